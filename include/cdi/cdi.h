@@ -35,6 +35,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <functional>
 
 #ifndef CDI_DLL_EXPORT
 #   define CDI_DLL_EXPORT __declspec(dllexport)
@@ -49,6 +50,12 @@ enum class Encoding
     I420,
     RGB24,
     RGBA32,
+    P010,   // 4:2:0, 16 bit little endian samples holding 10 bits in the high bits, interleaved UV plane
+    P016,   // As P010 with all 16 bits used
+    Y210,   // 4:2:2 packed Y0 U Y1 V, 16 bit samples holding 10 bits in the high bits
+    GRAY16, // 16 bit luma only
+    MJPEG,  // Compressed frames as the device delivers them, no decode and no conversion
+    H264,   // Annex B access units, frames depend on the ones before up to a keyframe
 };
 
 struct Resolution
@@ -59,6 +66,318 @@ struct Resolution
     uint32_t height;
 };
 
+struct PyramidLevel
+{
+    PyramidLevel() : scale(2), encoding(Encoding::UNKNOWN) {}
+    PyramidLevel(const uint32_t& scale, const Encoding& encoding) : scale(scale), encoding(encoding) {}
+    uint32_t scale; // Power of two divisor of the stream resolution
+    Encoding encoding;
+};
+
+struct ChangeGateOptions
+{
+    ChangeGateOptions() : enabled(false), grid_step(4), tile_size(16), threshold(4.0f), max_skipped(30) {}
+    bool enabled;
+    uint32_t grid_step;   // Luma is sampled every grid_step pixels in both directions
+    uint32_t tile_size;   // Tile edge in grid samples
+    float threshold;      // Mean absolute difference of a tile above which it counts as changed
+    uint32_t max_skipped; // Deliver a frame after this many unchanged ones, zero waits for a change
+};
+
+struct StatisticsOptions
+{
+    StatisticsOptions() : enabled(false), clip_low(2), clip_high(253) {}
+    bool enabled;
+    uint8_t clip_low;  // Luma at or below counts as clipped
+    uint8_t clip_high; // Luma at or above counts as clipped
+};
+
+enum class ColorMatrix
+{
+    DEFAULT, // Whatever the system color converter picks
+    BT601,
+    BT709,
+    BT2020,
+};
+
+enum class ColorRange
+{
+    LIMITED, // 16..235 luma, 16..240 chroma
+    FULL,
+};
+
+struct ColorSpace
+{
+    ColorSpace() : matrix(ColorMatrix::DEFAULT), range(ColorRange::LIMITED) {}
+    ColorSpace(const ColorMatrix& matrix, const ColorRange& range) : matrix(matrix), range(range) {}
+    ColorMatrix matrix;
+    ColorRange range;
+};
+
+struct ToneMapOptions
+{
+    ToneMapOptions() : enabled(false), black(0), white(0xFFFF) {}
+    bool enabled;   // High bit depth cameras to I420 through the window below instead of the system converter,
+                    // RGB output always takes own kernels and the window when enabled
+    uint16_t black; // 16 bit (high bit aligned) luma mapped to 0
+    uint16_t white; // mapped to 255
+};
+
+enum class DemosaicMethod
+{
+    BILINEAR,
+    EDGE_AWARE, // Green along the smaller gradient, red and blue from color differences
+};
+
+struct DemosaicOptions
+{
+    DemosaicOptions() : method(DemosaicMethod::EDGE_AWARE), threads(0) {}
+    DemosaicMethod method;
+    uint32_t threads; // Zero uses all hardware threads
+};
+
+enum class Rotation
+{
+    NONE,
+    CLOCKWISE_90,
+    CLOCKWISE_180,
+    CLOCKWISE_270,
+};
+
+// Done by the conversion itself without a pass of its own. Rotation and mirroring need an 8 bit
+// YUV camera (I420, NV12 or YUY2) and RGB24, RGBA32 or I420 output, I420 also an even frame size.
+// Change masks keep the orientation of the camera.
+struct OrientationOptions
+{
+    OrientationOptions() : rotation(Rotation::NONE), mirror_horizontal(false), mirror_vertical(false), top_down(false) {}
+    Rotation rotation;      // After the mirroring, 90 and 270 swap width and height
+    bool mirror_horizontal;
+    bool mirror_vertical;
+    bool top_down;          // RGB frames with the top row first in memory instead of bottom-up
+};
+
+enum class Presample
+{
+    SYNCHRONOUS, // open_device() returns once the first frame has been read
+    DEFERRED,    // The first read runs in the background, the first lock() waits for it
+    NONE,        // The camera starts streaming with the first lock()
+};
+
+// Rebuilds the reader and the conversion of a stream which stopped delivering frames. Streams
+// with a watchdog read in the background as asynchronous ones; lock() waits at most until a stall
+// is noticed and then hands out the last good frame marked stale.
+struct WatchdogOptions
+{
+    WatchdogOptions()
+        : enabled(false), stall_intervals(10), max_errors(3), frame_interval_ms(0), retry_ms(1000)
+        , give_up_ms(30000) {}
+    bool enabled;
+    uint32_t stall_intervals;   // Frame intervals without a frame which count as a stall
+    uint32_t max_errors;        // Failed reads in a row which count as a failure
+    uint32_t frame_interval_ms; // Zero takes it from the frame rate of the device
+    uint32_t retry_ms;          // Between rebuilds which did not bring frames back
+    uint32_t give_up_ms;        // The stream stops after recovering this long, zero never gives up
+};
+
+// Keeps the frames of the last seconds as the device delivers them, native or compressed, for
+// IBuffer::dump(). The ring is allocated once on open, frames are copied into it on the capture
+// thread and the oldest ones are overwritten. reconfigure() empties it.
+struct PretriggerOptions
+{
+    PretriggerOptions() : seconds(0), bytes(0) {}
+    uint32_t seconds;        // Zero keeps no frames
+    size_t bytes;            // Size of the ring, zero sizes it for 'seconds' at the nominal frame rate
+                             // with compressed frames counted as I420
+    std::wstring spill_path; // The ring lives in a file mapping there instead of memory, the system
+                             // writes parts of it to disk when memory is short. Deleted on close.
+};
+
+enum class ThreadPriority
+{
+    DEFAULT,  // As the thread was created
+    LOW,
+    NORMAL,
+    HIGH,
+    CRITICAL, // Time critical, real time within a process of the real time priority class
+};
+
+enum class MemoryPlacement
+{
+    DEFAULT,        // Wherever the system puts it
+    OPENING_THREAD, // NUMA node of the thread opening the stream, usually the consumer
+    NODE,           // The node given in the policy
+};
+
+// Where the threads the library runs for a stream are scheduled and where its frame memory lives.
+// Covers the demosaic workers, the deferred presample and the session and probe threads; reader
+// callbacks run on Media Foundation threads, which are shared by the process and left alone.
+struct ThreadPolicy
+{
+    ThreadPolicy()
+        : enabled(false), cpu_mask(0), cpu_group(0), priority(ThreadPriority::DEFAULT)
+        , memory(MemoryPlacement::DEFAULT), numa_node(0) {}
+    bool enabled;      // Streams without a policy of their own use the one of the process
+    uint64_t cpu_mask; // Processors of 'cpu_group' the threads may run on, zero leaves them as they are
+    uint16_t cpu_group;
+    ThreadPriority priority;
+    MemoryPlacement memory;
+    uint32_t numa_node;
+};
+
+// What a stream ended up with, read back from the system
+struct ThreadPlacement
+{
+    ThreadPlacement() : threads(0), failed(0), cpu_mask(0), cpu_group(0), priority(0), memory_node(-1) {}
+    uint32_t threads;    // Threads the policy was applied to
+    uint32_t failed;     // Of which a part of the policy was refused
+    uint64_t cpu_mask;   // Affinity of the last of them
+    uint16_t cpu_group;
+    int32_t priority;    // System priority of the last of them
+    int32_t memory_node; // NUMA node holding the frame, -1 while unknown or not resident
+};
+
+struct StreamOptions
+{
+    StreamOptions() : asynchronous(false), presample(Presample::SYNCHRONOUS) {}
+    // Downscaled copies of every frame, built from a single read of the frame
+    std::vector<PyramidLevel> pyramid;
+    // Frames without change against the last delivered one are neither converted nor delivered
+    ChangeGateOptions change_gate;
+    // Luma statistics of every delivered frame
+    StatisticsOptions statistics;
+    // YUV matrix and range of the camera for conversions to RGB
+    ColorSpace color;
+    // Fast 16 to 8 bit path for high bit depth cameras
+    ToneMapOptions tone_map;
+    // Raw Bayer cameras, converted to any encoding
+    DemosaicOptions demosaic;
+    // Rotation and mirroring of the delivered frames
+    OrientationOptions orientation;
+    // Frames are read in the background and announced through IBuffer::notify_frame,
+    // lock() takes the latest one and only blocks until there is one
+    bool asynchronous;
+    // First read of synchronous streams, asynchronous ones start reading on open
+    Presample presample;
+    // Placement of the threads and frame memory of this stream
+    ThreadPolicy threads;
+    // Automatic recovery of stalled or failing streams
+    WatchdogOptions watchdog;
+    // Frames before an event, see IBuffer::dump()
+    PretriggerOptions pretrigger;
+};
+
+// Where open_device() spent its time, durations in 100ns units as clock_now()
+struct OpenTimings
+{
+    OpenTimings()
+        : enumerate(0), activate(0), reader(0), setup(0), presample(0), total(0), first_frame(0)
+        , warm(false) {}
+    int64_t enumerate;   // Device and format enumeration, includes the activation of the media source
+    int64_t activate;    // Zero when the source activated for the enumeration was reused
+    int64_t reader;      // Source reader and its media type
+    int64_t setup;       // Color conversion and frame processing
+    int64_t presample;   // Synchronous first read
+    int64_t total;       // open_device() as a whole
+    int64_t first_frame; // From the start of open_device() to the first frame read, zero until then
+    bool warm;           // The device was kept open by a session pool or the stream reconfigured
+};
+
+struct FrameStatistics
+{
+    FrameStatistics() : histogram(), samples(0), mean(0.0f), clipped(0.0f), sharpness(0.0f) {}
+    uint32_t histogram[256];
+    uint64_t samples;
+    float mean;
+    float clipped;   // Ratio of clipped samples
+    float sharpness; // Mean absolute horizontal plus vertical luma gradient
+};
+
+struct FrameInfo
+{
+    FrameInfo()
+        : sequence(0), timestamp(0), changed(true), change_score(0.0f)
+        , tiles_x(0), tiles_y(0), change_mask(nullptr), statistics(nullptr), stale(false), keyframe(true) {}
+    uint64_t sequence;          // Number of frames read from the device, including skipped ones
+    int64_t timestamp;
+    bool changed;               // False for a heartbeat frame delivered by the change gate
+    float change_score;         // Mean absolute luma difference against the last delivered frame
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    const uint8_t* change_mask; // tiles_x * tiles_y entries, non zero for changed tiles
+    const FrameStatistics* statistics; // Null unless enabled
+    bool stale;                 // No new frame arrived, this is the last good one
+    bool keyframe;              // Decodes without the frames before it, false only for H264
+};
+
+// Watchdog activity of a stream, durations in clock_now() units
+struct RecoveryStatistics
+{
+    RecoveryStatistics()
+        : stalls(0), failures(0), recoveries(0), attempts(0), last(0), longest(0), total(0)
+        , recovering(false), gave_up(false) {}
+    uint32_t stalls;     // Recoveries started because no frame arrived
+    uint32_t failures;   // Recoveries started because reads failed
+    uint32_t recoveries; // Recoveries which brought frames back
+    uint32_t attempts;   // Rebuilds of the reader, several per recovery when the first ones fail
+    int64_t last;        // From the detection to the first frame of the last recovery
+    int64_t longest;
+    int64_t total;
+    bool recovering;
+    bool gave_up;
+};
+
+// Counters of a stream since it was opened, durations in clock_now() units
+struct StreamLoad
+{
+    StreamLoad() : frames(0), delivered(0), dropped(0), convert_time(0), latency(0), frame_interval(0) {}
+    uint64_t frames;        // Read from the device, including the ones which were not delivered
+    uint64_t delivered;     // Converted for the consumer
+    uint64_t dropped;       // Replaced by a newer frame before the consumer got to them
+    int64_t convert_time;   // Spent converting the delivered frames
+    int64_t latency;        // Sum of capture to delivery of the delivered frames
+    int64_t frame_interval; // Of the device, zero while unknown
+};
+
+// Capture at a reduced cost, the default is the stream as opened
+struct CaptureQuality
+{
+    CaptureQuality() : frame_divisor(1), cheap_format(false), resolution_steps(0) {}
+    uint32_t frame_divisor;    // Every n-th frame of the device is delivered, the others are dropped before their conversion
+    bool cheap_format;         // Native format of the resolution with the cheapest conversion, uncompressed 8 bit YUV first
+    uint32_t resolution_steps; // Device resolutions below the one opened
+};
+
+struct FrameLevel
+{
+    FrameLevel() : width(0), height(0), encoding(Encoding::UNKNOWN), size(0), data(nullptr), top_down(false) {}
+    uint32_t width;
+    uint32_t height;
+    Encoding encoding;
+    size_t size;
+    const void* data;
+    bool top_down;    // RGB rows start with the top one, see OrientationOptions
+    ColorSpace color; // Of YUV levels, StreamOptions::color of the stream
+};
+
+// Caller memory for one plane of a frame
+struct FramePlane
+{
+    FramePlane() : data(nullptr), stride(0) {}
+    FramePlane(void* data, const size_t& stride) : data(data), stride(stride) {}
+    void* data;
+    size_t stride; // Distance between rows in bytes, at least the row length
+};
+
+// Snapshots as baseline JPEG (JFIF, 4:2:0), see IBuffer::snapshot_jpeg()
+struct JpegOptions
+{
+    JpegOptions() : quality(85), scale(1) {}
+    uint32_t quality; // 1..100 as the IJG encoder
+    uint32_t scale;   // Width and height are divided by 1, 2, 4 or 8 (box filter)
+};
+
+class ICodec;
+
 class IBuffer
 {
 public:
@@ -66,20 +385,391 @@ public:
     virtual uint32_t width() const = 0;
     virtual uint32_t height() const = 0;
     virtual Encoding encoding() const = 0;
+    // Compressed encodings differ from frame to frame, this is the size of the locked frame
     virtual size_t size() const = 0;
+    // Capture time of the locked frame, see clock_now()
+    virtual int64_t timestamp() const = 0;
     virtual const void* lock() = 0;
     virtual void unlock() = 0;
+    // Level 0 is the frame itself followed by the pyramid levels, valid while locked
+    virtual uint32_t level_count() const = 0;
+    virtual FrameLevel level(const uint32_t& index) const = 0;
+    // Description of the locked frame, pointers are valid while locked
+    virtual FrameInfo info() const = 0;
+    // Reads the next frame and converts it straight into caller memory instead of the frame
+    // returned by lock(). Rows are ordered as in lock() but 'stride' bytes apart, I420 chroma
+    // planes follow the luma plane with half the stride. The memory is only written during the
+    // call and not referenced afterwards. Must not be called while locked, info() describes
+    // the frame, levels are not built for it. Not for compressed encodings.
+    virtual bool read_into(void* dst, const size_t& stride) = 0;
+    // One destination per plane in plane order (Y, U, V for I420). Planes which are not laid
+    // out as above are converted internally and copied.
+    virtual bool read_into(const FramePlane* planes, const uint32_t& plane_count) = 0;
+    // Asynchronous streams only. Calls 'ready' once a frame newer than the last locked one has
+    // arrived, right away when there is one already; lock() does not block after ready(true).
+    // ready(false) when the stream stops or the request is cancelled. 'ready' runs on a capture
+    // thread and must neither block nor destroy the stream. Returns false when a request is
+    // pending already or the stream is synchronous.
+    virtual bool notify_frame(const std::function<void(bool)>& ready) = 0;
+    // Calls a pending 'ready' with false
+    virtual void cancel_notify() = 0;
+    // Where the open_device() call that created this buffer spent its time, after reconfigure()
+    // where that did
+    virtual OpenTimings open_timings() const = 0;
+    // Switches the live stream to the closest available resolution and another encoding, only the
+    // media type of the device and the conversion are renegotiated. Must not be called while
+    // locked, the stream keeps its configuration on failure.
+    virtual bool reconfigure(const uint32_t& width, const uint32_t& height, const Encoding& encoding) = 0;
+    // Effective thread and memory placement of the stream
+    virtual ThreadPlacement placement() const = 0;
+    virtual RecoveryStatistics recovery() const = 0;
+    // What the frames of the stream cost, see create_governor()
+    virtual StreamLoad load() const = 0;
+    // Takes effect with the next lock() or read_into(), may be called from any thread. False when
+    // the stream cannot capture at this quality, a resolution step too many for example.
+    virtual bool set_quality(const CaptureQuality& quality) = 0;
+    // Quality asked for last
+    virtual CaptureQuality quality() const = 0;
+    // Reads the next frame and encodes it as JPEG into 'dst', returns the encoded size or zero
+    // when the frame could not be read or 'dst_size' is too small, see jpeg_bound(). Devices
+    // delivering 8 bit YUV are encoded from the device frame without a conversion. Frames of
+    // other formats and of streams which rotate or mirror go through the I420 conversion, which
+    // needs an I420 stream. Must not be called while locked, info() describes the frame.
+    virtual size_t snapshot_jpeg(const JpegOptions& options, void* dst, const size_t& dst_size) = 0;
+    // Writes the frames kept for StreamOptions::pretrigger from 'since' on into a recording, as
+    // create_recording() with the encoding of the buffer. H.264 starts at the keyframe before.
+    // Frames are copied out of the ring and converted on the calling thread while the capture
+    // goes on; frames the ring overwrites before they are copied are missing from the recording.
+    // False without a ring, without frames or when the recording fails.
+    virtual bool dump(const int64_t& since, const std::wstring& path, std::unique_ptr<ICodec> codec) = 0;
 };
 
+// Worst case size of snapshot_jpeg() for a frame of width x height
+CDI_DLL_EXPORT size_t jpeg_bound(const uint32_t& width, const uint32_t& height, const JpegOptions& options);
+
+// Shared clock of all devices in 100ns units
+CDI_DLL_EXPORT int64_t clock_now();
+
+// Policy of all threads the library starts from now on, streams may bring their own
+CDI_DLL_EXPORT void set_thread_policy(const ThreadPolicy& policy);
+CDI_DLL_EXPORT ThreadPolicy get_thread_policy();
+
+// Tracing of the capture pipeline: reads, conversions, locks and unlocks of all streams with their
+// frame numbers. Every thread keeps the last events_per_thread events, starting again discards
+// the earlier ones.
+CDI_DLL_EXPORT void start_trace(const uint32_t& events_per_thread);
+CDI_DLL_EXPORT void stop_trace();
+// Chrome trace event JSON of the recorded events, opens in Perfetto and chrome://tracing.
+// Works while tracing goes on.
+CDI_DLL_EXPORT std::string dump_trace();
+
 CDI_DLL_EXPORT std::vector<std::wstring> list_devices();
 
 CDI_DLL_EXPORT std::vector<Resolution> get_resolutions(const uint32_t& device_index);
 
-// Will select closest available resolution
+enum class ProbeStatus
+{
+    OK,
+    FAILED,  // The device could not be activated
+    TIMEOUT, // Still probing at the timeout, the probe finishes in the background
+};
+
+struct DeviceFormat
+{
+    DeviceFormat() : width(0), height(0), framerate(0) {}
+    uint32_t width;
+    uint32_t height;
+    uint32_t framerate; // Numerator of the frame rate
+    std::string format; // Native format, e.g. "MFVideoFormat_NV12"
+};
+
+struct DeviceCapabilities
+{
+    DeviceCapabilities() : index(0), status(ProbeStatus::FAILED), duration(0) {}
+    uint32_t index;   // As in list_devices()
+    std::wstring name;
+    ProbeStatus status;
+    int64_t duration; // Time spent on the device in clock_now() units
+    std::vector<DeviceFormat> formats;
+};
+
+struct ProbeOptions
+{
+    ProbeOptions() : threads(4), timeout_ms(5000) {}
+    uint32_t threads;    // Devices probed at the same time, zero for all at once
+    uint32_t timeout_ms; // Per device, zero waits as long as it takes
+};
+
+// Names and native formats of all devices from a single enumeration, the devices are activated
+// concurrently. A device which misses the timeout neither holds up the others nor the result.
+CDI_DLL_EXPORT std::vector<DeviceCapabilities> probe_all(const ProbeOptions& options);
+
+// Will select closest available resolution. Compressed encodings only pick formats of that
+// kind and fail on devices without one. Their streams cannot rotate, mirror or build levels,
+// H.264 streams keep the full frame rate.
 CDI_DLL_EXPORT std::unique_ptr<IBuffer> open_device(
     const uint32_t& device_index,
     const uint32_t& width,
     const uint32_t& height,
     const Encoding& encoding);
 
+CDI_DLL_EXPORT std::unique_ptr<IBuffer> open_device(
+    const uint32_t& device_index,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const StreamOptions& options);
+
+// Keeps devices activated between buffers, opening a device again skips the enumeration and
+// the activation of the camera. Device indices are the ones of list_devices() at the creation of
+// the pool. A device serves one buffer at a time, it is shut down once it has been without a
+// buffer for the idle timeout, checked a few times per timeout.
+class ISessionPool
+{
+public:
+    virtual ~ISessionPool() {}
+    // As open_device(), null while another buffer of this pool uses the device
+    virtual std::unique_ptr<IBuffer> open(
+        const uint32_t& device_index,
+        const uint32_t& width,
+        const uint32_t& height,
+        const Encoding& encoding,
+        const StreamOptions& options) = 0;
+    // Devices kept open without a buffer
+    virtual uint32_t idle_count() const = 0;
+    // Shuts down idle devices right away
+    virtual void clear() = 0;
+};
+
+CDI_DLL_EXPORT std::unique_ptr<ISessionPool> create_session_pool(const uint32_t& idle_timeout_ms);
+
+// One capture of a device for several consumers, each in its own encoding. Frames are read from
+// the device once for all of them, a frame is converted into an encoding at most once and only
+// when a consumer of that encoding locks it; consumers of the same encoding share the result.
+class ISharedStream
+{
+public:
+    virtual ~ISharedStream() {}
+    // New consumer, the buffers keep the capture running after the stream object is gone. A
+    // lock() gets the latest frame if it is newer than the consumer's last one, otherwise the
+    // next from the device. Pyramids are built per consumer, reconfigure() is not supported.
+    // Compressed encodings cannot be attached.
+    virtual std::unique_ptr<IBuffer> attach(const Encoding& encoding) = 0;
+    virtual uint32_t width() const = 0;
+    virtual uint32_t height() const = 0;
+};
+
+// Resolution and device format are selected as for an I420 open_device()
+CDI_DLL_EXPORT std::unique_ptr<ISharedStream> open_shared(
+    const uint32_t& device_index,
+    const uint32_t& width,
+    const uint32_t& height,
+    const StreamOptions& options);
+
+// Quality governor
+
+struct GovernorOptions
+{
+    GovernorOptions()
+        : interval_ms(500), high_cpu(0.85f), low_cpu(0.6f), max_lag(3.0f), max_dropped(0.25f)
+        , down_ms(1000), up_ms(10000), settle_ms(2000), max_frame_divisor(4), cheap_format(true)
+        , max_resolution_steps(2) {}
+    uint32_t interval_ms;          // Between two looks at the streams
+    float high_cpu;                // System CPU load (0..1) above which streams are stepped down
+    float low_cpu;                 // and below which they are stepped up again
+    float max_lag;                 // Capture to delivery in frame intervals above which a stream lags
+    float max_dropped;             // Ratio of dropped frames above which a stream lags
+    uint32_t down_ms;              // Pressure lasts this long before a stream is stepped down
+    uint32_t up_ms;                // Headroom lasts this long before a stream is stepped up
+    uint32_t settle_ms;            // No step follows another one sooner
+    uint32_t max_frame_divisor;    // Steps down halve the frame rate up to this divisor first,
+    bool cheap_format;             // then switch to the cheapest native format
+    uint32_t max_resolution_steps; // and finally to lower resolutions
+    std::function<float()> cpu_load; // Load model replacing the measured system load
+};
+
+enum class GovernorReason
+{
+    CPU_LOAD, // Stepped down, the system is loaded
+    LAG,      // Stepped down, the consumer of this stream falls behind
+    HEADROOM, // Stepped up
+};
+
+struct GovernorEvent
+{
+    GovernorEvent() : buffer(nullptr), priority(0), reason(GovernorReason::CPU_LOAD), cpu_load(0.0f), lag(0.0f), convert(0.0f) {}
+    IBuffer* buffer;
+    uint32_t priority;
+    CaptureQuality previous;
+    CaptureQuality quality;
+    GovernorReason reason;
+    float cpu_load;
+    float lag;     // Capture to delivery of the stream in frame intervals
+    float convert; // Conversion time of a frame in frame intervals
+};
+
+// Steps streams down one at a time while the system is loaded or their consumers fall behind,
+// and back up once there is headroom again. Pressure and headroom have to last before anything
+// changes and every change is followed by a time without changes.
+class IGovernor
+{
+public:
+    virtual ~IGovernor() {}
+    // Streams of lower priority are stepped down first and up last, among equal ones the most
+    // expensive goes down first. The buffer must outlive its membership.
+    virtual bool add(IBuffer* buffer, const uint32_t& priority) = 0;
+    // The stream gets back the quality it was opened with
+    virtual void remove(IBuffer* buffer) = 0;
+};
+
+// 'events' reports every change on the thread of the governor, it must neither block nor call
+// the governor
+CDI_DLL_EXPORT std::unique_ptr<IGovernor> create_governor(
+    const GovernorOptions& options,
+    const std::function<void(const GovernorEvent&)>& events);
+
+// Lossless frame compression
+
+enum class Predictor
+{
+    LEFT,
+    MEDIAN,
+};
+
+class ICodec
+{
+public:
+    virtual ~ICodec() {}
+    // Worst case size of an encoded frame
+    virtual size_t bound(const uint32_t& width, const uint32_t& height, const Encoding& encoding) const = 0;
+    // Returns the encoded size in bytes, zero on failure
+    virtual size_t encode(
+        const void* frame,
+        const uint32_t& width,
+        const uint32_t& height,
+        const Encoding& encoding,
+        void* dst,
+        const size_t& dst_size) = 0;
+    // Reads the frame description of an encoded frame
+    virtual bool info(
+        const void* src,
+        const size_t& src_size,
+        uint32_t& width,
+        uint32_t& height,
+        Encoding& encoding) const = 0;
+    // Decoding is bit-exact, dst_size must be at least the raw frame size
+    virtual bool decode(const void* src, const size_t& src_size, void* dst, const size_t& dst_size) = 0;
+};
+
+// Zero threads selects the number of hardware threads
+CDI_DLL_EXPORT std::unique_ptr<ICodec> create_lossless_codec(
+    const Predictor& predictor,
+    const uint32_t& threads);
+
+// Capture container
+
+class IRecorder
+{
+public:
+    virtual ~IRecorder() {}
+    // Frames are compressed when the recorder was created with a codec
+    virtual bool append(const void* frame, const size_t& bytes, const int64_t& timestamp) = 0;
+    // Frames of compressed encodings, which are stored as they are
+    virtual bool append(const void* frame, const size_t& bytes, const int64_t& timestamp, const bool& keyframe) = 0;
+    virtual uint64_t frame_count() const = 0;
+    // Writes the frame index, also called on destruction
+    virtual bool close() = 0;
+};
+
+struct RecordedFrame
+{
+    RecordedFrame() : data(nullptr), size(0), timestamp(0), compressed(false), keyframe(true) {}
+    const void* data; // Points into the mapped file, valid for the lifetime of the recording
+    size_t size;
+    int64_t timestamp;
+    bool compressed;  // By the codec of the recorder
+    bool keyframe;    // See FrameInfo::keyframe
+};
+
+class IRecording
+{
+public:
+    virtual ~IRecording() {}
+    virtual uint32_t width() const = 0;
+    virtual uint32_t height() const = 0;
+    virtual Encoding encoding() const = 0;
+    // Largest frame of compressed encodings
+    virtual size_t size() const = 0;
+    virtual std::wstring device_name() const = 0;
+    virtual uint64_t frame_count() const = 0;
+    // True if the index was missing and rebuilt from the frame area
+    virtual bool recovered() const = 0;
+    virtual bool frame(const uint64_t& index, RecordedFrame& frame) const = 0;
+    // Index of the last frame captured at or before the timestamp
+    virtual uint64_t find(const int64_t& timestamp) const = 0;
+    // Copies or decodes a frame, dst_size must be at least size(). Frames of compressed encodings
+    // are copied as they are, frame() has their size.
+    virtual bool read(const uint64_t& index, void* dst, const size_t& dst_size) = 0;
+};
+
+// Codec is optional, without it frames are stored as they are. Compressed encodings take no codec.
+CDI_DLL_EXPORT std::unique_ptr<IRecorder> create_recording(
+    const std::wstring& path,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const std::wstring& device_name,
+    std::unique_ptr<ICodec> codec);
+
+CDI_DLL_EXPORT std::unique_ptr<IRecording> open_recording(const std::wstring& path);
+
+// Tensor output
+
+enum class TensorLayout
+{
+    NCHW,
+    NHWC,
+};
+
+enum class TensorType
+{
+    UINT8,
+    FLOAT32,
+    FLOAT16,
+};
+
+enum class ChannelOrder
+{
+    RGB,
+    BGR,
+};
+
+struct TensorDesc
+{
+    TensorDesc()
+        : width(0), height(0), layout(TensorLayout::NCHW), type(TensorType::FLOAT32), order(ChannelOrder::RGB)
+        , mean{0.0f, 0.0f, 0.0f}, std{1.0f, 1.0f, 1.0f} {}
+    uint32_t width;  // Frames are resized (bilinear) to width x height
+    uint32_t height;
+    TensorLayout layout;
+    TensorType type;
+    ChannelOrder order;
+    float mean[3];   // Per output channel, applied to values scaled to 0..1, ignored for UINT8
+    float std[3];
+};
+
+class ITensorWriter
+{
+public:
+    virtual ~ITensorWriter() {}
+    // Bytes of one batch item
+    virtual size_t size() const = 0;
+    // Writes a locked frame (or pyramid level) as item 'batch_index' of the tensor
+    virtual bool write(const FrameLevel& frame, void* tensor, const uint32_t& batch_index) = 0;
+    // Locks every buffer in turn and writes it as the batch item of the same index
+    virtual bool write(const std::vector<IBuffer*>& buffers, void* tensor) = 0;
+};
+
+CDI_DLL_EXPORT std::unique_ptr<ITensorWriter> create_tensor_writer(const TensorDesc& desc);
+
 }
\ No newline at end of file
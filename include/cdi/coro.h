@@ -0,0 +1,366 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+// Awaitable frames for C++20 coroutines, the rest of the library stays C++14
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace cdi { namespace coro {
+
+// Where suspended coroutines are resumed. Both calls may come from any thread,
+// the work has to run on the executor.
+class IExecutor
+{
+public:
+    virtual ~IExecutor() {}
+    virtual void post(std::function<void()> work) = 0;
+    virtual void post_after(const std::chrono::steady_clock::duration& delay, std::function<void()> work) = 0;
+};
+
+// Single threaded executor, run() does the posted work and due timers on the calling
+// thread until stop()
+class RunLoop : public IExecutor
+{
+    RunLoop(const RunLoop&);
+    RunLoop& operator=(const RunLoop&);
+
+public:
+    RunLoop() : m_stop(false) {}
+
+    void post(std::function<void()> work) final
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_work.push_back(std::move(work));
+        m_wake.notify_one();
+    }
+
+    void post_after(const std::chrono::steady_clock::duration& delay, std::function<void()> work) final
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_timers.emplace(std::chrono::steady_clock::now() + delay, std::move(work));
+        m_wake.notify_one();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(!m_stop)
+        {
+            // Due timers queue up behind the posted work in the order they expired
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            while(!m_timers.empty() && m_timers.begin()->first <= now)
+            {
+                m_work.push_back(std::move(m_timers.begin()->second));
+                m_timers.erase(m_timers.begin());
+            }
+
+            if(m_work.empty())
+            {
+                if(m_timers.empty())
+                {
+                    m_wake.wait(lock);
+                }
+                else
+                {
+                    m_wake.wait_until(lock, m_timers.begin()->first);
+                }
+                continue;
+            }
+
+            std::function<void()> work = std::move(m_work.front());
+            m_work.pop_front();
+
+            lock.unlock();
+            work();
+            lock.lock();
+        }
+
+        m_stop = false;
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_wake.notify_one();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_work;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> m_timers;
+    bool m_stop;
+};
+
+// Shared cancellation flag. Callbacks run once, on the thread calling cancel(), or
+// right away when registered after it.
+class CancellationToken
+{
+public:
+    CancellationToken() {}
+
+    bool cancelled() const
+    {
+        return m_state && m_state->cancelled.load();
+    }
+
+    // Returns an id for remove(), zero when the token can not be cancelled
+    uint64_t on_cancel(std::function<void()> callback) const
+    {
+        if(!m_state)
+        {
+            return 0;
+        }
+
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        if(m_state->cancelled)
+        {
+            lock.unlock();
+            callback();
+            return 0;
+        }
+
+        const uint64_t id = ++m_state->next_id;
+        m_state->callbacks.emplace(id, std::move(callback));
+        return id;
+    }
+
+    void remove(const uint64_t& id) const
+    {
+        if(m_state && id != 0)
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            m_state->callbacks.erase(id);
+        }
+    }
+
+private:
+    friend class CancellationSource;
+
+    struct State
+    {
+        State() : cancelled(false), next_id(0) {}
+        std::mutex mutex;
+        std::atomic<bool> cancelled;
+        uint64_t next_id;
+        std::map<uint64_t, std::function<void()>> callbacks;
+    };
+
+    explicit CancellationToken(const std::shared_ptr<State>& state) : m_state(state) {}
+
+    std::shared_ptr<State> m_state;
+};
+
+class CancellationSource
+{
+public:
+    CancellationSource() : m_state(std::make_shared<CancellationToken::State>()) {}
+
+    CancellationToken token() const
+    {
+        return CancellationToken(m_state);
+    }
+
+    void cancel()
+    {
+        std::map<uint64_t, std::function<void()>> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            if(m_state->cancelled.exchange(true))
+            {
+                return;
+            }
+            callbacks.swap(m_state->callbacks);
+        }
+
+        for(auto& callback : callbacks)
+        {
+            callback.second();
+        }
+    }
+
+private:
+    std::shared_ptr<CancellationToken::State> m_state;
+};
+
+enum class FrameStatus
+{
+    READY,     // lock() returns the new frame without blocking
+    TIMEOUT,
+    CANCELLED,
+    STOPPED,   // The stream ended or is not asynchronous
+};
+
+// co_await next_frame(*stream, executor) suspends until the stream has a new frame. The
+// coroutine is always resumed through the executor, never on a capture thread. The
+// stream has to be opened with StreamOptions::asynchronous and has to outlive the wait.
+class FrameAwaiter
+{
+public:
+    FrameAwaiter(
+        IBuffer& buffer,
+        IExecutor& executor,
+        const std::chrono::steady_clock::duration& timeout,
+        const CancellationToken& token)
+        : m_state(std::make_shared<State>(buffer, executor))
+        , m_timeout(timeout)
+        , m_token(token)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        const std::shared_ptr<State> state = m_state;
+        const std::chrono::steady_clock::duration timeout = m_timeout;
+        const CancellationToken token = m_token;
+        state->handle = handle;
+        state->token = token;
+
+        // Whichever of frame, timeout and cancellation comes first resumes the coroutine.
+        // Nothing below touches the awaiter, the coroutine may be resumed on another
+        // executor thread before this returns.
+        if(token.cancelled())
+        {
+            finish(state, FrameStatus::CANCELLED);
+            return;
+        }
+
+        if(!state->buffer.notify_frame([state](bool arrived)
+            {
+                finish(state, arrived ? FrameStatus::READY : FrameStatus::STOPPED);
+            }))
+        {
+            finish(state, FrameStatus::STOPPED);
+            return;
+        }
+
+        if(state->done)
+        {
+            return;
+        }
+
+        if(timeout > std::chrono::steady_clock::duration::zero())
+        {
+            state->executor.post_after(timeout, [state]()
+            {
+                if(finish(state, FrameStatus::TIMEOUT))
+                {
+                    state->buffer.cancel_notify();
+                }
+            });
+        }
+
+        state->registration = token.on_cancel([state]()
+        {
+            if(finish(state, FrameStatus::CANCELLED))
+            {
+                state->buffer.cancel_notify();
+            }
+        });
+    }
+
+    FrameStatus await_resume() const noexcept
+    {
+        return m_state->status;
+    }
+
+private:
+    struct State
+    {
+        State(IBuffer& buffer, IExecutor& executor)
+            : buffer(buffer), executor(executor), done(false), status(FrameStatus::STOPPED), registration(0) {}
+        IBuffer& buffer;
+        IExecutor& executor;
+        std::atomic<bool> done;
+        FrameStatus status;
+        std::coroutine_handle<> handle;
+        CancellationToken token;
+        std::atomic<uint64_t> registration;
+    };
+
+    // True for the first completion only, the others find the coroutine resumed or about to be
+    static bool finish(const std::shared_ptr<State>& state, const FrameStatus& status)
+    {
+        bool expected = false;
+        if(!state->done.compare_exchange_strong(expected, true))
+        {
+            return false;
+        }
+
+        state->status = status;
+        state->executor.post([state]()
+        {
+            state->token.remove(state->registration.load());
+            state->handle.resume();
+        });
+
+        return true;
+    }
+
+    std::shared_ptr<State> m_state;
+    std::chrono::steady_clock::duration m_timeout;
+    CancellationToken m_token;
+};
+
+// A zero timeout waits without limit
+inline FrameAwaiter next_frame(
+    IBuffer& buffer,
+    IExecutor& executor,
+    const std::chrono::steady_clock::duration& timeout = std::chrono::steady_clock::duration::zero(),
+    const CancellationToken& token = CancellationToken())
+{
+    return FrameAwaiter(buffer, executor, timeout, token);
+}
+
+}}
+
+#endif
@@ -0,0 +1,760 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Python bindings. Frames are handed out without a copy: a locked frame supports the buffer
+// protocol, so memoryview() and numpy.asarray() point straight at the frame memory of the
+// stream. The frame stays locked until it is unlocked, which is refused while views of it
+// exist, or until it is garbage collected. Blocking calls release the GIL.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "cdi/cdi.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+struct FrameObject;
+
+struct BufferObject
+{
+    PyObject_HEAD
+    cdi::IBuffer* buffer;
+    FrameObject* frame; // Locked frame, not referenced
+    bool busy;          // A call runs without the GIL
+};
+
+struct FrameObject
+{
+    PyObject_HEAD
+    BufferObject* owner;
+    bool locked;
+    Py_ssize_t exports;
+    cdi::FrameLevel level;
+    uint64_t sequence;
+    int64_t timestamp;
+    bool stale;
+    bool keyframe;
+
+    // Layout handed to buffer consumers
+    const uint8_t* start;
+    int ndim;
+    Py_ssize_t itemsize;
+    const char* format;
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+};
+
+extern PyTypeObject BufferType;
+extern PyTypeObject FrameType;
+
+// Row length of the first plane, the default stride of read_into()
+Py_ssize_t row_bytes(const cdi::Encoding& encoding, const uint32_t& width)
+{
+    switch(encoding)
+    {
+    case cdi::Encoding::RGB24:
+        return static_cast<Py_ssize_t>(width) * 3;
+    case cdi::Encoding::RGBA32:
+    case cdi::Encoding::Y210:
+        return static_cast<Py_ssize_t>(width) * 4;
+    case cdi::Encoding::P010:
+    case cdi::Encoding::P016:
+    case cdi::Encoding::GRAY16:
+        return static_cast<Py_ssize_t>(width) * 2;
+    case cdi::Encoding::I420:
+    default:
+        return static_cast<Py_ssize_t>(width);
+    }
+}
+
+// RGB becomes height x width x channels with the first row on top, bottom-up frames get
+// a negative row stride. GRAY16 is height x width of uint16, planar and packed YUV stay
+// flat bytes as laid out in memory, compressed frames are their payload.
+void describe(FrameObject* frame)
+{
+    const cdi::FrameLevel& level = frame->level;
+    const uint8_t* data = static_cast<const uint8_t*>(level.data);
+    const Py_ssize_t width = static_cast<Py_ssize_t>(level.width);
+    const Py_ssize_t height = static_cast<Py_ssize_t>(level.height);
+
+    frame->start = data;
+    frame->itemsize = 1;
+    frame->format = "B";
+
+    if(level.encoding == cdi::Encoding::RGB24 || level.encoding == cdi::Encoding::RGBA32)
+    {
+        const Py_ssize_t channels = level.encoding == cdi::Encoding::RGB24 ? 3 : 4;
+        const Py_ssize_t pitch = width * channels;
+        frame->ndim = 3;
+        frame->shape[0] = height;
+        frame->shape[1] = width;
+        frame->shape[2] = channels;
+        frame->strides[0] = level.top_down ? pitch : -pitch;
+        frame->strides[1] = channels;
+        frame->strides[2] = 1;
+        if(!level.top_down && height > 0)
+        {
+            frame->start = data + pitch * (height - 1);
+        }
+    }
+    else if(level.encoding == cdi::Encoding::GRAY16)
+    {
+        frame->ndim = 2;
+        frame->itemsize = 2;
+        frame->format = "H";
+        frame->shape[0] = height;
+        frame->shape[1] = width;
+        frame->strides[0] = width * 2;
+        frame->strides[1] = 2;
+    }
+    else
+    {
+        frame->ndim = 1;
+        frame->shape[0] = static_cast<Py_ssize_t>(level.size);
+        frame->strides[0] = 1;
+    }
+}
+
+bool check_open(BufferObject* self)
+{
+    if(self->buffer == nullptr)
+    {
+        PyErr_SetString(PyExc_ValueError, "buffer is closed");
+        return false;
+    }
+
+    if(self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "buffer is in use by another thread");
+        return false;
+    }
+
+    return true;
+}
+
+// Frame
+
+bool frame_unlock(FrameObject* self)
+{
+    if(!self->locked)
+    {
+        return true;
+    }
+
+    if(self->exports > 0)
+    {
+        PyErr_Format(PyExc_BufferError, "cannot unlock, %zd views of the frame exist", self->exports);
+        return false;
+    }
+
+    self->owner->buffer->unlock();
+    self->owner->frame = nullptr;
+    self->locked = false;
+    return true;
+}
+
+void frame_dealloc(FrameObject* self)
+{
+    // Views hold a reference, none are left here
+    if(self->locked)
+    {
+        self->exports = 0;
+        frame_unlock(self);
+    }
+
+    Py_XDECREF(self->owner);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+int frame_getbuffer(FrameObject* self, Py_buffer* view, int flags)
+{
+    if(!self->locked)
+    {
+        PyErr_SetString(PyExc_BufferError, "frame is unlocked");
+        view->obj = nullptr;
+        return -1;
+    }
+
+    if((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "frame memory is read-only");
+        view->obj = nullptr;
+        return -1;
+    }
+
+    // Consumers which cannot take strides get the memory as it is, only possible for
+    // layouts without gaps or reversed rows
+    const bool strided = (flags & PyBUF_STRIDES) == PyBUF_STRIDES;
+    if(!strided && self->ndim == 3 && self->strides[0] < 0)
+    {
+        PyErr_SetString(PyExc_BufferError, "bottom-up frames need a strided buffer");
+        view->obj = nullptr;
+        return -1;
+    }
+
+    view->buf = const_cast<uint8_t*>(self->start);
+    view->obj = reinterpret_cast<PyObject*>(self);
+    view->len = static_cast<Py_ssize_t>(self->level.size);
+    view->readonly = 1;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? const_cast<char*>(self->format) : nullptr;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : nullptr;
+    view->strides = strided ? self->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+
+    Py_INCREF(self);
+    self->exports++;
+    return 0;
+}
+
+void frame_releasebuffer(FrameObject* self, Py_buffer*)
+{
+    self->exports--;
+}
+
+PyObject* frame_unlock_method(FrameObject* self, PyObject*)
+{
+    if(!frame_unlock(self))
+    {
+        return nullptr;
+    }
+
+    Py_RETURN_NONE;
+}
+
+PyObject* frame_enter(FrameObject* self, PyObject*)
+{
+    Py_INCREF(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+PyObject* frame_exit(FrameObject* self, PyObject*)
+{
+    if(!frame_unlock(self))
+    {
+        return nullptr;
+    }
+
+    Py_RETURN_FALSE;
+}
+
+PyObject* frame_numpy(FrameObject* self, PyObject*)
+{
+    PyObject* numpy = PyImport_ImportModule("numpy");
+    if(numpy == nullptr)
+    {
+        return nullptr;
+    }
+
+    PyObject* array = PyObject_CallMethod(numpy, "asarray", "O", self);
+    Py_DECREF(numpy);
+    return array;
+}
+
+PyObject* frame_get_locked(FrameObject* self, void*)
+{
+    return PyBool_FromLong(self->locked);
+}
+
+PyObject* frame_get_width(FrameObject* self, void*)
+{
+    return PyLong_FromUnsignedLong(self->level.width);
+}
+
+PyObject* frame_get_height(FrameObject* self, void*)
+{
+    return PyLong_FromUnsignedLong(self->level.height);
+}
+
+PyObject* frame_get_encoding(FrameObject* self, void*)
+{
+    return PyLong_FromLong(static_cast<long>(self->level.encoding));
+}
+
+PyObject* frame_get_sequence(FrameObject* self, void*)
+{
+    return PyLong_FromUnsignedLongLong(self->sequence);
+}
+
+PyObject* frame_get_timestamp(FrameObject* self, void*)
+{
+    return PyLong_FromLongLong(self->timestamp);
+}
+
+PyObject* frame_get_stale(FrameObject* self, void*)
+{
+    return PyBool_FromLong(self->stale);
+}
+
+PyObject* frame_get_keyframe(FrameObject* self, void*)
+{
+    return PyBool_FromLong(self->keyframe);
+}
+
+PyObject* frame_get_top_down(FrameObject* self, void*)
+{
+    return PyBool_FromLong(self->level.top_down);
+}
+
+PyMethodDef FRAME_METHODS[] =
+{
+    {"unlock", reinterpret_cast<PyCFunction>(frame_unlock_method), METH_NOARGS,
+     "Unlocks the frame, fails while views of it exist."},
+    {"numpy", reinterpret_cast<PyCFunction>(frame_numpy), METH_NOARGS,
+     "numpy.asarray() of the frame, a view of the frame memory."},
+    {"__enter__", reinterpret_cast<PyCFunction>(frame_enter), METH_NOARGS, nullptr},
+    {"__exit__", reinterpret_cast<PyCFunction>(frame_exit), METH_VARARGS, nullptr},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef FRAME_GETSET[] =
+{
+    {"locked", reinterpret_cast<getter>(frame_get_locked), nullptr, nullptr, nullptr},
+    {"width", reinterpret_cast<getter>(frame_get_width), nullptr, nullptr, nullptr},
+    {"height", reinterpret_cast<getter>(frame_get_height), nullptr, nullptr, nullptr},
+    {"encoding", reinterpret_cast<getter>(frame_get_encoding), nullptr, nullptr, nullptr},
+    {"sequence", reinterpret_cast<getter>(frame_get_sequence), nullptr, nullptr, nullptr},
+    {"timestamp", reinterpret_cast<getter>(frame_get_timestamp), nullptr, "Capture time, see clock_now()", nullptr},
+    {"stale", reinterpret_cast<getter>(frame_get_stale), nullptr, nullptr, nullptr},
+    {"keyframe", reinterpret_cast<getter>(frame_get_keyframe), nullptr, "False for H264 frames which depend on the ones before", nullptr},
+    {"top_down", reinterpret_cast<getter>(frame_get_top_down), nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyBufferProcs FRAME_BUFFER =
+{
+    reinterpret_cast<getbufferproc>(frame_getbuffer),
+    reinterpret_cast<releasebufferproc>(frame_releasebuffer),
+};
+
+// Buffer
+
+void buffer_dealloc(BufferObject* self)
+{
+    // A locked frame references the buffer, there is none left here
+    delete self->buffer;
+    self->buffer = nullptr;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+PyObject* buffer_lock(BufferObject* self, PyObject*)
+{
+    if(!check_open(self))
+    {
+        return nullptr;
+    }
+
+    if(self->frame != nullptr)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "the last frame is still locked");
+        return nullptr;
+    }
+
+    FrameObject* frame = PyObject_New(FrameObject, &FrameType);
+    if(frame == nullptr)
+    {
+        return nullptr;
+    }
+
+    frame->owner = nullptr;
+    frame->locked = false;
+    frame->exports = 0;
+
+    // Waits for the next frame
+    cdi::IBuffer* buffer = self->buffer;
+    const void* data = nullptr;
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    data = buffer->lock();
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+
+    if(data == nullptr)
+    {
+        buffer->unlock();
+        Py_DECREF(frame);
+        PyErr_SetString(PyExc_RuntimeError, "no frame");
+        return nullptr;
+    }
+
+    const cdi::FrameInfo info = buffer->info();
+    frame->level = buffer->level(0);
+    frame->sequence = info.sequence;
+    frame->timestamp = info.timestamp;
+    frame->stale = info.stale;
+    frame->keyframe = info.keyframe;
+    describe(frame);
+
+    Py_INCREF(self);
+    frame->owner = self;
+    frame->locked = true;
+    self->frame = frame;
+
+    return reinterpret_cast<PyObject*>(frame);
+}
+
+PyObject* buffer_read_into(BufferObject* self, PyObject* args)
+{
+    PyObject* target = nullptr;
+    Py_ssize_t stride = 0;
+    if(!PyArg_ParseTuple(args, "O|n", &target, &stride) || !check_open(self))
+    {
+        return nullptr;
+    }
+
+    if(self->frame != nullptr)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "read_into() needs the frame to be unlocked");
+        return nullptr;
+    }
+
+    Py_buffer view;
+    if(PyObject_GetBuffer(target, &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) != 0)
+    {
+        return nullptr;
+    }
+
+    cdi::IBuffer* buffer = self->buffer;
+    const Py_ssize_t row = row_bytes(buffer->encoding(), buffer->width());
+    if(stride == 0)
+    {
+        stride = row;
+    }
+
+    // The rows of all planes scale with the stride of the first one
+    const Py_ssize_t needed = static_cast<Py_ssize_t>(buffer->size()) / row * stride;
+    if(stride < row || view.len < needed)
+    {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "target of %zd bytes with stride %zd is too small, %zd bytes needed", view.len, stride, needed);
+        return nullptr;
+    }
+
+    bool result = false;
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    result = buffer->read_into(view.buf, static_cast<size_t>(stride));
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+
+    PyBuffer_Release(&view);
+    return PyBool_FromLong(result);
+}
+
+PyObject* buffer_close(BufferObject* self, PyObject*)
+{
+    if(self->frame != nullptr)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "cannot close while a frame is locked");
+        return nullptr;
+    }
+
+    if(self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "buffer is in use by another thread");
+        return nullptr;
+    }
+
+    // Stops the stream, which may wait for the capture thread
+    cdi::IBuffer* buffer = self->buffer;
+    self->buffer = nullptr;
+    Py_BEGIN_ALLOW_THREADS
+    delete buffer;
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+PyObject* buffer_enter(BufferObject* self, PyObject*)
+{
+    Py_INCREF(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+PyObject* buffer_exit(BufferObject* self, PyObject*)
+{
+    PyObject* result = buffer_close(self, nullptr);
+    if(result == nullptr)
+    {
+        return nullptr;
+    }
+
+    Py_DECREF(result);
+    Py_RETURN_FALSE;
+}
+
+PyObject* buffer_get_width(BufferObject* self, void*)
+{
+    return check_open(self) ? PyLong_FromUnsignedLong(self->buffer->width()) : nullptr;
+}
+
+PyObject* buffer_get_height(BufferObject* self, void*)
+{
+    return check_open(self) ? PyLong_FromUnsignedLong(self->buffer->height()) : nullptr;
+}
+
+PyObject* buffer_get_encoding(BufferObject* self, void*)
+{
+    return check_open(self) ? PyLong_FromLong(static_cast<long>(self->buffer->encoding())) : nullptr;
+}
+
+PyObject* buffer_get_size(BufferObject* self, void*)
+{
+    return check_open(self) ? PyLong_FromSize_t(self->buffer->size()) : nullptr;
+}
+
+PyMethodDef BUFFER_METHODS[] =
+{
+    {"lock", reinterpret_cast<PyCFunction>(buffer_lock), METH_NOARGS,
+     "Waits for the next frame and returns it locked, without copying it."},
+    {"read_into", reinterpret_cast<PyCFunction>(buffer_read_into), METH_VARARGS,
+     "read_into(target, stride=0): converts the next frame into a writable buffer, planes follow "
+     "each other with rows 'stride' bytes apart (the row length when 0)."},
+    {"close", reinterpret_cast<PyCFunction>(buffer_close), METH_NOARGS, "Stops the stream."},
+    {"__enter__", reinterpret_cast<PyCFunction>(buffer_enter), METH_NOARGS, nullptr},
+    {"__exit__", reinterpret_cast<PyCFunction>(buffer_exit), METH_VARARGS, nullptr},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef BUFFER_GETSET[] =
+{
+    {"width", reinterpret_cast<getter>(buffer_get_width), nullptr, nullptr, nullptr},
+    {"height", reinterpret_cast<getter>(buffer_get_height), nullptr, nullptr, nullptr},
+    {"encoding", reinterpret_cast<getter>(buffer_get_encoding), nullptr, nullptr, nullptr},
+    {"size", reinterpret_cast<getter>(buffer_get_size), nullptr, "Bytes of a frame", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyTypeObject BufferType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+PyTypeObject FrameType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+// Module
+
+PyObject* string_from(const std::wstring& text)
+{
+    return PyUnicode_FromWideChar(text.c_str(), static_cast<Py_ssize_t>(text.size()));
+}
+
+PyObject* list_devices(PyObject*, PyObject*)
+{
+    std::vector<std::wstring> names;
+    Py_BEGIN_ALLOW_THREADS
+    names = cdi::list_devices();
+    Py_END_ALLOW_THREADS
+
+    PyObject* result = PyList_New(static_cast<Py_ssize_t>(names.size()));
+    for(size_t i = 0; result != nullptr && i < names.size(); i++)
+    {
+        PyObject* name = string_from(names[i]);
+        if(name == nullptr)
+        {
+            Py_CLEAR(result);
+            break;
+        }
+
+        PyList_SET_ITEM(result, static_cast<Py_ssize_t>(i), name);
+    }
+
+    return result;
+}
+
+PyObject* get_resolutions(PyObject*, PyObject* args)
+{
+    unsigned int index = 0;
+    if(!PyArg_ParseTuple(args, "I", &index))
+    {
+        return nullptr;
+    }
+
+    std::vector<cdi::Resolution> resolutions;
+    Py_BEGIN_ALLOW_THREADS
+    resolutions = cdi::get_resolutions(index);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result = PyList_New(static_cast<Py_ssize_t>(resolutions.size()));
+    for(size_t i = 0; result != nullptr && i < resolutions.size(); i++)
+    {
+        PyObject* item = Py_BuildValue("(II)", resolutions[i].width, resolutions[i].height);
+        if(item == nullptr)
+        {
+            Py_CLEAR(result);
+            break;
+        }
+
+        PyList_SET_ITEM(result, static_cast<Py_ssize_t>(i), item);
+    }
+
+    return result;
+}
+
+PyObject* open_device(PyObject*, PyObject* args, PyObject* kwargs)
+{
+    static const char* keywords[] = {"index", "width", "height", "encoding", "asynchronous", "top_down", nullptr};
+    unsigned int index = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    int encoding = static_cast<int>(cdi::Encoding::RGB24);
+    int asynchronous = 0;
+    int top_down = 0;
+    if(!PyArg_ParseTupleAndKeywords(
+        args, kwargs, "III|ipp", const_cast<char**>(keywords),
+        &index, &width, &height, &encoding, &asynchronous, &top_down))
+    {
+        return nullptr;
+    }
+
+    if(encoding <= static_cast<int>(cdi::Encoding::UNKNOWN) || encoding > static_cast<int>(cdi::Encoding::H264))
+    {
+        PyErr_SetString(PyExc_ValueError, "unknown encoding");
+        return nullptr;
+    }
+
+    cdi::StreamOptions options;
+    options.asynchronous = asynchronous != 0;
+    options.orientation.top_down = top_down != 0;
+
+    // Activation and the first read take a while
+    std::unique_ptr<cdi::IBuffer> buffer;
+    Py_BEGIN_ALLOW_THREADS
+    buffer = cdi::open_device(index, width, height, static_cast<cdi::Encoding>(encoding), options);
+    Py_END_ALLOW_THREADS
+
+    if(!buffer)
+    {
+        PyErr_Format(PyExc_RuntimeError, "cannot open device %u", index);
+        return nullptr;
+    }
+
+    BufferObject* self = PyObject_New(BufferObject, &BufferType);
+    if(self == nullptr)
+    {
+        return nullptr;
+    }
+
+    self->buffer = buffer.release();
+    self->frame = nullptr;
+    self->busy = false;
+    return reinterpret_cast<PyObject*>(self);
+}
+
+PyMethodDef MODULE_METHODS[] =
+{
+    {"list_devices", list_devices, METH_NOARGS, "Names of the video capture devices."},
+    {"get_resolutions", get_resolutions, METH_VARARGS, "get_resolutions(index): (width, height) pairs of a device."},
+    {"open_device", reinterpret_cast<PyCFunction>(open_device), METH_VARARGS | METH_KEYWORDS,
+     "open_device(index, width, height, encoding=RGB24, asynchronous=False, top_down=False): stream of "
+     "the closest available resolution."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef MODULE =
+{
+    PyModuleDef_HEAD_INIT,
+    "cdi",
+    "Camera capture with frames shared through the buffer protocol.",
+    -1,
+    MODULE_METHODS,
+};
+
+}
+
+PyMODINIT_FUNC PyInit_cdi()
+{
+    BufferType.tp_name = "cdi.Buffer";
+    BufferType.tp_basicsize = sizeof(BufferObject);
+    BufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+    BufferType.tp_doc = "Stream of a device, see open_device().";
+    BufferType.tp_dealloc = reinterpret_cast<destructor>(buffer_dealloc);
+    BufferType.tp_methods = BUFFER_METHODS;
+    BufferType.tp_getset = BUFFER_GETSET;
+
+    FrameType.tp_name = "cdi.Frame";
+    FrameType.tp_basicsize = sizeof(FrameObject);
+    FrameType.tp_flags = Py_TPFLAGS_DEFAULT;
+    FrameType.tp_doc = "Locked frame, supports the buffer protocol.";
+    FrameType.tp_dealloc = reinterpret_cast<destructor>(frame_dealloc);
+    FrameType.tp_methods = FRAME_METHODS;
+    FrameType.tp_getset = FRAME_GETSET;
+    FrameType.tp_as_buffer = &FRAME_BUFFER;
+
+    if(PyType_Ready(&BufferType) < 0 || PyType_Ready(&FrameType) < 0)
+    {
+        return nullptr;
+    }
+
+    PyObject* module = PyModule_Create(&MODULE);
+    if(module == nullptr)
+    {
+        return nullptr;
+    }
+
+    const struct
+    {
+        const char* name;
+        cdi::Encoding encoding;
+    } encodings[] =
+    {
+        {"I420", cdi::Encoding::I420},
+        {"RGB24", cdi::Encoding::RGB24},
+        {"RGBA32", cdi::Encoding::RGBA32},
+        {"P010", cdi::Encoding::P010},
+        {"P016", cdi::Encoding::P016},
+        {"Y210", cdi::Encoding::Y210},
+        {"GRAY16", cdi::Encoding::GRAY16},
+        {"MJPEG", cdi::Encoding::MJPEG},
+        {"H264", cdi::Encoding::H264},
+    };
+
+    for(const auto& entry : encodings)
+    {
+        if(PyModule_AddIntConstant(module, entry.name, static_cast<long>(entry.encoding)) != 0)
+        {
+            Py_DECREF(module);
+            return nullptr;
+        }
+    }
+
+    Py_INCREF(&BufferType);
+    Py_INCREF(&FrameType);
+    PyModule_AddObject(module, "Buffer", reinterpret_cast<PyObject*>(&BufferType));
+    PyModule_AddObject(module, "Frame", reinterpret_cast<PyObject*>(&FrameType));
+
+    return module;
+}
@@ -0,0 +1,47 @@
+# Builds the cdi extension module from the library sources, the library is linked into it:
+#   python setup.py build_ext --inplace
+# Media Foundation is Windows only. Elsewhere CDI_SDK_DIR names a stand-in for the Windows SDK,
+# headers and sources, such as tests/sdk which the tests build the module against.
+
+import glob
+import os
+import sys
+
+from setuptools import Extension, setup
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+SOURCE = os.path.join(ROOT, "..", "src")
+INCLUDE = os.path.join(ROOT, "..", "include")
+
+sources = [os.path.join(ROOT, "cdi_module.cpp")] + sorted(glob.glob(os.path.join(SOURCE, "*.cpp")))
+include_dirs = [INCLUDE, SOURCE]
+libraries = []
+compile_args = []
+
+if os.name == "nt":
+    libraries = ["mf", "mfplat", "mfreadwrite", "mfuuid", "wmcodecdspuuid", "ole32", "psapi", "winmm"]
+    compile_args = ["/EHsc", "/D_WIN32_WINNT=0x0600"]
+else:
+    sdk = os.environ.get("CDI_SDK_DIR")
+    if not sdk:
+        sys.exit("Media Foundation is Windows only, set CDI_SDK_DIR to a stand-in such as tests/sdk")
+    sources += sorted(glob.glob(os.path.join(sdk, "*.cpp")))
+    include_dirs.append(sdk)
+    compile_args = ["-std=c++14", "-O2", "-msse2"]
+
+setup(
+    name="cdi",
+    version="1.0",
+    description="Camera capture with frames shared through the buffer protocol",
+    ext_modules=[
+        Extension(
+            "cdi",
+            sources=sources,
+            include_dirs=include_dirs,
+            libraries=libraries,
+            # The library is part of the module, nothing is imported from a DLL
+            define_macros=[("CDI_DLL_EXPORT", "")],
+            extra_compile_args=compile_args,
+        )
+    ],
+)
@@ -34,75 +34,235 @@
 #include "Buffer.h"
 #include "DevicePool.h"
 #include "Device.h"
+#include "Session.h"
+#include "Trace.h"
+#include "FrameLayout.h"
+#include "VideoFormats.h"
+#include "ScopeGuard.inl"
+#include "Macros.inl"
+
+#include <algorithm>
 
 
 namespace cdi
 {
 
+namespace {
+
+// Closest matching resolution
+DevicePool::Format select_format(
+    const std::vector<DevicePool::Format>& formats,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding)
+{
+    DevicePool::Format selected_format;
+    uint32_t selected_quare_delta = std::numeric_limits<uint32_t>::max();
+    const int32_t requestedLen2 = static_cast<int32_t>(width*width + height*height);
+    const bool want_wide = FrameLayout::is_wide(encoding);
+    GUID compressed = GUID_NULL;
+    const bool want_compressed = compressed_subtype(encoding, compressed);
+    bool selected_wide = false;
+    bool selected_bayer = false;
+
+    for (const DevicePool::Format& fmt : formats)
+    {
+        // Compressed output is the payload of the device, only formats of that kind deliver it
+        if(want_compressed && fmt.format != compressed)
+        {
+            continue;
+        }
+
+        const int32_t currLen2 = static_cast<int32_t>(fmt.width*fmt.width + fmt.height*fmt.height);
+        const uint32_t curr_square_delta = std::abs(requestedLen2 - currLen2);
+        Encoding native = Encoding::UNKNOWN;
+        BayerFormat raw;
+        const bool bayer = bayer_format(fmt.format, raw);
+        const bool wide = want_wide && (wide_encoding(fmt.format, native) || (bayer && raw.bits > 8));
+
+        bool select = false;
+        if(curr_square_delta < selected_quare_delta)
+        {
+            select = true;
+        }
+        else if(curr_square_delta == selected_quare_delta)
+        {
+            // High bit depth output needs a high bit depth format, otherwise
+            // prefer uncompressed format over compressed and both over raw Bayer
+            select = wide
+                || (!selected_wide && !bayer
+                    && (selected_bayer || fmt.format_translation.find("RGB") == std::string::npos));
+        }
+
+        if(select)
+        {
+            selected_format = fmt;
+            selected_quare_delta = curr_square_delta;
+            selected_wide = wide;
+            selected_bayer = bayer;
+        }
+    }
+
+    return selected_format;
+}
+
+// Relative cost of converting a native format, lowest first
+uint32_t conversion_cost(const GUID& format)
+{
+    Encoding wide = Encoding::UNKNOWN;
+    BayerFormat bayer;
+    if(format == MFVideoFormat_NV12 || format == MFVideoFormat_YUY2 || format == MFVideoFormat_I420
+       || format == MFVideoFormat_IYUV || format == MFVideoFormat_YV12)
+    {
+        // Conversion kernels of our own
+        return 0;
+    }
+
+    if(format == MFVideoFormat_UYVY || format == MFVideoFormat_YVYU || format == MFVideoFormat_RGB24
+       || format == MFVideoFormat_RGB32 || format == MFVideoFormat_ARGB32)
+    {
+        return 1;
+    }
+
+    if(wide_encoding(format, wide))
+    {
+        return 2;
+    }
+
+    if(bayer_format(format, bayer))
+    {
+        return 3;
+    }
+
+    // Compressed, a decoder runs first
+    return 4;
+}
+
+}
+
 Buffer::Buffer()
-    : m_pool(std::make_unique<DevicePool>())
-    , m_device(nullptr)
+    : m_device(nullptr)
+    , m_warm(false)
+    , m_enumerate(0)
+    , m_total(0)
+    , m_opened_encoding(Encoding::UNKNOWN)
+    , m_quality_pending(false)
 {
 }
 
 Buffer::~Buffer()
 {
+    // A session whose source a recovery replaced has nothing left to lend
+    if(m_session && m_device && m_device->source_replaced())
+    {
+        m_session->discard();
+    }
+
+    // The device lets go of the source before the session is lent to the next buffer
+    m_device.reset();
+
+    if(m_session)
+    {
+        m_session->release();
+    }
 }
 
 bool Buffer::init(
     const uint32_t& device_index,
     const uint32_t& width,
     const uint32_t& height,
-    const Encoding& encoding)
+    const Encoding& encoding,
+    const StreamOptions& options)
 {
-    // For now just pick first available device
-    if(m_pool->get_count() > device_index)
-    {
-        m_device = std::make_unique<Device>();
+    const int64_t open_start = clock_now();
 
-        // Select closes matching resolution
-        DevicePool::Format selected_format;
-        uint32_t selected_quare_delta = std::numeric_limits<uint32_t>::max();
-        const std::vector<DevicePool::Format> formats(m_pool->get_formats(device_index));
-        const int32_t requestedLen2 = static_cast<int32_t>(width*width + height*height);
+    m_pool = std::make_shared<DevicePool>();
 
-        for (const DevicePool::Format& fmt : formats)
-        {
-            const int32_t currLen2 = static_cast<int32_t>(fmt.width*fmt.width + fmt.height*fmt.height);
-            const uint32_t curr_square_delta = std::abs(requestedLen2 - currLen2);
+    if(m_pool->get_count() <= device_index)
+    {
+        return false;
+    }
 
-            bool select = false;
-            if(curr_square_delta < selected_quare_delta)
-            {
-                select = true;
-            }
-            else if(curr_square_delta == selected_quare_delta)
-            {
-                // Prefer uncompressed format over compressed
-                select = fmt.format_translation.find("RGB") == std::string::npos;
-            }
+    // The source activated for the enumeration goes on to the device
+    {
+        cdi::util::ScopeGuard guard;
+        IMFMediaSource* source = nullptr;
+        guard += [&source]() { SAFE_RELEASE(source); };
 
-            if(select)
-            {
-                selected_format = fmt;
-                selected_quare_delta = curr_square_delta;
-            }
-        }
+        m_formats = m_pool->get_formats(device_index, &source);
+        m_enumerate = clock_now() - open_start;
 
-        if(!m_device->init(
-            m_pool->get_device(device_index),
-            selected_format.width,
-            selected_format.height,
-            selected_format.format,
-            encoding))
+        if(!open(m_pool->get_device(device_index), source, false, width, height, encoding, options))
         {
             return false;
         }
     }
 
+    m_total = clock_now() - open_start;
+
     return true;
 }
 
+bool Buffer::init(
+    const std::shared_ptr<Session>& session,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const StreamOptions& options)
+{
+    const int64_t open_start = clock_now();
+
+    m_session = session;
+    m_formats = session->formats();
+
+    // The first buffer of a session pays for the activation
+    m_warm = session->warm();
+    m_enumerate = m_warm ? 0 : session->enumerate();
+
+    if(!open(session->device(), session->source(), true, width, height, encoding, options))
+    {
+        return false;
+    }
+
+    m_total = m_enumerate + clock_now() - open_start;
+
+    return true;
+}
+
+bool Buffer::open(
+    IMFActivate* device,
+    IMFMediaSource* source,
+    const bool& keep_source,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const StreamOptions& options)
+{
+    const DevicePool::Format selected_format(select_format(m_formats, width, height, encoding));
+    if(selected_format.width == 0)
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_quality_mutex);
+        m_opened = selected_format;
+        m_current = selected_format;
+        m_opened_encoding = encoding;
+    }
+
+    m_device = std::make_unique<Device>();
+    return m_device->init(
+        device,
+        source,
+        keep_source,
+        selected_format.width,
+        selected_format.height,
+        selected_format.format,
+        encoding,
+        options);
+}
+
 uint32_t Buffer::width() const
 {
     return m_device->width();
@@ -123,16 +283,25 @@ size_t Buffer::size() const
     return m_device->size();
 }
 
+int64_t Buffer::timestamp() const
+{
+    return m_device->timestamp();
+}
+
 const void* Buffer::lock()
 {
     const void* data = nullptr;
 
     if(m_device)
     {
+        apply_quality();
+
+        trace::Scope scope(trace::Name::LOCK, m_device->trace_stream(), 0);
         m_device->sample();
             
         size_t bytes = 0;
         data = m_device->lock(bytes);
+        scope.set_sequence(m_device->sequence());
     }
 
     return data;
@@ -142,8 +311,295 @@ void Buffer::unlock()
 {
     if (m_device)
     {
+        trace::Scope scope(trace::Name::UNLOCK, m_device->trace_stream(), m_device->sequence());
         m_device->unlock();
     }
 }
 
+uint32_t Buffer::level_count() const
+{
+    return m_device ? m_device->level_count() : 0;
+}
+
+FrameLevel Buffer::level(const uint32_t& index) const
+{
+    return m_device ? m_device->level(index) : FrameLevel();
+}
+
+FrameInfo Buffer::info() const
+{
+    return m_device ? m_device->info() : FrameInfo();
+}
+
+bool Buffer::read_into(void* dst, const size_t& stride)
+{
+    if(!m_device)
+    {
+        return false;
+    }
+
+    apply_quality();
+
+    trace::Scope scope(trace::Name::READ_INTO, m_device->trace_stream(), 0);
+    const bool result = m_device->read_into(dst, stride);
+    scope.set_sequence(m_device->sequence());
+    return result;
+}
+
+bool Buffer::read_into(const FramePlane* planes, const uint32_t& plane_count)
+{
+    if(!m_device)
+    {
+        return false;
+    }
+
+    apply_quality();
+
+    trace::Scope scope(trace::Name::READ_INTO, m_device->trace_stream(), 0);
+    const bool result = m_device->read_into(planes, plane_count);
+    scope.set_sequence(m_device->sequence());
+    return result;
+}
+
+bool Buffer::notify_frame(const std::function<void(bool)>& ready)
+{
+    return m_device ? m_device->notify_frame(ready) : false;
+}
+
+void Buffer::cancel_notify()
+{
+    if(m_device)
+    {
+        m_device->cancel_notify();
+    }
+}
+
+OpenTimings Buffer::open_timings() const
+{
+    OpenTimings timings = m_device ? m_device->open_timings() : OpenTimings();
+    timings.enumerate = m_enumerate;
+    timings.total = m_total;
+    timings.warm = m_warm;
+    if(timings.first_frame != 0)
+    {
+        timings.first_frame += m_enumerate;
+    }
+
+    return timings;
+}
+
+RecoveryStatistics Buffer::recovery() const
+{
+    return m_device ? m_device->recovery() : RecoveryStatistics();
+}
+
+ThreadPlacement Buffer::placement() const
+{
+    return m_device ? m_device->placement() : ThreadPlacement();
+}
+
+StreamLoad Buffer::load() const
+{
+    return m_device ? m_device->load() : StreamLoad();
+}
+
+bool Buffer::set_quality(const CaptureQuality& quality)
+{
+    std::lock_guard<std::mutex> lock(m_quality_mutex);
+
+    DevicePool::Format format;
+    if(!m_device || !quality_format(quality, format))
+    {
+        return false;
+    }
+
+    m_quality = quality;
+    m_quality_pending = true;
+    return true;
+}
+
+CaptureQuality Buffer::quality() const
+{
+    std::lock_guard<std::mutex> lock(m_quality_mutex);
+    return m_quality;
+}
+
+size_t Buffer::snapshot_jpeg(const JpegOptions& options, void* dst, const size_t& dst_size)
+{
+    if(!m_device)
+    {
+        return 0;
+    }
+
+    apply_quality();
+
+    trace::Scope scope(trace::Name::SNAPSHOT, m_device->trace_stream(), 0);
+    const size_t bytes = m_device->snapshot_jpeg(options, dst, dst_size);
+    scope.set_sequence(m_device->sequence());
+    return bytes;
+}
+
+bool Buffer::dump(const int64_t& since, const std::wstring& path, std::unique_ptr<ICodec> codec)
+{
+    if(!m_device)
+    {
+        return false;
+    }
+
+    trace::Scope scope(trace::Name::DUMP, m_device->trace_stream(), 0);
+    return m_device->dump(since, path, m_device->encoding(), std::move(codec));
+}
+
+bool Buffer::quality_format(const CaptureQuality& quality, DevicePool::Format& format) const
+{
+    // H.264 frames depend on the ones before, a reduced rate leaves nothing to decode
+    if(quality.frame_divisor == 0 || (quality.frame_divisor > 1 && m_opened_encoding == Encoding::H264))
+    {
+        return false;
+    }
+
+    if(quality.resolution_steps == 0 && !quality.cheap_format)
+    {
+        format = m_opened;
+        return true;
+    }
+
+    // Resolutions below the full one, largest first
+    const uint64_t opened_area = static_cast<uint64_t>(m_opened.width) * m_opened.height;
+    std::vector<Resolution> lower;
+    for(const DevicePool::Format& fmt : m_formats)
+    {
+        const uint64_t area = static_cast<uint64_t>(fmt.width) * fmt.height;
+        const bool known = std::any_of(lower.begin(), lower.end(), [&fmt](const Resolution& resolution)
+        {
+            return resolution.width == fmt.width && resolution.height == fmt.height;
+        });
+
+        if(area < opened_area && !known)
+        {
+            lower.emplace_back(fmt.width, fmt.height);
+        }
+    }
+
+    std::sort(lower.begin(), lower.end(), [](const Resolution& a, const Resolution& b)
+    {
+        return static_cast<uint64_t>(a.width) * a.height > static_cast<uint64_t>(b.width) * b.height;
+    });
+
+    if(quality.resolution_steps > lower.size())
+    {
+        return false;
+    }
+
+    if(quality.resolution_steps == 0)
+    {
+        format = m_opened;
+    }
+    else
+    {
+        const Resolution& target = lower[quality.resolution_steps - 1];
+        format = select_format(m_formats, target.width, target.height, m_opened_encoding);
+    }
+
+    // The format of compressed streams is their output, there is nothing to convert
+    if(quality.cheap_format && !FrameLayout::is_compressed(m_opened_encoding))
+    {
+        for(const DevicePool::Format& fmt : m_formats)
+        {
+            if(fmt.width == format.width && fmt.height == format.height
+               && conversion_cost(fmt.format) < conversion_cost(format.format))
+            {
+                format = fmt;
+            }
+        }
+    }
+
+    return true;
+}
+
+void Buffer::apply_quality()
+{
+    CaptureQuality quality;
+    DevicePool::Format format;
+    DevicePool::Format current;
+    Encoding encoding = Encoding::UNKNOWN;
+    {
+        std::lock_guard<std::mutex> lock(m_quality_mutex);
+        if(!m_quality_pending)
+        {
+            return;
+        }
+
+        m_quality_pending = false;
+        quality = m_quality;
+        current = m_current;
+        encoding = m_opened_encoding;
+        if(!quality_format(quality, format))
+        {
+            m_quality = m_applied;
+            return;
+        }
+    }
+
+    // Only a new format or resolution renegotiates, the frame rate is ours
+    const bool renegotiate = format.width != current.width || format.height != current.height || format.format != current.format;
+    if(renegotiate && !m_device->reconfigure(format.width, format.height, format.format, encoding))
+    {
+        std::lock_guard<std::mutex> lock(m_quality_mutex);
+        if(!m_quality_pending)
+        {
+            m_quality = m_applied;
+        }
+
+        return;
+    }
+
+    m_device->set_frame_divisor(quality.frame_divisor);
+
+    std::lock_guard<std::mutex> lock(m_quality_mutex);
+    m_current = format;
+    m_applied = quality;
+}
+
+Device* Buffer::device() const
+{
+    return m_device.get();
+}
+
+bool Buffer::reconfigure(const uint32_t& width, const uint32_t& height, const Encoding& encoding)
+{
+    const int64_t start = clock_now();
+
+    if(!m_device || encoding == Encoding::UNKNOWN)
+    {
+        return false;
+    }
+
+    // Formats are known since the open, the device keeps its source and reader
+    const DevicePool::Format selected_format(select_format(m_formats, width, height, encoding));
+    if(selected_format.width == 0
+       || !m_device->reconfigure(selected_format.width, selected_format.height, selected_format.format, encoding))
+    {
+        return false;
+    }
+
+    // The new configuration is the full quality
+    m_device->set_frame_divisor(1);
+    {
+        std::lock_guard<std::mutex> lock(m_quality_mutex);
+        m_opened = selected_format;
+        m_current = selected_format;
+        m_opened_encoding = encoding;
+        m_quality = CaptureQuality();
+        m_applied = CaptureQuality();
+        m_quality_pending = false;
+    }
+
+    m_warm = true;
+    m_enumerate = 0;
+    m_total = clock_now() - start;
+
+    return true;
+}
+
 }
\ No newline at end of file
@@ -34,16 +34,19 @@
 
 #define NOMINMAX
 #include "cdi/cdi.h"
+#include "DevicePool.h"
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 
 namespace cdi
 {
 
-class DevicePool;
 class Device;
+class Session;
 
 class Buffer : public IBuffer
 {
@@ -55,17 +58,74 @@ public:
         const uint32_t& device_index,
         const uint32_t& width,
         const uint32_t& height,
-        const Encoding& encoding);
+        const Encoding& encoding,
+        const StreamOptions& options);
+    // Opens the device of a session which has been acquired for this buffer, released again
+    // when the buffer goes
+    bool init(
+        const std::shared_ptr<Session>& session,
+        const uint32_t& width,
+        const uint32_t& height,
+        const Encoding& encoding,
+        const StreamOptions& options);
     uint32_t width() const final;
     uint32_t height() const final;
     Encoding encoding() const final;
     size_t size() const final;
+    int64_t timestamp() const final;
     const void* lock() final;
     void unlock() final;
+    uint32_t level_count() const final;
+    FrameLevel level(const uint32_t& index) const final;
+    FrameInfo info() const final;
+    bool read_into(void* dst, const size_t& stride) final;
+    bool read_into(const FramePlane* planes, const uint32_t& plane_count) final;
+    bool notify_frame(const std::function<void(bool)>& ready) final;
+    void cancel_notify() final;
+    OpenTimings open_timings() const final;
+    bool reconfigure(const uint32_t& width, const uint32_t& height, const Encoding& encoding) final;
+    ThreadPlacement placement() const final;
+    RecoveryStatistics recovery() const final;
+    StreamLoad load() const final;
+    bool set_quality(const CaptureQuality& quality) final;
+    CaptureQuality quality() const final;
+    size_t snapshot_jpeg(const JpegOptions& options, void* dst, const size_t& dst_size) final;
+    bool dump(const int64_t& since, const std::wstring& path, std::unique_ptr<ICodec> codec) final;
+
+    // Device of the buffer, for the streams which share it between consumers
+    Device* device() const;
+
+private:
+    bool open(
+        IMFActivate* device,
+        IMFMediaSource* source,
+        const bool& keep_source,
+        const uint32_t& width,
+        const uint32_t& height,
+        const Encoding& encoding,
+        const StreamOptions& options);
+    // Native format of a quality, false when there is none
+    bool quality_format(const CaptureQuality& quality, DevicePool::Format& format) const;
+    // Switches to the quality asked for last, on the thread of the consumer while unlocked
+    void apply_quality();
 
 private:
-    std::unique_ptr<DevicePool> m_pool;
+    std::shared_ptr<DevicePool> m_pool;
+    std::shared_ptr<Session> m_session;
+    std::vector<DevicePool::Format> m_formats;
     std::unique_ptr<Device> m_device;
+    bool m_warm;
+    int64_t m_enumerate;
+    int64_t m_total;
+
+    // Reduced quality, asked for from any thread and applied by the consumer
+    mutable std::mutex m_quality_mutex;
+    DevicePool::Format m_opened;  // Format of the full quality
+    DevicePool::Format m_current; // Format negotiated with the device
+    Encoding m_opened_encoding;
+    CaptureQuality m_quality;
+    CaptureQuality m_applied;
+    bool m_quality_pending;
 };
 
 }
\ No newline at end of file
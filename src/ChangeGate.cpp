@@ -0,0 +1,199 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ChangeGate.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <emmintrin.h>
+
+
+namespace cdi {
+
+namespace {
+
+uint32_t sum_abs_diff(const uint8_t* a, const uint8_t* b, const uint32_t& count)
+{
+    uint32_t sum = 0;
+    uint32_t i = 0;
+
+    for(; i + 16 <= count; i += 16)
+    {
+        const __m128i sad = _mm_sad_epu8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        sum += static_cast<uint32_t>(_mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4));
+    }
+
+    for(; i < count; i++)
+    {
+        sum += static_cast<uint32_t>(std::abs(static_cast<int32_t>(a[i]) - b[i]));
+    }
+
+    return sum;
+}
+
+}
+
+ChangeGate::ChangeGate()
+    : m_grid_width(0)
+    , m_grid_height(0)
+    , m_tiles_x(0)
+    , m_tiles_y(0)
+    , m_has_reference(false)
+    , m_score(0.0f)
+{
+}
+
+ChangeGate::~ChangeGate()
+{
+}
+
+bool ChangeGate::init(const uint32_t& width, const uint32_t& height, const ChangeGateOptions& options)
+{
+    if(options.grid_step == 0 || options.tile_size == 0)
+    {
+        return false;
+    }
+
+    m_options = options;
+    m_grid_width = std::max(1u, width / options.grid_step);
+    m_grid_height = std::max(1u, height / options.grid_step);
+    m_tiles_x = (m_grid_width + options.tile_size - 1) / options.tile_size;
+    m_tiles_y = (m_grid_height + options.tile_size - 1) / options.tile_size;
+    m_has_reference = false;
+    m_score = 0.0f;
+
+    const size_t cells = static_cast<size_t>(m_grid_width) * m_grid_height;
+    m_current.assign(cells, 0);
+    m_reference.assign(cells, 0);
+    m_tile_sums.assign(static_cast<size_t>(m_tiles_x) * m_tiles_y, 0);
+    m_mask.assign(m_tile_sums.size(), 1);
+
+    return true;
+}
+
+bool ChangeGate::update(const uint8_t* luma, const int32_t& pitch, const uint32_t& step)
+{
+    // Gather the grid
+    const size_t column_step = static_cast<size_t>(m_options.grid_step) * step;
+    const ptrdiff_t row_step = static_cast<ptrdiff_t>(m_options.grid_step) * pitch;
+    for(uint32_t gy = 0; gy < m_grid_height; gy++)
+    {
+        const uint8_t* src = luma + gy * row_step;
+        uint8_t* dst = m_current.data() + static_cast<size_t>(gy) * m_grid_width;
+        for(uint32_t gx = 0; gx < m_grid_width; gx++)
+        {
+            dst[gx] = src[gx * column_step];
+        }
+    }
+
+    if(!m_has_reference)
+    {
+        m_has_reference = true;
+        m_score = 255.0f;
+        std::fill(m_mask.begin(), m_mask.end(), static_cast<uint8_t>(1));
+        m_current.swap(m_reference);
+        return true;
+    }
+
+    // Accumulate absolute differences per tile
+    std::fill(m_tile_sums.begin(), m_tile_sums.end(), 0);
+    uint64_t total = 0;
+    const uint32_t tile = m_options.tile_size;
+    for(uint32_t gy = 0; gy < m_grid_height; gy++)
+    {
+        const uint8_t* cur = m_current.data() + static_cast<size_t>(gy) * m_grid_width;
+        const uint8_t* ref = m_reference.data() + static_cast<size_t>(gy) * m_grid_width;
+        uint32_t* sums = m_tile_sums.data() + static_cast<size_t>(gy / tile) * m_tiles_x;
+
+        for(uint32_t tx = 0; tx < m_tiles_x; tx++)
+        {
+            const uint32_t x = tx * tile;
+            const uint32_t sad = sum_abs_diff(cur + x, ref + x, std::min(tile, m_grid_width - x));
+            sums[tx] += sad;
+            total += sad;
+        }
+    }
+
+    bool changed = false;
+    for(uint32_t ty = 0; ty < m_tiles_y; ty++)
+    {
+        const uint32_t rows = std::min(tile, m_grid_height - ty * tile);
+        for(uint32_t tx = 0; tx < m_tiles_x; tx++)
+        {
+            const uint32_t columns = std::min(tile, m_grid_width - tx * tile);
+            const size_t index = static_cast<size_t>(ty) * m_tiles_x + tx;
+            const bool tile_changed = static_cast<float>(m_tile_sums[index])
+                > m_options.threshold * static_cast<float>(rows * columns);
+            m_mask[index] = tile_changed ? 1 : 0;
+            changed |= tile_changed;
+        }
+    }
+
+    m_score = static_cast<float>(total) / static_cast<float>(m_current.size());
+
+    if(changed)
+    {
+        m_current.swap(m_reference);
+    }
+
+    return changed;
+}
+
+void ChangeGate::accept()
+{
+    m_current.swap(m_reference);
+}
+
+float ChangeGate::score() const
+{
+    return m_score;
+}
+
+uint32_t ChangeGate::tiles_x() const
+{
+    return m_tiles_x;
+}
+
+uint32_t ChangeGate::tiles_y() const
+{
+    return m_tiles_y;
+}
+
+const uint8_t* ChangeGate::mask() const
+{
+    return m_mask.data();
+}
+
+}
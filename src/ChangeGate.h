@@ -0,0 +1,80 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+#include <cstdint>
+#include <vector>
+
+
+namespace cdi {
+
+// Compares a subsampled luma grid against the last frame that was let through and
+// reports which tiles changed. The reference only advances on changed frames, so
+// slow drifts accumulate until they cross the threshold.
+class ChangeGate
+{
+public:
+    ChangeGate();
+    ~ChangeGate();
+
+    bool init(const uint32_t& width, const uint32_t& height, const ChangeGateOptions& options);
+
+    // 'luma' points to the first luma sample of the first row, 'pitch' is the signed
+    // distance between rows and 'step' the distance between luma samples in bytes.
+    // Returns true if any tile changed.
+    bool update(const uint8_t* luma, const int32_t& pitch, const uint32_t& step);
+
+    // Makes an unchanged frame the reference, for frames delivered regardless
+    void accept();
+
+    float score() const;
+    uint32_t tiles_x() const;
+    uint32_t tiles_y() const;
+    const uint8_t* mask() const;
+
+private:
+    ChangeGateOptions m_options;
+    uint32_t m_grid_width;
+    uint32_t m_grid_height;
+    uint32_t m_tiles_x;
+    uint32_t m_tiles_y;
+    bool m_has_reference;
+    float m_score;
+    std::vector<uint8_t> m_current;
+    std::vector<uint8_t> m_reference;
+    std::vector<uint32_t> m_tile_sums;
+    std::vector<uint8_t> m_mask;
+};
+
+}
@@ -0,0 +1,73 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "Clock.h"
+
+#include <windows.h>
+
+
+namespace cdi {
+
+namespace {
+
+int64_t frequency()
+{
+    static const int64_t value = []()
+    {
+        LARGE_INTEGER frequency = {};
+        QueryPerformanceFrequency(&frequency);
+        return frequency.QuadPart;
+    }();
+    return value;
+}
+
+}
+
+int64_t clock_now()
+{
+    LARGE_INTEGER counter = {};
+    QueryPerformanceCounter(&counter);
+
+    // Split to avoid overflowing the multiplication
+    const int64_t ticks = counter.QuadPart;
+    const int64_t freq = frequency();
+    return (ticks / freq) * 10000000 + ((ticks % freq) * 10000000) / freq;
+}
+
+int64_t clock_from_device(const uint64_t& device_timestamp)
+{
+    // Device timestamps already use the performance counter in 100ns units
+    return static_cast<int64_t>(device_timestamp);
+}
+
+}
@@ -0,0 +1,696 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ColorKernels.h"
+#include "FrameLayout.h"
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+
+namespace cdi { namespace kernels {
+
+namespace {
+
+// 16 bit fixed point
+struct Coefficients
+{
+    int32_t y_offset;
+    int32_t y_scale;
+    int32_t v_to_r;
+    int32_t u_to_g;
+    int32_t v_to_g;
+    int32_t u_to_b;
+
+    int32_t r_to_y;
+    int32_t g_to_y;
+    int32_t b_to_y;
+    int32_t r_to_u;
+    int32_t g_to_u;
+    int32_t b_to_u;
+    int32_t r_to_v;
+    int32_t g_to_v;
+    int32_t b_to_v;
+};
+
+const int32_t ROUND = 1 << 15;
+
+constexpr int32_t fixed(const double value)
+{
+    return static_cast<int32_t>(value * 65536.0 + (value < 0.0 ? -0.5 : 0.5));
+}
+
+// From the luma weights of red and blue, limited range scales luma to 219 and chroma to 224 steps
+constexpr Coefficients make_coefficients(const double kr, const double kb, const bool full)
+{
+    const double kg = 1.0 - kr - kb;
+    const double ys = full ? 1.0 : 255.0 / 219.0;
+    const double cs = full ? 1.0 : 255.0 / 224.0;
+
+    return Coefficients{
+        full ? 0 : 16,
+        fixed(ys),
+        fixed(cs * 2.0 * (1.0 - kr)),
+        fixed(cs * 2.0 * (1.0 - kb) * kb / kg),
+        fixed(cs * 2.0 * (1.0 - kr) * kr / kg),
+        fixed(cs * 2.0 * (1.0 - kb)),
+
+        fixed(kr / ys),
+        fixed(kg / ys),
+        fixed(kb / ys),
+        fixed(-kr / (2.0 * (1.0 - kb)) / cs),
+        fixed(-kg / (2.0 * (1.0 - kb)) / cs),
+        fixed(0.5 / cs),
+        fixed(0.5 / cs),
+        fixed(-kg / (2.0 * (1.0 - kr)) / cs),
+        fixed(-kb / (2.0 * (1.0 - kr)) / cs)};
+}
+
+template<ColorMatrix M, ColorRange R>
+constexpr Coefficients coefficients()
+{
+    return M == ColorMatrix::BT709 ? make_coefficients(0.2126, 0.0722, R == ColorRange::FULL)
+         : M == ColorMatrix::BT2020 ? make_coefficients(0.2627, 0.0593, R == ColorRange::FULL)
+         : make_coefficients(0.299, 0.114, R == ColorRange::FULL);
+}
+
+template<Encoding E>
+struct RgbTraits
+{
+    static const uint32_t bytes_per_pixel = E == Encoding::RGBA32 ? 4 : 3;
+};
+
+// Where the samples of a row live relative to the plane pointers
+template<YuvFormat F>
+struct YuvTraits;
+
+template<>
+struct YuvTraits<YuvFormat::I420>
+{
+    static const uint32_t luma_step = 1;
+    static const uint32_t chroma_step = 1;
+    static const uint32_t chroma_rows = 2;
+};
+
+template<>
+struct YuvTraits<YuvFormat::NV12>
+{
+    static const uint32_t luma_step = 1;
+    static const uint32_t chroma_step = 2;
+    static const uint32_t chroma_rows = 2;
+};
+
+template<>
+struct YuvTraits<YuvFormat::YUY2>
+{
+    static const uint32_t luma_step = 2;
+    static const uint32_t chroma_step = 4;
+    static const uint32_t chroma_rows = 1;
+};
+
+struct YuvPlanes
+{
+    const uint8_t* y;
+    const uint8_t* u;
+    const uint8_t* v;
+    int32_t chroma_pitch;
+};
+
+YuvPlanes yuv_planes(const YuvFormat& format, const uint8_t* src, const int32_t& pitch, const uint32_t& height)
+{
+    YuvPlanes planes;
+    planes.y = src;
+
+    switch(format)
+    {
+    case YuvFormat::I420:
+        planes.chroma_pitch = pitch / 2;
+        planes.u = src + static_cast<ptrdiff_t>(pitch) * height;
+        planes.v = planes.u + static_cast<ptrdiff_t>(planes.chroma_pitch) * (height / 2);
+        break;
+    case YuvFormat::NV12:
+        planes.chroma_pitch = pitch;
+        planes.u = src + static_cast<ptrdiff_t>(pitch) * height;
+        planes.v = planes.u + 1;
+        break;
+    case YuvFormat::YUY2:
+    default:
+        planes.chroma_pitch = pitch;
+        planes.u = src + 1;
+        planes.v = src + 3;
+        break;
+    }
+
+    return planes;
+}
+
+uint8_t clamp8(const int32_t& value)
+{
+    return static_cast<uint8_t>(std::min(255, std::max(0, value)));
+}
+
+// Statistics of a luma row the kernel just read, the row above is still in the cache
+template<YuvFormat F>
+void accumulate(FrameStats* stats, const uint8_t* luma, const int32_t& pitch, const uint32_t& row, const uint32_t& width)
+{
+    const uint32_t luma_step = YuvTraits<F>::luma_step;
+    if(stats != nullptr)
+    {
+        stats->accumulate_row(luma, row > 0 ? luma - pitch : nullptr, width, luma_step);
+    }
+}
+
+template<YuvFormat F, Encoding D, ColorMatrix M, ColorRange R>
+void yuv_to_rgb_row(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, const uint32_t& width)
+{
+    constexpr Coefficients k = coefficients<M, R>();
+    const uint32_t luma_step = YuvTraits<F>::luma_step;
+    const uint32_t chroma_step = YuvTraits<F>::chroma_step;
+    const uint32_t bpp = RgbTraits<D>::bytes_per_pixel;
+
+    // Pixel pairs share their chroma, an odd last pixel reuses the pair before it
+    const uint32_t chroma_last = width > 1 ? (width >> 1) - 1 : 0;
+    for(uint32_t x = 0; x < width; x++)
+    {
+        const uint32_t c = std::min(x >> 1, chroma_last) * chroma_step;
+        const int32_t luma = (y[x * luma_step] - k.y_offset) * k.y_scale + ROUND;
+        const int32_t cb = u[c] - 128;
+        const int32_t cr = v[c] - 128;
+
+        uint8_t* pixel = dst + x * bpp;
+        pixel[0] = clamp8((luma + k.u_to_b * cb) >> 16);
+        pixel[1] = clamp8((luma - k.u_to_g * cb - k.v_to_g * cr) >> 16);
+        pixel[2] = clamp8((luma + k.v_to_r * cr) >> 16);
+        if(bpp == 4)
+        {
+            pixel[3] = 0xFF;
+        }
+    }
+}
+
+template<YuvFormat F, Encoding D, ColorMatrix M, ColorRange R>
+void yuv_to_rgb(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    FrameStats* stats)
+{
+    const YuvPlanes planes = yuv_planes(F, src, src_pitch, height);
+    const uint32_t chroma_rows = YuvTraits<F>::chroma_rows;
+    const uint32_t chroma_last = height >= chroma_rows ? height / chroma_rows - 1 : 0;
+
+    for(uint32_t row = 0; row < height; row++)
+    {
+        const uint32_t chroma_row = std::min(row / chroma_rows, chroma_last);
+        const ptrdiff_t chroma_offset = static_cast<ptrdiff_t>(chroma_row) * planes.chroma_pitch;
+        const uint8_t* luma = planes.y + static_cast<ptrdiff_t>(row) * src_pitch;
+        yuv_to_rgb_row<F, D, M, R>(
+            luma,
+            planes.u + chroma_offset,
+            planes.v + chroma_offset,
+            dst + static_cast<ptrdiff_t>(row) * dst_pitch,
+            width);
+        accumulate<F>(stats, luma, src_pitch, row, width);
+    }
+}
+
+template<YuvFormat F, Encoding D, ColorMatrix M, ColorRange R>
+void oriented_yuv_to_rgb(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    const PixelMap* planes,
+    const uint32_t& width,
+    const uint32_t& height,
+    uint8_t* band,
+    FrameStats* stats)
+{
+    const YuvPlanes yuv = yuv_planes(F, src, src_pitch, height);
+    const uint32_t chroma_rows = YuvTraits<F>::chroma_rows;
+    const uint32_t chroma_last = height >= chroma_rows ? height / chroma_rows - 1 : 0;
+    const uint32_t bpp = RgbTraits<D>::bytes_per_pixel;
+    const size_t band_pitch = static_cast<size_t>(width) * bpp;
+
+    for(uint32_t y0 = 0; y0 < height; y0 += BAND_ROWS)
+    {
+        const uint32_t rows = std::min(BAND_ROWS, height - y0);
+        for(uint32_t i = 0; i < rows; i++)
+        {
+            const uint32_t row = y0 + i;
+            const uint32_t chroma_row = std::min(row / chroma_rows, chroma_last);
+            const ptrdiff_t chroma_offset = static_cast<ptrdiff_t>(chroma_row) * yuv.chroma_pitch;
+            const uint8_t* luma = yuv.y + static_cast<ptrdiff_t>(row) * src_pitch;
+            yuv_to_rgb_row<F, D, M, R>(
+                luma,
+                yuv.u + chroma_offset,
+                yuv.v + chroma_offset,
+                band + band_pitch * i,
+                width);
+            accumulate<F>(stats, luma, src_pitch, row, width);
+        }
+
+        write_band(band, band_pitch, width, rows, y0, planes[0], bpp);
+    }
+}
+
+// Planes which are stored as they are go out straight from the source, the others
+// are gathered into the band first
+template<YuvFormat F>
+void oriented_yuv_to_i420(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    const PixelMap* planes,
+    const uint32_t& width,
+    const uint32_t& height,
+    uint8_t* band,
+    FrameStats* stats)
+{
+    const YuvPlanes yuv = yuv_planes(F, src, src_pitch, height);
+    const uint32_t chroma_width = width >> 1;
+    const uint32_t chroma_height = height >> 1;
+
+    for(uint32_t y0 = 0; y0 < height; y0 += BAND_ROWS)
+    {
+        const uint32_t rows = std::min(BAND_ROWS, height - y0);
+        const uint8_t* luma = yuv.y + static_cast<ptrdiff_t>(y0) * src_pitch;
+        if(F == YuvFormat::YUY2)
+        {
+            for(uint32_t i = 0; i < rows; i++)
+            {
+                const uint8_t* in = luma + static_cast<ptrdiff_t>(i) * src_pitch;
+                uint8_t* out = band + static_cast<size_t>(width) * i;
+                for(uint32_t x = 0; x < width; x++)
+                {
+                    out[x] = in[x * 2];
+                }
+                accumulate<F>(stats, in, src_pitch, y0 + i, width);
+            }
+
+            write_band(band, width, width, rows, y0, planes[0], 1);
+        }
+        else
+        {
+            write_band(luma, static_cast<size_t>(src_pitch), width, rows, y0, planes[0], 1);
+            for(uint32_t i = 0; i < rows; i++)
+            {
+                accumulate<F>(stats, luma + static_cast<ptrdiff_t>(i) * src_pitch, src_pitch, y0 + i, width);
+            }
+        }
+    }
+
+    uint8_t* band_u = band;
+    uint8_t* band_v = band + static_cast<size_t>(chroma_width) * BAND_ROWS;
+    for(uint32_t c0 = 0; c0 < chroma_height; c0 += BAND_ROWS)
+    {
+        const uint32_t rows = std::min(BAND_ROWS, chroma_height - c0);
+        if(F == YuvFormat::I420)
+        {
+            const ptrdiff_t offset = static_cast<ptrdiff_t>(c0) * yuv.chroma_pitch;
+            write_band(yuv.u + offset, static_cast<size_t>(yuv.chroma_pitch), chroma_width, rows, c0, planes[1], 1);
+            write_band(yuv.v + offset, static_cast<size_t>(yuv.chroma_pitch), chroma_width, rows, c0, planes[2], 1);
+            continue;
+        }
+
+        for(uint32_t i = 0; i < rows; i++)
+        {
+            uint8_t* out_u = band_u + static_cast<size_t>(chroma_width) * i;
+            uint8_t* out_v = band_v + static_cast<size_t>(chroma_width) * i;
+            if(F == YuvFormat::NV12)
+            {
+                const ptrdiff_t offset = static_cast<ptrdiff_t>(c0 + i) * yuv.chroma_pitch;
+                for(uint32_t x = 0; x < chroma_width; x++)
+                {
+                    out_u[x] = yuv.u[offset + x * 2];
+                    out_v[x] = yuv.v[offset + x * 2];
+                }
+            }
+            else
+            {
+                // 4:2:2 to 4:2:0, the two rows of a chroma row are averaged
+                const ptrdiff_t top = static_cast<ptrdiff_t>(2 * (c0 + i)) * yuv.chroma_pitch;
+                const ptrdiff_t bottom = top + yuv.chroma_pitch;
+                for(uint32_t x = 0; x < chroma_width; x++)
+                {
+                    out_u[x] = static_cast<uint8_t>((yuv.u[top + x * 4] + yuv.u[bottom + x * 4] + 1) >> 1);
+                    out_v[x] = static_cast<uint8_t>((yuv.v[top + x * 4] + yuv.v[bottom + x * 4] + 1) >> 1);
+                }
+            }
+        }
+
+        write_band(band_u, chroma_width, chroma_width, rows, c0, planes[1], 1);
+        write_band(band_v, chroma_width, chroma_width, rows, c0, planes[2], 1);
+    }
+}
+
+template<ColorMatrix M, ColorRange R>
+uint8_t luma(const uint8_t* bgr)
+{
+    constexpr Coefficients k = coefficients<M, R>();
+    return clamp8(((k.r_to_y * bgr[2] + k.g_to_y * bgr[1] + k.b_to_y * bgr[0] + ROUND) >> 16) + k.y_offset);
+}
+
+template<Encoding S, ColorMatrix M, ColorRange R>
+void rgb_to_i420_rows(
+    const uint8_t* rgb0,
+    const uint8_t* rgb1,
+    uint8_t* y0,
+    uint8_t* y1,
+    uint8_t* u,
+    uint8_t* v,
+    const uint32_t& width)
+{
+    constexpr Coefficients k = coefficients<M, R>();
+    const uint32_t bpp = RgbTraits<S>::bytes_per_pixel;
+
+    for(uint32_t x = 0; x < width; x++)
+    {
+        y0[x] = luma<M, R>(rgb0 + x * bpp);
+    }
+
+    if(y1 != nullptr)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            y1[x] = luma<M, R>(rgb1 + x * bpp);
+        }
+    }
+
+    if(u == nullptr || v == nullptr)
+    {
+        return;
+    }
+
+    // Chroma from the average of each 2x2 block
+    for(uint32_t c = 0; c < (width >> 1); c++)
+    {
+        const uint8_t* p00 = rgb0 + (c * 2) * bpp;
+        const uint8_t* p01 = p00 + bpp;
+        const uint8_t* p10 = rgb1 + (c * 2) * bpp;
+        const uint8_t* p11 = p10 + bpp;
+
+        const int32_t b = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+        const int32_t g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+        const int32_t r = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+
+        u[c] = clamp8(((k.r_to_u * r + k.g_to_u * g + k.b_to_u * b + ROUND) >> 16) + 128);
+        v[c] = clamp8(((k.r_to_v * r + k.g_to_v * g + k.b_to_v * b + ROUND) >> 16) + 128);
+    }
+}
+
+// Only the combinations listed here get instantiated
+
+struct YuvToRgbEntry
+{
+    YuvFormat src;
+    Encoding dst;
+    ColorMatrix matrix;
+    ColorRange range;
+    YuvToRgb kernel;
+};
+
+struct OrientedYuvEntry
+{
+    YuvFormat src;
+    Encoding dst;
+    ColorMatrix matrix;
+    ColorRange range;
+    OrientedYuv kernel;
+};
+
+struct RgbToI420Entry
+{
+    Encoding src;
+    ColorMatrix matrix;
+    ColorRange range;
+    RgbToI420 kernel;
+};
+
+#define YUV_TO_RGB(F, D, M, R) \
+    {YuvFormat::F, Encoding::D, ColorMatrix::M, ColorRange::R, \
+     &yuv_to_rgb<YuvFormat::F, Encoding::D, ColorMatrix::M, ColorRange::R>}
+
+#define YUV_TO_RGB_ALL(F, D) \
+    YUV_TO_RGB(F, D, BT601, LIMITED), YUV_TO_RGB(F, D, BT601, FULL), \
+    YUV_TO_RGB(F, D, BT709, LIMITED), YUV_TO_RGB(F, D, BT709, FULL), \
+    YUV_TO_RGB(F, D, BT2020, LIMITED), YUV_TO_RGB(F, D, BT2020, FULL)
+
+#define ORIENTED_YUV_TO_RGB(F, D, M, R) \
+    {YuvFormat::F, Encoding::D, ColorMatrix::M, ColorRange::R, \
+     &oriented_yuv_to_rgb<YuvFormat::F, Encoding::D, ColorMatrix::M, ColorRange::R>}
+
+#define ORIENTED_YUV_TO_RGB_ALL(F, D) \
+    ORIENTED_YUV_TO_RGB(F, D, BT601, LIMITED), ORIENTED_YUV_TO_RGB(F, D, BT601, FULL), \
+    ORIENTED_YUV_TO_RGB(F, D, BT709, LIMITED), ORIENTED_YUV_TO_RGB(F, D, BT709, FULL), \
+    ORIENTED_YUV_TO_RGB(F, D, BT2020, LIMITED), ORIENTED_YUV_TO_RGB(F, D, BT2020, FULL)
+
+#define RGB_TO_I420(S, M, R) \
+    {Encoding::S, ColorMatrix::M, ColorRange::R, &rgb_to_i420_rows<Encoding::S, ColorMatrix::M, ColorRange::R>}
+
+#define RGB_TO_I420_ALL(S) \
+    RGB_TO_I420(S, BT601, LIMITED), RGB_TO_I420(S, BT601, FULL), \
+    RGB_TO_I420(S, BT709, LIMITED), RGB_TO_I420(S, BT709, FULL), \
+    RGB_TO_I420(S, BT2020, LIMITED), RGB_TO_I420(S, BT2020, FULL)
+
+const YuvToRgbEntry YUV_TO_RGB_KERNELS[] = {
+    YUV_TO_RGB_ALL(I420, RGB24),
+    YUV_TO_RGB_ALL(I420, RGBA32),
+    YUV_TO_RGB_ALL(NV12, RGB24),
+    YUV_TO_RGB_ALL(NV12, RGBA32),
+    YUV_TO_RGB_ALL(YUY2, RGB24),
+    YUV_TO_RGB_ALL(YUY2, RGBA32),
+};
+
+const OrientedYuvEntry ORIENTED_YUV_KERNELS[] = {
+    ORIENTED_YUV_TO_RGB_ALL(I420, RGB24),
+    ORIENTED_YUV_TO_RGB_ALL(I420, RGBA32),
+    ORIENTED_YUV_TO_RGB_ALL(NV12, RGB24),
+    ORIENTED_YUV_TO_RGB_ALL(NV12, RGBA32),
+    ORIENTED_YUV_TO_RGB_ALL(YUY2, RGB24),
+    ORIENTED_YUV_TO_RGB_ALL(YUY2, RGBA32),
+};
+
+const RgbToI420Entry RGB_TO_I420_KERNELS[] = {
+    RGB_TO_I420_ALL(RGB24),
+    RGB_TO_I420_ALL(RGBA32),
+};
+
+#undef YUV_TO_RGB
+#undef YUV_TO_RGB_ALL
+#undef ORIENTED_YUV_TO_RGB
+#undef ORIENTED_YUV_TO_RGB_ALL
+#undef RGB_TO_I420
+#undef RGB_TO_I420_ALL
+
+ColorMatrix resolve(const ColorMatrix& matrix)
+{
+    return matrix == ColorMatrix::DEFAULT ? ColorMatrix::BT601 : matrix;
+}
+
+uint32_t bytes_per_pixel(const Encoding& encoding)
+{
+    return encoding == Encoding::RGB24 ? 3 : 4;
+}
+
+bool is_rgb(const Encoding& encoding)
+{
+    return encoding == Encoding::RGB24 || encoding == Encoding::RGBA32;
+}
+
+}
+
+YuvToRgb find_yuv_to_rgb(const YuvFormat& src, const Encoding& dst, const ColorSpace& color)
+{
+    const ColorMatrix matrix = resolve(color.matrix);
+    for(const YuvToRgbEntry& entry : YUV_TO_RGB_KERNELS)
+    {
+        if(entry.src == src && entry.dst == dst && entry.matrix == matrix && entry.range == color.range)
+        {
+            return entry.kernel;
+        }
+    }
+
+    return nullptr;
+}
+
+size_t oriented_band_size(const uint32_t& width)
+{
+    return static_cast<size_t>(width) * 4 * BAND_ROWS;
+}
+
+OrientedYuv find_oriented_yuv(const YuvFormat& src, const Encoding& dst, const ColorSpace& color)
+{
+    // Copies and resampling of the planes, matrix and range do not matter
+    if(dst == Encoding::I420)
+    {
+        switch(src)
+        {
+        case YuvFormat::I420:
+            return &oriented_yuv_to_i420<YuvFormat::I420>;
+        case YuvFormat::NV12:
+            return &oriented_yuv_to_i420<YuvFormat::NV12>;
+        case YuvFormat::YUY2:
+            return &oriented_yuv_to_i420<YuvFormat::YUY2>;
+        default:
+            return nullptr;
+        }
+    }
+
+    const ColorMatrix matrix = resolve(color.matrix);
+    for(const OrientedYuvEntry& entry : ORIENTED_YUV_KERNELS)
+    {
+        if(entry.src == src && entry.dst == dst && entry.matrix == matrix && entry.range == color.range)
+        {
+            return entry.kernel;
+        }
+    }
+
+    return nullptr;
+}
+
+RgbToI420 find_rgb_to_i420(const Encoding& src, const ColorSpace& color)
+{
+    const ColorMatrix matrix = resolve(color.matrix);
+    for(const RgbToI420Entry& entry : RGB_TO_I420_KERNELS)
+    {
+        if(entry.src == src && entry.matrix == matrix && entry.range == color.range)
+        {
+            return entry.kernel;
+        }
+    }
+
+    return nullptr;
+}
+
+bool convert_frame(
+    const void* src,
+    const Encoding& src_encoding,
+    void* dst,
+    const Encoding& dst_encoding,
+    const uint32_t& width,
+    const uint32_t& height,
+    const ColorSpace& color,
+    const bool& top_down)
+{
+    FrameLayout src_layout;
+    FrameLayout dst_layout;
+    if(!src_layout.init(width, height, src_encoding) || !dst_layout.init(width, height, dst_encoding))
+    {
+        return false;
+    }
+
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    uint8_t* out = static_cast<uint8_t*>(dst);
+
+    if(src_encoding == dst_encoding)
+    {
+        std::memcpy(out, in, src_layout.size());
+    }
+    else if(src_encoding == Encoding::I420)
+    {
+        const YuvToRgb kernel = find_yuv_to_rgb(YuvFormat::I420, dst_encoding, color);
+        if(kernel == nullptr)
+        {
+            return false;
+        }
+
+        const FrameLayout::Plane& rgb = dst_layout.plane(0);
+        const int32_t pitch = static_cast<int32_t>(rgb.stride);
+        if(top_down)
+        {
+            kernel(in, static_cast<int32_t>(width), out, pitch, width, height, nullptr);
+        }
+        else
+        {
+            kernel(in, static_cast<int32_t>(width), out + static_cast<size_t>(height - 1) * rgb.stride, -pitch, width, height, nullptr);
+        }
+    }
+    else if(dst_encoding == Encoding::I420)
+    {
+        const RgbToI420 kernel = find_rgb_to_i420(src_encoding, color);
+        if(kernel == nullptr)
+        {
+            return false;
+        }
+
+        const FrameLayout::Plane& rgb = src_layout.plane(0);
+        const FrameLayout::Plane& py = dst_layout.plane(0);
+        const FrameLayout::Plane& pu = dst_layout.plane(1);
+        const FrameLayout::Plane& pv = dst_layout.plane(2);
+
+        for(uint32_t row = 0; row < height; row += 2)
+        {
+            const bool pair = row + 1 < height;
+            const uint8_t* rgb0 = in + static_cast<size_t>(top_down ? row : height - 1 - row) * rgb.stride;
+            const uint8_t* rgb1 = pair ? (top_down ? rgb0 + rgb.stride : rgb0 - rgb.stride) : rgb0;
+            const uint32_t c = row >> 1;
+            const bool chroma = c < pu.height;
+
+            kernel(
+                rgb0,
+                rgb1,
+                out + py.offset + static_cast<size_t>(row) * py.stride,
+                pair ? out + py.offset + static_cast<size_t>(row + 1) * py.stride : nullptr,
+                chroma ? out + pu.offset + static_cast<size_t>(c) * pu.stride : nullptr,
+                chroma ? out + pv.offset + static_cast<size_t>(c) * pv.stride : nullptr,
+                width);
+        }
+    }
+    else if(is_rgb(src_encoding) && is_rgb(dst_encoding))
+    {
+        const uint32_t src_bpp = bytes_per_pixel(src_encoding);
+        const uint32_t dst_bpp = bytes_per_pixel(dst_encoding);
+        const size_t pixels = static_cast<size_t>(width) * height;
+
+        for(size_t i = 0; i < pixels; i++)
+        {
+            out[i * dst_bpp + 0] = in[i * src_bpp + 0];
+            out[i * dst_bpp + 1] = in[i * src_bpp + 1];
+            out[i * dst_bpp + 2] = in[i * src_bpp + 2];
+            if(dst_bpp == 4)
+            {
+                out[i * dst_bpp + 3] = 0xFF;
+            }
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+}}
@@ -0,0 +1,114 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "Orientation.h"
+#include <cstddef>
+#include <cstdint>
+
+
+namespace cdi {
+
+class FrameStats;
+
+namespace kernels {
+
+// Conversions follow the memory order of the Color Converter DSP: RGB24/RGBA32 are
+// B,G,R(,A) and stored bottom-up, YUV formats are stored top-down. Every combination
+// of formats, matrix and range is a kernel of its own, the inner loops carry no
+// per pixel decisions. ColorMatrix::DEFAULT is treated as BT.601.
+
+enum class YuvFormat
+{
+    I420,
+    NV12,
+    YUY2,
+};
+
+// 'src' is the first row of the frame and 'src_pitch' its luma pitch. 'dst' is the
+// top image row and 'dst_pitch' the distance to the next image row, negative for
+// bottom-up memory order. 'stats' accumulates the luma rows while they are converted,
+// between its begin() and finish(), or is null.
+typedef void (*YuvToRgb)(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    FrameStats* stats);
+
+// Two rows of packed BGR(A) to two luma rows and one row of each chroma plane,
+// 'y1' may be null for the last row of an odd height, 'u' and 'v' to skip chroma
+typedef void (*RgbToI420)(
+    const uint8_t* rgb0,
+    const uint8_t* rgb1,
+    uint8_t* y0,
+    uint8_t* y1,
+    uint8_t* u,
+    uint8_t* v,
+    const uint32_t& width);
+
+// As YuvToRgb, and to I420, with the output rotated or mirrored. Rows are converted into
+// 'band' a few at a time and written out from there through one map per output plane
+// (Y, U, V for I420), see write_band(). I420 output needs an even width and height.
+typedef void (*OrientedYuv)(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    const PixelMap* planes,
+    const uint32_t& width,
+    const uint32_t& height,
+    uint8_t* band,
+    FrameStats* stats);
+
+// Bytes of the 'band' of OrientedYuv
+size_t oriented_band_size(const uint32_t& width);
+
+// Null when the combination has no kernel
+YuvToRgb find_yuv_to_rgb(const YuvFormat& src, const Encoding& dst, const ColorSpace& color);
+RgbToI420 find_rgb_to_i420(const Encoding& src, const ColorSpace& color);
+OrientedYuv find_oriented_yuv(const YuvFormat& src, const Encoding& dst, const ColorSpace& color);
+
+// Converts a whole frame between two encodings, RGB is top-down instead of bottom-up
+// on both sides with 'top_down'
+bool convert_frame(
+    const void* src,
+    const Encoding& src_encoding,
+    void* dst,
+    const Encoding& dst_encoding,
+    const uint32_t& width,
+    const uint32_t& height,
+    const ColorSpace& color,
+    const bool& top_down);
+
+}}
@@ -31,6 +31,12 @@
 */
 
 #include "ColorTransform.h"
+#include "ExternalBuffer.h"
+#include "FrameLayout.h"
+#include "FrameStats.h"
+#include "ThreadPlacer.h"
+#include "Trace.h"
+#include "VideoFormats.h"
 #include "ScopeGuard.inl"
 #include "Macros.inl"
 #include <cassert>
@@ -45,6 +51,22 @@ ColorTransform::ColorTransform()
     , m_output_sample(nullptr)
     , m_output_buffer(nullptr)
     , m_locked_buffer(nullptr)
+    , m_target_sample(nullptr)
+    , m_frame_buffer(nullptr)
+    , m_kernel(nullptr)
+    , m_wide_kernel(nullptr)
+    , m_oriented(nullptr)
+    , m_stats(nullptr)
+    , m_output(Encoding::UNKNOWN)
+    , m_width(0)
+    , m_height(0)
+    , m_output_height(0)
+    , m_input_pitch(0)
+    , m_input_size(0)
+    , m_output_pitch(0)
+    , m_output_size(0)
+    , m_output_bottom_up(false)
+    , m_passthrough(false)
 {
 }
 
@@ -53,7 +75,11 @@ ColorTransform::~ColorTransform()
     uninit();
 }
 
-bool ColorTransform::init(IMFMediaType* input, const GUID& mf_video_format)
+bool ColorTransform::init(
+    IMFMediaType* input,
+    const GUID& mf_video_format,
+    const StreamOptions& options,
+    const std::shared_ptr<ThreadPlacer>& placer)
 {
     cdi::util::ScopeGuard uninit_guard;
     uninit_guard += [this]() { uninit(); };
@@ -64,9 +90,67 @@ bool ColorTransform::init(IMFMediaType* input, const GUID& mf_video_format)
     }
 
     m_input_type = input;
+    m_placer = placer;
+    m_orientation = options.orientation;
 
     m_input_type->AddRef();
 
+    // Compressed frames are handed out as the device delivers them
+    if(mf_video_format == MFVideoFormat_MJPG || mf_video_format == MFVideoFormat_H264)
+    {
+        GUID input_format = GUID_NULL;
+        FAILED_RETURN(m_input_type->GetGUID(MF_MT_SUBTYPE, &input_format), false);
+        if(input_format != mf_video_format || !kernels::is_identity(m_orientation))
+        {
+            return false;
+        }
+
+        m_passthrough = true;
+        uninit_guard.cancel();
+
+        return true;
+    }
+
+    // Bayer, high bit depth, BT.2020 and orientations go through our own kernels when there is one for the formats
+    if(init_kernel(mf_video_format, options))
+    {
+        if(!create_output(static_cast<DWORD>(m_output_size)))
+        {
+            return false;
+        }
+
+        uninit_guard.cancel();
+
+        return true;
+    }
+
+    // The DSP can neither rotate nor write RGB top-down
+    if(!kernels::is_identity(m_orientation)
+       || (m_orientation.top_down && (m_output == Encoding::RGB24 || m_output == Encoding::RGBA32)))
+    {
+        return false;
+    }
+
+    // Otherwise tell the DSP, which knows BT.601 and BT.709
+    const ColorSpace& color = options.color;
+    if(color.matrix != ColorMatrix::DEFAULT)
+    {
+        UINT32 matrix = MFVideoTransferMatrix_BT601;
+        if(color.matrix == ColorMatrix::BT709)
+        {
+            matrix = MFVideoTransferMatrix_BT709;
+        }
+        else if(color.matrix == ColorMatrix::BT2020)
+        {
+            matrix = MFVideoTransferMatrix_BT2020_10;
+        }
+
+        FAILED_RETURN(m_input_type->SetUINT32(MF_MT_YUV_MATRIX, matrix), false);
+        FAILED_RETURN(m_input_type->SetUINT32(
+            MF_MT_VIDEO_NOMINAL_RANGE,
+            color.range == ColorRange::FULL ? MFNominalRange_0_255 : MFNominalRange_16_235), false);
+    }
+
     FAILED_RETURN(CoCreateInstance(
         CLSID_CColorConvertDMO,
         NULL, CLSCTX_INPROC_SERVER,
@@ -98,18 +182,14 @@ bool ColorTransform::init(IMFMediaType* input, const GUID& mf_video_format)
     
     // Create output sample and Buffer
     {
-        // Create sample/frame
-        FAILED_RETURN(MFCreateSample(&m_output_sample), false);
-
         // Fetch target Buffer size
         MFT_OUTPUT_STREAM_INFO output_info = {};
         FAILED_RETURN(m_transform->GetOutputStreamInfo(0, &output_info), false);
 
-        // Create output Buffer
-        FAILED_RETURN(MFCreateMemoryBuffer(output_info.cbSize, &m_output_buffer), false);
-
-        // Attach the output Buffer to the output sample
-        FAILED_RETURN(m_output_sample->AddBuffer(m_output_buffer), false);
+        if(!create_output(output_info.cbSize))
+        {
+            return false;
+        }
     }
 
     uninit_guard.cancel();
@@ -117,34 +197,382 @@ bool ColorTransform::init(IMFMediaType* input, const GUID& mf_video_format)
     return true;
 }
 
-void ColorTransform::transform(IMFSample* sample)
+bool ColorTransform::create_output(const DWORD& size)
+{
+    // Create sample/frame
+    FAILED_RETURN(MFCreateSample(&m_output_sample), false);
+
+    // Own memory when the frame has to live on a given node, laid out as the converters expect
+    const int32_t node = m_placer ? m_placer->memory_node() : -1;
+    if(node >= 0 && m_output_pitch != 0 && m_frame_memory.allocate(size, static_cast<uint32_t>(node)))
+    {
+        uint8_t* base = m_frame_memory.data();
+        const LONG pitch = static_cast<LONG>(m_output_pitch);
+        uint8_t* scanline0 = m_output_bottom_up ? base + m_output_pitch * (m_output_height - 1) : base;
+        m_frame_buffer = new ExternalBuffer(base, size, scanline0, m_output_bottom_up ? -pitch : pitch, true);
+        m_output_buffer = m_frame_buffer;
+    }
+    else
+    {
+        FAILED_RETURN(MFCreateMemoryBuffer(size, &m_output_buffer), false);
+    }
+
+    // Attach the output Buffer to the output sample
+    FAILED_RETURN(m_output_sample->AddBuffer(m_output_buffer), false);
+
+    return true;
+}
+
+bool ColorTransform::init_kernel(const GUID& mf_video_format, const StreamOptions& options)
+{
+    GUID input_format = {};
+    FAILED_RETURN(m_input_type->GetGUID(MF_MT_SUBTYPE, &input_format), false);
+    FAILED_RETURN(MFGetAttributeSize(m_input_type, MF_MT_FRAME_SIZE, &m_width, &m_height), false);
+
+    Encoding output = Encoding::UNKNOWN;
+    if(mf_video_format == MFVideoFormat_RGB24)
+    {
+        output = Encoding::RGB24;
+    }
+    else if(mf_video_format == MFVideoFormat_RGB32)
+    {
+        output = Encoding::RGBA32;
+    }
+    else if(mf_video_format == MFVideoFormat_I420)
+    {
+        output = Encoding::I420;
+    }
+    else
+    {
+        wide_encoding(mf_video_format, output);
+    }
+
+    // Rotated frames swap width and height
+    m_output = output;
+    const bool rgb = output == Encoding::RGB24 || output == Encoding::RGBA32;
+    const bool swapped = kernels::swaps_axes(m_orientation);
+    m_output_height = swapped ? m_width : m_height;
+
+    FrameLayout output_layout;
+    if(!output_layout.init(swapped ? m_height : m_width, m_output_height, output))
+    {
+        return false;
+    }
+
+    m_output_pitch = output_layout.plane(0).stride;
+    m_output_size = output_layout.size();
+    m_output_bottom_up = rgb && !m_orientation.top_down;
+
+    // Demosaic and the high bit depth kernels write rows in order only
+    const bool oriented = !kernels::is_identity(m_orientation);
+
+    // The DSP knows nothing about raw sensor formats
+    BayerFormat bayer;
+    if(bayer_format(input_format, bayer))
+    {
+        if(oriented)
+        {
+            return false;
+        }
+
+        m_input_pitch = static_cast<LONG>(m_width * (bayer.bits == 8 ? 1 : 2));
+        m_input_size = static_cast<size_t>(m_input_pitch) * m_height;
+        m_demosaic = std::make_unique<Demosaic>();
+        if(!m_demosaic->init(m_width, m_height, bayer, output, options.color, options.demosaic, m_placer))
+        {
+            m_demosaic.reset();
+            return false;
+        }
+
+        return true;
+    }
+
+    // The DSP truncates high bit depth input. Keep the precision, tone map to I420 when asked
+    // for and convert to RGB from rounded samples, through the window or over the full range.
+    Encoding wide_input = Encoding::UNKNOWN;
+    if(wide_encoding(input_format, wide_input)
+       && (FrameLayout::is_wide(output) || rgb || (output == Encoding::I420 && options.tone_map.enabled)))
+    {
+        if(oriented)
+        {
+            return false;
+        }
+
+        FrameLayout input_layout;
+        if(!input_layout.init(m_width, m_height, wide_input))
+        {
+            return false;
+        }
+
+        m_input_pitch = static_cast<LONG>(input_layout.plane(0).stride);
+        m_input_size = input_layout.size();
+        m_wide_kernel = kernels::find_wide(wide_input, output);
+        m_wide_output.curve = kernels::make_tone_curve(options.tone_map);
+        m_wide_output.rgb = rgb ? kernels::find_yuv_to_rgb(kernels::YuvFormat::NV12, output, options.color) : nullptr;
+
+        return m_wide_kernel != nullptr && (!rgb || m_wide_output.rgb != nullptr);
+    }
+
+    // The DSP is the default for 8 bit YUV in the matrices it knows, it is told about them.
+    // Own kernels take BT.2020, orientations and top-down RGB and treat the default matrix as BT.601.
+    const bool dsp_matrix = options.color.matrix != ColorMatrix::BT2020;
+    if(dsp_matrix && !oriented && !(rgb && m_orientation.top_down))
+    {
+        return false;
+    }
+
+    // Default pitch of packed input buffers and their minimum size
+    kernels::YuvFormat yuv_format = kernels::YuvFormat::I420;
+    if(input_format == MFVideoFormat_I420 || input_format == MFVideoFormat_IYUV)
+    {
+        m_input_pitch = static_cast<LONG>(m_width);
+        m_input_size = static_cast<size_t>(m_width) * m_height * 3 / 2;
+    }
+    else if(input_format == MFVideoFormat_NV12)
+    {
+        yuv_format = kernels::YuvFormat::NV12;
+        m_input_pitch = static_cast<LONG>(m_width);
+        m_input_size = static_cast<size_t>(m_width) * m_height * 3 / 2;
+    }
+    else if(input_format == MFVideoFormat_YUY2)
+    {
+        yuv_format = kernels::YuvFormat::YUY2;
+        m_input_pitch = static_cast<LONG>(m_width) * 2;
+        m_input_size = static_cast<size_t>(m_width) * m_height * 2;
+    }
+    else
+    {
+        return false;
+    }
+
+    if(oriented)
+    {
+        // Chroma planes of a rotated I420 frame only line up with even sizes
+        if(output == Encoding::I420 && ((m_width | m_height) & 1) != 0)
+        {
+            return false;
+        }
+
+        m_oriented = kernels::find_oriented_yuv(yuv_format, output, options.color);
+        m_band.resize(kernels::oriented_band_size(m_width));
+
+        return m_oriented != nullptr;
+    }
+
+    m_kernel = kernels::find_yuv_to_rgb(yuv_format, output, options.color);
+
+    return m_kernel != nullptr;
+}
+
+bool ColorTransform::convert(IMFSample* sample, IMFMediaBuffer* target)
 {
-    HRESULT res = S_FALSE;
+    cdi::util::ScopeGuard guard;
+
+    IMFMediaBuffer* input = nullptr;
+    FAILED_RETURN(sample->ConvertToContiguousBuffer(&input), false);
+    guard += [&input]() { SAFE_RELEASE(input); };
+
+    // Prefer the real pitch of 2D buffers, fall back to the packed layout
+    BYTE* src = nullptr;
+    LONG src_pitch = m_input_pitch;
+    IMF2DBuffer* input_2d = nullptr;
+    if(SUCCEEDED(input->QueryInterface(IID_PPV_ARGS(&input_2d))))
+    {
+        guard += [&input_2d]() { SAFE_RELEASE(input_2d); };
+        FAILED_RETURN(input_2d->Lock2D(&src, &src_pitch), false);
+        guard += [&input_2d]() { input_2d->Unlock2D(); };
+    }
+    else
+    {
+        DWORD max_length = 0;
+        DWORD length = 0;
+        FAILED_RETURN(input->Lock(&src, &max_length, &length), false);
+        guard += [&input]() { input->Unlock(); };
+        if(length < m_input_size)
+        {
+            return false;
+        }
+    }
+
+    // The kernel starts at the top image row, RGB is bottom-up in plain buffers
+    BYTE* dst = nullptr;
+    LONG dst_pitch = 0;
+    IMF2DBuffer* target_2d = nullptr;
+    if(SUCCEEDED(target->QueryInterface(IID_PPV_ARGS(&target_2d))))
+    {
+        guard += [&target_2d]() { SAFE_RELEASE(target_2d); };
+        FAILED_RETURN(target_2d->Lock2D(&dst, &dst_pitch), false);
+        guard += [&target_2d]() { target_2d->Unlock2D(); };
+    }
+    else
+    {
+        DWORD max_length = 0;
+        DWORD length = 0;
+        FAILED_RETURN(target->Lock(&dst, &max_length, &length), false);
+        guard += [&target]() { target->Unlock(); };
+        if(max_length < m_output_size)
+        {
+            return false;
+        }
+
+        dst_pitch = static_cast<LONG>(m_output_pitch);
+        if(m_output_bottom_up)
+        {
+            dst += static_cast<size_t>(m_output_height - 1) * m_output_pitch;
+            dst_pitch = -dst_pitch;
+        }
+    }
+
+    // The luma rows are still in cache while the kernel converts them, the statistics come along
+    const bool fused = fuses_statistics();
+    if(fused)
+    {
+        m_stats->begin();
+    }
+
+    if(m_oriented != nullptr)
+    {
+        // Further planes follow the first one, chroma rows at half the pitch
+        kernels::PixelMap planes[3];
+        if(m_output == Encoding::I420)
+        {
+            const int32_t chroma_pitch = dst_pitch / 2;
+            uint8_t* u = dst + static_cast<ptrdiff_t>(dst_pitch) * m_output_height;
+            uint8_t* v = u + static_cast<ptrdiff_t>(chroma_pitch) * (m_output_height / 2);
+            planes[0] = kernels::map_pixels(m_orientation, dst, dst_pitch, m_width, m_height, 1);
+            planes[1] = kernels::map_pixels(m_orientation, u, chroma_pitch, m_width / 2, m_height / 2, 1);
+            planes[2] = kernels::map_pixels(m_orientation, v, chroma_pitch, m_width / 2, m_height / 2, 1);
+        }
+        else
+        {
+            const uint32_t bpp = m_output == Encoding::RGB24 ? 3 : 4;
+            planes[0] = kernels::map_pixels(m_orientation, dst, dst_pitch, m_width, m_height, bpp);
+        }
+
+        m_oriented(src, src_pitch, planes, m_width, m_height, m_band.data(), m_stats);
+    }
+    else if(m_kernel != nullptr)
+    {
+        m_kernel(src, src_pitch, dst, dst_pitch, m_width, m_height, m_stats);
+    }
+    else if(m_wide_kernel != nullptr)
+    {
+        m_wide_kernel(src, src_pitch, dst, dst_pitch, m_width, m_height, m_wide_output);
+    }
+    else
+    {
+        m_demosaic->run(src, src_pitch, dst, dst_pitch);
+    }
+
+    if(fused)
+    {
+        m_stats->finish(m_stats_options);
+    }
+    target->SetCurrentLength(static_cast<DWORD>(m_output_size));
+
+    return true;
+}
+
+bool ColorTransform::transform(IMFSample* sample)
+{
+    trace::Scope scope(trace::Name::CONVERT);
+
+    if(m_passthrough)
+    {
+        // Kept until the next frame arrives
+        SAFE_RELEASE(m_output_sample);
+        m_output_sample = sample;
+        m_output_sample->AddRef();
+        return true;
+    }
+
+    if(m_kernel != nullptr || m_wide_kernel != nullptr || m_demosaic != nullptr || m_oriented != nullptr)
+    {
+        return convert(sample, m_output_buffer);
+    }
 
     // Configure color space conversion
-    res = m_transform->ProcessInput(0, sample, 0);
-    assert(SUCCEEDED(res) && "Error processing input by MF transform");
+    FAILED_RETURN(m_transform->ProcessInput(0, sample, 0), false);
 
     // Process color space conversion
     MFT_OUTPUT_DATA_BUFFER output_buffer_info = {};
     output_buffer_info.pSample = m_output_sample;
     DWORD proces_output_status = 0;
-    res = m_transform->ProcessOutput(0, 1, &output_buffer_info, &proces_output_status);
-    assert(SUCCEEDED(res) && "Error processing output by MF transform");
+    FAILED_RETURN(m_transform->ProcessOutput(0, 1, &output_buffer_info, &proces_output_status), false);
+
+    return true;
+}
+
+bool ColorTransform::transform(IMFSample* sample, IMFMediaBuffer* target, bool& direct)
+{
+    trace::Scope scope(trace::Name::CONVERT);
+
+    direct = false;
+
+    if(m_passthrough)
+    {
+        SAFE_RELEASE(m_output_sample);
+        m_output_sample = sample;
+        m_output_sample->AddRef();
+        return true;
+    }
+
+    if(m_kernel != nullptr || m_wide_kernel != nullptr || m_demosaic != nullptr || m_oriented != nullptr)
+    {
+        direct = convert(sample, target);
+        return direct || convert(sample, m_output_buffer);
+    }
+
+    FAILED_RETURN(m_transform->ProcessInput(0, sample, 0), false);
+
+    if(m_target_sample == nullptr)
+    {
+        FAILED_RETURN(MFCreateSample(&m_target_sample), false);
+    }
+
+    MFT_OUTPUT_DATA_BUFFER output_buffer_info = {};
+    DWORD proces_output_status = 0;
+
+    if(SUCCEEDED(m_target_sample->AddBuffer(target)))
+    {
+        output_buffer_info.pSample = m_target_sample;
+        const HRESULT res = m_transform->ProcessOutput(0, 1, &output_buffer_info, &proces_output_status);
+        m_target_sample->RemoveAllBuffers();
+        if(SUCCEEDED(res))
+        {
+            direct = true;
+            return true;
+        }
+    }
+
+    // Input is still pending, convert into the internal frame
+    output_buffer_info = {};
+    output_buffer_info.pSample = m_output_sample;
+    FAILED_RETURN(m_transform->ProcessOutput(0, 1, &output_buffer_info, &proces_output_status), false);
+
+    return true;
 }
 
 const void* ColorTransform::lock(size_t& bytes)
 {
-    HRESULT res = S_FALSE;
+    bytes = 0;
+
+    // No frame arrived yet in passthrough
+    if(m_output_sample == nullptr)
+    {
+        return nullptr;
+    }
 
-    res = m_output_sample->ConvertToContiguousBuffer(&m_locked_buffer);
-    assert(SUCCEEDED(res) && "Error converting to contiguous Buffer");
+    FAILED_RETURN(m_output_sample->ConvertToContiguousBuffer(&m_locked_buffer), nullptr);
 
     BYTE* data = 0;
     DWORD buffer_length_max = 0;
     DWORD buffer_length_curr = 0;
-    res = m_locked_buffer->Lock(&data, &buffer_length_max, &buffer_length_curr);
-    assert(SUCCEEDED(res) && "Error locking contiguous Buffer");
+    if(FAILED(m_locked_buffer->Lock(&data, &buffer_length_max, &buffer_length_curr)))
+    {
+        SAFE_RELEASE(m_locked_buffer);
+        return nullptr;
+    }
 
     bytes = static_cast<size_t>(buffer_length_curr);
 
@@ -155,21 +583,66 @@ void ColorTransform::unlock()
 {
     if(m_locked_buffer != nullptr)
     {
-        const HRESULT res = m_locked_buffer->Unlock();
-        assert(SUCCEEDED(res) && "Error unlocking contiguous Buffer");
+        m_locked_buffer->Unlock();
         SAFE_RELEASE(m_locked_buffer);
     }
 }
 
+const void* ColorTransform::frame_memory() const
+{
+    if(m_frame_memory.data() != nullptr || m_output_buffer == nullptr)
+    {
+        return m_frame_memory.data();
+    }
+
+    // Memory of Media Foundation buffers does not move
+    BYTE* data = nullptr;
+    if(FAILED(m_output_buffer->Lock(&data, nullptr, nullptr)))
+    {
+        return nullptr;
+    }
+    m_output_buffer->Unlock();
+
+    return data;
+}
+
+bool ColorTransform::bottom_up() const
+{
+    return m_output_bottom_up;
+}
+
+void ColorTransform::set_statistics(FrameStats* stats, const StatisticsOptions& options)
+{
+    m_stats = stats;
+    m_stats_options = options;
+}
+
+bool ColorTransform::fuses_statistics() const
+{
+    return m_stats != nullptr && (m_kernel != nullptr || m_oriented != nullptr);
+}
+
 void ColorTransform::uninit()
 {
     assert(m_locked_buffer == nullptr
            && "Before Buffer can be destroyed, it needs to be unlocked");
 
+    // Nothing reaches the frame memory through a buffer still referenced elsewhere
+    if(m_frame_buffer != nullptr)
+    {
+        m_frame_buffer->detach();
+        m_frame_buffer = nullptr;
+    }
+
+    SAFE_RELEASE(m_target_sample);
     SAFE_RELEASE(m_output_sample);
     SAFE_RELEASE(m_output_buffer);
     SAFE_RELEASE(m_transform);
     SAFE_RELEASE(m_input_type);
+    m_demosaic.reset();
+    m_frame_memory.free();
+    m_placer.reset();
+    m_passthrough = false;
 }
 
 }
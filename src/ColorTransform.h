@@ -31,7 +31,14 @@
 */
 
 #pragma once
+#include "cdi/cdi.h"
+#include "ColorKernels.h"
+#include "Demosaic.h"
+#include "NumaMemory.h"
+#include "WideKernels.h"
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 #include <mfapi.h>
 #include <mftransform.h>
@@ -39,6 +46,10 @@
 
 namespace cdi {
 
+class ExternalBuffer;
+class FrameStats;
+class ThreadPlacer;
+
 class ColorTransform
 {
     ColorTransform(const ColorTransform&);
@@ -48,12 +59,33 @@ public:
     ColorTransform();
     ~ColorTransform();
 
-    bool init(IMFMediaType* input, const GUID& mf_video_format);
-    void transform(IMFSample* sample);
+    // The frame memory lives on the memory node of 'placer', which also places the threads
+    bool init(
+        IMFMediaType* input,
+        const GUID& mf_video_format,
+        const StreamOptions& options,
+        const std::shared_ptr<ThreadPlacer>& placer);
+    // False when the frame could not be converted, the internal frame keeps the last good one
+    bool transform(IMFSample* sample);
+    // Converts into 'target' instead of the internal frame, 'direct' is false when the
+    // converter rejected the target and the frame went to the internal one
+    bool transform(IMFSample* sample, IMFMediaBuffer* target, bool& direct);
     const void* lock(size_t& bytes);
     void unlock();
+    // Start of the internal frame
+    const void* frame_memory() const;
+    // Memory order of RGB output, the top image row is the last one
+    bool bottom_up() const;
+    // The own 8 bit YUV kernels accumulate the luma of every frame they convert into 'stats',
+    // which outlives the transform. Null stops it.
+    void set_statistics(FrameStats* stats, const StatisticsOptions& options);
+    // True when every converted frame leaves its statistics in the set FrameStats
+    bool fuses_statistics() const;
 
 private:
+    bool init_kernel(const GUID& mf_video_format, const StreamOptions& options);
+    bool create_output(const DWORD& size);
+    bool convert(IMFSample* sample, IMFMediaBuffer* target);
     void uninit();
 
 private:
@@ -62,6 +94,33 @@ private:
     IMFSample* m_output_sample;
     IMFMediaBuffer* m_output_buffer;
     IMFMediaBuffer* m_locked_buffer;
+    IMFSample* m_target_sample;
+
+    // Frame memory on a NUMA node, wrapped for the converters
+    std::shared_ptr<ThreadPlacer> m_placer;
+    NumaMemory m_frame_memory;
+    ExternalBuffer* m_frame_buffer;
+
+    // Own conversion kernels, replace the DSP when set
+    kernels::YuvToRgb m_kernel;
+    kernels::WideConvert m_wide_kernel;
+    kernels::WideOutput m_wide_output;
+    std::unique_ptr<Demosaic> m_demosaic;
+    kernels::OrientedYuv m_oriented;
+    std::vector<uint8_t> m_band;
+    FrameStats* m_stats;
+    StatisticsOptions m_stats_options;
+    OrientationOptions m_orientation;
+    Encoding m_output;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_output_height; // Of the rotated frame
+    LONG m_input_pitch;
+    size_t m_input_size;
+    uint32_t m_output_pitch;
+    size_t m_output_size;
+    bool m_output_bottom_up;
+    bool m_passthrough; // Compressed output, the output sample is the one of the device
 };
 
 }
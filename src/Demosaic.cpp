@@ -0,0 +1,735 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Demosaic.h"
+#include "WorkerPool.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstddef>
+
+
+namespace cdi {
+
+namespace {
+
+// Columns of one strip, and the margins the 5x5 green and 3x3 color passes read around it
+const uint32_t TILE = 256;
+const int32_t RAW_PAD = 16;
+const int32_t GREEN_PAD = 8;
+const uint32_t RAW_STRIDE = TILE + 2 * RAW_PAD;
+const uint32_t GREEN_STRIDE = TILE + 2 * GREEN_PAD;
+const uint32_t MIN_SLICE_ROWS = 16;
+
+const uint8_t* row_at(const uint8_t* plane, const int32_t& pitch, const uint32_t& row)
+{
+    return plane + static_cast<ptrdiff_t>(pitch) * row;
+}
+
+uint8_t* row_at(uint8_t* plane, const int32_t& pitch, const uint32_t& row)
+{
+    return plane + static_cast<ptrdiff_t>(pitch) * row;
+}
+
+// Mirrors around the first and last sample without repeating them, which keeps the
+// parity and so the color of every position
+int32_t reflect(int32_t index, const int32_t& size)
+{
+    while(index < 0 || index >= size)
+    {
+        index = index < 0 ? -index : 2 * (size - 1) - index;
+    }
+
+    return index;
+}
+
+// Rows are addressed by image row, negative and past the end ones included
+int16_t* ring_row(int16_t* ring, const int32_t& row, const uint32_t& rows, const uint32_t& stride)
+{
+    return ring + static_cast<size_t>(row & static_cast<int32_t>(rows - 1)) * stride;
+}
+
+template<typename T>
+void load_samples(
+    const T* src,
+    int16_t* dst,
+    const int32_t& first,
+    const uint32_t& count,
+    const int32_t& width,
+    const uint16_t& mask,
+    const uint32_t& shift_left,
+    const uint32_t& shift_right)
+{
+    if(first >= 0 && first + static_cast<int32_t>(count) <= width)
+    {
+        const T* in = src + first;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            dst[i] = static_cast<int16_t>(((in[i] & mask) << shift_left) >> shift_right);
+        }
+    }
+    else
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const T value = src[reflect(first + static_cast<int32_t>(i), width)];
+            dst[i] = static_cast<int16_t>(((value & mask) << shift_left) >> shift_right);
+        }
+    }
+}
+
+__m128i load(const int16_t* src)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+void store(int16_t* dst, const __m128i& value)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+__m128i select(const __m128i& mask, const __m128i& a, const __m128i& b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__m128i clamp12(const __m128i& value)
+{
+    return _mm_min_epi16(_mm_max_epi16(value, _mm_setzero_si128()), _mm_set1_epi16(4095));
+}
+
+__m128i abs16(const __m128i& value)
+{
+    return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+}
+
+// Lanes of the red or blue samples in a row, all mosaic columns of a lane share its parity
+__m128i colored_lanes(const uint32_t& column_parity)
+{
+    const __m128i even = _mm_set_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+    return column_parity == 0 ? even : _mm_xor_si128(even, _mm_set1_epi16(-1));
+}
+
+// Green at the red and blue positions of one row from the five rows around it. The
+// edge aware variant interpolates along the smaller of the horizontal and vertical
+// gradients and corrects with the Laplacian of the center color (Hamilton-Adams).
+template<bool EDGE>
+void green_row(int16_t* raw, const int32_t& row, int16_t* green, const uint32_t& columns, const __m128i& colored)
+{
+    const int16_t* up2 = ring_row(raw, row - 2, 8, RAW_STRIDE) + RAW_PAD;
+    const int16_t* up1 = ring_row(raw, row - 1, 8, RAW_STRIDE) + RAW_PAD;
+    const int16_t* center = ring_row(raw, row, 8, RAW_STRIDE) + RAW_PAD;
+    const int16_t* down1 = ring_row(raw, row + 1, 8, RAW_STRIDE) + RAW_PAD;
+    const int16_t* down2 = ring_row(raw, row + 2, 8, RAW_STRIDE) + RAW_PAD;
+    int16_t* out = ring_row(green, row, 4, GREEN_STRIDE) + GREEN_PAD;
+
+    for(int32_t x = -GREEN_PAD; x < static_cast<int32_t>(columns) + GREEN_PAD; x += 8)
+    {
+        const __m128i c = load(center + x);
+        const __m128i l = load(center + x - 1);
+        const __m128i r = load(center + x + 1);
+        const __m128i u = load(up1 + x);
+        const __m128i d = load(down1 + x);
+
+        __m128i g;
+        if(EDGE)
+        {
+            const __m128i c2 = _mm_add_epi16(c, c);
+            const __m128i lap_h = _mm_sub_epi16(_mm_sub_epi16(c2, load(center + x - 2)), load(center + x + 2));
+            const __m128i lap_v = _mm_sub_epi16(_mm_sub_epi16(c2, load(up2 + x)), load(down2 + x));
+
+            const __m128i gh = clamp12(_mm_srai_epi16(_mm_add_epi16(_mm_slli_epi16(_mm_add_epi16(l, r), 1), lap_h), 2));
+            const __m128i gv = clamp12(_mm_srai_epi16(_mm_add_epi16(_mm_slli_epi16(_mm_add_epi16(u, d), 1), lap_v), 2));
+            const __m128i dh = _mm_add_epi16(abs16(_mm_sub_epi16(l, r)), abs16(lap_h));
+            const __m128i dv = _mm_add_epi16(abs16(_mm_sub_epi16(u, d)), abs16(lap_v));
+
+            g = _mm_avg_epu16(gh, gv);
+            g = select(_mm_cmplt_epi16(dh, dv), gh, g);
+            g = select(_mm_cmpgt_epi16(dh, dv), gv, g);
+        }
+        else
+        {
+            g = _mm_avg_epu16(_mm_avg_epu16(l, r), _mm_avg_epu16(u, d));
+        }
+
+        store(out + x, select(colored, g, c));
+    }
+}
+
+// Green plus the color difference of the 'near' or 'far' neighbour, whichever is
+// across the smaller green step, or of both when the steps are equal
+__m128i side(const __m128i& g, const __m128i& near, const __m128i& far, const __m128i& step_near, const __m128i& step_far)
+{
+    const __m128i mean = _mm_srai_epi16(_mm_add_epi16(near, far), 1);
+    const __m128i margin = _mm_set1_epi16(32);
+    __m128i difference = select(_mm_cmplt_epi16(_mm_add_epi16(_mm_add_epi16(step_near, step_near), margin), step_far), near, mean);
+    difference = select(_mm_cmplt_epi16(_mm_add_epi16(_mm_add_epi16(step_far, step_far), margin), step_near), far, difference);
+    return clamp12(_mm_add_epi16(g, difference));
+}
+
+__m128i bound(const __m128i& value, const __m128i& a, const __m128i& b)
+{
+    return _mm_min_epi16(_mm_max_epi16(value, _mm_min_epi16(a, b)), _mm_max_epi16(a, b));
+}
+
+__m128i bound(const __m128i& value, const __m128i& low0, const __m128i& high0, const __m128i& low1, const __m128i& high1)
+{
+    return _mm_min_epi16(_mm_max_epi16(value, _mm_min_epi16(low0, low1)), _mm_max_epi16(high0, high1));
+}
+
+// Red and blue of one row. Bilinear averages the nearest samples of each color, the
+// edge aware variant interpolates the color differences to green instead.
+template<bool EDGE>
+void color_row(
+    int16_t* raw,
+    int16_t* green,
+    const int32_t& row,
+    const uint32_t& columns,
+    const __m128i& colored,
+    int16_t* same,
+    int16_t* other,
+    int16_t* green_out)
+{
+    const int16_t* up = ring_row(raw, row - 1, 8, RAW_STRIDE) + RAW_PAD;
+    const int16_t* center = ring_row(raw, row, 8, RAW_STRIDE) + RAW_PAD;
+    const int16_t* down = ring_row(raw, row + 1, 8, RAW_STRIDE) + RAW_PAD;
+    const int16_t* green_up = ring_row(green, row - 1, 4, GREEN_STRIDE) + GREEN_PAD;
+    const int16_t* green_center = ring_row(green, row, 4, GREEN_STRIDE) + GREEN_PAD;
+    const int16_t* green_down = ring_row(green, row + 1, 4, GREEN_STRIDE) + GREEN_PAD;
+
+    for(uint32_t x = 0; x < columns; x += 8)
+    {
+        const __m128i c = load(center + x);
+        const __m128i l = load(center + x - 1);
+        const __m128i r = load(center + x + 1);
+        const __m128i u = load(up + x);
+        const __m128i d = load(down + x);
+        const __m128i g = load(green_center + x);
+
+        __m128i h;
+        __m128i v;
+        __m128i x4;
+        if(EDGE)
+        {
+            // One sided color differences, the side with the smaller green step wins
+            const __m128i gl = load(green_center + x - 1);
+            const __m128i gr = load(green_center + x + 1);
+            const __m128i gu = load(green_up + x);
+            const __m128i gd = load(green_down + x);
+            h = side(g, _mm_sub_epi16(l, gl), _mm_sub_epi16(r, gr), abs16(_mm_sub_epi16(g, gl)), abs16(_mm_sub_epi16(g, gr)));
+            v = side(g, _mm_sub_epi16(u, gu), _mm_sub_epi16(d, gd), abs16(_mm_sub_epi16(g, gu)), abs16(_mm_sub_epi16(g, gd)));
+
+            // Diagonals as in Hamilton-Adams, the one with the smaller gradient wins
+            const __m128i ul = load(up + x - 1);
+            const __m128i ur = load(up + x + 1);
+            const __m128i dl = load(down + x - 1);
+            const __m128i dr = load(down + x + 1);
+            const __m128i gul = load(green_up + x - 1);
+            const __m128i gur = load(green_up + x + 1);
+            const __m128i gdl = load(green_down + x - 1);
+            const __m128i gdr = load(green_down + x + 1);
+            const __m128i g2 = _mm_add_epi16(g, g);
+            const __m128i lap1 = _mm_sub_epi16(g2, _mm_add_epi16(gul, gdr));
+            const __m128i lap2 = _mm_sub_epi16(g2, _mm_add_epi16(gur, gdl));
+            const __m128i x1 = clamp12(_mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(ul, dr), lap1), 1));
+            const __m128i x2 = clamp12(_mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(ur, dl), lap2), 1));
+            const __m128i d1 = _mm_add_epi16(abs16(_mm_sub_epi16(ul, dr)), abs16(lap1));
+            const __m128i d2 = _mm_add_epi16(abs16(_mm_sub_epi16(ur, dl)), abs16(lap2));
+
+            x4 = _mm_avg_epu16(x1, x2);
+            x4 = select(_mm_cmplt_epi16(d1, d2), x1, x4);
+            x4 = select(_mm_cmpgt_epi16(d1, d2), x2, x4);
+
+            // Saturated colors break the constant difference assumption at corners,
+            // stay within the samples the estimates come from
+            h = bound(h, l, r);
+            v = bound(v, u, d);
+            x4 = bound(x4, _mm_min_epi16(ul, ur), _mm_max_epi16(ul, ur), _mm_min_epi16(dl, dr), _mm_max_epi16(dl, dr));
+        }
+        else
+        {
+            h = _mm_avg_epu16(l, r);
+            v = _mm_avg_epu16(u, d);
+            x4 = _mm_avg_epu16(
+                _mm_avg_epu16(load(up + x - 1), load(up + x + 1)),
+                _mm_avg_epu16(load(down + x - 1), load(down + x + 1)));
+        }
+
+        // Horizontal neighbours of green positions carry the color of the row
+        store(same + x, select(colored, c, h));
+        store(other + x, select(colored, x4, v));
+        store(green_out + x, g);
+    }
+}
+
+int32_t clamp(const int32_t& value)
+{
+    return std::min(std::max(value, 0), 4095);
+}
+
+// 12 bit to the 16 bit encodings, 10 bit ones keep their samples in the high bits
+template<bool TEN>
+uint16_t to_16(const int32_t& value)
+{
+    return TEN ? static_cast<uint16_t>(std::min((value + 2) >> 2, 1023) << 6)
+               : static_cast<uint16_t>((value << 4) | (value >> 8));
+}
+
+struct Pixel
+{
+    int32_t r;
+    int32_t g;
+    int32_t b;
+};
+
+}
+
+Demosaic::Demosaic()
+    : m_width(0)
+    , m_height(0)
+    , m_slice_rows(0)
+    , m_slices(0)
+    , m_red_row(0)
+    , m_red_column(0)
+    , m_shift_left(0)
+    , m_shift_right(0)
+    , m_mask(0)
+    , m_edge(true)
+    , m_output(Encoding::UNKNOWN)
+    , m_weights()
+    , m_rgb_to_i420(nullptr)
+    , m_src(nullptr)
+    , m_src_pitch(0)
+    , m_dst(nullptr)
+    , m_dst_pitch(0)
+{
+}
+
+Demosaic::~Demosaic()
+{
+    uninit();
+}
+
+bool Demosaic::init(
+    const uint32_t& width,
+    const uint32_t& height,
+    const BayerFormat& format,
+    const Encoding& output,
+    const ColorSpace& color,
+    const DemosaicOptions& options,
+    const std::shared_ptr<ThreadPlacer>& placer)
+{
+    if(m_pool != nullptr || width < 2 || height < 2)
+    {
+        return false;
+    }
+
+    if(format.bits != 8 && format.bits != 10 && format.bits != 12 && format.bits != 16)
+    {
+        return false;
+    }
+
+    switch(output)
+    {
+    case Encoding::RGB24:
+    case Encoding::RGBA32:
+    case Encoding::GRAY16:
+    case Encoding::P010:
+    case Encoding::P016:
+    case Encoding::Y210:
+        break;
+    case Encoding::I420:
+        m_rgb_to_i420 = kernels::find_rgb_to_i420(Encoding::RGB24, color);
+        if(m_rgb_to_i420 == nullptr)
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    m_output = output;
+    m_edge = options.method == DemosaicMethod::EDGE_AWARE;
+
+    switch(format.pattern)
+    {
+    case BayerPattern::RGGB: m_red_row = 0; m_red_column = 0; break;
+    case BayerPattern::BGGR: m_red_row = 1; m_red_column = 1; break;
+    case BayerPattern::GRBG: m_red_row = 0; m_red_column = 1; break;
+    case BayerPattern::GBRG: m_red_row = 1; m_red_column = 0; break;
+    }
+
+    m_mask = static_cast<uint16_t>((1u << format.bits) - 1);
+    m_shift_left = format.bits < 12 ? 12 - format.bits : 0;
+    m_shift_right = format.bits > 12 ? format.bits - 12 : 0;
+
+    // Q14 weights, the 12 bit limited range puts black at 16 << 4
+    double kr = 0.299;
+    double kb = 0.114;
+    if(color.matrix == ColorMatrix::BT709)
+    {
+        kr = 0.2126;
+        kb = 0.0722;
+    }
+    else if(color.matrix == ColorMatrix::BT2020)
+    {
+        kr = 0.2627;
+        kb = 0.0593;
+    }
+
+    const double kg = 1.0 - kr - kb;
+    const bool full = color.range == ColorRange::FULL || output == Encoding::GRAY16;
+    const double y_scale = (full ? 1.0 : 219.0 / 255.0) * 16384.0;
+    const double c_scale = (full ? 1.0 : 224.0 / 255.0) * 16384.0;
+    auto fixed = [](const double value) { return static_cast<int32_t>(value < 0.0 ? value - 0.5 : value + 0.5); };
+
+    m_weights.yr = fixed(kr * y_scale);
+    m_weights.yg = fixed(kg * y_scale);
+    m_weights.yb = fixed(kb * y_scale);
+    m_weights.ur = fixed(-kr / (2.0 * (1.0 - kb)) * c_scale);
+    m_weights.ug = fixed(-kg / (2.0 * (1.0 - kb)) * c_scale);
+    m_weights.ub = fixed(0.5 * c_scale);
+    m_weights.vr = fixed(0.5 * c_scale);
+    m_weights.vg = fixed(-kg / (2.0 * (1.0 - kr)) * c_scale);
+    m_weights.vb = fixed(-kb / (2.0 * (1.0 - kr)) * c_scale);
+    m_weights.y_offset = full ? 0 : 256;
+
+    // Even slice heights keep the mosaic phase and the chroma rows of every slice aligned
+    m_pool = std::make_unique<WorkerPool>(options.threads, placer);
+    m_slice_rows = (height + m_pool->size() - 1) / m_pool->size();
+    m_slice_rows = std::max((m_slice_rows + 1) & ~1u, MIN_SLICE_ROWS);
+    m_slices = (height + m_slice_rows - 1) / m_slice_rows;
+
+    m_scratch.resize(m_slices);
+    for(Scratch& scratch : m_scratch)
+    {
+        scratch.raw.resize(8 * RAW_STRIDE);
+        scratch.green.resize(4 * GREEN_STRIDE);
+        scratch.rgb.resize(6 * TILE);
+        scratch.bgr.resize(2 * TILE * 3);
+    }
+
+    return true;
+}
+
+void Demosaic::uninit()
+{
+    m_pool.reset();
+    m_scratch.clear();
+    m_rgb_to_i420 = nullptr;
+}
+
+void Demosaic::run(const uint8_t* src, const int32_t& src_pitch, uint8_t* dst, const int32_t& dst_pitch)
+{
+    m_src = src;
+    m_src_pitch = src_pitch;
+    m_dst = dst;
+    m_dst_pitch = dst_pitch;
+
+    m_pool->run(m_slices, [this](const uint32_t index)
+    {
+        Scratch& scratch = m_scratch[index];
+        const uint32_t y0 = index * m_slice_rows;
+        const uint32_t y1 = std::min(y0 + m_slice_rows, m_height);
+
+        for(uint32_t x0 = 0; x0 < m_width; x0 += TILE)
+        {
+            const uint32_t columns = std::min(TILE, m_width - x0);
+            if(m_edge)
+            {
+                strip<true>(scratch, x0, columns, y0, y1);
+            }
+            else
+            {
+                strip<false>(scratch, x0, columns, y0, y1);
+            }
+        }
+    });
+}
+
+template<bool EDGE>
+void Demosaic::strip(Scratch& scratch, const uint32_t& x0, const uint32_t& columns, const uint32_t& y0, const uint32_t& y1)
+{
+    // Vector passes run over whole lanes, the columns past the strip are dropped on output
+    const uint32_t lanes = (columns + 7) & ~7u;
+    int16_t* raw = scratch.raw.data();
+    int16_t* green = scratch.green.data();
+
+    auto colored_parity = [this](const int32_t row)
+    {
+        return static_cast<uint32_t>(row & 1) == m_red_row ? m_red_column : 1 - m_red_column;
+    };
+
+    auto interpolate_green = [&](const int32_t row)
+    {
+        green_row<EDGE>(raw, row, green, lanes, colored_lanes(colored_parity(row)));
+    };
+
+    auto interpolate_colors = [&](const int32_t row, const uint32_t& index)
+    {
+        int16_t* r = scratch.rgb.data() + index * 3 * TILE;
+        int16_t* g = r + TILE;
+        int16_t* b = g + TILE;
+        const bool red = static_cast<uint32_t>(row & 1) == m_red_row;
+        color_row<EDGE>(raw, green, row, lanes, colored_lanes(colored_parity(row)), red ? r : b, red ? b : r, g);
+    };
+
+    // Rows y - 3 .. y + 4 of the mosaic and y - 1 .. y + 2 of green cover a row pair
+    const int32_t top = static_cast<int32_t>(y0);
+    for(int32_t row = top - 3; row <= top + 4; row++)
+    {
+        load_row(scratch, row, x0, lanes);
+    }
+
+    for(int32_t row = top - 1; row <= top + 2; row++)
+    {
+        interpolate_green(row);
+    }
+
+    for(uint32_t y = y0; y < y1; y += 2)
+    {
+        const int32_t row = static_cast<int32_t>(y);
+        const bool pair = y + 1 < y1;
+
+        interpolate_colors(row, 0);
+        if(pair)
+        {
+            interpolate_colors(row + 1, 1);
+        }
+
+        write_rows(scratch, y, pair, x0, columns);
+
+        if(y + 2 < y1)
+        {
+            load_row(scratch, row + 5, x0, lanes);
+            load_row(scratch, row + 6, x0, lanes);
+            interpolate_green(row + 3);
+            interpolate_green(row + 4);
+        }
+    }
+}
+
+void Demosaic::load_row(Scratch& scratch, const int32_t& row, const uint32_t& x0, const uint32_t& columns) const
+{
+    const uint8_t* src = row_at(m_src, m_src_pitch, static_cast<uint32_t>(reflect(row, static_cast<int32_t>(m_height))));
+    int16_t* dst = ring_row(scratch.raw.data(), row, 8, RAW_STRIDE);
+    const int32_t first = static_cast<int32_t>(x0) - RAW_PAD;
+    const uint32_t count = columns + 2 * RAW_PAD;
+    const int32_t width = static_cast<int32_t>(m_width);
+
+    if(m_format.bits == 8)
+    {
+        load_samples(src, dst, first, count, width, m_mask, m_shift_left, m_shift_right);
+    }
+    else
+    {
+        load_samples(reinterpret_cast<const uint16_t*>(src), dst, first, count, width, m_mask, m_shift_left, m_shift_right);
+    }
+}
+
+void Demosaic::write_rows(Scratch& scratch, const uint32_t& y, const bool& pair, const uint32_t& x0, const uint32_t& columns)
+{
+    const uint32_t rows = pair ? 2 : 1;
+    const Weights& w = m_weights;
+
+    auto pixel = [&scratch](const uint32_t& index, const uint32_t& x)
+    {
+        const int16_t* r = scratch.rgb.data() + index * 3 * TILE;
+        Pixel p = {r[x], r[x + TILE], r[x + 2 * TILE]};
+        return p;
+    };
+
+    auto luma = [&w](const Pixel& p)
+    {
+        return clamp(((w.yr * p.r + w.yg * p.g + w.yb * p.b + 8192) >> 14) + w.y_offset);
+    };
+
+    auto chroma = [&w](const Pixel& p, int32_t& u, int32_t& v)
+    {
+        u = clamp(((w.ur * p.r + w.ug * p.g + w.ub * p.b + 8192) >> 14) + 2048);
+        v = clamp(((w.vr * p.r + w.vg * p.g + w.vb * p.b + 8192) >> 14) + 2048);
+    };
+
+    auto average = [](const Pixel& a, const Pixel& b)
+    {
+        Pixel p = {(a.r + b.r + 1) >> 1, (a.g + b.g + 1) >> 1, (a.b + b.b + 1) >> 1};
+        return p;
+    };
+
+    switch(m_output)
+    {
+    case Encoding::RGB24:
+    case Encoding::RGBA32:
+    {
+        const uint32_t bytes = m_output == Encoding::RGB24 ? 3 : 4;
+        for(uint32_t index = 0; index < rows; index++)
+        {
+            const int16_t* r = scratch.rgb.data() + index * 3 * TILE;
+            const int16_t* g = r + TILE;
+            const int16_t* b = g + TILE;
+            uint8_t* out = row_at(m_dst, m_dst_pitch, y + index) + static_cast<size_t>(x0) * bytes;
+
+            if(bytes == 3)
+            {
+                for(uint32_t x = 0; x < columns; x++, out += 3)
+                {
+                    out[0] = static_cast<uint8_t>(b[x] >> 4);
+                    out[1] = static_cast<uint8_t>(g[x] >> 4);
+                    out[2] = static_cast<uint8_t>(r[x] >> 4);
+                }
+            }
+            else
+            {
+                for(uint32_t x = 0; x < columns; x++, out += 4)
+                {
+                    out[0] = static_cast<uint8_t>(b[x] >> 4);
+                    out[1] = static_cast<uint8_t>(g[x] >> 4);
+                    out[2] = static_cast<uint8_t>(r[x] >> 4);
+                    out[3] = 0xFF;
+                }
+            }
+        }
+        break;
+    }
+    case Encoding::I420:
+    {
+        uint8_t* bgr[2] = {scratch.bgr.data(), scratch.bgr.data() + TILE * 3};
+        for(uint32_t index = 0; index < rows; index++)
+        {
+            const int16_t* r = scratch.rgb.data() + index * 3 * TILE;
+            uint8_t* out = bgr[index];
+            for(uint32_t x = 0; x < columns; x++, out += 3)
+            {
+                out[0] = static_cast<uint8_t>(r[x + 2 * TILE] >> 4);
+                out[1] = static_cast<uint8_t>(r[x + TILE] >> 4);
+                out[2] = static_cast<uint8_t>(r[x] >> 4);
+            }
+        }
+
+        // A lone last row of an odd height has no chroma row
+        const int32_t chroma_pitch = m_dst_pitch / 2;
+        uint8_t* u = m_dst + static_cast<ptrdiff_t>(m_dst_pitch) * m_height;
+        uint8_t* v = u + static_cast<ptrdiff_t>(chroma_pitch) * (m_height / 2);
+        m_rgb_to_i420(
+            bgr[0],
+            pair ? bgr[1] : nullptr,
+            row_at(m_dst, m_dst_pitch, y) + x0,
+            pair ? row_at(m_dst, m_dst_pitch, y + 1) + x0 : nullptr,
+            pair ? row_at(u, chroma_pitch, y / 2) + x0 / 2 : nullptr,
+            pair ? row_at(v, chroma_pitch, y / 2) + x0 / 2 : nullptr,
+            columns);
+        break;
+    }
+    case Encoding::GRAY16:
+    {
+        for(uint32_t index = 0; index < rows; index++)
+        {
+            uint16_t* out = reinterpret_cast<uint16_t*>(row_at(m_dst, m_dst_pitch, y + index)) + x0;
+            for(uint32_t x = 0; x < columns; x++)
+            {
+                out[x] = to_16<false>(luma(pixel(index, x)));
+            }
+        }
+        break;
+    }
+    case Encoding::P010:
+    case Encoding::P016:
+    {
+        const bool ten = m_output == Encoding::P010;
+        for(uint32_t index = 0; index < rows; index++)
+        {
+            uint16_t* out = reinterpret_cast<uint16_t*>(row_at(m_dst, m_dst_pitch, y + index)) + x0;
+            for(uint32_t x = 0; x < columns; x++)
+            {
+                const int32_t value = luma(pixel(index, x));
+                out[x] = ten ? to_16<true>(value) : to_16<false>(value);
+            }
+        }
+
+        if(!pair)
+        {
+            break;
+        }
+
+        // Interleaved UV of 2x2 blocks, the plane follows the luma rows at the same pitch
+        uint8_t* uv_plane = m_dst + static_cast<ptrdiff_t>(m_dst_pitch) * m_height;
+        uint16_t* out = reinterpret_cast<uint16_t*>(row_at(uv_plane, m_dst_pitch, y / 2)) + x0;
+        for(uint32_t x = 0; x + 1 < columns; x += 2)
+        {
+            const Pixel block = average(
+                average(pixel(0, x), pixel(0, x + 1)),
+                average(pixel(1, x), pixel(1, x + 1)));
+
+            int32_t u = 0;
+            int32_t v = 0;
+            chroma(block, u, v);
+            out[x] = ten ? to_16<true>(u) : to_16<false>(u);
+            out[x + 1] = ten ? to_16<true>(v) : to_16<false>(v);
+        }
+        break;
+    }
+    case Encoding::Y210:
+    {
+        // Y0 U Y1 V per pixel pair, chroma of horizontal pairs
+        for(uint32_t index = 0; index < rows; index++)
+        {
+            uint16_t* out = reinterpret_cast<uint16_t*>(row_at(m_dst, m_dst_pitch, y + index)) + x0 * 2;
+            for(uint32_t x = 0; x < columns; x += 2)
+            {
+                const Pixel p0 = pixel(index, x);
+                const Pixel p1 = x + 1 < columns ? pixel(index, x + 1) : p0;
+
+                int32_t u = 0;
+                int32_t v = 0;
+                chroma(average(p0, p1), u, v);
+                out[x * 2] = to_16<true>(luma(p0));
+                out[x * 2 + 1] = to_16<true>(u);
+                if(x + 1 < columns)
+                {
+                    out[x * 2 + 2] = to_16<true>(luma(p1));
+                    out[x * 2 + 3] = to_16<true>(v);
+                }
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+}
@@ -0,0 +1,124 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "ColorKernels.h"
+#include "VideoFormats.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace cdi {
+
+class ThreadPlacer;
+class WorkerPool;
+
+// Bayer mosaic to any Encoding. Samples are processed at 12 bit in vertical strips of
+// a few hundred columns whose rows live in small ring buffers, so every source row is
+// read once per strip and the working set stays in the L1 cache. Horizontal slices of
+// the frame run on the worker threads.
+class Demosaic
+{
+    Demosaic(const Demosaic&);
+    Demosaic& operator=(const Demosaic&);
+
+public:
+    Demosaic();
+    ~Demosaic();
+
+    bool init(
+        const uint32_t& width,
+        const uint32_t& height,
+        const BayerFormat& format,
+        const Encoding& output,
+        const ColorSpace& color,
+        const DemosaicOptions& options,
+        const std::shared_ptr<ThreadPlacer>& placer);
+
+    // 'src' is the first row of the mosaic. 'dst' is the top image row of the output
+    // and 'dst_pitch' the distance to the next image row, negative for bottom-up RGB.
+    // Further planes follow the first one as in FrameLayout, with rows at 'dst_pitch'
+    // (half of it for the I420 chroma planes).
+    void run(const uint8_t* src, const int32_t& src_pitch, uint8_t* dst, const int32_t& dst_pitch);
+
+private:
+    // Fixed point RGB to YUV in the 12 bit domain
+    struct Weights
+    {
+        int32_t yr, yg, yb;
+        int32_t ur, ug, ub;
+        int32_t vr, vg, vb;
+        int32_t y_offset;
+    };
+
+    struct Scratch
+    {
+        std::vector<int16_t> raw;   // Ring of 8 mosaic rows
+        std::vector<int16_t> green; // Ring of 4 interpolated green rows
+        std::vector<int16_t> rgb;   // Two output rows, planar R, G, B
+        std::vector<uint8_t> bgr;   // Two packed 8 bit rows for the I420 kernel
+    };
+
+    template<bool EDGE>
+    void strip(Scratch& scratch, const uint32_t& x0, const uint32_t& columns, const uint32_t& y0, const uint32_t& y1);
+    void load_row(Scratch& scratch, const int32_t& row, const uint32_t& x0, const uint32_t& columns) const;
+    void write_rows(Scratch& scratch, const uint32_t& y, const bool& pair, const uint32_t& x0, const uint32_t& columns);
+    void uninit();
+
+private:
+    std::unique_ptr<WorkerPool> m_pool;
+    std::vector<Scratch> m_scratch;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_slice_rows;
+    uint32_t m_slices;
+    BayerFormat m_format;
+    uint32_t m_red_row; // Parity of the rows and columns holding red
+    uint32_t m_red_column;
+    uint32_t m_shift_left; // To 12 bit
+    uint32_t m_shift_right;
+    uint16_t m_mask;
+    bool m_edge;
+    Encoding m_output;
+    Weights m_weights;
+    kernels::RgbToI420 m_rgb_to_i420;
+
+    // Frame of the current run
+    const uint8_t* m_src;
+    int32_t m_src_pitch;
+    uint8_t* m_dst;
+    int32_t m_dst_pitch;
+};
+
+}
@@ -30,18 +30,130 @@
     OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#define NOMINMAX
 #include "Device.h"
+#include "ChangeGate.h"
+#include "Clock.h"
 #include "ColorTransform.h"
+#include "ExternalBuffer.h"
+#include "FrameLayout.h"
+#include "FrameRing.h"
+#include "FrameStats.h"
+#include "JpegEncoder.h"
+#include "Orientation.h"
+#include "Pyramid.h"
+#include "ReaderCallback.h"
+#include "Recorder.h"
+#include "ThreadPlacer.h"
+#include "Trace.h"
+#include "VideoFormats.h"
 #include "ScopeGuard.inl"
 #include "Macros.inl"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <limits>
 
 
 namespace cdi {
 
+namespace {
+
+// Where the luma (or a luma like channel) of a native frame lives
+bool luma_layout(const GUID& format, const uint32_t& width, LumaLayout& layout)
+{
+    BayerFormat bayer;
+    if(format == MFVideoFormat_NV12 || format == MFVideoFormat_I420
+       || format == MFVideoFormat_IYUV || format == MFVideoFormat_YV12)
+    {
+        layout.offset = 0;
+        layout.step = 1;
+        layout.pitch = static_cast<int32_t>(width);
+    }
+    else if(format == MFVideoFormat_YUY2 || format == MFVideoFormat_YVYU)
+    {
+        layout.offset = 0;
+        layout.step = 2;
+        layout.pitch = static_cast<int32_t>(width * 2);
+    }
+    else if(format == MFVideoFormat_UYVY)
+    {
+        layout.offset = 1;
+        layout.step = 2;
+        layout.pitch = static_cast<int32_t>(width * 2);
+    }
+    else if(format == MFVideoFormat_P010 || format == MFVideoFormat_P016
+            || format == MFVideoFormat_L16 || format == fourcc_subtype("Y16 "))
+    {
+        // High byte of the little endian 16 bit samples
+        layout.offset = 1;
+        layout.step = 2;
+        layout.pitch = static_cast<int32_t>(width * 2);
+    }
+    else if(bayer_format(format, bayer) && bayer.bits == 8)
+    {
+        // Every sample of the mosaic, close enough to luma for the gate and statistics
+        layout.offset = 0;
+        layout.step = 1;
+        layout.pitch = static_cast<int32_t>(width);
+    }
+    else if(format == MFVideoFormat_Y210)
+    {
+        layout.offset = 1;
+        layout.step = 4;
+        layout.pitch = static_cast<int32_t>(width * 4);
+    }
+    else if(format == MFVideoFormat_RGB24)
+    {
+        // Green channel
+        layout.offset = 1;
+        layout.step = 3;
+        layout.pitch = static_cast<int32_t>(width * 3);
+    }
+    else if(format == MFVideoFormat_RGB32 || format == MFVideoFormat_ARGB32)
+    {
+        layout.offset = 1;
+        layout.step = 4;
+        layout.pitch = static_cast<int32_t>(width * 4);
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// 8 bit YUV which the JPEG encoder takes as it is
+bool jpeg_format(const GUID& format, kernels::YuvFormat& yuv)
+{
+    if(format == MFVideoFormat_I420 || format == MFVideoFormat_IYUV)
+    {
+        yuv = kernels::YuvFormat::I420;
+    }
+    else if(format == MFVideoFormat_NV12)
+    {
+        yuv = kernels::YuvFormat::NV12;
+    }
+    else if(format == MFVideoFormat_YUY2)
+    {
+        yuv = kernels::YuvFormat::YUY2;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+}
+
 Device::Device()
     : m_device(nullptr)
+    , m_trace_stream(0)
     , m_source(nullptr)
     , m_attributes(nullptr)
     , m_reader(nullptr)
@@ -49,8 +161,44 @@ Device::Device()
     , m_device_output(nullptr)
     , m_width(0)
     , m_height(0)
+    , m_frame_width(0)
+    , m_frame_height(0)
     , m_output_format(Encoding::UNKNOWN)
     , m_size(0)
+    , m_timestamp(0)
+    , m_locked_data(nullptr)
+    , m_pyramid_valid(false)
+    , m_fused_stats(false)
+    , m_jpeg_format(kernels::YuvFormat::I420)
+    , m_jpeg_native(false)
+    , m_sequence(0)
+    , m_changed(true)
+    , m_skipped(0)
+    , m_keyframe(true)
+    , m_resync(false)
+    , m_open_start(0)
+    , m_first_frame(0)
+    , m_presampled(nullptr)
+    , m_keep_source(false)
+    , m_callback(nullptr)
+    , m_asynchronous(false)
+    , m_pending(nullptr)
+    , m_stopped(false)
+    , m_reading(false)
+    , m_pausing(false)
+    , m_flushed(false)
+    , m_consumer_gap(false)
+    , m_watch_exit(false)
+    , m_source_replaced(false)
+    , m_stale(false)
+    , m_generation(0)
+    , m_frame_divisor(1)
+    , m_frame_interval(0)
+    , m_frames(0)
+    , m_delivered(0)
+    , m_dropped(0)
+    , m_convert_time(0)
+    , m_latency(0)
 {
 }
 
@@ -61,10 +209,13 @@ Device::~Device()
 
 bool Device::init(
     IMFActivate* device,
+    IMFMediaSource* source,
+    const bool& keep_source,
     const uint32_t& width,
     const uint32_t& height,
     const GUID& mf_format,
-    const Encoding& output_format)
+    const Encoding& output_format,
+    const StreamOptions& options)
 {
     cdi::util::ScopeGuard uninit_guard;
     uninit_guard += [this]() { uninit(); };
@@ -74,10 +225,15 @@ bool Device::init(
         return false;
     }
 
+    m_open_start = clock_now();
+    m_placer = std::make_shared<ThreadPlacer>(options.threads);
     m_device = device;
+    m_device->AddRef();
+    m_keep_source = keep_source && source != nullptr;
     m_width = width;
     m_height = height;
     m_output_format = output_format;
+    m_options = options;
 
     // Fetch device name
     {
@@ -89,147 +245,1689 @@ bool Device::init(
         device_name = nullptr;
     }
 
-    // Activate
-    FAILED_RETURN(m_device->ActivateObject(IID_PPV_ARGS(&m_source)), false);
+    m_trace_stream = trace::register_stream(m_name);
+
+    // Activate, unless the enumeration did already
+    int64_t mark = clock_now();
+    if(source != nullptr)
+    {
+        m_source = source;
+        m_source->AddRef();
+    }
+    else
+    {
+        FAILED_RETURN(m_device->ActivateObject(IID_PPV_ARGS(&m_source)), false);
+        m_timings.activate = clock_now() - mark;
+        mark = clock_now();
+    }
 
     // Create video attribute
-    FAILED_RETURN(MFCreateAttributes(&m_attributes, 1), false);
+    FAILED_RETURN(MFCreateAttributes(&m_attributes, 2), false);
     FAILED_RETURN(m_attributes->SetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE, MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID), false);
 
+    // A source kept by a session outlives the reader
+    if(m_keep_source)
+    {
+        FAILED_RETURN(m_attributes->SetUINT32(MF_SOURCE_READER_DISCONNECT_MEDIASOURCE_ON_SHUTDOWN, TRUE), false);
+    }
+
+    // Reads complete on a worker thread of the reader instead of blocking the caller, also when
+    // the watchdog needs the caller not to block on a stalled device
+    if(options.asynchronous || options.watchdog.enabled)
+    {
+        m_callback = new ReaderCallback(this);
+        m_asynchronous = true;
+        FAILED_RETURN(m_attributes->SetUnknown(MF_SOURCE_READER_ASYNC_CALLBACK, m_callback), false);
+    }
+
     // Create Reader
     FAILED_RETURN(MFCreateSourceReaderFromMediaSource(m_source, m_attributes, &m_reader), false);
 
     // Fetch SourceReaderEx
     FAILED_RETURN(m_reader->QueryInterface(IID_PPV_ARGS(&m_readerEx)), false);
 
+    // Connect reader to the media output
+    if(!negotiate(mf_format))
+    {
+        return false;
+    }
+
+    m_timings.reader = clock_now() - mark;
+    mark = clock_now();
+
+    if(!setup(mf_format))
+    {
+        return false;
+    }
+
+    m_timings.setup = clock_now() - mark;
+    mark = clock_now();
+
+    if(m_asynchronous)
+    {
+        // Frames flow from here on, the first lock waits for the first of them
+        if(!start_reading())
+        {
+            return false;
+        }
+
+        if(options.watchdog.enabled)
+        {
+            m_watchdog.init(options.watchdog, frame_interval(), clock_now());
+            m_watch_thread = std::thread([this]() { watch(); });
+        }
+    }
+    else if(options.presample == Presample::SYNCHRONOUS)
+    {
+        // Presample, this ensures next sample will have a valid data
+        sample();
+        m_timings.presample = clock_now() - mark;
+    }
+    else if(options.presample == Presample::DEFERRED)
+    {
+        // Starting the stream takes most of the first read, overlap it with the caller
+        m_presample = std::async(std::launch::async, [this]()
+        {
+            m_placer->place();
+            m_presampled = read_sample();
+        });
+    }
+
+    uninit_guard.cancel();
+
+    return true;
+}
+
+bool Device::negotiate(const GUID& mf_format)
+{
     // Create device output
+    SAFE_RELEASE(m_device_output);
     FAILED_RETURN(MFCreateMediaType(&m_device_output), false);
     FAILED_RETURN(m_device_output->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video), false);
     FAILED_RETURN(m_device_output->SetGUID(MF_MT_SUBTYPE, mf_format), false);
     FAILED_RETURN(MFSetAttributeSize(m_device_output, MF_MT_FRAME_SIZE, m_width, m_height), false);
 
-    // Connect reader to the media output
     FAILED_RETURN(m_reader->SetCurrentMediaType(0, nullptr, m_device_output), false);
 
+    return true;
+}
+
+GUID Device::output_subtype(const Encoding& encoding)
+{
     GUID mf_video_format = MFVideoFormat_I420;
-    switch (output_format)
+    switch (encoding)
     {
     case Encoding::I420:
         mf_video_format = MFVideoFormat_I420;
-        m_size = m_width * m_height + (m_width * m_height >> 2) * 2;
         break;
     case Encoding::RGB24:
         mf_video_format = MFVideoFormat_RGB24;
-        m_size = m_width * m_height * 3;
         break;
     case Encoding::RGBA32:
         mf_video_format = MFVideoFormat_RGB32;
-        m_size = m_width * m_height * 4;
+        break;
+    case Encoding::P010:
+        mf_video_format = MFVideoFormat_P010;
+        break;
+    case Encoding::P016:
+        mf_video_format = MFVideoFormat_P016;
+        break;
+    case Encoding::Y210:
+        mf_video_format = MFVideoFormat_Y210;
+        break;
+    case Encoding::GRAY16:
+        mf_video_format = MFVideoFormat_L16;
+        break;
+    case Encoding::MJPEG:
+        mf_video_format = MFVideoFormat_MJPG;
+        break;
+    case Encoding::H264:
+        mf_video_format = MFVideoFormat_H264;
         break;
     default:
         break;
     }
 
+    return mf_video_format;
+}
+
+int64_t Device::frame_interval() const
+{
+    cdi::util::ScopeGuard guard;
+    IMFMediaType* type = nullptr;
+    FAILED_RETURN(m_reader->GetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), &type), 0);
+    guard += [&type]() { SAFE_RELEASE(type); };
+
+    UINT32 numerator = 0;
+    UINT32 denominator = 0;
+    FAILED_RETURN(MFGetAttributeRatio(type, MF_MT_FRAME_RATE, &numerator, &denominator), 0);
+    if(numerator == 0)
+    {
+        return 0;
+    }
+
+    return static_cast<int64_t>(denominator) * 10000000 / numerator;
+}
+
+bool Device::setup(const GUID& mf_format)
+{
+    m_transform.reset();
+    m_pyramid.reset();
+    m_gate.reset();
+    m_stats.reset();
+    m_fused_stats = false;
+    m_pyramid_valid = false;
+    m_changed = true;
+    m_skipped = 0;
+    m_keyframe = true;
+
+    // Decoding starts at a keyframe, also when the device begins with something else
+    m_resync = m_output_format == Encoding::H264;
+
+    const GUID mf_video_format = output_subtype(m_output_format);
+
+    // The conversion rotates, width and height are swapped for quarter turns
+    const bool swapped = kernels::swaps_axes(m_options.orientation);
+    m_frame_width = swapped ? m_height : m_width;
+    m_frame_height = swapped ? m_width : m_height;
+
+    m_size = 0;
+    FrameLayout layout;
+    if(layout.init(m_frame_width, m_frame_height, m_output_format))
+    {
+        m_size = layout.size();
+    }
+
     m_transform = std::make_unique<ColorTransform>();
-    if (!m_transform->init(m_device_output, mf_video_format))
+    if (!m_transform->init(m_device_output, mf_video_format, m_options, m_placer))
     {
         return false;
     }
 
-    // Presample, this ensures next sample will have a valid data
-    sample();
+    // Compressed formats have no luma to look at, gate and statistics stay off for them
+    const bool has_luma = luma_layout(mf_format, m_width, m_luma);
+    m_jpeg_native = kernels::is_identity(m_options.orientation) && jpeg_format(mf_format, m_jpeg_format);
+    if(m_options.change_gate.enabled && has_luma)
+    {
+        m_gate = std::make_unique<ChangeGate>();
+        if(!m_gate->init(m_width, m_height, m_options.change_gate))
+        {
+            return false;
+        }
+    }
 
-    uninit_guard.cancel();
+    if(m_options.statistics.enabled && has_luma)
+    {
+        m_stats = std::make_unique<FrameStats>();
+        m_transform->set_statistics(m_stats.get(), m_options.statistics);
+        m_fused_stats = m_transform->fuses_statistics();
+    }
+
+    if(!m_options.pyramid.empty())
+    {
+        m_pyramid = std::make_unique<Pyramid>();
+        if(!m_pyramid->init(
+            m_frame_width,
+            m_frame_height,
+            m_output_format,
+            m_options.pyramid,
+            m_options.color,
+            m_options.orientation.top_down))
+        {
+            return false;
+        }
+    }
+
+    m_frame_interval = frame_interval();
+
+    if(m_options.pretrigger.seconds > 0 && !setup_ring())
+    {
+        return false;
+    }
 
     return true;
 }
 
-void Device::sample()
+bool Device::setup_ring()
 {
-    if(m_reader == nullptr)
+    const PretriggerOptions& options = m_options.pretrigger;
+
+    size_t capacity = options.bytes;
+    if(capacity == 0)
     {
-        return;
-    }
+        // Frames of the native format at the nominal rate, devices without one count as 30 fps
+        size_t frame = MFGetAttributeUINT32(m_device_output, MF_MT_SAMPLE_SIZE, 0);
+        if(frame == 0 || FrameLayout::is_compressed(m_output_format))
+        {
+            frame = static_cast<size_t>(m_width) * m_height * 3 / 2;
+        }
 
-    DWORD stream_index = 0;
-    DWORD flags = 0;
-    LONGLONG timestamp = 0;
-    IMFSample* sample = nullptr;
+        const int64_t interval = m_frame_interval > 0 ? static_cast<int64_t>(m_frame_interval) : 333333;
+        const uint64_t frames = (static_cast<uint64_t>(options.seconds) * 10000000 + interval - 1) / interval + 1;
+        capacity = static_cast<size_t>(frames * FrameRing::span(frame));
+    }
 
-    FAILED_RETURN(m_reader->ReadSample(
-        static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM),
-        0,
-        &stream_index,
-        &flags,
-        &timestamp,
-        &sample),);
+    // Kept over reconfigurations it is large enough for, the frames of the old format go
+    if(m_ring && m_ring->capacity() >= capacity)
+    {
+        m_ring->clear();
+        return true;
+    }
 
-    if(sample == nullptr)
+    std::shared_ptr<FrameRing> ring = std::make_shared<FrameRing>();
+    if(!ring->init(capacity, m_placer->memory_node(), options.spill_path))
     {
-        return;
+        return false;
     }
 
-    // call color converter here
-    m_transform->transform(sample);
-    SAFE_RELEASE(sample);
+    m_ring = ring;
+
+    return true;
 }
 
-const void* Device::lock(size_t& bytes)
+bool Device::reconfigure(
+    const uint32_t& width,
+    const uint32_t& height,
+    const GUID& mf_format,
+    const Encoding& output_format)
 {
+    std::lock_guard<std::mutex> recover_lock(m_recover_mutex);
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    bytes = 0;
-    const void* data = nullptr;
+    if(m_reader == nullptr || m_locked_data != nullptr)
+    {
+        return false;
+    }
 
-    if(m_transform)
+    const int64_t start = clock_now();
+
+    // A deferred first frame has the old format
+    if(m_presample.valid())
     {
-        data = m_transform->lock(bytes);
+        m_presample.wait();
+        m_presample = std::future<void>();
     }
+    SAFE_RELEASE(m_presampled);
 
-    return data;
+    pause_reading();
+    m_recovered_transform.reset();
+
+    // Queued frames have the old format as well
+    if(!m_asynchronous)
+    {
+        m_reader->Flush(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM));
+    }
+
+    GUID previous_format = GUID_NULL;
+    m_device_output->GetGUID(MF_MT_SUBTYPE, &previous_format);
+    const uint32_t previous_width = m_width;
+    const uint32_t previous_height = m_height;
+    const Encoding previous_output = m_output_format;
+
+    m_width = width;
+    m_height = height;
+    m_output_format = output_format;
+
+    bool result = negotiate(mf_format);
+    const int64_t negotiated = clock_now();
+    result = result && setup(mf_format);
+
+    if(!result)
+    {
+        // Back to the configuration which worked
+        m_width = previous_width;
+        m_height = previous_height;
+        m_output_format = previous_output;
+        if(!negotiate(previous_format) || !setup(previous_format))
+        {
+            m_transform.reset();
+        }
+    }
+    else
+    {
+        // Timings of the reconfiguration replace the ones of the open
+        m_timings = OpenTimings();
+        m_timings.reader = negotiated - start;
+        m_timings.setup = clock_now() - negotiated;
+        m_open_start = start;
+        m_first_frame = 0;
+    }
+
+    if(m_asynchronous)
+    {
+        start_reading();
+    }
+
+    return result;
 }
 
-void Device::unlock()
+bool Device::start_reading()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        SAFE_RELEASE(m_pending);
+        m_current_info = FrameSnapshot();
+        m_consumer_gap = false;
+        m_pausing = false;
+        m_stopped = false;
+        m_reading = true;
+        m_watchdog.rearm(clock_now());
+    }
 
-    if(m_transform)
+    if(FAILED(m_reader->ReadSample(
+        static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), 0, nullptr, nullptr, nullptr, nullptr)))
     {
-        m_transform->unlock();
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        m_reading = false;
+        m_stopped = true;
+        return false;
     }
+
+    return true;
 }
 
-uint32_t Device::width() const
+void Device::pause_reading()
 {
-    return m_width;
+    if(!m_asynchronous)
+    {
+        return;
+    }
+
+    // The read in flight completes within a frame and is not followed by another one
+    std::unique_lock<std::mutex> lock(m_async_mutex);
+    m_pausing = true;
+    m_arrived.wait(lock, [this]() { return !m_reading; });
+
+    // Drop what the reader queued meanwhile, completion is reported through on_flush()
+    m_flushed = false;
+    lock.unlock();
+    const HRESULT flushing = m_reader->Flush(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM));
+    lock.lock();
+    if(SUCCEEDED(flushing))
+    {
+        m_arrived.wait(lock, [this]() { return m_flushed; });
+    }
 }
 
-uint32_t Device::height() const
+void Device::on_flush()
 {
-    return m_height;
+    std::lock_guard<std::mutex> lock(m_async_mutex);
+    m_flushed = true;
+    m_arrived.notify_all();
 }
 
-Encoding Device::encoding() const
+void Device::sample()
 {
-    return m_output_format;
+    IMFSample* sample = next_sample();
+
+    // The last good frame stays
+    m_stale = sample == nullptr;
+    if(sample == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_recovered_transform)
+        {
+            m_transform = std::move(m_recovered_transform);
+        }
+    }
+
+    // call color converter here
+    trace::set_frame(m_trace_stream, sequence());
+    const int64_t start = clock_now();
+    const bool transformed = m_transform->transform(sample);
+    SAFE_RELEASE(sample);
+    converted(transformed);
+
+    // The last good frame stays, also when the conversion failed
+    if(!transformed)
+    {
+        m_stale = true;
+        return;
+    }
+    delivered(start);
+
+    m_pyramid_valid = false;
 }
 
-size_t Device::size() const
+bool Device::read_into(void* dst, const size_t& stride)
 {
-    return m_size;
+    FrameLayout layout;
+    if(dst == nullptr || !layout.init(m_frame_width, m_frame_height, m_output_format))
+    {
+        return false;
+    }
+
+    // Planes follow each other, strides scale with the plane widths
+    FramePlane planes[3];
+    uint8_t* data = static_cast<uint8_t*>(dst);
+    for(uint32_t i = 0; i < layout.plane_count(); i++)
+    {
+        const FrameLayout::Plane& plane = layout.plane(i);
+        planes[i].data = data;
+        planes[i].stride = stride * plane.stride / layout.plane(0).stride;
+        data += planes[i].stride * plane.height;
+    }
+
+    return read_into(planes, layout.plane_count());
 }
 
-void Device::uninit()
+bool Device::read_into(const FramePlane* planes, const uint32_t& plane_count)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    m_transform.reset();
+    FrameLayout layout;
+    if(planes == nullptr
+       || m_transform == nullptr
+       || m_locked_data != nullptr
+       || !layout.init(m_frame_width, m_frame_height, m_output_format)
+       || plane_count != layout.plane_count())
+    {
+        return false;
+    }
 
-    SAFE_RELEASE(m_reader);
-    SAFE_RELEASE(m_readerEx);
-    SAFE_RELEASE(m_attributes);
+    // The converter writes a single buffer with one pitch, which works when the planes are
+    // laid out like the internal frame apart from the row distance
+    const size_t stride = planes[0].stride;
+    bool single = true;
+    size_t length = 0;
+    for(uint32_t i = 0; i < plane_count; i++)
+    {
+        const FrameLayout::Plane& plane = layout.plane(i);
+        if(planes[i].data == nullptr || planes[i].stride < plane.width)
+        {
+            return false;
+        }
+
+        if(i > 0)
+        {
+            const uint8_t* expected = static_cast<const uint8_t*>(planes[i - 1].data)
+                + planes[i - 1].stride * layout.plane(i - 1).height;
+            single = single
+                && planes[i].data == expected
+                && planes[i].stride * layout.plane(0).stride == stride * plane.stride;
+        }
+
+        length += planes[i].stride * plane.height;
+    }
+
+    single = single && length <= std::numeric_limits<DWORD>::max();
+
+    IMFSample* sample = next_sample();
+    m_stale = sample == nullptr;
+    if(sample == nullptr)
+    {
+        return false;
+    }
+
+    cdi::util::ScopeGuard guard;
+    guard += [&sample]() { SAFE_RELEASE(sample); };
+
+    if(m_recovered_transform)
+    {
+        m_transform = std::move(m_recovered_transform);
+    }
+
+    // The internal frame is replaced or stale from here on
+    m_pyramid_valid = false;
+    trace::set_frame(m_trace_stream, sequence());
+
+    const int64_t start = clock_now();
+    bool direct = false;
+    if(single)
+    {
+        // RGB is bottom-up, the top image row is the last one in memory
+        uint8_t* base = static_cast<uint8_t*>(planes[0].data);
+        const bool bottom_up = m_transform->bottom_up();
+        uint8_t* scanline0 = bottom_up ? base + stride * (m_frame_height - 1) : base;
+        const LONG pitch = bottom_up ? -static_cast<LONG>(stride) : static_cast<LONG>(stride);
+
+        ExternalBuffer* target = new ExternalBuffer(
+            base, length, scanline0, pitch, stride == layout.plane(0).stride);
+        const bool transformed = m_transform->transform(sample, target, direct);
+
+        // The caller gets its memory back, nothing may reach it through the buffer anymore
+        target->detach();
+        target->Release();
+
+        converted(transformed);
+        if(!transformed)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        const bool transformed = m_transform->transform(sample);
+        converted(transformed);
+        if(!transformed)
+        {
+            return false;
+        }
+    }
+
+    if(direct)
+    {
+        delivered(start);
+        return true;
+    }
+
+    // Copy out of the internal frame
+    size_t bytes = 0;
+    const uint8_t* data = static_cast<const uint8_t*>(m_transform->lock(bytes));
+    if(data == nullptr || bytes < layout.size())
+    {
+        m_transform->unlock();
+        return false;
+    }
+
+    for(uint32_t i = 0; i < plane_count; i++)
+    {
+        const FrameLayout::Plane& plane = layout.plane(i);
+        const uint8_t* src = data + plane.offset;
+        uint8_t* dst = static_cast<uint8_t*>(planes[i].data);
+        for(uint32_t row = 0; row < plane.height; row++)
+        {
+            std::memcpy(dst + planes[i].stride * row, src + static_cast<size_t>(plane.stride) * row, plane.width);
+        }
+    }
+
+    m_transform->unlock();
+    delivered(start);
+
+    return true;
+}
+
+size_t Device::snapshot_jpeg(const JpegOptions& options, void* dst, const size_t& dst_size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(dst == nullptr
+       || m_transform == nullptr
+       || m_locked_data != nullptr
+       || (!m_jpeg_native && m_output_format != Encoding::I420))
+    {
+        return 0;
+    }
+
+    if(!m_jpeg)
+    {
+        m_jpeg = std::make_unique<JpegEncoder>();
+    }
+
+    if(m_jpeg->quality() != options.quality && !m_jpeg->init(options.quality))
+    {
+        return 0;
+    }
+
+    IMFSample* sample = next_sample();
+    m_stale = sample == nullptr;
+    if(sample == nullptr)
+    {
+        return 0;
+    }
+
+    cdi::util::ScopeGuard guard;
+    guard += [&sample]() { SAFE_RELEASE(sample); };
+
+    if(m_recovered_transform)
+    {
+        m_transform = std::move(m_recovered_transform);
+    }
+
+    // The internal frame is replaced or stale from here on
+    m_pyramid_valid = false;
+    trace::set_frame(m_trace_stream, sequence());
+
+    const int64_t start = clock_now();
+    size_t bytes = 0;
+    const bool native = encode_jpeg(sample, *m_jpeg, options, dst, dst_size, bytes);
+    if(native && m_fused_stats)
+    {
+        // Nothing converts the frame
+        inspect(sample, false, true);
+    }
+    else if(!native)
+    {
+        // The I420 frame of the stream, rotated and mirrored as lock() returns it
+        const bool transformed = m_transform->transform(sample);
+        converted(transformed);
+
+        size_t frame_bytes = 0;
+        const uint8_t* frame = transformed ? static_cast<const uint8_t*>(m_transform->lock(frame_bytes)) : nullptr;
+        if(frame != nullptr && frame_bytes >= m_size)
+        {
+            bytes = m_jpeg->encode(
+                kernels::YuvFormat::I420,
+                frame,
+                static_cast<int32_t>(m_frame_width),
+                m_frame_width,
+                m_frame_height,
+                options.scale,
+                m_options.color.range,
+                static_cast<uint8_t*>(dst),
+                dst_size);
+        }
+        m_transform->unlock();
+    }
+
+    if(bytes != 0)
+    {
+        delivered(start);
+    }
+
+    return bytes;
+}
+
+bool Device::encode_jpeg(
+    IMFSample* sample,
+    JpegEncoder& encoder,
+    const JpegOptions& options,
+    void* dst,
+    const size_t& dst_size,
+    size_t& bytes) const
+{
+    bytes = 0;
+    if(!m_jpeg_native)
+    {
+        return false;
+    }
+
+    cdi::util::ScopeGuard guard;
+
+    IMFMediaBuffer* buffer = nullptr;
+    FAILED_RETURN(sample->ConvertToContiguousBuffer(&buffer), true);
+    guard += [&buffer]() { SAFE_RELEASE(buffer); };
+
+    // Prefer the real pitch of 2D buffers, fall back to the packed layout
+    IMF2DBuffer* buffer_2d = nullptr;
+    BYTE* data = nullptr;
+    LONG pitch = m_luma.pitch;
+    if(SUCCEEDED(buffer->QueryInterface(IID_PPV_ARGS(&buffer_2d))))
+    {
+        guard += [&buffer_2d]() { SAFE_RELEASE(buffer_2d); };
+        FAILED_RETURN(buffer_2d->Lock2D(&data, &pitch), true);
+        guard += [&buffer_2d]() { buffer_2d->Unlock2D(); };
+    }
+    else
+    {
+        DWORD max_length = 0;
+        DWORD length = 0;
+        FAILED_RETURN(buffer->Lock(&data, &max_length, &length), true);
+        guard += [&buffer]() { buffer->Unlock(); };
+
+        // Chroma planes of 4:2:0 add half the luma plane
+        const bool planar = m_jpeg_format != kernels::YuvFormat::YUY2;
+        const DWORD luma_size = static_cast<DWORD>(m_luma.pitch) * m_height;
+        if(length < (planar ? luma_size + luma_size / 2 : luma_size))
+        {
+            return true;
+        }
+    }
+
+    bytes = encoder.encode(
+        m_jpeg_format,
+        data,
+        pitch,
+        m_width,
+        m_height,
+        options.scale,
+        m_options.color.range,
+        static_cast<uint8_t*>(dst),
+        dst_size);
+
+    return true;
+}
+
+bool Device::dump(
+    const int64_t& since,
+    const std::wstring& path,
+    const Encoding& encoding,
+    std::unique_ptr<ICodec> codec)
+{
+    std::shared_ptr<FrameRing> ring;
+    std::unique_ptr<ColorTransform> transform = std::make_unique<ColorTransform>();
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // The frames of the ring have the current device format, setup() empties it on a change
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(!m_ring
+           || m_device_output == nullptr
+           || !transform->init(m_device_output, output_subtype(encoding), m_options, m_placer))
+        {
+            return false;
+        }
+
+        ring = m_ring;
+        width = m_frame_width;
+        height = m_frame_height;
+    }
+
+    std::vector<FrameRing::Entry> entries;
+    ring->collect(since, entries);
+    if(entries.empty())
+    {
+        return false;
+    }
+
+    Recorder recorder;
+    if(!recorder.init(path, width, height, encoding, m_name, std::move(codec)))
+    {
+        return false;
+    }
+
+    size_t largest = 0;
+    for(const FrameRing::Entry& entry : entries)
+    {
+        largest = std::max(largest, entry.size);
+    }
+
+    // One buffer for all frames, each is copied out of the ring before it is converted
+    cdi::util::ScopeGuard guard;
+    IMFMediaBuffer* buffer = nullptr;
+    IMFSample* sample = nullptr;
+    guard += [&]()
+    {
+        SAFE_RELEASE(sample);
+        SAFE_RELEASE(buffer);
+    };
+
+    FAILED_RETURN(MFCreateMemoryBuffer(static_cast<DWORD>(largest), &buffer), false);
+    FAILED_RETURN(MFCreateSample(&sample), false);
+    FAILED_RETURN(sample->AddBuffer(buffer), false);
+
+    bool gap = false;
+    for(const FrameRing::Entry& entry : entries)
+    {
+        BYTE* data = nullptr;
+        FAILED_RETURN(buffer->Lock(&data, nullptr, nullptr), false);
+        const bool copied = ring->read(entry, data, largest);
+        buffer->Unlock();
+
+        // The capture overtook the dump, H.264 goes on at the next keyframe
+        gap = !copied || (gap && !entry.keyframe);
+        if(gap)
+        {
+            continue;
+        }
+
+        FAILED_RETURN(buffer->SetCurrentLength(static_cast<DWORD>(entry.size)), false);
+        if(!transform->transform(sample))
+        {
+            return false;
+        }
+
+        size_t bytes = 0;
+        const void* frame = transform->lock(bytes);
+        const bool appended = frame != nullptr && recorder.append(frame, bytes, entry.timestamp, entry.keyframe);
+        transform->unlock();
+        if(!appended)
+        {
+            return false;
+        }
+    }
+
+    return recorder.close();
+}
+
+bool Device::retain(IMFSample* sample)
+{
+    // Runs for every frame, without a guard nothing is allocated here
+    IMFMediaBuffer* buffer = nullptr;
+    FAILED_RETURN(sample->ConvertToContiguousBuffer(&buffer), false);
+
+    bool retained = false;
+    BYTE* data = nullptr;
+    DWORD max_length = 0;
+    DWORD length = 0;
+    if(SUCCEEDED(buffer->Lock(&data, &max_length, &length)))
+    {
+        retained = m_ring->push(data, length, m_timestamp, m_sequence, m_keyframe);
+        buffer->Unlock();
+    }
+
+    SAFE_RELEASE(buffer);
+
+    return retained;
+}
+
+IMFSample* Device::next_sample()
+{
+    // A recovery replaces reader and callback meanwhile
+    if(m_asynchronous)
+    {
+        return take_sample();
+    }
+
+    if(m_reader == nullptr)
+    {
+        return nullptr;
+    }
+
+    // The deferred presample is the first frame
+    if(m_presample.valid())
+    {
+        m_presample.get();
+
+        IMFSample* sample = m_presampled;
+        m_presampled = nullptr;
+        if(sample != nullptr && accept(sample))
+        {
+            return sample;
+        }
+
+        SAFE_RELEASE(sample);
+    }
+
+    // Unchanged frames are dropped here, read until one gets through the gate
+    for(;;)
+    {
+        IMFSample* sample = read_sample();
+        if(sample == nullptr)
+        {
+            return nullptr;
+        }
+
+        if(!accept(sample))
+        {
+            SAFE_RELEASE(sample);
+            continue;
+        }
+
+        return sample;
+    }
+}
+
+IMFSample* Device::read_sample()
+{
+    trace::Scope scope(trace::Name::READ_SAMPLE, m_trace_stream, m_sequence + 1);
+
+    DWORD stream_index = 0;
+    DWORD flags = 0;
+    LONGLONG timestamp = 0;
+    IMFSample* sample = nullptr;
+
+    FAILED_RETURN(m_reader->ReadSample(
+        static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM),
+        0,
+        &stream_index,
+        &flags,
+        &timestamp,
+        &sample), nullptr);
+
+    return sample;
+}
+
+IMFSample* Device::take_sample()
+{
+    trace::Scope scope(trace::Name::WAIT_FRAME, m_trace_stream, 0);
+
+    std::unique_lock<std::mutex> lock(m_async_mutex);
+    if(m_watchdog.enabled())
+    {
+        // A stopped reader is the watchdog's business, wait for it only until a stall is noticed
+        m_arrived.wait_for(
+            lock,
+            std::chrono::microseconds(m_watchdog.stall_timeout() / 10),
+            [this]() { return m_pending != nullptr || m_watchdog.gave_up(); });
+    }
+    else
+    {
+        m_arrived.wait(lock, [this]() { return m_pending != nullptr || m_stopped; });
+    }
+
+    IMFSample* sample = m_pending;
+    m_pending = nullptr;
+    if(sample != nullptr)
+    {
+        std::swap(m_current_info, m_pending_info);
+        scope.set_sequence(m_current_info.info.sequence);
+    }
+
+    return sample;
+}
+
+bool Device::accept(IMFSample* sample)
+{
+    m_sequence++;
+    m_frames++;
+    trace::Scope scope(trace::Name::INSPECT, m_trace_stream, m_sequence);
+
+    // Not a frame of the reduced rate, nothing is spent on it
+    const uint32_t divisor = m_frame_divisor;
+    if(divisor > 1 && m_sequence % divisor != 0)
+    {
+        return false;
+    }
+
+    // A gap in H.264 leaves the frames after it undecodable up to the next keyframe
+    m_keyframe = m_output_format != Encoding::H264 || MFGetAttributeUINT32(sample, MFSampleExtension_CleanPoint, FALSE) != 0;
+    if(m_resync && !m_keyframe)
+    {
+        return false;
+    }
+    m_resync = false;
+
+    if(m_first_frame == 0)
+    {
+        m_first_frame = clock_now() - m_open_start;
+    }
+
+    // Prefer the capture time reported by the device over the arrival time
+    UINT64 device_timestamp = 0;
+    if(SUCCEEDED(sample->GetUINT64(MFSampleExtension_DeviceTimestamp, &device_timestamp)))
+    {
+        m_timestamp = clock_from_device(device_timestamp);
+    }
+    else
+    {
+        m_timestamp = clock_now();
+    }
+
+    // The ring keeps every frame of the stream, also the ones the change gate holds back
+    if(m_ring)
+    {
+        retain(sample);
+    }
+
+    const bool measure = m_stats && !m_fused_stats;
+    return !(m_gate || measure) || inspect(sample, m_gate != nullptr, measure);
+}
+
+void Device::on_sample(const HRESULT& status, const DWORD& flags, IMFSample* sample)
+{
+    bool stopped = FAILED(status) || (flags & (MF_SOURCE_READERF_ERROR | MF_SOURCE_READERF_ENDOFSTREAM)) != 0;
+    std::function<void(bool)> ready;
+
+    // The stream is being reconfigured, this read is the last one of the old format
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        if(m_pausing)
+        {
+            m_reading = false;
+            m_arrived.notify_all();
+            return;
+        }
+
+        // Any frame shows the device is alive, also one the gate drops
+        if(sample != nullptr)
+        {
+            m_watchdog.frame(clock_now());
+        }
+
+        // Single failed reads are retried, the watchdog takes over when they repeat
+        const bool end = (flags & MF_SOURCE_READERF_ENDOFSTREAM) != 0;
+        if(stopped && !end && m_watchdog.enabled() && !m_watchdog.error())
+        {
+            stopped = false;
+            sample = nullptr;
+        }
+    }
+
+    // Gate and statistics run here in this mode, the consumer only sees their snapshots
+    if(!stopped && sample != nullptr && accept(sample))
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+
+        // Frames the consumer did not get to are dropped, it always gets the latest one. Frames
+        // which depend on the pending one cannot replace it, they go up to the next keyframe.
+        m_consumer_gap = !m_keyframe && (m_consumer_gap || m_pending != nullptr);
+        if(m_pending != nullptr || m_consumer_gap)
+        {
+            m_dropped++;
+        }
+
+        if(!m_consumer_gap)
+        {
+            SAFE_RELEASE(m_pending);
+            m_pending = sample;
+            m_pending->AddRef();
+            snapshot(m_pending_info);
+
+            ready.swap(m_ready);
+            m_arrived.notify_all();
+        }
+    }
+
+    if(ready)
+    {
+        ready(true);
+        ready = nullptr;
+    }
+
+    if(!stopped)
+    {
+        // The next frame is on its way while this one waits for the consumer
+        stopped = FAILED(m_reader->ReadSample(
+            static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), 0, nullptr, nullptr, nullptr, nullptr));
+    }
+
+    if(stopped)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_async_mutex);
+            m_stopped = true;
+            m_reading = false;
+            m_arrived.notify_all();
+
+            // A pending request outlives the recovery
+            if(m_watchdog.enabled())
+            {
+                m_watch_wake.notify_all();
+            }
+            else
+            {
+                ready.swap(m_ready);
+            }
+        }
+
+        if(ready)
+        {
+            ready(false);
+        }
+    }
+}
+
+bool Device::notify_frame(const std::function<void(bool)>& ready)
+{
+    std::unique_lock<std::mutex> lock(m_async_mutex);
+    if(!m_asynchronous || !ready || m_ready)
+    {
+        return false;
+    }
+
+    // A frame which is waiting already, or the end of the stream, is announced right away
+    if(m_pending != nullptr || m_stopped)
+    {
+        const bool arrived = m_pending != nullptr;
+        lock.unlock();
+        ready(arrived);
+        return true;
+    }
+
+    m_ready = ready;
+    return true;
+}
+
+void Device::cancel_notify()
+{
+    std::function<void(bool)> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        ready.swap(m_ready);
+    }
+
+    if(ready)
+    {
+        ready(false);
+    }
+}
+
+OpenTimings Device::open_timings() const
+{
+    OpenTimings timings = m_timings;
+    timings.first_frame = m_first_frame;
+    return timings;
+}
+
+ThreadPlacement Device::placement() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ThreadPlacement placement = m_placer ? m_placer->placement() : ThreadPlacement();
+    if(m_transform)
+    {
+        placement.memory_node = memory_numa_node(m_transform->frame_memory());
+    }
+
+    return placement;
+}
+
+RecoveryStatistics Device::recovery() const
+{
+    std::lock_guard<std::mutex> lock(m_async_mutex);
+    return m_watchdog.statistics();
+}
+
+bool Device::source_replaced() const
+{
+    return m_source_replaced;
+}
+
+uint32_t Device::trace_stream() const
+{
+    return m_trace_stream;
+}
+
+void Device::set_frame_divisor(const uint32_t& divisor)
+{
+    m_frame_divisor = std::max(1u, divisor);
+}
+
+StreamLoad Device::load() const
+{
+    StreamLoad load;
+    load.frames = m_frames;
+    load.delivered = m_delivered;
+    load.dropped = m_dropped;
+    load.convert_time = m_convert_time;
+    load.latency = m_latency;
+    load.frame_interval = m_frame_interval;
+    return load;
+}
+
+void Device::delivered(const int64_t& convert_start)
+{
+    const int64_t now = clock_now();
+    m_convert_time += now - convert_start;
+    m_latency += std::max<int64_t>(0, now - timestamp());
+    m_delivered++;
+}
+
+uint64_t Device::sequence() const
+{
+    return m_asynchronous ? m_current_info.info.sequence : m_sequence;
+}
+
+IMFSample* Device::capture(FrameSnapshot& frame)
+{
+    IMFSample* sample = next_sample();
+    m_stale = sample == nullptr;
+    if(sample == nullptr)
+    {
+        return nullptr;
+    }
+
+    // Frames of the recovered reader start here
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_recovered_transform)
+        {
+            m_transform = std::move(m_recovered_transform);
+            m_generation++;
+        }
+    }
+
+    // The consumers convert with transforms of their own, which leave the statistics out
+    if(m_fused_stats)
+    {
+        inspect(sample, false, true);
+    }
+
+    if(m_asynchronous)
+    {
+        frame = m_current_info;
+    }
+    else
+    {
+        snapshot(frame);
+    }
+
+    if(m_fused_stats)
+    {
+        frame.statistics = m_stats->result();
+    }
+
+    return sample;
+}
+
+std::unique_ptr<ColorTransform> Device::create_transform(const Encoding& encoding) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::unique_ptr<ColorTransform> transform = std::make_unique<ColorTransform>();
+    if(m_device_output == nullptr || !transform->init(m_device_output, output_subtype(encoding), m_options, m_placer))
+    {
+        transform.reset();
+    }
+
+    return transform;
+}
+
+uint32_t Device::generation() const
+{
+    return m_generation;
+}
+
+void Device::converted(const bool& success)
+{
+    std::lock_guard<std::mutex> lock(m_async_mutex);
+    if(!m_watchdog.enabled())
+    {
+        return;
+    }
+
+    if(success)
+    {
+        m_watchdog.converted();
+    }
+    else if(m_watchdog.conversion_error())
+    {
+        m_watch_wake.notify_all();
+    }
+}
+
+void Device::watch()
+{
+    m_placer->place();
+
+    std::unique_lock<std::mutex> lock(m_async_mutex);
+    while(!m_watch_exit)
+    {
+        m_watch_wake.wait_for(lock, std::chrono::microseconds(m_watchdog.period() / 10));
+        if(m_watch_exit || m_pausing)
+        {
+            continue;
+        }
+
+        const Watchdog::Action action = m_watchdog.check(clock_now(), m_stopped);
+        if(action == Watchdog::Action::RECOVER)
+        {
+            lock.unlock();
+            recover();
+            lock.lock();
+            m_watchdog.attempted(clock_now());
+        }
+        else if(action == Watchdog::Action::GIVE_UP)
+        {
+            // For good, lock() stops waiting and a pending request hears about it
+            m_stopped = true;
+            m_arrived.notify_all();
+
+            std::function<void(bool)> ready;
+            ready.swap(m_ready);
+            lock.unlock();
+            if(ready)
+            {
+                ready(false);
+            }
+            lock.lock();
+        }
+    }
+}
+
+bool Device::recover()
+{
+    std::lock_guard<std::mutex> recover_lock(m_recover_mutex);
+
+    // Nothing completes into the device from the old reader after this
+    m_callback->detach();
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        m_reading = false;
+
+        // The glitch lost frames H.264 depends on
+        m_resync = m_output_format == Encoding::H264;
+    }
+
+    cdi::util::ScopeGuard guard;
+    IMFMediaSource* source = nullptr;
+    IMFAttributes* attributes = nullptr;
+    ReaderCallback* callback = nullptr;
+    IMFSourceReader* reader = nullptr;
+    IMFSourceReaderEx* reader_ex = nullptr;
+    guard += [&]()
+    {
+        SAFE_RELEASE(reader_ex);
+        SAFE_RELEASE(reader);
+        SAFE_RELEASE(callback);
+        SAFE_RELEASE(attributes);
+        SAFE_RELEASE(source);
+    };
+
+    // The glitch likely took the source with it, activation hands out the same one until shut down
+    m_device->ShutdownObject();
+    FAILED_RETURN(m_device->ActivateObject(IID_PPV_ARGS(&source)), false);
+
+    FAILED_RETURN(MFCreateAttributes(&attributes, 2), false);
+    FAILED_RETURN(attributes->SetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE, MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID), false);
+    callback = new ReaderCallback(this);
+    FAILED_RETURN(attributes->SetUnknown(MF_SOURCE_READER_ASYNC_CALLBACK, callback), false);
+    FAILED_RETURN(MFCreateSourceReaderFromMediaSource(source, attributes, &reader), false);
+    FAILED_RETURN(reader->QueryInterface(IID_PPV_ARGS(&reader_ex)), false);
+    FAILED_RETURN(reader->SetCurrentMediaType(0, nullptr, m_device_output), false);
+
+    // A fresh conversion, the current one keeps the last good frame until the first new one
+    std::unique_ptr<ColorTransform> transform = std::make_unique<ColorTransform>();
+    if(!transform->init(m_device_output, output_subtype(m_output_format), m_options, m_placer))
+    {
+        return false;
+    }
+    transform->set_statistics(m_stats.get(), m_options.statistics);
+
+    // The old ones are released by the guard, the new source belongs to this device
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(m_source, source);
+        std::swap(m_attributes, attributes);
+        std::swap(m_callback, callback);
+        std::swap(m_reader, reader);
+        std::swap(m_readerEx, reader_ex);
+        m_recovered_transform = std::move(transform);
+        m_keep_source = false;
+        m_source_replaced = true;
+    }
+
+    return start_reading();
+}
+
+void Device::snapshot(FrameSnapshot& snapshot) const
+{
+    snapshot.info = FrameInfo();
+    snapshot.info.sequence = m_sequence;
+    snapshot.info.timestamp = m_timestamp;
+    snapshot.info.changed = m_changed;
+    snapshot.info.keyframe = m_keyframe;
+    snapshot.mask.clear();
+
+    if(m_gate)
+    {
+        snapshot.info.change_score = m_gate->score();
+        snapshot.info.tiles_x = m_gate->tiles_x();
+        snapshot.info.tiles_y = m_gate->tiles_y();
+        snapshot.mask.assign(m_gate->mask(), m_gate->mask() + m_gate->tiles_x() * m_gate->tiles_y());
+    }
+
+    // Fused statistics belong to the consumer's thread, info() hands them out directly
+    if(m_stats && !m_fused_stats)
+    {
+        snapshot.statistics = m_stats->result();
+    }
+}
+
+void Device::stop_reading()
+{
+    if(m_callback == nullptr)
+    {
+        return;
+    }
+
+    // No read completes into the device after this
+    m_callback->detach();
+
+    std::function<void(bool)> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        m_stopped = true;
+        SAFE_RELEASE(m_pending);
+        ready.swap(m_ready);
+        m_arrived.notify_all();
+    }
+
+    if(ready)
+    {
+        ready(false);
+    }
+}
+
+bool Device::inspect(IMFSample* sample, const bool& change, const bool& measure)
+{
+    cdi::util::ScopeGuard guard;
+
+    IMFMediaBuffer* buffer = nullptr;
+    FAILED_RETURN(sample->ConvertToContiguousBuffer(&buffer), true);
+    guard += [&buffer]() { SAFE_RELEASE(buffer); };
+
+    // Prefer the real pitch of 2D buffers, fall back to the packed layout
+    IMF2DBuffer* buffer_2d = nullptr;
+    BYTE* data = nullptr;
+    LONG pitch = m_luma.pitch;
+    if(SUCCEEDED(buffer->QueryInterface(IID_PPV_ARGS(&buffer_2d))))
+    {
+        guard += [&buffer_2d]() { SAFE_RELEASE(buffer_2d); };
+        FAILED_RETURN(buffer_2d->Lock2D(&data, &pitch), true);
+        guard += [&buffer_2d]() { buffer_2d->Unlock2D(); };
+    }
+    else
+    {
+        DWORD max_length = 0;
+        DWORD length = 0;
+        FAILED_RETURN(buffer->Lock(&data, &max_length, &length), true);
+        guard += [&buffer]() { buffer->Unlock(); };
+        if(length < static_cast<DWORD>(m_luma.pitch) * m_height)
+        {
+            return true;
+        }
+    }
+
+    const uint8_t* luma = data + m_luma.offset;
+
+    if(change && !gate(luma, pitch))
+    {
+        return false;
+    }
+
+    // Statistics only for frames which get delivered. The own kernels accumulate them while
+    // they convert, this pass of its own is left for the DSP and the other converters, which
+    // work out of sight or on other samples, and for frames nothing converts. tools/stats_bench
+    // times both.
+    if(measure)
+    {
+        m_stats->begin();
+        const uint8_t* prev = nullptr;
+        for(uint32_t row = 0; row < m_height; row++)
+        {
+            const uint8_t* cur = luma + static_cast<ptrdiff_t>(row) * pitch;
+            m_stats->accumulate_row(cur, prev, m_width, m_luma.step);
+            prev = cur;
+        }
+        m_stats->finish(m_options.statistics);
+    }
+
+    return true;
+}
+
+bool Device::gate(const uint8_t* luma, const int32_t& pitch)
+{
+    const bool changed = m_gate->update(luma, pitch, m_luma.step);
+
+    m_changed = changed;
+    if(changed)
+    {
+        m_skipped = 0;
+        return true;
+    }
+
+    // Heartbeat, deliver an unchanged frame every now and then
+    const uint32_t max_skipped = m_options.change_gate.max_skipped;
+    if(max_skipped != 0 && m_skipped >= max_skipped)
+    {
+        m_skipped = 0;
+        m_gate->accept();
+        return true;
+    }
+
+    m_skipped++;
+    return false;
+}
+
+const void* Device::lock(size_t& bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    bytes = 0;
+    const void* data = nullptr;
+
+    if(m_transform)
+    {
+        data = m_transform->lock(bytes);
+    }
+
+    // Compressed frames differ in size
+    if(data != nullptr && FrameLayout::is_compressed(m_output_format))
+    {
+        m_size = bytes;
+    }
+
+    if(data != nullptr && m_pyramid && !m_pyramid_valid)
+    {
+        m_pyramid->build(data);
+        m_pyramid_valid = true;
+    }
+
+    m_locked_data = data;
+
+    return data;
+}
+
+void Device::unlock()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_transform)
+    {
+        m_transform->unlock();
+    }
+
+    m_locked_data = nullptr;
+}
+
+uint32_t Device::width() const
+{
+    return m_frame_width;
+}
+
+uint32_t Device::height() const
+{
+    return m_frame_height;
+}
+
+Encoding Device::encoding() const
+{
+    return m_output_format;
+}
+
+size_t Device::size() const
+{
+    return m_size;
+}
+
+int64_t Device::timestamp() const
+{
+    return m_asynchronous ? m_current_info.info.timestamp : m_timestamp;
+}
+
+FrameInfo Device::info() const
+{
+    if(m_asynchronous)
+    {
+        FrameInfo result = m_current_info.info;
+        result.change_mask = m_current_info.mask.empty() ? nullptr : m_current_info.mask.data();
+        result.statistics = m_stats ? (m_fused_stats ? &m_stats->result() : &m_current_info.statistics) : nullptr;
+        result.stale = m_stale;
+        return result;
+    }
+
+    FrameInfo result;
+    result.sequence = m_sequence;
+    result.timestamp = m_timestamp;
+    result.changed = m_changed;
+    result.stale = m_stale;
+    result.keyframe = m_keyframe;
+
+    if(m_gate)
+    {
+        result.change_score = m_gate->score();
+        result.tiles_x = m_gate->tiles_x();
+        result.tiles_y = m_gate->tiles_y();
+        result.change_mask = m_gate->mask();
+    }
+
+    if(m_stats)
+    {
+        result.statistics = &m_stats->result();
+    }
+
+    return result;
+}
+
+uint32_t Device::level_count() const
+{
+    return 1 + (m_pyramid ? m_pyramid->level_count() : 0);
+}
+
+FrameLevel Device::level(const uint32_t& index) const
+{
+    FrameLevel result;
+    if(m_locked_data == nullptr)
+    {
+        return result;
+    }
+
+    if(index == 0)
+    {
+        result.width = m_frame_width;
+        result.height = m_frame_height;
+        result.encoding = m_output_format;
+        result.size = m_size;
+        result.data = m_locked_data;
+        result.top_down = m_transform && !m_transform->bottom_up()
+            && (m_output_format == Encoding::RGB24 || m_output_format == Encoding::RGBA32);
+        result.color = m_options.color;
+    }
+    else if(m_pyramid)
+    {
+        result = m_pyramid->level(index - 1);
+    }
+
+    return result;
+}
+
+void Device::uninit()
+{
+    // The watchdog may be rebuilding the reader
+    if(m_watch_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_async_mutex);
+            m_watch_exit = true;
+        }
+        m_watch_wake.notify_all();
+        m_watch_thread.join();
+    }
+
+    stop_reading();
+
+    if(m_presample.valid())
+    {
+        m_presample.wait();
+        m_presample = std::future<void>();
+    }
+    SAFE_RELEASE(m_presampled);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_transform.reset();
+    m_recovered_transform.reset();
+    m_ring.reset();
+    m_pyramid.reset();
+    m_gate.reset();
+    m_stats.reset();
+    m_placer.reset();
+
+    SAFE_RELEASE(m_reader);
+    SAFE_RELEASE(m_readerEx);
+    SAFE_RELEASE(m_attributes);
+    SAFE_RELEASE(m_device_output);
+
+    // The reader shut the source down unless a session keeps it, which only needs it idle.
+    // An own source is also dropped from the activation, which would hand it out again.
+    if(m_keep_source && m_source != nullptr)
+    {
+        m_source->Stop();
+    }
+    else if(m_source != nullptr && m_device != nullptr)
+    {
+        m_device->ShutdownObject();
+    }
     SAFE_RELEASE(m_source);
     SAFE_RELEASE(m_device);
+    SAFE_RELEASE(m_callback);
 }
 
 }
@@ -32,9 +32,17 @@
 
 #pragma once
 #include "cdi/cdi.h"
+#include "ColorKernels.h"
+#include "Watchdog.h"
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include <mfapi.h>
 #include <mfidl.h>
@@ -42,7 +50,31 @@
 
 namespace cdi {
 
+class ChangeGate;
 class ColorTransform;
+class FrameRing;
+class FrameStats;
+class JpegEncoder;
+class Pyramid;
+class ReaderCallback;
+class ThreadPlacer;
+
+struct LumaLayout
+{
+    LumaLayout() : offset(0), step(1), pitch(0) {}
+    uint32_t offset;
+    uint32_t step;
+    int32_t pitch;
+};
+
+// Description of a frame read in the background, copied because the capture
+// thread moves on to the next frame while it waits to be locked
+struct FrameSnapshot
+{
+    FrameInfo info;
+    FrameStatistics statistics;
+    std::vector<uint8_t> mask;
+};
 
 class Device
 {
@@ -50,8 +82,20 @@ public:
     Device();
     ~Device();
 
+    // 'source' is the already activated media source of 'device' or null, with 'keep_source'
+    // it outlives the device and is only stopped instead of shut down
     bool init(
         IMFActivate* device,
+        IMFMediaSource* source,
+        const bool& keep_source,
+        const uint32_t& width,
+        const uint32_t& height,
+        const GUID& mf_format,
+        const Encoding& output_format,
+        const StreamOptions& options);
+    // Renegotiates the media type of the live reader and rebuilds the conversion, must not be
+    // called while locked. The previous configuration stays on failure.
+    bool reconfigure(
         const uint32_t& width,
         const uint32_t& height,
         const GUID& mf_format,
@@ -63,13 +107,84 @@ public:
     uint32_t height() const;
     Encoding encoding() const;
     size_t size() const;
+    int64_t timestamp() const;
+    uint32_t level_count() const;
+    FrameLevel level(const uint32_t& index) const;
+    FrameInfo info() const;
+    bool read_into(void* dst, const size_t& stride);
+    bool read_into(const FramePlane* planes, const uint32_t& plane_count);
+    size_t snapshot_jpeg(const JpegOptions& options, void* dst, const size_t& dst_size);
+    // Pre-trigger frames converted into 'encoding', shared streams dump per consumer
+    bool dump(
+        const int64_t& since,
+        const std::wstring& path,
+        const Encoding& encoding,
+        std::unique_ptr<ICodec> codec);
+    bool notify_frame(const std::function<void(bool)>& ready);
+    void cancel_notify();
+    OpenTimings open_timings() const;
+    ThreadPlacement placement() const;
+    RecoveryStatistics recovery() const;
+    // The media source given to init() has been replaced by a recovery
+    bool source_replaced() const;
+    // Stream id of the trace events and the number of the current frame
+    uint32_t trace_stream() const;
+    uint64_t sequence() const;
+    // Frames between two delivered ones are dropped before they are looked at or converted
+    void set_frame_divisor(const uint32_t& divisor);
+    StreamLoad load() const;
+
+    // Streams shared by several consumers convert on their own: the next frame as it came from
+    // the device, released by the caller, and conversions of the device output. Conversions
+    // must be created again when the generation changes, a recovery may renegotiate the output.
+    IMFSample* capture(FrameSnapshot& frame);
+    std::unique_ptr<ColorTransform> create_transform(const Encoding& encoding) const;
+    uint32_t generation() const;
+    // Outcome of a conversion, failures in a row rebuild the stream as failed reads do
+    void converted(const bool& success);
+    // Encodes a frame of capture() as it came from the device with an initialized 'encoder'. False
+    // when the device format or the orientation options need the I420 conversion first.
+    bool encode_jpeg(
+        IMFSample* sample,
+        JpegEncoder& encoder,
+        const JpegOptions& options,
+        void* dst,
+        const size_t& dst_size,
+        size_t& bytes) const;
+
+    // Reads of the asynchronous reader, called on its thread
+    void on_sample(const HRESULT& status, const DWORD& flags, IMFSample* sample);
+    void on_flush();
 
 private:
+    bool negotiate(const GUID& mf_format);
+    bool setup(const GUID& mf_format);
+    bool start_reading();
+    void pause_reading();
+    void watch();
+    bool recover();
+    static GUID output_subtype(const Encoding& encoding);
+    int64_t frame_interval() const;
+    IMFSample* next_sample();
+    IMFSample* read_sample();
+    IMFSample* take_sample();
+    bool accept(IMFSample* sample);
+    bool setup_ring();
+    // Copies an accepted frame into the pre-trigger ring
+    bool retain(IMFSample* sample);
+    void snapshot(FrameSnapshot& snapshot) const;
+    void stop_reading();
+    // Runs the change gate and the statistics on the native frame, false when the gate drops it
+    bool inspect(IMFSample* sample, const bool& change, const bool& measure);
+    bool gate(const uint8_t* luma, const int32_t& pitch);
+    // Counts a frame handed to the consumer, converted since 'convert_start'
+    void delivered(const int64_t& convert_start);
     void uninit();
 
 private:
     IMFActivate* m_device;
     std::wstring m_name;
+    uint32_t m_trace_stream;
     IMFMediaSource* m_source;
     IMFAttributes* m_attributes;
     IMFSourceReader* m_reader;
@@ -77,12 +192,84 @@ private:
     IMFMediaType* m_device_output;
     uint32_t m_width;
     uint32_t m_height;
+    uint32_t m_frame_width; // Delivered frames, rotated by the conversion
+    uint32_t m_frame_height;
     Encoding m_output_format;
+    StreamOptions m_options;
     size_t m_size;
+    int64_t m_timestamp;
 
     // Color space transformation
     std::unique_ptr<ColorTransform> m_transform;
-    std::mutex m_mutex;
+    std::shared_ptr<ThreadPlacer> m_placer;
+    mutable std::mutex m_mutex;
+    const void* m_locked_data;
+
+    // Downscaled outputs, rebuilt on the first lock of every sample
+    std::unique_ptr<Pyramid> m_pyramid;
+    bool m_pyramid_valid;
+
+    // Change detection and statistics on the native frame
+    std::unique_ptr<ChangeGate> m_gate;
+    std::unique_ptr<FrameStats> m_stats;
+    LumaLayout m_luma;
+    bool m_fused_stats; // The kernels of m_transform accumulate them, on the consumer's thread
+
+    // Pre-trigger frames as they came from the device, shared with dumps in progress
+    std::shared_ptr<FrameRing> m_ring;
+
+    // Snapshots, encoded from the native frame when it is 8 bit YUV
+    std::unique_ptr<JpegEncoder> m_jpeg;
+    kernels::YuvFormat m_jpeg_format;
+    bool m_jpeg_native;
+    uint64_t m_sequence;
+    bool m_changed;
+    uint32_t m_skipped;
+    bool m_keyframe;
+    bool m_resync; // H.264 frames are dropped up to the next keyframe
+
+    // Open path, the deferred presample reads the first frame in the background
+    OpenTimings m_timings;
+    int64_t m_open_start;
+    std::atomic<int64_t> m_first_frame;
+    std::future<void> m_presample;
+    IMFSample* m_presampled;
+    bool m_keep_source;
+
+    // Asynchronous reads, the capture thread keeps the latest accepted frame for the consumer
+    ReaderCallback* m_callback;
+    bool m_asynchronous; // Set once, the callback changes with a recovery
+    mutable std::mutex m_async_mutex;
+    std::condition_variable m_arrived;
+    IMFSample* m_pending;
+    FrameSnapshot m_pending_info;
+    FrameSnapshot m_current_info;
+    std::function<void(bool)> m_ready;
+    bool m_stopped;
+    bool m_reading;  // A read is in flight
+    bool m_pausing;  // No read follows the one in flight
+    bool m_flushed;
+    bool m_consumer_gap; // H.264 frames after one the consumer missed wait for the next keyframe
+
+    // Recovery of stalled streams, the rebuilt conversion takes over with the first new frame
+    Watchdog m_watchdog;
+    std::thread m_watch_thread;
+    std::condition_variable m_watch_wake;
+    bool m_watch_exit;
+    std::mutex m_recover_mutex;
+    std::unique_ptr<ColorTransform> m_recovered_transform;
+    bool m_source_replaced;
+    bool m_stale;
+    uint32_t m_generation;
+
+    // Cost of the stream for the quality governor, written by the reading threads
+    std::atomic<uint32_t> m_frame_divisor;
+    std::atomic<int64_t> m_frame_interval;
+    std::atomic<uint64_t> m_frames;
+    std::atomic<uint64_t> m_delivered;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<int64_t> m_convert_time;
+    std::atomic<int64_t> m_latency;
 };
 
 }
@@ -42,9 +42,9 @@
 namespace cdi {
 
 DevicePool::Format::Format()
-    : framerate(0)
-    , width(0)
+    : width(0)
     , height(0)
+    , framerate(0)
     , format(MFVideoFormat_Base)
     , format_translation("MFVideoFormat_Base")
 {
@@ -131,11 +131,25 @@ std::vector<std::wstring> DevicePool::get_device_names()
 }
 
 std::vector<DevicePool::Format> DevicePool::get_formats(const uint32_t& device_index)
+{
+    return get_formats(device_index, nullptr);
+}
+
+std::vector<DevicePool::Format> DevicePool::get_formats(const uint32_t& device_index, IMFMediaSource** activated)
 {
     cdi::util::ScopeGuard local_guard;
     std::vector<Format> formats;
 
+    if(activated != nullptr)
+    {
+        *activated = nullptr;
+    }
+
     IMFActivate* device = get_device(device_index);
+    if(device == nullptr)
+    {
+        return formats;
+    }
 
     IMFMediaSource* source = nullptr;
     FAILED_RETURN(device->ActivateObject(IID_PPV_ARGS(&source)), formats);
@@ -171,8 +185,15 @@ std::vector<DevicePool::Format> DevicePool::get_formats(const uint32_t& device_i
         if(prop.vt == VT_CLSID)
         {
             fmt.format = *prop.puuid;
-            fmt.format_translation = GuidToString(*prop.puuid);
+
+            // Unknown formats keep the default translation
+            const char* translation = GuidToString(*prop.puuid);
+            if(translation != nullptr)
+            {
+                fmt.format_translation = translation;
+            }
         }
+        PropVariantClear(&prop);
 
         FAILED_RETURN(type->GetItem(MF_MT_FRAME_SIZE, &prop), formats);
         if(prop.vt == VT_UI8)
@@ -190,7 +211,53 @@ std::vector<DevicePool::Format> DevicePool::get_formats(const uint32_t& device_i
         formats.push_back(fmt);
     }
 
+    // Activation is the slow part of opening a camera, keep the source for the reader
+    if(activated != nullptr)
+    {
+        *activated = source;
+        source = nullptr;
+    }
+
     return formats;
 }
 
+void DevicePool::probe(const uint32_t& device_index, DeviceCapabilities& capabilities)
+{
+    capabilities.status = ProbeStatus::FAILED;
+
+    IMFActivate* device = get_device(device_index);
+    if(device == nullptr)
+    {
+        return;
+    }
+
+    wchar_t* device_name = nullptr;
+    if(SUCCEEDED(device->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME, &device_name, nullptr)))
+    {
+        capabilities.name = device_name;
+        CoTaskMemFree(device_name);
+        device_name = nullptr;
+    }
+
+    // A source is handed out once the activation succeeded
+    IMFMediaSource* source = nullptr;
+    for(const Format& fmt : get_formats(device_index, &source))
+    {
+        DeviceFormat format;
+        format.width = fmt.width;
+        format.height = fmt.height;
+        format.framerate = fmt.framerate;
+        format.format = fmt.format_translation;
+        capabilities.formats.push_back(format);
+    }
+
+    // Nothing reads from the source, let the camera go
+    if(source != nullptr)
+    {
+        capabilities.status = ProbeStatus::OK;
+        SAFE_RELEASE(source);
+        device->ShutdownObject();
+    }
+}
+
 }
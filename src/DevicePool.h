@@ -35,6 +35,7 @@
 #include "ScopeGuard.inl"
 #include <memory>
 #include <mfobjects.h>
+#include <mfidl.h>
 
 namespace cdi {
 
@@ -58,6 +59,11 @@ public:
     IMFActivate* get_device(const uint32_t& device_index);
     std::vector<std::wstring> get_device_names();
     std::vector<Format> get_formats(const uint32_t& device_index);
+    // Hands the media source activated for the enumeration to the caller instead of
+    // releasing it, null when the enumeration failed
+    std::vector<Format> get_formats(const uint32_t& device_index, IMFMediaSource** source);
+    // Name and formats of one device, different devices may be probed at the same time
+    void probe(const uint32_t& device_index, DeviceCapabilities& capabilities);
 
 private:
     std::unique_ptr<cdi::util::ScopeGuard> m_uninit_guard;
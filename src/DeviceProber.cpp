@@ -0,0 +1,289 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "DeviceProber.h"
+#include "ThreadPlacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <mfapi.h>
+
+
+namespace cdi {
+
+namespace {
+
+// Shared with the probe threads, which may outlive the run
+struct ProbeState
+{
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<DeviceCapabilities> results;
+    std::vector<uint8_t> abandoned;
+    std::vector<uint8_t> exited;     // Nothing left for the thread to do but to return
+    std::vector<uint32_t> completed; // Finished since the last look
+};
+
+struct Running
+{
+    uint32_t index;
+    int64_t start;
+};
+
+struct Straggler
+{
+    std::thread thread;
+    std::shared_ptr<ProbeState> state;
+    uint32_t index;
+};
+
+// Threads of all runs which were left behind by their timeout
+class Stragglers
+{
+public:
+    static Stragglers& instance()
+    {
+        static Stragglers stragglers;
+        return stragglers;
+    }
+
+    ~Stragglers()
+    {
+        // A probe hanging for longer than any timeout is left to the end of the process
+        if(drain(m_grace) > 0)
+        {
+            for(Straggler& straggler : m_threads)
+            {
+                straggler.thread.detach();
+            }
+        }
+    }
+
+    void add(Straggler&& straggler, const int64_t& timeout)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threads.push_back(std::move(straggler));
+        m_grace = std::max(m_grace, timeout);
+    }
+
+    uint32_t drain(const int64_t& timeout)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const int64_t deadline = clock_now() + timeout;
+
+        for(auto it = m_threads.begin(); it != m_threads.end();)
+        {
+            bool exited = false;
+            {
+                ProbeState& state = *it->state;
+                const uint32_t index = it->index;
+                std::unique_lock<std::mutex> state_lock(state.mutex);
+                const int64_t remaining = std::max<int64_t>(deadline - clock_now(), 0);
+                exited = state.finished.wait_for(
+                    state_lock,
+                    std::chrono::microseconds(remaining / 10),
+                    [&state, index]() { return state.exited[index] != 0; });
+            }
+
+            if(exited)
+            {
+                it->thread.join();
+                it = m_threads.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        return static_cast<uint32_t>(m_threads.size());
+    }
+
+private:
+    Stragglers() : m_grace(0) {}
+
+private:
+    std::mutex m_mutex;
+    std::vector<Straggler> m_threads;
+    int64_t m_grace;
+};
+
+}
+
+DeviceProber::DeviceProber(const ProbeOptions& options)
+    : m_options(options)
+{
+}
+
+std::vector<DeviceCapabilities> DeviceProber::run(const uint32_t& count, const Probe& probe) const
+{
+    // Whatever earlier runs left behind and has returned since
+    Stragglers::instance().drain(0);
+
+    std::shared_ptr<ProbeState> state(std::make_shared<ProbeState>());
+    state->results.resize(count);
+    state->abandoned.resize(count, 0);
+    state->exited.resize(count, 0);
+
+    const uint32_t threads = m_options.threads == 0 ? count : std::min(m_options.threads, count);
+    const int64_t timeout = static_cast<int64_t>(m_options.timeout_ms) * 10000;
+
+    std::vector<Running> running;
+    std::vector<std::thread> probes(count);
+    uint32_t next = 0;
+    uint32_t finished = 0;
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while(finished < count)
+    {
+        // Keep the bound busy
+        while(running.size() < threads && next < count)
+        {
+            const uint32_t index = next++;
+            running.push_back({index, clock_now()});
+
+            probes[index] = std::thread([state, probe, index]()
+            {
+                const HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+                ThreadPlacer::apply(get_thread_policy());
+
+                DeviceCapabilities capabilities;
+                const int64_t start = clock_now();
+                probe(index, capabilities);
+                capabilities.index = index;
+                capabilities.duration = clock_now() - start;
+
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if(!state->abandoned[index])
+                    {
+                        state->results[index] = std::move(capabilities);
+                        state->completed.push_back(index);
+                        state->finished.notify_all();
+                    }
+                }
+
+                if(SUCCEEDED(com))
+                {
+                    CoUninitialize();
+                }
+
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->exited[index] = 1;
+                state->finished.notify_all();
+            });
+        }
+
+        // Until a probe finishes or the earliest deadline passes
+        if(state->completed.empty())
+        {
+            if(timeout > 0)
+            {
+                int64_t deadline = running.front().start + timeout;
+                for(const Running& entry : running)
+                {
+                    deadline = std::min(deadline, entry.start + timeout);
+                }
+
+                const int64_t remaining = std::max<int64_t>(deadline - clock_now(), 0);
+                state->finished.wait_for(lock, std::chrono::microseconds(remaining / 10 + 1));
+            }
+            else
+            {
+                state->finished.wait(lock);
+            }
+        }
+
+        for(const uint32_t index : state->completed)
+        {
+            running.erase(std::find_if(running.begin(), running.end(),
+                [index](const Running& entry) { return entry.index == index; }));
+            finished++;
+        }
+        state->completed.clear();
+
+        if(timeout > 0)
+        {
+            const int64_t now = clock_now();
+            for(auto it = running.begin(); it != running.end();)
+            {
+                if(now - it->start < timeout)
+                {
+                    ++it;
+                    continue;
+                }
+
+                // Left behind, whatever it reports later is dropped
+                state->abandoned[it->index] = 1;
+                DeviceCapabilities& result = state->results[it->index];
+                result.index = it->index;
+                result.status = ProbeStatus::TIMEOUT;
+                result.duration = now - it->start;
+
+                it = running.erase(it);
+                finished++;
+            }
+        }
+    }
+
+    std::vector<DeviceCapabilities> results = state->results;
+    const std::vector<uint8_t> abandoned = state->abandoned;
+    lock.unlock();
+
+    // Probes which finished in time are about to return, the others are joined later
+    for(uint32_t index = 0; index < count; index++)
+    {
+        if(abandoned[index])
+        {
+            Stragglers::instance().add({std::move(probes[index]), state, index}, timeout);
+        }
+        else
+        {
+            probes[index].join();
+        }
+    }
+
+    return results;
+}
+
+uint32_t DeviceProber::drain(const uint32_t& timeout_ms)
+{
+    return Stragglers::instance().drain(static_cast<int64_t>(timeout_ms) * 10000);
+}
+
+}
@@ -0,0 +1,65 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+namespace cdi {
+
+// Probes devices on a bounded number of threads with a deadline per device. A probe which
+// misses its deadline is reported as timed out and left behind, it no longer counts against
+// the bound and its result is dropped once it returns. Its thread is joined after that, by a
+// later run or by drain(), which also runs at shutdown for as long as the longest timeout.
+class DeviceProber
+{
+public:
+    // Fills name, formats and status of the device, runs with COM initialised
+    typedef std::function<void(const uint32_t& index, DeviceCapabilities& capabilities)> Probe;
+
+    explicit DeviceProber(const ProbeOptions& options);
+
+    // One entry per device in index order
+    std::vector<DeviceCapabilities> run(const uint32_t& count, const Probe& probe) const;
+
+    // Joins the threads left behind which return within 'timeout_ms', the number still running
+    static uint32_t drain(const uint32_t& timeout_ms);
+
+private:
+    ProbeOptions m_options;
+};
+
+}
@@ -0,0 +1,243 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ExternalBuffer.h"
+
+#include <cstring>
+
+
+namespace cdi {
+
+ExternalBuffer::ExternalBuffer(
+    uint8_t* data,
+    const size_t& length,
+    uint8_t* scanline0,
+    const LONG& pitch,
+    const bool& contiguous)
+    : m_references(1)
+    , m_data(data)
+    , m_length(static_cast<DWORD>(length))
+    , m_current_length(0)
+    , m_scanline0(scanline0)
+    , m_pitch(pitch)
+    , m_contiguous(contiguous)
+{
+}
+
+ExternalBuffer::~ExternalBuffer()
+{
+}
+
+void ExternalBuffer::detach()
+{
+    m_data = nullptr;
+    m_scanline0 = nullptr;
+}
+
+STDMETHODIMP ExternalBuffer::QueryInterface(REFIID riid, void** object)
+{
+    if(object == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    if(riid == __uuidof(IUnknown) || riid == __uuidof(IMFMediaBuffer))
+    {
+        *object = static_cast<IMFMediaBuffer*>(this);
+    }
+    else if(riid == __uuidof(IMF2DBuffer))
+    {
+        *object = static_cast<IMF2DBuffer*>(this);
+    }
+    else
+    {
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    AddRef();
+    return S_OK;
+}
+
+STDMETHODIMP_(ULONG) ExternalBuffer::AddRef()
+{
+    return InterlockedIncrement(&m_references);
+}
+
+STDMETHODIMP_(ULONG) ExternalBuffer::Release()
+{
+    const ULONG references = InterlockedDecrement(&m_references);
+    if(references == 0)
+    {
+        delete this;
+    }
+
+    return references;
+}
+
+STDMETHODIMP ExternalBuffer::Lock(BYTE** buffer, DWORD* max_length, DWORD* current_length)
+{
+    if(buffer == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    // Writers which don't know about the pitch may only get packed rows
+    if(m_data == nullptr || !m_contiguous)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    *buffer = m_data;
+    if(max_length != nullptr)
+    {
+        *max_length = m_length;
+    }
+    if(current_length != nullptr)
+    {
+        *current_length = m_current_length;
+    }
+
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::Unlock()
+{
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::GetCurrentLength(DWORD* current_length)
+{
+    if(current_length == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    *current_length = m_current_length;
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::SetCurrentLength(DWORD current_length)
+{
+    if(current_length > m_length)
+    {
+        return E_INVALIDARG;
+    }
+
+    m_current_length = current_length;
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::GetMaxLength(DWORD* max_length)
+{
+    if(max_length == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    *max_length = m_length;
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::Lock2D(BYTE** scanline0, LONG* pitch)
+{
+    return GetScanline0AndPitch(scanline0, pitch);
+}
+
+STDMETHODIMP ExternalBuffer::Unlock2D()
+{
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::GetScanline0AndPitch(BYTE** scanline0, LONG* pitch)
+{
+    if(scanline0 == nullptr || pitch == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    if(m_scanline0 == nullptr)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    *scanline0 = m_scanline0;
+    *pitch = m_pitch;
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::IsContiguousFormat(BOOL* contiguous)
+{
+    if(contiguous == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    *contiguous = m_contiguous ? TRUE : FALSE;
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::GetContiguousLength(DWORD* length)
+{
+    if(length == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    *length = m_length;
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::ContiguousCopyTo(BYTE* destination, DWORD destination_length)
+{
+    if(m_data == nullptr || !m_contiguous || destination_length < m_length)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    std::memcpy(destination, m_data, m_length);
+    return S_OK;
+}
+
+STDMETHODIMP ExternalBuffer::ContiguousCopyFrom(const BYTE* source, DWORD source_length)
+{
+    if(m_data == nullptr || !m_contiguous || source_length > m_length)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    std::memcpy(m_data, source, source_length);
+    m_current_length = source_length;
+    return S_OK;
+}
+
+}
@@ -0,0 +1,97 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include <mfapi.h>
+#include <mfidl.h>
+
+
+namespace cdi {
+
+// Media buffer over memory owned by the caller, lets a transform write its output
+// straight into it. The memory is not owned, detach() makes every later lock fail
+// so nothing can reach the caller memory once it has been handed back.
+class ExternalBuffer : public IMFMediaBuffer, public IMF2DBuffer
+{
+    ExternalBuffer(const ExternalBuffer&);
+    ExternalBuffer& operator=(const ExternalBuffer&);
+
+public:
+    // 'pitch' is negative for bottom-up images, 'scanline0' then points to the last row in memory.
+    // 'contiguous' when rows are packed, only then the plain Lock() is allowed
+    ExternalBuffer(
+        uint8_t* data,
+        const size_t& length,
+        uint8_t* scanline0,
+        const LONG& pitch,
+        const bool& contiguous);
+
+    void detach();
+
+    // IUnknown
+    STDMETHODIMP QueryInterface(REFIID riid, void** object) final;
+    STDMETHODIMP_(ULONG) AddRef() final;
+    STDMETHODIMP_(ULONG) Release() final;
+
+    // IMFMediaBuffer
+    STDMETHODIMP Lock(BYTE** buffer, DWORD* max_length, DWORD* current_length) final;
+    STDMETHODIMP Unlock() final;
+    STDMETHODIMP GetCurrentLength(DWORD* current_length) final;
+    STDMETHODIMP SetCurrentLength(DWORD current_length) final;
+    STDMETHODIMP GetMaxLength(DWORD* max_length) final;
+
+    // IMF2DBuffer
+    STDMETHODIMP Lock2D(BYTE** scanline0, LONG* pitch) final;
+    STDMETHODIMP Unlock2D() final;
+    STDMETHODIMP GetScanline0AndPitch(BYTE** scanline0, LONG* pitch) final;
+    STDMETHODIMP IsContiguousFormat(BOOL* contiguous) final;
+    STDMETHODIMP GetContiguousLength(DWORD* length) final;
+    STDMETHODIMP ContiguousCopyTo(BYTE* destination, DWORD destination_length) final;
+    STDMETHODIMP ContiguousCopyFrom(const BYTE* source, DWORD source_length) final;
+
+private:
+    ~ExternalBuffer();
+
+private:
+    volatile LONG m_references;
+    uint8_t* m_data;
+    DWORD m_length;
+    DWORD m_current_length;
+    uint8_t* m_scanline0;
+    LONG m_pitch;
+    bool m_contiguous;
+};
+
+}
@@ -0,0 +1,180 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FrameLayout.h"
+
+
+namespace cdi {
+
+FrameLayout::Plane::Plane()
+    : offset(0)
+    , width(0)
+    , height(0)
+    , stride(0)
+    , step(1)
+{
+}
+
+FrameLayout::FrameLayout()
+    : m_plane_count(0)
+    , m_size(0)
+{
+}
+
+bool FrameLayout::init(const uint32_t& width, const uint32_t& height, const Encoding& encoding)
+{
+    m_plane_count = 0;
+    m_size = 0;
+
+    switch (encoding)
+    {
+    case Encoding::I420:
+        {
+            const uint32_t chroma_width = width >> 1;
+            const uint32_t chroma_height = height >> 1;
+            const size_t luma_size = static_cast<size_t>(width) * height;
+            const size_t chroma_size = static_cast<size_t>(chroma_width) * chroma_height;
+
+            m_planes[0].width = width;
+            m_planes[0].height = height;
+            m_planes[0].stride = width;
+
+            m_planes[1].offset = luma_size;
+            m_planes[1].width = chroma_width;
+            m_planes[1].height = chroma_height;
+            m_planes[1].stride = chroma_width;
+
+            m_planes[2].offset = luma_size + chroma_size;
+            m_planes[2].width = chroma_width;
+            m_planes[2].height = chroma_height;
+            m_planes[2].stride = chroma_width;
+
+            m_plane_count = 3;
+            m_size = luma_size + chroma_size * 2;
+        }
+        break;
+    case Encoding::RGB24:
+    case Encoding::RGBA32:
+        {
+            // Packed formats are treated as a single interleaved plane
+            const uint32_t bytes_per_pixel = encoding == Encoding::RGB24 ? 3 : 4;
+            m_planes[0].width = width * bytes_per_pixel;
+            m_planes[0].height = height;
+            m_planes[0].stride = width * bytes_per_pixel;
+            m_planes[0].step = bytes_per_pixel;
+
+            m_plane_count = 1;
+            m_size = static_cast<size_t>(m_planes[0].stride) * height;
+        }
+        break;
+    case Encoding::P010:
+    case Encoding::P016:
+        {
+            // Two byte samples, chroma as interleaved UV pairs of half the rows. The chroma row
+            // spans the whole stride, an odd width ends it in half a pair.
+            const uint32_t row = width * 2;
+            const uint32_t chroma_height = height >> 1;
+
+            m_planes[0].width = row;
+            m_planes[0].height = height;
+            m_planes[0].stride = row;
+            m_planes[0].step = 2;
+
+            m_planes[1].offset = static_cast<size_t>(row) * height;
+            m_planes[1].width = row;
+            m_planes[1].height = chroma_height;
+            m_planes[1].stride = row;
+            m_planes[1].step = 4;
+
+            m_plane_count = 2;
+            m_size = static_cast<size_t>(row) * (height + chroma_height);
+        }
+        break;
+    case Encoding::Y210:
+        {
+            // Y0 U Y1 V of two bytes each per pixel pair, luma is every other sample
+            m_planes[0].width = width * 4;
+            m_planes[0].height = height;
+            m_planes[0].stride = width * 4;
+            m_planes[0].step = 4;
+
+            m_plane_count = 1;
+            m_size = static_cast<size_t>(m_planes[0].stride) * height;
+        }
+        break;
+    case Encoding::GRAY16:
+        {
+            m_planes[0].width = width * 2;
+            m_planes[0].height = height;
+            m_planes[0].stride = width * 2;
+            m_planes[0].step = 2;
+
+            m_plane_count = 1;
+            m_size = static_cast<size_t>(m_planes[0].stride) * height;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+bool FrameLayout::is_wide(const Encoding& encoding)
+{
+    return encoding == Encoding::P010
+        || encoding == Encoding::P016
+        || encoding == Encoding::Y210
+        || encoding == Encoding::GRAY16;
+}
+
+bool FrameLayout::is_compressed(const Encoding& encoding)
+{
+    return encoding == Encoding::MJPEG || encoding == Encoding::H264;
+}
+
+size_t FrameLayout::size() const
+{
+    return m_size;
+}
+
+uint32_t FrameLayout::plane_count() const
+{
+    return m_plane_count;
+}
+
+const FrameLayout::Plane& FrameLayout::plane(const uint32_t& index) const
+{
+    return m_planes[index];
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include <cstdint>
+#include <cstddef>
+
+
+namespace cdi {
+
+// Describes how the planes of a frame in a given Encoding are laid out in memory
+class FrameLayout
+{
+public:
+    struct Plane
+    {
+        Plane();
+        size_t offset;   // Byte offset of the plane from the start of the frame
+        uint32_t width;  // Row length in bytes
+        uint32_t height; // Number of rows
+        uint32_t stride; // Distance between rows in bytes
+        uint32_t step;   // Distance between two samples of the same channel in bytes
+    };
+
+    FrameLayout();
+
+    bool init(const uint32_t& width, const uint32_t& height, const Encoding& encoding);
+    // True for encodings with two byte samples
+    static bool is_wide(const Encoding& encoding);
+    // True for encodings without a pixel layout, their frames differ in size
+    static bool is_compressed(const Encoding& encoding);
+    size_t size() const;
+    uint32_t plane_count() const;
+    const Plane& plane(const uint32_t& index) const;
+
+private:
+    Plane m_planes[3];
+    uint32_t m_plane_count;
+    size_t m_size;
+};
+
+}
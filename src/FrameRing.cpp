@@ -0,0 +1,342 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FrameRing.h"
+#include "ScopeGuard.inl"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace cdi {
+
+namespace {
+
+const uint64_t ALIGNMENT = 64;
+
+enum RecordFlags : uint32_t
+{
+    RECORD_KEYFRAME = 1 << 0,
+    RECORD_FILLER = 1 << 1, // Rest of the memory before the ring starts over, records do not wrap
+};
+
+struct Record
+{
+    uint64_t span; // Up to the next record, header and padding included
+    uint64_t size;
+    int64_t timestamp;
+    uint64_t sequence;
+    uint32_t flags;
+    uint8_t reserved[28];
+};
+
+static_assert(sizeof(Record) == ALIGNMENT, "Unexpected Record size");
+
+uint64_t align(const uint64_t& size)
+{
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+}
+
+FrameRing::Entry::Entry()
+    : position(0)
+    , size(0)
+    , timestamp(0)
+    , sequence(0)
+    , keyframe(true)
+{
+}
+
+FrameRing::FrameRing()
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+    , m_data(nullptr)
+    , m_capacity(0)
+    , m_begin(0)
+    , m_end(0)
+{
+}
+
+FrameRing::~FrameRing()
+{
+    uninit();
+}
+
+bool FrameRing::init(const size_t& capacity, const int32_t& node, const std::wstring& spill_path)
+{
+    cdi::util::ScopeGuard uninit_guard;
+    uninit_guard += [this]() { uninit(); };
+
+    if(m_data != nullptr || capacity < 2 * ALIGNMENT)
+    {
+        return false;
+    }
+
+    m_capacity = static_cast<size_t>(align(capacity));
+
+    if(spill_path.empty())
+    {
+        // Touched on allocation, the ring costs its full size from the start
+        // A node the system refuses is only a preference, the ring goes wherever it gets memory
+        const DWORD preferred = node >= 0 ? static_cast<DWORD>(node) : NUMA_NO_PREFERRED_NODE;
+        if(!m_memory.allocate(m_capacity, preferred)
+           && (preferred == NUMA_NO_PREFERRED_NODE || !m_memory.allocate(m_capacity, NUMA_NO_PREFERRED_NODE)))
+        {
+            return false;
+        }
+        m_data = m_memory.data();
+    }
+    else
+    {
+        // Scratch space only, nobody else opens it and it goes with the ring
+        m_file = CreateFileW(
+            spill_path.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            0,
+            nullptr,
+            CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_DELETE_ON_CLOSE,
+            nullptr);
+        if(m_file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        const uint64_t size = m_capacity;
+        m_mapping = CreateFileMappingW(
+            m_file,
+            nullptr,
+            PAGE_READWRITE,
+            static_cast<DWORD>(size >> 32),
+            static_cast<DWORD>(size),
+            nullptr);
+        if(m_mapping == nullptr)
+        {
+            return false;
+        }
+
+        m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, m_capacity));
+        if(m_data == nullptr)
+        {
+            return false;
+        }
+    }
+
+    uninit_guard.cancel();
+
+    return true;
+}
+
+size_t FrameRing::capacity() const
+{
+    return m_capacity;
+}
+
+size_t FrameRing::span(const size_t& bytes)
+{
+    return static_cast<size_t>(align(sizeof(Record) + bytes));
+}
+
+bool FrameRing::push(
+    const void* frame,
+    const size_t& bytes,
+    const int64_t& timestamp,
+    const uint64_t& sequence,
+    const bool& keyframe)
+{
+    const uint64_t span = align(sizeof(Record) + bytes);
+    if(m_data == nullptr || frame == nullptr || span > m_capacity)
+    {
+        return false;
+    }
+
+    uint64_t begin = m_begin.load(std::memory_order_relaxed);
+    uint64_t end = m_end.load(std::memory_order_relaxed);
+    const uint64_t offset = end % m_capacity;
+    uint64_t filler = offset + span > m_capacity ? m_capacity - offset : 0;
+
+    // Only fits at the start of the memory with nothing else in the ring
+    if(filler + span > m_capacity)
+    {
+        end += filler;
+        begin = end;
+        filler = 0;
+    }
+
+    // The oldest records make room
+    while(end + filler + span - begin > m_capacity)
+    {
+        begin += reinterpret_cast<const Record*>(m_data + begin % m_capacity)->span;
+    }
+
+    // Readers check the begin after copying, it moves before the memory is reused
+    m_begin.store(begin, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if(filler != 0)
+    {
+        Record* record = reinterpret_cast<Record*>(m_data + offset);
+        std::memset(record, 0, sizeof(Record));
+        record->span = filler;
+        record->flags = RECORD_FILLER;
+        end += filler;
+    }
+
+    Record* record = reinterpret_cast<Record*>(m_data + end % m_capacity);
+    std::memset(record, 0, sizeof(Record));
+    record->span = span;
+    record->size = bytes;
+    record->timestamp = timestamp;
+    record->sequence = sequence;
+    record->flags = keyframe ? static_cast<uint32_t>(RECORD_KEYFRAME) : 0;
+    std::memcpy(record + 1, frame, bytes);
+
+    m_end.store(end + span, std::memory_order_release);
+
+    return true;
+}
+
+void FrameRing::clear()
+{
+    m_begin.store(m_end.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+void FrameRing::collect(const int64_t& since, std::vector<Entry>& entries) const
+{
+    entries.clear();
+    if(m_data == nullptr)
+    {
+        return;
+    }
+
+    const uint64_t end = m_end.load(std::memory_order_acquire);
+    uint64_t position = m_begin.load(std::memory_order_acquire);
+    while(position < end)
+    {
+        Record record;
+        std::memcpy(&record, m_data + position % m_capacity, sizeof(Record));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Overwritten while reading, the walk goes on at the oldest record left
+        const uint64_t begin = m_begin.load(std::memory_order_relaxed);
+        if(begin > position)
+        {
+            const auto kept = std::find_if(entries.begin(), entries.end(), [&begin](const Entry& entry)
+            {
+                return entry.position >= begin;
+            });
+            entries.erase(entries.begin(), kept);
+            position = begin;
+            continue;
+        }
+
+        if((record.flags & RECORD_FILLER) == 0)
+        {
+            Entry entry;
+            entry.position = position;
+            entry.size = static_cast<size_t>(record.size);
+            entry.timestamp = record.timestamp;
+            entry.sequence = record.sequence;
+            entry.keyframe = (record.flags & RECORD_KEYFRAME) != 0;
+            entries.push_back(entry);
+        }
+
+        position += record.span;
+    }
+
+    // The first frame at or after 'since', back to the keyframe it depends on. Without one left
+    // the frames up to the next keyframe cannot be decoded.
+    size_t first = 0;
+    while(first < entries.size() && entries[first].timestamp < since)
+    {
+        first++;
+    }
+
+    size_t start = first;
+    while(start > 0 && start < entries.size() && !entries[start].keyframe)
+    {
+        start--;
+    }
+
+    if(start < entries.size() && !entries[start].keyframe)
+    {
+        start = first;
+        while(start < entries.size() && !entries[start].keyframe)
+        {
+            start++;
+        }
+    }
+
+    entries.erase(entries.begin(), entries.begin() + start);
+}
+
+bool FrameRing::read(const Entry& entry, void* dst, const size_t& dst_size) const
+{
+    if(m_data == nullptr || dst == nullptr || entry.size > dst_size
+       || m_begin.load(std::memory_order_acquire) > entry.position)
+    {
+        return false;
+    }
+
+    std::memcpy(dst, m_data + entry.position % m_capacity + sizeof(Record), entry.size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return m_begin.load(std::memory_order_relaxed) <= entry.position;
+}
+
+void FrameRing::uninit()
+{
+    if(m_mapping != nullptr)
+    {
+        if(m_data != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    if(m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+
+    m_memory.free();
+    m_data = nullptr;
+    m_capacity = 0;
+    m_begin = 0;
+    m_end = 0;
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#define NOMINMAX
+#include "NumaMemory.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+
+namespace cdi {
+
+// Frames of the last seconds of a stream in fixed memory, see PretriggerOptions. Records follow
+// each other and the newest one overwrites the oldest ones. A single thread pushes while others
+// read: readers copy a frame and check afterwards that its memory was not reused meanwhile,
+// the writer never waits for them.
+class FrameRing
+{
+    FrameRing(const FrameRing&);
+    FrameRing& operator=(const FrameRing&);
+
+public:
+    struct Entry
+    {
+        Entry();
+        uint64_t position; // Of the record, counts on over the lifetime of the ring
+        size_t size;
+        int64_t timestamp;
+        uint64_t sequence;
+        bool keyframe;
+    };
+
+    FrameRing();
+    ~FrameRing();
+
+    // Memory on 'node', or with a path a file mapping the system may write out to disk. The
+    // capacity is rounded up to whole records.
+    bool init(const size_t& capacity, const int32_t& node, const std::wstring& spill_path);
+    size_t capacity() const;
+    // Ring bytes a frame of 'bytes' takes
+    static size_t span(const size_t& bytes);
+
+    // Writer side, false when the frame is larger than the ring
+    bool push(
+        const void* frame,
+        const size_t& bytes,
+        const int64_t& timestamp,
+        const uint64_t& sequence,
+        const bool& keyframe);
+    // Drops all frames, nothing may be pushed meanwhile
+    void clear();
+
+    // Frames in the ring, oldest first, from the last keyframe at or before 'since' on
+    void collect(const int64_t& since, std::vector<Entry>& entries) const;
+    // False when the memory of the frame has been reused
+    bool read(const Entry& entry, void* dst, const size_t& dst_size) const;
+
+private:
+    void uninit();
+
+private:
+    NumaMemory m_memory;
+    HANDLE m_file;
+    HANDLE m_mapping;
+    uint8_t* m_data;
+    size_t m_capacity;
+
+    // Positions count bytes ever written, the memory offset is the position modulo the capacity
+    std::atomic<uint64_t> m_begin; // Oldest record
+    std::atomic<uint64_t> m_end;   // Behind the newest record
+};
+
+}
@@ -0,0 +1,213 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FrameStats.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <emmintrin.h>
+
+
+namespace cdi {
+
+namespace {
+
+uint32_t sad_sum(const __m128i& a, const __m128i& b)
+{
+    const __m128i sad = _mm_sad_epu8(a, b);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4));
+}
+
+uint32_t abs_diff(const uint8_t& a, const uint8_t& b)
+{
+    return static_cast<uint32_t>(std::abs(static_cast<int32_t>(a) - b));
+}
+
+}
+
+FrameStats::FrameStats()
+{
+    begin();
+}
+
+void FrameStats::begin()
+{
+    std::memset(m_histograms, 0, sizeof(m_histograms));
+    m_samples = 0;
+    m_horizontal = 0;
+    m_horizontal_samples = 0;
+    m_vertical = 0;
+    m_vertical_samples = 0;
+}
+
+void FrameStats::accumulate_row(const uint8_t* row, const uint8_t* prev, const uint32_t& width, const uint32_t& step)
+{
+    if(width == 0)
+    {
+        return;
+    }
+
+    uint32_t x = 0;
+    for(; x + 4 <= width; x += 4)
+    {
+        m_histograms[0][row[(x + 0) * step]]++;
+        m_histograms[1][row[(x + 1) * step]]++;
+        m_histograms[2][row[(x + 2) * step]]++;
+        m_histograms[3][row[(x + 3) * step]]++;
+    }
+    for(; x < width; x++)
+    {
+        m_histograms[0][row[x * step]]++;
+    }
+    m_samples += width;
+
+    // Gradients as sums of absolute differences against the shifted row and the row above
+    uint64_t horizontal = 0;
+    uint64_t vertical = 0;
+    uint32_t h = 0;
+    uint32_t v = 0;
+
+    if(step == 1)
+    {
+        for(; h + 17 <= width; h += 16)
+        {
+            horizontal += sad_sum(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + h)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + h + 1)));
+        }
+        if(prev != nullptr)
+        {
+            for(; v + 16 <= width; v += 16)
+            {
+                vertical += sad_sum(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + v)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + v)));
+            }
+        }
+    }
+    else if(step == 2)
+    {
+        // Interleaved 4:2:2, chroma bytes are masked out and contribute nothing
+        const __m128i mask = _mm_set1_epi16(0x00FF);
+        for(; h + 10 <= width; h += 8)
+        {
+            horizontal += sad_sum(
+                _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + h * 2)), mask),
+                _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + h * 2 + 2)), mask));
+        }
+        if(prev != nullptr)
+        {
+            for(; v + 9 <= width; v += 8)
+            {
+                vertical += sad_sum(
+                    _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + v * 2)), mask),
+                    _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + v * 2)), mask));
+            }
+        }
+    }
+    else if(step == 4)
+    {
+        // One channel of RGB32, the loads stop a pixel early as the row may start at any channel
+        const __m128i mask = _mm_set1_epi32(0x000000FF);
+        for(; h + 6 <= width; h += 4)
+        {
+            horizontal += sad_sum(
+                _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + h * 4)), mask),
+                _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + h * 4 + 4)), mask));
+        }
+        if(prev != nullptr)
+        {
+            for(; v + 5 <= width; v += 4)
+            {
+                vertical += sad_sum(
+                    _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + v * 4)), mask),
+                    _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + v * 4)), mask));
+            }
+        }
+    }
+
+    for(; h + 1 < width; h++)
+    {
+        horizontal += abs_diff(row[h * step], row[(h + 1) * step]);
+    }
+    if(prev != nullptr)
+    {
+        for(; v < width; v++)
+        {
+            vertical += abs_diff(row[v * step], prev[v * step]);
+        }
+        m_vertical += vertical;
+        m_vertical_samples += width;
+    }
+
+    m_horizontal += horizontal;
+    m_horizontal_samples += width - 1;
+}
+
+void FrameStats::finish(const StatisticsOptions& options)
+{
+    uint64_t sum = 0;
+    uint64_t clipped = 0;
+
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        const uint32_t count = m_histograms[0][i] + m_histograms[1][i] + m_histograms[2][i] + m_histograms[3][i];
+        m_result.histogram[i] = count;
+        sum += static_cast<uint64_t>(count) * i;
+        if(i <= options.clip_low || i >= options.clip_high)
+        {
+            clipped += count;
+        }
+    }
+
+    m_result.samples = m_samples;
+    m_result.mean = m_samples ? static_cast<float>(static_cast<double>(sum) / m_samples) : 0.0f;
+    m_result.clipped = m_samples ? static_cast<float>(static_cast<double>(clipped) / m_samples) : 0.0f;
+
+    double sharpness = 0.0;
+    if(m_horizontal_samples > 0)
+    {
+        sharpness += static_cast<double>(m_horizontal) / m_horizontal_samples;
+    }
+    if(m_vertical_samples > 0)
+    {
+        sharpness += static_cast<double>(m_vertical) / m_vertical_samples;
+    }
+    m_result.sharpness = static_cast<float>(sharpness);
+}
+
+const FrameStatistics& FrameStats::result() const
+{
+    return m_result;
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+#include <cstdint>
+
+
+namespace cdi {
+
+// Accumulates luma statistics row by row, so it can run inside any pass that
+// already walks the rows of a frame
+class FrameStats
+{
+public:
+    FrameStats();
+
+    void begin();
+    // 'prev' is the previous row or null for the first one, 'step' is the distance
+    // between luma samples in bytes
+    void accumulate_row(const uint8_t* row, const uint8_t* prev, const uint32_t& width, const uint32_t& step);
+    void finish(const StatisticsOptions& options);
+    const FrameStatistics& result() const;
+
+private:
+    // Four interleaved histograms avoid stalls on runs of equal values
+    uint32_t m_histograms[4][256];
+    uint64_t m_samples;
+    uint64_t m_horizontal;
+    uint64_t m_horizontal_samples;
+    uint64_t m_vertical;
+    uint64_t m_vertical_samples;
+    FrameStatistics m_result;
+};
+
+}
@@ -0,0 +1,400 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "Governor.h"
+#include "Clock.h"
+#include "ThreadPlacer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <windows.h>
+
+
+namespace cdi {
+
+namespace {
+
+// Assumed for streams which do not know their frame rate yet
+const int64_t DEFAULT_FRAME_INTERVAL = 333333;
+
+uint64_t file_time(const FILETIME& time)
+{
+    return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+
+// Busy share of all processors since the last sample
+class SystemLoad
+{
+public:
+    SystemLoad() : m_idle(0), m_total(0)
+    {
+        sample();
+    }
+
+    float sample()
+    {
+        FILETIME idle_time;
+        FILETIME kernel_time;
+        FILETIME user_time;
+        if(!GetSystemTimes(&idle_time, &kernel_time, &user_time))
+        {
+            return 0.0f;
+        }
+
+        // Kernel time includes the idle time
+        const uint64_t idle = file_time(idle_time);
+        const uint64_t total = file_time(kernel_time) + file_time(user_time);
+        const uint64_t idle_delta = idle - m_idle;
+        const uint64_t total_delta = total - m_total;
+        m_idle = idle;
+        m_total = total;
+
+        if(total_delta == 0 || idle_delta > total_delta)
+        {
+            return 0.0f;
+        }
+
+        return static_cast<float>(total_delta - idle_delta) / static_cast<float>(total_delta);
+    }
+
+private:
+    uint64_t m_idle;
+    uint64_t m_total;
+};
+
+}
+
+Governor::Stream::Stream()
+    : buffer(nullptr)
+    , priority(0)
+    , lag(0.0f)
+    , convert(0.0f)
+    , cost(0.0f)
+    , lagging(false)
+    , floor(false)
+{
+}
+
+Governor::Governor()
+    : m_last_update(0)
+    , m_pressure_since(0)
+    , m_headroom_since(0)
+    , m_last_change(0)
+    , m_exit(false)
+{
+}
+
+Governor::~Governor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_wake.notify_all();
+
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    // Streams outlive the governor at full quality
+    for(Stream& stream : m_streams)
+    {
+        stream.buffer->set_quality(CaptureQuality());
+    }
+}
+
+bool Governor::init(const GovernorOptions& options, const std::function<void(const GovernorEvent&)>& events)
+{
+    if(m_thread.joinable()
+       || options.interval_ms == 0
+       || options.low_cpu > options.high_cpu
+       || options.max_frame_divisor == 0)
+    {
+        return false;
+    }
+
+    m_options = options;
+    m_events = events;
+    m_thread = std::thread([this]() { run(); });
+
+    return true;
+}
+
+bool Governor::add(IBuffer* buffer, const uint32_t& priority)
+{
+    if(buffer == nullptr)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const bool known = std::any_of(m_streams.begin(), m_streams.end(), [buffer](const Stream& stream)
+    {
+        return stream.buffer == buffer;
+    });
+
+    if(known)
+    {
+        return false;
+    }
+
+    Stream stream;
+    stream.buffer = buffer;
+    stream.priority = priority;
+    stream.last = buffer->load();
+    m_streams.push_back(stream);
+
+    return true;
+}
+
+void Governor::remove(IBuffer* buffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        if(it->buffer == buffer)
+        {
+            buffer->set_quality(CaptureQuality());
+            m_streams.erase(it);
+            break;
+        }
+    }
+}
+
+void Governor::update(const int64_t& now, const float& cpu_load)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const int64_t elapsed = m_last_update != 0 ? now - m_last_update : 0;
+    m_last_update = now;
+
+    // What every stream did since the last look
+    bool lagging = false;
+    for(Stream& stream : m_streams)
+    {
+        const StreamLoad load = stream.buffer->load();
+        const uint64_t frames = load.frames - stream.last.frames;
+        const uint64_t delivered = load.delivered - stream.last.delivered;
+        const uint64_t dropped = load.dropped - stream.last.dropped;
+        const int64_t convert_time = load.convert_time - stream.last.convert_time;
+        const int64_t latency = load.latency - stream.last.latency;
+        stream.last = load;
+
+        const double interval = static_cast<double>(load.frame_interval > 0 ? load.frame_interval : DEFAULT_FRAME_INTERVAL);
+        stream.lag = delivered > 0 ? static_cast<float>(latency / interval / delivered) : 0.0f;
+        stream.convert = delivered > 0 ? static_cast<float>(convert_time / interval / delivered) : 0.0f;
+        stream.cost = elapsed > 0 ? static_cast<float>(convert_time) / static_cast<float>(elapsed) : 0.0f;
+
+        const float dropped_ratio = frames > 0 ? static_cast<float>(dropped) / static_cast<float>(frames) : 0.0f;
+        stream.lagging = elapsed > 0 && (stream.lag > m_options.max_lag || dropped_ratio > m_options.max_dropped);
+        lagging = lagging || stream.lagging;
+    }
+
+    // Both have to last, in between nothing changes
+    const bool loaded = cpu_load > m_options.high_cpu;
+    const bool pressure = loaded || lagging;
+    const bool headroom = cpu_load < m_options.low_cpu && !lagging;
+    m_pressure_since = pressure ? (m_pressure_since != 0 ? m_pressure_since : now) : 0;
+    m_headroom_since = headroom ? (m_headroom_since != 0 ? m_headroom_since : now) : 0;
+
+    const int64_t settle = static_cast<int64_t>(m_options.settle_ms) * 10000;
+    if(m_last_change != 0 && now - m_last_change < settle)
+    {
+        return;
+    }
+
+    if(pressure && now - m_pressure_since >= static_cast<int64_t>(m_options.down_ms) * 10000)
+    {
+        // The least important stream goes first, of those the most expensive one. A lag of its
+        // own only steps the stream itself down.
+        Stream* selected = nullptr;
+        CaptureQuality selected_quality;
+        for(Stream& stream : m_streams)
+        {
+            CaptureQuality quality = stream.buffer->quality();
+            if(stream.floor || (!loaded && !stream.lagging) || !step_down(quality))
+            {
+                continue;
+            }
+
+            if(selected == nullptr
+               || stream.priority < selected->priority
+               || (stream.priority == selected->priority && stream.cost > selected->cost))
+            {
+                selected = &stream;
+                selected_quality = quality;
+            }
+        }
+
+        if(selected != nullptr)
+        {
+            if(change(*selected, selected_quality, loaded ? GovernorReason::CPU_LOAD : GovernorReason::LAG, cpu_load))
+            {
+                m_last_change = now;
+                m_pressure_since = now;
+            }
+            else
+            {
+                selected->floor = true;
+            }
+        }
+    }
+    else if(headroom && now - m_headroom_since >= static_cast<int64_t>(m_options.up_ms) * 10000)
+    {
+        // The most important stream comes back first, of those the cheapest one
+        Stream* selected = nullptr;
+        CaptureQuality selected_quality;
+        for(Stream& stream : m_streams)
+        {
+            CaptureQuality quality = stream.buffer->quality();
+            if(!step_up(quality))
+            {
+                continue;
+            }
+
+            if(selected == nullptr
+               || stream.priority > selected->priority
+               || (stream.priority == selected->priority && stream.cost < selected->cost))
+            {
+                selected = &stream;
+                selected_quality = quality;
+            }
+        }
+
+        if(selected != nullptr && change(*selected, selected_quality, GovernorReason::HEADROOM, cpu_load))
+        {
+            selected->floor = false;
+            m_last_change = now;
+            m_headroom_since = now;
+        }
+    }
+}
+
+void Governor::run()
+{
+    ThreadPlacer::apply(get_thread_policy());
+
+    SystemLoad system;
+    const std::chrono::milliseconds period(m_options.interval_ms);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!m_exit)
+    {
+        m_wake.wait_for(lock, period);
+        if(m_exit)
+        {
+            break;
+        }
+
+        lock.unlock();
+        const float cpu_load = m_options.cpu_load ? m_options.cpu_load() : system.sample();
+        update(clock_now(), cpu_load);
+        lock.lock();
+    }
+}
+
+bool Governor::step_down(CaptureQuality& quality) const
+{
+    // Frame rate first, then the format and the resolution last
+    if(quality.frame_divisor * 2 <= m_options.max_frame_divisor)
+    {
+        quality.frame_divisor *= 2;
+        return true;
+    }
+
+    if(m_options.cheap_format && !quality.cheap_format)
+    {
+        quality.cheap_format = true;
+        return true;
+    }
+
+    if(quality.resolution_steps < m_options.max_resolution_steps)
+    {
+        quality.resolution_steps++;
+        return true;
+    }
+
+    return false;
+}
+
+bool Governor::step_up(CaptureQuality& quality) const
+{
+    if(quality.resolution_steps > 0)
+    {
+        quality.resolution_steps--;
+        return true;
+    }
+
+    if(quality.cheap_format)
+    {
+        quality.cheap_format = false;
+        return true;
+    }
+
+    if(quality.frame_divisor > 1)
+    {
+        quality.frame_divisor /= 2;
+        return true;
+    }
+
+    return false;
+}
+
+bool Governor::change(Stream& stream, const CaptureQuality& quality, const GovernorReason& reason, const float& cpu_load)
+{
+    GovernorEvent event;
+    event.buffer = stream.buffer;
+    event.priority = stream.priority;
+    event.previous = stream.buffer->quality();
+    event.quality = quality;
+    event.reason = reason;
+    event.cpu_load = cpu_load;
+    event.lag = stream.lag;
+    event.convert = stream.convert;
+
+    if(!stream.buffer->set_quality(quality))
+    {
+        return false;
+    }
+
+    if(m_events)
+    {
+        m_events(event);
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,101 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace cdi {
+
+// Looks at the load of its streams every interval and steps one of them down or up at a time.
+// update() holds the decisions and is fed with the time and the system load, the thread of the
+// governor calls it with the measured load or the one of the load model.
+class Governor : public IGovernor
+{
+    Governor(const Governor&);
+    Governor& operator=(const Governor&);
+
+public:
+    Governor();
+    ~Governor();
+
+    bool init(const GovernorOptions& options, const std::function<void(const GovernorEvent&)>& events);
+    bool add(IBuffer* buffer, const uint32_t& priority) final;
+    void remove(IBuffer* buffer) final;
+
+    // 'now' in clock_now() units, 'cpu_load' 0..1
+    void update(const int64_t& now, const float& cpu_load);
+
+private:
+    struct Stream
+    {
+        Stream();
+        IBuffer* buffer;
+        uint32_t priority;
+        StreamLoad last;
+        float lag;     // Frame intervals, see GovernorEvent
+        float convert;
+        float cost;    // Conversion time per time, the share of a processor the stream takes
+        bool lagging;
+        bool floor;    // The last step down was refused, no further ones until a step up
+    };
+
+    void run();
+    // Next quality down or up, false when there is none
+    bool step_down(CaptureQuality& quality) const;
+    bool step_up(CaptureQuality& quality) const;
+    // Asks the stream for the quality and reports it, false when the stream refused
+    bool change(Stream& stream, const CaptureQuality& quality, const GovernorReason& reason, const float& cpu_load);
+
+private:
+    GovernorOptions m_options;
+    std::function<void(const GovernorEvent&)> m_events;
+    std::vector<Stream> m_streams;
+    int64_t m_last_update;
+    int64_t m_pressure_since; // Zero while there is no pressure
+    int64_t m_headroom_since; // Zero while there is no headroom
+    int64_t m_last_change;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+    bool m_exit;
+};
+
+}
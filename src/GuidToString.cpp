@@ -31,6 +31,7 @@
 */
 
 #include "GuidToString.h"
+#include "VideoFormats.h"
 
 #include <mfapi.h>
 
@@ -137,6 +138,7 @@ const char* GuidToString(const GUID& guid)
     IF_EQUAL_RETURN(guid, MFVideoFormat_H264); //     FCC('H264')
     IF_EQUAL_RETURN(guid, MFVideoFormat_I420); //     FCC('I420')
     IF_EQUAL_RETURN(guid, MFVideoFormat_IYUV); //     FCC('IYUV')
+    IF_EQUAL_RETURN(guid, MFVideoFormat_L16); //      D3DFMT_L16
     IF_EQUAL_RETURN(guid, MFVideoFormat_M4S2); //     FCC('M4S2')
     IF_EQUAL_RETURN(guid, MFVideoFormat_MJPG);
     IF_EQUAL_RETURN(guid, MFVideoFormat_MP43); //     FCC('MP43')
@@ -188,7 +190,8 @@ const char* GuidToString(const GUID& guid)
     IF_EQUAL_RETURN(guid, MFAudioFormat_AAC); //              WAVE_FORMAT_MPEG_HEAAC 
     IF_EQUAL_RETURN(guid, MFAudioFormat_ADTS); //             WAVE_FORMAT_MPEG_ADTS_AAC 
 
-    return nullptr;
+    // Raw sensor formats have no name in the SDK
+    return bayer_format_name(guid);
 }
 
 }
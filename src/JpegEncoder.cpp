@@ -0,0 +1,900 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "JpegEncoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+#include <xmmintrin.h>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+
+namespace cdi {
+
+namespace {
+
+const uint32_t MAX_DIMENSION = 0xFFFF;
+const size_t HEADER_BOUND = 1024;
+// Per MCU of six blocks: 16 + 11 bits of DC and 63 times 16 + 10 bits of AC per block, doubled
+// for the zero bytes after every 0xFF
+const size_t MCU_BOUND = 6 * 2 * ((27 + 63 * 26 + 7) / 8);
+
+// Natural (row major) index of each zigzag position
+const uint8_t ZIGZAG[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Tables K.1 and K.2 of the standard at quality 50
+const uint8_t LUMA_QUANT[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+const uint8_t CHROMA_QUANT[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// Huffman tables K.3 to K.6, code counts per length followed by the symbols
+const uint8_t DC_LUMA_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+const uint8_t DC_CHROMA_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+const uint8_t DC_VALUES[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+const uint8_t AC_LUMA_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
+const uint8_t AC_LUMA_VALUES[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+};
+
+const uint8_t AC_CHROMA_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+const uint8_t AC_CHROMA_VALUES[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+};
+
+// Limited range (16..235, 16..240) is stretched to the full range of JFIF within the DCT, which is
+// linear: the level shift moves and the quantization scales the coefficients
+const uint32_t FULL = 0;
+const uint32_t LIMITED = 1;
+const float LIMITED_STRETCH[2] = {255.0f / 219.0f, 255.0f / 224.0f};
+const float LIMITED_LUMA_LEVEL = 16.0f + 128.0f * 219.0f / 255.0f;
+
+// cos(k * pi / 16) * sqrt(2), the scale the AAN DCT leaves on its outputs
+const float AAN_SCALE[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+};
+
+// The DCT writes its output transposed, coefficient (row v, column u) at u * 8 + v
+uint32_t transposed(const uint32_t& index)
+{
+    return (index % 8) * 8 + index / 8;
+}
+
+// Position of each zigzag coefficient in the transposed order
+const uint8_t ZIGZAG_TRANSPOSED[64] = {
+     0,  8,  1,  2,  9, 16, 24, 17,
+    10,  3,  4, 11, 18, 25, 32, 40,
+    33, 26, 19, 12,  5,  6, 13, 20,
+    27, 34, 41, 48, 56, 49, 42, 35,
+    28, 21, 14,  7, 15, 22, 29, 36,
+    43, 50, 57, 58, 51, 44, 37, 30,
+    23, 31, 38, 45, 52, 59, 60, 53,
+    46, 39, 47, 54, 61, 62, 55, 63,
+};
+
+uint32_t count_trailing_zeros(const uint64_t& value)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward64(&index, value);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+// Bits needed for the magnitude, the size category of the standard
+uint32_t bit_length(const uint32_t& value)
+{
+    if(value == 0)
+    {
+        return 0;
+    }
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanReverse(&index, value);
+    return index + 1;
+#else
+    return 32 - static_cast<uint32_t>(__builtin_clz(value));
+#endif
+}
+
+uint32_t floor_log2(const uint32_t& value)
+{
+    return bit_length(value) - 1;
+}
+
+void build_huffman(const uint8_t* bits, const uint8_t* values, uint16_t* codes, uint8_t* sizes)
+{
+    // Canonical codes as in Annex C
+    uint32_t code = 0;
+    uint32_t k = 0;
+    for(uint32_t length = 1; length <= 16; length++)
+    {
+        for(uint32_t i = 0; i < bits[length - 1]; i++)
+        {
+            codes[values[k]] = static_cast<uint16_t>(code++);
+            sizes[values[k]] = static_cast<uint8_t>(length);
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+// MSB-first bit packing with a zero byte after every 0xFF of the entropy coded data
+class JpegBits
+{
+public:
+    JpegBits(uint8_t* dst, const size_t& capacity)
+        : m_begin(dst), m_dst(dst), m_end(dst + capacity), m_acc(0), m_bits(0), m_overflow(false)
+    {
+    }
+
+    // 'code' has no bits above 'length', which is at most 32
+    void put(const uint32_t& code, const uint32_t& length)
+    {
+        m_acc = (m_acc << length) | code;
+        m_bits += length;
+        if(m_bits >= 32)
+        {
+            m_bits -= 32;
+            flush(static_cast<uint32_t>(m_acc >> m_bits));
+        }
+    }
+
+    // Pads the last byte with ones, returns number of written bytes, zero on overflow
+    size_t finish()
+    {
+        const uint32_t pad = (8 - m_bits % 8) % 8;
+        put((1u << pad) - 1, pad);
+        while(m_bits >= 8 && !m_overflow)
+        {
+            m_bits -= 8;
+            emit(static_cast<uint8_t>(m_acc >> m_bits));
+        }
+        return m_overflow ? 0 : static_cast<size_t>(m_dst - m_begin);
+    }
+
+private:
+    void flush(const uint32_t& word)
+    {
+        // Room for four bytes and their stuffing, overflowing output keeps going from the start
+        if(m_end - m_dst < 8)
+        {
+            m_overflow = true;
+            m_dst = m_begin;
+        }
+
+        // A byte of 0xFF is a zero byte of the inverted word
+        const uint32_t inverted = ~word;
+        if(((inverted - 0x01010101u) & ~inverted & 0x80808080u) == 0)
+        {
+            m_dst[0] = static_cast<uint8_t>(word >> 24);
+            m_dst[1] = static_cast<uint8_t>(word >> 16);
+            m_dst[2] = static_cast<uint8_t>(word >> 8);
+            m_dst[3] = static_cast<uint8_t>(word);
+            m_dst += 4;
+            return;
+        }
+
+        for(int32_t shift = 24; shift >= 0; shift -= 8)
+        {
+            const uint8_t byte = static_cast<uint8_t>(word >> shift);
+            *m_dst++ = byte;
+            if(byte == 0xFF)
+            {
+                *m_dst++ = 0;
+            }
+        }
+    }
+
+    void emit(const uint8_t& byte)
+    {
+        if(m_end - m_dst < 2)
+        {
+            m_overflow = true;
+            return;
+        }
+        *m_dst++ = byte;
+        if(byte == 0xFF)
+        {
+            *m_dst++ = 0;
+        }
+    }
+
+private:
+    uint8_t* m_begin;
+    uint8_t* m_dst;
+    uint8_t* m_end;
+    uint64_t m_acc;
+    uint32_t m_bits;
+    bool m_overflow;
+};
+
+// One pass of the AAN DCT over eight vectors of four lanes each
+void dct_pass(__m128* d)
+{
+    const __m128 c0_707 = _mm_set1_ps(0.707106781f);
+    const __m128 c0_382 = _mm_set1_ps(0.382683433f);
+    const __m128 c0_541 = _mm_set1_ps(0.541196100f);
+    const __m128 c1_306 = _mm_set1_ps(1.306562965f);
+
+    const __m128 tmp0 = _mm_add_ps(d[0], d[7]);
+    const __m128 tmp7 = _mm_sub_ps(d[0], d[7]);
+    const __m128 tmp1 = _mm_add_ps(d[1], d[6]);
+    const __m128 tmp6 = _mm_sub_ps(d[1], d[6]);
+    const __m128 tmp2 = _mm_add_ps(d[2], d[5]);
+    const __m128 tmp5 = _mm_sub_ps(d[2], d[5]);
+    const __m128 tmp3 = _mm_add_ps(d[3], d[4]);
+    const __m128 tmp4 = _mm_sub_ps(d[3], d[4]);
+
+    // Even part
+    const __m128 tmp10 = _mm_add_ps(tmp0, tmp3);
+    const __m128 tmp13 = _mm_sub_ps(tmp0, tmp3);
+    const __m128 tmp11 = _mm_add_ps(tmp1, tmp2);
+    const __m128 tmp12 = _mm_sub_ps(tmp1, tmp2);
+
+    d[0] = _mm_add_ps(tmp10, tmp11);
+    d[4] = _mm_sub_ps(tmp10, tmp11);
+
+    const __m128 z1 = _mm_mul_ps(_mm_add_ps(tmp12, tmp13), c0_707);
+    d[2] = _mm_add_ps(tmp13, z1);
+    d[6] = _mm_sub_ps(tmp13, z1);
+
+    // Odd part
+    const __m128 odd10 = _mm_add_ps(tmp4, tmp5);
+    const __m128 odd11 = _mm_add_ps(tmp5, tmp6);
+    const __m128 odd12 = _mm_add_ps(tmp6, tmp7);
+
+    const __m128 z5 = _mm_mul_ps(_mm_sub_ps(odd10, odd12), c0_382);
+    const __m128 z2 = _mm_add_ps(_mm_mul_ps(odd10, c0_541), z5);
+    const __m128 z4 = _mm_add_ps(_mm_mul_ps(odd12, c1_306), z5);
+    const __m128 z3 = _mm_mul_ps(odd11, c0_707);
+
+    const __m128 z11 = _mm_add_ps(tmp7, z3);
+    const __m128 z13 = _mm_sub_ps(tmp7, z3);
+
+    d[5] = _mm_add_ps(z13, z2);
+    d[3] = _mm_sub_ps(z13, z2);
+    d[1] = _mm_add_ps(z11, z4);
+    d[7] = _mm_sub_ps(z11, z4);
+}
+
+// DCT of the 8x8 block at 'src' less 'level' and quantization, 'out' in transposed order
+void forward_dct(const uint8_t* src, const size_t& stride, const float& level, const float* scales, int16_t* out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 bias = _mm_set1_ps(level);
+    const __m128i limit = _mm_set1_epi16(1023);
+    const __m128i negative_limit = _mm_set1_epi16(-1023);
+
+    // Columns 0..3 and 4..7 of each row
+    __m128 lo[8];
+    __m128 hi[8];
+    for(uint32_t row = 0; row < 8; row++)
+    {
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + stride * row));
+        const __m128i words = _mm_unpacklo_epi8(bytes, zero);
+        lo[row] = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), bias);
+        hi[row] = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), bias);
+    }
+
+    // Vertical pass, then the horizontal one on the transposed block
+    dct_pass(lo);
+    dct_pass(hi);
+
+    _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+    _MM_TRANSPOSE4_PS(lo[4], lo[5], lo[6], lo[7]);
+    _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+    _MM_TRANSPOSE4_PS(hi[4], hi[5], hi[6], hi[7]);
+
+    // The upper right and lower left quarters trade places
+    __m128 left[8] = {lo[0], lo[1], lo[2], lo[3], hi[0], hi[1], hi[2], hi[3]};
+    __m128 right[8] = {lo[4], lo[5], lo[6], lo[7], hi[4], hi[5], hi[6], hi[7]};
+    dct_pass(left);
+    dct_pass(right);
+
+    for(uint32_t row = 0; row < 8; row++)
+    {
+        const __m128i a = _mm_cvtps_epi32(_mm_mul_ps(left[row], _mm_loadu_ps(scales + row * 8)));
+        const __m128i b = _mm_cvtps_epi32(_mm_mul_ps(right[row], _mm_loadu_ps(scales + row * 8 + 4)));
+        // Baseline AC sizes end at 10 bits
+        const __m128i clamped = _mm_max_epi16(_mm_min_epi16(_mm_packs_epi32(a, b), limit), negative_limit);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + row * 8), clamped);
+    }
+}
+
+// Entropy coding of one quantized block, 'coefficients' in the transposed order of forward_dct()
+void put_block(
+    JpegBits& bits,
+    const int16_t* coefficients,
+    int32_t& dc_prediction,
+    const uint16_t* dc_codes,
+    const uint8_t* dc_sizes,
+    const uint16_t* ac_codes,
+    const uint8_t* ac_sizes)
+{
+    alignas(16) int16_t zigzag[64];
+    for(uint32_t i = 0; i < 64; i++)
+    {
+        zigzag[i] = coefficients[ZIGZAG_TRANSPOSED[i]];
+    }
+
+    // Difference to the DC of the previous block of the component
+    const int32_t diff = zigzag[0] - dc_prediction;
+    dc_prediction = zigzag[0];
+    const uint32_t magnitude = static_cast<uint32_t>(diff < 0 ? -diff : diff);
+    const uint32_t dc_size = bit_length(magnitude);
+    const uint32_t dc_bits = static_cast<uint32_t>(diff < 0 ? diff - 1 : diff) & ((1u << dc_size) - 1);
+    bits.put((static_cast<uint32_t>(dc_codes[dc_size]) << dc_size) | dc_bits, dc_sizes[dc_size] + dc_size);
+
+    // Bit i of 'mask' for a nonzero coefficient at zigzag position i, zero runs are the gaps
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t mask = 0;
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(zigzag + i * 16));
+        const __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(zigzag + i * 16 + 8));
+        const __m128i zeros = _mm_packs_epi16(_mm_cmpeq_epi16(a, zero), _mm_cmpeq_epi16(b, zero));
+        mask |= static_cast<uint64_t>(~_mm_movemask_epi8(zeros) & 0xFFFF) << (i * 16);
+    }
+    mask &= ~static_cast<uint64_t>(1);
+
+    uint32_t last = 0;
+    while(mask != 0)
+    {
+        const uint32_t index = count_trailing_zeros(mask);
+        mask &= mask - 1;
+
+        uint32_t run = index - last - 1;
+        last = index;
+        while(run >= 16)
+        {
+            bits.put(ac_codes[0xF0], ac_sizes[0xF0]);
+            run -= 16;
+        }
+
+        // Negative values are sent as the ones' complement of the magnitude
+        const int32_t value = zigzag[index];
+        const int32_t sign = value >> 31;
+        const uint32_t size = bit_length(static_cast<uint32_t>((value ^ sign) - sign));
+        const uint32_t value_bits = static_cast<uint32_t>(value + sign) & ((1u << size) - 1);
+        const uint32_t symbol = (run << 4) | size;
+        bits.put((static_cast<uint32_t>(ac_codes[symbol]) << size) | value_bits, ac_sizes[symbol] + size);
+    }
+
+    if(last != 63)
+    {
+        bits.put(ac_codes[0x00], ac_sizes[0x00]);
+    }
+}
+
+// Every 'step'th byte (1, 2 or 4) of 'row0', averaged with 'row1' unless that is null
+void pick_row(const uint8_t* row0, const uint8_t* row1, const uint32_t& step, const uint32_t& count, uint8_t* dst)
+{
+    uint32_t x = 0;
+    if(step == 1 && row1 == nullptr)
+    {
+        std::memcpy(dst, row0, count);
+        return;
+    }
+
+    // Loads stay short of the last sample, it may end the frame memory with fewer than 16 bytes
+    const __m128i low16 = _mm_set1_epi16(0x00FF);
+    const __m128i low32 = _mm_set1_epi32(0x000000FF);
+    for(; x + 16 < count; x += 16)
+    {
+        __m128i v[4] = {};
+        for(uint32_t i = 0; i < step; i++)
+        {
+            v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + (x + i * 16 / step) * step));
+            if(row1 != nullptr)
+            {
+                const __m128i other = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + (x + i * 16 / step) * step));
+                v[i] = _mm_avg_epu8(v[i], other);
+            }
+        }
+
+        __m128i packed = v[0];
+        if(step == 2)
+        {
+            packed = _mm_packus_epi16(_mm_and_si128(v[0], low16), _mm_and_si128(v[1], low16));
+        }
+        else if(step == 4)
+        {
+            const __m128i first = _mm_packs_epi32(_mm_and_si128(v[0], low32), _mm_and_si128(v[1], low32));
+            const __m128i second = _mm_packs_epi32(_mm_and_si128(v[2], low32), _mm_and_si128(v[3], low32));
+            packed = _mm_packus_epi16(first, second);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+    }
+
+    for(; x < count; x++)
+    {
+        const uint32_t a = row0[x * step];
+        dst[x] = static_cast<uint8_t>(row1 != nullptr ? (a + row1[x * step] + 1) >> 1 : a);
+    }
+}
+
+// One row of 'count' samples, each the rounded mean of 'row_count' rows by 'cols' samples of the
+// source rows, 'step' bytes apart. Boxes past 'limit' samples repeat the last one. 'picked' and
+// 'sums' hold 'limit' samples.
+void box_row(
+    const uint8_t* const* rows,
+    const uint32_t& row_count,
+    const uint32_t& cols,
+    const uint32_t& step,
+    const uint32_t& count,
+    const uint32_t& limit,
+    uint8_t* picked,
+    uint16_t* sums,
+    uint8_t* dst)
+{
+    const uint32_t shift = floor_log2(row_count * cols);
+    const uint32_t half = (1u << shift) >> 1;
+    const uint32_t inside = std::min(count, limit / cols);
+
+    if(cols == 1 && row_count <= 2)
+    {
+        pick_row(rows[0], row_count == 2 ? rows[1] : nullptr, step, inside, dst);
+    }
+    else
+    {
+        // Columns of the boxes are summed first, at most 16 rows of 8 bits fit into 16 bits
+        const uint32_t samples = inside * cols;
+        std::memset(sums, 0, samples * sizeof(uint16_t));
+        const __m128i zero = _mm_setzero_si128();
+        for(uint32_t r = 0; r < row_count; r++)
+        {
+            pick_row(rows[r], nullptr, step, samples, picked);
+
+            uint32_t x = 0;
+            for(; x + 16 <= samples; x += 16)
+            {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(picked + x));
+                __m128i* sum = reinterpret_cast<__m128i*>(sums + x);
+                _mm_storeu_si128(sum, _mm_add_epi16(_mm_loadu_si128(sum), _mm_unpacklo_epi8(bytes, zero)));
+                _mm_storeu_si128(sum + 1, _mm_add_epi16(_mm_loadu_si128(sum + 1), _mm_unpackhi_epi8(bytes, zero)));
+            }
+            for(; x < samples; x++)
+            {
+                sums[x] = static_cast<uint16_t>(sums[x] + picked[x]);
+            }
+        }
+
+        for(uint32_t x = 0; x < inside; x++)
+        {
+            uint32_t sum = 0;
+            for(uint32_t c = 0; c < cols; c++)
+            {
+                sum += sums[x * cols + c];
+            }
+            dst[x] = static_cast<uint8_t>((sum + half) >> shift);
+        }
+    }
+
+    for(uint32_t x = inside; x < count; x++)
+    {
+        uint32_t sum = 0;
+        for(uint32_t r = 0; r < row_count; r++)
+        {
+            for(uint32_t c = 0; c < cols; c++)
+            {
+                sum += rows[r][std::min(x * cols + c, limit - 1) * step];
+            }
+        }
+        dst[x] = static_cast<uint8_t>((sum + half) >> shift);
+    }
+}
+
+// Repeats the last sample up to the block boundary
+void pad_row(uint8_t* row, const uint32_t& count, const uint32_t& padded)
+{
+    std::memset(row + count, row[count - 1], padded - count);
+}
+
+void put_u16(uint8_t*& dst, const uint32_t& value)
+{
+    dst[0] = static_cast<uint8_t>(value >> 8);
+    dst[1] = static_cast<uint8_t>(value);
+    dst += 2;
+}
+
+void put_huffman(uint8_t*& dst, const uint8_t& table, const uint8_t* bits, const uint8_t* values)
+{
+    uint32_t count = 0;
+    *dst++ = table;
+    for(uint32_t i = 0; i < 16; i++)
+    {
+        *dst++ = bits[i];
+        count += bits[i];
+    }
+    std::memcpy(dst, values, count);
+    dst += count;
+}
+
+}
+
+JpegEncoder::JpegEncoder()
+    : m_quality(0)
+    , m_strip_pitch(0)
+{
+}
+
+JpegEncoder::~JpegEncoder()
+{
+}
+
+bool JpegEncoder::init(const uint32_t& quality)
+{
+    if(quality < 1 || quality > 100)
+    {
+        return false;
+    }
+
+    const uint32_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    const uint8_t* bases[2] = {LUMA_QUANT, CHROMA_QUANT};
+    for(uint32_t table = 0; table < 2; table++)
+    {
+        uint32_t divisors[64];
+        for(uint32_t i = 0; i < 64; i++)
+        {
+            divisors[i] = std::min(255u, std::max(1u, (bases[table][i] * scale + 50) / 100));
+        }
+
+        for(uint32_t i = 0; i < 64; i++)
+        {
+            m_tables[table][i] = static_cast<uint8_t>(divisors[ZIGZAG[i]]);
+
+            // Output i of the DCT is row i % 8, column i / 8 and still carries the AAN scale
+            const float divisor = divisors[transposed(i)] * AAN_SCALE[i / 8] * AAN_SCALE[i % 8] * 8.0f;
+            m_scales[FULL][table][i] = 1.0f / divisor;
+            m_scales[LIMITED][table][i] = LIMITED_STRETCH[table] / divisor;
+        }
+    }
+
+    std::memset(m_dc, 0, sizeof(m_dc));
+    std::memset(m_ac, 0, sizeof(m_ac));
+    build_huffman(DC_LUMA_BITS, DC_VALUES, m_dc[0].code, m_dc[0].size);
+    build_huffman(DC_CHROMA_BITS, DC_VALUES, m_dc[1].code, m_dc[1].size);
+    build_huffman(AC_LUMA_BITS, AC_LUMA_VALUES, m_ac[0].code, m_ac[0].size);
+    build_huffman(AC_CHROMA_BITS, AC_CHROMA_VALUES, m_ac[1].code, m_ac[1].size);
+
+    m_quality = quality;
+
+    return true;
+}
+
+uint32_t JpegEncoder::quality() const
+{
+    return m_quality;
+}
+
+size_t JpegEncoder::bound(const uint32_t& width, const uint32_t& height)
+{
+    const size_t mcus = static_cast<size_t>((width + 15) / 16) * ((height + 15) / 16);
+    return HEADER_BOUND + mcus * MCU_BOUND;
+}
+
+size_t JpegEncoder::encode(
+    const kernels::YuvFormat& format,
+    const uint8_t* src,
+    const int32_t& pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const uint32_t& scale,
+    const ColorRange& range,
+    uint8_t* dst,
+    const size_t& dst_size)
+{
+    if(m_quality == 0 || src == nullptr || dst == nullptr
+       || (scale != 1 && scale != 2 && scale != 4 && scale != 8))
+    {
+        return 0;
+    }
+
+    const uint32_t out_width = width / scale;
+    const uint32_t out_height = height / scale;
+    if(out_width == 0 || out_height == 0 || out_width > MAX_DIMENSION || out_height > MAX_DIMENSION)
+    {
+        return 0;
+    }
+
+    const uint32_t set = range == ColorRange::LIMITED ? LIMITED : FULL;
+    const float* luma_scales = m_scales[set][0];
+    const float* chroma_scales = m_scales[set][1];
+    const float luma_level = set == LIMITED ? LIMITED_LUMA_LEVEL : 128.0f;
+
+    const uint32_t mcu_columns = (out_width + 15) / 16;
+    const uint32_t mcu_rows = (out_height + 15) / 16;
+    m_strip_pitch = mcu_columns * 16;
+    m_strip.resize(static_cast<size_t>(m_strip_pitch) * 24);
+
+    uint8_t header[HEADER_BOUND];
+    const size_t header_size = write_headers(header, out_width, out_height);
+    if(header_size + 2 > dst_size)
+    {
+        return 0;
+    }
+    std::memcpy(dst, header, header_size);
+
+    // The end marker follows the entropy coded data
+    JpegBits bits(dst + header_size, dst_size - header_size - 2);
+
+    Source source;
+    source.format = format;
+    source.src = src;
+    source.pitch = pitch;
+    source.width = width;
+    source.height = height;
+    source.scale = scale;
+
+    const size_t luma_pitch = m_strip_pitch;
+    const size_t chroma_pitch = m_strip_pitch / 2;
+    const uint8_t* luma = m_strip.data();
+    const uint8_t* u = luma + luma_pitch * 16;
+    const uint8_t* v = u + chroma_pitch * 8;
+
+    int32_t dc[3] = {0, 0, 0};
+    alignas(16) int16_t block[64];
+    for(uint32_t mcu_row = 0; mcu_row < mcu_rows; mcu_row++)
+    {
+        fill_strip(source, mcu_row * 16, out_width, out_height);
+
+        for(uint32_t mcu = 0; mcu < mcu_columns; mcu++)
+        {
+            // Four luma blocks in raster order, then one block of each chroma plane
+            for(uint32_t i = 0; i < 4; i++)
+            {
+                const uint8_t* origin = luma + luma_pitch * 8 * (i / 2) + mcu * 16 + 8 * (i % 2);
+                forward_dct(origin, luma_pitch, luma_level, luma_scales, block);
+                put_block(bits, block, dc[0], m_dc[0].code, m_dc[0].size, m_ac[0].code, m_ac[0].size);
+            }
+
+            forward_dct(u + mcu * 8, chroma_pitch, 128.0f, chroma_scales, block);
+            put_block(bits, block, dc[1], m_dc[1].code, m_dc[1].size, m_ac[1].code, m_ac[1].size);
+
+            forward_dct(v + mcu * 8, chroma_pitch, 128.0f, chroma_scales, block);
+            put_block(bits, block, dc[2], m_dc[1].code, m_dc[1].size, m_ac[1].code, m_ac[1].size);
+        }
+    }
+
+    const size_t data_size = bits.finish();
+    if(data_size == 0)
+    {
+        return 0;
+    }
+
+    size_t size = header_size + data_size;
+    dst[size++] = 0xFF;
+    dst[size++] = 0xD9;
+
+    return size;
+}
+
+void JpegEncoder::fill_strip(
+    const Source& source,
+    const uint32_t& row,
+    const uint32_t& out_width,
+    const uint32_t& out_height)
+{
+    const uint32_t scale = source.scale;
+    const ptrdiff_t pitch = source.pitch;
+
+    // Chroma planes as the conversion kernels find them, YUY2 chroma has every row
+    const uint8_t* u_plane = nullptr;
+    const uint8_t* v_plane = nullptr;
+    ptrdiff_t chroma_pitch = 0;
+    uint32_t luma_step = 1;
+    uint32_t chroma_step = 1;
+    uint32_t chroma_rows = 1;
+    uint32_t chroma_height = source.height / 2;
+    switch(source.format)
+    {
+    case kernels::YuvFormat::I420:
+        chroma_pitch = pitch / 2;
+        u_plane = source.src + pitch * source.height;
+        v_plane = u_plane + chroma_pitch * (source.height / 2);
+        break;
+    case kernels::YuvFormat::NV12:
+        chroma_pitch = pitch;
+        u_plane = source.src + pitch * source.height;
+        v_plane = u_plane + 1;
+        chroma_step = 2;
+        break;
+    case kernels::YuvFormat::YUY2:
+    default:
+        chroma_pitch = pitch;
+        u_plane = source.src + 1;
+        v_plane = source.src + 3;
+        luma_step = 2;
+        chroma_step = 4;
+        chroma_rows = 2;
+        chroma_height = source.height;
+        break;
+    }
+
+    const uint32_t chroma_width = std::max(1u, source.width / 2);
+    chroma_height = std::max(1u, chroma_height);
+
+    const uint32_t luma_padded = m_strip_pitch;
+    const uint32_t chroma_padded = m_strip_pitch / 2;
+    uint8_t* luma = m_strip.data();
+    uint8_t* u = luma + static_cast<size_t>(luma_padded) * 16;
+    uint8_t* v = u + static_cast<size_t>(chroma_padded) * 8;
+
+    m_picked.resize(source.width);
+    m_sums.resize(source.width);
+    uint8_t* picked = m_picked.data();
+    uint16_t* sums = m_sums.data();
+
+    // Rows past the image repeat the last one
+    const uint8_t* rows[16];
+    const uint8_t* v_rows[16];
+    for(uint32_t r = 0; r < 16; r++)
+    {
+        const uint32_t y = std::min(row + r, out_height - 1);
+        for(uint32_t k = 0; k < scale; k++)
+        {
+            rows[k] = source.src + pitch * (y * scale + k);
+        }
+
+        uint8_t* dst = luma + static_cast<size_t>(luma_padded) * r;
+        box_row(rows, scale, scale, luma_step, out_width, source.width, picked, sums, dst);
+        pad_row(dst, out_width, luma_padded);
+    }
+
+    const uint32_t chroma_out_width = (out_width + 1) / 2;
+    const uint32_t chroma_out_height = (out_height + 1) / 2;
+    const uint32_t box_rows = chroma_rows * scale;
+    for(uint32_t r = 0; r < 8; r++)
+    {
+        const uint32_t y = std::min(row / 2 + r, chroma_out_height - 1);
+        for(uint32_t k = 0; k < box_rows; k++)
+        {
+            const ptrdiff_t offset = chroma_pitch * std::min(y * box_rows + k, chroma_height - 1);
+            rows[k] = u_plane + offset;
+            v_rows[k] = v_plane + offset;
+        }
+
+        uint8_t* u_dst = u + static_cast<size_t>(chroma_padded) * r;
+        uint8_t* v_dst = v + static_cast<size_t>(chroma_padded) * r;
+        box_row(rows, box_rows, scale, chroma_step, chroma_out_width, chroma_width, picked, sums, u_dst);
+        box_row(v_rows, box_rows, scale, chroma_step, chroma_out_width, chroma_width, picked, sums, v_dst);
+        pad_row(u_dst, chroma_out_width, chroma_padded);
+        pad_row(v_dst, chroma_out_width, chroma_padded);
+    }
+}
+
+size_t JpegEncoder::write_headers(uint8_t* dst, const uint32_t& width, const uint32_t& height) const
+{
+    uint8_t* begin = dst;
+
+    // SOI and a JFIF APP0 without thumbnail
+    put_u16(dst, 0xFFD8);
+    put_u16(dst, 0xFFE0);
+    put_u16(dst, 16);
+    const uint8_t jfif[14] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    std::memcpy(dst, jfif, sizeof(jfif));
+    dst += sizeof(jfif);
+
+    // Both quantization tables in one DQT
+    put_u16(dst, 0xFFDB);
+    put_u16(dst, 2 + 2 * 65);
+    for(uint8_t table = 0; table < 2; table++)
+    {
+        *dst++ = table;
+        std::memcpy(dst, m_tables[table], 64);
+        dst += 64;
+    }
+
+    // Baseline frame, luma sampled 2x2 against chroma
+    put_u16(dst, 0xFFC0);
+    put_u16(dst, 17);
+    *dst++ = 8;
+    put_u16(dst, height);
+    put_u16(dst, width);
+    *dst++ = 3;
+    const uint8_t components[9] = {1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+    std::memcpy(dst, components, sizeof(components));
+    dst += sizeof(components);
+
+    put_u16(dst, 0xFFC4);
+    put_u16(dst, static_cast<uint32_t>(
+        2 + 4 * 17 + 2 * sizeof(DC_VALUES) + sizeof(AC_LUMA_VALUES) + sizeof(AC_CHROMA_VALUES)));
+    put_huffman(dst, 0x00, DC_LUMA_BITS, DC_VALUES);
+    put_huffman(dst, 0x10, AC_LUMA_BITS, AC_LUMA_VALUES);
+    put_huffman(dst, 0x01, DC_CHROMA_BITS, DC_VALUES);
+    put_huffman(dst, 0x11, AC_CHROMA_BITS, AC_CHROMA_VALUES);
+
+    put_u16(dst, 0xFFDA);
+    put_u16(dst, 12);
+    const uint8_t scan[10] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+    std::memcpy(dst, scan, sizeof(scan));
+    dst += sizeof(scan);
+
+    return static_cast<size_t>(dst - begin);
+}
+
+}
@@ -0,0 +1,113 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "ColorKernels.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace cdi {
+
+// Baseline JPEG straight from the YUV planes of a native frame: no RGB round trip, 4:2:0
+// output with the standard Huffman tables. A row of MCUs is gathered (and box downscaled) at a
+// time, blocks go through a float AAN DCT and the quantization with SSE2.
+class JpegEncoder
+{
+    JpegEncoder(const JpegEncoder&);
+    JpegEncoder& operator=(const JpegEncoder&);
+
+public:
+    JpegEncoder();
+    ~JpegEncoder();
+
+    // 'quality' 1..100 scales the tables of the standard as the IJG encoder does
+    bool init(const uint32_t& quality);
+    uint32_t quality() const;
+
+    // 'src' is the first row of the frame and 'pitch' its luma pitch, the chroma planes follow as
+    // for the conversion kernels. The image is 'width' / 'scale' by 'height' / 'scale', 'scale'
+    // 1, 2, 4 or 8. Limited range samples are stretched to the full range of JFIF. Returns the
+    // encoded size, zero when the image does not fit into 'dst'.
+    size_t encode(
+        const kernels::YuvFormat& format,
+        const uint8_t* src,
+        const int32_t& pitch,
+        const uint32_t& width,
+        const uint32_t& height,
+        const uint32_t& scale,
+        const ColorRange& range,
+        uint8_t* dst,
+        const size_t& dst_size);
+
+    // Worst case size of an image of width x height, including the headers
+    static size_t bound(const uint32_t& width, const uint32_t& height);
+
+private:
+    struct Huffman
+    {
+        uint16_t code[256];
+        uint8_t size[256];
+    };
+
+    struct Source
+    {
+        kernels::YuvFormat format;
+        const uint8_t* src;
+        int32_t pitch;
+        uint32_t width;
+        uint32_t height;
+        uint32_t scale;
+    };
+
+    // Gathers the luma rows and chroma rows of the MCU row starting at image row 'row'
+    void fill_strip(const Source& source, const uint32_t& row, const uint32_t& out_width, const uint32_t& out_height);
+    size_t write_headers(uint8_t* dst, const uint32_t& width, const uint32_t& height) const;
+
+private:
+    uint32_t m_quality;
+    uint8_t m_tables[2][64];  // Zigzag order, as written to the file
+    float m_scales[2][2][64]; // Reciprocal divisors in the transposed order of the DCT, per range
+    Huffman m_dc[2];
+    Huffman m_ac[2];
+
+    // One row of MCUs: 16 luma rows, 8 rows of each chroma plane, padded to whole blocks
+    std::vector<uint8_t> m_strip;
+    uint32_t m_strip_pitch;
+    std::vector<uint8_t> m_picked; // Rows of the box filter
+    std::vector<uint16_t> m_sums;
+};
+
+}
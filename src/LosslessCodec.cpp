@@ -0,0 +1,1118 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "LosslessCodec.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+
+namespace cdi {
+
+namespace {
+
+const uint32_t MAGIC = 0x4C494443; // 'CDIL'
+const uint8_t VERSION = 2;
+const size_t HEADER_SIZE = 24;
+const uint32_t BLOCK_SIZE = 32;
+const uint32_t ZERO_BLOCK = 8;       // Block header of a block of zeros, one past the largest k
+const uint32_t ZERO_BLOCK_WIDE = 15; // The same for two byte samples
+const uint32_t ESCAPE = 16;
+const uint32_t MIN_SLICE_ROWS = 16;
+
+void write_u32(uint8_t* dst, const uint32_t& value)
+{
+    dst[0] = static_cast<uint8_t>(value);
+    dst[1] = static_cast<uint8_t>(value >> 8);
+    dst[2] = static_cast<uint8_t>(value >> 16);
+    dst[3] = static_cast<uint8_t>(value >> 24);
+}
+
+uint32_t read_u32(const uint8_t* src)
+{
+    return static_cast<uint32_t>(src[0])
+        | (static_cast<uint32_t>(src[1]) << 8)
+        | (static_cast<uint32_t>(src[2]) << 16)
+        | (static_cast<uint32_t>(src[3]) << 24);
+}
+
+uint32_t count_trailing_zeros(const uint64_t& value)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward64(&index, value);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+// LSB-first bit packing
+class BitWriter
+{
+public:
+    BitWriter(uint8_t* dst, const size_t& capacity)
+        : m_begin(dst), m_dst(dst), m_end(dst + capacity), m_acc(0), m_bits(0), m_overflow(false)
+    {
+    }
+
+    void put(const uint32_t& code, const uint32_t& length)
+    {
+        m_acc |= static_cast<uint64_t>(code) << m_bits;
+        m_bits += length;
+        if(m_bits >= 32)
+        {
+            if(m_end - m_dst < 4)
+            {
+                m_overflow = true;
+                m_dst = m_begin;
+            }
+            write_u32(m_dst, static_cast<uint32_t>(m_acc));
+            m_dst += 4;
+            m_acc >>= 32;
+            m_bits -= 32;
+        }
+    }
+
+    // Returns number of written bytes, zero on overflow
+    size_t finish()
+    {
+        while(m_bits > 0 && m_dst < m_end)
+        {
+            *m_dst++ = static_cast<uint8_t>(m_acc);
+            m_acc >>= 8;
+            m_bits = m_bits > 8 ? m_bits - 8 : 0;
+        }
+        return m_overflow || m_bits > 0 ? 0 : static_cast<size_t>(m_dst - m_begin);
+    }
+
+private:
+    uint8_t* m_begin;
+    uint8_t* m_dst;
+    uint8_t* m_end;
+    uint64_t m_acc;
+    uint32_t m_bits;
+    bool m_overflow;
+};
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t* src, const size_t& size)
+        : m_src(src), m_end(src + size), m_acc(0), m_bits(0), m_padding(0)
+    {
+    }
+
+    // Guarantees at least 32 buffered bits, the longest code of a two byte sample
+    void refill()
+    {
+        if(m_bits >= 32)
+        {
+            return;
+        }
+
+        if(m_end - m_src >= 8)
+        {
+            uint64_t value = 0;
+            std::memcpy(&value, m_src, sizeof(value));
+            m_acc |= value << m_bits;
+            m_src += (63 - m_bits) >> 3;
+            m_bits |= 56;
+        }
+        else
+        {
+            while(m_bits < 56)
+            {
+                uint64_t value = 0;
+                if(m_src < m_end)
+                {
+                    value = *m_src++;
+                }
+                else
+                {
+                    m_padding += 8;
+                }
+                m_acc |= value << m_bits;
+                m_bits += 8;
+            }
+        }
+    }
+
+    uint64_t peek() const
+    {
+        return m_acc;
+    }
+
+    void consume(const uint32_t& length)
+    {
+        m_acc >>= length;
+        m_bits -= length;
+    }
+
+    // False if more bits were consumed than available
+    bool valid() const
+    {
+        return m_bits >= m_padding;
+    }
+
+private:
+    const uint8_t* m_src;
+    const uint8_t* m_end;
+    uint64_t m_acc;
+    uint32_t m_bits;
+    uint32_t m_padding;
+};
+
+uint8_t zigzag(const uint8_t& residual)
+{
+    return static_cast<uint8_t>((residual << 1) ^ (static_cast<int8_t>(residual) >> 7));
+}
+
+uint8_t unzigzag(const uint8_t& code)
+{
+    return static_cast<uint8_t>((code >> 1) ^ (0 - (code & 1)));
+}
+
+uint8_t median(const uint8_t& a, const uint8_t& b, const uint8_t& c)
+{
+    const int32_t lo = std::min(a, b);
+    const int32_t hi = std::max(a, b);
+    const int32_t gradient = static_cast<int32_t>(a) + b - c;
+    return static_cast<uint8_t>(std::max(lo, std::min(hi, gradient)));
+}
+
+uint16_t zigzag(const uint16_t& residual)
+{
+    return static_cast<uint16_t>((residual << 1) ^ (static_cast<int16_t>(residual) >> 15));
+}
+
+uint16_t unzigzag(const uint16_t& code)
+{
+    return static_cast<uint16_t>((code >> 1) ^ (0 - (code & 1)));
+}
+
+uint16_t median(const uint16_t& a, const uint16_t& b, const uint16_t& c)
+{
+    const int32_t lo = std::min(a, b);
+    const int32_t hi = std::max(a, b);
+    const int32_t gradient = static_cast<int32_t>(a) + b - c;
+    return static_cast<uint16_t>(std::max(lo, std::min(hi, gradient)));
+}
+
+// Two byte little endian sample 'index' of a row, without the 'shift' low bits
+uint16_t load_sample(const uint8_t* row, const uint32_t& index, const uint32_t& shift)
+{
+    return static_cast<uint16_t>((row[index * 2] | (row[index * 2 + 1] << 8)) >> shift);
+}
+
+void store_sample(uint8_t* row, const uint32_t& index, const uint16_t& value, const uint32_t& shift)
+{
+    const uint32_t sample = static_cast<uint32_t>(value) << shift;
+    row[index * 2] = static_cast<uint8_t>(sample);
+    row[index * 2 + 1] = static_cast<uint8_t>(sample >> 8);
+}
+
+__m128i zigzag16(const __m128i& residual)
+{
+    const __m128i sign = _mm_cmpgt_epi8(_mm_setzero_si128(), residual);
+    return _mm_xor_si128(_mm_add_epi8(residual, residual), sign);
+}
+
+__m128i unzigzag16(const __m128i& code)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i sign = _mm_cmpeq_epi8(_mm_and_si128(code, one), one);
+    return _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(code, 1), _mm_set1_epi8(0x7F)), sign);
+}
+
+__m128i zigzag8(const __m128i& residual)
+{
+    return _mm_xor_si128(_mm_add_epi16(residual, residual), _mm_srai_epi16(residual, 15));
+}
+
+__m128i unzigzag8(const __m128i& code)
+{
+    const __m128i sign = _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(code, _mm_set1_epi16(1)));
+    return _mm_xor_si128(_mm_srli_epi16(code, 1), sign);
+}
+
+__m128i select(const __m128i& mask, const __m128i& set, const __m128i& clear)
+{
+    return _mm_or_si128(_mm_and_si128(mask, set), _mm_andnot_si128(mask, clear));
+}
+
+// Median reconstruction of 'STEP' interleaved channels from 'x' on, returns where it stopped.
+// Every sample depends on the one to its left, so lanes 0..STEP-1 carry the last pixel along
+// the row while the neighbours above and the residuals of a block are shifted through. The
+// gradient a + b - c is clamped with saturating steps, one of b - c and c - b is zero.
+template<uint32_t STEP>
+uint32_t reconstruct_median(uint8_t* cur, const uint8_t* prev, const uint32_t& width, uint32_t x, const uint8_t* residual)
+{
+    const uint32_t block = 16 / STEP * STEP;
+
+    uint32_t last = 0;
+    std::memcpy(&last, cur + x - STEP, STEP);
+    __m128i left = _mm_cvtsi32_si128(static_cast<int>(last));
+
+    for(; x + 16 <= width; x += block)
+    {
+        __m128i above = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x));
+        const __m128i corner = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x - STEP));
+        __m128i up = _mm_subs_epu8(above, corner);
+        __m128i down = _mm_subs_epu8(corner, above);
+        __m128i difference = unzigzag16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(residual + x)));
+        __m128i out = _mm_setzero_si128();
+
+        for(uint32_t i = 0; i < block; i += STEP)
+        {
+            const __m128i lo = _mm_min_epu8(left, above);
+            const __m128i hi = _mm_max_epu8(left, above);
+            const __m128i gradient = _mm_subs_epu8(_mm_adds_epu8(left, up), down);
+            left = _mm_add_epi8(_mm_max_epu8(lo, _mm_min_epu8(hi, gradient)), difference);
+
+            out = _mm_or_si128(_mm_srli_si128(out, STEP), _mm_slli_si128(left, 16 - STEP));
+            above = _mm_srli_si128(above, STEP);
+            up = _mm_srli_si128(up, STEP);
+            down = _mm_srli_si128(down, STEP);
+            difference = _mm_srli_si128(difference, STEP);
+        }
+
+        // Bytes past the block are written again by the next one or the scalar loop
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cur + x), _mm_srli_si128(out, 16 - block));
+    }
+
+    return x;
+}
+
+// Writes zigzag coded prediction residuals of one row. 'prev' is null for the
+// first row of a slice, then only the left neighbour is available.
+void predict_row(
+    const uint8_t* cur,
+    const uint8_t* prev,
+    const uint32_t& width,
+    const uint32_t& step,
+    const Predictor& predictor,
+    uint8_t* residual)
+{
+    const uint32_t head = std::min(step, width);
+    uint32_t x = 0;
+
+    for(; x < head; x++)
+    {
+        residual[x] = zigzag(static_cast<uint8_t>(cur[x] - (prev ? prev[x] : 0)));
+    }
+
+    if(prev == nullptr || predictor == Predictor::LEFT)
+    {
+        for(; x + 16 <= width; x += 16)
+        {
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x));
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x - step));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(residual + x), zigzag16(_mm_sub_epi8(c, a)));
+        }
+        for(; x < width; x++)
+        {
+            residual[x] = zigzag(static_cast<uint8_t>(cur[x] - cur[x - step]));
+        }
+    }
+    else
+    {
+        const __m128i zero = _mm_setzero_si128();
+        for(; x + 16 <= width; x += 16)
+        {
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x));
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x - step));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x));
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x - step));
+            const __m128i lo = _mm_min_epu8(a, b);
+            const __m128i hi = _mm_max_epu8(a, b);
+
+            // Gradient a + b - c needs 16 bit precision
+            const __m128i gradient_lo = _mm_sub_epi16(
+                _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+                _mm_unpacklo_epi8(d, zero));
+            const __m128i gradient_hi = _mm_sub_epi16(
+                _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+                _mm_unpackhi_epi8(d, zero));
+            const __m128i gradient = _mm_packus_epi16(gradient_lo, gradient_hi);
+
+            const __m128i prediction = _mm_max_epu8(lo, _mm_min_epu8(hi, gradient));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(residual + x), zigzag16(_mm_sub_epi8(c, prediction)));
+        }
+        for(; x < width; x++)
+        {
+            residual[x] = zigzag(static_cast<uint8_t>(cur[x] - median(cur[x - step], prev[x], prev[x - step])));
+        }
+    }
+}
+
+// Inverse of predict_row, 'residual' holds zigzag codes
+void reconstruct_row(
+    uint8_t* cur,
+    const uint8_t* prev,
+    const uint32_t& width,
+    const uint32_t& step,
+    const Predictor& predictor,
+    const uint8_t* residual)
+{
+    const uint32_t head = std::min(step, width);
+    uint32_t x = 0;
+
+    for(; x < head; x++)
+    {
+        cur[x] = static_cast<uint8_t>(unzigzag(residual[x]) + (prev ? prev[x] : 0));
+    }
+
+    if(prev == nullptr || predictor == Predictor::LEFT)
+    {
+        if(step == 1 && x < width)
+        {
+            // Prefix sum over 16 residuals at a time
+            __m128i carry = _mm_set1_epi8(static_cast<char>(cur[x - 1]));
+            for(; x + 16 <= width; x += 16)
+            {
+                __m128i sum = unzigzag16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(residual + x)));
+                sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 1));
+                sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 2));
+                sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+                sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+                sum = _mm_add_epi8(sum, carry);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(cur + x), sum);
+                carry = _mm_set1_epi8(static_cast<char>(cur[x + 15]));
+            }
+        }
+        for(; x < width; x++)
+        {
+            cur[x] = static_cast<uint8_t>(unzigzag(residual[x]) + cur[x - step]);
+        }
+    }
+    else
+    {
+        // Whole blocks, the scalar loop finishes the row
+        switch(x == step ? step : 0)
+        {
+        case 1:
+            x = reconstruct_median<1>(cur, prev, width, x, residual);
+            break;
+        case 2:
+            x = reconstruct_median<2>(cur, prev, width, x, residual);
+            break;
+        case 3:
+            x = reconstruct_median<3>(cur, prev, width, x, residual);
+            break;
+        case 4:
+            x = reconstruct_median<4>(cur, prev, width, x, residual);
+            break;
+        default:
+            break;
+        }
+        for(; x < width; x++)
+        {
+            cur[x] = static_cast<uint8_t>(unzigzag(residual[x]) + median(cur[x - step], prev[x], prev[x - step]));
+        }
+    }
+}
+
+// predict_row for two byte samples, 'width' and 'step' count samples. Samples lose the
+// 'shift' low bits, which are zero throughout the slice, P010 and Y210 leave six.
+void predict_row_wide(
+    const uint8_t* cur,
+    const uint8_t* prev,
+    const uint32_t& width,
+    const uint32_t& step,
+    const uint32_t& shift,
+    const Predictor& predictor,
+    uint16_t* residual)
+{
+    const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+    const uint32_t head = std::min(step, width);
+    uint32_t x = 0;
+
+    for(; x < head; x++)
+    {
+        residual[x] = zigzag(static_cast<uint16_t>(load_sample(cur, x, shift) - (prev ? load_sample(prev, x, shift) : 0)));
+    }
+
+    if(prev == nullptr || predictor == Predictor::LEFT)
+    {
+        for(; x + 8 <= width; x += 8)
+        {
+            const __m128i c = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x * 2)), count);
+            const __m128i a = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + (x - step) * 2)), count);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(residual + x), zigzag8(_mm_sub_epi16(c, a)));
+        }
+        for(; x < width; x++)
+        {
+            residual[x] = zigzag(static_cast<uint16_t>(load_sample(cur, x, shift) - load_sample(cur, x - step, shift)));
+        }
+    }
+    else
+    {
+        // SSE2 compares signed words only, the bias keeps the unsigned order
+        const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+        for(; x + 8 <= width; x += 8)
+        {
+            const __m128i c = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x * 2)), count);
+            const __m128i a = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + (x - step) * 2)), count);
+            const __m128i b = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x * 2)), count);
+            const __m128i d = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + (x - step) * 2)), count);
+            const __m128i lo = _mm_min_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+            const __m128i hi = _mm_max_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+            const __m128i corner = _mm_xor_si128(d, bias);
+
+            // The corner at or above both neighbours predicts the smaller one, at or below both
+            // the larger one, in between the gradient a + b - c lies between them as well
+            const __m128i gradient = _mm_xor_si128(_mm_sub_epi16(_mm_add_epi16(a, b), d), bias);
+            __m128i prediction = select(_mm_cmpgt_epi16(corner, lo), gradient, hi);
+            prediction = _mm_xor_si128(select(_mm_cmpgt_epi16(hi, corner), prediction, lo), bias);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(residual + x), zigzag8(_mm_sub_epi16(c, prediction)));
+        }
+        for(; x < width; x++)
+        {
+            const uint16_t prediction = median(load_sample(cur, x - step, shift), load_sample(prev, x, shift), load_sample(prev, x - step, shift));
+            residual[x] = zigzag(static_cast<uint16_t>(load_sample(cur, x, shift) - prediction));
+        }
+    }
+}
+
+// reconstruct_median for two byte samples, eight to a block
+template<uint32_t STEP>
+uint32_t reconstruct_median_wide(uint8_t* cur, const uint8_t* prev, const uint32_t& width, uint32_t x, const uint32_t& shift, const uint16_t* residual)
+{
+    const uint32_t block = 8 / STEP * STEP;
+    const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    uint32_t last = 0;
+    for(uint32_t i = 0; i < STEP; i++)
+    {
+        last |= static_cast<uint32_t>(load_sample(cur, x - STEP + i, shift)) << (16 * i);
+    }
+    __m128i left = _mm_cvtsi32_si128(static_cast<int>(last));
+
+    for(; x + 8 <= width; x += block)
+    {
+        __m128i above = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x * 2)), count);
+        __m128i corner = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + (x - STEP) * 2)), count);
+        __m128i difference = unzigzag8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(residual + x)));
+        __m128i out = _mm_setzero_si128();
+
+        for(uint32_t i = 0; i < block; i += STEP)
+        {
+            const __m128i lo = _mm_min_epi16(_mm_xor_si128(left, bias), _mm_xor_si128(above, bias));
+            const __m128i hi = _mm_max_epi16(_mm_xor_si128(left, bias), _mm_xor_si128(above, bias));
+            const __m128i biased_corner = _mm_xor_si128(corner, bias);
+            const __m128i gradient = _mm_xor_si128(_mm_sub_epi16(_mm_add_epi16(left, above), corner), bias);
+            __m128i prediction = select(_mm_cmpgt_epi16(biased_corner, lo), gradient, hi);
+            prediction = _mm_xor_si128(select(_mm_cmpgt_epi16(hi, biased_corner), prediction, lo), bias);
+            left = _mm_add_epi16(prediction, difference);
+
+            out = _mm_or_si128(_mm_srli_si128(out, STEP * 2), _mm_slli_si128(left, 16 - STEP * 2));
+            above = _mm_srli_si128(above, STEP * 2);
+            corner = _mm_srli_si128(corner, STEP * 2);
+            difference = _mm_srli_si128(difference, STEP * 2);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cur + x * 2), _mm_sll_epi16(_mm_srli_si128(out, 16 - block * 2), count));
+    }
+
+    return x;
+}
+
+// Inverse of predict_row_wide
+void reconstruct_row_wide(
+    uint8_t* cur,
+    const uint8_t* prev,
+    const uint32_t& width,
+    const uint32_t& step,
+    const uint32_t& shift,
+    const Predictor& predictor,
+    const uint16_t* residual)
+{
+    const uint32_t head = std::min(step, width);
+    uint32_t x = 0;
+
+    for(; x < head; x++)
+    {
+        store_sample(cur, x, static_cast<uint16_t>(unzigzag(residual[x]) + (prev ? load_sample(prev, x, shift) : 0)), shift);
+    }
+
+    if(prev == nullptr || predictor == Predictor::LEFT)
+    {
+        if(step == 1 && x < width)
+        {
+            // Prefix sum over 8 residuals at a time, the carry is the last sample broadcast
+            const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+            __m128i carry = _mm_set1_epi16(static_cast<short>(load_sample(cur, x - 1, shift)));
+            for(; x + 8 <= width; x += 8)
+            {
+                __m128i sum = unzigzag8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(residual + x)));
+                sum = _mm_add_epi16(sum, _mm_slli_si128(sum, 2));
+                sum = _mm_add_epi16(sum, _mm_slli_si128(sum, 4));
+                sum = _mm_add_epi16(sum, _mm_slli_si128(sum, 8));
+                sum = _mm_add_epi16(sum, carry);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(cur + x * 2), _mm_sll_epi16(sum, count));
+                carry = _mm_shuffle_epi32(_mm_shufflehi_epi16(sum, 0xFF), 0xFF);
+            }
+        }
+        for(; x < width; x++)
+        {
+            store_sample(cur, x, static_cast<uint16_t>(unzigzag(residual[x]) + load_sample(cur, x - step, shift)), shift);
+        }
+    }
+    else
+    {
+        switch(x == step ? step : 0)
+        {
+        case 1:
+            x = reconstruct_median_wide<1>(cur, prev, width, x, shift, residual);
+            break;
+        case 2:
+            x = reconstruct_median_wide<2>(cur, prev, width, x, shift, residual);
+            break;
+        default:
+            break;
+        }
+        for(; x < width; x++)
+        {
+            const uint16_t prediction = median(load_sample(cur, x - step, shift), load_sample(prev, x, shift), load_sample(prev, x - step, shift));
+            store_sample(cur, x, static_cast<uint16_t>(unzigzag(residual[x]) + prediction), shift);
+        }
+    }
+}
+
+// Number of low bits which are zero in every sample of the rows
+uint32_t common_shift(const uint8_t* frame, const FrameLayout::Plane& plane, const uint32_t& first_row, const uint32_t& rows)
+{
+    __m128i bits = _mm_setzero_si128();
+    uint32_t tail = 0;
+    for(uint32_t row = 0; row < rows; row++)
+    {
+        const uint8_t* cur = frame + plane.offset + static_cast<size_t>(first_row + row) * plane.stride;
+        uint32_t x = 0;
+        for(; x + 16 <= plane.width; x += 16)
+        {
+            bits = _mm_or_si128(bits, _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x)));
+        }
+        for(; x < plane.width; x += 2)
+        {
+            tail |= load_sample(cur, x / 2, 0);
+        }
+    }
+
+    bits = _mm_or_si128(bits, _mm_shuffle_epi32(bits, 0x4E));
+    bits = _mm_or_si128(bits, _mm_shuffle_epi32(bits, 0xB1));
+    bits = _mm_or_si128(bits, _mm_srli_epi32(bits, 16));
+    tail |= static_cast<uint32_t>(_mm_cvtsi128_si32(bits)) & 0xFFFF;
+
+    return tail != 0 ? count_trailing_zeros(tail) : 0;
+}
+
+uint32_t block_sum(const uint8_t* codes, const uint32_t& count)
+{
+    uint32_t sum = 0;
+    uint32_t i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        const __m128i sad = _mm_sad_epu8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)),
+            _mm_setzero_si128());
+        sum += static_cast<uint32_t>(_mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4));
+    }
+    for(; i < count; i++)
+    {
+        sum += codes[i];
+    }
+    return sum;
+}
+
+uint32_t block_sum(const uint16_t* codes, const uint32_t& count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sums = zero;
+    uint32_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i));
+        sums = _mm_add_epi32(sums, _mm_add_epi32(_mm_unpacklo_epi16(value, zero), _mm_unpackhi_epi16(value, zero)));
+    }
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, 0x4E));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, 0xB1));
+
+    uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(sums));
+    for(; i < count; i++)
+    {
+        sum += codes[i];
+    }
+    return sum;
+}
+
+// Codes of one byte take k up to 7 and escape with the full byte, codes of two bytes take
+// k up to 14 and escape with both bytes
+template<typename T>
+void encode_block(BitWriter& writer, const T* codes, const uint32_t& count)
+{
+    const uint32_t zero_block = sizeof(T) == 1 ? ZERO_BLOCK : ZERO_BLOCK_WIDE;
+    const uint32_t sum = block_sum(codes, count);
+
+    if(sum == 0)
+    {
+        writer.put(zero_block, 4);
+        return;
+    }
+
+    // Smallest k for which count * 2^k covers two thirds of the block magnitude, close to the
+    // best k for the geometric distribution of residuals
+    uint32_t k = 0;
+    while(k + 1 < zero_block && (count << k) * 3 < sum * 2)
+    {
+        k++;
+    }
+    writer.put(k, 4);
+
+    const uint32_t mask = (1u << k) - 1;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t value = codes[i];
+        const uint32_t quotient = value >> k;
+        if(quotient < ESCAPE)
+        {
+            writer.put(((1u << quotient) - 1) | ((value & mask) << (quotient + 1)), quotient + 1 + k);
+        }
+        else
+        {
+            writer.put(((1u << ESCAPE) - 1) | (value << ESCAPE), ESCAPE + sizeof(T) * 8);
+        }
+    }
+}
+
+template<typename T>
+void decode_block(BitReader& reader, T* codes, const uint32_t& count)
+{
+    const uint32_t zero_block = sizeof(T) == 1 ? ZERO_BLOCK : ZERO_BLOCK_WIDE;
+
+    reader.refill();
+    const uint32_t k = static_cast<uint32_t>(reader.peek() & 0xF);
+    reader.consume(4);
+
+    if(k >= zero_block)
+    {
+        std::fill(codes, codes + count, static_cast<T>(0));
+        return;
+    }
+
+    const uint64_t mask = (1u << k) - 1;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        reader.refill();
+        const uint64_t bits = reader.peek();
+
+        // The stop bit caps the count at an escape, a run of ones in corrupt input included
+        const uint32_t quotient = count_trailing_zeros(~bits | (uint64_t(1) << ESCAPE));
+        if(quotient < ESCAPE)
+        {
+            codes[i] = static_cast<T>((quotient << k) | ((bits >> (quotient + 1)) & mask));
+            reader.consume(quotient + 1 + k);
+        }
+        else
+        {
+            codes[i] = static_cast<T>(bits >> ESCAPE);
+            reader.consume(ESCAPE + sizeof(T) * 8);
+        }
+    }
+}
+
+// A slice is stored as its rows when coding does not make it smaller
+size_t slice_bound(const FrameLayout::Plane& plane, const uint32_t& rows)
+{
+    return static_cast<size_t>(plane.width) * rows;
+}
+
+}
+
+LosslessCodec::LosslessCodec(const Predictor& predictor, const uint32_t& threads)
+    : m_predictor(predictor)
+    , m_pool(std::make_unique<WorkerPool>(threads))
+{
+}
+
+LosslessCodec::~LosslessCodec()
+{
+}
+
+uint32_t LosslessCodec::slice_rows(const uint32_t& height) const
+{
+    // Several slices per worker keep the threads balanced
+    const uint32_t slices = m_pool->size() * 4;
+    return std::max(MIN_SLICE_ROWS, (height + slices - 1) / slices);
+}
+
+void LosslessCodec::build_slices(const FrameLayout& layout, const uint32_t& rows)
+{
+    size_t count = 0;
+    for(uint32_t p = 0; p < layout.plane_count(); p++)
+    {
+        const FrameLayout::Plane& plane = layout.plane(p);
+        for(uint32_t row = 0; row < plane.height; row += rows)
+        {
+            if(m_slices.size() <= count)
+            {
+                m_slices.emplace_back();
+            }
+
+            Slice& slice = m_slices[count++];
+            slice.plane = p;
+            slice.first_row = row;
+            slice.rows = std::min(rows, plane.height - row);
+            slice.capacity = slice_bound(plane, slice.rows);
+            slice.encoded_size = 0;
+        }
+    }
+    m_slices.resize(count);
+}
+
+size_t LosslessCodec::bound(const uint32_t& width, const uint32_t& height, const Encoding& encoding) const
+{
+    FrameLayout layout;
+    if(!layout.init(width, height, encoding))
+    {
+        return 0;
+    }
+
+    const uint32_t rows = slice_rows(height);
+    size_t size = HEADER_SIZE;
+    for(uint32_t p = 0; p < layout.plane_count(); p++)
+    {
+        const FrameLayout::Plane& plane = layout.plane(p);
+        for(uint32_t row = 0; row < plane.height; row += rows)
+        {
+            size += sizeof(uint32_t) + slice_bound(plane, std::min(rows, plane.height - row));
+        }
+    }
+    return size;
+}
+
+size_t LosslessCodec::encode(
+    const void* frame,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    void* dst,
+    const size_t& dst_size)
+{
+    FrameLayout layout;
+    if(frame == nullptr || dst == nullptr || !layout.init(width, height, encoding))
+    {
+        return 0;
+    }
+
+    const uint32_t rows = slice_rows(height);
+    build_slices(layout, rows);
+
+    const uint8_t* pixels = static_cast<const uint8_t*>(frame);
+    const bool wide = FrameLayout::is_wide(encoding);
+    m_pool->run(static_cast<uint32_t>(m_slices.size()), [&](uint32_t index)
+    {
+        encode_slice(layout, wide, pixels, m_slices[index]);
+    });
+
+    const size_t table_size = m_slices.size() * sizeof(uint32_t);
+    size_t total = HEADER_SIZE + table_size;
+    for(const Slice& slice : m_slices)
+    {
+        total += slice.encoded_size;
+    }
+
+    if(total > dst_size)
+    {
+        return 0;
+    }
+
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    write_u32(out, MAGIC);
+    out[4] = VERSION;
+    out[5] = static_cast<uint8_t>(encoding);
+    out[6] = static_cast<uint8_t>(m_predictor);
+    out[7] = 0;
+    write_u32(out + 8, width);
+    write_u32(out + 12, height);
+    write_u32(out + 16, rows);
+    write_u32(out + 20, static_cast<uint32_t>(m_slices.size()));
+    out += HEADER_SIZE;
+
+    for(const Slice& slice : m_slices)
+    {
+        write_u32(out, static_cast<uint32_t>(slice.encoded_size));
+        out += sizeof(uint32_t);
+    }
+
+    for(const Slice& slice : m_slices)
+    {
+        std::memcpy(out, slice.encoded.data(), slice.encoded_size);
+        out += slice.encoded_size;
+    }
+
+    return total;
+}
+
+bool LosslessCodec::info(
+    const void* src,
+    const size_t& src_size,
+    uint32_t& width,
+    uint32_t& height,
+    Encoding& encoding) const
+{
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    if(in == nullptr || src_size < HEADER_SIZE || read_u32(in) != MAGIC || in[4] != VERSION)
+    {
+        return false;
+    }
+
+    width = read_u32(in + 8);
+    height = read_u32(in + 12);
+    encoding = static_cast<Encoding>(in[5]);
+
+    return true;
+}
+
+bool LosslessCodec::decode(const void* src, const size_t& src_size, void* dst, const size_t& dst_size)
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    Encoding encoding = Encoding::UNKNOWN;
+    FrameLayout layout;
+    if(dst == nullptr
+       || !info(src, src_size, width, height, encoding)
+       || !layout.init(width, height, encoding)
+       || layout.size() > dst_size)
+    {
+        return false;
+    }
+
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    const Predictor predictor = static_cast<Predictor>(in[6]);
+    const uint32_t rows = read_u32(in + 16);
+    const uint32_t count = read_u32(in + 20);
+    if(rows == 0 || predictor > Predictor::MEDIAN)
+    {
+        return false;
+    }
+
+    build_slices(layout, rows);
+    if(m_slices.size() != count || src_size - HEADER_SIZE < count * sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    // Resolve payload offsets
+    std::vector<size_t> offsets(count);
+    size_t offset = HEADER_SIZE + count * sizeof(uint32_t);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        offsets[i] = offset;
+        m_slices[i].encoded_size = read_u32(in + HEADER_SIZE + i * sizeof(uint32_t));
+        offset += m_slices[i].encoded_size;
+    }
+
+    if(offset > src_size)
+    {
+        return false;
+    }
+
+    uint8_t* pixels = static_cast<uint8_t*>(dst);
+    const bool wide = FrameLayout::is_wide(encoding);
+    std::atomic<bool> failed(false);
+    m_pool->run(count, [&](uint32_t index)
+    {
+        Slice& slice = m_slices[index];
+        if(!decode_slice(layout, wide, predictor, in + offsets[index], slice.encoded_size, pixels, slice))
+        {
+            failed = true;
+        }
+    });
+
+    return !failed;
+}
+
+void LosslessCodec::encode_slice(const FrameLayout& layout, const bool& wide, const uint8_t* frame, Slice& slice)
+{
+    const FrameLayout::Plane& plane = layout.plane(slice.plane);
+
+    // The writer flushes four bytes at a time, also into slices smaller than that
+    slice.encoded.resize(std::max<size_t>(slice.capacity, sizeof(uint64_t)));
+
+    BitWriter writer(slice.encoded.data(), slice.encoded.size());
+    const uint8_t* prev = nullptr;
+
+    if(wide)
+    {
+        const uint32_t shift = common_shift(frame, plane, slice.first_row, slice.rows);
+        const uint32_t width = plane.width / 2;
+        slice.wide_residual.resize(width);
+        writer.put(shift, 4);
+
+        for(uint32_t row = 0; row < slice.rows; row++)
+        {
+            const uint8_t* cur = frame + plane.offset + static_cast<size_t>(slice.first_row + row) * plane.stride;
+            predict_row_wide(cur, prev, width, plane.step / 2, shift, m_predictor, slice.wide_residual.data());
+
+            for(uint32_t x = 0; x < width; x += BLOCK_SIZE)
+            {
+                encode_block(writer, slice.wide_residual.data() + x, std::min(BLOCK_SIZE, width - x));
+            }
+
+            prev = cur;
+        }
+    }
+    else
+    {
+        slice.residual.resize(plane.width);
+
+        for(uint32_t row = 0; row < slice.rows; row++)
+        {
+            const uint8_t* cur = frame + plane.offset + static_cast<size_t>(slice.first_row + row) * plane.stride;
+            predict_row(cur, prev, plane.width, plane.step, m_predictor, slice.residual.data());
+
+            for(uint32_t x = 0; x < plane.width; x += BLOCK_SIZE)
+            {
+                encode_block(writer, slice.residual.data() + x, std::min(BLOCK_SIZE, plane.width - x));
+            }
+
+            prev = cur;
+        }
+    }
+
+    slice.encoded_size = writer.finish();
+
+    // Noise does not compress, its rows are stored as they are. A slice is coded only when it
+    // is smaller than that, so the size tells the two apart.
+    if(slice.encoded_size == 0 || slice.encoded_size >= slice.capacity)
+    {
+        for(uint32_t row = 0; row < slice.rows; row++)
+        {
+            const uint8_t* cur = frame + plane.offset + static_cast<size_t>(slice.first_row + row) * plane.stride;
+            std::memcpy(slice.encoded.data() + static_cast<size_t>(row) * plane.width, cur, plane.width);
+        }
+        slice.encoded_size = slice.capacity;
+    }
+}
+
+bool LosslessCodec::decode_slice(
+    const FrameLayout& layout,
+    const bool& wide,
+    const Predictor& predictor,
+    const uint8_t* src,
+    const size_t& src_size,
+    uint8_t* frame,
+    Slice& slice)
+{
+    const FrameLayout::Plane& plane = layout.plane(slice.plane);
+
+    if(src_size >= slice.capacity)
+    {
+        if(src_size > slice.capacity)
+        {
+            return false;
+        }
+
+        for(uint32_t row = 0; row < slice.rows; row++)
+        {
+            uint8_t* cur = frame + plane.offset + static_cast<size_t>(slice.first_row + row) * plane.stride;
+            std::memcpy(cur, src + static_cast<size_t>(row) * plane.width, plane.width);
+        }
+        return true;
+    }
+
+    BitReader reader(src, src_size);
+    const uint8_t* prev = nullptr;
+
+    if(wide)
+    {
+        reader.refill();
+        const uint32_t shift = static_cast<uint32_t>(reader.peek() & 0xF);
+        reader.consume(4);
+
+        const uint32_t width = plane.width / 2;
+        slice.wide_residual.resize(width);
+
+        for(uint32_t row = 0; row < slice.rows; row++)
+        {
+            uint8_t* cur = frame + plane.offset + static_cast<size_t>(slice.first_row + row) * plane.stride;
+
+            for(uint32_t x = 0; x < width; x += BLOCK_SIZE)
+            {
+                decode_block(reader, slice.wide_residual.data() + x, std::min(BLOCK_SIZE, width - x));
+            }
+
+            if(!reader.valid())
+            {
+                return false;
+            }
+
+            reconstruct_row_wide(cur, prev, width, plane.step / 2, shift, predictor, slice.wide_residual.data());
+            prev = cur;
+        }
+    }
+    else
+    {
+        slice.residual.resize(plane.width);
+
+        for(uint32_t row = 0; row < slice.rows; row++)
+        {
+            uint8_t* cur = frame + plane.offset + static_cast<size_t>(slice.first_row + row) * plane.stride;
+
+            for(uint32_t x = 0; x < plane.width; x += BLOCK_SIZE)
+            {
+                decode_block(reader, slice.residual.data() + x, std::min(BLOCK_SIZE, plane.width - x));
+            }
+
+            if(!reader.valid())
+            {
+                return false;
+            }
+
+            reconstruct_row(cur, prev, plane.width, plane.step, predictor, slice.residual.data());
+            prev = cur;
+        }
+    }
+
+    return true;
+}
+
+}
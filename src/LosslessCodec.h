@@ -0,0 +1,103 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "FrameLayout.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace cdi {
+
+class WorkerPool;
+
+// Per-plane prediction followed by adaptive Golomb-Rice coding. Planes are cut into
+// horizontal slices which are coded independently, so encoding and decoding scale
+// with the number of worker threads. Two byte encodings are predicted a sample at a
+// time, slices which coding would not make smaller are stored as they are.
+class LosslessCodec : public ICodec
+{
+public:
+    LosslessCodec(const Predictor& predictor, const uint32_t& threads);
+    ~LosslessCodec();
+
+    size_t bound(const uint32_t& width, const uint32_t& height, const Encoding& encoding) const final;
+    size_t encode(
+        const void* frame,
+        const uint32_t& width,
+        const uint32_t& height,
+        const Encoding& encoding,
+        void* dst,
+        const size_t& dst_size) final;
+    bool info(
+        const void* src,
+        const size_t& src_size,
+        uint32_t& width,
+        uint32_t& height,
+        Encoding& encoding) const final;
+    bool decode(const void* src, const size_t& src_size, void* dst, const size_t& dst_size) final;
+
+private:
+    struct Slice
+    {
+        uint32_t plane;
+        uint32_t first_row;
+        uint32_t rows;
+        size_t capacity;
+        size_t encoded_size;
+        std::vector<uint8_t> encoded;
+        std::vector<uint8_t> residual;
+        std::vector<uint16_t> wide_residual;
+    };
+
+    uint32_t slice_rows(const uint32_t& height) const;
+    void build_slices(const FrameLayout& layout, const uint32_t& rows);
+    void encode_slice(const FrameLayout& layout, const bool& wide, const uint8_t* frame, Slice& slice);
+    bool decode_slice(
+        const FrameLayout& layout,
+        const bool& wide,
+        const Predictor& predictor,
+        const uint8_t* src,
+        const size_t& src_size,
+        uint8_t* frame,
+        Slice& slice);
+
+private:
+    Predictor m_predictor;
+    std::unique_ptr<WorkerPool> m_pool;
+    std::vector<Slice> m_slices;
+};
+
+}
@@ -0,0 +1,95 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "NumaMemory.h"
+
+#include <cstring>
+
+#include <windows.h>
+
+
+namespace cdi {
+
+NumaMemory::NumaMemory()
+    : m_data(nullptr)
+    , m_size(0)
+{
+}
+
+NumaMemory::~NumaMemory()
+{
+    free();
+}
+
+bool NumaMemory::allocate(const size_t& size, const uint32_t& node)
+{
+    if(m_data != nullptr || size == 0)
+    {
+        return false;
+    }
+
+    m_data = static_cast<uint8_t*>(VirtualAllocExNuma(
+        GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node));
+    if(m_data == nullptr)
+    {
+        return false;
+    }
+
+    m_size = size;
+    std::memset(m_data, 0, m_size);
+
+    return true;
+}
+
+void NumaMemory::free()
+{
+    if(m_data != nullptr)
+    {
+        VirtualFree(m_data, 0, MEM_RELEASE);
+        m_data = nullptr;
+    }
+
+    m_size = 0;
+}
+
+uint8_t* NumaMemory::data() const
+{
+    return m_data;
+}
+
+size_t NumaMemory::size() const
+{
+    return m_size;
+}
+
+}
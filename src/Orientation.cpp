@@ -0,0 +1,412 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Orientation.h"
+
+#include <cstring>
+#include <emmintrin.h>
+
+
+namespace cdi { namespace kernels {
+
+namespace {
+
+// Output position of source pixel (x, y), mirrored first and then rotated clockwise
+void place(
+    const OrientationOptions& orientation,
+    const int64_t& width,
+    const int64_t& height,
+    const int64_t& x,
+    const int64_t& y,
+    int64_t& out_x,
+    int64_t& out_y)
+{
+    const int64_t mx = orientation.mirror_horizontal ? width - 1 - x : x;
+    const int64_t my = orientation.mirror_vertical ? height - 1 - y : y;
+
+    switch(orientation.rotation)
+    {
+    case Rotation::CLOCKWISE_90:
+        out_x = height - 1 - my;
+        out_y = mx;
+        break;
+    case Rotation::CLOCKWISE_180:
+        out_x = width - 1 - mx;
+        out_y = height - 1 - my;
+        break;
+    case Rotation::CLOCKWISE_270:
+        out_x = my;
+        out_y = width - 1 - mx;
+        break;
+    case Rotation::NONE:
+    default:
+        out_x = mx;
+        out_y = my;
+        break;
+    }
+}
+
+template<uint32_t BPP>
+void copy_pixel(uint8_t* dst, const uint8_t* src)
+{
+    std::memcpy(dst, src, BPP);
+}
+
+// Output rows run along the source rows, possibly backwards
+template<uint32_t BPP>
+void write_rows(
+    const uint8_t* band,
+    const size_t& band_pitch,
+    const uint32_t& width,
+    const uint32_t& rows,
+    uint8_t* origin,
+    const ptrdiff_t& step_x,
+    const ptrdiff_t& step_y)
+{
+    for(uint32_t row = 0; row < rows; row++)
+    {
+        const uint8_t* in = band + band_pitch * row;
+        uint8_t* out = origin + step_y * row;
+        if(step_x > 0)
+        {
+            std::memcpy(out, in, static_cast<size_t>(width) * BPP);
+            continue;
+        }
+
+        for(uint32_t x = 0; x < width; x++)
+        {
+            copy_pixel<BPP>(out - static_cast<ptrdiff_t>(x) * BPP, in + x * BPP);
+        }
+    }
+}
+
+// Pixels [x0, x1) of rows [r0, r1) with the source columns as output rows
+template<uint32_t BPP>
+void write_columns(
+    const uint8_t* band,
+    const size_t& band_pitch,
+    const uint32_t& x0,
+    const uint32_t& x1,
+    const uint32_t& r0,
+    const uint32_t& r1,
+    uint8_t* origin,
+    const ptrdiff_t& step_x,
+    const ptrdiff_t& step_y)
+{
+    for(uint32_t x = x0; x < x1; x++)
+    {
+        const uint8_t* in = band + x * BPP;
+        uint8_t* out = origin + step_x * x;
+        for(uint32_t row = r0; row < r1; row++)
+        {
+            copy_pixel<BPP>(out + step_y * row, in + band_pitch * row);
+        }
+    }
+}
+
+// 4x4 blocks of 32 bit pixels. Rows are loaded in reverse for backward output rows, the
+// transposed block then comes out in memory order as well.
+void transpose_band_32(
+    const uint8_t* band,
+    const size_t& band_pitch,
+    const uint32_t& width,
+    const uint32_t& rows,
+    uint8_t* origin,
+    const ptrdiff_t& step_x,
+    const ptrdiff_t& step_y)
+{
+    const uint32_t block_columns = width & ~3u;
+    const uint32_t block_rows = rows & ~3u;
+    const bool backward = step_y < 0;
+
+    for(uint32_t x = 0; x < block_columns; x += 4)
+    {
+        for(uint32_t row = 0; row < block_rows; row += 4)
+        {
+            __m128i a[4];
+            for(uint32_t i = 0; i < 4; i++)
+            {
+                const uint32_t source_row = row + (backward ? 3 - i : i);
+                a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(band + band_pitch * source_row + x * 4));
+            }
+
+            const __m128i t0 = _mm_unpacklo_epi32(a[0], a[1]);
+            const __m128i t1 = _mm_unpacklo_epi32(a[2], a[3]);
+            const __m128i t2 = _mm_unpackhi_epi32(a[0], a[1]);
+            const __m128i t3 = _mm_unpackhi_epi32(a[2], a[3]);
+            const __m128i columns[4] =
+            {
+                _mm_unpacklo_epi64(t0, t1),
+                _mm_unpackhi_epi64(t0, t1),
+                _mm_unpacklo_epi64(t2, t3),
+                _mm_unpackhi_epi64(t2, t3),
+            };
+
+            const ptrdiff_t first = step_y * (backward ? row + 3 : row);
+            for(uint32_t i = 0; i < 4; i++)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(origin + step_x * (x + i) + first), columns[i]);
+            }
+        }
+    }
+
+    write_columns<4>(band, band_pitch, 0, block_columns, block_rows, rows, origin, step_x, step_y);
+    write_columns<4>(band, band_pitch, block_columns, width, 0, rows, origin, step_x, step_y);
+}
+
+// Four 24 bit pixels in the low 12 bytes, loaded and stored without touching the bytes after them
+__m128i load_24(const uint8_t* src)
+{
+    int32_t high = 0;
+    std::memcpy(&high, src + 8, 4);
+    return _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)), _mm_cvtsi32_si128(high));
+}
+
+void store_24(uint8_t* dst, const __m128i& pixels)
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), pixels);
+    const int32_t high = _mm_cvtsi128_si32(_mm_srli_si128(pixels, 8));
+    std::memcpy(dst + 8, &high, 4);
+}
+
+// Four packed 24 bit pixels to one per 32 bit lane and back
+__m128i widen_24(const __m128i& pixels)
+{
+    const __m128i lane = _mm_set_epi32(0, 0, 0, 0x00FFFFFF);
+    return _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(pixels, lane), _mm_and_si128(_mm_slli_si128(pixels, 1), _mm_slli_si128(lane, 4))),
+        _mm_or_si128(
+            _mm_and_si128(_mm_slli_si128(pixels, 2), _mm_slli_si128(lane, 8)),
+            _mm_and_si128(_mm_slli_si128(pixels, 3), _mm_slli_si128(lane, 12))));
+}
+
+__m128i narrow_24(const __m128i& lanes)
+{
+    const __m128i pixel = _mm_set_epi32(0, 0, 0, 0x00FFFFFF);
+    return _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(lanes, pixel), _mm_and_si128(_mm_srli_si128(lanes, 1), _mm_slli_si128(pixel, 3))),
+        _mm_or_si128(
+            _mm_and_si128(_mm_srli_si128(lanes, 2), _mm_slli_si128(pixel, 6)),
+            _mm_and_si128(_mm_srli_si128(lanes, 3), _mm_slli_si128(pixel, 9))));
+}
+
+// 4x4 blocks of 24 bit pixels, widened to 32 bit lanes for the transpose and packed again
+void transpose_band_24(
+    const uint8_t* band,
+    const size_t& band_pitch,
+    const uint32_t& width,
+    const uint32_t& rows,
+    uint8_t* origin,
+    const ptrdiff_t& step_x,
+    const ptrdiff_t& step_y)
+{
+    const uint32_t block_columns = width & ~3u;
+    const uint32_t block_rows = rows & ~3u;
+    const bool backward = step_y < 0;
+
+    for(uint32_t x = 0; x < block_columns; x += 4)
+    {
+        for(uint32_t row = 0; row < block_rows; row += 4)
+        {
+            __m128i a[4];
+            for(uint32_t i = 0; i < 4; i++)
+            {
+                const uint32_t source_row = row + (backward ? 3 - i : i);
+                a[i] = widen_24(load_24(band + band_pitch * source_row + x * 3));
+            }
+
+            const __m128i t0 = _mm_unpacklo_epi32(a[0], a[1]);
+            const __m128i t1 = _mm_unpacklo_epi32(a[2], a[3]);
+            const __m128i t2 = _mm_unpackhi_epi32(a[0], a[1]);
+            const __m128i t3 = _mm_unpackhi_epi32(a[2], a[3]);
+            const __m128i columns[4] =
+            {
+                _mm_unpacklo_epi64(t0, t1),
+                _mm_unpackhi_epi64(t0, t1),
+                _mm_unpacklo_epi64(t2, t3),
+                _mm_unpackhi_epi64(t2, t3),
+            };
+
+            const ptrdiff_t first = step_y * (backward ? row + 3 : row);
+            for(uint32_t i = 0; i < 4; i++)
+            {
+                store_24(origin + step_x * (x + i) + first, narrow_24(columns[i]));
+            }
+        }
+    }
+
+    write_columns<3>(band, band_pitch, 0, block_columns, block_rows, rows, origin, step_x, step_y);
+    write_columns<3>(band, band_pitch, block_columns, width, 0, rows, origin, step_x, step_y);
+}
+
+// 8x8 blocks of bytes, as above
+void transpose_band_8(
+    const uint8_t* band,
+    const size_t& band_pitch,
+    const uint32_t& width,
+    const uint32_t& rows,
+    uint8_t* origin,
+    const ptrdiff_t& step_x,
+    const ptrdiff_t& step_y)
+{
+    const uint32_t block_columns = width & ~7u;
+    const uint32_t block_rows = rows & ~7u;
+    const bool backward = step_y < 0;
+
+    for(uint32_t x = 0; x < block_columns; x += 8)
+    {
+        for(uint32_t row = 0; row < block_rows; row += 8)
+        {
+            __m128i a[8];
+            for(uint32_t i = 0; i < 8; i++)
+            {
+                const uint32_t source_row = row + (backward ? 7 - i : i);
+                a[i] = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(band + band_pitch * source_row + x));
+            }
+
+            const __m128i t0 = _mm_unpacklo_epi8(a[0], a[1]);
+            const __m128i t1 = _mm_unpacklo_epi8(a[2], a[3]);
+            const __m128i t2 = _mm_unpacklo_epi8(a[4], a[5]);
+            const __m128i t3 = _mm_unpacklo_epi8(a[6], a[7]);
+            const __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+            const __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+            const __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+            const __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+
+            // Two output rows in each register
+            const __m128i pairs[4] =
+            {
+                _mm_unpacklo_epi32(u0, u2),
+                _mm_unpackhi_epi32(u0, u2),
+                _mm_unpacklo_epi32(u1, u3),
+                _mm_unpackhi_epi32(u1, u3),
+            };
+
+            const ptrdiff_t first = step_y * (backward ? row + 7 : row);
+            for(uint32_t i = 0; i < 4; i++)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(origin + step_x * (x + 2 * i) + first), pairs[i]);
+                _mm_storel_epi64(
+                    reinterpret_cast<__m128i*>(origin + step_x * (x + 2 * i + 1) + first),
+                    _mm_srli_si128(pairs[i], 8));
+            }
+        }
+    }
+
+    write_columns<1>(band, band_pitch, 0, block_columns, block_rows, rows, origin, step_x, step_y);
+    write_columns<1>(band, band_pitch, block_columns, width, 0, rows, origin, step_x, step_y);
+}
+
+}
+
+PixelMap::PixelMap()
+    : origin(nullptr)
+    , step_x(0)
+    , step_y(0)
+{
+}
+
+bool is_identity(const OrientationOptions& orientation)
+{
+    return orientation.rotation == Rotation::NONE && !orientation.mirror_horizontal && !orientation.mirror_vertical;
+}
+
+bool swaps_axes(const OrientationOptions& orientation)
+{
+    return orientation.rotation == Rotation::CLOCKWISE_90 || orientation.rotation == Rotation::CLOCKWISE_270;
+}
+
+PixelMap map_pixels(
+    const OrientationOptions& orientation,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const uint32_t& bytes_per_pixel)
+{
+    int64_t positions[3][2] = {};
+    const int64_t source[3][2] = {{0, 0}, {1, 0}, {0, 1}};
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        place(orientation, width, height, source[i][0], source[i][1], positions[i][0], positions[i][1]);
+    }
+
+    // The map is affine, three points define it
+    ptrdiff_t offsets[3] = {};
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        offsets[i] = static_cast<ptrdiff_t>(positions[i][1] * dst_pitch + positions[i][0] * bytes_per_pixel);
+    }
+
+    PixelMap map;
+    map.origin = dst + offsets[0];
+    map.step_x = offsets[1] - offsets[0];
+    map.step_y = offsets[2] - offsets[0];
+    return map;
+}
+
+void write_band(
+    const uint8_t* band,
+    const size_t& band_pitch,
+    const uint32_t& width,
+    const uint32_t& rows,
+    const uint32_t& y0,
+    const PixelMap& map,
+    const uint32_t& bytes_per_pixel)
+{
+    uint8_t* origin = map.origin + map.step_y * y0;
+    const ptrdiff_t bpp = static_cast<ptrdiff_t>(bytes_per_pixel);
+    const bool along_rows = map.step_x == bpp || map.step_x == -bpp;
+
+    switch(bytes_per_pixel)
+    {
+    case 1:
+        along_rows
+            ? write_rows<1>(band, band_pitch, width, rows, origin, map.step_x, map.step_y)
+            : transpose_band_8(band, band_pitch, width, rows, origin, map.step_x, map.step_y);
+        break;
+    case 3:
+        along_rows
+            ? write_rows<3>(band, band_pitch, width, rows, origin, map.step_x, map.step_y)
+            : transpose_band_24(band, band_pitch, width, rows, origin, map.step_x, map.step_y);
+        break;
+    case 4:
+        along_rows
+            ? write_rows<4>(band, band_pitch, width, rows, origin, map.step_x, map.step_y)
+            : transpose_band_32(band, band_pitch, width, rows, origin, map.step_x, map.step_y);
+        break;
+    default:
+        break;
+    }
+}
+
+}}
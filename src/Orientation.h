@@ -0,0 +1,83 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include <cstddef>
+#include <cstdint>
+
+
+namespace cdi { namespace kernels {
+
+// Where a rotated or mirrored frame puts its pixels: source pixel (x, y) lands at
+// origin + x * step_x + y * step_y. One of the steps is the pixel size, the other
+// one the output pitch, both may be negative.
+struct PixelMap
+{
+    PixelMap();
+    uint8_t* origin;
+    ptrdiff_t step_x;
+    ptrdiff_t step_y;
+};
+
+// Rotation or mirroring, top_down only changes the memory order and does not count
+bool is_identity(const OrientationOptions& orientation);
+// 90 and 270 degrees
+bool swaps_axes(const OrientationOptions& orientation);
+
+// 'dst' is the top output row and 'dst_pitch' the distance to the next one, 'width' and
+// 'height' are those of the source plane
+PixelMap map_pixels(
+    const OrientationOptions& orientation,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const uint32_t& bytes_per_pixel);
+
+// Source rows are converted into bands of this many rows and written out from there,
+// a band of a full HD RGBA32 frame stays in the L2 cache
+const uint32_t BAND_ROWS = 16;
+
+// Writes 'rows' source rows starting with row 'y0', 'band_pitch' bytes apart. When the
+// source columns become output rows the band is written in tiles which are transposed
+// in registers, so both sides of a tile stay in the L1 cache.
+void write_band(
+    const uint8_t* band,
+    const size_t& band_pitch,
+    const uint32_t& width,
+    const uint32_t& rows,
+    const uint32_t& y0,
+    const PixelMap& map,
+    const uint32_t& bytes_per_pixel);
+
+}}
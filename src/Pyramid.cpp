@@ -0,0 +1,302 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Pyramid.h"
+#include "ColorKernels.h"
+
+#include <cstring>
+#include <emmintrin.h>
+
+
+namespace cdi {
+
+namespace {
+
+// Words 'n' on of the 16 word concatenation of a and b
+template<int N>
+__m128i words_from(const __m128i& a, const __m128i& b)
+{
+    return _mm_or_si128(_mm_srli_si128(a, N * 2), _mm_slli_si128(b, 16 - N * 2));
+}
+
+__m128i select(const __m128i& mask, const __m128i& set, const __m128i& clear)
+{
+    return _mm_or_si128(_mm_and_si128(mask, set), _mm_andnot_si128(mask, clear));
+}
+
+// Averages 2x2 blocks of two rows, 'step' is the number of interleaved channels
+void downsample_row(
+    const uint8_t* row0,
+    const uint8_t* row1,
+    uint8_t* dst,
+    const uint32_t& pixels,
+    const uint32_t& step)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+    uint32_t x = 0;
+
+    if(step == 1)
+    {
+        const __m128i low = _mm_set1_epi16(0x00FF);
+        for(; x + 8 <= pixels; x += 8)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 2));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 2));
+            __m128i sum = _mm_add_epi16(
+                _mm_add_epi16(_mm_and_si128(a, low), _mm_srli_epi16(a, 8)),
+                _mm_add_epi16(_mm_and_si128(b, low), _mm_srli_epi16(b, 8)));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sum, sum));
+        }
+    }
+    else if(step == 3)
+    {
+        // Eight pixels in, four out. w holds the column sums of the 24 bytes, w[i] + w[i + 3] the
+        // pixel pair sums of which every other run of three words is packed together.
+        const __m128i first3 = _mm_setr_epi16(-1, -1, -1, 0, 0, 0, 0, 0);
+        const __m128i next3 = _mm_setr_epi16(0, 0, 0, -1, -1, -1, 0, 0);
+        const __m128i first1 = _mm_setr_epi16(-1, 0, 0, 0, 0, 0, 0, 0);
+        for(; x + 4 <= pixels; x += 4)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 6));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 6));
+            const __m128i a_tail = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row0 + x * 6 + 16));
+            const __m128i b_tail = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row1 + x * 6 + 16));
+            const __m128i w0 = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            const __m128i w1 = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            const __m128i w2 = _mm_add_epi16(_mm_unpacklo_epi8(a_tail, zero), _mm_unpacklo_epi8(b_tail, zero));
+
+            const __m128i s0 = _mm_add_epi16(w0, words_from<3>(w0, w1));
+            const __m128i s1 = _mm_add_epi16(w1, words_from<3>(w1, w2));
+            const __m128i s2 = _mm_add_epi16(w2, _mm_srli_si128(w2, 6));
+
+            // Pixels 0 and 1 from s[0..2] and s[6..8], 2 and 3 from s[12..14] and s[18..20]
+            __m128i lo = select(first3, s0, select(next3, words_from<3>(s0, s1), words_from<6>(s0, s1)));
+            __m128i hi = select(first1, _mm_srli_si128(s1, 12), _mm_srli_si128(s2, 2));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 2);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 2);
+
+            const __m128i packed = _mm_packus_epi16(lo, hi);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 3), packed);
+            const uint32_t last = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(packed, 8)));
+            std::memcpy(dst + x * 3 + 8, &last, sizeof(last));
+        }
+    }
+    else if(step == 4)
+    {
+        for(; x + 2 <= pixels; x += 2)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            __m128i sum = _mm_unpacklo_epi64(lo, hi);
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(sum, sum));
+        }
+    }
+
+    for(; x < pixels; x++)
+    {
+        const uint8_t* a = row0 + x * step * 2;
+        const uint8_t* b = row1 + x * step * 2;
+        for(uint32_t c = 0; c < step; c++)
+        {
+            dst[x * step + c] = static_cast<uint8_t>((a[c] + a[c + step] + b[c] + b[c + step] + 2) >> 2);
+        }
+    }
+}
+
+void downsample(
+    const uint8_t* src,
+    const FrameLayout& src_layout,
+    uint8_t* dst,
+    const FrameLayout& dst_layout)
+{
+    for(uint32_t p = 0; p < dst_layout.plane_count(); p++)
+    {
+        const FrameLayout::Plane& in = src_layout.plane(p);
+        const FrameLayout::Plane& out = dst_layout.plane(p);
+
+        for(uint32_t row = 0; row < out.height; row++)
+        {
+            const uint8_t* row0 = src + in.offset + static_cast<size_t>(row * 2) * in.stride;
+            downsample_row(
+                row0,
+                row0 + in.stride,
+                dst + out.offset + static_cast<size_t>(row) * out.stride,
+                out.width / out.step,
+                out.step);
+        }
+    }
+}
+
+}
+
+Pyramid::Pyramid()
+    : m_width(0)
+    , m_height(0)
+    , m_encoding(Encoding::UNKNOWN)
+    , m_top_down(false)
+{
+}
+
+Pyramid::~Pyramid()
+{
+}
+
+bool Pyramid::init(
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const std::vector<PyramidLevel>& levels,
+    const ColorSpace& color,
+    const bool& top_down)
+{
+    m_steps.clear();
+    m_levels.clear();
+
+    // Averaging works on byte samples only
+    if(FrameLayout::is_wide(encoding) || !m_layout.init(width, height, encoding))
+    {
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_encoding = encoding;
+    m_color = color;
+    m_top_down = top_down;
+
+    for(const PyramidLevel& requested : levels)
+    {
+        const uint32_t scale = requested.scale;
+        if(scale < 2 || (scale & (scale - 1)) != 0)
+        {
+            return false;
+        }
+
+        uint32_t step = 0;
+        while((2u << step) < scale)
+        {
+            step++;
+        }
+
+        // Intermediate halvings are shared by all levels
+        while(m_steps.size() <= step)
+        {
+            const uint32_t shift = static_cast<uint32_t>(m_steps.size()) + 1;
+            Step halving;
+            halving.width = width >> shift;
+            halving.height = height >> shift;
+            if(halving.width == 0 || halving.height == 0 || !halving.layout.init(halving.width, halving.height, encoding))
+            {
+                return false;
+            }
+            halving.data.resize(halving.layout.size());
+            m_steps.push_back(std::move(halving));
+        }
+
+        Level level;
+        level.step = step;
+        level.encoding = requested.encoding == Encoding::UNKNOWN ? encoding : requested.encoding;
+        if(FrameLayout::is_wide(level.encoding) || !level.layout.init(m_steps[step].width, m_steps[step].height, level.encoding))
+        {
+            return false;
+        }
+        if(level.encoding != encoding)
+        {
+            level.converted.resize(level.layout.size());
+        }
+        m_levels.push_back(std::move(level));
+    }
+
+    return true;
+}
+
+void Pyramid::build(const void* frame)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(frame);
+    const FrameLayout* src_layout = &m_layout;
+
+    for(Step& step : m_steps)
+    {
+        downsample(src, *src_layout, step.data.data(), step.layout);
+        src = step.data.data();
+        src_layout = &step.layout;
+    }
+
+    for(Level& level : m_levels)
+    {
+        if(!level.converted.empty())
+        {
+            const Step& step = m_steps[level.step];
+            kernels::convert_frame(
+                step.data.data(),
+                m_encoding,
+                level.converted.data(),
+                level.encoding,
+                step.width,
+                step.height,
+                m_color,
+                m_top_down);
+        }
+    }
+}
+
+uint32_t Pyramid::level_count() const
+{
+    return static_cast<uint32_t>(m_levels.size());
+}
+
+FrameLevel Pyramid::level(const uint32_t& index) const
+{
+    FrameLevel result;
+    if(index < m_levels.size())
+    {
+        const Level& level = m_levels[index];
+        const Step& step = m_steps[level.step];
+        result.width = step.width;
+        result.height = step.height;
+        result.encoding = level.encoding;
+        result.size = level.layout.size();
+        result.data = level.converted.empty() ? step.data.data() : level.converted.data();
+        result.top_down = m_top_down && (level.encoding == Encoding::RGB24 || level.encoding == Encoding::RGBA32);
+        result.color = m_color;
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,91 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "FrameLayout.h"
+
+#include <cstdint>
+#include <vector>
+
+
+namespace cdi {
+
+// Builds power of two downscaled copies of a frame with 2x2 box filtering. Every
+// halving reads only the previous one, so the frame itself is read once.
+class Pyramid
+{
+public:
+    Pyramid();
+    ~Pyramid();
+
+    // RGB frames and levels are stored top-down with 'top_down'
+    bool init(
+        const uint32_t& width,
+        const uint32_t& height,
+        const Encoding& encoding,
+        const std::vector<PyramidLevel>& levels,
+        const ColorSpace& color,
+        const bool& top_down);
+    void build(const void* frame);
+    uint32_t level_count() const;
+    FrameLevel level(const uint32_t& index) const;
+
+private:
+    struct Step
+    {
+        FrameLayout layout;
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> data;
+    };
+
+    struct Level
+    {
+        uint32_t step;
+        Encoding encoding;
+        FrameLayout layout;
+        std::vector<uint8_t> converted;
+    };
+
+private:
+    uint32_t m_width;
+    uint32_t m_height;
+    Encoding m_encoding;
+    ColorSpace m_color;
+    bool m_top_down; // RGB frames and levels
+    FrameLayout m_layout;
+    std::vector<Step> m_steps;
+    std::vector<Level> m_levels;
+};
+
+}
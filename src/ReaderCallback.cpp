@@ -0,0 +1,126 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ReaderCallback.h"
+#include "Device.h"
+
+
+namespace cdi {
+
+ReaderCallback::ReaderCallback(Device* device)
+    : m_references(1)
+    , m_device(device)
+{
+}
+
+ReaderCallback::~ReaderCallback()
+{
+}
+
+void ReaderCallback::detach()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_device = nullptr;
+}
+
+STDMETHODIMP ReaderCallback::QueryInterface(REFIID riid, void** object)
+{
+    if(object == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    if(riid == __uuidof(IUnknown) || riid == __uuidof(IMFSourceReaderCallback))
+    {
+        *object = static_cast<IMFSourceReaderCallback*>(this);
+    }
+    else
+    {
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    AddRef();
+    return S_OK;
+}
+
+STDMETHODIMP_(ULONG) ReaderCallback::AddRef()
+{
+    return InterlockedIncrement(&m_references);
+}
+
+STDMETHODIMP_(ULONG) ReaderCallback::Release()
+{
+    const ULONG references = InterlockedDecrement(&m_references);
+    if(references == 0)
+    {
+        delete this;
+    }
+
+    return references;
+}
+
+STDMETHODIMP ReaderCallback::OnReadSample(
+    HRESULT status,
+    DWORD /*stream_index*/,
+    DWORD flags,
+    LONGLONG /*timestamp*/,
+    IMFSample* sample)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_device != nullptr)
+    {
+        m_device->on_sample(status, flags, sample);
+    }
+
+    return S_OK;
+}
+
+STDMETHODIMP ReaderCallback::OnFlush(DWORD /*stream_index*/)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_device != nullptr)
+    {
+        m_device->on_flush();
+    }
+
+    return S_OK;
+}
+
+STDMETHODIMP ReaderCallback::OnEvent(DWORD /*stream_index*/, IMFMediaEvent* /*event*/)
+{
+    return S_OK;
+}
+
+}
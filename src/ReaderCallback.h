@@ -0,0 +1,81 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <mutex>
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+
+
+namespace cdi {
+
+class Device;
+
+// Callback of an asynchronous source reader, hands every read to the device. detach()
+// waits for a callback in progress, nothing reaches the device after it returned.
+class ReaderCallback : public IMFSourceReaderCallback
+{
+    ReaderCallback(const ReaderCallback&);
+    ReaderCallback& operator=(const ReaderCallback&);
+
+public:
+    explicit ReaderCallback(Device* device);
+
+    void detach();
+
+    // IUnknown
+    STDMETHODIMP QueryInterface(REFIID riid, void** object) final;
+    STDMETHODIMP_(ULONG) AddRef() final;
+    STDMETHODIMP_(ULONG) Release() final;
+
+    // IMFSourceReaderCallback
+    STDMETHODIMP OnReadSample(
+        HRESULT status,
+        DWORD stream_index,
+        DWORD flags,
+        LONGLONG timestamp,
+        IMFSample* sample) final;
+    STDMETHODIMP OnFlush(DWORD stream_index) final;
+    STDMETHODIMP OnEvent(DWORD stream_index, IMFMediaEvent* event) final;
+
+private:
+    ~ReaderCallback();
+
+private:
+    volatile LONG m_references;
+    std::mutex m_mutex;
+    Device* m_device;
+};
+
+}
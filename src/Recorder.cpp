@@ -0,0 +1,252 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Recorder.h"
+#include "Clock.h"
+#include "FrameLayout.h"
+#include "LosslessCodec.h"
+#include "ScopeGuard.inl"
+
+#include <algorithm>
+
+
+namespace cdi {
+
+namespace {
+
+const uint8_t PADDING[recording::ALIGNMENT] = {};
+
+}
+
+Recorder::Recorder()
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_offset(0)
+    , m_width(0)
+    , m_height(0)
+    , m_encoding(Encoding::UNKNOWN)
+{
+}
+
+Recorder::~Recorder()
+{
+    close();
+}
+
+bool Recorder::init(
+    const std::wstring& path,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const std::wstring& device_name,
+    std::unique_ptr<ICodec> codec)
+{
+    cdi::util::ScopeGuard uninit_guard;
+    uninit_guard += [this]() { uninit(); };
+
+    if(m_file != INVALID_HANDLE_VALUE || encoding == Encoding::UNKNOWN)
+    {
+        return false;
+    }
+
+    // LosslessCodec is the only codec the reader knows how to decode, compressed frames are kept
+    if(codec && (dynamic_cast<LosslessCodec*>(codec.get()) == nullptr || FrameLayout::is_compressed(encoding)))
+    {
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_encoding = encoding;
+    m_codec = std::move(codec);
+
+    if(m_codec)
+    {
+        m_scratch.resize(m_codec->bound(width, height, encoding));
+    }
+
+    // Readers may map the file while it is being written
+    m_file = CreateFileW(
+        path.c_str(),
+        GENERIC_WRITE,
+        FILE_SHARE_READ,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if(m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    recording::FileHeader header = {};
+    header.magic = recording::FILE_MAGIC;
+    header.version = recording::VERSION;
+    header.header_size = sizeof(header);
+    header.encoding = static_cast<uint32_t>(encoding);
+    header.width = width;
+    header.height = height;
+    header.codec = m_codec ? recording::CODEC_LOSSLESS : recording::CODEC_RAW;
+    header.clock_origin = clock_now();
+
+    FILETIME utc = {};
+    GetSystemTimeAsFileTime(&utc);
+    header.utc_origin = static_cast<int64_t>((static_cast<uint64_t>(utc.dwHighDateTime) << 32) | utc.dwLowDateTime);
+
+    const size_t name_length = std::min(device_name.size(), static_cast<size_t>(recording::NAME_LENGTH - 1));
+    for(size_t i = 0; i < name_length; i++)
+    {
+        header.name[i] = static_cast<uint16_t>(device_name[i]);
+    }
+
+    if(!write(&header, sizeof(header)))
+    {
+        return false;
+    }
+
+    uninit_guard.cancel();
+
+    return true;
+}
+
+bool Recorder::append(const void* frame, const size_t& bytes, const int64_t& timestamp)
+{
+    return append(frame, bytes, timestamp, true);
+}
+
+bool Recorder::append(const void* frame, const size_t& bytes, const int64_t& timestamp, const bool& keyframe)
+{
+    if(m_file == INVALID_HANDLE_VALUE || frame == nullptr || bytes == 0)
+    {
+        return false;
+    }
+
+    const void* payload = frame;
+    size_t payload_size = bytes;
+    uint32_t flags = 0;
+
+    if(m_codec)
+    {
+        payload_size = m_codec->encode(frame, m_width, m_height, m_encoding, m_scratch.data(), m_scratch.size());
+        if(payload_size == 0)
+        {
+            return false;
+        }
+        payload = m_scratch.data();
+        flags |= recording::FRAME_COMPRESSED;
+    }
+
+    if(!keyframe)
+    {
+        flags |= recording::FRAME_DELTA;
+    }
+
+    recording::FrameHeader header = {};
+    header.magic = recording::FRAME_MAGIC;
+    header.flags = flags;
+    header.index = m_index.size();
+    header.size = payload_size;
+    header.timestamp = timestamp;
+
+    recording::IndexEntry entry = {};
+    entry.offset = m_offset;
+    entry.size = payload_size;
+    entry.timestamp = timestamp;
+    entry.flags = flags;
+
+    const size_t padding = static_cast<size_t>(recording::align(payload_size) - payload_size);
+    if(!write(&header, sizeof(header)) || !write(payload, payload_size) || !write(PADDING, padding))
+    {
+        return false;
+    }
+
+    m_index.push_back(entry);
+
+    return true;
+}
+
+uint64_t Recorder::frame_count() const
+{
+    return m_index.size();
+}
+
+bool Recorder::close()
+{
+    if(m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    recording::Trailer trailer = {};
+    trailer.magic = recording::INDEX_MAGIC;
+    trailer.index_offset = m_offset;
+    trailer.frame_count = m_index.size();
+    trailer.file_size = m_offset + m_index.size() * sizeof(recording::IndexEntry) + sizeof(trailer);
+
+    const bool result = write(m_index.data(), m_index.size() * sizeof(recording::IndexEntry))
+        && write(&trailer, sizeof(trailer));
+
+    uninit();
+
+    return result;
+}
+
+bool Recorder::write(const void* data, const size_t& bytes)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    size_t remaining = bytes;
+
+    while(remaining > 0)
+    {
+        const DWORD chunk = static_cast<DWORD>(std::min(remaining, static_cast<size_t>(1u << 30)));
+        DWORD written = 0;
+        if(!WriteFile(m_file, src, chunk, &written, nullptr) || written != chunk)
+        {
+            return false;
+        }
+        src += written;
+        remaining -= written;
+        m_offset += written;
+    }
+
+    return true;
+}
+
+void Recorder::uninit()
+{
+    if(m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#define NOMINMAX
+#include "cdi/cdi.h"
+#include "RecordingFormat.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <windows.h>
+
+
+namespace cdi {
+
+class Recorder : public IRecorder
+{
+public:
+    Recorder();
+    ~Recorder();
+
+    bool init(
+        const std::wstring& path,
+        const uint32_t& width,
+        const uint32_t& height,
+        const Encoding& encoding,
+        const std::wstring& device_name,
+        std::unique_ptr<ICodec> codec);
+    bool append(const void* frame, const size_t& bytes, const int64_t& timestamp) final;
+    bool append(const void* frame, const size_t& bytes, const int64_t& timestamp, const bool& keyframe) final;
+    uint64_t frame_count() const final;
+    bool close() final;
+
+private:
+    bool write(const void* data, const size_t& bytes);
+    void uninit();
+
+private:
+    HANDLE m_file;
+    uint64_t m_offset;
+    uint32_t m_width;
+    uint32_t m_height;
+    Encoding m_encoding;
+    std::unique_ptr<ICodec> m_codec;
+    std::vector<uint8_t> m_scratch;
+    std::vector<recording::IndexEntry> m_index;
+};
+
+}
@@ -0,0 +1,369 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Recording.h"
+#include "FrameLayout.h"
+#include "LosslessCodec.h"
+#include "ScopeGuard.inl"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace cdi {
+
+namespace {
+
+const uint32_t FIND_STEPS = 4;
+
+}
+
+Recording::Recording()
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+    , m_data(nullptr)
+    , m_file_size(0)
+    , m_header(nullptr)
+    , m_size(0)
+    , m_index(nullptr)
+    , m_frame_count(0)
+    , m_recovered(false)
+{
+}
+
+Recording::~Recording()
+{
+    uninit();
+}
+
+bool Recording::init(const std::wstring& path)
+{
+    cdi::util::ScopeGuard uninit_guard;
+    uninit_guard += [this]() { uninit(); };
+
+    if(m_file != INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    // Allow opening recordings which are still being written
+    m_file = CreateFileW(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+        nullptr);
+    if(m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER file_size = {};
+    if(!GetFileSizeEx(m_file, &file_size) || file_size.QuadPart < static_cast<LONGLONG>(sizeof(recording::FileHeader)))
+    {
+        return false;
+    }
+    m_file_size = static_cast<uint64_t>(file_size.QuadPart);
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(m_mapping == nullptr)
+    {
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if(m_data == nullptr)
+    {
+        return false;
+    }
+
+    m_header = reinterpret_cast<const recording::FileHeader*>(m_data);
+    if(m_header->magic != recording::FILE_MAGIC
+       || m_header->version != recording::VERSION
+       || m_header->header_size < sizeof(recording::FileHeader)
+       || m_header->header_size > m_file_size)
+    {
+        return false;
+    }
+
+    const Encoding encoding = static_cast<Encoding>(m_header->encoding);
+    FrameLayout layout;
+    if(!FrameLayout::is_compressed(encoding) && !layout.init(m_header->width, m_header->height, encoding))
+    {
+        return false;
+    }
+    m_size = layout.size();
+
+    if(!load_index())
+    {
+        recover_index();
+    }
+
+    // Compressed frames differ in size, the largest one fits all
+    if(FrameLayout::is_compressed(encoding))
+    {
+        for(uint64_t i = 0; i < m_frame_count; i++)
+        {
+            m_size = std::max(m_size, static_cast<size_t>(m_index[i].size));
+        }
+    }
+
+    uninit_guard.cancel();
+
+    return true;
+}
+
+uint32_t Recording::width() const
+{
+    return m_header->width;
+}
+
+uint32_t Recording::height() const
+{
+    return m_header->height;
+}
+
+Encoding Recording::encoding() const
+{
+    return static_cast<Encoding>(m_header->encoding);
+}
+
+size_t Recording::size() const
+{
+    return m_size;
+}
+
+std::wstring Recording::device_name() const
+{
+    std::wstring name;
+    for(uint32_t i = 0; i < recording::NAME_LENGTH && m_header->name[i] != 0; i++)
+    {
+        name.push_back(static_cast<wchar_t>(m_header->name[i]));
+    }
+    return name;
+}
+
+uint64_t Recording::frame_count() const
+{
+    return m_frame_count;
+}
+
+bool Recording::recovered() const
+{
+    return m_recovered;
+}
+
+bool Recording::frame(const uint64_t& index, RecordedFrame& frame) const
+{
+    if(index >= m_frame_count)
+    {
+        return false;
+    }
+
+    const recording::IndexEntry& entry = m_index[index];
+    if(entry.offset > m_file_size - sizeof(recording::FrameHeader)
+       || entry.size > m_file_size - sizeof(recording::FrameHeader) - entry.offset)
+    {
+        return false;
+    }
+
+    frame.data = m_data + entry.offset + sizeof(recording::FrameHeader);
+    frame.size = static_cast<size_t>(entry.size);
+    frame.timestamp = entry.timestamp;
+    frame.compressed = (entry.flags & recording::FRAME_COMPRESSED) != 0;
+    frame.keyframe = (entry.flags & recording::FRAME_DELTA) == 0;
+
+    return true;
+}
+
+uint64_t Recording::find(const int64_t& timestamp) const
+{
+    if(m_frame_count == 0 || timestamp <= m_index[0].timestamp)
+    {
+        return 0;
+    }
+
+    const uint64_t last = m_frame_count - 1;
+    if(timestamp >= m_index[last].timestamp)
+    {
+        return last;
+    }
+
+    // Interpolate the position, a constant frame rate lands on the frame directly
+    const double span = static_cast<double>(m_index[last].timestamp - m_index[0].timestamp);
+    const double position = static_cast<double>(timestamp - m_index[0].timestamp) / span;
+    uint64_t index = std::min(last, static_cast<uint64_t>(position * static_cast<double>(last)));
+
+    for(uint32_t step = 0; step < FIND_STEPS; step++)
+    {
+        if(m_index[index].timestamp > timestamp)
+        {
+            index--;
+        }
+        else if(m_index[index + 1].timestamp <= timestamp)
+        {
+            index++;
+        }
+        else
+        {
+            return index;
+        }
+    }
+
+    // Irregular timing, fall back to a binary search
+    const recording::IndexEntry* end = m_index + m_frame_count;
+    const recording::IndexEntry* next = std::upper_bound(m_index, end, timestamp,
+        [](const int64_t& value, const recording::IndexEntry& entry) { return value < entry.timestamp; });
+
+    return static_cast<uint64_t>(next - m_index) - 1;
+}
+
+bool Recording::read(const uint64_t& index, void* dst, const size_t& dst_size)
+{
+    RecordedFrame recorded;
+    if(dst == nullptr || !frame(index, recorded))
+    {
+        return false;
+    }
+
+    if(!recorded.compressed)
+    {
+        if(recorded.size > dst_size)
+        {
+            return false;
+        }
+        std::memcpy(dst, recorded.data, recorded.size);
+        return true;
+    }
+
+    if(m_header->codec != recording::CODEC_LOSSLESS)
+    {
+        return false;
+    }
+
+    if(!m_codec)
+    {
+        // Predictor is stored per frame, the one given here is only used for encoding
+        m_codec = std::make_unique<LosslessCodec>(Predictor::LEFT, 0);
+    }
+
+    return m_codec->decode(recorded.data, recorded.size, dst, dst_size);
+}
+
+bool Recording::load_index()
+{
+    if(m_file_size < m_header->header_size + sizeof(recording::Trailer))
+    {
+        return false;
+    }
+
+    const recording::Trailer* trailer = reinterpret_cast<const recording::Trailer*>(
+        m_data + m_file_size - sizeof(recording::Trailer));
+
+    // Bounds are checked by division, a crafted frame count would wrap the product
+    const uint64_t index_end = m_file_size - sizeof(recording::Trailer);
+    if(trailer->magic != recording::INDEX_MAGIC
+       || trailer->file_size != m_file_size
+       || trailer->index_offset < m_header->header_size
+       || trailer->index_offset > index_end
+       || trailer->frame_count > (index_end - trailer->index_offset) / sizeof(recording::IndexEntry)
+       || trailer->index_offset + trailer->frame_count * sizeof(recording::IndexEntry) != index_end)
+    {
+        return false;
+    }
+
+    m_index = reinterpret_cast<const recording::IndexEntry*>(m_data + trailer->index_offset);
+    m_frame_count = trailer->frame_count;
+
+    return true;
+}
+
+void Recording::recover_index()
+{
+    // Walk the frame area until the first incomplete or damaged frame
+    uint64_t offset = m_header->header_size;
+    while(offset + sizeof(recording::FrameHeader) <= m_file_size)
+    {
+        const recording::FrameHeader* header = reinterpret_cast<const recording::FrameHeader*>(m_data + offset);
+        if(header->magic != recording::FRAME_MAGIC
+           || header->index != m_recovered_index.size()
+           || header->size > m_file_size - offset - sizeof(recording::FrameHeader))
+        {
+            break;
+        }
+
+        recording::IndexEntry entry = {};
+        entry.offset = offset;
+        entry.size = header->size;
+        entry.timestamp = header->timestamp;
+        entry.flags = header->flags;
+        m_recovered_index.push_back(entry);
+
+        offset += sizeof(recording::FrameHeader) + recording::align(header->size);
+    }
+
+    m_index = m_recovered_index.data();
+    m_frame_count = m_recovered_index.size();
+    m_recovered = true;
+}
+
+void Recording::uninit()
+{
+    m_codec.reset();
+    m_recovered_index.clear();
+    m_index = nullptr;
+    m_frame_count = 0;
+    m_recovered = false;
+    m_header = nullptr;
+
+    if(m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+
+    if(m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    if(m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+}
+
+}
@@ -0,0 +1,90 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#define NOMINMAX
+#include "cdi/cdi.h"
+#include "RecordingFormat.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <windows.h>
+
+
+namespace cdi {
+
+class LosslessCodec;
+
+// Read access to a capture container through a read-only file mapping
+class Recording : public IRecording
+{
+public:
+    Recording();
+    ~Recording();
+
+    bool init(const std::wstring& path);
+    uint32_t width() const final;
+    uint32_t height() const final;
+    Encoding encoding() const final;
+    size_t size() const final;
+    std::wstring device_name() const final;
+    uint64_t frame_count() const final;
+    bool recovered() const final;
+    bool frame(const uint64_t& index, RecordedFrame& frame) const final;
+    uint64_t find(const int64_t& timestamp) const final;
+    bool read(const uint64_t& index, void* dst, const size_t& dst_size) final;
+
+private:
+    bool load_index();
+    void recover_index();
+    void uninit();
+
+private:
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const uint8_t* m_data;
+    uint64_t m_file_size;
+    const recording::FileHeader* m_header;
+    size_t m_size;
+
+    // Points either into the mapping or into m_recovered_index
+    const recording::IndexEntry* m_index;
+    uint64_t m_frame_count;
+    std::vector<recording::IndexEntry> m_recovered_index;
+    bool m_recovered;
+
+    std::unique_ptr<LosslessCodec> m_codec;
+};
+
+}
@@ -0,0 +1,122 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <cstdint>
+
+
+namespace cdi { namespace recording {
+
+// File layout, all values little endian:
+//
+//   FileHeader
+//   FrameHeader, payload, padding to ALIGNMENT   (repeated, append only)
+//   IndexEntry[frame_count]
+//   Trailer
+//
+// The index and trailer are written on close. A file without them is recovered by
+// walking the frame headers from the start of the frame area.
+
+const uint32_t FILE_MAGIC = 0x52494443;  // 'CDIR'
+const uint32_t FRAME_MAGIC = 0x454D5246; // 'FRME'
+const uint32_t INDEX_MAGIC = 0x58494443; // 'CDIX'
+const uint32_t VERSION = 1;
+const uint32_t ALIGNMENT = 64;
+const uint32_t NAME_LENGTH = 128;
+
+enum Codec : uint32_t
+{
+    CODEC_RAW = 0,
+    CODEC_LOSSLESS = 1,
+};
+
+enum FrameFlags : uint32_t
+{
+    FRAME_COMPRESSED = 1 << 0,
+    FRAME_DELTA = 1 << 1, // Compressed encodings, depends on the frames before
+};
+
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t encoding;
+    uint32_t width;
+    uint32_t height;
+    uint32_t codec;
+    uint32_t reserved0;
+    int64_t clock_origin;           // Shared clock value at the time the file was created
+    int64_t utc_origin;             // Wall clock (FILETIME) at clock_origin
+    uint16_t name[NAME_LENGTH];     // Device name, UTF-16, zero terminated
+    uint8_t reserved1[208];
+};
+
+struct FrameHeader
+{
+    uint32_t magic;
+    uint32_t flags;
+    uint64_t index;
+    uint64_t size;
+    int64_t timestamp;
+    uint8_t reserved[32];
+};
+
+struct IndexEntry
+{
+    uint64_t offset; // File offset of the FrameHeader
+    uint64_t size;
+    int64_t timestamp;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct Trailer
+{
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t index_offset;
+    uint64_t frame_count;
+    uint64_t file_size;
+};
+
+static_assert(sizeof(FileHeader) == 512, "Unexpected FileHeader size");
+static_assert(sizeof(FrameHeader) == ALIGNMENT, "Unexpected FrameHeader size");
+static_assert(sizeof(IndexEntry) == 32, "Unexpected IndexEntry size");
+static_assert(sizeof(Trailer) == 32, "Unexpected Trailer size");
+
+inline uint64_t align(const uint64_t& size)
+{
+    return (size + ALIGNMENT - 1) & ~static_cast<uint64_t>(ALIGNMENT - 1);
+}
+
+}}
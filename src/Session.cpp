@@ -0,0 +1,167 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Session.h"
+#include "Macros.inl"
+
+
+namespace cdi {
+
+Session::Session()
+    : m_device(nullptr)
+    , m_source(nullptr)
+    , m_enumerate(0)
+    , m_leased(false)
+    , m_discarded(false)
+    , m_leases(0)
+    , m_released(0)
+{
+}
+
+Session::~Session()
+{
+    uninit();
+}
+
+bool Session::init(const std::shared_ptr<DevicePool>& pool, const uint32_t& device_index)
+{
+    const int64_t start = clock_now();
+
+    if(m_pool || !pool || pool->get_count() <= device_index)
+    {
+        return false;
+    }
+
+    // The source activated for the enumeration is the one every buffer reads from
+    m_formats = pool->get_formats(device_index, &m_source);
+    if(m_source == nullptr)
+    {
+        return false;
+    }
+
+    m_pool = pool;
+    m_device = m_pool->get_device(device_index);
+    m_enumerate = clock_now() - start;
+    m_released = clock_now();
+
+    return true;
+}
+
+bool Session::acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_leased || m_discarded || m_source == nullptr)
+    {
+        return false;
+    }
+
+    m_leased = true;
+    m_leases++;
+    return true;
+}
+
+void Session::release()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_leased = false;
+    m_released = clock_now();
+}
+
+void Session::discard()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_discarded = true;
+}
+
+bool Session::discarded() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_discarded;
+}
+
+bool Session::idle() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_leased;
+}
+
+bool Session::expired(const int64_t& now, const int64_t& timeout) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_leased && (m_discarded || now - m_released >= timeout);
+}
+
+IMFActivate* Session::device() const
+{
+    return m_device;
+}
+
+IMFMediaSource* Session::source() const
+{
+    return m_source;
+}
+
+const std::vector<DevicePool::Format>& Session::formats() const
+{
+    return m_formats;
+}
+
+int64_t Session::enumerate() const
+{
+    return m_enumerate;
+}
+
+bool Session::warm() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_leases > 1;
+}
+
+void Session::uninit()
+{
+    // Readers only disconnected from the source, shutting it down releases the camera. Through
+    // the activation, which would hand out the shut down source to the next session otherwise.
+    if(m_device != nullptr)
+    {
+        m_device->ShutdownObject();
+    }
+    else if(m_source != nullptr)
+    {
+        m_source->Shutdown();
+    }
+    SAFE_RELEASE(m_source);
+
+    m_device = nullptr;
+    m_pool.reset();
+}
+
+}
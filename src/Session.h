@@ -0,0 +1,95 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "DevicePool.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <mfidl.h>
+
+
+namespace cdi {
+
+// One device activated by a session pool and lent to one buffer at a time. Shares the
+// enumeration of the pool, which keeps the device and Media Foundation alive for a buffer
+// that outlives the pool.
+class Session
+{
+    Session(const Session&);
+    Session& operator=(const Session&);
+
+public:
+    Session();
+    ~Session();
+
+    bool init(const std::shared_ptr<DevicePool>& pool, const uint32_t& device_index);
+
+    // False while a buffer uses the session
+    bool acquire();
+    void release();
+    // The source was replaced by a recovery of the stream, the session cannot be lent again
+    void discard();
+    bool discarded() const;
+    bool idle() const;
+    // Without a buffer for 'timeout' or longer at 'now'
+    bool expired(const int64_t& now, const int64_t& timeout) const;
+
+    IMFActivate* device() const;
+    IMFMediaSource* source() const;
+    const std::vector<DevicePool::Format>& formats() const;
+    // Duration of init(), the cold part of the first open
+    int64_t enumerate() const;
+    // Served a buffer before the current one
+    bool warm() const;
+
+private:
+    void uninit();
+
+private:
+    std::shared_ptr<DevicePool> m_pool;
+    IMFActivate* m_device;
+    IMFMediaSource* m_source;
+    std::vector<DevicePool::Format> m_formats;
+    int64_t m_enumerate;
+
+    mutable std::mutex m_mutex;
+    bool m_leased;
+    bool m_discarded;
+    uint64_t m_leases;
+    int64_t m_released;
+};
+
+}
@@ -0,0 +1,209 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "SessionPool.h"
+#include "Buffer.h"
+#include "DevicePool.h"
+#include "Session.h"
+#include "ThreadPlacer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <mfapi.h>
+
+
+namespace cdi {
+
+SessionPool::SessionPool()
+    : m_idle_timeout(0)
+    , m_exit(false)
+{
+}
+
+SessionPool::~SessionPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_wake.notify_all();
+
+    if(m_janitor.joinable())
+    {
+        m_janitor.join();
+    }
+
+    // Sessions in use by a buffer go with the buffer
+    m_sessions.clear();
+}
+
+bool SessionPool::init(const uint32_t& idle_timeout_ms)
+{
+    if(m_pool)
+    {
+        return false;
+    }
+
+    m_pool = std::make_shared<DevicePool>();
+    m_idle_timeout = static_cast<int64_t>(idle_timeout_ms) * 10000;
+    m_janitor = std::thread([this]() { janitor(); });
+
+    return true;
+}
+
+std::unique_ptr<IBuffer> SessionPool::open(
+    const uint32_t& device_index,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const StreamOptions& options)
+{
+    std::unique_ptr<Buffer> buffer;
+    if(encoding == Encoding::UNKNOWN)
+    {
+        return buffer;
+    }
+
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Cold open, activate the device and keep it
+        std::shared_ptr<Session>& entry = m_sessions[device_index];
+        if(!entry || entry->discarded())
+        {
+            entry = std::make_shared<Session>();
+            if(!entry->init(m_pool, device_index))
+            {
+                m_sessions.erase(device_index);
+                return buffer;
+            }
+        }
+
+        if(!entry->acquire())
+        {
+            return buffer;
+        }
+
+        session = entry;
+    }
+
+    // The buffer returns the session when it goes, also when it fails to open
+    buffer = std::make_unique<Buffer>();
+    if(!buffer->init(session, width, height, encoding, options))
+    {
+        buffer.reset();
+    }
+
+    return buffer;
+}
+
+uint32_t SessionPool::idle_count() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t count = 0;
+    for(const auto& kv : m_sessions)
+    {
+        count += kv.second->idle() ? 1 : 0;
+    }
+
+    return count;
+}
+
+void SessionPool::clear()
+{
+    std::vector<std::shared_ptr<Session>> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        expired = take_expired(0);
+    }
+
+    // Shut down outside the lock, opens of other devices go on meanwhile
+    expired.clear();
+}
+
+void SessionPool::janitor()
+{
+    // Shutting down a source needs COM on this thread
+    const HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    ThreadPlacer::apply(get_thread_policy());
+
+    // A quarter of the timeout, idle sessions are closed within 1.25 timeouts
+    const std::chrono::milliseconds period(std::max<int64_t>(m_idle_timeout / 40000, 10));
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!m_exit)
+    {
+        m_wake.wait_for(lock, period);
+
+        std::vector<std::shared_ptr<Session>> expired = take_expired(m_idle_timeout);
+        if(!expired.empty())
+        {
+            lock.unlock();
+            expired.clear();
+            lock.lock();
+        }
+    }
+
+    lock.unlock();
+
+    if(SUCCEEDED(com))
+    {
+        CoUninitialize();
+    }
+}
+
+std::vector<std::shared_ptr<Session>> SessionPool::take_expired(const int64_t& timeout)
+{
+    std::vector<std::shared_ptr<Session>> expired;
+
+    const int64_t now = clock_now();
+    for(auto it = m_sessions.begin(); it != m_sessions.end();)
+    {
+        if(it->second->expired(now, timeout))
+        {
+            expired.push_back(it->second);
+            it = m_sessions.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    return expired;
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace cdi {
+
+class DevicePool;
+class Session;
+
+class SessionPool : public ISessionPool
+{
+public:
+    SessionPool();
+    ~SessionPool();
+
+    bool init(const uint32_t& idle_timeout_ms);
+    std::unique_ptr<IBuffer> open(
+        const uint32_t& device_index,
+        const uint32_t& width,
+        const uint32_t& height,
+        const Encoding& encoding,
+        const StreamOptions& options) final;
+    uint32_t idle_count() const final;
+    void clear() final;
+
+private:
+    void janitor();
+    // Takes the sessions idle for 'timeout' or longer out of the pool, called with the mutex held
+    std::vector<std::shared_ptr<Session>> take_expired(const int64_t& timeout);
+
+private:
+    std::shared_ptr<DevicePool> m_pool;
+    std::map<uint32_t, std::shared_ptr<Session>> m_sessions;
+    int64_t m_idle_timeout; // clock_now() units
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_janitor;
+    bool m_exit;
+};
+
+}
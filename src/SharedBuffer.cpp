@@ -0,0 +1,409 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SharedBuffer.h"
+#include "Clock.h"
+#include "JpegEncoder.h"
+#include "Pyramid.h"
+#include "Trace.h"
+
+#include <cstring>
+
+
+namespace cdi
+{
+
+SharedBuffer::SharedBuffer()
+    : m_encoding(Encoding::UNKNOWN)
+    , m_sequence(0)
+    , m_stale(false)
+    , m_locked_data(nullptr)
+    , m_delivered(0)
+    , m_convert_time(0)
+    , m_latency(0)
+{
+}
+
+SharedBuffer::~SharedBuffer()
+{
+    if(m_capture)
+    {
+        m_capture->cancel(this);
+    }
+}
+
+bool SharedBuffer::init(const std::shared_ptr<SharedCapture>& capture, const Encoding& encoding)
+{
+    if(m_capture || !capture || !m_layout.init(capture->width(), capture->height(), encoding))
+    {
+        return false;
+    }
+
+    const StreamOptions& options = capture->options();
+    if(!options.pyramid.empty())
+    {
+        m_pyramid = std::make_unique<Pyramid>();
+        const bool top_down = options.orientation.top_down;
+        if(!m_pyramid->init(capture->width(), capture->height(), encoding, options.pyramid, options.color, top_down))
+        {
+            m_pyramid.reset();
+            return false;
+        }
+    }
+
+    m_capture = capture;
+    m_encoding = encoding;
+
+    return true;
+}
+
+uint32_t SharedBuffer::width() const
+{
+    return m_capture->width();
+}
+
+uint32_t SharedBuffer::height() const
+{
+    return m_capture->height();
+}
+
+Encoding SharedBuffer::encoding() const
+{
+    return m_encoding;
+}
+
+size_t SharedBuffer::size() const
+{
+    return m_layout.size();
+}
+
+int64_t SharedBuffer::timestamp() const
+{
+    return m_frame ? m_frame->snapshot.info.timestamp : 0;
+}
+
+bool SharedBuffer::advance()
+{
+    bool stale = false;
+    std::shared_ptr<SharedCapture::Frame> frame = m_capture->next(m_sequence, stale);
+    m_stale = stale;
+    if(!frame)
+    {
+        return false;
+    }
+
+    // Converted by this consumer or by another one of the same encoding
+    const int64_t start = clock_now();
+    SharedCapture::Converted converted = m_capture->convert(frame, m_encoding);
+    if(!converted)
+    {
+        return false;
+    }
+
+    const int64_t now = clock_now();
+    const int64_t latency = now - frame->snapshot.info.timestamp;
+    m_convert_time += now - start;
+    m_latency += latency > 0 ? latency : 0;
+    m_delivered++;
+
+    m_frame = frame;
+    m_converted = converted;
+    m_sequence = frame->snapshot.info.sequence;
+
+    return true;
+}
+
+const void* SharedBuffer::lock()
+{
+    trace::Scope scope(trace::Name::LOCK, m_capture->trace_stream(), 0);
+
+    if(m_locked_data != nullptr || !advance())
+    {
+        return nullptr;
+    }
+
+    scope.set_sequence(m_sequence);
+    m_locked_data = m_converted->data();
+
+    if(m_pyramid)
+    {
+        m_pyramid->build(m_locked_data);
+    }
+
+    return m_locked_data;
+}
+
+void SharedBuffer::unlock()
+{
+    trace::Scope scope(trace::Name::UNLOCK, m_capture->trace_stream(), m_sequence);
+
+    m_locked_data = nullptr;
+}
+
+uint32_t SharedBuffer::level_count() const
+{
+    return 1 + (m_pyramid ? m_pyramid->level_count() : 0);
+}
+
+FrameLevel SharedBuffer::level(const uint32_t& index) const
+{
+    FrameLevel result;
+    if(m_locked_data == nullptr)
+    {
+        return result;
+    }
+
+    if(index == 0)
+    {
+        result.width = width();
+        result.height = height();
+        result.encoding = m_encoding;
+        result.size = m_layout.size();
+        result.data = m_locked_data;
+        result.top_down = m_capture->options().orientation.top_down
+            && (m_encoding == Encoding::RGB24 || m_encoding == Encoding::RGBA32);
+        result.color = m_capture->options().color;
+    }
+    else if(m_pyramid)
+    {
+        result = m_pyramid->level(index - 1);
+    }
+
+    return result;
+}
+
+FrameInfo SharedBuffer::info() const
+{
+    if(!m_frame)
+    {
+        FrameInfo result;
+        result.stale = m_stale;
+        return result;
+    }
+
+    const FrameSnapshot& snapshot = m_frame->snapshot;
+    FrameInfo result = snapshot.info;
+    result.change_mask = snapshot.mask.empty() ? nullptr : snapshot.mask.data();
+    result.statistics = m_capture->options().statistics.enabled ? &snapshot.statistics : nullptr;
+    result.stale = m_stale;
+    return result;
+}
+
+bool SharedBuffer::read_into(void* dst, const size_t& stride)
+{
+    if(dst == nullptr)
+    {
+        return false;
+    }
+
+    // Planes follow each other, strides scale with the plane widths
+    FramePlane planes[3];
+    uint8_t* data = static_cast<uint8_t*>(dst);
+    for(uint32_t i = 0; i < m_layout.plane_count(); i++)
+    {
+        const FrameLayout::Plane& plane = m_layout.plane(i);
+        planes[i].data = data;
+        planes[i].stride = stride * plane.stride / m_layout.plane(0).stride;
+        data += planes[i].stride * plane.height;
+    }
+
+    return read_into(planes, m_layout.plane_count());
+}
+
+bool SharedBuffer::read_into(const FramePlane* planes, const uint32_t& plane_count)
+{
+    trace::Scope scope(trace::Name::READ_INTO, m_capture->trace_stream(), 0);
+
+    if(planes == nullptr || m_locked_data != nullptr || plane_count != m_layout.plane_count())
+    {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < plane_count; i++)
+    {
+        if(planes[i].data == nullptr || planes[i].stride < m_layout.plane(i).width)
+        {
+            return false;
+        }
+    }
+
+    // The shared conversion is copied, other consumers may hold it
+    if(!advance())
+    {
+        return false;
+    }
+
+    scope.set_sequence(m_sequence);
+
+    const uint8_t* data = m_converted->data();
+    for(uint32_t i = 0; i < plane_count; i++)
+    {
+        const FrameLayout::Plane& plane = m_layout.plane(i);
+        const uint8_t* src = data + plane.offset;
+        uint8_t* dst = static_cast<uint8_t*>(planes[i].data);
+        for(uint32_t row = 0; row < plane.height; row++)
+        {
+            std::memcpy(dst + planes[i].stride * row, src + static_cast<size_t>(plane.stride) * row, plane.width);
+        }
+    }
+
+    return true;
+}
+
+bool SharedBuffer::notify_frame(const std::function<void(bool)>& ready)
+{
+    return m_capture->notify(this, m_sequence, ready);
+}
+
+void SharedBuffer::cancel_notify()
+{
+    m_capture->cancel(this);
+}
+
+OpenTimings SharedBuffer::open_timings() const
+{
+    return m_capture->open_timings();
+}
+
+bool SharedBuffer::reconfigure(const uint32_t& /*width*/, const uint32_t& /*height*/, const Encoding& /*encoding*/)
+{
+    // The format belongs to all consumers of the capture
+    return false;
+}
+
+ThreadPlacement SharedBuffer::placement() const
+{
+    return m_capture->placement();
+}
+
+RecoveryStatistics SharedBuffer::recovery() const
+{
+    return m_capture->recovery();
+}
+
+StreamLoad SharedBuffer::load() const
+{
+    StreamLoad load = m_capture->load();
+    load.delivered = m_delivered;
+    load.convert_time = m_convert_time;
+    load.latency = m_latency;
+    return load;
+}
+
+bool SharedBuffer::set_quality(const CaptureQuality& quality)
+{
+    // As the format, the frame rate belongs to all consumers
+    return quality.frame_divisor == 1 && !quality.cheap_format && quality.resolution_steps == 0;
+}
+
+CaptureQuality SharedBuffer::quality() const
+{
+    return CaptureQuality();
+}
+
+size_t SharedBuffer::snapshot_jpeg(const JpegOptions& options, void* dst, const size_t& dst_size)
+{
+    trace::Scope scope(trace::Name::SNAPSHOT, m_capture->trace_stream(), 0);
+
+    if(dst == nullptr || m_locked_data != nullptr)
+    {
+        return 0;
+    }
+
+    if(!m_jpeg)
+    {
+        m_jpeg = std::make_unique<JpegEncoder>();
+    }
+
+    if(m_jpeg->quality() != options.quality && !m_jpeg->init(options.quality))
+    {
+        return 0;
+    }
+
+    bool stale = false;
+    std::shared_ptr<SharedCapture::Frame> frame = m_capture->next(m_sequence, stale);
+    m_stale = stale;
+    if(!frame)
+    {
+        return 0;
+    }
+
+    // Frames the device does not deliver as 8 bit YUV share the I420 conversion of other consumers
+    const int64_t start = clock_now();
+    size_t bytes = 0;
+    if(!m_capture->encode_jpeg(frame, *m_jpeg, options, dst, dst_size, bytes))
+    {
+        SharedCapture::Converted converted = m_capture->convert(frame, Encoding::I420);
+        if(!converted)
+        {
+            return 0;
+        }
+
+        bytes = m_jpeg->encode(
+            kernels::YuvFormat::I420,
+            converted->data(),
+            static_cast<int32_t>(m_capture->width()),
+            m_capture->width(),
+            m_capture->height(),
+            options.scale,
+            m_capture->options().color.range,
+            static_cast<uint8_t*>(dst),
+            dst_size);
+    }
+
+    if(bytes == 0)
+    {
+        return 0;
+    }
+
+    const int64_t now = clock_now();
+    const int64_t latency = now - frame->snapshot.info.timestamp;
+    m_convert_time += now - start;
+    m_latency += latency > 0 ? latency : 0;
+    m_delivered++;
+
+    m_frame = frame;
+    m_sequence = frame->snapshot.info.sequence;
+    scope.set_sequence(m_sequence);
+
+    return bytes;
+}
+
+bool SharedBuffer::dump(const int64_t& since, const std::wstring& path, std::unique_ptr<ICodec> codec)
+{
+    trace::Scope scope(trace::Name::DUMP, m_capture->trace_stream(), 0);
+
+    // The ring holds the device frames, they are converted into the encoding of this consumer
+    return m_capture->dump(since, path, m_encoding, std::move(codec));
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "SharedCapture.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+
+namespace cdi
+{
+
+class JpegEncoder;
+class Pyramid;
+
+// Consumer of a shared stream in its own encoding
+class SharedBuffer : public IBuffer
+{
+    SharedBuffer(const SharedBuffer&);
+    SharedBuffer& operator=(const SharedBuffer&);
+
+public:
+    SharedBuffer();
+    ~SharedBuffer();
+
+    bool init(const std::shared_ptr<SharedCapture>& capture, const Encoding& encoding);
+    uint32_t width() const final;
+    uint32_t height() const final;
+    Encoding encoding() const final;
+    size_t size() const final;
+    int64_t timestamp() const final;
+    const void* lock() final;
+    void unlock() final;
+    uint32_t level_count() const final;
+    FrameLevel level(const uint32_t& index) const final;
+    FrameInfo info() const final;
+    bool read_into(void* dst, const size_t& stride) final;
+    bool read_into(const FramePlane* planes, const uint32_t& plane_count) final;
+    bool notify_frame(const std::function<void(bool)>& ready) final;
+    void cancel_notify() final;
+    OpenTimings open_timings() const final;
+    bool reconfigure(const uint32_t& width, const uint32_t& height, const Encoding& encoding) final;
+    ThreadPlacement placement() const final;
+    RecoveryStatistics recovery() const final;
+    StreamLoad load() const final;
+    bool set_quality(const CaptureQuality& quality) final;
+    CaptureQuality quality() const final;
+    size_t snapshot_jpeg(const JpegOptions& options, void* dst, const size_t& dst_size) final;
+    bool dump(const int64_t& since, const std::wstring& path, std::unique_ptr<ICodec> codec) final;
+
+private:
+    // Takes the next frame in the encoding of the buffer
+    bool advance();
+
+private:
+    std::shared_ptr<SharedCapture> m_capture;
+    Encoding m_encoding;
+    FrameLayout m_layout;
+    std::shared_ptr<SharedCapture::Frame> m_frame;
+    SharedCapture::Converted m_converted;
+    uint64_t m_sequence;
+    bool m_stale;
+    const void* m_locked_data;
+    std::unique_ptr<Pyramid> m_pyramid;
+    std::unique_ptr<JpegEncoder> m_jpeg;
+
+    // Frames of this consumer, the device counts the reads of all of them
+    std::atomic<uint64_t> m_delivered;
+    std::atomic<int64_t> m_convert_time;
+    std::atomic<int64_t> m_latency;
+};
+
+}
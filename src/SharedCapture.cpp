@@ -0,0 +1,395 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "SharedCapture.h"
+#include "Buffer.h"
+#include "ColorTransform.h"
+#include "ExternalBuffer.h"
+#include "Trace.h"
+#include "Macros.inl"
+
+#include <cstring>
+#include <limits>
+
+
+namespace cdi {
+
+SharedCapture::Frame::Frame()
+    : sample(nullptr)
+    , generation(0)
+{
+}
+
+SharedCapture::Frame::~Frame()
+{
+    SAFE_RELEASE(sample);
+}
+
+SharedCapture::Output::Output()
+    : generation(0)
+{
+}
+
+SharedCapture::Output::~Output()
+{
+}
+
+SharedCapture::SharedCapture()
+    : m_latest_sequence(0)
+    , m_requested(false)
+    , m_device(nullptr)
+{
+}
+
+SharedCapture::~SharedCapture()
+{
+    if(m_device != nullptr)
+    {
+        m_device->cancel_notify();
+    }
+
+    m_buffer.reset();
+    m_device = nullptr;
+}
+
+bool SharedCapture::init(
+    const uint32_t& device_index,
+    const uint32_t& width,
+    const uint32_t& height,
+    const StreamOptions& options)
+{
+    if(m_buffer)
+    {
+        return false;
+    }
+
+    m_options = options;
+
+    // Pyramids are built by the consumers in their encodings, the device does not need one
+    StreamOptions device_options(options);
+    device_options.pyramid.clear();
+
+    m_buffer = std::make_unique<Buffer>();
+    if(!m_buffer->init(device_index, width, height, Encoding::I420, device_options) || m_buffer->device() == nullptr)
+    {
+        m_buffer.reset();
+        return false;
+    }
+
+    m_device = m_buffer->device();
+    return true;
+}
+
+std::shared_ptr<SharedCapture::Frame> SharedCapture::next(const uint64_t& sequence, bool& stale)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Another consumer read a frame this one has not seen yet
+    stale = false;
+    if(m_latest && m_latest->snapshot.info.sequence > sequence)
+    {
+        return m_latest;
+    }
+
+    std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+    frame->sample = m_device->capture(frame->snapshot);
+    if(frame->sample == nullptr)
+    {
+        stale = true;
+        return m_latest;
+    }
+
+    frame->generation = m_device->generation();
+    m_latest = frame;
+    m_latest_sequence = frame->snapshot.info.sequence;
+    lock.unlock();
+
+    // Consumers waiting for a frame need not wait for the device's next one
+    on_ready(true, false);
+
+    return frame;
+}
+
+SharedCapture::Converted SharedCapture::convert(const std::shared_ptr<Frame>& frame, const Encoding& encoding)
+{
+    if(!frame)
+    {
+        return nullptr;
+    }
+
+    // The sample is read by one conversion at a time
+    std::lock_guard<std::mutex> frame_lock(frame->mutex);
+    std::map<Encoding, Converted>::const_iterator found = frame->converted.find(encoding);
+    if(found != frame->converted.end())
+    {
+        return found->second;
+    }
+
+    Output* output = this->output(encoding);
+    if(output == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> output_lock(output->mutex);
+    if(!output->transform || output->generation != frame->generation)
+    {
+        output->transform = m_device->create_transform(encoding);
+        output->generation = frame->generation;
+        if(!output->transform)
+        {
+            return nullptr;
+        }
+    }
+
+    // A frame no consumer holds anymore is written again
+    const size_t size = output->layout.size();
+    Converted converted;
+    for(const Converted& candidate : output->frames)
+    {
+        if(candidate.use_count() == 1)
+        {
+            converted = candidate;
+            break;
+        }
+    }
+
+    if(!converted)
+    {
+        converted = std::make_shared<std::vector<uint8_t>>(size);
+        output->frames.push_back(converted);
+    }
+
+    trace::set_frame(m_device->trace_stream(), frame->snapshot.info.sequence);
+
+    // Bottom-up RGB has the top image row last in memory
+    uint8_t* base = converted->data();
+    const LONG stride = static_cast<LONG>(output->layout.plane(0).stride);
+    const bool bottom_up = output->transform->bottom_up();
+    uint8_t* scanline0 = bottom_up ? base + static_cast<size_t>(stride) * (m_device->height() - 1) : base;
+
+    bool direct = false;
+    ExternalBuffer* target = new ExternalBuffer(base, size, scanline0, bottom_up ? -stride : stride, true);
+    const bool result = output->transform->transform(frame->sample, target, direct);
+    target->detach();
+    target->Release();
+
+    m_device->converted(result);
+    if(!result)
+    {
+        return nullptr;
+    }
+
+    if(!direct)
+    {
+        size_t bytes = 0;
+        const void* data = output->transform->lock(bytes);
+        if(data == nullptr || bytes < size)
+        {
+            output->transform->unlock();
+            return nullptr;
+        }
+
+        std::memcpy(base, data, size);
+        output->transform->unlock();
+    }
+
+    frame->converted[encoding] = converted;
+    return converted;
+}
+
+SharedCapture::Output* SharedCapture::output(const Encoding& encoding)
+{
+    std::lock_guard<std::mutex> lock(m_output_mutex);
+
+    std::unique_ptr<Output>& output = m_outputs[encoding];
+    if(!output)
+    {
+        std::unique_ptr<Output> created = std::make_unique<Output>();
+        if(!created->layout.init(m_device->width(), m_device->height(), encoding)
+           || created->layout.size() > std::numeric_limits<DWORD>::max())
+        {
+            m_outputs.erase(encoding);
+            return nullptr;
+        }
+
+        output = std::move(created);
+    }
+
+    return output.get();
+}
+
+bool SharedCapture::notify(const void* owner, const uint64_t& sequence, const std::function<void(bool)>& ready)
+{
+    if(!ready)
+    {
+        return false;
+    }
+
+    bool arrived = false;
+    bool request = false;
+    {
+        std::lock_guard<std::mutex> lock(m_notify_mutex);
+        if(m_waiters.count(owner) != 0)
+        {
+            return false;
+        }
+
+        // Another consumer got a frame already which this one has not locked
+        arrived = m_latest_sequence > sequence;
+        if(!arrived)
+        {
+            m_waiters[owner] = ready;
+            request = !m_requested;
+            m_requested = true;
+        }
+    }
+
+    if(arrived)
+    {
+        ready(true);
+        return true;
+    }
+
+    // One request to the device serves every waiting consumer
+    if(request && !m_device->notify_frame([this](bool arrived) { on_ready(arrived, true); }))
+    {
+        std::lock_guard<std::mutex> lock(m_notify_mutex);
+        m_waiters.erase(owner);
+        m_requested = false;
+        return false;
+    }
+
+    return true;
+}
+
+void SharedCapture::cancel(const void* owner)
+{
+    std::function<void(bool)> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_notify_mutex);
+        std::map<const void*, std::function<void(bool)>>::iterator found = m_waiters.find(owner);
+        if(found == m_waiters.end())
+        {
+            return;
+        }
+
+        ready.swap(found->second);
+        m_waiters.erase(found);
+    }
+
+    ready(false);
+}
+
+void SharedCapture::on_ready(const bool& arrived, const bool& device)
+{
+    std::map<const void*, std::function<void(bool)>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(m_notify_mutex);
+        waiters.swap(m_waiters);
+        m_requested = m_requested && !device;
+    }
+
+    for(std::pair<const void* const, std::function<void(bool)>>& waiter : waiters)
+    {
+        waiter.second(arrived);
+    }
+}
+
+uint32_t SharedCapture::width() const
+{
+    return m_device->width();
+}
+
+uint32_t SharedCapture::height() const
+{
+    return m_device->height();
+}
+
+const StreamOptions& SharedCapture::options() const
+{
+    return m_options;
+}
+
+uint32_t SharedCapture::trace_stream() const
+{
+    return m_device->trace_stream();
+}
+
+OpenTimings SharedCapture::open_timings() const
+{
+    return m_buffer->open_timings();
+}
+
+ThreadPlacement SharedCapture::placement() const
+{
+    return m_buffer->placement();
+}
+
+RecoveryStatistics SharedCapture::recovery() const
+{
+    return m_buffer->recovery();
+}
+
+bool SharedCapture::encode_jpeg(
+    const std::shared_ptr<Frame>& frame,
+    JpegEncoder& encoder,
+    const JpegOptions& options,
+    void* dst,
+    const size_t& dst_size,
+    size_t& bytes)
+{
+    bytes = 0;
+    if(frame->generation != m_device->generation())
+    {
+        return false;
+    }
+
+    return m_device->encode_jpeg(frame->sample, encoder, options, dst, dst_size, bytes);
+}
+
+StreamLoad SharedCapture::load() const
+{
+    return m_buffer->load();
+}
+
+bool SharedCapture::dump(
+    const int64_t& since,
+    const std::wstring& path,
+    const Encoding& encoding,
+    std::unique_ptr<ICodec> codec)
+{
+    return m_device->dump(since, path, encoding, std::move(codec));
+}
+
+}
@@ -0,0 +1,151 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "Device.h"
+#include "FrameLayout.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <mfidl.h>
+
+namespace cdi {
+
+class Buffer;
+class ColorTransform;
+class JpegEncoder;
+
+// Capture side of a shared stream: reads frames for all consumers and converts each frame into
+// every encoding that has been asked for once
+class SharedCapture
+{
+    SharedCapture(const SharedCapture&);
+    SharedCapture& operator=(const SharedCapture&);
+
+public:
+    typedef std::shared_ptr<std::vector<uint8_t>> Converted;
+
+    // A frame as read from the device with the conversions done so far
+    struct Frame
+    {
+        Frame();
+        ~Frame();
+        IMFSample* sample;
+        FrameSnapshot snapshot;
+        uint32_t generation;
+        std::mutex mutex;
+        std::map<Encoding, Converted> converted;
+    };
+
+    SharedCapture();
+    ~SharedCapture();
+
+    bool init(
+        const uint32_t& device_index,
+        const uint32_t& width,
+        const uint32_t& height,
+        const StreamOptions& options);
+    // The latest frame when it is newer than 'sequence', otherwise the next one from the device.
+    // 'stale' when the device has no new frame, the latest one is returned then if there is one.
+    std::shared_ptr<Frame> next(const uint64_t& sequence, bool& stale);
+    // The frame in 'encoding', laid out as a locked frame, null when the conversion fails
+    Converted convert(const std::shared_ptr<Frame>& frame, const Encoding& encoding);
+    // See Device::encode_jpeg(), false as well when the device changed its format since the frame
+    bool encode_jpeg(
+        const std::shared_ptr<Frame>& frame,
+        JpegEncoder& encoder,
+        const JpegOptions& options,
+        void* dst,
+        const size_t& dst_size,
+        size_t& bytes);
+    // notify_frame() of the consumer 'owner' for a frame newer than 'sequence'
+    bool notify(const void* owner, const uint64_t& sequence, const std::function<void(bool)>& ready);
+    void cancel(const void* owner);
+    uint32_t width() const;
+    uint32_t height() const;
+    const StreamOptions& options() const;
+    uint32_t trace_stream() const;
+    OpenTimings open_timings() const;
+    ThreadPlacement placement() const;
+    RecoveryStatistics recovery() const;
+    StreamLoad load() const;
+    // See Device::dump()
+    bool dump(
+        const int64_t& since,
+        const std::wstring& path,
+        const Encoding& encoding,
+        std::unique_ptr<ICodec> codec);
+
+private:
+    // Conversion into one encoding and the frames it wrote, reused once no consumer holds them
+    struct Output
+    {
+        Output();
+        ~Output();
+        std::mutex mutex;
+        std::unique_ptr<ColorTransform> transform;
+        uint32_t generation;
+        FrameLayout layout;
+        std::vector<Converted> frames;
+    };
+
+    Output* output(const Encoding& encoding);
+    // 'device' when the device answers the request of notify()
+    void on_ready(const bool& arrived, const bool& device);
+
+private:
+    StreamOptions m_options;
+
+    std::mutex m_mutex;
+    std::shared_ptr<Frame> m_latest;
+    std::atomic<uint64_t> m_latest_sequence;
+
+    std::mutex m_output_mutex;
+    std::map<Encoding, std::unique_ptr<Output>> m_outputs;
+
+    std::mutex m_notify_mutex;
+    std::map<const void*, std::function<void(bool)>> m_waiters;
+    bool m_requested;
+
+    // Declared last, the device stops calling back before anything else goes
+    std::unique_ptr<Buffer> m_buffer;
+    Device* m_device;
+};
+
+}
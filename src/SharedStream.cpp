@@ -0,0 +1,96 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SharedStream.h"
+#include "SharedBuffer.h"
+#include "SharedCapture.h"
+
+
+namespace cdi
+{
+
+SharedStream::SharedStream()
+{
+}
+
+SharedStream::~SharedStream()
+{
+}
+
+bool SharedStream::init(
+    const uint32_t& device_index,
+    const uint32_t& width,
+    const uint32_t& height,
+    const StreamOptions& options)
+{
+    if(m_capture)
+    {
+        return false;
+    }
+
+    std::shared_ptr<SharedCapture> capture = std::make_shared<SharedCapture>();
+    if(!capture->init(device_index, width, height, options))
+    {
+        return false;
+    }
+
+    m_capture = capture;
+    return true;
+}
+
+std::unique_ptr<IBuffer> SharedStream::attach(const Encoding& encoding)
+{
+    std::unique_ptr<SharedBuffer> buffer;
+
+    if(m_capture && encoding != Encoding::UNKNOWN)
+    {
+        buffer = std::make_unique<SharedBuffer>();
+        if(!buffer->init(m_capture, encoding))
+        {
+            buffer.reset();
+        }
+    }
+
+    return buffer;
+}
+
+uint32_t SharedStream::width() const
+{
+    return m_capture ? m_capture->width() : 0;
+}
+
+uint32_t SharedStream::height() const
+{
+    return m_capture ? m_capture->height() : 0;
+}
+
+}
@@ -0,0 +1,574 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TensorWriter.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace cdi {
+
+namespace {
+
+// Round to nearest even, values outside the half range saturate to infinity
+uint16_t float_to_half(const float& value)
+{
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    const uint32_t sign = (f >> 16) & 0x8000;
+    f &= 0x7FFFFFFF;
+
+    uint32_t h;
+    if(f >= 0x47800000)
+    {
+        h = f > 0x7F800000 ? 0x7E00 : 0x7C00;
+    }
+    else if(f < 0x38800000)
+    {
+        // Subnormal, let the FPU round by adding a magic number
+        const uint32_t magic_bits = 0x3F000000;
+        float magic;
+        float v;
+        std::memcpy(&magic, &magic_bits, sizeof(magic));
+        std::memcpy(&v, &f, sizeof(v));
+        v += magic;
+        std::memcpy(&h, &v, sizeof(h));
+        h -= magic_bits;
+    }
+    else
+    {
+        const uint32_t odd = (f >> 13) & 1;
+        h = (f + 0xC8000FFF + odd) >> 13;
+    }
+
+    return static_cast<uint16_t>(h | sign);
+}
+
+uint32_t element_size(const TensorType& type)
+{
+    switch(type)
+    {
+    case TensorType::UINT8:
+        return 1;
+    case TensorType::FLOAT16:
+        return 2;
+    case TensorType::FLOAT32:
+        return 4;
+    }
+
+    return 0;
+}
+
+// dst[i * step] = src[i] * scale + bias
+void store_f32(const float* src, float* dst, const uint32_t& count, const uint32_t& step, const float& scale, const float& bias)
+{
+    uint32_t x = 0;
+    if(step == 1)
+    {
+        const __m128 s = _mm_set1_ps(scale);
+        const __m128 b = _mm_set1_ps(bias);
+        for(; x + 4 <= count; x += 4)
+        {
+            _mm_storeu_ps(dst + x, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + x), s), b));
+        }
+    }
+
+    for(; x < count; ++x)
+    {
+        dst[x * step] = src[x] * scale + bias;
+    }
+}
+
+void store_f16(const float* src, uint16_t* dst, const uint32_t& count, const uint32_t& step, const float& scale, const float& bias)
+{
+    for(uint32_t x = 0; x < count; ++x)
+    {
+        dst[x * step] = float_to_half(src[x] * scale + bias);
+    }
+}
+
+void store_u8(const float* src, uint8_t* dst, const uint32_t& count, const uint32_t& step)
+{
+    uint32_t x = 0;
+    if(step == 1)
+    {
+        for(; x + 8 <= count; x += 8)
+        {
+            const __m128i lo = _mm_cvtps_epi32(_mm_loadu_ps(src + x));
+            const __m128i hi = _mm_cvtps_epi32(_mm_loadu_ps(src + x + 4));
+            const __m128i words = _mm_packs_epi32(lo, hi);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(words, words));
+        }
+    }
+
+    for(; x < count; ++x)
+    {
+        const int value = static_cast<int>(src[x] + 0.5f);
+        dst[x * step] = static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+    }
+}
+
+// dst[c][x] = a + (b - a) * weight of channel c of the pixels at the two offsets of each column
+template<uint32_t CHANNELS>
+void resample_row(const uint8_t* src, const uint32_t* i0, const uint32_t* i1, const float* weight, float* const* dst, const uint32_t& count)
+{
+    uint32_t x = 0;
+    for(; x + 4 <= count; x += 4)
+    {
+        const uint8_t* a[4] = {src + i0[x], src + i0[x + 1], src + i0[x + 2], src + i0[x + 3]};
+        const uint8_t* b[4] = {src + i1[x], src + i1[x + 1], src + i1[x + 2], src + i1[x + 3]};
+        const __m128 w = _mm_loadu_ps(weight + x);
+        for(uint32_t c = 0; c < CHANNELS; ++c)
+        {
+            const __m128 va = _mm_cvtepi32_ps(_mm_setr_epi32(a[0][c], a[1][c], a[2][c], a[3][c]));
+            const __m128 vb = _mm_cvtepi32_ps(_mm_setr_epi32(b[0][c], b[1][c], b[2][c], b[3][c]));
+            _mm_storeu_ps(dst[c] + x, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), w)));
+        }
+    }
+
+    for(; x < count; ++x)
+    {
+        for(uint32_t c = 0; c < CHANNELS; ++c)
+        {
+            const float a = src[i0[x] + c];
+            dst[c][x] = a + (src[i1[x] + c] - a) * weight[x];
+        }
+    }
+}
+
+// dst[x] = a[x] + (b[x] - a[x]) * weight
+void blend_rows(const float* a, const float* b, const float& weight, float* dst, const uint32_t& count)
+{
+    const __m128 w = _mm_set1_ps(weight);
+    uint32_t x = 0;
+    for(; x + 4 <= count; x += 4)
+    {
+        const __m128 va = _mm_loadu_ps(a + x);
+        _mm_storeu_ps(dst + x, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + x), va), w)));
+    }
+
+    for(; x < count; ++x)
+    {
+        dst[x] = a[x] + (b[x] - a[x]) * weight;
+    }
+}
+
+__m128 clamp_channel(const __m128& value)
+{
+    return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+}
+
+float clamp_channel(const float& value)
+{
+    return std::min(std::max(value, 0.0f), 255.0f);
+}
+
+}
+
+TensorWriter::TensorWriter()
+    : m_element_size(0)
+    , m_scale{1.0f, 1.0f, 1.0f}
+    , m_bias{0.0f, 0.0f, 0.0f}
+    , m_coefficients()
+    , m_src_width(0)
+    , m_src_height(0)
+    , m_src_encoding(Encoding::UNKNOWN)
+{
+}
+
+TensorWriter::Line::Line()
+    : row(UINT32_MAX)
+{
+}
+
+TensorWriter::~TensorWriter()
+{
+}
+
+bool TensorWriter::init(const TensorDesc& desc)
+{
+    m_element_size = element_size(desc.type);
+    if(desc.width == 0 || desc.height == 0 || m_element_size == 0)
+    {
+        return false;
+    }
+
+    for(uint32_t c = 0; c < 3; ++c)
+    {
+        if(desc.std[c] == 0.0f)
+        {
+            return false;
+        }
+
+        // ((x / 255) - mean) / std folded into x * scale + bias
+        m_scale[c] = 1.0f / (255.0f * desc.std[c]);
+        m_bias[c] = -desc.mean[c] / desc.std[c];
+        m_row[c].resize(desc.width);
+        for(uint32_t i = 0; i < 2; ++i)
+        {
+            m_lines[i].values[c].resize(desc.width);
+            m_chroma_lines[i].values[c].resize(desc.width);
+        }
+    }
+
+    m_desc = desc;
+    m_src_width = 0;
+    m_src_height = 0;
+    m_src_encoding = Encoding::UNKNOWN;
+    return true;
+}
+
+size_t TensorWriter::size() const
+{
+    return static_cast<size_t>(m_desc.width) * m_desc.height * 3 * m_element_size;
+}
+
+bool TensorWriter::write(const FrameLevel& frame, void* tensor, const uint32_t& batch_index)
+{
+    if(!frame.data || !tensor || frame.width == 0 || frame.height == 0)
+    {
+        return false;
+    }
+
+    const bool i420 = frame.encoding == Encoding::I420;
+    if(!i420 && frame.encoding != Encoding::RGB24 && frame.encoding != Encoding::RGBA32)
+    {
+        return false;
+    }
+
+    if(frame.width != m_src_width || frame.height != m_src_height || frame.encoding != m_src_encoding)
+    {
+        // Odd sizes leave the last luma row and column without chroma, as in FrameLayout,
+        // I420 needs a chroma sample in each direction
+        m_src_width = 0;
+        if(!m_layout.init(frame.width, frame.height, frame.encoding) || (i420 && (frame.width < 2 || frame.height < 2)))
+        {
+            return false;
+        }
+
+        const FrameLayout::Plane& plane = m_layout.plane(0);
+        build_taps(m_y_taps, frame.height, frame.height, m_desc.height, 1);
+        build_columns(m_x_columns, frame.width, frame.width, plane.step, 1);
+        if(i420)
+        {
+            const FrameLayout::Plane& chroma = m_layout.plane(1);
+            build_taps(m_chroma_y_taps, frame.height, chroma.height, m_desc.height, 2);
+            build_columns(m_chroma_x_columns, frame.width, chroma.width, 1, 2);
+        }
+
+        m_src_width = frame.width;
+        m_src_height = frame.height;
+        m_src_encoding = frame.encoding;
+    }
+
+    if(frame.size < m_layout.size())
+    {
+        return false;
+    }
+
+    if(i420)
+    {
+        build_coefficients(frame.color);
+    }
+
+    // Lines of the frame before are stale
+    for(uint32_t i = 0; i < 2; ++i)
+    {
+        m_lines[i].row = UINT32_MAX;
+        m_chroma_lines[i].row = UINT32_MAX;
+    }
+
+    uint8_t* item = static_cast<uint8_t*>(tensor) + size() * batch_index;
+    for(uint32_t y = 0; y < m_desc.height; ++y)
+    {
+        if(i420)
+        {
+            sample_i420_row(frame, y);
+        }
+        else
+        {
+            sample_rgb_row(frame, y);
+        }
+
+        store_row(item, y);
+    }
+
+    return true;
+}
+
+bool TensorWriter::write(const std::vector<IBuffer*>& buffers, void* tensor)
+{
+    for(uint32_t i = 0; i < buffers.size(); ++i)
+    {
+        if(!buffers[i] || !buffers[i]->lock())
+        {
+            return false;
+        }
+
+        const bool written = write(buffers[i]->level(0), tensor, i);
+        buffers[i]->unlock();
+        if(!written)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TensorWriter::build_taps(std::vector<Tap>& taps, const uint32_t& extent, const uint32_t& samples, const uint32_t& dst, const uint32_t& subsampling) const
+{
+    // Pixel centers are aligned, as in most training pipelines. Subsampled planes have
+    // one sample per 'subsampling' source pixels, centered on them.
+    taps.resize(dst);
+    const float ratio = static_cast<float>(extent) / (static_cast<float>(dst) * subsampling);
+    for(uint32_t i = 0; i < dst; ++i)
+    {
+        const float position = std::max((i + 0.5f) * ratio - 0.5f, 0.0f);
+        const uint32_t i0 = std::min(static_cast<uint32_t>(position), samples - 1);
+        taps[i].i0 = i0;
+        taps[i].i1 = std::min(i0 + 1, samples - 1);
+        taps[i].weight = position - i0;
+    }
+}
+
+void TensorWriter::build_columns(Columns& columns, const uint32_t& extent, const uint32_t& samples, const uint32_t& step, const uint32_t& subsampling) const
+{
+    std::vector<Tap> taps;
+    build_taps(taps, extent, samples, m_desc.width, subsampling);
+
+    columns.i0.resize(taps.size());
+    columns.i1.resize(taps.size());
+    columns.weight.resize(taps.size());
+    for(size_t i = 0; i < taps.size(); ++i)
+    {
+        columns.i0[i] = taps[i].i0 * step;
+        columns.i1[i] = taps[i].i1 * step;
+        columns.weight[i] = taps[i].weight;
+    }
+}
+
+void TensorWriter::build_coefficients(const ColorSpace& color)
+{
+    // ColorMatrix::DEFAULT is BT.601, as in the color kernels
+    float kr = 0.299f;
+    float kb = 0.114f;
+    if(color.matrix == ColorMatrix::BT709)
+    {
+        kr = 0.2126f;
+        kb = 0.0722f;
+    }
+    else if(color.matrix == ColorMatrix::BT2020)
+    {
+        kr = 0.2627f;
+        kb = 0.0593f;
+    }
+
+    const float kg = 1.0f - kr - kb;
+    const bool full = color.range == ColorRange::FULL;
+    const float c_scale = full ? 1.0f : 255.0f / 224.0f;
+
+    m_coefficients.y_offset = full ? 0.0f : 16.0f;
+    m_coefficients.y_scale = full ? 1.0f : 255.0f / 219.0f;
+    m_coefficients.rv = 2.0f * (1.0f - kr) * c_scale;
+    m_coefficients.gu = -2.0f * (1.0f - kb) * kb / kg * c_scale;
+    m_coefficients.gv = -2.0f * (1.0f - kr) * kr / kg * c_scale;
+    m_coefficients.bu = 2.0f * (1.0f - kb) * c_scale;
+}
+
+void TensorWriter::fetch_lines(
+    Line* lines,
+    const Tap& tap,
+    const uint8_t* const* planes,
+    const uint32_t& plane_count,
+    const ptrdiff_t& pitch,
+    const uint32_t& channels,
+    const Columns& columns) const
+{
+    // Output rows mostly move on by less than a source row, the second line of one is
+    // the first of the next
+    if(lines[0].row != tap.i0 && lines[1].row == tap.i0)
+    {
+        std::swap(lines[0], lines[1]);
+    }
+
+    const uint32_t rows[2] = {tap.i0, tap.i1};
+    for(uint32_t i = 0; i < 2; ++i)
+    {
+        Line& line = lines[i];
+        if(line.row == rows[i])
+        {
+            continue;
+        }
+
+        for(uint32_t p = 0; p < plane_count; ++p)
+        {
+            const uint8_t* row = planes[p] + pitch * static_cast<ptrdiff_t>(rows[i]);
+            float* values[3] = {line.values[p].data(), line.values[1].data(), line.values[2].data()};
+            if(channels == 3)
+            {
+                resample_row<3>(row, columns.i0.data(), columns.i1.data(), columns.weight.data(), values, m_desc.width);
+            }
+            else
+            {
+                resample_row<1>(row, columns.i0.data(), columns.i1.data(), columns.weight.data(), values, m_desc.width);
+            }
+        }
+        line.row = rows[i];
+    }
+}
+
+void TensorWriter::sample_rgb_row(const FrameLevel& frame, const uint32_t& row)
+{
+    // RGB frames are stored bottom-up unless the stream asked otherwise
+    const FrameLayout::Plane& plane = m_layout.plane(0);
+    const uint8_t* data = static_cast<const uint8_t*>(frame.data);
+    const uint8_t* top = frame.top_down ? data : data + static_cast<size_t>(plane.stride) * (frame.height - 1);
+    const ptrdiff_t pitch = frame.top_down ? plane.stride : -static_cast<ptrdiff_t>(plane.stride);
+
+    const Tap& ty = m_y_taps[row];
+    fetch_lines(m_lines, ty, &top, 1, pitch, 3, m_x_columns);
+
+    // Source is BGR
+    for(uint32_t c = 0; c < 3; ++c)
+    {
+        const uint32_t out = m_desc.order == ChannelOrder::RGB ? 2 - c : c;
+        blend_rows(m_lines[0].values[c].data(), m_lines[1].values[c].data(), ty.weight, m_row[out].data(), m_desc.width);
+    }
+}
+
+void TensorWriter::sample_i420_row(const FrameLevel& frame, const uint32_t& row)
+{
+    const uint8_t* data = static_cast<const uint8_t*>(frame.data);
+    const FrameLayout::Plane& luma = m_layout.plane(0);
+    const FrameLayout::Plane& chroma = m_layout.plane(1);
+    const uint8_t* chroma_planes[2] = {data + chroma.offset, data + m_layout.plane(2).offset};
+
+    const Tap& ty = m_y_taps[row];
+    const Tap& tc = m_chroma_y_taps[row];
+    fetch_lines(m_lines, ty, &data, 1, luma.stride, 1, m_x_columns);
+    fetch_lines(m_chroma_lines, tc, chroma_planes, 2, chroma.stride, 1, m_chroma_x_columns);
+
+    const float* y0 = m_lines[0].values[0].data();
+    const float* y1 = m_lines[1].values[0].data();
+    const float* u0 = m_chroma_lines[0].values[0].data();
+    const float* u1 = m_chroma_lines[1].values[0].data();
+    const float* v0 = m_chroma_lines[0].values[1].data();
+    const float* v1 = m_chroma_lines[1].values[1].data();
+
+    float* r = m_row[0].data();
+    float* b = m_row[2].data();
+    if(m_desc.order == ChannelOrder::BGR)
+    {
+        std::swap(r, b);
+    }
+    float* g = m_row[1].data();
+
+    // Matrix and range of the stream, see StreamOptions::color
+    const Coefficients& k = m_coefficients;
+    const __m128 wy = _mm_set1_ps(ty.weight);
+    const __m128 wc = _mm_set1_ps(tc.weight);
+    const __m128 y_offset = _mm_set1_ps(k.y_offset);
+    const __m128 y_scale = _mm_set1_ps(k.y_scale);
+    const __m128 neutral = _mm_set1_ps(128.0f);
+    const __m128 rv = _mm_set1_ps(k.rv);
+    const __m128 gu = _mm_set1_ps(k.gu);
+    const __m128 gv = _mm_set1_ps(k.gv);
+    const __m128 bu = _mm_set1_ps(k.bu);
+
+    auto blend = [](const float* a, const float* b, const __m128& w)
+    {
+        const __m128 va = _mm_loadu_ps(a);
+        return _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b), va), w));
+    };
+
+    uint32_t x = 0;
+    for(; x + 4 <= m_desc.width; x += 4)
+    {
+        const __m128 yv = _mm_mul_ps(_mm_sub_ps(blend(y0 + x, y1 + x, wy), y_offset), y_scale);
+        const __m128 cb = _mm_sub_ps(blend(u0 + x, u1 + x, wc), neutral);
+        const __m128 cr = _mm_sub_ps(blend(v0 + x, v1 + x, wc), neutral);
+        _mm_storeu_ps(r + x, clamp_channel(_mm_add_ps(yv, _mm_mul_ps(cr, rv))));
+        _mm_storeu_ps(g + x, clamp_channel(_mm_add_ps(yv, _mm_add_ps(_mm_mul_ps(cb, gu), _mm_mul_ps(cr, gv)))));
+        _mm_storeu_ps(b + x, clamp_channel(_mm_add_ps(yv, _mm_mul_ps(cb, bu))));
+    }
+
+    for(; x < m_desc.width; ++x)
+    {
+        const float yv = (y0[x] + (y1[x] - y0[x]) * ty.weight - k.y_offset) * k.y_scale;
+        const float cb = u0[x] + (u1[x] - u0[x]) * tc.weight - 128.0f;
+        const float cr = v0[x] + (v1[x] - v0[x]) * tc.weight - 128.0f;
+        r[x] = clamp_channel(yv + cr * k.rv);
+        g[x] = clamp_channel(yv + cb * k.gu + cr * k.gv);
+        b[x] = clamp_channel(yv + cb * k.bu);
+    }
+}
+
+void TensorWriter::store_row(uint8_t* tensor, const uint32_t& row) const
+{
+    const size_t plane = static_cast<size_t>(m_desc.width) * m_desc.height;
+    for(uint32_t c = 0; c < 3; ++c)
+    {
+        // Element offset and distance between consecutive pixels of this channel
+        size_t offset;
+        uint32_t step;
+        if(m_desc.layout == TensorLayout::NCHW)
+        {
+            offset = c * plane + static_cast<size_t>(row) * m_desc.width;
+            step = 1;
+        }
+        else
+        {
+            offset = static_cast<size_t>(row) * m_desc.width * 3 + c;
+            step = 3;
+        }
+
+        uint8_t* dst = tensor + offset * m_element_size;
+        switch(m_desc.type)
+        {
+        case TensorType::UINT8:
+            store_u8(m_row[c].data(), dst, m_desc.width, step);
+            break;
+        case TensorType::FLOAT16:
+            store_f16(m_row[c].data(), reinterpret_cast<uint16_t*>(dst), m_desc.width, step, m_scale[c], m_bias[c]);
+            break;
+        case TensorType::FLOAT32:
+            store_f32(m_row[c].data(), reinterpret_cast<float*>(dst), m_desc.width, step, m_scale[c], m_bias[c]);
+            break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,127 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "FrameLayout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace cdi {
+
+// Resize, color conversion, channel order, normalization and layout conversion in
+// one pass over the output rows. Source rows are resampled horizontally into float
+// lines once, each output row blends two of them (and converts the color) into a
+// small planar float row which is then normalized and stored.
+class TensorWriter : public ITensorWriter
+{
+public:
+    TensorWriter();
+    ~TensorWriter();
+
+    bool init(const TensorDesc& desc);
+    size_t size() const final;
+    bool write(const FrameLevel& frame, void* tensor, const uint32_t& batch_index) final;
+    bool write(const std::vector<IBuffer*>& buffers, void* tensor) final;
+
+private:
+    struct Tap
+    {
+        uint32_t i0;
+        uint32_t i1;
+        float weight; // Of i1
+    };
+
+    // Horizontal taps as separate arrays for the vector loops
+    struct Columns
+    {
+        std::vector<uint32_t> i0; // Byte offsets of the two source samples in a row
+        std::vector<uint32_t> i1;
+        std::vector<float> weight;
+    };
+
+    // One source row resampled to the output width, per source channel
+    struct Line
+    {
+        Line();
+        uint32_t row;
+        std::vector<float> values[3];
+    };
+
+    // YUV to RGB of the frame's ColorSpace
+    struct Coefficients
+    {
+        float y_offset;
+        float y_scale;
+        float rv;
+        float gu;
+        float gv;
+        float bu;
+    };
+
+    void build_taps(std::vector<Tap>& taps, const uint32_t& extent, const uint32_t& samples, const uint32_t& dst, const uint32_t& subsampling) const;
+    void build_columns(Columns& columns, const uint32_t& extent, const uint32_t& samples, const uint32_t& step, const uint32_t& subsampling) const;
+    void build_coefficients(const ColorSpace& color);
+    void fetch_lines(Line* lines, const Tap& tap, const uint8_t* const* planes, const uint32_t& plane_count, const ptrdiff_t& pitch, const uint32_t& channels, const Columns& columns) const;
+    void sample_rgb_row(const FrameLevel& frame, const uint32_t& row);
+    void sample_i420_row(const FrameLevel& frame, const uint32_t& row);
+    void store_row(uint8_t* tensor, const uint32_t& row) const;
+
+private:
+    TensorDesc m_desc;
+    uint32_t m_element_size;
+    float m_scale[3];
+    float m_bias[3];
+    Coefficients m_coefficients;
+
+    // Taps are rebuilt when the source size or encoding changes
+    uint32_t m_src_width;
+    uint32_t m_src_height;
+    Encoding m_src_encoding;
+    FrameLayout m_layout;
+    std::vector<Tap> m_y_taps;
+    std::vector<Tap> m_chroma_y_taps;
+    Columns m_x_columns;
+    Columns m_chroma_x_columns;
+
+    // The two source rows of the current output row, luma (or RGB) and chroma
+    Line m_lines[2];
+    Line m_chroma_lines[2];
+
+    // One output row per channel, already in output channel order
+    std::vector<float> m_row[3];
+};
+
+}
@@ -0,0 +1,185 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "ThreadPlacer.h"
+
+#include <windows.h>
+#include <psapi.h>
+
+
+namespace cdi {
+
+namespace {
+
+std::mutex g_process_mutex;
+ThreadPolicy g_process_policy;
+
+int system_priority(const ThreadPriority& priority)
+{
+    switch(priority)
+    {
+    case ThreadPriority::LOW:
+        return THREAD_PRIORITY_BELOW_NORMAL;
+    case ThreadPriority::HIGH:
+        return THREAD_PRIORITY_HIGHEST;
+    case ThreadPriority::CRITICAL:
+        return THREAD_PRIORITY_TIME_CRITICAL;
+    default:
+        return THREAD_PRIORITY_NORMAL;
+    }
+}
+
+}
+
+void set_thread_policy(const ThreadPolicy& policy)
+{
+    std::lock_guard<std::mutex> lock(g_process_mutex);
+    g_process_policy = policy;
+}
+
+ThreadPolicy get_thread_policy()
+{
+    std::lock_guard<std::mutex> lock(g_process_mutex);
+    return g_process_policy;
+}
+
+int32_t current_numa_node()
+{
+    PROCESSOR_NUMBER processor = {};
+    GetCurrentProcessorNumberEx(&processor);
+
+    USHORT node = 0;
+    if(!GetNumaProcessorNodeEx(&processor, &node) || node == 0xFFFF)
+    {
+        return -1;
+    }
+
+    return static_cast<int32_t>(node);
+}
+
+int32_t memory_numa_node(const void* address)
+{
+    if(address == nullptr)
+    {
+        return -1;
+    }
+
+    PSAPI_WORKING_SET_EX_INFORMATION info = {};
+    info.VirtualAddress = const_cast<void*>(address);
+    if(!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) || !info.VirtualAttributes.Valid)
+    {
+        return -1;
+    }
+
+    return static_cast<int32_t>(info.VirtualAttributes.Node);
+}
+
+ThreadPlacer::ThreadPlacer(const ThreadPolicy& policy)
+    : m_policy(policy.enabled ? policy : get_thread_policy())
+    , m_memory_node(-1)
+{
+    if(m_policy.enabled)
+    {
+        if(m_policy.memory == MemoryPlacement::OPENING_THREAD)
+        {
+            m_memory_node = current_numa_node();
+        }
+        else if(m_policy.memory == MemoryPlacement::NODE)
+        {
+            m_memory_node = static_cast<int32_t>(m_policy.numa_node);
+        }
+    }
+}
+
+bool ThreadPlacer::place()
+{
+    if(!m_policy.enabled)
+    {
+        return true;
+    }
+
+    const bool result = apply(m_policy);
+
+    // Read back, the system may have narrowed the request
+    GROUP_AFFINITY affinity = {};
+    GetThreadGroupAffinity(GetCurrentThread(), &affinity);
+    const int priority = GetThreadPriority(GetCurrentThread());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_placement.threads++;
+    m_placement.failed += result ? 0 : 1;
+    m_placement.cpu_mask = static_cast<uint64_t>(affinity.Mask);
+    m_placement.cpu_group = affinity.Group;
+    m_placement.priority = priority;
+
+    return result;
+}
+
+int32_t ThreadPlacer::memory_node() const
+{
+    return m_memory_node;
+}
+
+ThreadPlacement ThreadPlacer::placement() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_placement;
+}
+
+bool ThreadPlacer::apply(const ThreadPolicy& policy)
+{
+    if(!policy.enabled)
+    {
+        return true;
+    }
+
+    bool result = true;
+
+    if(policy.cpu_mask != 0)
+    {
+        GROUP_AFFINITY affinity = {};
+        affinity.Mask = static_cast<KAFFINITY>(policy.cpu_mask);
+        affinity.Group = policy.cpu_group;
+        result = SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE && result;
+    }
+
+    // Time critical needs the process to allow it, refused otherwise
+    if(policy.priority != ThreadPriority::DEFAULT)
+    {
+        result = SetThreadPriority(GetCurrentThread(), system_priority(policy.priority)) != FALSE && result;
+    }
+
+    return result;
+}
+
+}
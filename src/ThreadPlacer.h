@@ -0,0 +1,76 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+#include <cstdint>
+#include <mutex>
+
+
+namespace cdi {
+
+// NUMA node of the processor the calling thread runs on, -1 when unknown
+int32_t current_numa_node();
+
+// NUMA node of the physical page behind 'address', -1 when it is not resident
+int32_t memory_numa_node(const void* address);
+
+// Applies a policy to the threads which call place() and keeps what they ended up with. The
+// memory node of MemoryPlacement::OPENING_THREAD is the one of the thread creating the placer.
+class ThreadPlacer
+{
+    ThreadPlacer(const ThreadPlacer&);
+    ThreadPlacer& operator=(const ThreadPlacer&);
+
+public:
+    explicit ThreadPlacer(const ThreadPolicy& policy);
+
+    // Calling thread, false when the system refused a part of the policy
+    bool place();
+    // Node for frame memory, -1 for the default placement
+    int32_t memory_node() const;
+    // Threads so far, the memory node is up to the caller
+    ThreadPlacement placement() const;
+
+    // Without a record, for threads outside of a stream
+    static bool apply(const ThreadPolicy& policy);
+
+private:
+    ThreadPolicy m_policy;
+    int32_t m_memory_node;
+
+    mutable std::mutex m_mutex;
+    ThreadPlacement m_placement;
+};
+
+}
@@ -0,0 +1,333 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <windows.h>
+
+
+namespace cdi {
+namespace trace {
+
+std::atomic<bool> g_enabled(false);
+
+namespace {
+
+const char* const NAMES[] =
+{
+    "ReadSample",
+    "WaitFrame",
+    "Inspect",
+    "Convert",
+    "lock",
+    "unlock",
+    "read_into",
+    "snapshot_jpeg",
+    "dump",
+};
+
+struct Record
+{
+    int64_t start;
+    int64_t duration;
+    uint64_t sequence;
+    uint32_t stream;
+    Name name;
+};
+
+// Written by its thread only, read by dump_trace(). The head is published after the record,
+// a reader drops whatever the writer may have overwritten while it copied. One slot more than
+// the events kept, the writer may be past the head on the slot of the next record already.
+struct Ring
+{
+    Ring(const uint32_t& capacity, const uint64_t& generation)
+        : records(static_cast<size_t>(capacity) + 1), head(0), thread_id(GetCurrentThreadId()), generation(generation) {}
+    std::vector<Record> records;
+    std::atomic<uint64_t> head;
+    DWORD thread_id;
+    uint64_t generation;
+};
+
+struct Registry
+{
+    Registry() : capacity(0), generation(0) {}
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::vector<std::wstring> streams;
+    uint32_t capacity;
+    uint64_t generation;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+struct ThreadState
+{
+    ThreadState() : stream(0), sequence(0) {}
+    std::shared_ptr<Ring> ring;
+    uint32_t stream;
+    uint64_t sequence;
+};
+
+thread_local ThreadState t_state;
+
+Ring* thread_ring()
+{
+    Registry& reg = registry();
+
+    // Rings are replaced when tracing restarts, the registry keeps the ones of ended threads
+    std::shared_ptr<Ring>& ring = t_state.ring;
+    if(!ring || ring->generation != reg.generation)
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if(reg.capacity == 0)
+        {
+            return nullptr;
+        }
+
+        ring = std::make_shared<Ring>(reg.capacity, reg.generation);
+        reg.rings.push_back(ring);
+    }
+
+    return ring.get();
+}
+
+void append_escaped(std::string& out, const std::wstring& text)
+{
+    for(const wchar_t c : text)
+    {
+        if(c == L'"' || c == L'\\')
+        {
+            out += '\\';
+            out += static_cast<char>(c);
+        }
+        else if(c < 0x20 || c > 0x7E)
+        {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c) & 0xFFFF);
+            out += code;
+        }
+        else
+        {
+            out += static_cast<char>(c);
+        }
+    }
+}
+
+}
+
+uint32_t register_stream(const std::wstring& name)
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.streams.push_back(name);
+    return static_cast<uint32_t>(reg.streams.size());
+}
+
+void set_frame(const uint32_t& stream, const uint64_t& sequence)
+{
+    t_state.stream = stream;
+    t_state.sequence = sequence;
+}
+
+void record(const Name& name, const int64_t& start, const int64_t& end, const uint32_t& stream, const uint64_t& sequence)
+{
+    Ring* ring = thread_ring();
+    if(ring == nullptr)
+    {
+        return;
+    }
+
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Record& entry = ring->records[head % ring->records.size()];
+    entry.start = start;
+    entry.duration = end - start;
+    entry.sequence = sequence;
+    entry.stream = stream;
+    entry.name = name;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+Scope::Scope(const Name& name)
+    : m_name(name)
+    , m_start(0)
+    , m_stream(0)
+    , m_sequence(0)
+    , m_context(true)
+{
+    if(enabled())
+    {
+        m_start = clock_now();
+    }
+}
+
+Scope::Scope(const Name& name, const uint32_t& stream, const uint64_t& sequence)
+    : m_name(name)
+    , m_start(0)
+    , m_stream(stream)
+    , m_sequence(sequence)
+    , m_context(false)
+{
+    if(enabled())
+    {
+        m_start = clock_now();
+    }
+}
+
+Scope::~Scope()
+{
+    if(m_start == 0 || !enabled())
+    {
+        return;
+    }
+
+    if(m_context)
+    {
+        m_stream = t_state.stream;
+        m_sequence = t_state.sequence;
+    }
+
+    record(m_name, m_start, clock_now(), m_stream, m_sequence);
+}
+
+void Scope::set_sequence(const uint64_t& sequence)
+{
+    m_sequence = sequence;
+    m_context = false;
+}
+
+}
+
+void start_trace(const uint32_t& events_per_thread)
+{
+    trace::Registry& reg = trace::registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.clear();
+        reg.capacity = std::max(events_per_thread, 1u);
+        reg.generation++;
+    }
+
+    trace::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+void stop_trace()
+{
+    trace::g_enabled.store(false, std::memory_order_relaxed);
+}
+
+std::string dump_trace()
+{
+    trace::Registry& reg = trace::registry();
+
+    std::vector<std::shared_ptr<trace::Ring>> rings;
+    std::vector<std::wstring> streams;
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        rings = reg.rings;
+        streams = reg.streams;
+    }
+
+    std::string out("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    char line[256];
+
+    for(const std::shared_ptr<trace::Ring>& ring : rings)
+    {
+        const uint64_t slots = ring->records.size();
+        const uint64_t capacity = slots - 1;
+
+        // Copy, then keep what the writer cannot have touched meanwhile
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t begin = head > capacity ? head - capacity : 0;
+        std::vector<trace::Record> records;
+        records.reserve(static_cast<size_t>(head - begin));
+        for(uint64_t i = begin; i < head; i++)
+        {
+            records.push_back(ring->records[i % slots]);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t after = ring->head.load(std::memory_order_relaxed);
+        const uint64_t valid = after > capacity ? after - capacity : 0;
+        const size_t skip = static_cast<size_t>(std::min(std::max(valid, begin) - begin, head - begin));
+
+        std::snprintf(line, sizeof(line),
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"thread %lu\"}}",
+            first ? "" : ",",
+            static_cast<unsigned long>(ring->thread_id),
+            static_cast<unsigned long>(ring->thread_id));
+        out += line;
+        first = false;
+
+        for(size_t i = skip; i < records.size(); i++)
+        {
+            const trace::Record& record = records[i];
+            const uint32_t name = static_cast<uint32_t>(record.name);
+            if(name >= static_cast<uint32_t>(trace::Name::COUNT))
+            {
+                continue;
+            }
+
+            // Microseconds with the 100ns resolution of the clock
+            std::snprintf(line, sizeof(line),
+                ",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%lld.%lld,\"dur\":%lld.%lld,"
+                "\"args\":{\"stream\":%lu,\"frame\":%llu,\"device\":\"",
+                trace::NAMES[name],
+                static_cast<unsigned long>(ring->thread_id),
+                static_cast<long long>(record.start / 10), static_cast<long long>(record.start % 10),
+                static_cast<long long>(record.duration / 10), static_cast<long long>(record.duration % 10),
+                static_cast<unsigned long>(record.stream),
+                static_cast<unsigned long long>(record.sequence));
+            out += line;
+            if(record.stream > 0 && record.stream <= streams.size())
+            {
+                trace::append_escaped(out, streams[record.stream - 1]);
+            }
+            out += "\"}}";
+        }
+    }
+
+    out += "]}";
+    return out;
+}
+
+}
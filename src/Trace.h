@@ -0,0 +1,98 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+namespace cdi {
+namespace trace {
+
+enum class Name : uint32_t
+{
+    READ_SAMPLE, // Synchronous read from the device
+    WAIT_FRAME,  // Consumer waiting for a frame of an asynchronous stream
+    INSPECT,     // Change gate and statistics of an arrived frame
+    CONVERT,     // Color conversion or demosaic
+    LOCK,
+    UNLOCK,
+    READ_INTO,
+    SNAPSHOT,
+    DUMP,
+    COUNT,
+};
+
+extern std::atomic<bool> g_enabled;
+
+inline bool enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+// Stream id for the events of a device, the name shows up in the trace
+uint32_t register_stream(const std::wstring& name);
+
+// Frame the calling thread works on, picked up by scopes which do not know it themselves
+void set_frame(const uint32_t& stream, const uint64_t& sequence);
+
+// Appends a complete event to the ring of the calling thread, lock free
+void record(const Name& name, const int64_t& start, const int64_t& end, const uint32_t& stream, const uint64_t& sequence);
+
+// Complete event from construction to destruction, costs a relaxed load while tracing is off
+class Scope
+{
+    Scope(const Scope&);
+    Scope& operator=(const Scope&);
+
+public:
+    // Stream and frame of the calling thread, see set_frame()
+    explicit Scope(const Name& name);
+    Scope(const Name& name, const uint32_t& stream, const uint64_t& sequence);
+    ~Scope();
+
+    // The frame is often known only at the end
+    void set_sequence(const uint64_t& sequence);
+
+private:
+    Name m_name;
+    int64_t m_start;
+    uint32_t m_stream;
+    uint64_t m_sequence;
+    bool m_context;
+};
+
+}
+}
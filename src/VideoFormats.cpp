@@ -0,0 +1,160 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "VideoFormats.h"
+
+#include <mfapi.h>
+
+
+namespace cdi {
+
+namespace {
+
+struct BayerEntry
+{
+    const char* fourcc;
+    BayerPattern pattern;
+    uint32_t bits;
+    const char* name;
+};
+
+// FOURCCs used by machine vision drivers, following the V4L2 names
+const BayerEntry BAYER_FORMATS[] = {
+    {"RGGB", BayerPattern::RGGB, 8, "Bayer_RGGB8"},
+    {"BGGR", BayerPattern::BGGR, 8, "Bayer_BGGR8"},
+    {"GRBG", BayerPattern::GRBG, 8, "Bayer_GRBG8"},
+    {"GBRG", BayerPattern::GBRG, 8, "Bayer_GBRG8"},
+    {"BA81", BayerPattern::BGGR, 8, "Bayer_BGGR8"},
+    {"RG10", BayerPattern::RGGB, 10, "Bayer_RGGB10"},
+    {"BG10", BayerPattern::BGGR, 10, "Bayer_BGGR10"},
+    {"BA10", BayerPattern::GRBG, 10, "Bayer_GRBG10"},
+    {"GB10", BayerPattern::GBRG, 10, "Bayer_GBRG10"},
+    {"RG12", BayerPattern::RGGB, 12, "Bayer_RGGB12"},
+    {"BG12", BayerPattern::BGGR, 12, "Bayer_BGGR12"},
+    {"BA12", BayerPattern::GRBG, 12, "Bayer_GRBG12"},
+    {"GB12", BayerPattern::GBRG, 12, "Bayer_GBRG12"},
+    {"RG16", BayerPattern::RGGB, 16, "Bayer_RGGB16"},
+    {"BYR2", BayerPattern::BGGR, 16, "Bayer_BGGR16"},
+    {"GR16", BayerPattern::GRBG, 16, "Bayer_GRBG16"},
+    {"GB16", BayerPattern::GBRG, 16, "Bayer_GBRG16"},
+};
+
+const BayerEntry* find_bayer(const GUID& subtype)
+{
+    for(const BayerEntry& entry : BAYER_FORMATS)
+    {
+        if(subtype == fourcc_subtype(entry.fourcc))
+        {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+}
+
+GUID fourcc_subtype(const char* fourcc)
+{
+    // FOURCC subtypes share the tail of MFVideoFormat_Base
+    GUID subtype = MFVideoFormat_Base;
+    subtype.Data1 = static_cast<uint32_t>(static_cast<uint8_t>(fourcc[0]))
+        | (static_cast<uint32_t>(static_cast<uint8_t>(fourcc[1])) << 8)
+        | (static_cast<uint32_t>(static_cast<uint8_t>(fourcc[2])) << 16)
+        | (static_cast<uint32_t>(static_cast<uint8_t>(fourcc[3])) << 24);
+    return subtype;
+}
+
+bool wide_encoding(const GUID& subtype, Encoding& encoding)
+{
+    if(subtype == MFVideoFormat_P010)
+    {
+        encoding = Encoding::P010;
+    }
+    else if(subtype == MFVideoFormat_P016)
+    {
+        encoding = Encoding::P016;
+    }
+    else if(subtype == MFVideoFormat_Y210)
+    {
+        encoding = Encoding::Y210;
+    }
+    else if(subtype == MFVideoFormat_L16 || subtype == fourcc_subtype("Y16 "))
+    {
+        encoding = Encoding::GRAY16;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool compressed_subtype(const Encoding& encoding, GUID& subtype)
+{
+    if(encoding == Encoding::MJPEG)
+    {
+        subtype = MFVideoFormat_MJPG;
+    }
+    else if(encoding == Encoding::H264)
+    {
+        subtype = MFVideoFormat_H264;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool bayer_format(const GUID& subtype, BayerFormat& format)
+{
+    const BayerEntry* entry = find_bayer(subtype);
+    if(entry == nullptr)
+    {
+        return false;
+    }
+
+    format.pattern = entry->pattern;
+    format.bits = entry->bits;
+    return true;
+}
+
+const char* bayer_format_name(const GUID& subtype)
+{
+    const BayerEntry* entry = find_bayer(subtype);
+    return entry != nullptr ? entry->name : nullptr;
+}
+
+}
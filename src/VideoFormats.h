@@ -0,0 +1,70 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include <cstdint>
+
+#include <guiddef.h>
+
+
+namespace cdi {
+
+// Subtype of a FOURCC video format, for formats the SDK headers don't name
+GUID fourcc_subtype(const char* fourcc);
+
+// Encoding of a native high bit depth format, false for any other format
+bool wide_encoding(const GUID& subtype, Encoding& encoding);
+
+// Native format of a compressed encoding, false for any other encoding
+bool compressed_subtype(const Encoding& encoding, GUID& subtype);
+
+enum class BayerPattern
+{
+    RGGB, // Colors of the top left 2x2 block, row by row
+    BGGR,
+    GRBG,
+    GBRG,
+};
+
+struct BayerFormat
+{
+    BayerFormat() : pattern(BayerPattern::RGGB), bits(8) {}
+    BayerPattern pattern;
+    uint32_t bits; // 8 bit samples are bytes, wider ones low aligned 16 bit little endian
+};
+
+// Raw sensor formats, false for any other format
+bool bayer_format(const GUID& subtype, BayerFormat& format);
+const char* bayer_format_name(const GUID& subtype);
+
+}
@@ -0,0 +1,196 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define NOMINMAX
+#include "Watchdog.h"
+
+#include <algorithm>
+
+
+namespace cdi {
+
+namespace {
+
+const int64_t MILLISECOND = 10000;
+const int64_t DEFAULT_INTERVAL = 333333; // 30 fps
+
+}
+
+Watchdog::Watchdog()
+    : m_frame_interval(DEFAULT_INTERVAL)
+    , m_last_frame(0)
+    , m_last_attempt(0)
+    , m_recovery_start(0)
+    , m_errors(0)
+    , m_conversion_errors(0)
+{
+}
+
+void Watchdog::init(const WatchdogOptions& options, const int64_t& frame_interval, const int64_t& now)
+{
+    m_options = options;
+    m_frame_interval = options.frame_interval_ms != 0
+        ? options.frame_interval_ms * MILLISECOND
+        : (frame_interval > 0 ? frame_interval : DEFAULT_INTERVAL);
+    m_last_frame = now;
+    m_last_attempt = now;
+    m_recovery_start = 0;
+    m_errors = 0;
+    m_conversion_errors = 0;
+    m_statistics = RecoveryStatistics();
+}
+
+bool Watchdog::enabled() const
+{
+    return m_options.enabled;
+}
+
+void Watchdog::frame(const int64_t& now)
+{
+    m_last_frame = now;
+    m_errors = 0;
+
+    if(m_statistics.recovering)
+    {
+        const int64_t duration = now - m_recovery_start;
+        m_statistics.recovering = false;
+        m_statistics.recoveries++;
+        m_statistics.last = duration;
+        m_statistics.longest = std::max(m_statistics.longest, duration);
+        m_statistics.total += duration;
+    }
+}
+
+bool Watchdog::error()
+{
+    m_errors++;
+    return m_errors >= std::max(m_options.max_errors, 1u);
+}
+
+bool Watchdog::conversion_error()
+{
+    m_conversion_errors++;
+    return m_conversion_errors >= std::max(m_options.max_errors, 1u);
+}
+
+void Watchdog::converted()
+{
+    m_conversion_errors = 0;
+}
+
+void Watchdog::rearm(const int64_t& now)
+{
+    m_last_frame = now;
+    m_errors = 0;
+    m_conversion_errors = 0;
+}
+
+Watchdog::Action Watchdog::check(const int64_t& now, const bool& stopped)
+{
+    if(!m_options.enabled || m_statistics.gave_up)
+    {
+        return Action::NONE;
+    }
+
+    const bool stalled = now - m_last_frame >= stall_timeout();
+    const uint32_t max_errors = std::max(m_options.max_errors, 1u);
+    const bool failed = stopped || m_errors >= max_errors || m_conversion_errors >= max_errors;
+
+    if(!m_statistics.recovering)
+    {
+        if(!stalled && !failed)
+        {
+            return Action::NONE;
+        }
+
+        m_statistics.recovering = true;
+        m_recovery_start = now;
+        if(failed)
+        {
+            m_statistics.failures++;
+        }
+        else
+        {
+            m_statistics.stalls++;
+        }
+
+        return Action::RECOVER;
+    }
+
+    if(m_options.give_up_ms != 0 && now - m_recovery_start >= m_options.give_up_ms * MILLISECOND)
+    {
+        m_statistics.recovering = false;
+        m_statistics.gave_up = true;
+        return Action::GIVE_UP;
+    }
+
+    // The last rebuild did not bring frames back either
+    if((stalled || failed) && now - m_last_attempt >= m_options.retry_ms * MILLISECOND)
+    {
+        return Action::RECOVER;
+    }
+
+    return Action::NONE;
+}
+
+void Watchdog::attempted(const int64_t& now)
+{
+    m_last_attempt = now;
+    m_statistics.attempts++;
+}
+
+int64_t Watchdog::period() const
+{
+    return m_frame_interval;
+}
+
+int64_t Watchdog::stall_timeout() const
+{
+    return m_frame_interval * std::max(m_options.stall_intervals, 1u);
+}
+
+bool Watchdog::recovering() const
+{
+    return m_statistics.recovering;
+}
+
+bool Watchdog::gave_up() const
+{
+    return m_statistics.gave_up;
+}
+
+RecoveryStatistics Watchdog::statistics() const
+{
+    return m_statistics;
+}
+
+}
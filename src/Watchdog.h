@@ -0,0 +1,93 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+
+#include <cstdint>
+
+
+namespace cdi {
+
+// Decides when a stream needs to be rebuilt and keeps the recovery statistics. Fed with frame
+// arrivals, read errors and conversion results, polled with the time; not thread safe, the stream serializes it.
+class Watchdog
+{
+public:
+    enum class Action
+    {
+        NONE,
+        RECOVER, // Rebuild the reader now
+        GIVE_UP, // Recovery took too long, stop the stream
+    };
+
+    Watchdog();
+
+    // 'frame_interval' in clock_now() units, used unless the options set one
+    void init(const WatchdogOptions& options, const int64_t& frame_interval, const int64_t& now);
+    bool enabled() const;
+
+    // A frame arrived, completes a recovery
+    void frame(const int64_t& now);
+    // A read failed, true once too many failed in a row
+    bool error();
+    // A frame could not be converted, true once too many failed in a row. Arriving frames do
+    // not end the row, only a converted one does.
+    bool conversion_error();
+    void converted();
+    // The reader (re)started, it gets a full stall timeout for its first frame
+    void rearm(const int64_t& now);
+    // 'stopped' when the reader does not read anymore
+    Action check(const int64_t& now, const bool& stopped);
+    // A rebuild finished, frames may or may not follow
+    void attempted(const int64_t& now);
+
+    // How often check() should be called
+    int64_t period() const;
+    // Longest wait for a frame before the stall is noticed
+    int64_t stall_timeout() const;
+    bool recovering() const;
+    bool gave_up() const;
+    RecoveryStatistics statistics() const;
+
+private:
+    WatchdogOptions m_options;
+    int64_t m_frame_interval;
+    int64_t m_last_frame;
+    int64_t m_last_attempt;
+    int64_t m_recovery_start;
+    uint32_t m_errors;
+    uint32_t m_conversion_errors;
+    RecoveryStatistics m_statistics;
+};
+
+}
@@ -0,0 +1,646 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "WideKernels.h"
+
+#include <emmintrin.h>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+
+namespace cdi { namespace kernels {
+
+namespace {
+
+const uint8_t* row_at(const uint8_t* plane, const int32_t& pitch, const uint32_t& row)
+{
+    return plane + static_cast<ptrdiff_t>(pitch) * row;
+}
+
+uint8_t* row_at(uint8_t* plane, const int32_t& pitch, const uint32_t& row)
+{
+    return plane + static_cast<ptrdiff_t>(pitch) * row;
+}
+
+void copy_rows(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const size_t& bytes,
+    const uint32_t& rows)
+{
+    for(uint32_t row = 0; row < rows; row++)
+    {
+        std::memcpy(row_at(dst, dst_pitch, row), row_at(src, src_pitch, row), bytes);
+    }
+}
+
+// Y210 rows are 32 bit lanes of Y | C << 16, C alternating U and V. Splits one row into
+// its luma samples and the interleaved UV pairs, as in a P010 chroma row.
+void split_y210_row(const uint8_t* src, uint16_t* luma, uint16_t* chroma, const uint32_t& width)
+{
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src);
+    uint32_t x = 0;
+
+    // Sign extension before packing keeps the 16 bit patterns intact
+    for(; x + 8 <= width; x += 8)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x * 2));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x * 2 + 8));
+        const __m128i ya = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        const __m128i yb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(luma + x), _mm_packs_epi32(ya, yb));
+        if(chroma != nullptr)
+        {
+            const __m128i ca = _mm_srai_epi32(a, 16);
+            const __m128i cb = _mm_srai_epi32(b, 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(chroma + x), _mm_packs_epi32(ca, cb));
+        }
+    }
+
+    for(; x < width; x++)
+    {
+        luma[x] = in[x * 2];
+        if(chroma != nullptr)
+        {
+            chroma[x] = in[x * 2 + 1];
+        }
+    }
+}
+
+// Rounded average of two chroma rows
+void average_row(const uint16_t* a, const uint16_t* b, uint16_t* dst, const uint32_t& samples)
+{
+    uint32_t x = 0;
+    for(; x + 8 <= samples; x += 8)
+    {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_avg_epu16(va, vb));
+    }
+
+    for(; x < samples; x++)
+    {
+        dst[x] = static_cast<uint16_t>((a[x] + b[x] + 1) >> 1);
+    }
+}
+
+// The curve in SSE2 registers
+struct ToneVectors
+{
+    explicit ToneVectors(const ToneCurve& curve)
+        : black(_mm_set1_epi16(static_cast<short>(curve.black)))
+        , range(_mm_set1_epi16(static_cast<short>(curve.range)))
+        , scale(_mm_set1_epi16(static_cast<short>(curve.scale)))
+        , shift(_mm_cvtsi32_si128(curve.shift))
+    {
+    }
+
+    __m128i black;
+    __m128i range;
+    __m128i scale;
+    __m128i shift;
+};
+
+// Values from 0 to the range onto 0..255 in 16 bit lanes, rounded
+__m128i scale_range(const __m128i& value, const ToneVectors& tone)
+{
+    const __m128i v = _mm_sub_epi16(value, _mm_subs_epu16(value, tone.range));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mulhi_epu16(_mm_sll_epi16(v, tone.shift), tone.scale), _mm_set1_epi16(64)), 7);
+}
+
+uint32_t scale_range(const uint32_t& value, const ToneCurve& curve)
+{
+    const uint32_t v = (value < curve.range ? value : curve.range) << curve.shift;
+    return (((v * curve.scale) >> 16) + 64) >> 7;
+}
+
+__m128i tone_map_luma(const __m128i& luma, const ToneVectors& tone)
+{
+    return scale_range(_mm_subs_epu16(luma, tone.black), tone);
+}
+
+// 128 and the scaled distance from 0x8000, in 16 bit lanes for the saturating pack
+__m128i tone_map_chroma(const __m128i& chroma, const ToneVectors& tone)
+{
+    const __m128i distance = _mm_xor_si128(chroma, _mm_set1_epi16(static_cast<short>(0x8000)));
+    const __m128i sign = _mm_srai_epi16(distance, 15);
+    const __m128i scaled = scale_range(_mm_sub_epi16(_mm_xor_si128(distance, sign), sign), tone);
+    return _mm_add_epi16(_mm_set1_epi16(128), _mm_sub_epi16(_mm_xor_si128(scaled, sign), sign));
+}
+
+uint8_t tone_map_chroma(const uint16_t& chroma, const ToneCurve& curve)
+{
+    const int32_t distance = static_cast<int32_t>(chroma) - 0x8000;
+    const int32_t scaled = static_cast<int32_t>(scale_range(static_cast<uint32_t>(distance < 0 ? -distance : distance), curve));
+    const int32_t value = 128 + (distance < 0 ? -scaled : scaled);
+    return static_cast<uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+void tone_map_row(const uint16_t* src, uint8_t* dst, const uint32_t& width, const ToneCurve& curve)
+{
+    const ToneVectors tone(curve);
+    uint32_t x = 0;
+
+    for(; x + 8 <= width; x += 8)
+    {
+        const __m128i v = tone_map_luma(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)), tone);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(v, v));
+    }
+
+    for(; x < width; x++)
+    {
+        const uint32_t v = scale_range(src[x] > curve.black ? src[x] - curve.black : 0, curve);
+        dst[x] = static_cast<uint8_t>(v < 255 ? v : 255);
+    }
+}
+
+// Interleaved UV samples, kept interleaved as in NV12
+void tone_map_chroma_row(const uint16_t* src, uint8_t* dst, const uint32_t& samples, const ToneCurve& curve)
+{
+    const ToneVectors tone(curve);
+    uint32_t x = 0;
+
+    for(; x + 8 <= samples; x += 8)
+    {
+        const __m128i v = tone_map_chroma(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)), tone);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(v, v));
+    }
+
+    for(; x < samples; x++)
+    {
+        dst[x] = tone_map_chroma(src[x], curve);
+    }
+}
+
+// Interleaved UV pairs through the curve into separate planes
+void split_chroma_row(const uint16_t* src, uint8_t* u, uint8_t* v, const uint32_t& pairs, const ToneCurve& curve)
+{
+    const ToneVectors tone(curve);
+    uint32_t x = 0;
+
+    // Sign extension before packing keeps the 16 bit patterns intact
+    for(; x + 8 <= pairs; x += 8)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2 + 8));
+        const __m128i ua = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        const __m128i ub = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        const __m128i u16 = tone_map_chroma(_mm_packs_epi32(ua, ub), tone);
+        const __m128i v16 = tone_map_chroma(_mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16)), tone);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x), _mm_packus_epi16(u16, u16));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x), _mm_packus_epi16(v16, v16));
+    }
+
+    for(; x < pairs; x++)
+    {
+        u[x] = tone_map_chroma(src[x * 2], curve);
+        v[x] = tone_map_chroma(src[x * 2 + 1], curve);
+    }
+}
+
+// Keeps the 10 significant bits of P010 from 16 bit samples
+void mask_row(const uint16_t* src, uint16_t* dst, const uint32_t& samples)
+{
+    const __m128i mask = _mm_set1_epi16(static_cast<short>(0xFFC0));
+    uint32_t x = 0;
+
+    for(; x + 8 <= samples; x += 8)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_and_si128(v, mask));
+    }
+
+    for(; x < samples; x++)
+    {
+        dst[x] = static_cast<uint16_t>(src[x] & 0xFFC0);
+    }
+}
+
+struct I420Planes
+{
+    uint8_t* u;
+    uint8_t* v;
+    int32_t chroma_pitch;
+};
+
+I420Planes i420_planes(uint8_t* dst, const int32_t& pitch, const uint32_t& height)
+{
+    I420Planes planes;
+    planes.chroma_pitch = pitch / 2;
+    planes.u = dst + static_cast<ptrdiff_t>(pitch) * height;
+    planes.v = planes.u + static_cast<ptrdiff_t>(planes.chroma_pitch) * (height / 2);
+    return planes;
+}
+
+// P010 and P016 share their memory layout
+void p01x_to_p01x(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput&)
+{
+    const size_t bytes = static_cast<size_t>(width) * 2;
+    copy_rows(src, src_pitch, dst, dst_pitch, bytes, height);
+    copy_rows(
+        row_at(src, src_pitch, height),
+        src_pitch,
+        row_at(dst, dst_pitch, height),
+        dst_pitch,
+        static_cast<size_t>(width >> 1) * 4,
+        height >> 1);
+}
+
+// P010 leaves the low six bits zero, P016 and GRAY16 use them
+void p016_to_p010(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput&)
+{
+    for(uint32_t row = 0; row < height; row++)
+    {
+        mask_row(
+            reinterpret_cast<const uint16_t*>(row_at(src, src_pitch, row)),
+            reinterpret_cast<uint16_t*>(row_at(dst, dst_pitch, row)),
+            width);
+    }
+
+    const uint8_t* src_uv = row_at(src, src_pitch, height);
+    uint8_t* dst_uv = row_at(dst, dst_pitch, height);
+    for(uint32_t row = 0; row < (height >> 1); row++)
+    {
+        mask_row(
+            reinterpret_cast<const uint16_t*>(row_at(src_uv, src_pitch, row)),
+            reinterpret_cast<uint16_t*>(row_at(dst_uv, dst_pitch, row)),
+            (width >> 1) * 2);
+    }
+}
+
+template<uint32_t BYTES_PER_PIXEL>
+void copy_packed(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput&)
+{
+    copy_rows(src, src_pitch, dst, dst_pitch, static_cast<size_t>(width) * BYTES_PER_PIXEL, height);
+}
+
+void p01x_to_gray16(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput&)
+{
+    copy_rows(src, src_pitch, dst, dst_pitch, static_cast<size_t>(width) * 2, height);
+}
+
+void y210_to_gray16(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput&)
+{
+    for(uint32_t row = 0; row < height; row++)
+    {
+        split_y210_row(
+            row_at(src, src_pitch, row),
+            reinterpret_cast<uint16_t*>(row_at(dst, dst_pitch, row)),
+            nullptr,
+            width);
+    }
+}
+
+template<bool MASK>
+void y210_to_p01x(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput&)
+{
+    // 4:2:2 to 4:2:0 from the average of each pair of chroma rows, whose rounding sets bits P010 has not
+    std::vector<uint16_t> chroma(static_cast<size_t>(width) * 2);
+    uint16_t* chroma0 = chroma.data();
+    uint16_t* chroma1 = chroma0 + width;
+    uint8_t* uv = row_at(dst, dst_pitch, height);
+    const uint32_t samples = (width >> 1) * 2;
+
+    for(uint32_t row = 0; row + 1 < height; row += 2)
+    {
+        split_y210_row(row_at(src, src_pitch, row), reinterpret_cast<uint16_t*>(row_at(dst, dst_pitch, row)), chroma0, width);
+        split_y210_row(row_at(src, src_pitch, row + 1), reinterpret_cast<uint16_t*>(row_at(dst, dst_pitch, row + 1)), chroma1, width);
+        uint16_t* out = reinterpret_cast<uint16_t*>(row_at(uv, dst_pitch, row >> 1));
+        average_row(chroma0, chroma1, out, samples);
+        if(MASK)
+        {
+            mask_row(out, out, samples);
+        }
+    }
+
+    if(height & 1)
+    {
+        split_y210_row(row_at(src, src_pitch, height - 1), reinterpret_cast<uint16_t*>(row_at(dst, dst_pitch, height - 1)), nullptr, width);
+    }
+}
+
+template<bool MASK>
+void gray16_to_p01x(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput&)
+{
+    for(uint32_t row = 0; row < height; row++)
+    {
+        const uint16_t* in = reinterpret_cast<const uint16_t*>(row_at(src, src_pitch, row));
+        uint16_t* out = reinterpret_cast<uint16_t*>(row_at(dst, dst_pitch, row));
+        if(MASK)
+        {
+            mask_row(in, out, width);
+        }
+        else
+        {
+            std::memcpy(out, in, static_cast<size_t>(width) * 2);
+        }
+    }
+
+    // Neutral chroma
+    const std::vector<uint16_t> neutral((width >> 1) * 2, 0x8000);
+    uint8_t* uv = row_at(dst, dst_pitch, height);
+    for(uint32_t row = 0; row < (height >> 1); row++)
+    {
+        std::memcpy(row_at(uv, dst_pitch, row), neutral.data(), neutral.size() * 2);
+    }
+}
+
+void p01x_to_i420(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput& output)
+{
+    for(uint32_t row = 0; row < height; row++)
+    {
+        tone_map_row(reinterpret_cast<const uint16_t*>(row_at(src, src_pitch, row)), row_at(dst, dst_pitch, row), width, output.curve);
+    }
+
+    const uint8_t* uv = row_at(src, src_pitch, height);
+    const I420Planes planes = i420_planes(dst, dst_pitch, height);
+    for(uint32_t row = 0; row < (height >> 1); row++)
+    {
+        split_chroma_row(
+            reinterpret_cast<const uint16_t*>(row_at(uv, src_pitch, row)),
+            row_at(planes.u, planes.chroma_pitch, row),
+            row_at(planes.v, planes.chroma_pitch, row),
+            width >> 1,
+            output.curve);
+    }
+}
+
+void y210_to_i420(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput& output)
+{
+    std::vector<uint16_t> rows(static_cast<size_t>(width) * 5);
+    uint16_t* luma = rows.data();
+    uint16_t* chroma0 = luma + width;
+    uint16_t* chroma1 = chroma0 + width;
+    uint16_t* chroma = chroma1 + width;
+    const I420Planes planes = i420_planes(dst, dst_pitch, height);
+
+    for(uint32_t row = 0; row < height; row++)
+    {
+        const bool second = (row & 1) != 0;
+        split_y210_row(row_at(src, src_pitch, row), luma, second ? chroma1 : chroma0, width);
+        tone_map_row(luma, row_at(dst, dst_pitch, row), width, output.curve);
+
+        if(second)
+        {
+            average_row(chroma0, chroma1, chroma, (width >> 1) * 2);
+            split_chroma_row(
+                chroma,
+                row_at(planes.u, planes.chroma_pitch, row >> 1),
+                row_at(planes.v, planes.chroma_pitch, row >> 1),
+                width >> 1,
+                output.curve);
+        }
+    }
+}
+
+void gray16_to_i420(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput& output)
+{
+    for(uint32_t row = 0; row < height; row++)
+    {
+        tone_map_row(reinterpret_cast<const uint16_t*>(row_at(src, src_pitch, row)), row_at(dst, dst_pitch, row), width, output.curve);
+    }
+
+    const I420Planes planes = i420_planes(dst, dst_pitch, height);
+    for(uint32_t row = 0; row < (height >> 1); row++)
+    {
+        std::memset(row_at(planes.u, planes.chroma_pitch, row), 128, width >> 1);
+        std::memset(row_at(planes.v, planes.chroma_pitch, row), 128, width >> 1);
+    }
+}
+
+// One row at a time through an NV12 band of the tone mapped luma and chroma of the row,
+// which the 8 bit kernel of the stream turns into RGB
+template<Encoding S>
+void wide_to_rgb(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput& output)
+{
+    const uint32_t chroma_samples = (width >> 1) * 2;
+    std::vector<uint8_t> band(static_cast<size_t>(width) + chroma_samples);
+    std::vector<uint16_t> split(static_cast<size_t>(width) * 2);
+    uint8_t* uv = band.data() + width;
+    const uint8_t* src_uv = row_at(src, src_pitch, height);
+
+    if(S == Encoding::GRAY16)
+    {
+        std::memset(uv, 128, chroma_samples);
+    }
+
+    for(uint32_t row = 0; row < height; row++)
+    {
+        const uint8_t* in = row_at(src, src_pitch, row);
+        if(S == Encoding::Y210)
+        {
+            // 4:2:2, every row has chroma of its own
+            split_y210_row(in, split.data(), split.data() + width, width);
+            tone_map_row(split.data(), band.data(), width, output.curve);
+            tone_map_chroma_row(split.data() + width, uv, chroma_samples, output.curve);
+        }
+        else
+        {
+            tone_map_row(reinterpret_cast<const uint16_t*>(in), band.data(), width, output.curve);
+
+            // The last row of an odd height keeps the chroma of the one before
+            if(S != Encoding::GRAY16 && (row & 1) == 0 && (row >> 1) < (height >> 1))
+            {
+                tone_map_chroma_row(reinterpret_cast<const uint16_t*>(row_at(src_uv, src_pitch, row >> 1)), uv, chroma_samples, output.curve);
+            }
+        }
+
+        output.rgb(band.data(), static_cast<int32_t>(width), row_at(dst, dst_pitch, row), dst_pitch, width, 1, nullptr);
+    }
+}
+
+struct WideEntry
+{
+    Encoding src;
+    Encoding dst;
+    WideConvert kernel;
+};
+
+const WideEntry WIDE_KERNELS[] = {
+    {Encoding::P010, Encoding::P010, &p01x_to_p01x},
+    {Encoding::P010, Encoding::P016, &p01x_to_p01x},
+    {Encoding::P016, Encoding::P010, &p016_to_p010},
+    {Encoding::P016, Encoding::P016, &p01x_to_p01x},
+    {Encoding::Y210, Encoding::Y210, &copy_packed<4>},
+    {Encoding::GRAY16, Encoding::GRAY16, &copy_packed<2>},
+    {Encoding::P010, Encoding::GRAY16, &p01x_to_gray16},
+    {Encoding::P016, Encoding::GRAY16, &p01x_to_gray16},
+    {Encoding::Y210, Encoding::GRAY16, &y210_to_gray16},
+    {Encoding::Y210, Encoding::P010, &y210_to_p01x<true>},
+    {Encoding::Y210, Encoding::P016, &y210_to_p01x<false>},
+    {Encoding::GRAY16, Encoding::P010, &gray16_to_p01x<true>},
+    {Encoding::GRAY16, Encoding::P016, &gray16_to_p01x<false>},
+    {Encoding::P010, Encoding::I420, &p01x_to_i420},
+    {Encoding::P016, Encoding::I420, &p01x_to_i420},
+    {Encoding::Y210, Encoding::I420, &y210_to_i420},
+    {Encoding::GRAY16, Encoding::I420, &gray16_to_i420},
+    {Encoding::P010, Encoding::RGB24, &wide_to_rgb<Encoding::P010>},
+    {Encoding::P016, Encoding::RGB24, &wide_to_rgb<Encoding::P016>},
+    {Encoding::Y210, Encoding::RGB24, &wide_to_rgb<Encoding::Y210>},
+    {Encoding::GRAY16, Encoding::RGB24, &wide_to_rgb<Encoding::GRAY16>},
+    {Encoding::P010, Encoding::RGBA32, &wide_to_rgb<Encoding::P010>},
+    {Encoding::P016, Encoding::RGBA32, &wide_to_rgb<Encoding::P016>},
+    {Encoding::Y210, Encoding::RGBA32, &wide_to_rgb<Encoding::Y210>},
+    {Encoding::GRAY16, Encoding::RGBA32, &wide_to_rgb<Encoding::GRAY16>},
+};
+
+}
+
+ToneCurve::ToneCurve()
+    : black(0)
+    , range(0xFFFF)
+    , shift(0)
+    , scale(32640)
+{
+}
+
+ToneCurve make_tone_curve(const ToneMapOptions& options)
+{
+    ToneCurve curve;
+    if(!options.enabled)
+    {
+        return curve;
+    }
+
+    curve.black = options.black;
+    curve.range = options.white > options.black ? static_cast<uint16_t>(options.white - options.black) : 1;
+
+    while((static_cast<uint32_t>(curve.range) << curve.shift) < 0x8000)
+    {
+        curve.shift++;
+    }
+
+    const uint32_t full = static_cast<uint32_t>(curve.range) << curve.shift;
+    curve.scale = static_cast<uint16_t>(((255ull << 23) + full / 2) / full);
+    return curve;
+}
+
+WideOutput::WideOutput()
+    : rgb(nullptr)
+{
+}
+
+WideConvert find_wide(const Encoding& src, const Encoding& dst)
+{
+    for(const WideEntry& entry : WIDE_KERNELS)
+    {
+        if(entry.src == src && entry.dst == dst)
+        {
+            return entry.kernel;
+        }
+    }
+
+    return nullptr;
+}
+
+}}
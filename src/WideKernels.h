@@ -0,0 +1,82 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "cdi/cdi.h"
+#include "ColorKernels.h"
+#include <cstdint>
+
+
+namespace cdi { namespace kernels {
+
+// Conversions of frames with two byte (little endian, high bit aligned) samples.
+// 'src' and 'dst' are the first rows of the frames and the pitches their luma (or
+// packed) row distance. Further planes follow the first one as in FrameLayout, but
+// with rows at those pitches (half of it for the I420 chroma planes).
+
+// ToneMapOptions prepared for the kernels. Luma maps from the window to 0..255, chroma
+// keeps 0x8000 at 128 and its distance from there scales as luma does. Both round.
+struct ToneCurve
+{
+    ToneCurve();
+    uint16_t black;
+    uint16_t range; // white - black
+    uint16_t shift; // range << shift uses all 16 bits
+    uint16_t scale; // 255 << 23 / (range << shift), rounded, output steps in 1/128
+};
+
+// The full 16 bit range unless the options are enabled
+ToneCurve make_tone_curve(const ToneMapOptions& options);
+
+// What the kernels produce 8 bit output with
+struct WideOutput
+{
+    WideOutput();
+    ToneCurve curve;
+    YuvToRgb rgb; // NV12 to the RGB encoding and color space of the stream, RGB output only
+};
+
+// 'dst' and 'dst_pitch' as in YuvToRgb for RGB output
+typedef void (*WideConvert)(
+    const uint8_t* src,
+    const int32_t& src_pitch,
+    uint8_t* dst,
+    const int32_t& dst_pitch,
+    const uint32_t& width,
+    const uint32_t& height,
+    const WideOutput& output);
+
+// Between the high bit depth encodings without losing precision, and from them to I420,
+// RGB24 and RGBA32 through the tone curve. Null when there is no kernel for the pair.
+WideConvert find_wide(const Encoding& src, const Encoding& dst);
+
+}}
@@ -0,0 +1,159 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "WorkerPool.h"
+#include "ThreadPlacer.h"
+
+#include <algorithm>
+
+
+namespace cdi {
+
+WorkerPool::WorkerPool(const uint32_t& threads, const std::shared_ptr<ThreadPlacer>& placer)
+    : m_placer(placer)
+    , m_job(nullptr)
+    , m_count(0)
+    , m_next(0)
+    , m_pending(0)
+    , m_generation(0)
+    , m_exit(false)
+{
+    uint32_t count = threads;
+    if(count == 0)
+    {
+        count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Calling thread is one of the workers
+    for(uint32_t i = 1; i < count; i++)
+    {
+        m_threads.emplace_back([this]() { worker(); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_start.notify_all();
+
+    for(std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+uint32_t WorkerPool::size() const
+{
+    return static_cast<uint32_t>(m_threads.size()) + 1;
+}
+
+void WorkerPool::run(const uint32_t& count, const std::function<void(uint32_t)>& job)
+{
+    if(count == 0)
+    {
+        return;
+    }
+
+    if(count == 1 || m_threads.empty())
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_count = count;
+        m_next = 0;
+        m_pending = static_cast<uint32_t>(m_threads.size());
+        m_generation++;
+    }
+    m_start.notify_all();
+
+    execute();
+
+    // Wait for all workers to leave the job before it goes out of scope
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_pending == 0; });
+    m_job = nullptr;
+}
+
+void WorkerPool::worker()
+{
+    if(m_placer)
+    {
+        m_placer->place();
+    }
+    else
+    {
+        ThreadPlacer::apply(get_thread_policy());
+    }
+
+    uint64_t generation = 0;
+
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, generation]() { return m_exit || m_generation != generation; });
+            if(m_exit)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        execute();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending--;
+        }
+        m_done.notify_one();
+    }
+}
+
+void WorkerPool::execute()
+{
+    for(uint32_t i = m_next++; i < m_count; i = m_next++)
+    {
+        (*m_job)(i);
+    }
+}
+
+}
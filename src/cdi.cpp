@@ -30,12 +30,19 @@
     OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#pragma once
-
 #define NOMINMAX
 #include "cdi/cdi.h"
 #include "Buffer.h"
 #include "DevicePool.h"
+#include "DeviceProber.h"
+#include "Governor.h"
+#include "JpegEncoder.h"
+#include "LosslessCodec.h"
+#include "Recorder.h"
+#include "Recording.h"
+#include "SessionPool.h"
+#include "SharedStream.h"
+#include "TensorWriter.h"
 
 #include <map>
 
@@ -76,24 +83,137 @@ std::vector<Resolution> get_resolutions(const uint32_t& device_index)
     return resolutions;
 }
 
+std::vector<DeviceCapabilities> probe_all(const ProbeOptions& options)
+{
+    // Probes left behind by the timeout keep the enumeration alive until they return
+    std::shared_ptr<DevicePool> devices(std::make_shared<DevicePool>());
+
+    DeviceProber prober(options);
+    return prober.run(devices->get_count(), [devices](const uint32_t& index, DeviceCapabilities& capabilities)
+    {
+        devices->probe(index, capabilities);
+    });
+}
+
 std::unique_ptr<IBuffer> open_device(
     const uint32_t& device_index,
     const uint32_t& width,
     const uint32_t& height,
     const Encoding& encoding)
+{
+    return open_device(device_index, width, height, encoding, StreamOptions());
+}
+
+std::unique_ptr<IBuffer> open_device(
+    const uint32_t& device_index,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const StreamOptions& options)
 {
     std::unique_ptr<Buffer> buffer;
 
     if(encoding != Encoding::UNKNOWN)
     {
         buffer = std::make_unique<Buffer>();
-        if(!buffer->init(device_index, width, height, encoding))
+        if(!buffer->init(device_index, width, height, encoding, options))
         {
             buffer.reset();
         }
     }
 
-    return std::move(buffer);
+    return buffer;
+}
+
+std::unique_ptr<ISessionPool> create_session_pool(const uint32_t& idle_timeout_ms)
+{
+    std::unique_ptr<SessionPool> pool(std::make_unique<SessionPool>());
+    if(!pool->init(idle_timeout_ms))
+    {
+        pool.reset();
+    }
+
+    return pool;
+}
+
+std::unique_ptr<ISharedStream> open_shared(
+    const uint32_t& device_index,
+    const uint32_t& width,
+    const uint32_t& height,
+    const StreamOptions& options)
+{
+    std::unique_ptr<SharedStream> stream(std::make_unique<SharedStream>());
+    if(!stream->init(device_index, width, height, options))
+    {
+        stream.reset();
+    }
+
+    return stream;
+}
+
+std::unique_ptr<IGovernor> create_governor(
+    const GovernorOptions& options,
+    const std::function<void(const GovernorEvent&)>& events)
+{
+    std::unique_ptr<Governor> governor(std::make_unique<Governor>());
+    if(!governor->init(options, events))
+    {
+        governor.reset();
+    }
+
+    return governor;
+}
+
+size_t jpeg_bound(const uint32_t& width, const uint32_t& height, const JpegOptions& options)
+{
+    const uint32_t scale = options.scale != 0 ? options.scale : 1;
+    return JpegEncoder::bound(width / scale, height / scale);
+}
+
+std::unique_ptr<ICodec> create_lossless_codec(
+    const Predictor& predictor,
+    const uint32_t& threads)
+{
+    return std::make_unique<LosslessCodec>(predictor, threads);
+}
+
+std::unique_ptr<IRecorder> create_recording(
+    const std::wstring& path,
+    const uint32_t& width,
+    const uint32_t& height,
+    const Encoding& encoding,
+    const std::wstring& device_name,
+    std::unique_ptr<ICodec> codec)
+{
+    std::unique_ptr<Recorder> recorder(std::make_unique<Recorder>());
+    if(!recorder->init(path, width, height, encoding, device_name, std::move(codec)))
+    {
+        recorder.reset();
+    }
+
+    return recorder;
+}
+
+std::unique_ptr<IRecording> open_recording(const std::wstring& path)
+{
+    std::unique_ptr<Recording> recording(std::make_unique<Recording>());
+    if(!recording->init(path))
+    {
+        recording.reset();
+    }
+
+    return recording;
+}
+
+std::unique_ptr<ITensorWriter> create_tensor_writer(const TensorDesc& desc)
+{
+    std::unique_ptr<TensorWriter> writer(std::make_unique<TensorWriter>());
+    if(!writer->init(desc))
+    {
+        writer.reset();
+    }
+
+    return writer;
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,238 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Thresholds of the change gate: a tile changes when the mean absolute difference of its grid
+// samples exceeds the threshold, edge tiles are normalised by their own size and the reference
+// only advances with changed or accepted frames.
+
+#include "Check.h"
+#include "ChangeGate.h"
+
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 64;
+const uint32_t HEIGHT = 64;
+
+cdi::ChangeGateOptions options(const uint32_t& grid_step, const uint32_t& tile_size, const float& threshold)
+{
+    cdi::ChangeGateOptions result;
+    result.enabled = true;
+    result.grid_step = grid_step;
+    result.tile_size = tile_size;
+    result.threshold = threshold;
+    return result;
+}
+
+// Adds 'delta' to the grid samples of one tile of a packed frame, grid step 4 and tiles of 8
+void add_to_tile(std::vector<uint8_t>& frame, const uint32_t& width, const uint32_t& tx, const uint32_t& ty, const int& delta)
+{
+    for(uint32_t gy = ty * 8; gy < ty * 8 + 8; gy++)
+    {
+        for(uint32_t gx = tx * 8; gx < tx * 8 + 8 && gx * 4 < width; gx++)
+        {
+            uint8_t& value = frame[static_cast<size_t>(gy) * 4 * width + gx * 4];
+            value = static_cast<uint8_t>(value + delta);
+        }
+    }
+}
+
+bool update(cdi::ChangeGate& gate, const std::vector<uint8_t>& frame, const uint32_t& width)
+{
+    return gate.update(frame.data(), static_cast<int32_t>(width), 1);
+}
+
+void test_init()
+{
+    cdi::ChangeGate gate;
+    CHECK(!gate.init(WIDTH, HEIGHT, options(0, 8, 4.0f)));
+    CHECK(!gate.init(WIDTH, HEIGHT, options(4, 0, 4.0f)));
+    REQUIRE(gate.init(WIDTH, HEIGHT, options(4, 8, 4.0f)));
+    CHECK(gate.tiles_x() == 2 && gate.tiles_y() == 2);
+
+    // Grids smaller than a tile still have one
+    REQUIRE(gate.init(3, 3, options(4, 8, 4.0f)));
+    CHECK(gate.tiles_x() == 1 && gate.tiles_y() == 1);
+}
+
+void test_threshold()
+{
+    cdi::ChangeGate gate;
+    REQUIRE(gate.init(WIDTH, HEIGHT, options(4, 8, 4.0f)));
+
+    std::vector<uint8_t> frame(WIDTH * HEIGHT, 100);
+
+    // The first frame has nothing to compare with
+    CHECK(update(gate, frame, WIDTH));
+    CHECK(gate.score() == 255.0f);
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        CHECK(gate.mask()[i] == 1);
+    }
+
+    CHECK(!update(gate, frame, WIDTH));
+    CHECK(gate.score() == 0.0f);
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        CHECK(gate.mask()[i] == 0);
+    }
+
+    // A mean difference at the threshold does not count, above it does
+    std::vector<uint8_t> at = frame;
+    add_to_tile(at, WIDTH, 1, 0, 4);
+    CHECK(!update(gate, at, WIDTH));
+    CHECK(gate.mask()[1] == 0);
+    CHECK(gate.score() == 1.0f);
+
+    std::vector<uint8_t> above = frame;
+    add_to_tile(above, WIDTH, 1, 0, 5);
+    CHECK(update(gate, above, WIDTH));
+    CHECK(gate.mask()[0] == 0 && gate.mask()[1] == 1 && gate.mask()[2] == 0 && gate.mask()[3] == 0);
+
+    // Decreases count as much as increases
+    add_to_tile(above, WIDTH, 0, 1, -5);
+    CHECK(update(gate, above, WIDTH));
+    CHECK(gate.mask()[0] == 0 && gate.mask()[1] == 0 && gate.mask()[2] == 1 && gate.mask()[3] == 0);
+
+    // Pixels between the grid samples are not looked at
+    std::vector<uint8_t> between = above;
+    for(size_t i = 0; i < between.size(); i++)
+    {
+        if((i % WIDTH) % 4 != 0 || (i / WIDTH) % 4 != 0)
+        {
+            between[i] = 0;
+        }
+    }
+    CHECK(!update(gate, between, WIDTH));
+}
+
+void test_drift()
+{
+    cdi::ChangeGate gate;
+    REQUIRE(gate.init(WIDTH, HEIGHT, options(4, 8, 4.0f)));
+
+    std::vector<uint8_t> frame(WIDTH * HEIGHT, 100);
+    CHECK(update(gate, frame, WIDTH));
+
+    // The reference stays until the accumulated drift crosses the threshold
+    for(int step = 1; step <= 4; step++)
+    {
+        std::fill(frame.begin(), frame.end(), static_cast<uint8_t>(100 + step));
+        CHECK(!update(gate, frame, WIDTH));
+    }
+    std::fill(frame.begin(), frame.end(), static_cast<uint8_t>(105));
+    CHECK(update(gate, frame, WIDTH));
+
+    // Now relative to the changed frame
+    std::fill(frame.begin(), frame.end(), static_cast<uint8_t>(106));
+    CHECK(!update(gate, frame, WIDTH));
+
+    // An accepted frame becomes the reference although it did not change enough
+    std::fill(frame.begin(), frame.end(), static_cast<uint8_t>(108));
+    CHECK(!update(gate, frame, WIDTH));
+    gate.accept();
+    std::fill(frame.begin(), frame.end(), static_cast<uint8_t>(112));
+    CHECK(!update(gate, frame, WIDTH));
+    std::fill(frame.begin(), frame.end(), static_cast<uint8_t>(113));
+    CHECK(update(gate, frame, WIDTH));
+}
+
+void test_edge_tiles()
+{
+    // 18 grid columns, the last tile is 2 wide
+    const uint32_t width = 72;
+    cdi::ChangeGate gate;
+    REQUIRE(gate.init(width, HEIGHT, options(4, 8, 4.0f)));
+    REQUIRE(gate.tiles_x() == 3 && gate.tiles_y() == 2);
+
+    std::vector<uint8_t> frame(width * HEIGHT, 0);
+    CHECK(update(gate, frame, width));
+
+    // 65 over the 16 samples of the edge tile crosses the threshold
+    std::vector<uint8_t> edge = frame;
+    edge[68] = 65;
+    CHECK(update(gate, edge, width));
+    CHECK(gate.mask()[2] == 1);
+
+    // The same change in a full tile of 64 samples does not
+    std::vector<uint8_t> inner = edge;
+    inner[0] = 65;
+    CHECK(!update(gate, inner, width));
+    CHECK(gate.mask()[0] == 0);
+}
+
+void test_layouts()
+{
+    // The same image top-down and packed, bottom-up with two byte steps as YUY2 luma
+    std::vector<uint8_t> packed(WIDTH * HEIGHT, 50);
+    std::vector<uint8_t> interleaved(WIDTH * 2 * HEIGHT, 200);
+    for(uint32_t y = 0; y < HEIGHT; y++)
+    {
+        for(uint32_t x = 0; x < WIDTH; x++)
+        {
+            interleaved[static_cast<size_t>(HEIGHT - 1 - y) * WIDTH * 2 + x * 2] = packed[y * WIDTH + x];
+        }
+    }
+    const uint8_t* last_row = interleaved.data() + (HEIGHT - 1) * WIDTH * 2;
+    const int32_t pitch = -static_cast<int32_t>(WIDTH * 2);
+
+    cdi::ChangeGate top_down;
+    cdi::ChangeGate bottom_up;
+    REQUIRE(top_down.init(WIDTH, HEIGHT, options(4, 8, 1.0f)));
+    REQUIRE(bottom_up.init(WIDTH, HEIGHT, options(4, 8, 1.0f)));
+    CHECK(top_down.update(packed.data(), WIDTH, 1));
+    CHECK(bottom_up.update(last_row, pitch, 2));
+
+    // Bottom left tile of the image, 100 over 64 samples. Its rows come first in the bottom-up memory.
+    packed[48 * WIDTH + 8] = 150;
+    interleaved[static_cast<size_t>(HEIGHT - 1 - 48) * WIDTH * 2 + 16] = 150;
+    CHECK(top_down.update(packed.data(), WIDTH, 1));
+    CHECK(bottom_up.update(last_row, pitch, 2));
+    CHECK(std::memcmp(top_down.mask(), bottom_up.mask(), 4) == 0);
+    CHECK(top_down.mask()[2] == 1);
+    CHECK(top_down.score() == bottom_up.score());
+}
+
+}
+
+int main()
+{
+    test_init();
+    test_threshold();
+    test_drift();
+    test_edge_tiles();
+    test_layouts();
+
+    return cdi::test::result("ChangeGateTest");
+}
@@ -0,0 +1,427 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Conversion kernels against a double-precision reference of the matrices and ranges, every
+// kernel of the dispatch tables within one code value. Explicit BT.601 and BT.709 streams go
+// through the Color Converter DSP, which gets told the matrix and range. Streams report the
+// statistics of the camera frame whether the kernels accumulate them or a pass of their own.
+
+#include "Check.h"
+#include "ColorKernels.h"
+#include "FrameStats.h"
+#include "camera.h"
+
+#include <mfapi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 34;
+const uint32_t HEIGHT = 18;
+
+struct Weights
+{
+    double kr;
+    double kb;
+};
+
+Weights weights(const cdi::ColorMatrix& matrix)
+{
+    switch(matrix)
+    {
+    case cdi::ColorMatrix::BT709:
+        return {0.2126, 0.0722};
+    case cdi::ColorMatrix::BT2020:
+        return {0.2627, 0.0593};
+    default:
+        return {0.299, 0.114};
+    }
+}
+
+// B, G, R of one pixel
+void reference_rgb(const int& y, const int& u, const int& v, const cdi::ColorSpace& color, double* bgr)
+{
+    const Weights w = weights(color.matrix);
+    const bool full = color.range == cdi::ColorRange::FULL;
+    const double luma = (y - (full ? 0 : 16)) * (full ? 1.0 : 255.0 / 219.0);
+    const double cb = (u - 128) * (full ? 1.0 : 255.0 / 224.0);
+    const double cr = (v - 128) * (full ? 1.0 : 255.0 / 224.0);
+
+    bgr[2] = luma + 2.0 * (1.0 - w.kr) * cr;
+    bgr[0] = luma + 2.0 * (1.0 - w.kb) * cb;
+    bgr[1] = (luma - w.kr * bgr[2] - w.kb * bgr[0]) / (1.0 - w.kr - w.kb);
+}
+
+// Y, U, V of one pixel
+void reference_yuv(const double* bgr, const cdi::ColorSpace& color, double* yuv)
+{
+    const Weights w = weights(color.matrix);
+    const bool full = color.range == cdi::ColorRange::FULL;
+    const double luma = w.kr * bgr[2] + (1.0 - w.kr - w.kb) * bgr[1] + w.kb * bgr[0];
+
+    yuv[0] = luma * (full ? 1.0 : 219.0 / 255.0) + (full ? 0 : 16);
+    yuv[1] = (bgr[0] - luma) / (2.0 * (1.0 - w.kb)) * (full ? 1.0 : 224.0 / 255.0) + 128;
+    yuv[2] = (bgr[2] - luma) / (2.0 * (1.0 - w.kr)) * (full ? 1.0 : 224.0 / 255.0) + 128;
+}
+
+bool near(const uint8_t& value, const double& reference)
+{
+    return std::abs(value - std::min(255.0, std::max(0.0, reference))) <= 1.0;
+}
+
+std::vector<uint8_t> noise(const size_t& size, const uint32_t& seed)
+{
+    std::vector<uint8_t> result(size);
+    uint32_t state = seed;
+    for(uint8_t& value : result)
+    {
+        state = state * 1664525u + 1013904223u;
+        value = static_cast<uint8_t>(state >> 24);
+    }
+    return result;
+}
+
+// Y, U, V of pixel x, y of a packed 8 bit frame
+void sample(const cdi::kernels::YuvFormat& format, const std::vector<uint8_t>& frame, const uint32_t& x, const uint32_t& y, int* yuv)
+{
+    switch(format)
+    {
+    case cdi::kernels::YuvFormat::I420:
+        yuv[0] = frame[y * WIDTH + x];
+        yuv[1] = frame[WIDTH * HEIGHT + (y / 2) * (WIDTH / 2) + x / 2];
+        yuv[2] = frame[WIDTH * HEIGHT * 5 / 4 + (y / 2) * (WIDTH / 2) + x / 2];
+        break;
+    case cdi::kernels::YuvFormat::NV12:
+        yuv[0] = frame[y * WIDTH + x];
+        yuv[1] = frame[WIDTH * HEIGHT + (y / 2) * WIDTH + (x & ~1u)];
+        yuv[2] = frame[WIDTH * HEIGHT + (y / 2) * WIDTH + (x & ~1u) + 1];
+        break;
+    case cdi::kernels::YuvFormat::YUY2:
+        yuv[0] = frame[y * WIDTH * 2 + x * 2];
+        yuv[1] = frame[y * WIDTH * 2 + (x & ~1u) * 2 + 1];
+        yuv[2] = frame[y * WIDTH * 2 + (x & ~1u) * 2 + 3];
+        break;
+    }
+}
+
+const cdi::ColorMatrix MATRICES[] = {cdi::ColorMatrix::DEFAULT, cdi::ColorMatrix::BT601, cdi::ColorMatrix::BT709, cdi::ColorMatrix::BT2020};
+const cdi::ColorRange RANGES[] = {cdi::ColorRange::LIMITED, cdi::ColorRange::FULL};
+
+void check_yuv_to_rgb()
+{
+    const cdi::kernels::YuvFormat formats[] = {cdi::kernels::YuvFormat::I420, cdi::kernels::YuvFormat::NV12, cdi::kernels::YuvFormat::YUY2};
+
+    for(const cdi::kernels::YuvFormat& format : formats)
+    {
+        const bool packed = format == cdi::kernels::YuvFormat::YUY2;
+        const std::vector<uint8_t> src = noise(packed ? WIDTH * HEIGHT * 2 : WIDTH * HEIGHT * 3 / 2, 7);
+
+        for(const cdi::Encoding& encoding : {cdi::Encoding::RGB24, cdi::Encoding::RGBA32})
+        {
+            const uint32_t bpp = encoding == cdi::Encoding::RGBA32 ? 4 : 3;
+            for(const cdi::ColorMatrix& matrix : MATRICES)
+            {
+                for(const cdi::ColorRange& range : RANGES)
+                {
+                    const cdi::ColorSpace color(matrix, range);
+                    const cdi::kernels::YuvToRgb kernel = cdi::kernels::find_yuv_to_rgb(format, encoding, color);
+                    REQUIRE(kernel != nullptr);
+
+                    std::vector<uint8_t> dst(WIDTH * HEIGHT * bpp);
+                    kernel(src.data(), static_cast<int32_t>(packed ? WIDTH * 2 : WIDTH), dst.data(), static_cast<int32_t>(WIDTH * bpp), WIDTH, HEIGHT, nullptr);
+
+                    bool within = true;
+                    for(uint32_t y = 0; y < HEIGHT; y++)
+                    {
+                        for(uint32_t x = 0; x < WIDTH; x++)
+                        {
+                            int yuv[3];
+                            double bgr[3];
+                            sample(format, src, x, y, yuv);
+                            reference_rgb(yuv[0], yuv[1], yuv[2], color, bgr);
+
+                            const uint8_t* pixel = &dst[(y * WIDTH + x) * bpp];
+                            within = within && near(pixel[0], bgr[0]) && near(pixel[1], bgr[1]) && near(pixel[2], bgr[2]);
+                            within = within && (bpp == 3 || pixel[3] == 0xFF);
+                        }
+                    }
+                    CHECK(within);
+                }
+            }
+        }
+    }
+}
+
+void check_rgb_to_i420()
+{
+    for(const cdi::Encoding& encoding : {cdi::Encoding::RGB24, cdi::Encoding::RGBA32})
+    {
+        const uint32_t bpp = encoding == cdi::Encoding::RGBA32 ? 4 : 3;
+        const std::vector<uint8_t> src = noise(WIDTH * HEIGHT * bpp, 11);
+
+        for(const cdi::ColorMatrix& matrix : MATRICES)
+        {
+            for(const cdi::ColorRange& range : RANGES)
+            {
+                const cdi::ColorSpace color(matrix, range);
+                const cdi::kernels::RgbToI420 kernel = cdi::kernels::find_rgb_to_i420(encoding, color);
+                REQUIRE(kernel != nullptr);
+
+                std::vector<uint8_t> y_plane(WIDTH * HEIGHT);
+                std::vector<uint8_t> u_plane(WIDTH * HEIGHT / 4);
+                std::vector<uint8_t> v_plane(WIDTH * HEIGHT / 4);
+                for(uint32_t y = 0; y < HEIGHT; y += 2)
+                {
+                    kernel(
+                        &src[y * WIDTH * bpp], &src[(y + 1) * WIDTH * bpp],
+                        &y_plane[y * WIDTH], &y_plane[(y + 1) * WIDTH],
+                        &u_plane[y / 2 * WIDTH / 2], &v_plane[y / 2 * WIDTH / 2],
+                        WIDTH);
+                }
+
+                bool within = true;
+                for(uint32_t y = 0; y < HEIGHT; y++)
+                {
+                    for(uint32_t x = 0; x < WIDTH; x++)
+                    {
+                        const uint8_t* pixel = &src[(y * WIDTH + x) * bpp];
+                        const double bgr[3] = {static_cast<double>(pixel[0]), static_cast<double>(pixel[1]), static_cast<double>(pixel[2])};
+                        double yuv[3];
+                        reference_yuv(bgr, color, yuv);
+                        within = within && near(y_plane[y * WIDTH + x], yuv[0]);
+                    }
+                }
+
+                // Chroma of the mean of each 2x2 block
+                for(uint32_t y = 0; y < HEIGHT / 2; y++)
+                {
+                    for(uint32_t x = 0; x < WIDTH / 2; x++)
+                    {
+                        double bgr[3] = {};
+                        for(uint32_t i = 0; i < 4; i++)
+                        {
+                            const uint8_t* pixel = &src[((y * 2 + i / 2) * WIDTH + x * 2 + i % 2) * bpp];
+                            for(uint32_t c = 0; c < 3; c++)
+                            {
+                                bgr[c] += pixel[c] / 4.0;
+                            }
+                        }
+
+                        double yuv[3];
+                        reference_yuv(bgr, color, yuv);
+                        within = within && near(u_plane[y * WIDTH / 2 + x], yuv[1]) && near(v_plane[y * WIDTH / 2 + x], yuv[2]);
+                    }
+                }
+                CHECK(within);
+            }
+        }
+    }
+}
+
+// The stand-in DSP converts exactly with what it is told, the first frame of the camera
+// matches the reference of the requested matrix and range only when it got them
+void check_dsp_color()
+{
+    const GUID subtype = MFVideoFormat_YUY2;
+    sdk::CameraDesc desc;
+    desc.formats.push_back({subtype, WIDTH, HEIGHT, 500});
+
+    const cdi::ColorSpace spaces[] = {
+        cdi::ColorSpace(cdi::ColorMatrix::BT601, cdi::ColorRange::LIMITED),
+        cdi::ColorSpace(cdi::ColorMatrix::BT601, cdi::ColorRange::FULL),
+        cdi::ColorSpace(cdi::ColorMatrix::BT709, cdi::ColorRange::LIMITED),
+        cdi::ColorSpace(cdi::ColorMatrix::BT709, cdi::ColorRange::FULL)};
+
+    for(const cdi::ColorSpace& color : spaces)
+    {
+        sdk::remove_cameras();
+        sdk::add_camera(desc);
+
+        cdi::StreamOptions options;
+        options.color = color;
+        std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::RGB24, options);
+        REQUIRE(buffer);
+        CHECK(sdk::converter_instances() == 1);
+
+        const uint8_t* data = static_cast<const uint8_t*>(buffer->lock());
+        REQUIRE(data != nullptr);
+
+        // The camera counts from zero
+        std::vector<uint8_t> src(WIDTH * HEIGHT * 2);
+        sdk::fill_frame(subtype, WIDTH, HEIGHT, buffer->info().sequence - 1, src.data());
+
+        bool within = true;
+        for(uint32_t y = 0; y < HEIGHT; y++)
+        {
+            for(uint32_t x = 0; x < WIDTH; x++)
+            {
+                int yuv[3];
+                double bgr[3];
+                sample(cdi::kernels::YuvFormat::YUY2, src, x, y, yuv);
+                reference_rgb(yuv[0], yuv[1], yuv[2], color, bgr);
+
+                // Bottom-up
+                const uint8_t* pixel = data + ((HEIGHT - 1 - y) * WIDTH + x) * 3;
+                within = within && near(pixel[0], bgr[0]) && near(pixel[1], bgr[1]) && near(pixel[2], bgr[2]);
+            }
+        }
+        CHECK(within);
+
+        buffer->unlock();
+    }
+
+    sdk::remove_cameras();
+}
+
+// Statistics of a frame against those of the camera frame with the same sequence
+bool same_statistics(const cdi::FrameInfo& info, const GUID& subtype)
+{
+    if(info.statistics == nullptr || info.sequence == 0)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> src(WIDTH * HEIGHT * 2);
+    sdk::fill_frame(subtype, WIDTH, HEIGHT, info.sequence - 1, src.data());
+
+    cdi::StatisticsOptions options;
+    options.enabled = true;
+    cdi::FrameStats stats;
+    stats.begin();
+    for(uint32_t y = 0; y < HEIGHT; y++)
+    {
+        stats.accumulate_row(&src[y * WIDTH * 2], y > 0 ? &src[(y - 1) * WIDTH * 2] : nullptr, WIDTH, 2);
+    }
+    stats.finish(options);
+
+    const cdi::FrameStatistics& expected = stats.result();
+    bool equal = info.statistics->samples == expected.samples
+        && info.statistics->mean == expected.mean
+        && info.statistics->clipped == expected.clipped
+        && info.statistics->sharpness == expected.sharpness;
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        equal = equal && info.statistics->histogram[i] == expected.histogram[i];
+    }
+    return equal;
+}
+
+// BT.2020 and rotated streams take the own kernels, which accumulate the statistics while they
+// convert. The DSP stream, a native JPEG snapshot and the frames of a shared stream, which
+// convert elsewhere, get the pass of Device::inspect().
+void check_statistics()
+{
+    const GUID subtype = MFVideoFormat_YUY2;
+    sdk::CameraDesc desc;
+    desc.formats.push_back({subtype, WIDTH, HEIGHT, 500});
+    desc.row_padding = 6;
+
+    cdi::OrientationOptions rotated;
+    rotated.rotation = cdi::Rotation::CLOCKWISE_180;
+
+    struct Case
+    {
+        cdi::ColorMatrix matrix;
+        cdi::OrientationOptions orientation;
+        bool asynchronous;
+    };
+    const Case cases[] = {
+        {cdi::ColorMatrix::BT601, cdi::OrientationOptions(), false},
+        {cdi::ColorMatrix::BT2020, cdi::OrientationOptions(), false},
+        {cdi::ColorMatrix::BT2020, cdi::OrientationOptions(), true},
+        {cdi::ColorMatrix::BT601, rotated, false},
+        {cdi::ColorMatrix::BT601, rotated, true},
+    };
+
+    for(const Case& test : cases)
+    {
+        sdk::remove_cameras();
+        sdk::add_camera(desc);
+
+        cdi::StreamOptions options;
+        options.statistics.enabled = true;
+        options.color.matrix = test.matrix;
+        options.orientation = test.orientation;
+        options.asynchronous = test.asynchronous;
+
+        {
+            std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::RGB24, options);
+            REQUIRE(buffer);
+            for(uint32_t i = 0; i < 3; i++)
+            {
+                REQUIRE(buffer->lock() != nullptr);
+                CHECK(same_statistics(buffer->info(), subtype));
+                buffer->unlock();
+            }
+        }
+
+        // Unrotated frames are encoded as they came, rotated ones from their I420 conversion
+        {
+            const bool native = test.orientation.rotation == cdi::Rotation::NONE;
+            const cdi::Encoding encoding = native ? cdi::Encoding::RGB24 : cdi::Encoding::I420;
+            std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, encoding, options);
+            REQUIRE(buffer);
+            std::vector<uint8_t> jpeg(cdi::jpeg_bound(WIDTH, HEIGHT, cdi::JpegOptions()));
+            CHECK(buffer->snapshot_jpeg(cdi::JpegOptions(), jpeg.data(), jpeg.size()) != 0);
+            CHECK(same_statistics(buffer->info(), subtype));
+        }
+
+        std::unique_ptr<cdi::ISharedStream> stream = cdi::open_shared(0, WIDTH, HEIGHT, options);
+        REQUIRE(stream);
+        std::unique_ptr<cdi::IBuffer> rgb = stream->attach(cdi::Encoding::RGB24);
+        REQUIRE(rgb);
+        for(uint32_t i = 0; i < 3; i++)
+        {
+            REQUIRE(rgb->lock() != nullptr);
+            CHECK(same_statistics(rgb->info(), subtype));
+            rgb->unlock();
+        }
+    }
+
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_yuv_to_rgb();
+    check_rgb_to_i420();
+    check_dsp_color();
+    check_statistics();
+
+    return cdi::test::result("ColorKernelsTest");
+}
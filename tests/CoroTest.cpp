@@ -0,0 +1,338 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// co_await next_frame() on asynchronous streams of the SDK stand-in, all coroutines on one
+// RunLoop: many streams at once, timeouts on stalled cameras which then recover, cancellation
+// before and during the wait and the end of synchronous streams. Every resume has to happen
+// on the loop thread. Needs C++20, the target is skipped on compilers without coroutines.
+
+#include "Check.h"
+#include "camera.h"
+
+#include <cdi/coro.h>
+
+#include <mfapi.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t WIDTH = 32;
+const uint32_t HEIGHT = 24;
+
+// Fire and forget coroutine, runs until its first suspension on the caller's thread
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+std::shared_ptr<sdk::Camera> add_camera(const uint32_t& fps)
+{
+    sdk::CameraDesc desc;
+    desc.formats.push_back({MFVideoFormat_NV12, WIDTH, HEIGHT, fps});
+    return sdk::add_camera(desc);
+}
+
+std::unique_ptr<cdi::IBuffer> open_async(const uint32_t& index)
+{
+    cdi::StreamOptions options;
+    options.asynchronous = true;
+    return cdi::open_device(index, WIDTH, HEIGHT, cdi::Encoding::I420, options);
+}
+
+// The loop gives up after a while so that a lost resume fails instead of hanging
+void run(cdi::coro::RunLoop& loop, bool& timed_out)
+{
+    timed_out = false;
+    loop.post_after(std::chrono::seconds(20), [&loop, &timed_out]() { timed_out = true; loop.stop(); });
+    loop.run();
+}
+
+struct Shared
+{
+    cdi::coro::RunLoop loop;
+    std::thread::id loop_thread;
+    uint32_t running = 0;
+    bool off_loop = false;
+
+    void done()
+    {
+        if(--running == 0)
+        {
+            loop.stop();
+        }
+    }
+
+    void resumed()
+    {
+        off_loop = off_loop || std::this_thread::get_id() != loop_thread;
+    }
+};
+
+Task read_frames(Shared& shared, cdi::IBuffer& buffer, const uint32_t frames, uint32_t& ready, bool& ordered)
+{
+    uint64_t last = 0;
+    for(uint32_t i = 0; i < frames; i++)
+    {
+        const cdi::coro::FrameStatus status = co_await cdi::coro::next_frame(buffer, shared.loop, std::chrono::seconds(5));
+        shared.resumed();
+        if(status != cdi::coro::FrameStatus::READY)
+        {
+            break;
+        }
+
+        // The frame is there, lock() does not wait
+        const Clock::time_point start = Clock::now();
+        ordered = ordered && buffer.lock() != nullptr && buffer.info().sequence > last;
+        last = buffer.info().sequence;
+        buffer.unlock();
+        ordered = ordered && Clock::now() - start < std::chrono::milliseconds(50);
+        ready++;
+    }
+    shared.done();
+}
+
+// Streams of differing frame rates read concurrently from one thread
+void check_many_streams()
+{
+    const uint32_t STREAMS = 16;
+    const uint32_t FRAMES = 10;
+
+    sdk::remove_cameras();
+    for(uint32_t i = 0; i < STREAMS; i++)
+    {
+        add_camera(100 + 25 * i);
+    }
+
+    std::vector<std::unique_ptr<cdi::IBuffer>> buffers;
+    for(uint32_t i = 0; i < STREAMS; i++)
+    {
+        buffers.push_back(open_async(i));
+        REQUIRE(buffers.back());
+    }
+
+    Shared shared;
+    shared.loop_thread = std::this_thread::get_id();
+    shared.running = STREAMS;
+    std::vector<uint32_t> ready(STREAMS, 0);
+    bool ordered = true;
+
+    for(uint32_t i = 0; i < STREAMS; i++)
+    {
+        read_frames(shared, *buffers[i], FRAMES, ready[i], ordered);
+    }
+
+    bool timed_out = false;
+    run(shared.loop, timed_out);
+    CHECK(!timed_out);
+    CHECK(!shared.off_loop);
+    CHECK(ordered);
+    for(uint32_t i = 0; i < STREAMS; i++)
+    {
+        CHECK(ready[i] == FRAMES);
+    }
+
+    buffers.clear();
+    sdk::remove_cameras();
+}
+
+Task wait_once(
+    Shared& shared,
+    cdi::IBuffer& buffer,
+    const Clock::duration timeout,
+    const cdi::coro::CancellationToken token,
+    cdi::coro::FrameStatus& status,
+    Clock::duration& waited)
+{
+    const Clock::time_point start = Clock::now();
+    status = co_await cdi::coro::next_frame(buffer, shared.loop, timeout, token);
+    waited = Clock::now() - start;
+    shared.resumed();
+    shared.done();
+}
+
+cdi::coro::FrameStatus wait_on_loop(
+    cdi::IBuffer& buffer,
+    const Clock::duration& timeout,
+    const cdi::coro::CancellationToken& token,
+    Clock::duration& waited,
+    bool& on_loop,
+    const std::function<void(cdi::coro::RunLoop&)>& meanwhile = nullptr)
+{
+    Shared shared;
+    shared.loop_thread = std::this_thread::get_id();
+    shared.running = 1;
+
+    cdi::coro::FrameStatus status = cdi::coro::FrameStatus::STOPPED;
+    wait_once(shared, buffer, timeout, token, status, waited);
+    if(meanwhile)
+    {
+        meanwhile(shared.loop);
+    }
+
+    bool timed_out = false;
+    run(shared.loop, timed_out);
+    on_loop = !timed_out && !shared.off_loop;
+    return status;
+}
+
+// Stalls the camera and takes the frames which were on their way, lock() of an asynchronous
+// stream waits for a new frame
+void stall(sdk::Camera& camera, cdi::IBuffer& buffer)
+{
+    camera.set_stalled(true);
+
+    Clock::duration waited;
+    bool on_loop = false;
+    while(wait_on_loop(buffer, std::chrono::milliseconds(30), cdi::coro::CancellationToken(), waited, on_loop) == cdi::coro::FrameStatus::READY)
+    {
+        buffer.lock();
+        buffer.unlock();
+    }
+}
+
+// A stalled camera times out, the same stream delivers again once the camera is back
+void check_timeout()
+{
+    sdk::remove_cameras();
+    std::shared_ptr<sdk::Camera> camera = add_camera(200);
+    std::unique_ptr<cdi::IBuffer> buffer = open_async(0);
+    REQUIRE(buffer);
+
+    Clock::duration waited;
+    bool on_loop = false;
+    stall(*camera, *buffer);
+
+    const cdi::coro::FrameStatus status = wait_on_loop(*buffer, std::chrono::milliseconds(80), cdi::coro::CancellationToken(), waited, on_loop);
+    CHECK(status == cdi::coro::FrameStatus::TIMEOUT);
+    CHECK(on_loop);
+    CHECK(waited >= std::chrono::milliseconds(80));
+    CHECK(waited < std::chrono::seconds(2));
+
+    camera->set_stalled(false);
+    CHECK(wait_on_loop(*buffer, std::chrono::seconds(5), cdi::coro::CancellationToken(), waited, on_loop) == cdi::coro::FrameStatus::READY);
+    CHECK(on_loop);
+
+    buffer.reset();
+    sdk::remove_cameras();
+}
+
+// Cancelled before the wait it returns right away, during the wait as soon as cancel() runs,
+// from the loop or from another thread
+void check_cancellation()
+{
+    sdk::remove_cameras();
+    std::shared_ptr<sdk::Camera> camera = add_camera(200);
+    std::unique_ptr<cdi::IBuffer> buffer = open_async(0);
+    REQUIRE(buffer);
+
+    Clock::duration waited;
+    bool on_loop = false;
+    stall(*camera, *buffer);
+
+
+    cdi::coro::CancellationSource early;
+    early.cancel();
+    CHECK(wait_on_loop(*buffer, Clock::duration::zero(), early.token(), waited, on_loop) == cdi::coro::FrameStatus::CANCELLED);
+    CHECK(on_loop);
+
+    cdi::coro::CancellationSource on_timer;
+    const cdi::coro::FrameStatus timer_status = wait_on_loop(*buffer, std::chrono::seconds(5), on_timer.token(), waited, on_loop,
+        [&on_timer](cdi::coro::RunLoop& loop) { loop.post_after(std::chrono::milliseconds(40), [&on_timer]() { on_timer.cancel(); }); });
+    CHECK(timer_status == cdi::coro::FrameStatus::CANCELLED);
+    CHECK(on_loop);
+    CHECK(waited >= std::chrono::milliseconds(40) && waited < std::chrono::seconds(2));
+
+    cdi::coro::CancellationSource other_thread;
+    std::thread canceller;
+    const cdi::coro::FrameStatus thread_status = wait_on_loop(*buffer, Clock::duration::zero(), other_thread.token(), waited, on_loop,
+        [&other_thread, &canceller](cdi::coro::RunLoop&)
+        {
+            canceller = std::thread([&other_thread]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(40));
+                other_thread.cancel();
+            });
+        });
+    canceller.join();
+    CHECK(thread_status == cdi::coro::FrameStatus::CANCELLED);
+    CHECK(on_loop);
+
+    // The stream is still usable after the cancelled waits
+    camera->set_stalled(false);
+    CHECK(wait_on_loop(*buffer, std::chrono::seconds(5), cdi::coro::CancellationToken(), waited, on_loop) == cdi::coro::FrameStatus::READY);
+    CHECK(on_loop);
+
+    buffer.reset();
+    sdk::remove_cameras();
+}
+
+// Synchronous streams have nothing to announce
+void check_synchronous()
+{
+    sdk::remove_cameras();
+    add_camera(200);
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::I420);
+    REQUIRE(buffer);
+
+    Clock::duration waited;
+    bool on_loop = false;
+    CHECK(wait_on_loop(*buffer, std::chrono::seconds(5), cdi::coro::CancellationToken(), waited, on_loop) == cdi::coro::FrameStatus::STOPPED);
+    CHECK(on_loop);
+
+    buffer.reset();
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_many_streams();
+    check_timeout();
+    check_cancellation();
+    check_synchronous();
+
+    return cdi::test::result("CoroTest");
+}
@@ -0,0 +1,329 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Demosaic of known Bayer mosaics: flat colors come back exactly in every pattern, bit depth and
+// method, bits above the sample width are ignored, bilinear matches a plain reference of the
+// nearest samples everywhere including the mirrored borders, strips and slices, and edge-aware
+// keeps a gray edge gray where bilinear puts false color next to it.
+
+#include "Check.h"
+#include "Demosaic.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+struct Color
+{
+    int r;
+    int g;
+    int b;
+};
+
+const cdi::BayerPattern PATTERNS[] = {
+    cdi::BayerPattern::RGGB,
+    cdi::BayerPattern::BGGR,
+    cdi::BayerPattern::GRBG,
+    cdi::BayerPattern::GBRG,
+};
+
+// 0 red, 1 green, 2 blue at a mosaic position
+int channel(const cdi::BayerPattern& pattern, const uint32_t& x, const uint32_t& y)
+{
+    static const int colors[4][4] = {
+        {0, 1, 1, 2}, // RGGB, top left 2x2 block row by row
+        {2, 1, 1, 0}, // BGGR
+        {1, 0, 2, 1}, // GRBG
+        {1, 2, 0, 1}, // GBRG
+    };
+    return colors[static_cast<int>(pattern)][(y & 1) * 2 + (x & 1)];
+}
+
+int component(const Color& color, const int& index)
+{
+    return index == 0 ? color.r : (index == 1 ? color.g : color.b);
+}
+
+// 8 bit scene samples in the layout of 'bits', wider ones low aligned with 'junk' above them
+template<typename Scene>
+std::vector<uint8_t> mosaic(
+    const cdi::BayerPattern& pattern,
+    const uint32_t& bits,
+    const uint32_t& width,
+    const uint32_t& height,
+    const uint16_t& junk,
+    Scene scene)
+{
+    const uint32_t bytes = bits == 8 ? 1 : 2;
+    std::vector<uint8_t> raw(static_cast<size_t>(width) * height * bytes);
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            const int value = component(scene(x, y), channel(pattern, x, y));
+            const size_t index = static_cast<size_t>(y) * width + x;
+            if(bytes == 1)
+            {
+                raw[index] = static_cast<uint8_t>(value);
+                continue;
+            }
+
+            const uint16_t sample = static_cast<uint16_t>((value << (bits - 8)) | junk);
+            std::memcpy(&raw[index * 2], &sample, 2);
+        }
+    }
+    return raw;
+}
+
+// Top-down B, G, R
+std::vector<uint8_t> run(
+    const std::vector<uint8_t>& raw,
+    const cdi::BayerPattern& pattern,
+    const uint32_t& bits,
+    const cdi::DemosaicMethod& method,
+    const uint32_t& width,
+    const uint32_t& height,
+    const uint32_t& threads)
+{
+    cdi::BayerFormat format;
+    format.pattern = pattern;
+    format.bits = bits;
+    cdi::DemosaicOptions options;
+    options.method = method;
+    options.threads = threads;
+
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+    cdi::Demosaic demosaic;
+    if(!demosaic.init(width, height, format, cdi::Encoding::RGB24, cdi::ColorSpace(), options, nullptr))
+    {
+        return std::vector<uint8_t>();
+    }
+
+    demosaic.run(raw.data(), static_cast<int32_t>(width * (bits == 8 ? 1 : 2)), rgb.data(), static_cast<int32_t>(width * 3));
+    return rgb;
+}
+
+// Mirrored around the first and last sample as the demosaic reads past the borders
+int reflect(int index, const int& size)
+{
+    while(index < 0 || index >= size)
+    {
+        index = index < 0 ? -index : 2 * (size - 1) - index;
+    }
+    return index;
+}
+
+// Bilinear at 12 bit, each missing color the mean of its nearest samples: the two in the row
+// or column of a green position, or the four around a red or blue one, truncated to 8 bit
+Color bilinear(const std::vector<uint8_t>& raw, const cdi::BayerPattern& pattern, const int& width, const int& height, const int& x, const int& y)
+{
+    auto at = [&](const int dx, const int dy)
+    {
+        const int sx = reflect(x + dx, width);
+        const int sy = reflect(y + dy, height);
+        return static_cast<double>(raw[static_cast<size_t>(sy) * width + sx] << 4);
+    };
+
+    const int own = channel(pattern, static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+    const int beside = channel(pattern, static_cast<uint32_t>(x + 1), static_cast<uint32_t>(y));
+    double values[3];
+    for(int c = 0; c < 3; c++)
+    {
+        if(c == own)
+        {
+            values[c] = at(0, 0);
+        }
+        else if(c == 1)
+        {
+            values[c] = (at(-1, 0) + at(1, 0) + at(0, -1) + at(0, 1)) / 4.0;
+        }
+        else if(own != 1)
+        {
+            values[c] = (at(-1, -1) + at(1, -1) + at(-1, 1) + at(1, 1)) / 4.0;
+        }
+        else if(c == beside)
+        {
+            values[c] = (at(-1, 0) + at(1, 0)) / 2.0;
+        }
+        else
+        {
+            values[c] = (at(0, -1) + at(0, 1)) / 2.0;
+        }
+    }
+
+    Color result = {static_cast<int>(values[0]) >> 4, static_cast<int>(values[1]) >> 4, static_cast<int>(values[2]) >> 4};
+    return result;
+}
+
+Color pixel(const std::vector<uint8_t>& rgb, const uint32_t& width, const uint32_t& x, const uint32_t& y)
+{
+    const uint8_t* p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+    Color result = {p[2], p[1], p[0]};
+    return result;
+}
+
+void test_flat()
+{
+    // Odd sizes, the mosaic phase of the last row and column differs from the first
+    const uint32_t width = 37;
+    const uint32_t height = 21;
+    const Color color = {200, 100, 50};
+    auto scene = [&color](const uint32_t, const uint32_t) { return color; };
+
+    const cdi::DemosaicMethod methods[] = {cdi::DemosaicMethod::BILINEAR, cdi::DemosaicMethod::EDGE_AWARE};
+    for(const cdi::BayerPattern& pattern : PATTERNS)
+    {
+        for(const uint32_t bits : {8u, 10u, 12u, 16u})
+        {
+            // Samples narrower than 16 bit carry junk in the bits above them
+            const uint16_t junk = bits < 16 && bits > 8 ? static_cast<uint16_t>(0xFFFF << bits) : 0;
+            const std::vector<uint8_t> raw = mosaic(pattern, bits, width, height, junk, scene);
+            for(const cdi::DemosaicMethod& method : methods)
+            {
+                const std::vector<uint8_t> rgb = run(raw, pattern, bits, method, width, height, 1);
+                REQUIRE(!rgb.empty());
+
+                bool exact = true;
+                for(uint32_t y = 0; y < height; y++)
+                {
+                    for(uint32_t x = 0; x < width; x++)
+                    {
+                        const Color p = pixel(rgb, width, x, y);
+                        exact = exact && p.r == color.r && p.g == color.g && p.b == color.b;
+                    }
+                }
+                CHECK(exact);
+            }
+        }
+    }
+}
+
+void test_bilinear()
+{
+    // Past one strip of 256 columns and over several slices of at least 16 rows
+    const uint32_t width = 301;
+    const uint32_t height = 67;
+    auto scene = [](const uint32_t x, const uint32_t y)
+    {
+        const uint32_t hash = (x * 2654435761u) ^ (y * 40503u);
+        Color color = {
+            static_cast<int>((x * 3 + y) % 256),
+            static_cast<int>((hash >> 8) % 256),
+            static_cast<int>((x + y * 5) % 256)};
+        return color;
+    };
+
+    for(const cdi::BayerPattern& pattern : PATTERNS)
+    {
+        const std::vector<uint8_t> raw = mosaic(pattern, 8, width, height, 0, scene);
+        for(const uint32_t threads : {1u, 3u})
+        {
+            const std::vector<uint8_t> rgb = run(raw, pattern, 8, cdi::DemosaicMethod::BILINEAR, width, height, threads);
+            REQUIRE(!rgb.empty());
+
+            // The rounding of the averages adds up to one 12 bit step
+            int worst = 0;
+            for(uint32_t y = 0; y < height; y++)
+            {
+                for(uint32_t x = 0; x < width; x++)
+                {
+                    const Color expected = bilinear(raw, pattern, static_cast<int>(width), static_cast<int>(height), static_cast<int>(x), static_cast<int>(y));
+                    const Color p = pixel(rgb, width, x, y);
+                    worst = std::max(worst, std::abs(p.r - expected.r));
+                    worst = std::max(worst, std::abs(p.g - expected.g));
+                    worst = std::max(worst, std::abs(p.b - expected.b));
+                }
+            }
+            CHECK(worst <= 1);
+        }
+    }
+}
+
+void test_edge()
+{
+    // A vertical gray edge, bright left of column 'edge' and dark from there on
+    const uint32_t width = 40;
+    const uint32_t height = 24;
+    const uint32_t edge = 19;
+    auto scene = [edge](const uint32_t x, const uint32_t)
+    {
+        const int value = x < edge ? 200 : 40;
+        Color color = {value, value, value};
+        return color;
+    };
+
+    for(const cdi::BayerPattern& pattern : PATTERNS)
+    {
+        const std::vector<uint8_t> raw = mosaic(pattern, 8, width, height, 0, scene);
+        const std::vector<uint8_t> edge_aware = run(raw, pattern, 8, cdi::DemosaicMethod::EDGE_AWARE, width, height, 1);
+        const std::vector<uint8_t> plain = run(raw, pattern, 8, cdi::DemosaicMethod::BILINEAR, width, height, 1);
+        REQUIRE(!edge_aware.empty() && !plain.empty());
+
+        // Largest difference between the colors of a pixel
+        int edge_aware_color = 0;
+        int plain_color = 0;
+        bool exact = true;
+        for(uint32_t y = 0; y < height; y++)
+        {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                const Color p = pixel(edge_aware, width, x, y);
+                const Color q = pixel(plain, width, x, y);
+                edge_aware_color = std::max(edge_aware_color, std::max(std::abs(p.r - p.g), std::abs(p.b - p.g)));
+                plain_color = std::max(plain_color, std::max(std::abs(q.r - q.g), std::abs(q.b - q.g)));
+
+                const int expected = component(scene(x, y), 1);
+                const bool away = x + 2 < edge || x > edge + 1;
+                exact = exact && (!away || (p.r == expected && p.g == expected && p.b == expected));
+            }
+        }
+
+        // Bilinear mixes the colors of both sides, a fringe of half the step
+        CHECK(exact);
+        CHECK(edge_aware_color <= 2);
+        CHECK(plain_color >= 40);
+    }
+}
+
+}
+
+int main()
+{
+    test_flat();
+    test_bilinear();
+    test_edge();
+
+    return cdi::test::result("DemosaicTest");
+}
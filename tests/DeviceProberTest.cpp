@@ -0,0 +1,248 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// The prober with probes which take their time: a probe missing its deadline is reported as
+// timed out, neither holds up the run nor the bound, its late result is dropped and its thread
+// is joined by drain(). probe_all() on cameras of the SDK stand-in which activate slowly.
+
+#include "Check.h"
+#include "DeviceProber.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t TIMEOUT_MS = 100;
+const uint32_t SLOW_MS = 400;
+const uint32_t FAST_MS = 10;
+
+double elapsed_ms(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Device 1 misses the deadline, the others report a format
+void check_timeout()
+{
+    std::atomic<uint32_t> late(0);
+
+    cdi::ProbeOptions options;
+    options.threads = 2;
+    options.timeout_ms = TIMEOUT_MS;
+    cdi::DeviceProber prober(options);
+
+    const Clock::time_point start = Clock::now();
+    const std::vector<cdi::DeviceCapabilities> results = prober.run(4,
+        [&late](const uint32_t& index, cdi::DeviceCapabilities& capabilities)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(index == 1 ? SLOW_MS : FAST_MS));
+        capabilities.name = L"camera";
+        capabilities.formats.push_back(cdi::DeviceFormat());
+        capabilities.status = cdi::ProbeStatus::OK;
+        if(index == 1)
+        {
+            late++;
+        }
+    });
+    const double ms = elapsed_ms(start);
+
+    REQUIRE(results.size() == 4);
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        CHECK(results[i].index == i);
+        if(i == 1)
+        {
+            CHECK(results[i].status == cdi::ProbeStatus::TIMEOUT);
+            CHECK(results[i].duration >= TIMEOUT_MS * 10000);
+        }
+        else
+        {
+            CHECK(results[i].status == cdi::ProbeStatus::OK);
+            CHECK(results[i].formats.size() == 1);
+        }
+    }
+
+    // Back at the deadline rather than with the slow probe
+    CHECK(ms >= TIMEOUT_MS);
+    CHECK(ms < SLOW_MS - FAST_MS * 4);
+    CHECK(late == 0);
+
+    // The straggler is still running, then returns and is joined
+    CHECK(cdi::DeviceProber::drain(0) == 1);
+    CHECK(cdi::DeviceProber::drain(SLOW_MS * 2) == 0);
+    CHECK(late == 1);
+
+    // Its result stayed out of the returned ones
+    CHECK(results[1].formats.empty());
+    CHECK(results[1].name.empty());
+}
+
+// No more than 'threads' probes at a time, a timed out probe frees its slot
+void check_bound()
+{
+    std::atomic<uint32_t> active(0);
+    std::atomic<uint32_t> peak(0);
+
+    cdi::ProbeOptions options;
+    options.threads = 3;
+    options.timeout_ms = TIMEOUT_MS;
+    cdi::DeviceProber prober(options);
+
+    const Clock::time_point start = Clock::now();
+    const std::vector<cdi::DeviceCapabilities> results = prober.run(9,
+        [&active, &peak](const uint32_t& index, cdi::DeviceCapabilities& capabilities)
+    {
+        const uint32_t now = ++active;
+        uint32_t seen = peak;
+        while(now > seen && !peak.compare_exchange_weak(seen, now))
+        {
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(index == 0 ? SLOW_MS : FAST_MS * 2));
+        capabilities.status = cdi::ProbeStatus::OK;
+        active--;
+    });
+    const double ms = elapsed_ms(start);
+
+    REQUIRE(results.size() == 9);
+    CHECK(results[0].status == cdi::ProbeStatus::TIMEOUT);
+    for(uint32_t i = 1; i < 9; i++)
+    {
+        CHECK(results[i].status == cdi::ProbeStatus::OK);
+    }
+
+    // The slot of the slow probe was held until its deadline only
+    CHECK(peak <= 3 + 1);
+    CHECK(ms < SLOW_MS - FAST_MS * 4);
+
+    CHECK(cdi::DeviceProber::drain(SLOW_MS * 2) == 0);
+    CHECK(active == 0);
+}
+
+// Without a timeout every probe finishes, nothing is left behind
+void check_no_timeout()
+{
+    cdi::ProbeOptions options;
+    options.threads = 0;
+    options.timeout_ms = 0;
+    cdi::DeviceProber prober(options);
+
+    const std::vector<cdi::DeviceCapabilities> results = prober.run(3,
+        [](const uint32_t& index, cdi::DeviceCapabilities& capabilities)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(FAST_MS * (index + 1)));
+        capabilities.status = cdi::ProbeStatus::OK;
+    });
+
+    REQUIRE(results.size() == 3);
+    for(const cdi::DeviceCapabilities& result : results)
+    {
+        CHECK(result.status == cdi::ProbeStatus::OK);
+    }
+    CHECK(cdi::DeviceProber::drain(0) == 0);
+}
+
+sdk::CameraDesc camera(const wchar_t* name, const uint32_t& activate_ms, const bool& fails)
+{
+    sdk::CameraDesc desc;
+    desc.name = name;
+    desc.formats.push_back({MFVideoFormat_NV12, 320, 240, 30});
+    desc.formats.push_back({MFVideoFormat_YUY2, 640, 480, 15});
+    desc.activate_ms = activate_ms;
+    desc.activate_fails = fails;
+    return desc;
+}
+
+// A fast, a slow and a broken camera
+void check_probe_all()
+{
+    sdk::remove_cameras();
+    std::shared_ptr<sdk::Camera> fast = sdk::add_camera(camera(L"fast", FAST_MS, false));
+    std::shared_ptr<sdk::Camera> slow = sdk::add_camera(camera(L"slow", SLOW_MS, false));
+    std::shared_ptr<sdk::Camera> broken = sdk::add_camera(camera(L"broken", FAST_MS, true));
+
+    cdi::ProbeOptions options;
+    options.timeout_ms = TIMEOUT_MS;
+
+    const Clock::time_point start = Clock::now();
+    const std::vector<cdi::DeviceCapabilities> results = cdi::probe_all(options);
+    const double ms = elapsed_ms(start);
+
+    REQUIRE(results.size() == 3);
+
+    CHECK(results[0].status == cdi::ProbeStatus::OK);
+    CHECK(results[0].name == L"fast");
+    REQUIRE(results[0].formats.size() == 2);
+    CHECK(results[0].formats[0].width == 320 && results[0].formats[0].height == 240);
+    CHECK(results[0].formats[0].framerate == 30);
+    CHECK(results[0].formats[0].format == "MFVideoFormat_NV12");
+    CHECK(results[0].formats[1].format == "MFVideoFormat_YUY2");
+
+    CHECK(results[1].status == cdi::ProbeStatus::TIMEOUT);
+    CHECK(results[1].formats.empty());
+
+    CHECK(results[2].status == cdi::ProbeStatus::FAILED);
+    CHECK(results[2].name == L"broken");
+    CHECK(results[2].formats.empty());
+
+    CHECK(ms < SLOW_MS);
+
+    // The slow activation completes in the background and its source is shut down with it
+    CHECK(cdi::DeviceProber::drain(SLOW_MS * 2) == 0);
+    CHECK(slow->activations() == 1);
+    CHECK(slow->shutdowns() == slow->activations());
+    CHECK(fast->shutdowns() == fast->activations());
+
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_timeout();
+    check_bound();
+    check_no_timeout();
+    check_probe_all();
+
+    return cdi::test::result("DeviceProberTest");
+}
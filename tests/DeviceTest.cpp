@@ -0,0 +1,262 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// read_into() against lock() on cameras of the SDK stand-in: the same frame read both ways is
+// byte-equal for natural and padded strides, bottom-up and top-down RGB, through the Color
+// Converter DSP and through the own kernels. The DSP writes straight into the caller memory
+// through IMF2DBuffer, a DSP which only knows Lock() is refused padded memory and the frame
+// takes the copy out of the internal one.
+
+#include "Check.h"
+#include "ExternalBuffer.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 64;
+const uint32_t HEIGHT = 48;
+const uint8_t UNTOUCHED = 0xEE;
+
+struct Case
+{
+    const char* name;
+    GUID camera_format;
+    uint32_t camera_padding;
+    cdi::Encoding encoding;
+    cdi::StreamOptions options;
+    bool dsp;
+};
+
+Case make_case(const char* name, const GUID& camera_format, const uint32_t& camera_padding, const cdi::Encoding& encoding, const bool& dsp)
+{
+    Case result;
+    result.name = name;
+    result.camera_format = camera_format;
+    result.camera_padding = camera_padding;
+    result.encoding = encoding;
+    result.dsp = dsp;
+    return result;
+}
+
+std::shared_ptr<sdk::Camera> add_camera(const Case& test_case)
+{
+    sdk::remove_cameras();
+
+    sdk::CameraDesc desc;
+    desc.formats.push_back({test_case.camera_format, WIDTH, HEIGHT, 500});
+    desc.row_padding = test_case.camera_padding;
+    return sdk::add_camera(desc);
+}
+
+// Bytes of the rows of every plane as lock() lays them out
+struct Rows
+{
+    uint32_t count;
+    uint32_t bytes;
+};
+
+std::vector<Rows> plane_rows(const cdi::Encoding& encoding)
+{
+    if(encoding == cdi::Encoding::I420)
+    {
+        return {{HEIGHT, WIDTH}, {HEIGHT / 2, WIDTH / 2}, {HEIGHT / 2, WIDTH / 2}};
+    }
+
+    return {{HEIGHT, WIDTH * (encoding == cdi::Encoding::RGB24 ? 3u : 4u)}};
+}
+
+// First frame of a fresh stream through lock()
+bool read_locked(const Case& test_case, std::vector<uint8_t>& frame, uint64_t& sequence)
+{
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, test_case.encoding, test_case.options);
+    if(!buffer)
+    {
+        return false;
+    }
+
+    const uint8_t* data = static_cast<const uint8_t*>(buffer->lock());
+    if(data == nullptr)
+    {
+        return false;
+    }
+
+    frame.assign(data, data + buffer->size());
+    sequence = buffer->info().sequence;
+    buffer->unlock();
+    return true;
+}
+
+void check_case(const Case& test_case, const bool& plain_lock_dsp)
+{
+    std::fprintf(stderr, "%s%s\n", test_case.name, plain_lock_dsp ? ", DSP without IMF2DBuffer" : "");
+
+    add_camera(test_case);
+    sdk::set_converter_plain_lock(plain_lock_dsp);
+
+    std::vector<uint8_t> expected;
+    uint64_t expected_sequence = 0;
+    REQUIRE(read_locked(test_case, expected, expected_sequence));
+
+    const std::vector<Rows> rows = plane_rows(test_case.encoding);
+    for(const uint32_t padding : {0u, 24u})
+    {
+        std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, test_case.encoding, test_case.options);
+        REQUIRE(buffer);
+        CHECK((sdk::converter_instances() > 0) == test_case.dsp);
+
+        // Chroma planes of I420 take half of the stride
+        const size_t stride = rows[0].bytes + padding;
+        size_t size = 0;
+        for(const Rows& plane : rows)
+        {
+            size += stride * plane.bytes / rows[0].bytes * plane.count;
+        }
+
+        std::vector<uint8_t> frame(size, UNTOUCHED);
+        REQUIRE(buffer->read_into(frame.data(), stride));
+        CHECK(buffer->info().sequence == expected_sequence);
+
+        const uint8_t* src = expected.data();
+        const uint8_t* dst = frame.data();
+        bool equal = true;
+        bool padding_untouched = true;
+        for(const Rows& plane : rows)
+        {
+            const size_t plane_stride = stride * plane.bytes / rows[0].bytes;
+            for(uint32_t row = 0; row < plane.count; row++)
+            {
+                equal = equal && std::memcmp(src, dst, plane.bytes) == 0;
+                for(size_t i = plane.bytes; i < plane_stride; i++)
+                {
+                    padding_untouched = padding_untouched && dst[i] == UNTOUCHED;
+                }
+                src += plane.bytes;
+                dst += plane_stride;
+            }
+        }
+        CHECK(equal);
+        CHECK(padding_untouched);
+    }
+
+    sdk::set_converter_plain_lock(false);
+}
+
+void check_read_into()
+{
+    std::vector<Case> cases;
+
+    // The DSP, for 8 bit YUV to bottom-up RGB and I420 with the default matrix
+    cases.push_back(make_case("YUY2 to RGB24, DSP", MFVideoFormat_YUY2, 0, cdi::Encoding::RGB24, true));
+    cases.push_back(make_case("YUY2 to RGBA32, DSP", MFVideoFormat_YUY2, 0, cdi::Encoding::RGBA32, true));
+    cases.push_back(make_case("NV12 to RGB24, DSP, padded camera rows", MFVideoFormat_NV12, 16, cdi::Encoding::RGB24, true));
+    cases.push_back(make_case("NV12 to I420, DSP", MFVideoFormat_NV12, 0, cdi::Encoding::I420, true));
+
+    // Own kernels, for top-down RGB and for matrices the DSP does not know
+    Case top_down = make_case("YUY2 to top-down RGB24, kernel", MFVideoFormat_YUY2, 0, cdi::Encoding::RGB24, false);
+    top_down.options.orientation.top_down = true;
+    cases.push_back(top_down);
+
+    Case top_down_padded = make_case("NV12 to top-down RGBA32, kernel, padded camera rows", MFVideoFormat_NV12, 32, cdi::Encoding::RGBA32, false);
+    top_down_padded.options.orientation.top_down = true;
+    cases.push_back(top_down_padded);
+
+    Case bt2020 = make_case("YUY2 to RGB24, BT.2020 kernel", MFVideoFormat_YUY2, 0, cdi::Encoding::RGB24, false);
+    bt2020.options.color = cdi::ColorSpace(cdi::ColorMatrix::BT2020, cdi::ColorRange::LIMITED);
+    cases.push_back(bt2020);
+
+    Case mirrored_i420 = make_case("NV12 to mirrored I420, kernel", MFVideoFormat_NV12, 0, cdi::Encoding::I420, false);
+    mirrored_i420.options.orientation.mirror_horizontal = true;
+    cases.push_back(mirrored_i420);
+
+    Case rotated = make_case("YUY2 to RGB24 rotated twice, kernel", MFVideoFormat_YUY2, 0, cdi::Encoding::RGB24, false);
+    rotated.options.orientation.rotation = cdi::Rotation::CLOCKWISE_180;
+    cases.push_back(rotated);
+
+    for(const Case& test_case : cases)
+    {
+        check_case(test_case, false);
+        if(test_case.dsp)
+        {
+            check_case(test_case, true);
+        }
+    }
+
+    sdk::remove_cameras();
+}
+
+// Writers without the pitch only get the memory when the rows are packed, nothing after detach()
+void check_external_buffer()
+{
+    std::vector<uint8_t> memory(WIDTH * 3 * HEIGHT + 64 * HEIGHT, 0);
+    const LONG pitch = WIDTH * 3 + 64;
+    uint8_t* last_row = memory.data() + pitch * (HEIGHT - 1);
+
+    cdi::ExternalBuffer* padded = new cdi::ExternalBuffer(memory.data(), memory.size(), last_row, -pitch, false);
+    BYTE* data = nullptr;
+    DWORD max_length = 0;
+    CHECK(padded->Lock(&data, &max_length, nullptr) == MF_E_INVALIDREQUEST);
+
+    IMF2DBuffer* buffer_2d = nullptr;
+    REQUIRE(SUCCEEDED(padded->QueryInterface(IID_PPV_ARGS(&buffer_2d))));
+    LONG locked_pitch = 0;
+    CHECK(SUCCEEDED(buffer_2d->Lock2D(&data, &locked_pitch)));
+    CHECK(data == last_row && locked_pitch == -pitch);
+    buffer_2d->Unlock2D();
+
+    padded->detach();
+    CHECK(FAILED(buffer_2d->Lock2D(&data, &locked_pitch)));
+    buffer_2d->Release();
+    padded->Release();
+
+    cdi::ExternalBuffer* packed = new cdi::ExternalBuffer(memory.data(), WIDTH * 3 * HEIGHT, memory.data(), WIDTH * 3, true);
+    CHECK(SUCCEEDED(packed->Lock(&data, &max_length, nullptr)));
+    CHECK(data == memory.data() && max_length == WIDTH * 3 * HEIGHT);
+    packed->Unlock();
+    packed->detach();
+    CHECK(FAILED(packed->Lock(&data, &max_length, nullptr)));
+    packed->Release();
+}
+
+}
+
+int main()
+{
+    check_read_into();
+    check_external_buffer();
+
+    return cdi::test::result("DeviceTest");
+}
@@ -0,0 +1,305 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Luma statistics against a plain per sample reference: every step the native layouts use,
+// widths around the SIMD block sizes and luma interleaved with bytes which must not count.
+// The statistics the conversion kernels accumulate equal those of the pass of their own.
+
+#include "Check.h"
+#include "ColorKernels.h"
+#include "FrameStats.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+
+namespace {
+
+struct Reference
+{
+    Reference() : histogram(), samples(0), horizontal(0), horizontal_samples(0), vertical(0), vertical_samples(0) {}
+    uint64_t histogram[256];
+    uint64_t samples;
+    uint64_t horizontal;
+    uint64_t horizontal_samples;
+    uint64_t vertical;
+    uint64_t vertical_samples;
+};
+
+// Luma at every 'step' bytes, the bytes between are filled with noise
+std::vector<uint8_t> render(const uint32_t& width, const uint32_t& height, const uint32_t& step, uint32_t seed)
+{
+    std::vector<uint8_t> frame(static_cast<size_t>(width) * height * step);
+    for(size_t i = 0; i < frame.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        frame[i] = static_cast<uint8_t>(seed >> 16);
+    }
+    return frame;
+}
+
+Reference reference(
+    const std::vector<uint8_t>& frame,
+    const uint32_t& width,
+    const uint32_t& height,
+    const uint32_t& step,
+    const uint32_t& offset)
+{
+    Reference result;
+    const size_t pitch = static_cast<size_t>(width) * step;
+    for(uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = frame.data() + offset + pitch * y;
+        for(uint32_t x = 0; x < width; x++)
+        {
+            result.histogram[row[x * step]]++;
+            result.samples++;
+            if(x + 1 < width)
+            {
+                result.horizontal += static_cast<uint64_t>(std::abs(row[x * step] - row[(x + 1) * step]));
+                result.horizontal_samples++;
+            }
+            if(y > 0)
+            {
+                result.vertical += static_cast<uint64_t>(std::abs(row[x * step] - row[x * step - pitch]));
+                result.vertical_samples++;
+            }
+        }
+    }
+    return result;
+}
+
+// 'offset' is the byte of the pixel which holds the luma, the frame ends right after the last pixel
+void compare(const uint32_t& width, const uint32_t& height, const uint32_t& step, const uint32_t& offset)
+{
+    const std::vector<uint8_t> frame = render(width, height, step, width * 31 + height * 7 + step);
+    const Reference expected = reference(frame, width, height, step, offset);
+
+    cdi::StatisticsOptions options;
+    options.enabled = true;
+    options.clip_low = 16;
+    options.clip_high = 235;
+
+    cdi::FrameStats stats;
+    stats.begin();
+    const size_t pitch = static_cast<size_t>(width) * step;
+    const uint8_t* prev = nullptr;
+    for(uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = frame.data() + offset + pitch * y;
+        stats.accumulate_row(row, prev, width, step);
+        prev = row;
+    }
+    stats.finish(options);
+    const cdi::FrameStatistics& result = stats.result();
+
+    bool histogram = true;
+    uint64_t sum = 0;
+    uint64_t clipped = 0;
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        histogram = histogram && result.histogram[i] == expected.histogram[i];
+        sum += expected.histogram[i] * i;
+        clipped += i <= options.clip_low || i >= options.clip_high ? expected.histogram[i] : 0;
+    }
+
+    double sharpness = 0.0;
+    if(expected.horizontal_samples > 0)
+    {
+        sharpness += static_cast<double>(expected.horizontal) / expected.horizontal_samples;
+    }
+    if(expected.vertical_samples > 0)
+    {
+        sharpness += static_cast<double>(expected.vertical) / expected.vertical_samples;
+    }
+
+    CHECK(histogram);
+    CHECK(result.samples == expected.samples);
+    CHECK(std::fabs(result.mean - static_cast<double>(sum) / expected.samples) < 1e-3);
+    CHECK(std::fabs(result.clipped - static_cast<double>(clipped) / expected.samples) < 1e-6);
+    CHECK(std::fabs(result.sharpness - sharpness) < 1e-3);
+}
+
+void test_layouts()
+{
+    // Planar luma, 4:2:2 and high bytes of 16 bit samples, packed RGB and RGB32
+    for(const uint32_t step : {1u, 2u, 3u, 4u})
+    {
+        for(const uint32_t width : {1u, 2u, 9u, 10u, 15u, 16u, 17u, 18u, 33u, 64u, 101u})
+        {
+            for(const uint32_t height : {1u, 2u, 7u})
+            {
+                compare(width, height, step, 0);
+                compare(width, height, step, step - 1);
+            }
+        }
+    }
+}
+
+// The pass of Device::inspect() over the luma of a padded frame
+cdi::FrameStatistics separate(
+    const std::vector<uint8_t>& frame,
+    const uint32_t& width,
+    const uint32_t& height,
+    const int32_t& pitch,
+    const uint32_t& step,
+    const cdi::StatisticsOptions& options)
+{
+    cdi::FrameStats stats;
+    stats.begin();
+    const uint8_t* prev = nullptr;
+    for(uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = frame.data() + static_cast<ptrdiff_t>(pitch) * y;
+        stats.accumulate_row(row, prev, width, step);
+        prev = row;
+    }
+    stats.finish(options);
+    return stats.result();
+}
+
+bool same(const cdi::FrameStatistics& a, const cdi::FrameStatistics& b)
+{
+    bool equal = a.samples == b.samples && a.mean == b.mean && a.clipped == b.clipped && a.sharpness == b.sharpness;
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        equal = equal && a.histogram[i] == b.histogram[i];
+    }
+    return equal;
+}
+
+void test_fused()
+{
+    // Several bands and a row pitch with padding, the padding must not count
+    const uint32_t WIDTH = 36;
+    const uint32_t HEIGHT = 38;
+    const uint32_t PADDING = 12;
+
+    cdi::StatisticsOptions options;
+    options.enabled = true;
+
+    struct Source
+    {
+        cdi::kernels::YuvFormat format;
+        uint32_t step;
+    };
+    const Source sources[] = {
+        {cdi::kernels::YuvFormat::I420, 1},
+        {cdi::kernels::YuvFormat::NV12, 1},
+        {cdi::kernels::YuvFormat::YUY2, 2},
+    };
+
+    cdi::ColorSpace color(cdi::ColorMatrix::BT2020, cdi::ColorRange::FULL);
+    cdi::OrientationOptions rotated;
+    rotated.rotation = cdi::Rotation::CLOCKWISE_90;
+
+    for(const Source& source : sources)
+    {
+        const int32_t pitch = static_cast<int32_t>(WIDTH * source.step + PADDING);
+        const uint32_t rows = source.format == cdi::kernels::YuvFormat::YUY2 ? HEIGHT : HEIGHT * 3 / 2;
+        const std::vector<uint8_t> frame = render(static_cast<uint32_t>(pitch), rows, 1, WIDTH + source.step);
+        const cdi::FrameStatistics expected = separate(frame, WIDTH, HEIGHT, pitch, source.step, options);
+
+        cdi::FrameStats stats;
+        std::vector<uint8_t> rgb(static_cast<size_t>(WIDTH) * HEIGHT * 4);
+        const cdi::kernels::YuvToRgb kernel = cdi::kernels::find_yuv_to_rgb(source.format, cdi::Encoding::RGBA32, color);
+        REQUIRE(kernel != nullptr);
+        stats.begin();
+        kernel(frame.data(), pitch, rgb.data(), static_cast<int32_t>(WIDTH * 4), WIDTH, HEIGHT, &stats);
+        stats.finish(options);
+        CHECK(same(stats.result(), expected));
+
+        // Rotated to RGB and to I420, the statistics are those of the source
+        std::vector<uint8_t> band(cdi::kernels::oriented_band_size(WIDTH));
+        const cdi::Encoding outputs[] = {cdi::Encoding::RGB24, cdi::Encoding::I420};
+        for(const cdi::Encoding& output : outputs)
+        {
+            const cdi::kernels::OrientedYuv oriented = cdi::kernels::find_oriented_yuv(source.format, output, color);
+            REQUIRE(oriented != nullptr);
+
+            cdi::kernels::PixelMap planes[3];
+            if(output == cdi::Encoding::I420)
+            {
+                uint8_t* u = rgb.data() + HEIGHT * WIDTH;
+                uint8_t* v = u + HEIGHT * WIDTH / 4;
+                planes[0] = cdi::kernels::map_pixels(rotated, rgb.data(), HEIGHT, WIDTH, HEIGHT, 1);
+                planes[1] = cdi::kernels::map_pixels(rotated, u, HEIGHT / 2, WIDTH / 2, HEIGHT / 2, 1);
+                planes[2] = cdi::kernels::map_pixels(rotated, v, HEIGHT / 2, WIDTH / 2, HEIGHT / 2, 1);
+            }
+            else
+            {
+                planes[0] = cdi::kernels::map_pixels(rotated, rgb.data(), HEIGHT * 3, WIDTH, HEIGHT, 3);
+            }
+
+            stats.begin();
+            oriented(frame.data(), pitch, planes, WIDTH, HEIGHT, band.data(), &stats);
+            stats.finish(options);
+            CHECK(same(stats.result(), expected));
+        }
+    }
+}
+
+void test_reuse()
+{
+    // begin() starts over, nothing of the previous frame remains
+    cdi::StatisticsOptions options;
+    const std::vector<uint8_t> bright(64, 200);
+    const std::vector<uint8_t> dark(64, 10);
+
+    cdi::FrameStats stats;
+    stats.accumulate_row(bright.data(), nullptr, 64, 1);
+    stats.finish(options);
+    CHECK(stats.result().mean == 200.0f);
+    CHECK(stats.result().sharpness == 0.0f);
+
+    stats.begin();
+    stats.accumulate_row(dark.data(), nullptr, 64, 1);
+    stats.accumulate_row(bright.data(), dark.data(), 64, 1);
+    stats.finish(options);
+    CHECK(stats.result().samples == 128);
+    CHECK(stats.result().histogram[10] == 64);
+    CHECK(stats.result().histogram[200] == 64);
+    CHECK(stats.result().mean == 105.0f);
+    CHECK(stats.result().sharpness == 190.0f);
+    CHECK(stats.result().clipped == 0.0f);
+}
+
+}
+
+int main()
+{
+    test_layouts();
+    test_fused();
+    test_reuse();
+
+    return cdi::test::result("FrameStatsTest");
+}
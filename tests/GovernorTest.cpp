@@ -0,0 +1,355 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// The governor with made up times and loads over streams which only count: pressure and headroom
+// have to last before a step, nothing changes within the settle time or between the two
+// thresholds, the order of the steps, which stream goes first, lagging streams and refused steps.
+
+#include "Check.h"
+#include "Governor.h"
+
+#include <cdi/cdi.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace {
+
+const int64_t MS = 10000; // clock_now() units
+const int64_t FRAME_INTERVAL = 333333;
+
+// Only what the governor looks at, the load is advanced by the test
+class FakeBuffer : public cdi::IBuffer
+{
+public:
+    FakeBuffer() : refuse(false) { load_.frame_interval = FRAME_INTERVAL; }
+
+    // 'frames' more frames delivered, each converted in 'convert' and delivered 'latency' after its capture
+    void advance(const uint64_t& frames, const int64_t& convert, const int64_t& latency)
+    {
+        load_.frames += frames;
+        load_.delivered += frames;
+        load_.convert_time += convert * static_cast<int64_t>(frames);
+        load_.latency += latency * static_cast<int64_t>(frames);
+    }
+
+    uint32_t width() const override { return 0; }
+    uint32_t height() const override { return 0; }
+    cdi::Encoding encoding() const override { return cdi::Encoding::I420; }
+    size_t size() const override { return 0; }
+    int64_t timestamp() const override { return 0; }
+    const void* lock() override { return nullptr; }
+    void unlock() override {}
+    uint32_t level_count() const override { return 0; }
+    cdi::FrameLevel level(const uint32_t&) const override { return cdi::FrameLevel(); }
+    cdi::FrameInfo info() const override { return cdi::FrameInfo(); }
+    bool read_into(void*, const size_t&) override { return false; }
+    bool read_into(const cdi::FramePlane*, const uint32_t&) override { return false; }
+    bool notify_frame(const std::function<void(bool)>&) override { return false; }
+    void cancel_notify() override {}
+    cdi::OpenTimings open_timings() const override { return cdi::OpenTimings(); }
+    bool reconfigure(const uint32_t&, const uint32_t&, const cdi::Encoding&) override { return false; }
+    cdi::ThreadPlacement placement() const override { return cdi::ThreadPlacement(); }
+    cdi::RecoveryStatistics recovery() const override { return cdi::RecoveryStatistics(); }
+    cdi::StreamLoad load() const override { return load_; }
+    cdi::CaptureQuality quality() const override { return quality_; }
+    size_t snapshot_jpeg(const cdi::JpegOptions&, void*, const size_t&) override { return 0; }
+    bool dump(const int64_t&, const std::wstring&, std::unique_ptr<cdi::ICodec>) override { return false; }
+
+    bool set_quality(const cdi::CaptureQuality& quality) override
+    {
+        if(refuse)
+        {
+            return false;
+        }
+        quality_ = quality;
+        return true;
+    }
+
+    bool refuse;
+
+private:
+    cdi::StreamLoad load_;
+    cdi::CaptureQuality quality_;
+};
+
+// The thread of the governor never gets to look, the tests call update() themselves
+struct Fixture
+{
+    Fixture()
+    {
+        cdi::GovernorOptions options;
+        options.interval_ms = 3600 * 1000;
+        options.high_cpu = 0.85f;
+        options.low_cpu = 0.6f;
+        options.down_ms = 1000;
+        options.up_ms = 10000;
+        options.settle_ms = 2000;
+        options.max_frame_divisor = 4;
+        options.cheap_format = true;
+        options.max_resolution_steps = 2;
+
+        governor = std::make_unique<cdi::Governor>();
+        governor->init(options, [this](const cdi::GovernorEvent& event) { events.push_back(event); });
+    }
+
+    // Updates every 500 ms from 'from' up to and including 'to'
+    void run(const int64_t& from, const int64_t& to, const float& cpu_load)
+    {
+        for(int64_t now = from; now <= to; now += 500)
+        {
+            governor->update(now * MS, cpu_load);
+        }
+    }
+
+    std::vector<cdi::GovernorEvent> events;
+    std::unique_ptr<cdi::Governor> governor;
+};
+
+bool same(const cdi::CaptureQuality& quality, const uint32_t& divisor, const bool& cheap, const uint32_t& steps)
+{
+    return quality.frame_divisor == divisor && quality.cheap_format == cheap && quality.resolution_steps == steps;
+}
+
+// Pressure steps down after down_ms and again after the settle time, nothing happens between the
+// thresholds or when the pressure or the headroom do not last, headroom steps up after up_ms
+void check_hysteresis()
+{
+    FakeBuffer buffer;
+    Fixture fixture;
+    cdi::Governor& governor = *fixture.governor;
+    REQUIRE(governor.add(&buffer, 0));
+    CHECK(!governor.add(&buffer, 0));
+
+    governor.update(1000 * MS, 0.9f);
+    governor.update(1500 * MS, 0.9f);
+    CHECK(fixture.events.empty());
+    governor.update(2000 * MS, 0.9f);
+    REQUIRE(fixture.events.size() == 1);
+    CHECK(fixture.events[0].buffer == &buffer);
+    CHECK(fixture.events[0].reason == cdi::GovernorReason::CPU_LOAD);
+    CHECK(same(fixture.events[0].previous, 1, false, 0));
+    CHECK(same(fixture.events[0].quality, 2, false, 0));
+    CHECK(same(buffer.quality(), 2, false, 0));
+
+    // Settling
+    governor.update(2500 * MS, 0.9f);
+    governor.update(3900 * MS, 0.9f);
+    CHECK(fixture.events.size() == 1);
+    governor.update(4000 * MS, 0.9f);
+    REQUIRE(fixture.events.size() == 2);
+    CHECK(same(buffer.quality(), 4, false, 0));
+
+    // Between the thresholds
+    fixture.run(4500, 30000, 0.7f);
+    CHECK(fixture.events.size() == 2);
+
+    // Pressure which does not last
+    for(int64_t now = 30000; now < 40000; now += 1000)
+    {
+        governor.update(now * MS, 0.9f);
+        governor.update((now + 500) * MS, 0.7f);
+    }
+    CHECK(fixture.events.size() == 2);
+    CHECK(same(buffer.quality(), 4, false, 0));
+
+    // Headroom
+    fixture.run(40000, 49900, 0.3f);
+    CHECK(fixture.events.size() == 2);
+    governor.update(50000 * MS, 0.3f);
+    REQUIRE(fixture.events.size() == 3);
+    CHECK(fixture.events[2].reason == cdi::GovernorReason::HEADROOM);
+    CHECK(same(buffer.quality(), 2, false, 0));
+
+    // A spike starts the headroom over
+    governor.update(55000 * MS, 0.9f);
+    fixture.run(55500, 65000, 0.3f);
+    CHECK(fixture.events.size() == 3);
+    governor.update(65500 * MS, 0.3f);
+    REQUIRE(fixture.events.size() == 4);
+    CHECK(same(buffer.quality(), 1, false, 0));
+
+    // Nothing above the quality the stream was opened with
+    fixture.run(66000, 100000, 0.3f);
+    CHECK(fixture.events.size() == 4);
+}
+
+// Frame rate first, then the format, then the resolution, and back in the opposite order
+void check_order()
+{
+    FakeBuffer buffer;
+    Fixture fixture;
+    REQUIRE(fixture.governor->add(&buffer, 0));
+
+    fixture.run(1000, 60000, 0.95f);
+    REQUIRE(fixture.events.size() == 5);
+    CHECK(same(fixture.events[0].quality, 2, false, 0));
+    CHECK(same(fixture.events[1].quality, 4, false, 0));
+    CHECK(same(fixture.events[2].quality, 4, true, 0));
+    CHECK(same(fixture.events[3].quality, 4, true, 1));
+    CHECK(same(fixture.events[4].quality, 4, true, 2));
+
+    fixture.run(60500, 200000, 0.1f);
+    REQUIRE(fixture.events.size() == 10);
+    CHECK(same(fixture.events[5].quality, 4, true, 1));
+    CHECK(same(fixture.events[6].quality, 4, true, 0));
+    CHECK(same(fixture.events[7].quality, 4, false, 0));
+    CHECK(same(fixture.events[8].quality, 2, false, 0));
+    CHECK(same(fixture.events[9].quality, 1, false, 0));
+
+    // Removed streams get back their quality
+    fixture.run(200500, 205000, 0.95f);
+    CHECK(!same(buffer.quality(), 1, false, 0));
+    fixture.governor->remove(&buffer);
+    CHECK(same(buffer.quality(), 1, false, 0));
+}
+
+// The lowest priority goes down first, among equal ones the most expensive. The highest priority
+// comes back first, among equal ones the cheapest.
+void check_priority()
+{
+    FakeBuffer important;
+    FakeBuffer cheap;
+    FakeBuffer expensive;
+    Fixture fixture;
+    REQUIRE(fixture.governor->add(&important, 2));
+    REQUIRE(fixture.governor->add(&cheap, 1));
+    REQUIRE(fixture.governor->add(&expensive, 1));
+
+    auto run = [&](const int64_t& from, const int64_t& to, const float& cpu_load)
+    {
+        for(int64_t now = from; now <= to; now += 500)
+        {
+            important.advance(15, 20 * MS, 0);
+            cheap.advance(15, 1 * MS, 0);
+            expensive.advance(15, 10 * MS, 0);
+            fixture.governor->update(now * MS, cpu_load);
+        }
+    };
+
+    run(1000, 40000, 0.9f);
+    REQUIRE(fixture.events.size() == 15);
+    for(size_t i = 0; i < 15; i++)
+    {
+        CHECK(fixture.events[i].buffer == (i < 5 ? &expensive : i < 10 ? &cheap : &important));
+    }
+    CHECK(fixture.events[0].priority == 1);
+    CHECK(fixture.events[10].priority == 2);
+
+    run(40500, 200000, 0.1f);
+    REQUIRE(fixture.events.size() == 30);
+    for(size_t i = 15; i < 30; i++)
+    {
+        CHECK(fixture.events[i].reason == cdi::GovernorReason::HEADROOM);
+        CHECK(fixture.events[i].buffer == (i < 20 ? &important : i < 25 ? &cheap : &expensive));
+    }
+    CHECK(same(expensive.quality(), 1, false, 0));
+}
+
+// A consumer which falls behind steps its own stream down without any system load
+void check_lag()
+{
+    FakeBuffer lagging;
+    FakeBuffer fine;
+    Fixture fixture;
+    REQUIRE(fixture.governor->add(&lagging, 1));
+    REQUIRE(fixture.governor->add(&fine, 0));
+
+    // The first look has nothing to compare with, the lag lasts from the second one on
+    for(int64_t now = 1000; now <= 2500; now += 500)
+    {
+        lagging.advance(15, 1 * MS, FRAME_INTERVAL * 5);
+        fine.advance(15, 1 * MS, FRAME_INTERVAL);
+        fixture.governor->update(now * MS, 0.7f);
+    }
+    REQUIRE(fixture.events.size() == 1);
+    CHECK(fixture.events[0].buffer == &lagging);
+    CHECK(fixture.events[0].reason == cdi::GovernorReason::LAG);
+    CHECK(fixture.events[0].lag > 4.9f && fixture.events[0].lag < 5.1f);
+    CHECK(same(fine.quality(), 1, false, 0));
+
+    // Caught up, between the thresholds the stream stays where it is, with headroom it comes back
+    for(int64_t now = 3000; now <= 60000; now += 500)
+    {
+        lagging.advance(15, 1 * MS, FRAME_INTERVAL);
+        fine.advance(15, 1 * MS, FRAME_INTERVAL);
+        fixture.governor->update(now * MS, now <= 30000 ? 0.7f : 0.1f);
+        if(now == 30000)
+        {
+            CHECK(fixture.events.size() == 1);
+        }
+    }
+    REQUIRE(fixture.events.size() == 2);
+    CHECK(fixture.events[1].buffer == &lagging);
+    CHECK(fixture.events[1].reason == cdi::GovernorReason::HEADROOM);
+    CHECK(same(lagging.quality(), 1, false, 0));
+}
+
+// A refused step is not tried again until the stream steps up, the next stream goes meanwhile
+void check_refused()
+{
+    FakeBuffer refusing;
+    FakeBuffer other;
+    Fixture fixture;
+    REQUIRE(fixture.governor->add(&refusing, 0));
+    REQUIRE(fixture.governor->add(&other, 1));
+    refusing.refuse = true;
+
+    fixture.governor->update(1000 * MS, 0.9f);
+    fixture.governor->update(2000 * MS, 0.9f);
+    CHECK(fixture.events.empty());
+    fixture.governor->update(2500 * MS, 0.9f);
+    REQUIRE(fixture.events.size() == 1);
+    CHECK(fixture.events[0].buffer == &other);
+
+    refusing.refuse = false;
+    fixture.run(3000, 20000, 0.9f);
+    for(const cdi::GovernorEvent& event : fixture.events)
+    {
+        CHECK(event.buffer == &other);
+    }
+    CHECK(same(refusing.quality(), 1, false, 0));
+}
+
+}
+
+int main()
+{
+    check_hysteresis();
+    check_order();
+    check_priority();
+    check_lag();
+    check_refused();
+
+    return cdi::test::result("GovernorTest");
+}
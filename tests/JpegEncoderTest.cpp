@@ -0,0 +1,694 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// JpegEncoder output read back by a minimal baseline decoder: the markers and the frame header
+// with the scaled dimensions, then the decoded planes of I420, NV12 and YUY2 frames, full range
+// and stretched from limited range, at full size and box downscaled, against the source within
+// the loss of the quantization. Encodes which do not fit are refused.
+
+#include "Check.h"
+#include "JpegEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+namespace {
+
+const uint8_t ZIGZAG[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+struct Table
+{
+    Table() : defined(false), max_code(), offset(), values() {}
+    bool defined;
+    int32_t max_code[17]; // Largest code of each length, -1 for none
+    int32_t offset[17];   // Index of the first value of each length minus its first code
+    std::vector<uint8_t> values;
+};
+
+struct Component
+{
+    Component() : id(0), h(1), v(1), quant(0), dc(0), ac(0), predictor(0), width(0), height(0) {}
+    uint8_t id;
+    uint32_t h;
+    uint32_t v;
+    uint32_t quant;
+    uint32_t dc;
+    uint32_t ac;
+    int32_t predictor;
+    uint32_t width; // Padded to whole MCUs
+    uint32_t height;
+    std::vector<uint8_t> samples;
+};
+
+// What a baseline decoder needs of JFIF: DQT, SOF0, DHT and one interleaved SOS, no restarts
+class Decoder
+{
+public:
+    Decoder()
+        : m_data(nullptr), m_size(0), m_pos(0), m_end(0), m_bits(0), m_count(0), m_error(false), m_width(0), m_height(0)
+        , m_quant()
+    {
+    }
+
+    bool decode(const uint8_t* data, const size_t& size)
+    {
+        m_data = data;
+        m_size = size;
+        m_pos = 0;
+        if(size < 4 || data[0] != 0xFF || data[1] != 0xD8 || data[size - 2] != 0xFF || data[size - 1] != 0xD9)
+        {
+            return false;
+        }
+        m_markers.push_back(0xD8);
+        m_pos = 2;
+
+        while(m_pos + 4 <= m_size)
+        {
+            if(m_data[m_pos] != 0xFF)
+            {
+                return false;
+            }
+
+            const uint8_t marker = m_data[m_pos + 1];
+            const size_t length = (static_cast<size_t>(m_data[m_pos + 2]) << 8) | m_data[m_pos + 3];
+            const uint8_t* segment = m_data + m_pos + 4;
+            m_markers.push_back(marker);
+            if(length < 2 || m_pos + 2 + length > m_size)
+            {
+                return false;
+            }
+            m_pos += 2 + length;
+
+            bool parsed = true;
+            switch(marker)
+            {
+            case 0xDB:
+                parsed = quantization(segment, length - 2);
+                break;
+            case 0xC0:
+                parsed = frame(segment, length - 2);
+                break;
+            case 0xC4:
+                parsed = huffman(segment, length - 2);
+                break;
+            case 0xDA:
+                if(!scan(segment, length - 2))
+                {
+                    return false;
+                }
+                m_markers.push_back(0xD9);
+                return m_pos + 2 == m_size;
+            default:
+                // APPn and anything else a baseline file may carry
+                parsed = marker >= 0xE0 && marker <= 0xEF;
+                break;
+            }
+
+            if(!parsed)
+            {
+                return false;
+            }
+        }
+
+        return false;
+    }
+
+    const std::vector<uint8_t>& markers() const { return m_markers; }
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+    const std::vector<Component>& components() const { return m_components; }
+
+private:
+    bool quantization(const uint8_t* segment, const size_t& length)
+    {
+        for(size_t i = 0; i + 65 <= length; i += 65)
+        {
+            if((segment[i] >> 4) != 0 || (segment[i] & 15) > 3)
+            {
+                return false;
+            }
+            for(uint32_t k = 0; k < 64; k++)
+            {
+                m_quant[segment[i] & 15][k] = segment[i + 1 + k];
+            }
+        }
+        return length % 65 == 0;
+    }
+
+    bool frame(const uint8_t* segment, const size_t& length)
+    {
+        if(length < 6 || segment[0] != 8)
+        {
+            return false;
+        }
+
+        m_height = (static_cast<uint32_t>(segment[1]) << 8) | segment[2];
+        m_width = (static_cast<uint32_t>(segment[3]) << 8) | segment[4];
+        const uint32_t count = segment[5];
+        if(length != 6 + 3 * count || count == 0 || m_width == 0 || m_height == 0)
+        {
+            return false;
+        }
+
+        m_components.resize(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            m_components[i].id = segment[6 + i * 3];
+            m_components[i].h = segment[7 + i * 3] >> 4;
+            m_components[i].v = segment[7 + i * 3] & 15;
+            m_components[i].quant = segment[8 + i * 3] & 3;
+        }
+        return true;
+    }
+
+    bool huffman(const uint8_t* segment, const size_t& length)
+    {
+        size_t i = 0;
+        while(i + 17 <= length)
+        {
+            const uint32_t index = (segment[i] >> 4) * 4 + (segment[i] & 15);
+            if(index >= 8)
+            {
+                return false;
+            }
+
+            Table& table = m_tables[index];
+            table = Table();
+            table.defined = true;
+            size_t total = 0;
+            int32_t code = 0;
+            for(uint32_t bits = 1; bits <= 16; bits++)
+            {
+                const uint32_t count = segment[i + bits];
+                table.offset[bits] = static_cast<int32_t>(total) - code;
+                table.max_code[bits] = count != 0 ? code + static_cast<int32_t>(count) - 1 : -1;
+                code = (code + static_cast<int32_t>(count)) << 1;
+                total += count;
+            }
+
+            if(i + 17 + total > length)
+            {
+                return false;
+            }
+            table.values.assign(segment + i + 17, segment + i + 17 + total);
+            i += 17 + total;
+        }
+        return i == length;
+    }
+
+    bool scan(const uint8_t* segment, const size_t& length)
+    {
+        const uint32_t count = segment[0];
+        if(count != m_components.size() || length != 4 + 2 * count)
+        {
+            return false;
+        }
+
+        uint32_t h_max = 1;
+        uint32_t v_max = 1;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            Component& component = m_components[i];
+            if(segment[1 + i * 2] != component.id)
+            {
+                return false;
+            }
+            component.dc = segment[2 + i * 2] >> 4;
+            component.ac = segment[2 + i * 2] & 15;
+            if(!m_tables[component.dc].defined || !m_tables[4 + component.ac].defined)
+            {
+                return false;
+            }
+            h_max = std::max(h_max, component.h);
+            v_max = std::max(v_max, component.v);
+        }
+
+        const uint32_t mcu_columns = (m_width + 8 * h_max - 1) / (8 * h_max);
+        const uint32_t mcu_rows = (m_height + 8 * v_max - 1) / (8 * v_max);
+        for(Component& component : m_components)
+        {
+            component.width = mcu_columns * component.h * 8;
+            component.height = mcu_rows * component.v * 8;
+            component.samples.assign(static_cast<size_t>(component.width) * component.height, 0);
+        }
+
+        // The entropy coded data runs up to the EOI
+        m_bits = 0;
+        m_count = 0;
+        m_end = m_size - 2;
+        for(uint32_t row = 0; row < mcu_rows; row++)
+        {
+            for(uint32_t column = 0; column < mcu_columns; column++)
+            {
+                for(Component& component : m_components)
+                {
+                    for(uint32_t by = 0; by < component.v; by++)
+                    {
+                        for(uint32_t bx = 0; bx < component.h; bx++)
+                        {
+                            const uint32_t x = (column * component.h + bx) * 8;
+                            const uint32_t y = (row * component.v + by) * 8;
+                            if(!block(component, x, y))
+                            {
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Nothing but the padding of the last byte remains
+        return m_pos == m_end;
+    }
+
+    int32_t bit()
+    {
+        if(m_count == 0)
+        {
+            uint32_t byte = 0;
+            if(m_pos < m_end)
+            {
+                byte = m_data[m_pos++];
+                if(byte == 0xFF)
+                {
+                    // Stuffed zero byte, anything else is a marker inside the data
+                    if(m_pos >= m_end || m_data[m_pos] != 0)
+                    {
+                        m_error = true;
+                    }
+                    m_pos++;
+                }
+            }
+            else
+            {
+                m_error = true;
+            }
+            m_bits = byte;
+            m_count = 8;
+        }
+
+        m_count--;
+        return static_cast<int32_t>((m_bits >> m_count) & 1);
+    }
+
+    int32_t receive(const uint32_t& size)
+    {
+        int32_t value = 0;
+        for(uint32_t i = 0; i < size; i++)
+        {
+            value = (value << 1) | bit();
+        }
+        return value;
+    }
+
+    static int32_t extend(const int32_t& value, const uint32_t& size)
+    {
+        return size != 0 && value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+    }
+
+    int32_t symbol(const Table& table)
+    {
+        int32_t code = 0;
+        for(uint32_t bits = 1; bits <= 16; bits++)
+        {
+            code = (code << 1) | bit();
+            if(table.max_code[bits] >= 0 && code <= table.max_code[bits])
+            {
+                const size_t index = static_cast<size_t>(table.offset[bits] + code);
+                return index < table.values.size() ? table.values[index] : -1;
+            }
+        }
+        return -1;
+    }
+
+    bool block(Component& component, const uint32_t& x0, const uint32_t& y0)
+    {
+        double coefficients[64] = {};
+        const uint8_t* quant = m_quant[component.quant];
+
+        const int32_t dc_size = symbol(m_tables[component.dc]);
+        if(dc_size < 0 || dc_size > 11)
+        {
+            return false;
+        }
+        component.predictor += extend(receive(static_cast<uint32_t>(dc_size)), static_cast<uint32_t>(dc_size));
+        coefficients[0] = component.predictor * quant[0];
+
+        for(uint32_t k = 1; k < 64;)
+        {
+            const int32_t rs = symbol(m_tables[4 + component.ac]);
+            if(rs < 0)
+            {
+                return false;
+            }
+
+            const uint32_t run = static_cast<uint32_t>(rs) >> 4;
+            const uint32_t size = static_cast<uint32_t>(rs) & 15;
+            if(size == 0)
+            {
+                if(run != 15)
+                {
+                    break;
+                }
+                k += 16;
+                continue;
+            }
+
+            k += run;
+            if(k > 63)
+            {
+                return false;
+            }
+            coefficients[ZIGZAG[k]] = extend(receive(size), size) * quant[k];
+            k++;
+        }
+
+        if(m_error)
+        {
+            return false;
+        }
+
+        // Plain inverse DCT, level shifted and rounded
+        const double pi = 3.14159265358979323846;
+        for(uint32_t y = 0; y < 8; y++)
+        {
+            for(uint32_t x = 0; x < 8; x++)
+            {
+                double sum = 0.0;
+                for(uint32_t v = 0; v < 8; v++)
+                {
+                    for(uint32_t u = 0; u < 8; u++)
+                    {
+                        const double cu = u == 0 ? std::sqrt(0.5) : 1.0;
+                        const double cv = v == 0 ? std::sqrt(0.5) : 1.0;
+                        sum += cu * cv * coefficients[v * 8 + u]
+                            * std::cos((2 * x + 1) * u * pi / 16.0) * std::cos((2 * y + 1) * v * pi / 16.0);
+                    }
+                }
+
+                const double value = std::floor(sum / 4.0 + 128.0 + 0.5);
+                component.samples[static_cast<size_t>(y0 + y) * component.width + x0 + x] =
+                    static_cast<uint8_t>(std::min(255.0, std::max(0.0, value)));
+            }
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos;
+    size_t m_end;
+    uint32_t m_bits;
+    uint32_t m_count;
+    bool m_error;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint8_t m_quant[4][64];
+    Table m_tables[8]; // DC 0..3, AC 4..7
+    std::vector<Component> m_components;
+    std::vector<uint8_t> m_markers;
+};
+
+// Y, U and V planes of the image at full resolution, chroma at half width and height
+struct Image
+{
+    uint32_t width;
+    uint32_t height;
+    std::vector<double> y;
+    std::vector<double> u;
+    std::vector<double> v;
+};
+
+Image scene(const uint32_t& width, const uint32_t& height)
+{
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.y.resize(static_cast<size_t>(width) * height);
+    image.u.resize(static_cast<size_t>(width / 2) * (height / 2));
+    image.v.resize(image.u.size());
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            image.y[static_cast<size_t>(y) * width + x] =
+                std::floor(40.0 + 150.0 * (x + y) / (width + height) + 20.0 * std::sin(x * 0.4) * std::cos(y * 0.3));
+        }
+    }
+    for(uint32_t y = 0; y < height / 2; y++)
+    {
+        for(uint32_t x = 0; x < width / 2; x++)
+        {
+            image.u[static_cast<size_t>(y) * (width / 2) + x] = std::floor(128.0 + 50.0 * std::sin(x * 0.2));
+            image.v[static_cast<size_t>(y) * (width / 2) + x] = std::floor(128.0 - 40.0 * std::cos(y * 0.25));
+        }
+    }
+    return image;
+}
+
+// The frame in the layout of 'format', rows 'padding' bytes longer than the pixels
+std::vector<uint8_t> layout(const Image& image, const cdi::kernels::YuvFormat& format, const uint32_t& padding, int32_t& pitch)
+{
+    const uint32_t width = image.width;
+    const uint32_t height = image.height;
+    const uint32_t cw = width / 2;
+    std::vector<uint8_t> frame;
+    switch(format)
+    {
+    case cdi::kernels::YuvFormat::YUY2:
+    {
+        // Both rows of a chroma row carry it
+        pitch = static_cast<int32_t>(width * 2 + padding);
+        frame.assign(static_cast<size_t>(pitch) * height, 0);
+        for(uint32_t y = 0; y < height; y++)
+        {
+            uint8_t* row = &frame[static_cast<size_t>(y) * pitch];
+            for(uint32_t x = 0; x < width; x++)
+            {
+                row[x * 2] = static_cast<uint8_t>(image.y[static_cast<size_t>(y) * width + x]);
+                const size_t c = static_cast<size_t>(y / 2) * cw + x / 2;
+                row[x * 2 + 1] = static_cast<uint8_t>((x & 1) == 0 ? image.u[c] : image.v[c]);
+            }
+        }
+        break;
+    }
+    case cdi::kernels::YuvFormat::NV12:
+    case cdi::kernels::YuvFormat::I420:
+    default:
+    {
+        pitch = static_cast<int32_t>(width + padding);
+        frame.assign(static_cast<size_t>(pitch) * height * 3 / 2, 0);
+        for(uint32_t y = 0; y < height; y++)
+        {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                frame[static_cast<size_t>(y) * pitch + x] = static_cast<uint8_t>(image.y[static_cast<size_t>(y) * width + x]);
+            }
+        }
+
+        uint8_t* chroma = &frame[static_cast<size_t>(pitch) * height];
+        for(uint32_t y = 0; y < height / 2; y++)
+        {
+            for(uint32_t x = 0; x < cw; x++)
+            {
+                const size_t c = static_cast<size_t>(y) * cw + x;
+                if(format == cdi::kernels::YuvFormat::NV12)
+                {
+                    chroma[static_cast<size_t>(y) * pitch + x * 2] = static_cast<uint8_t>(image.u[c]);
+                    chroma[static_cast<size_t>(y) * pitch + x * 2 + 1] = static_cast<uint8_t>(image.v[c]);
+                }
+                else
+                {
+                    const size_t chroma_pitch = static_cast<size_t>(pitch) / 2;
+                    chroma[static_cast<size_t>(y) * chroma_pitch + x] = static_cast<uint8_t>(image.u[c]);
+                    chroma[chroma_pitch * (height / 2) + static_cast<size_t>(y) * chroma_pitch + x] = static_cast<uint8_t>(image.v[c]);
+                }
+            }
+        }
+        break;
+    }
+    }
+    return frame;
+}
+
+// Box mean of 'scale' x 'scale' samples, stretched to full range from limited range
+double expected(const std::vector<double>& plane, const uint32_t& width, const uint32_t& x, const uint32_t& y, const uint32_t& scale, const bool& luma, const bool& limited)
+{
+    double sum = 0.0;
+    for(uint32_t dy = 0; dy < scale; dy++)
+    {
+        for(uint32_t dx = 0; dx < scale; dx++)
+        {
+            sum += plane[static_cast<size_t>(y * scale + dy) * width + x * scale + dx];
+        }
+    }
+
+    const double value = sum / (scale * scale);
+    if(!limited)
+    {
+        return value;
+    }
+    return luma ? (value - 16.0) * 255.0 / 219.0 : (value - 128.0) * 255.0 / 224.0 + 128.0;
+}
+
+struct Error
+{
+    Error() : sum(0.0), count(0), worst(0.0) {}
+    void add(const double& value)
+    {
+        sum += std::fabs(value);
+        count++;
+        worst = std::max(worst, std::fabs(value));
+    }
+    double mean() const { return count != 0 ? sum / count : 0.0; }
+    double sum;
+    size_t count;
+    double worst;
+};
+
+void check_plane(const Component& component, const std::vector<double>& plane, const uint32_t& plane_width, const uint32_t& width, const uint32_t& height, const uint32_t& scale, const bool& luma, const bool& limited)
+{
+    Error error;
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            const double decoded = component.samples[static_cast<size_t>(y) * component.width + x];
+            error.add(decoded - expected(plane, plane_width, x, y, scale, luma, limited));
+        }
+    }
+
+    // Quality 95 on smooth content: below a code value on average, a few at the worst
+    CHECK(error.mean() < 1.0);
+    CHECK(error.worst <= 4.0);
+}
+
+void test_roundtrip()
+{
+    const uint32_t width = 68;
+    const uint32_t height = 44;
+    const Image image = scene(width, height);
+
+    cdi::JpegEncoder encoder;
+    REQUIRE(encoder.init(95));
+    CHECK(encoder.quality() == 95);
+
+    const cdi::kernels::YuvFormat formats[] = {
+        cdi::kernels::YuvFormat::I420,
+        cdi::kernels::YuvFormat::NV12,
+        cdi::kernels::YuvFormat::YUY2,
+    };
+    const cdi::ColorRange ranges[] = {cdi::ColorRange::FULL, cdi::ColorRange::LIMITED};
+
+    for(const cdi::kernels::YuvFormat& format : formats)
+    {
+        int32_t pitch = 0;
+        const std::vector<uint8_t> frame = layout(image, format, 12, pitch);
+        for(const cdi::ColorRange& range : ranges)
+        {
+            for(const uint32_t scale : {1u, 2u, 4u})
+            {
+                const uint32_t out_width = width / scale;
+                const uint32_t out_height = height / scale;
+                std::vector<uint8_t> jpeg(cdi::JpegEncoder::bound(width, height));
+                const size_t size = encoder.encode(format, frame.data(), pitch, width, height, scale, range, jpeg.data(), jpeg.size());
+                REQUIRE(size != 0 && size <= jpeg.size());
+
+                Decoder decoder;
+                REQUIRE(decoder.decode(jpeg.data(), size));
+
+                // SOI, APP0, DQT, SOF0, DHT, SOS and EOI in this order
+                const std::vector<uint8_t> markers = {0xD8, 0xE0, 0xDB, 0xC0, 0xC4, 0xDA, 0xD9};
+                CHECK(decoder.markers() == markers);
+                CHECK(decoder.width() == out_width);
+                CHECK(decoder.height() == out_height);
+
+                // Luma sampled 2x2 against both chroma components
+                const std::vector<Component>& components = decoder.components();
+                REQUIRE(components.size() == 3);
+                CHECK(components[0].h == 2 && components[0].v == 2);
+                CHECK(components[1].h == 1 && components[1].v == 1 && components[2].h == 1 && components[2].v == 1);
+
+                const bool limited = range == cdi::ColorRange::LIMITED;
+                check_plane(components[0], image.y, width, out_width, out_height, scale, true, limited);
+                check_plane(components[1], image.u, width / 2, out_width / 2, out_height / 2, scale, false, limited);
+                check_plane(components[2], image.v, width / 2, out_width / 2, out_height / 2, scale, false, limited);
+            }
+        }
+    }
+}
+
+void test_refused()
+{
+    const uint32_t width = 32;
+    const uint32_t height = 16;
+    const Image image = scene(width, height);
+    int32_t pitch = 0;
+    const std::vector<uint8_t> frame = layout(image, cdi::kernels::YuvFormat::I420, 0, pitch);
+    std::vector<uint8_t> jpeg(cdi::JpegEncoder::bound(width, height));
+
+    cdi::JpegEncoder encoder;
+    CHECK(encoder.encode(cdi::kernels::YuvFormat::I420, frame.data(), pitch, width, height, 1, cdi::ColorRange::FULL, jpeg.data(), jpeg.size()) == 0);
+    CHECK(!encoder.init(0));
+    CHECK(!encoder.init(101));
+    REQUIRE(encoder.init(50));
+
+    CHECK(encoder.encode(cdi::kernels::YuvFormat::I420, frame.data(), pitch, width, height, 3, cdi::ColorRange::FULL, jpeg.data(), jpeg.size()) == 0);
+    CHECK(encoder.encode(cdi::kernels::YuvFormat::I420, frame.data(), pitch, width, height, 64, cdi::ColorRange::FULL, jpeg.data(), jpeg.size()) == 0);
+
+    const size_t size = encoder.encode(cdi::kernels::YuvFormat::I420, frame.data(), pitch, width, height, 1, cdi::ColorRange::FULL, jpeg.data(), jpeg.size());
+    REQUIRE(size != 0);
+    CHECK(encoder.encode(cdi::kernels::YuvFormat::I420, frame.data(), pitch, width, height, 1, cdi::ColorRange::FULL, jpeg.data(), size - 1) == 0);
+}
+
+}
+
+int main()
+{
+    test_roundtrip();
+    test_refused();
+
+    return cdi::test::result("JpegEncoderTest");
+}
@@ -0,0 +1,267 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Round trips of the lossless codec over every encoding with a pixel layout, odd sizes included.
+// Decoding goes into memory filled with a marker, so bytes a plane's rows leave out show up too.
+// Two byte encodings are checked to compress, and corrupt payloads to be read safely.
+
+#include "Check.h"
+#include "FrameLayout.h"
+#include "LosslessCodec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+using cdi::Encoding;
+
+const Encoding ENCODINGS[] =
+{
+    Encoding::I420,
+    Encoding::RGB24,
+    Encoding::RGBA32,
+    Encoding::P010,
+    Encoding::P016,
+    Encoding::Y210,
+    Encoding::GRAY16,
+};
+
+struct Size
+{
+    uint32_t width;
+    uint32_t height;
+};
+
+const Size SIZES[] =
+{
+    {1, 1}, {2, 2}, {3, 5}, {5, 3}, {17, 9}, {33, 31}, {64, 48}, {127, 65}, {250, 3},
+};
+
+enum class Content
+{
+    FLAT,     // Zero blocks only
+    SMOOTH,   // Gradients with a little noise, as from a camera
+    NOISE,    // Incompressible, takes the escape codes
+};
+
+std::vector<uint8_t> make_frame(const size_t& size, const Content& content, const uint32_t& seed)
+{
+    std::vector<uint8_t> frame(size);
+    std::mt19937 random(seed);
+    for(size_t i = 0; i < size; i++)
+    {
+        switch(content)
+        {
+        case Content::FLAT:
+            frame[i] = 0x40;
+            break;
+        case Content::SMOOTH:
+            frame[i] = static_cast<uint8_t>((i / 7) + (random() & 3));
+            break;
+        case Content::NOISE:
+            frame[i] = static_cast<uint8_t>(random());
+            break;
+        }
+    }
+    return frame;
+}
+
+void round_trip(const Encoding& encoding, const Size& size, const cdi::Predictor& predictor, const uint32_t& threads, const Content& content)
+{
+    cdi::FrameLayout layout;
+    REQUIRE(layout.init(size.width, size.height, encoding));
+
+    // Every byte of the frame belongs to exactly one coded row
+    size_t coded = 0;
+    for(uint32_t p = 0; p < layout.plane_count(); p++)
+    {
+        const cdi::FrameLayout::Plane& plane = layout.plane(p);
+        CHECK(plane.width == plane.stride);
+        coded += static_cast<size_t>(plane.width) * plane.height;
+    }
+    CHECK(coded == layout.size());
+
+    const std::vector<uint8_t> frame = make_frame(layout.size(), content, size.width * 31 + size.height);
+
+    cdi::LosslessCodec codec(predictor, threads);
+    std::vector<uint8_t> encoded(codec.bound(size.width, size.height, encoding));
+    const size_t encoded_size = codec.encode(frame.data(), size.width, size.height, encoding, encoded.data(), encoded.size());
+    REQUIRE(encoded_size > 0);
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    Encoding decoded_encoding = Encoding::UNKNOWN;
+    CHECK(codec.info(encoded.data(), encoded_size, width, height, decoded_encoding));
+    CHECK(width == size.width && height == size.height && decoded_encoding == encoding);
+
+    // A second codec as a reader elsewhere would use
+    cdi::LosslessCodec decoder(cdi::Predictor::LEFT, threads);
+    std::vector<uint8_t> decoded(layout.size(), 0xCD);
+    CHECK(decoder.decode(encoded.data(), encoded_size, decoded.data(), decoded.size()));
+    if(std::memcmp(decoded.data(), frame.data(), frame.size()) != 0)
+    {
+        std::fprintf(stderr, "encoding %d, %ux%u, predictor %d, %u threads, content %d\n",
+            static_cast<int>(encoding), size.width, size.height, static_cast<int>(predictor), threads, static_cast<int>(content));
+        CHECK(!"decoded frame differs");
+    }
+
+    // Incompressible slices are stored, the frame grows by the header and slice table only
+    CHECK(encoded_size <= layout.size() + 256);
+
+    // Truncated input is refused, not read past
+    if(encoded_size > 32)
+    {
+        CHECK(!decoder.decode(encoded.data(), encoded_size / 2, decoded.data(), decoded.size()));
+    }
+}
+
+void test_round_trips()
+{
+    for(const Encoding encoding : ENCODINGS)
+    {
+        for(const Size& size : SIZES)
+        {
+            for(const cdi::Predictor predictor : {cdi::Predictor::LEFT, cdi::Predictor::MEDIAN})
+            {
+                for(const Content content : {Content::FLAT, Content::SMOOTH, Content::NOISE})
+                {
+                    round_trip(encoding, size, predictor, 1, content);
+                    round_trip(encoding, size, predictor, 3, content);
+                }
+            }
+        }
+    }
+}
+
+// Ten significant bits in the high bits of each sample, as P010 carries them
+std::vector<uint8_t> make_ten_bit(const cdi::FrameLayout& layout)
+{
+    std::vector<uint8_t> frame(layout.size());
+    std::mt19937 random(7);
+    for(size_t i = 0; i + 1 < frame.size(); i += 2)
+    {
+        const uint32_t code = static_cast<uint32_t>(((i / 2) % 640 + (random() & 7)) << 6);
+        frame[i] = static_cast<uint8_t>(code);
+        frame[i + 1] = static_cast<uint8_t>(code >> 8);
+    }
+    return frame;
+}
+
+void test_wide_samples()
+{
+    for(const Encoding encoding : {Encoding::P010, Encoding::P016, Encoding::Y210, Encoding::GRAY16})
+    {
+        for(const cdi::Predictor predictor : {cdi::Predictor::LEFT, cdi::Predictor::MEDIAN})
+        {
+            cdi::FrameLayout layout;
+            REQUIRE(layout.init(97, 64, encoding));
+            const std::vector<uint8_t> frame = make_ten_bit(layout);
+
+            cdi::LosslessCodec codec(predictor, 2);
+            std::vector<uint8_t> encoded(codec.bound(97, 64, encoding));
+            const size_t encoded_size = codec.encode(frame.data(), 97, 64, encoding, encoded.data(), encoded.size());
+            REQUIRE(encoded_size > 0);
+
+            // Three bits of noise in sixteen, predicting byte by byte stayed near the raw size
+            CHECK(encoded_size * 3 < frame.size());
+
+            std::vector<uint8_t> decoded(frame.size());
+            CHECK(codec.decode(encoded.data(), encoded_size, decoded.data(), decoded.size()));
+            CHECK(decoded == frame);
+        }
+    }
+}
+
+// Slice payloads of set bits only, the longest run of ones a reader can meet
+void test_corrupt_payload()
+{
+    for(const Encoding encoding : {Encoding::I420, Encoding::P010})
+    {
+        cdi::FrameLayout layout;
+        REQUIRE(layout.init(64, 32, encoding));
+        const std::vector<uint8_t> frame = make_frame(layout.size(), Content::SMOOTH, 3);
+
+        cdi::LosslessCodec codec(cdi::Predictor::MEDIAN, 1);
+        std::vector<uint8_t> encoded(codec.bound(64, 32, encoding));
+        const size_t encoded_size = codec.encode(frame.data(), 64, 32, encoding, encoded.data(), encoded.size());
+        REQUIRE(encoded_size > 0);
+
+        // A small Rice parameter up front, the block header and the shift of a wide slice
+        const size_t slices = encoded[20] | (encoded[21] << 8);
+        const size_t payload = 24 + slices * 4;
+        encoded[payload] = 0;
+        std::fill(encoded.begin() + payload + 1, encoded.begin() + encoded_size, 0xFF);
+
+        // Whatever comes out, the reader stays within its buffers
+        std::vector<uint8_t> decoded(frame.size());
+        codec.decode(encoded.data(), encoded_size, decoded.data(), decoded.size());
+    }
+}
+
+void test_refuses()
+{
+    cdi::LosslessCodec codec(cdi::Predictor::MEDIAN, 1);
+    uint8_t frame[64] = {};
+    uint8_t encoded[256] = {};
+
+    CHECK(codec.bound(4, 4, Encoding::UNKNOWN) == 0);
+    CHECK(codec.bound(4, 4, Encoding::MJPEG) == 0);
+    CHECK(codec.encode(frame, 4, 4, Encoding::MJPEG, encoded, sizeof(encoded)) == 0);
+    CHECK(codec.encode(nullptr, 4, 4, Encoding::I420, encoded, sizeof(encoded)) == 0);
+
+    // Too small for the result
+    CHECK(codec.encode(frame, 4, 4, Encoding::RGBA32, encoded, 8) == 0);
+
+    // Not a frame of the codec
+    CHECK(!codec.decode(frame, sizeof(frame), encoded, sizeof(encoded)));
+
+    // Too small for the decoded frame
+    const size_t size = codec.encode(frame, 4, 4, Encoding::I420, encoded, sizeof(encoded));
+    REQUIRE(size > 0);
+    CHECK(!codec.decode(encoded, size, frame, 23));
+    CHECK(codec.decode(encoded, size, frame, 24));
+}
+
+}
+
+int main()
+{
+    test_round_trips();
+    test_wide_samples();
+    test_corrupt_payload();
+    test_refuses();
+
+    return cdi::test::result("LosslessCodecTest");
+}
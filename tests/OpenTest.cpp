@@ -0,0 +1,155 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// The open path on a camera of the SDK stand-in whose activation takes a while: the source
+// activated for the format enumeration serves the reader, open_timings() accounts for the
+// activation, and the presample modes decide when the first frame is read.
+
+#include "Check.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <chrono>
+#include <memory>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t ACTIVATE_MS = 60;
+const uint32_t FPS = 30;
+const int64_t MS = 10000; // clock_now() units
+
+std::shared_ptr<sdk::Camera> add_camera()
+{
+    sdk::remove_cameras();
+
+    sdk::CameraDesc desc;
+    desc.formats.push_back({MFVideoFormat_NV12, 320, 240, FPS});
+    desc.activate_ms = ACTIVATE_MS;
+    return sdk::add_camera(desc);
+}
+
+std::unique_ptr<cdi::IBuffer> open(const cdi::Presample& presample)
+{
+    cdi::StreamOptions options;
+    options.presample = presample;
+    return cdi::open_device(0, 320, 240, cdi::Encoding::I420, options);
+}
+
+// Milliseconds from 'start' to the first lock() returning
+double first_lock(cdi::IBuffer& buffer, const Clock::time_point& start)
+{
+    const bool locked = buffer.lock() != nullptr;
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    buffer.unlock();
+    return locked ? ms : -1.0;
+}
+
+void check_single_activation()
+{
+    std::shared_ptr<sdk::Camera> camera = add_camera();
+
+    const Clock::time_point start = Clock::now();
+    std::unique_ptr<cdi::IBuffer> buffer = open(cdi::Presample::SYNCHRONOUS);
+    const double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    REQUIRE(buffer);
+
+    // One activation for enumeration and reader, shut down with the stream
+    CHECK(camera->activations() == 1);
+    const cdi::OpenTimings timings = buffer->open_timings();
+    CHECK(timings.activate == 0);
+    CHECK(timings.enumerate >= ACTIVATE_MS * MS);
+    CHECK(timings.presample > 0);
+    CHECK(timings.total >= timings.enumerate + timings.reader + timings.setup + timings.presample);
+    CHECK(timings.total <= static_cast<int64_t>(elapsed * MS) + MS);
+    CHECK(timings.first_frame > 0 && timings.first_frame <= timings.total);
+    CHECK(camera->frames() == 1);
+
+    buffer.reset();
+    CHECK(camera->shutdowns() == 1);
+
+    // Every cold open activates once
+    buffer = open(cdi::Presample::SYNCHRONOUS);
+    REQUIRE(buffer);
+    CHECK(camera->activations() == 2);
+    buffer.reset();
+
+    sdk::remove_cameras();
+}
+
+// The deferred first read is the frame of the first lock(), a synchronous open reads one
+// frame during the open and the first lock() waits for the next
+void check_presample()
+{
+    std::shared_ptr<sdk::Camera> camera = add_camera();
+
+    Clock::time_point start = Clock::now();
+    std::unique_ptr<cdi::IBuffer> buffer = open(cdi::Presample::SYNCHRONOUS);
+    REQUIRE(buffer);
+    const double synchronous_ms = first_lock(*buffer, start);
+    buffer.reset();
+
+    start = Clock::now();
+    buffer = open(cdi::Presample::DEFERRED);
+    REQUIRE(buffer);
+    CHECK(buffer->open_timings().presample == 0);
+    const double deferred_ms = first_lock(*buffer, start);
+    CHECK(buffer->open_timings().first_frame > 0);
+    buffer.reset();
+
+    start = Clock::now();
+    buffer = open(cdi::Presample::NONE);
+    REQUIRE(buffer);
+    const uint64_t frames = camera->frames();
+    const double none_ms = first_lock(*buffer, start);
+    CHECK(camera->frames() == frames + 1);
+    buffer.reset();
+
+    CHECK(synchronous_ms >= ACTIVATE_MS && deferred_ms >= ACTIVATE_MS && none_ms >= ACTIVATE_MS);
+    CHECK(deferred_ms + 1000.0 / FPS / 2 < synchronous_ms);
+
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_single_activation();
+    check_presample();
+
+    return cdi::test::result("OpenTest");
+}
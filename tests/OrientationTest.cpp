@@ -0,0 +1,366 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Rotation and mirroring against a plain per pixel reference: write_band() for every pixel size
+// with sizes around the tile and band sizes, then the oriented YUV kernels for every camera and
+// output encoding, each at every angle with every flip.
+
+#include "Check.h"
+#include "ColorKernels.h"
+#include "Orientation.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+const uint8_t PADDING = 0xCD;
+const uint32_t PADDING_BYTES = 7;
+
+const cdi::Rotation ROTATIONS[] =
+{
+    cdi::Rotation::NONE,
+    cdi::Rotation::CLOCKWISE_90,
+    cdi::Rotation::CLOCKWISE_180,
+    cdi::Rotation::CLOCKWISE_270,
+};
+
+std::vector<cdi::OrientationOptions> orientations()
+{
+    std::vector<cdi::OrientationOptions> result;
+    for(const cdi::Rotation& rotation : ROTATIONS)
+    {
+        for(uint32_t flips = 0; flips < 4; flips++)
+        {
+            cdi::OrientationOptions orientation;
+            orientation.rotation = rotation;
+            orientation.mirror_horizontal = (flips & 1) != 0;
+            orientation.mirror_vertical = (flips & 2) != 0;
+            result.push_back(orientation);
+        }
+    }
+    return result;
+}
+
+void describe(const cdi::OrientationOptions& orientation, char* text, const size_t& size)
+{
+    std::snprintf(text, size, "%d degrees%s%s",
+        static_cast<int>(orientation.rotation) * 90,
+        orientation.mirror_horizontal ? ", mirrored horizontally" : "",
+        orientation.mirror_vertical ? ", mirrored vertically" : "");
+}
+
+// A plane of 'width' x 'height' pixels of 'bpp' bytes, rows 'pitch' bytes apart
+struct Plane
+{
+    Plane(const uint32_t& width, const uint32_t& height, const uint32_t& bpp, const uint8_t& fill)
+        : width(width), height(height), bpp(bpp), pitch(width * bpp + PADDING_BYTES)
+        , data(static_cast<size_t>(pitch) * height, fill) {}
+    uint32_t width;
+    uint32_t height;
+    uint32_t bpp;
+    uint32_t pitch;
+    std::vector<uint8_t> data;
+};
+
+Plane oriented_plane(const cdi::OrientationOptions& orientation, const uint32_t& width, const uint32_t& height, const uint32_t& bpp)
+{
+    return cdi::kernels::swaps_axes(orientation)
+        ? Plane(height, width, bpp, PADDING)
+        : Plane(width, height, bpp, PADDING);
+}
+
+// Every pixel of 'source' where the orientation puts it, mirrored first and then rotated clockwise
+Plane reference(const cdi::OrientationOptions& orientation, const Plane& source)
+{
+    Plane result = oriented_plane(orientation, source.width, source.height, source.bpp);
+    const uint32_t w = source.width;
+    const uint32_t h = source.height;
+
+    for(uint32_t y = 0; y < h; y++)
+    {
+        for(uint32_t x = 0; x < w; x++)
+        {
+            const uint32_t mx = orientation.mirror_horizontal ? w - 1 - x : x;
+            const uint32_t my = orientation.mirror_vertical ? h - 1 - y : y;
+
+            uint32_t ox = mx;
+            uint32_t oy = my;
+            if(orientation.rotation == cdi::Rotation::CLOCKWISE_90)
+            {
+                ox = h - 1 - my;
+                oy = mx;
+            }
+            else if(orientation.rotation == cdi::Rotation::CLOCKWISE_180)
+            {
+                ox = w - 1 - mx;
+                oy = h - 1 - my;
+            }
+            else if(orientation.rotation == cdi::Rotation::CLOCKWISE_270)
+            {
+                ox = my;
+                oy = w - 1 - mx;
+            }
+
+            std::memcpy(
+                &result.data[static_cast<size_t>(result.pitch) * oy + static_cast<size_t>(ox) * source.bpp],
+                &source.data[static_cast<size_t>(source.pitch) * y + static_cast<size_t>(x) * source.bpp],
+                source.bpp);
+        }
+    }
+
+    return result;
+}
+
+void fill(std::vector<uint8_t>& data, uint32_t seed)
+{
+    for(uint8_t& value : data)
+    {
+        seed = seed * 1103515245 + 12345;
+        value = static_cast<uint8_t>(seed >> 16);
+    }
+}
+
+// Band by band as the kernels write, the padding after the output rows stays untouched
+void check_write_band()
+{
+    const uint32_t sizes[][2] = {{1, 1}, {3, 5}, {4, 4}, {8, 16}, {37, 21}, {64, 40}, {13, 35}};
+    const uint32_t pixel_sizes[] = {1, 3, 4};
+
+    for(const uint32_t& bpp : pixel_sizes)
+    {
+        for(const auto& size : sizes)
+        {
+            Plane source(size[0], size[1], bpp, 0);
+            fill(source.data, size[0] * 31 + size[1] + bpp);
+
+            for(const cdi::OrientationOptions& orientation : orientations())
+            {
+                const Plane expected = reference(orientation, source);
+                Plane result = oriented_plane(orientation, source.width, source.height, bpp);
+                const cdi::kernels::PixelMap map = cdi::kernels::map_pixels(
+                    orientation, result.data.data(), static_cast<int32_t>(result.pitch), source.width, source.height, bpp);
+
+                for(uint32_t y0 = 0; y0 < source.height; y0 += cdi::kernels::BAND_ROWS)
+                {
+                    const uint32_t rows = std::min(cdi::kernels::BAND_ROWS, source.height - y0);
+                    cdi::kernels::write_band(
+                        source.data.data() + static_cast<size_t>(source.pitch) * y0,
+                        source.pitch, source.width, rows, y0, map, bpp);
+                }
+
+                if(result.data != expected.data)
+                {
+                    char text[128];
+                    describe(orientation, text, sizeof(text));
+                    std::fprintf(stderr, "write_band: %u bytes per pixel, %ux%u, %s\n", bpp, size[0], size[1], text);
+                    CHECK(result.data == expected.data);
+                }
+            }
+        }
+    }
+}
+
+const uint32_t WIDTH = 38;
+const uint32_t HEIGHT = 22;
+
+// Camera frame with the planes as the kernels expect them, 'pitch' is the luma pitch
+struct Frame
+{
+    int32_t pitch;
+    std::vector<uint8_t> data;
+};
+
+Frame camera_frame(const cdi::kernels::YuvFormat& format)
+{
+    Frame frame;
+    frame.pitch = static_cast<int32_t>(format == cdi::kernels::YuvFormat::YUY2 ? WIDTH * 2 : WIDTH);
+    frame.data.resize(format == cdi::kernels::YuvFormat::YUY2
+        ? static_cast<size_t>(frame.pitch) * HEIGHT
+        : static_cast<size_t>(frame.pitch) * HEIGHT * 3 / 2);
+    fill(frame.data, static_cast<uint32_t>(format) + 7);
+    return frame;
+}
+
+// The unoriented I420 planes of a camera frame, chroma of 4:2:2 averaged over two rows
+void i420_planes(const cdi::kernels::YuvFormat& format, const Frame& frame, Plane& y, Plane& u, Plane& v)
+{
+    const uint8_t* src = frame.data.data();
+    const uint32_t pitch = static_cast<uint32_t>(frame.pitch);
+    const uint8_t* chroma = src + static_cast<size_t>(pitch) * HEIGHT;
+
+    for(uint32_t row = 0; row < HEIGHT; row++)
+    {
+        for(uint32_t x = 0; x < WIDTH; x++)
+        {
+            const uint32_t step = format == cdi::kernels::YuvFormat::YUY2 ? 2 : 1;
+            y.data[static_cast<size_t>(y.pitch) * row + x] = src[static_cast<size_t>(pitch) * row + x * step];
+        }
+    }
+
+    for(uint32_t row = 0; row < HEIGHT / 2; row++)
+    {
+        for(uint32_t x = 0; x < WIDTH / 2; x++)
+        {
+            uint8_t* out_u = &u.data[static_cast<size_t>(u.pitch) * row + x];
+            uint8_t* out_v = &v.data[static_cast<size_t>(v.pitch) * row + x];
+            if(format == cdi::kernels::YuvFormat::I420)
+            {
+                *out_u = chroma[static_cast<size_t>(pitch / 2) * row + x];
+                *out_v = chroma[static_cast<size_t>(pitch / 2) * (HEIGHT / 2 + row) + x];
+            }
+            else if(format == cdi::kernels::YuvFormat::NV12)
+            {
+                *out_u = chroma[static_cast<size_t>(pitch) * row + x * 2];
+                *out_v = chroma[static_cast<size_t>(pitch) * row + x * 2 + 1];
+            }
+            else
+            {
+                const uint8_t* top = src + static_cast<size_t>(pitch) * row * 2 + x * 4;
+                const uint8_t* bottom = top + pitch;
+                *out_u = static_cast<uint8_t>((top[1] + bottom[1] + 1) >> 1);
+                *out_v = static_cast<uint8_t>((top[3] + bottom[3] + 1) >> 1);
+            }
+        }
+    }
+}
+
+const char* format_name(const cdi::kernels::YuvFormat& format)
+{
+    switch(format)
+    {
+    case cdi::kernels::YuvFormat::I420:
+        return "I420";
+    case cdi::kernels::YuvFormat::NV12:
+        return "NV12";
+    default:
+        return "YUY2";
+    }
+}
+
+// Oriented RGB against the unoriented kernel oriented by the reference, top-down
+void check_oriented_rgb(const cdi::kernels::YuvFormat& format, const cdi::Encoding& encoding, const cdi::ColorSpace& color)
+{
+    const uint32_t bpp = encoding == cdi::Encoding::RGB24 ? 3 : 4;
+    const Frame frame = camera_frame(format);
+
+    const cdi::kernels::YuvToRgb plain = cdi::kernels::find_yuv_to_rgb(format, encoding, color);
+    const cdi::kernels::OrientedYuv oriented = cdi::kernels::find_oriented_yuv(format, encoding, color);
+    REQUIRE(plain != nullptr && oriented != nullptr);
+
+    Plane unoriented(WIDTH, HEIGHT, bpp, PADDING);
+    plain(frame.data.data(), frame.pitch, unoriented.data.data(), static_cast<int32_t>(unoriented.pitch), WIDTH, HEIGHT, nullptr);
+
+    std::vector<uint8_t> band(cdi::kernels::oriented_band_size(WIDTH));
+    for(const cdi::OrientationOptions& orientation : orientations())
+    {
+        const Plane expected = reference(orientation, unoriented);
+        Plane result = oriented_plane(orientation, WIDTH, HEIGHT, bpp);
+        cdi::kernels::PixelMap planes[3];
+        planes[0] = cdi::kernels::map_pixels(
+            orientation, result.data.data(), static_cast<int32_t>(result.pitch), WIDTH, HEIGHT, bpp);
+        oriented(frame.data.data(), frame.pitch, planes, WIDTH, HEIGHT, band.data(), nullptr);
+
+        if(result.data != expected.data)
+        {
+            char text[128];
+            describe(orientation, text, sizeof(text));
+            std::fprintf(stderr, "%s to %s: %s\n", format_name(format), bpp == 3 ? "RGB24" : "RGBA32", text);
+            CHECK(result.data == expected.data);
+        }
+    }
+}
+
+// Oriented I420 against the camera planes oriented by the reference, each plane on its own
+void check_oriented_i420(const cdi::kernels::YuvFormat& format)
+{
+    const Frame frame = camera_frame(format);
+    const cdi::kernels::OrientedYuv oriented = cdi::kernels::find_oriented_yuv(format, cdi::Encoding::I420, cdi::ColorSpace());
+    REQUIRE(oriented != nullptr);
+
+    Plane y(WIDTH, HEIGHT, 1, 0);
+    Plane u(WIDTH / 2, HEIGHT / 2, 1, 0);
+    Plane v(WIDTH / 2, HEIGHT / 2, 1, 0);
+    i420_planes(format, frame, y, u, v);
+
+    std::vector<uint8_t> band(cdi::kernels::oriented_band_size(WIDTH));
+    for(const cdi::OrientationOptions& orientation : orientations())
+    {
+        Plane result_y = oriented_plane(orientation, WIDTH, HEIGHT, 1);
+        Plane result_u = oriented_plane(orientation, WIDTH / 2, HEIGHT / 2, 1);
+        Plane result_v = oriented_plane(orientation, WIDTH / 2, HEIGHT / 2, 1);
+
+        cdi::kernels::PixelMap planes[3];
+        planes[0] = cdi::kernels::map_pixels(
+            orientation, result_y.data.data(), static_cast<int32_t>(result_y.pitch), WIDTH, HEIGHT, 1);
+        planes[1] = cdi::kernels::map_pixels(
+            orientation, result_u.data.data(), static_cast<int32_t>(result_u.pitch), WIDTH / 2, HEIGHT / 2, 1);
+        planes[2] = cdi::kernels::map_pixels(
+            orientation, result_v.data.data(), static_cast<int32_t>(result_v.pitch), WIDTH / 2, HEIGHT / 2, 1);
+        oriented(frame.data.data(), frame.pitch, planes, WIDTH, HEIGHT, band.data(), nullptr);
+
+        const bool equal = result_y.data == reference(orientation, y).data
+            && result_u.data == reference(orientation, u).data
+            && result_v.data == reference(orientation, v).data;
+        if(!equal)
+        {
+            char text[128];
+            describe(orientation, text, sizeof(text));
+            std::fprintf(stderr, "%s to I420: %s\n", format_name(format), text);
+            CHECK(equal);
+        }
+    }
+}
+
+}
+
+int main()
+{
+    check_write_band();
+
+    const cdi::kernels::YuvFormat formats[] =
+    {
+        cdi::kernels::YuvFormat::I420,
+        cdi::kernels::YuvFormat::NV12,
+        cdi::kernels::YuvFormat::YUY2,
+    };
+    for(const cdi::kernels::YuvFormat& format : formats)
+    {
+        check_oriented_rgb(format, cdi::Encoding::RGB24, cdi::ColorSpace());
+        check_oriented_rgb(format, cdi::Encoding::RGBA32, cdi::ColorSpace());
+        check_oriented_rgb(format, cdi::Encoding::RGB24, cdi::ColorSpace(cdi::ColorMatrix::BT709, cdi::ColorRange::FULL));
+        check_oriented_i420(format);
+    }
+
+    return cdi::test::result("OrientationTest");
+}
@@ -0,0 +1,186 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Compressed passthrough on the SDK stand-in: MJPEG and H.264 frames are handed out as the
+// camera delivers them with their size and keyframe flags, H.264 starts at a keyframe also when
+// a reconfigured stream switches to it mid-GOP, uncompressed encodings avoid compressed formats
+// and compressed encodings need a camera delivering them.
+
+#include "Check.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 320;
+const uint32_t HEIGHT = 240;
+const uint32_t FPS = 120;
+const uint64_t GOP = 30; // Keyframes of the stand-in
+
+std::shared_ptr<sdk::Camera> add_camera(const std::vector<GUID>& subtypes)
+{
+    sdk::remove_cameras();
+
+    sdk::CameraDesc desc;
+    for(const GUID& subtype : subtypes)
+    {
+        desc.formats.push_back({subtype, WIDTH, HEIGHT, FPS});
+    }
+    return sdk::add_camera(desc);
+}
+
+std::vector<uint8_t> camera_frame(const GUID& subtype, const uint64_t& sequence)
+{
+    uint32_t pitch = 0;
+    uint32_t size = 0;
+    sdk::packed_layout(subtype, WIDTH, HEIGHT, pitch, size);
+    std::vector<uint8_t> frame(size);
+    sdk::fill_frame(subtype, WIDTH, HEIGHT, sequence, frame.data());
+    return frame;
+}
+
+// The locked frame is camera frame 'sequence' of 'subtype' byte for byte
+bool same_frame(const GUID& subtype, const void* frame, const size_t& size, const uint64_t& sequence)
+{
+    const std::vector<uint8_t> camera = camera_frame(subtype, sequence);
+    return size == camera.size() && std::memcmp(frame, camera.data(), size) == 0;
+}
+
+void check_mjpeg()
+{
+    add_camera({MFVideoFormat_NV12, MFVideoFormat_MJPG});
+
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::MJPEG);
+    REQUIRE(buffer);
+    CHECK(buffer->encoding() == cdi::Encoding::MJPEG);
+
+    for(int i = 0; i < 3; i++)
+    {
+        const void* frame = buffer->lock();
+        REQUIRE(frame != nullptr);
+        const cdi::FrameInfo info = buffer->info();
+        CHECK(info.keyframe);
+        CHECK(same_frame(MFVideoFormat_MJPG, frame, buffer->size(), info.sequence - 1));
+        buffer->unlock();
+    }
+
+    // Nothing to convert into caller memory
+    std::vector<uint8_t> target(WIDTH * HEIGHT * 3);
+    CHECK(!buffer->read_into(target.data(), WIDTH));
+
+    sdk::remove_cameras();
+}
+
+void check_h264()
+{
+    add_camera({MFVideoFormat_H264});
+
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::H264);
+    REQUIRE(buffer);
+
+    uint64_t last = 0;
+    uint32_t keyframes = 0;
+    for(uint64_t i = 0; i < GOP + 2; i++)
+    {
+        const void* frame = buffer->lock();
+        REQUIRE(frame != nullptr);
+        const cdi::FrameInfo info = buffer->info();
+        CHECK(info.sequence > last);
+        CHECK(info.keyframe == ((info.sequence - 1) % GOP == 0));
+        CHECK(same_frame(MFVideoFormat_H264, frame, buffer->size(), info.sequence - 1));
+        keyframes += info.keyframe ? 1 : 0;
+        last = info.sequence;
+        buffer->unlock();
+    }
+    CHECK(keyframes >= 1);
+
+    sdk::remove_cameras();
+}
+
+// Uncompressed output prefers the uncompressed format of the resolution, a switch to H.264
+// drops frames up to the next keyframe
+void check_switch()
+{
+    add_camera({MFVideoFormat_H264, MFVideoFormat_NV12});
+
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::I420);
+    REQUIRE(buffer);
+    for(int i = 0; i < 3; i++)
+    {
+        const void* frame = buffer->lock();
+        REQUIRE(frame != nullptr);
+        CHECK(std::memcmp(frame, camera_frame(MFVideoFormat_NV12, buffer->info().sequence - 1).data(), WIDTH * HEIGHT) == 0);
+        buffer->unlock();
+    }
+
+    REQUIRE(buffer->reconfigure(WIDTH, HEIGHT, cdi::Encoding::H264));
+    const void* frame = buffer->lock();
+    REQUIRE(frame != nullptr);
+    const cdi::FrameInfo info = buffer->info();
+    CHECK(info.keyframe);
+    CHECK((info.sequence - 1) % GOP == 0);
+    CHECK(info.sequence > GOP);
+    CHECK(same_frame(MFVideoFormat_H264, frame, buffer->size(), info.sequence - 1));
+    buffer->unlock();
+
+    sdk::remove_cameras();
+}
+
+// Compressed output needs a camera which delivers it
+void check_unavailable()
+{
+    add_camera({MFVideoFormat_NV12, MFVideoFormat_YUY2});
+
+    CHECK(!cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::MJPEG));
+    CHECK(!cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::H264));
+
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_mjpeg();
+    check_h264();
+    check_switch();
+    check_unavailable();
+
+    return cdi::test::result("PassthroughTest");
+}
@@ -0,0 +1,279 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Pre-trigger rings on the SDK stand-in: dump() writes the frames kept while the capture runs into
+// a recording, converted into the encoding of the stream and without gaps, from 'since' on. A ring
+// of a fixed size keeps only the latest frames, H.264 dumps start at the keyframe before 'since',
+// rings in a file mapping work the same and streams without a ring have nothing to dump.
+
+#include "Check.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 64;
+const uint32_t HEIGHT = 48;
+const uint32_t FPS = 120;
+const uint64_t GOP = 30; // Keyframes of the stand-in
+const char* RECORDING = "PretriggerTest.cdi";
+const wchar_t* RECORDING_W = L"PretriggerTest.cdi";
+
+std::shared_ptr<sdk::Camera> add_camera(const GUID& subtype)
+{
+    sdk::remove_cameras();
+
+    sdk::CameraDesc desc;
+    desc.formats.push_back({subtype, WIDTH, HEIGHT, FPS});
+    return sdk::add_camera(desc);
+}
+
+std::vector<uint8_t> camera_frame(const GUID& subtype, const uint64_t& sequence)
+{
+    uint32_t pitch = 0;
+    uint32_t size = 0;
+    sdk::packed_layout(subtype, WIDTH, HEIGHT, pitch, size);
+    std::vector<uint8_t> frame(size);
+    sdk::fill_frame(subtype, WIDTH, HEIGHT, sequence, frame.data());
+    return frame;
+}
+
+// Camera sequence of a frame whose first 'bytes' are the ones of the camera, -1 when none of the
+// first frames matches
+int64_t find_sequence(const GUID& subtype, const void* frame, const size_t& bytes)
+{
+    for(uint64_t sequence = 0; sequence < 1000; sequence++)
+    {
+        if(std::memcmp(frame, camera_frame(subtype, sequence).data(), bytes) == 0)
+        {
+            return static_cast<int64_t>(sequence);
+        }
+    }
+    return -1;
+}
+
+cdi::StreamOptions ring_options()
+{
+    cdi::StreamOptions options;
+    options.asynchronous = true;
+    options.pretrigger.seconds = 2;
+    return options;
+}
+
+// Locks the frames of a while, the ring fills meanwhile
+void capture(cdi::IBuffer& buffer, const uint32_t& ms)
+{
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while(std::chrono::steady_clock::now() < end)
+    {
+        if(buffer.lock() != nullptr)
+        {
+            buffer.unlock();
+        }
+    }
+}
+
+// The frames of the recording follow each other on the camera, returns the count or zero when
+// they do not. Uncompressed frames are I420 of which the luma plane is compared.
+uint64_t check_recording(const GUID& subtype, const int64_t& since)
+{
+    std::unique_ptr<cdi::IRecording> recording = cdi::open_recording(RECORDING_W);
+    if(!recording || recording->frame_count() == 0)
+    {
+        return 0;
+    }
+
+    const bool compressed = subtype == MFVideoFormat_H264;
+    std::vector<uint8_t> frame(recording->size());
+    int64_t first = -1;
+    int64_t last_timestamp = 0;
+    for(uint64_t i = 0; i < recording->frame_count(); i++)
+    {
+        cdi::RecordedFrame info;
+        if(!recording->frame(i, info) || !recording->read(i, frame.data(), frame.size()))
+        {
+            return 0;
+        }
+
+        const size_t bytes = compressed ? info.size : WIDTH * HEIGHT;
+        if(first < 0)
+        {
+            first = find_sequence(subtype, frame.data(), bytes);
+            CHECK(first >= 0);
+            CHECK(!compressed || (info.keyframe && first % GOP == 0));
+            CHECK(compressed || info.timestamp >= since);
+        }
+        else
+        {
+            CHECK(info.timestamp > last_timestamp);
+        }
+        last_timestamp = info.timestamp;
+
+        if(std::memcmp(frame.data(), camera_frame(subtype, first + i).data(), bytes) != 0)
+        {
+            return 0;
+        }
+    }
+
+    return recording->frame_count();
+}
+
+void check_dump()
+{
+    add_camera(MFVideoFormat_NV12);
+
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::I420, ring_options());
+    REQUIRE(buffer);
+    capture(*buffer, 300);
+
+    REQUIRE(buffer->dump(0, RECORDING_W, nullptr));
+    const uint64_t all = check_recording(MFVideoFormat_NV12, 0);
+    CHECK(all >= FPS / 10);
+
+    // From the locked frame on
+    REQUIRE(buffer->lock() != nullptr);
+    const int64_t since = buffer->timestamp();
+    buffer->unlock();
+    capture(*buffer, 100);
+    REQUIRE(buffer->dump(since, RECORDING_W, nullptr));
+    const uint64_t later = check_recording(MFVideoFormat_NV12, since);
+    CHECK(later > 0);
+
+    // Nothing yet
+    CHECK(!buffer->dump(cdi::clock_now() + 10000000, RECORDING_W, nullptr));
+
+    buffer.reset();
+    std::remove(RECORDING);
+    sdk::remove_cameras();
+}
+
+// A ring of a few frames keeps the latest ones
+void check_fixed_size()
+{
+    add_camera(MFVideoFormat_NV12);
+
+    cdi::StreamOptions options = ring_options();
+    options.pretrigger.bytes = 4 * (WIDTH * HEIGHT * 3 / 2 + 64);
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::I420, options);
+    REQUIRE(buffer);
+    capture(*buffer, 300);
+
+    REQUIRE(buffer->dump(0, RECORDING_W, nullptr));
+    const uint64_t kept = check_recording(MFVideoFormat_NV12, 0);
+    CHECK(kept >= 1 && kept <= 4);
+
+    buffer.reset();
+    std::remove(RECORDING);
+    sdk::remove_cameras();
+}
+
+void check_h264()
+{
+    add_camera(MFVideoFormat_H264);
+
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::H264, ring_options());
+    REQUIRE(buffer);
+    capture(*buffer, 400);
+
+    // Past the first keyframe, the dump goes back to the one before
+    REQUIRE(buffer->lock() != nullptr);
+    const cdi::FrameInfo info = buffer->info();
+    buffer->unlock();
+    CHECK(info.sequence > GOP);
+    REQUIRE(buffer->dump(info.timestamp, RECORDING_W, nullptr));
+    const uint64_t frames = check_recording(MFVideoFormat_H264, 0);
+    CHECK(frames > (info.sequence - 1) % GOP);
+
+    buffer.reset();
+    std::remove(RECORDING);
+    sdk::remove_cameras();
+}
+
+// A ring in a file mapping, the file goes with the stream. Streams without a ring have nothing.
+void check_spill()
+{
+    add_camera(MFVideoFormat_NV12);
+
+    cdi::StreamOptions options = ring_options();
+    options.pretrigger.spill_path = L"PretriggerTest.ring";
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::I420, options);
+    REQUIRE(buffer);
+    capture(*buffer, 200);
+    std::FILE* file = std::fopen("PretriggerTest.ring", "rb");
+    CHECK(file != nullptr);
+    if(file != nullptr)
+    {
+        std::fclose(file);
+    }
+
+    REQUIRE(buffer->dump(0, RECORDING_W, nullptr));
+    CHECK(check_recording(MFVideoFormat_NV12, 0) > 0);
+    buffer.reset();
+    file = std::fopen("PretriggerTest.ring", "rb");
+    CHECK(file == nullptr);
+    if(file != nullptr)
+    {
+        std::fclose(file);
+    }
+
+    buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::I420);
+    REQUIRE(buffer);
+    capture(*buffer, 50);
+    CHECK(!buffer->dump(0, RECORDING_W, nullptr));
+
+    buffer.reset();
+    std::remove(RECORDING);
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_dump();
+    check_fixed_size();
+    check_h264();
+    check_spill();
+
+    return cdi::test::result("PretriggerTest");
+}
@@ -0,0 +1,215 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Pyramid levels against a plain 2x2 box filter: sizes and plane geometry of odd dimensions, where
+// the last column and row of a plane drop out, widths around the SIMD block sizes of every step,
+// and levels converted into another encoding.
+
+#include "Check.h"
+#include "ColorKernels.h"
+#include "FrameLayout.h"
+#include "Pyramid.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+
+namespace {
+
+using cdi::Encoding;
+
+struct Plane
+{
+    uint32_t width;  // In samples of one channel
+    uint32_t height;
+    uint32_t channels;
+};
+
+// Written out here rather than taken from FrameLayout, chroma of odd sizes rounds down
+std::vector<Plane> planes(const Encoding& encoding, const uint32_t& width, const uint32_t& height)
+{
+    switch(encoding)
+    {
+    case Encoding::I420:
+        return {{width, height, 1}, {width >> 1, height >> 1, 1}, {width >> 1, height >> 1, 1}};
+    case Encoding::RGB24:
+        return {{width, height, 3}};
+    case Encoding::RGBA32:
+        return {{width, height, 4}};
+    default:
+        return {};
+    }
+}
+
+std::vector<uint8_t> render(const size_t& size, uint32_t seed)
+{
+    std::vector<uint8_t> frame(size);
+    for(uint8_t& value : frame)
+    {
+        seed = seed * 1103515245 + 12345;
+        value = static_cast<uint8_t>(seed >> 16);
+    }
+    return frame;
+}
+
+// One halving, each plane on its own
+std::vector<uint8_t> halve(const std::vector<uint8_t>& src, const Encoding& encoding, const uint32_t& width, const uint32_t& height)
+{
+    const std::vector<Plane> in = planes(encoding, width, height);
+    const std::vector<Plane> out = planes(encoding, width >> 1, height >> 1);
+
+    std::vector<uint8_t> dst;
+    size_t offset = 0;
+    for(size_t p = 0; p < in.size(); p++)
+    {
+        const uint32_t stride = in[p].width * in[p].channels;
+        for(uint32_t y = 0; y < out[p].height; y++)
+        {
+            for(uint32_t x = 0; x < out[p].width * out[p].channels; x++)
+            {
+                const uint32_t column = (x / out[p].channels) * 2 * in[p].channels + x % out[p].channels;
+                const uint8_t* top = src.data() + offset + static_cast<size_t>(y * 2) * stride + column;
+                const uint8_t* bottom = top + stride;
+                dst.push_back(static_cast<uint8_t>((top[0] + top[in[p].channels] + bottom[0] + bottom[in[p].channels] + 2) >> 2));
+            }
+        }
+        offset += static_cast<size_t>(stride) * in[p].height;
+    }
+    return dst;
+}
+
+void check_levels(const Encoding& encoding, const uint32_t& width, const uint32_t& height)
+{
+    const std::vector<cdi::PyramidLevel> requested = {
+        cdi::PyramidLevel(2, Encoding::UNKNOWN),
+        cdi::PyramidLevel(8, Encoding::UNKNOWN),
+        cdi::PyramidLevel(4, Encoding::UNKNOWN),
+        cdi::PyramidLevel(4, encoding == Encoding::I420 ? Encoding::RGB24 : Encoding::I420),
+    };
+    const cdi::ColorSpace color;
+
+    cdi::FrameLayout layout;
+    REQUIRE(layout.init(width, height, encoding));
+    const std::vector<uint8_t> frame = render(layout.size(), width * 7 + height);
+
+    cdi::Pyramid pyramid;
+    REQUIRE(pyramid.init(width, height, encoding, requested, color, true));
+    REQUIRE(pyramid.level_count() == requested.size());
+    pyramid.build(frame.data());
+
+    // Halvings 1 to 3
+    std::vector<std::vector<uint8_t>> halvings = {frame};
+    for(uint32_t shift = 1; shift <= 3; shift++)
+    {
+        halvings.push_back(halve(halvings.back(), encoding, width >> (shift - 1), height >> (shift - 1)));
+    }
+
+    for(uint32_t i = 0; i < requested.size(); i++)
+    {
+        const cdi::FrameLevel level = pyramid.level(i);
+        const uint32_t shift = requested[i].scale == 2 ? 1 : requested[i].scale == 4 ? 2 : 3;
+        const uint32_t level_width = width >> shift;
+        const uint32_t level_height = height >> shift;
+        CHECK(level.width == level_width && level.height == level_height);
+
+        std::vector<uint8_t> expected = halvings[shift];
+        if(requested[i].encoding == Encoding::UNKNOWN)
+        {
+            CHECK(level.encoding == encoding);
+        }
+        else
+        {
+            CHECK(level.encoding == requested[i].encoding);
+            cdi::FrameLayout converted;
+            REQUIRE(converted.init(level_width, level_height, level.encoding));
+            expected.resize(converted.size());
+            REQUIRE(cdi::kernels::convert_frame(
+                halvings[shift].data(), encoding, expected.data(), level.encoding, level_width, level_height, color, true));
+        }
+
+        // The planes of the reference follow each other as FrameLayout places them
+        size_t planes_size = 0;
+        for(const Plane& plane : planes(level.encoding, level_width, level_height))
+        {
+            planes_size += static_cast<size_t>(plane.width) * plane.channels * plane.height;
+        }
+        CHECK(level.size == planes_size);
+        REQUIRE(level.size == expected.size());
+
+        const uint8_t* data = static_cast<const uint8_t*>(level.data);
+        if(!std::equal(expected.begin(), expected.end(), data))
+        {
+            std::fprintf(stderr, "encoding %d, %ux%u, scale %u\n",
+                static_cast<int>(encoding), width, height, requested[i].scale);
+            CHECK(!"level differs from the reference");
+        }
+    }
+}
+
+void test_levels()
+{
+    const uint32_t sizes[][2] = {
+        {16, 16}, {17, 9}, {33, 31}, {37, 23}, {64, 48}, {75, 45}, {101, 67}, {130, 34}, {240, 135},
+    };
+
+    for(const Encoding encoding : {Encoding::I420, Encoding::RGB24, Encoding::RGBA32})
+    {
+        for(const auto& size : sizes)
+        {
+            check_levels(encoding, size[0], size[1]);
+        }
+    }
+}
+
+void test_refuses()
+{
+    cdi::Pyramid pyramid;
+    const cdi::ColorSpace color;
+
+    CHECK(!pyramid.init(64, 48, Encoding::P010, {cdi::PyramidLevel(2, Encoding::UNKNOWN)}, color, false));
+    CHECK(!pyramid.init(64, 48, Encoding::I420, {cdi::PyramidLevel(3, Encoding::UNKNOWN)}, color, false));
+    CHECK(!pyramid.init(64, 48, Encoding::I420, {cdi::PyramidLevel(2, Encoding::GRAY16)}, color, false));
+
+    // Nothing left of a row
+    CHECK(!pyramid.init(15, 48, Encoding::I420, {cdi::PyramidLevel(16, Encoding::UNKNOWN)}, color, false));
+    CHECK(pyramid.init(16, 48, Encoding::I420, {cdi::PyramidLevel(16, Encoding::UNKNOWN)}, color, false));
+}
+
+}
+
+int main()
+{
+    test_levels();
+    test_refuses();
+
+    return cdi::test::result("PyramidTest");
+}
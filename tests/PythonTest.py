@@ -0,0 +1,150 @@
+# The Python module built by python/setup.py against the SDK stand-in: devices and resolutions,
+# frames shared through the buffer protocol and compared with the pattern the stand-in fills
+# them with, the locking rules and read_into(). tests/CMakeLists.txt puts the module on the path.
+
+import ctypes
+import os
+import sys
+import unittest
+
+# The stand-in enumerates its cameras on first use, before that they can be set up here
+os.environ["CDI_SDK_CAMERAS"] = "Planar=I420:64x48@30,NV12:640x480@30;Packed=YUY2:320x240@30,YUY2:64x48@15;Rgb=RGB24:64x48@30"
+
+import cdi
+
+WIDTH = 64
+HEIGHT = 48
+
+
+# tests/sdk fill_frame() of a packed frame of 'size' bytes with rows 'pitch' bytes long
+def camera_frame(sequence, pitch, size, height):
+    shift = sequence * 3
+    return bytes(
+        (x * 2 + y * 3 + shift + ((x * y) >> 4 & 0x1F) + (y // height) * 60) & 0xFF
+        for y, x in ((i // pitch, i % pitch) for i in range(size)))
+
+
+class DeviceTest(unittest.TestCase):
+    def test_devices(self):
+        self.assertEqual(cdi.list_devices(), ["Planar", "Packed", "Rgb"])
+        self.assertIn((WIDTH, HEIGHT), cdi.get_resolutions(0))
+        self.assertIn((320, 240), cdi.get_resolutions(1))
+        self.assertEqual(cdi.get_resolutions(7), [])
+
+    def test_open_fails(self):
+        with self.assertRaises(RuntimeError):
+            cdi.open_device(7, WIDTH, HEIGHT, cdi.I420)
+        with self.assertRaises(ValueError):
+            cdi.open_device(0, WIDTH, HEIGHT, 99)
+
+
+class FrameTest(unittest.TestCase):
+    # I420 to I420 hands out the camera frame as it is
+    def test_i420_content(self):
+        with cdi.open_device(0, WIDTH, HEIGHT, cdi.I420) as buffer:
+            self.assertEqual((buffer.width, buffer.height, buffer.encoding), (WIDTH, HEIGHT, cdi.I420))
+            self.assertEqual(buffer.size, WIDTH * HEIGHT * 3 // 2)
+
+            sequences = []
+            for _ in range(3):
+                with buffer.lock() as frame:
+                    view = memoryview(frame)
+                    self.assertTrue(view.readonly)
+                    self.assertEqual((view.ndim, view.format, view.nbytes), (1, "B", buffer.size))
+                    expected = camera_frame(frame.sequence - 1, WIDTH, buffer.size, HEIGHT)
+                    self.assertEqual(view.tobytes(), expected)
+                    self.assertFalse(frame.stale)
+                    sequences.append(frame.sequence)
+                    view.release()
+                self.assertFalse(frame.locked)
+
+            self.assertEqual(sequences, sorted(set(sequences)))
+
+    # Bottom-up RGB24 comes with a negative row stride, row 0 is the last one in memory
+    def test_rgb_bottom_up(self):
+        with cdi.open_device(2, WIDTH, HEIGHT, cdi.RGB24) as buffer:
+            with buffer.lock() as frame:
+                self.assertFalse(frame.top_down)
+                view = memoryview(frame)
+                self.assertEqual(view.shape, (HEIGHT, WIDTH, 3))
+                self.assertEqual(view.strides, (-WIDTH * 3, 3, 1))
+
+                rows = view.tobytes()
+                view.release()
+
+                pitch = WIDTH * 3
+                memory = camera_frame(frame.sequence - 1, pitch, pitch * HEIGHT, HEIGHT)
+                self.assertEqual(rows, b"".join(memory[row * pitch:(row + 1) * pitch] for row in reversed(range(HEIGHT))))
+
+    # YUY2 through the Color Converter DSP, top-down RGBA32 through the kernels
+    def test_converted_shapes(self):
+        with cdi.open_device(1, 320, 240, cdi.RGB24) as buffer:
+            with buffer.lock() as frame:
+                view = memoryview(frame)
+                self.assertEqual(view.shape, (240, 320, 3))
+                self.assertLess(view.strides[0], 0)
+                view.release()
+
+        with cdi.open_device(1, 320, 240, cdi.RGBA32, top_down=True) as buffer:
+            with buffer.lock() as frame:
+                self.assertTrue(frame.top_down)
+                view = memoryview(frame)
+                self.assertEqual(view.shape, (240, 320, 4))
+                self.assertEqual(view.strides, (320 * 4, 4, 1))
+                self.assertTrue(view.c_contiguous)
+                view.release()
+
+    def test_locking(self):
+        buffer = cdi.open_device(0, WIDTH, HEIGHT, cdi.I420, asynchronous=True)
+        frame = buffer.lock()
+
+        # One frame at a time, kept while views of it exist
+        with self.assertRaises(RuntimeError):
+            buffer.lock()
+        with self.assertRaises(RuntimeError):
+            buffer.close()
+        view = memoryview(frame)
+        with self.assertRaises(BufferError):
+            frame.unlock()
+        with self.assertRaises(TypeError):
+            (ctypes.c_char * buffer.size).from_buffer(frame)
+        view.release()
+        frame.unlock()
+        self.assertFalse(frame.locked)
+        with self.assertRaises(BufferError):
+            memoryview(frame)
+
+        # Garbage collection unlocks as well
+        buffer.lock()
+        buffer.lock().unlock()
+
+        buffer.close()
+        with self.assertRaises(ValueError):
+            buffer.lock()
+
+    def test_read_into(self):
+        with cdi.open_device(0, WIDTH, HEIGHT, cdi.I420) as buffer:
+            target = bytearray(buffer.size)
+            self.assertTrue(buffer.read_into(target))
+            pattern = [camera_frame(sequence, WIDTH, buffer.size, HEIGHT) for sequence in range(60)]
+            self.assertIn(bytes(target), pattern)
+
+            # Rows of all planes further apart, chroma rows at half the stride
+            stride = WIDTH + 16
+            padded = bytearray(buffer.size // WIDTH * stride)
+            self.assertTrue(buffer.read_into(padded, stride))
+            planes = [(0, WIDTH, stride, HEIGHT),
+                      (HEIGHT * stride, WIDTH // 2, stride // 2, HEIGHT // 2),
+                      (HEIGHT * stride + HEIGHT // 2 * stride // 2, WIDTH // 2, stride // 2, HEIGHT // 2)]
+            packed = b"".join(bytes(padded[offset + row * pitch:offset + row * pitch + width])
+                              for offset, width, pitch, rows in planes for row in range(rows))
+            self.assertIn(packed, pattern)
+
+            with self.assertRaises(ValueError):
+                buffer.read_into(bytearray(16))
+            with self.assertRaises(BufferError):
+                buffer.read_into(bytes(buffer.size))
+
+
+if __name__ == "__main__":
+    sys.exit(0 if unittest.main(exit=False).result.wasSuccessful() else 1)
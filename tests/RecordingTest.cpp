@@ -0,0 +1,257 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// The capture container: frames come back as they were appended, through the lossless codec
+// too. A file without its index, cut off while the last frame was written, is recovered up to
+// that frame, and so is one whose trailer claims more frames than fit. find() lands on the last
+// frame at or before a timestamp also when the frames do not come at a constant rate.
+
+#include "Check.h"
+#include "RecordingFormat.h"
+
+#include <cdi/cdi.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 64;
+const uint32_t HEIGHT = 48;
+const size_t FRAME_SIZE = WIDTH * HEIGHT * 3 / 2;
+const uint64_t FRAMES = 12;
+const char* RECORDING = "RecordingTest.cdi";
+const wchar_t* RECORDING_W = L"RecordingTest.cdi";
+
+// Gradients which move with the frame, compressible but different for every frame
+std::vector<uint8_t> make_frame(const uint64_t& index)
+{
+    std::vector<uint8_t> frame(FRAME_SIZE);
+    for(size_t i = 0; i < frame.size(); i++)
+    {
+        frame[i] = static_cast<uint8_t>(i % WIDTH + i / WIDTH * 2 + index * 5);
+    }
+    return frame;
+}
+
+// Frame timestamps in 100 ns units: bursts, gaps and two frames at the same time
+int64_t timestamp(const uint64_t& index)
+{
+    const int64_t times[FRAMES] = {1000, 1010, 1020, 1021, 5000, 5000, 5001, 90000, 90333, 90666, 400000, 400001};
+    return times[index];
+}
+
+bool write_recording(std::unique_ptr<cdi::ICodec> codec)
+{
+    std::unique_ptr<cdi::IRecorder> recorder = cdi::create_recording(
+        RECORDING_W, WIDTH, HEIGHT, cdi::Encoding::I420, L"Camera", std::move(codec));
+    if(!recorder)
+    {
+        return false;
+    }
+
+    for(uint64_t i = 0; i < FRAMES; i++)
+    {
+        const std::vector<uint8_t> frame = make_frame(i);
+        if(!recorder->append(frame.data(), frame.size(), timestamp(i)))
+        {
+            return false;
+        }
+    }
+
+    return recorder->close() && recorder->frame_count() == FRAMES;
+}
+
+std::vector<uint8_t> read_file()
+{
+    std::vector<uint8_t> data;
+    FILE* file = std::fopen(RECORDING, "rb");
+    if(file != nullptr)
+    {
+        uint8_t chunk[4096];
+        size_t read = 0;
+        while((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            data.insert(data.end(), chunk, chunk + read);
+        }
+        std::fclose(file);
+    }
+    return data;
+}
+
+void write_file(const std::vector<uint8_t>& data)
+{
+    FILE* file = std::fopen(RECORDING, "wb");
+    if(file != nullptr)
+    {
+        std::fwrite(data.data(), 1, data.size(), file);
+        std::fclose(file);
+    }
+}
+
+// The first 'count' frames read back as they were appended
+void check_frames(cdi::IRecording& recording, const uint64_t& count, const bool& compressed)
+{
+    CHECK(recording.frame_count() == count);
+    CHECK(recording.size() == FRAME_SIZE);
+
+    std::vector<uint8_t> frame(recording.size());
+    for(uint64_t i = 0; i < count; i++)
+    {
+        cdi::RecordedFrame info;
+        CHECK(recording.frame(i, info));
+        CHECK(info.timestamp == timestamp(i));
+        CHECK(info.compressed == compressed);
+        CHECK(!compressed || info.size < FRAME_SIZE);
+        CHECK(recording.read(i, frame.data(), frame.size()));
+        CHECK(frame == make_frame(i));
+    }
+
+    cdi::RecordedFrame info;
+    CHECK(!recording.frame(count, info));
+    CHECK(!recording.read(count, frame.data(), frame.size()));
+}
+
+void test_round_trip()
+{
+    for(const bool compressed : {false, true})
+    {
+        REQUIRE(write_recording(compressed ? cdi::create_lossless_codec(cdi::Predictor::MEDIAN, 2) : nullptr));
+
+        std::unique_ptr<cdi::IRecording> recording = cdi::open_recording(RECORDING_W);
+        REQUIRE(recording);
+        CHECK(recording->width() == WIDTH);
+        CHECK(recording->height() == HEIGHT);
+        CHECK(recording->encoding() == cdi::Encoding::I420);
+        CHECK(recording->device_name() == L"Camera");
+        CHECK(!recording->recovered());
+        check_frames(*recording, FRAMES, compressed);
+
+        // Too small for a frame
+        std::vector<uint8_t> frame(FRAME_SIZE - 1);
+        CHECK(!recording->read(0, frame.data(), frame.size()));
+    }
+}
+
+void test_recovery()
+{
+    REQUIRE(write_recording(cdi::create_lossless_codec(cdi::Predictor::LEFT, 1)));
+    std::vector<uint8_t> data = read_file();
+    REQUIRE(data.size() > sizeof(cdi::recording::Trailer));
+
+    // Cut in the middle of the last payload, the index behind it goes too
+    cdi::recording::Trailer trailer = {};
+    std::memcpy(&trailer, data.data() + data.size() - sizeof(trailer), sizeof(trailer));
+    REQUIRE(trailer.frame_count == FRAMES);
+
+    cdi::recording::IndexEntry last = {};
+    std::memcpy(&last, data.data() + trailer.index_offset + (FRAMES - 1) * sizeof(last), sizeof(last));
+    std::vector<uint8_t> truncated(data.begin(), data.begin() + last.offset + sizeof(cdi::recording::FrameHeader) + last.size / 2);
+    write_file(truncated);
+
+    std::unique_ptr<cdi::IRecording> recording = cdi::open_recording(RECORDING_W);
+    REQUIRE(recording);
+    CHECK(recording->recovered());
+    check_frames(*recording, FRAMES - 1, true);
+    recording.reset();
+
+    // A frame count which wraps the index size around to the one of the file
+    trailer.frame_count += uint64_t(1) << 59;
+    std::memcpy(data.data() + data.size() - sizeof(trailer), &trailer, sizeof(trailer));
+    write_file(data);
+
+    recording = cdi::open_recording(RECORDING_W);
+    REQUIRE(recording);
+    CHECK(recording->recovered());
+    check_frames(*recording, FRAMES, true);
+}
+
+// Last frame at or before the time, the first for anything earlier
+uint64_t find_linear(const int64_t& time)
+{
+    uint64_t index = 0;
+    for(uint64_t i = 0; i < FRAMES; i++)
+    {
+        if(timestamp(i) <= time)
+        {
+            index = i;
+        }
+    }
+    return index;
+}
+
+void test_find()
+{
+    REQUIRE(write_recording(nullptr));
+    std::unique_ptr<cdi::IRecording> recording = cdi::open_recording(RECORDING_W);
+    REQUIRE(recording);
+
+    std::vector<int64_t> times = {0, 999, 400002, 1000000};
+    for(uint64_t i = 0; i < FRAMES; i++)
+    {
+        times.push_back(timestamp(i) - 1);
+        times.push_back(timestamp(i));
+        times.push_back(timestamp(i) + 1);
+    }
+    for(int64_t time = 0; time < 410000; time += 997)
+    {
+        times.push_back(time);
+    }
+
+    for(const int64_t time : times)
+    {
+        if(recording->find(time) != find_linear(time))
+        {
+            std::fprintf(stderr, "find(%lld) = %llu, expected %llu\n",
+                static_cast<long long>(time),
+                static_cast<unsigned long long>(recording->find(time)),
+                static_cast<unsigned long long>(find_linear(time)));
+            CHECK(!"find() missed the frame");
+        }
+    }
+}
+
+}
+
+int main()
+{
+    test_round_trip();
+    test_recovery();
+    test_find();
+
+    std::remove(RECORDING);
+
+    return cdi::test::result("RecordingTest");
+}
@@ -0,0 +1,183 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Sessions of the SDK stand-in: a pool keeps the camera activated between buffers so that the
+// next open skips the activation, serves one buffer per device at a time and shuts idle devices
+// down after the timeout or on clear(). reconfigure() switches a live stream to another resolution
+// and encoding without activating the camera again.
+
+#include "Check.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+
+namespace {
+
+const uint32_t ACTIVATE_MS = 60;
+const uint32_t IDLE_MS = 200;
+const int64_t MS = 10000; // clock_now() units
+
+std::shared_ptr<sdk::Camera> add_camera()
+{
+    sdk::remove_cameras();
+
+    sdk::CameraDesc desc;
+    desc.formats.push_back({MFVideoFormat_NV12, 320, 240, 30});
+    desc.formats.push_back({MFVideoFormat_YUY2, 640, 480, 30});
+    desc.activate_ms = ACTIVATE_MS;
+    return sdk::add_camera(desc);
+}
+
+bool read_frame(cdi::IBuffer& buffer)
+{
+    const bool locked = buffer.lock() != nullptr;
+    buffer.unlock();
+    return locked;
+}
+
+void check_pool()
+{
+    std::shared_ptr<sdk::Camera> camera = add_camera();
+    std::unique_ptr<cdi::ISessionPool> pool = cdi::create_session_pool(IDLE_MS);
+    REQUIRE(pool);
+
+    // Cold
+    std::unique_ptr<cdi::IBuffer> buffer = pool->open(0, 320, 240, cdi::Encoding::I420, cdi::StreamOptions());
+    REQUIRE(buffer);
+    CHECK(camera->activations() == 1);
+    CHECK(!buffer->open_timings().warm);
+    const int64_t cold = buffer->open_timings().total;
+    CHECK(cold >= ACTIVATE_MS * MS);
+    CHECK(read_frame(*buffer));
+
+    // One buffer per device
+    CHECK(!pool->open(0, 320, 240, cdi::Encoding::I420, cdi::StreamOptions()));
+    CHECK(!pool->open(1, 320, 240, cdi::Encoding::I420, cdi::StreamOptions()));
+
+    buffer.reset();
+    CHECK(pool->idle_count() == 1);
+    CHECK(camera->shutdowns() == 0);
+
+    // Warm, in another resolution and encoding
+    buffer = pool->open(0, 640, 480, cdi::Encoding::RGB24, cdi::StreamOptions());
+    REQUIRE(buffer);
+    CHECK(camera->activations() == 1);
+    CHECK(buffer->open_timings().warm);
+    // Neither enumeration nor activation, which take their time on a cold open
+    CHECK(buffer->open_timings().enumerate < ACTIVATE_MS * MS);
+    CHECK(buffer->open_timings().activate == 0);
+    CHECK(buffer->width() == 640 && buffer->height() == 480);
+    CHECK(read_frame(*buffer));
+    CHECK(pool->idle_count() == 0);
+    buffer.reset();
+
+    // Idle for longer than the timeout
+    std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_MS * 3));
+    CHECK(pool->idle_count() == 0);
+    CHECK(camera->shutdowns() == 1);
+
+    buffer = pool->open(0, 320, 240, cdi::Encoding::I420, cdi::StreamOptions());
+    REQUIRE(buffer);
+    CHECK(camera->activations() == 2);
+    CHECK(!buffer->open_timings().warm);
+    buffer.reset();
+
+    pool->clear();
+    CHECK(pool->idle_count() == 0);
+    CHECK(camera->shutdowns() == 2);
+
+    // A buffer outlives its pool
+    buffer = pool->open(0, 320, 240, cdi::Encoding::I420, cdi::StreamOptions());
+    REQUIRE(buffer);
+    pool.reset();
+    CHECK(read_frame(*buffer));
+    buffer.reset();
+    CHECK(camera->shutdowns() == camera->activations());
+
+    sdk::remove_cameras();
+}
+
+void check_reconfigure()
+{
+    std::shared_ptr<sdk::Camera> camera = add_camera();
+
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, 320, 240, cdi::Encoding::I420);
+    REQUIRE(buffer);
+    CHECK(read_frame(*buffer));
+    CHECK(!buffer->open_timings().warm);
+
+    REQUIRE(buffer->reconfigure(640, 480, cdi::Encoding::RGB24));
+    CHECK(camera->activations() == 1);
+    CHECK(buffer->width() == 640 && buffer->height() == 480);
+    CHECK(buffer->encoding() == cdi::Encoding::RGB24);
+    CHECK(buffer->open_timings().warm);
+    CHECK(buffer->open_timings().enumerate == 0);
+    CHECK(buffer->open_timings().activate == 0);
+    REQUIRE(buffer->lock() != nullptr);
+    CHECK(buffer->size() == 640 * 480 * 3);
+
+    // Not while locked, and the stream keeps its configuration on failure
+    CHECK(!buffer->reconfigure(320, 240, cdi::Encoding::I420));
+    buffer->unlock();
+    CHECK(!buffer->reconfigure(320, 240, cdi::Encoding::UNKNOWN));
+    CHECK(!buffer->reconfigure(320, 240, cdi::Encoding::MJPEG));
+    CHECK(buffer->width() == 640 && buffer->encoding() == cdi::Encoding::RGB24);
+    CHECK(read_frame(*buffer));
+
+    // And back
+    REQUIRE(buffer->reconfigure(320, 240, cdi::Encoding::I420));
+    REQUIRE(buffer->lock() != nullptr);
+    CHECK(buffer->size() == 320 * 240 * 3 / 2);
+    buffer->unlock();
+    CHECK(camera->activations() == 1);
+
+    buffer.reset();
+    CHECK(camera->shutdowns() == 1);
+
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_pool();
+    check_reconfigure();
+
+    return cdi::test::result("SessionTest");
+}
@@ -0,0 +1,151 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Shared streams on the SDK stand-in: consumers in several encodings share one activation and one
+// read per frame, consumers of the same encoding get the same converted memory, the I420 planes
+// are the ones of the camera and RGB24 and RGBA32 agree. The buffers keep the capture running
+// once the stream object is gone.
+
+#include "Check.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 64;
+const uint32_t HEIGHT = 48;
+
+std::shared_ptr<sdk::Camera> add_camera()
+{
+    sdk::remove_cameras();
+
+    sdk::CameraDesc desc;
+    desc.formats.push_back({MFVideoFormat_NV12, WIDTH, HEIGHT, 30});
+    return sdk::add_camera(desc);
+}
+
+// The luma plane of the locked I420 frame is the one of camera frame 'sequence'
+bool same_luma(const uint8_t* frame, const uint64_t& sequence)
+{
+    uint32_t pitch = 0;
+    uint32_t size = 0;
+    sdk::packed_layout(MFVideoFormat_NV12, WIDTH, HEIGHT, pitch, size);
+    std::vector<uint8_t> camera(size);
+    sdk::fill_frame(MFVideoFormat_NV12, WIDTH, HEIGHT, sequence, camera.data());
+    return std::memcmp(frame, camera.data(), WIDTH * HEIGHT) == 0;
+}
+
+void check_consumers()
+{
+    std::shared_ptr<sdk::Camera> camera = add_camera();
+
+    std::unique_ptr<cdi::ISharedStream> stream = cdi::open_shared(0, WIDTH, HEIGHT, cdi::StreamOptions());
+    REQUIRE(stream);
+    CHECK(stream->width() == WIDTH && stream->height() == HEIGHT);
+
+    std::unique_ptr<cdi::IBuffer> recorder = stream->attach(cdi::Encoding::I420);
+    std::unique_ptr<cdi::IBuffer> preview = stream->attach(cdi::Encoding::RGBA32);
+    std::unique_ptr<cdi::IBuffer> analytics = stream->attach(cdi::Encoding::RGB24);
+    std::unique_ptr<cdi::IBuffer> second_preview = stream->attach(cdi::Encoding::RGBA32);
+    REQUIRE(recorder && preview && analytics && second_preview);
+    CHECK(!stream->attach(cdi::Encoding::MJPEG));
+    CHECK(!stream->attach(cdi::Encoding::UNKNOWN));
+    CHECK(camera->activations() == 1);
+    CHECK(!preview->reconfigure(WIDTH, HEIGHT, cdi::Encoding::I420));
+
+    for(int round = 0; round < 3; round++)
+    {
+        // The first consumer reads a frame from the device, the others get the same one
+        const uint64_t frames = camera->frames();
+        const uint8_t* i420 = static_cast<const uint8_t*>(recorder->lock());
+        const uint8_t* rgba = static_cast<const uint8_t*>(preview->lock());
+        const uint8_t* rgb = static_cast<const uint8_t*>(analytics->lock());
+        const uint8_t* second_rgba = static_cast<const uint8_t*>(second_preview->lock());
+        REQUIRE(i420 != nullptr && rgba != nullptr && rgb != nullptr && second_rgba != nullptr);
+        CHECK(camera->frames() == frames + 1);
+
+        const uint64_t sequence = recorder->info().sequence;
+        CHECK(preview->info().sequence == sequence);
+        CHECK(analytics->info().sequence == sequence);
+        CHECK(second_preview->info().sequence == sequence);
+
+        CHECK(recorder->size() == WIDTH * HEIGHT * 3 / 2);
+        CHECK(same_luma(i420, sequence - 1));
+
+        // One conversion per encoding and frame
+        CHECK(second_rgba == rgba);
+        bool agree = true;
+        for(uint32_t i = 0; i < WIDTH * HEIGHT; i++)
+        {
+            agree = agree && std::memcmp(rgb + i * 3, rgba + i * 4, 3) == 0;
+        }
+        CHECK(agree);
+
+        recorder->unlock();
+        preview->unlock();
+        analytics->unlock();
+        second_preview->unlock();
+    }
+
+    // The capture goes on without the stream object and ends with the last buffer
+    stream.reset();
+    const uint8_t* i420 = static_cast<const uint8_t*>(recorder->lock());
+    REQUIRE(i420 != nullptr);
+    CHECK(same_luma(i420, recorder->info().sequence - 1));
+    recorder->unlock();
+
+    preview.reset();
+    analytics.reset();
+    second_preview.reset();
+    CHECK(camera->shutdowns() == 0);
+    recorder.reset();
+    CHECK(camera->shutdowns() == 1);
+    CHECK(camera->activations() == 1);
+
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_consumers();
+
+    return cdi::test::result("SharedStreamTest");
+}
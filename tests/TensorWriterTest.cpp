@@ -0,0 +1,426 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Tensor output: element positions of both layouts, channel order, the normalisation of the
+// float types, bilinear resampling with aligned pixel centers and the I420 conversion in the
+// matrix and range of the level, odd sizes included.
+
+#include "Check.h"
+#include "FrameLayout.h"
+#include "TensorWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 5;
+const uint32_t HEIGHT = 3;
+
+cdi::TensorDesc desc(const uint32_t& width, const uint32_t& height, const cdi::TensorLayout& layout, const cdi::TensorType& type, const cdi::ChannelOrder& order)
+{
+    cdi::TensorDesc result;
+    result.width = width;
+    result.height = height;
+    result.layout = layout;
+    result.type = type;
+    result.order = order;
+    return result;
+}
+
+// B, G, R of image pixel x, y, every value differs
+uint8_t channel(const uint32_t& x, const uint32_t& y, const uint32_t& bgr)
+{
+    return static_cast<uint8_t>(bgr * 80 + y * 20 + x * 3 + 1);
+}
+
+// Packed BGR(A) in the memory order of the stream
+std::vector<uint8_t> render_rgb(const uint32_t& bpp, const bool& top_down)
+{
+    std::vector<uint8_t> frame(WIDTH * HEIGHT * bpp, 0xEE);
+    for(uint32_t y = 0; y < HEIGHT; y++)
+    {
+        const uint32_t memory_row = top_down ? y : HEIGHT - 1 - y;
+        for(uint32_t x = 0; x < WIDTH; x++)
+        {
+            for(uint32_t c = 0; c < 3; c++)
+            {
+                frame[(memory_row * WIDTH + x) * bpp + c] = channel(x, y, c);
+            }
+        }
+    }
+    return frame;
+}
+
+cdi::FrameLevel level(const std::vector<uint8_t>& frame, const uint32_t& width, const uint32_t& height, const cdi::Encoding& encoding, const bool& top_down)
+{
+    cdi::FrameLevel result;
+    result.width = width;
+    result.height = height;
+    result.encoding = encoding;
+    result.size = frame.size();
+    result.data = frame.data();
+    result.top_down = top_down;
+    return result;
+}
+
+// Element of output channel c at x, y
+size_t index(const cdi::TensorLayout& layout, const uint32_t& width, const uint32_t& height, const uint32_t& x, const uint32_t& y, const uint32_t& c)
+{
+    if(layout == cdi::TensorLayout::NCHW)
+    {
+        return (static_cast<size_t>(c) * height + y) * width + x;
+    }
+    return (static_cast<size_t>(y) * width + x) * 3 + c;
+}
+
+float half_to_float(const uint16_t& h)
+{
+    const uint32_t exponent = (h >> 10) & 0x1F;
+    const uint32_t mantissa = h & 0x3FF;
+    float value;
+    if(exponent == 0)
+    {
+        value = std::ldexp(static_cast<float>(mantissa), -24);
+    }
+    else
+    {
+        value = std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+    }
+    return (h & 0x8000) != 0 ? -value : value;
+}
+
+void test_init()
+{
+    cdi::TensorWriter writer;
+    CHECK(!writer.init(desc(0, 4, cdi::TensorLayout::NCHW, cdi::TensorType::FLOAT32, cdi::ChannelOrder::RGB)));
+    CHECK(!writer.init(desc(4, 0, cdi::TensorLayout::NCHW, cdi::TensorType::FLOAT32, cdi::ChannelOrder::RGB)));
+
+    cdi::TensorDesc zero_std = desc(4, 4, cdi::TensorLayout::NCHW, cdi::TensorType::FLOAT32, cdi::ChannelOrder::RGB);
+    zero_std.std[1] = 0.0f;
+    CHECK(!writer.init(zero_std));
+
+    REQUIRE(writer.init(desc(7, 5, cdi::TensorLayout::NHWC, cdi::TensorType::FLOAT16, cdi::ChannelOrder::BGR)));
+    CHECK(writer.size() == 7 * 5 * 3 * 2);
+    REQUIRE(writer.init(desc(7, 5, cdi::TensorLayout::NCHW, cdi::TensorType::UINT8, cdi::ChannelOrder::RGB)));
+    CHECK(writer.size() == 7 * 5 * 3);
+
+    // Only the encodings it converts
+    const std::vector<uint8_t> frame(7 * 5 * 2);
+    std::vector<uint8_t> tensor(writer.size());
+    CHECK(!writer.write(level(frame, 7, 5, cdi::Encoding::P010, false), tensor.data(), 0));
+    CHECK(!writer.write(level(frame, 7, 5, cdi::Encoding::RGB24, false), nullptr, 0));
+}
+
+void test_layouts()
+{
+    // Same size in and out, every element is one source sample
+    for(const uint32_t bpp : {3u, 4u})
+    {
+        for(const bool top_down : {false, true})
+        {
+            const std::vector<uint8_t> frame = render_rgb(bpp, top_down);
+            const cdi::Encoding encoding = bpp == 3 ? cdi::Encoding::RGB24 : cdi::Encoding::RGBA32;
+
+            for(const cdi::TensorLayout layout : {cdi::TensorLayout::NCHW, cdi::TensorLayout::NHWC})
+            {
+                for(const cdi::ChannelOrder order : {cdi::ChannelOrder::RGB, cdi::ChannelOrder::BGR})
+                {
+                    cdi::TensorWriter writer;
+                    REQUIRE(writer.init(desc(WIDTH, HEIGHT, layout, cdi::TensorType::UINT8, order)));
+                    std::vector<uint8_t> tensor(writer.size(), 0xEE);
+                    REQUIRE(writer.write(level(frame, WIDTH, HEIGHT, encoding, top_down), tensor.data(), 0));
+
+                    bool exact = true;
+                    for(uint32_t y = 0; y < HEIGHT; y++)
+                    {
+                        for(uint32_t x = 0; x < WIDTH; x++)
+                        {
+                            for(uint32_t c = 0; c < 3; c++)
+                            {
+                                const uint32_t bgr = order == cdi::ChannelOrder::RGB ? 2 - c : c;
+                                exact = exact && tensor[index(layout, WIDTH, HEIGHT, x, y, c)] == channel(x, y, bgr);
+                            }
+                        }
+                    }
+                    CHECK(exact);
+                }
+            }
+        }
+    }
+}
+
+void test_batch()
+{
+    const std::vector<uint8_t> frame = render_rgb(3, false);
+    cdi::TensorWriter writer;
+    REQUIRE(writer.init(desc(WIDTH, HEIGHT, cdi::TensorLayout::NHWC, cdi::TensorType::UINT8, cdi::ChannelOrder::BGR)));
+
+    // Item 1 follows item 0, the rest of the tensor stays
+    std::vector<uint8_t> tensor(writer.size() * 3, 0xEE);
+    REQUIRE(writer.write(level(frame, WIDTH, HEIGHT, cdi::Encoding::RGB24, false), tensor.data(), 1));
+    const size_t item = writer.size();
+    CHECK(tensor[item - 1] == 0xEE);
+    CHECK(tensor[item * 2] == 0xEE);
+    CHECK(tensor[item] == channel(0, 0, 0));
+    CHECK(tensor[item * 2 - 1] == channel(WIDTH - 1, HEIGHT - 1, 2));
+}
+
+void test_normalisation()
+{
+    const std::vector<uint8_t> frame = render_rgb(3, true);
+
+    for(const cdi::TensorType type : {cdi::TensorType::FLOAT32, cdi::TensorType::FLOAT16})
+    {
+        for(const cdi::ChannelOrder order : {cdi::ChannelOrder::RGB, cdi::ChannelOrder::BGR})
+        {
+            // The ImageNet constants, per output channel
+            cdi::TensorDesc normalised = desc(WIDTH, HEIGHT, cdi::TensorLayout::NCHW, type, order);
+            const float mean[3] = {0.485f, 0.456f, 0.406f};
+            const float std[3] = {0.229f, 0.224f, 0.225f};
+            std::memcpy(normalised.mean, mean, sizeof(mean));
+            std::memcpy(normalised.std, std, sizeof(std));
+
+            cdi::TensorWriter writer;
+            REQUIRE(writer.init(normalised));
+            std::vector<uint8_t> tensor(writer.size());
+            REQUIRE(writer.write(level(frame, WIDTH, HEIGHT, cdi::Encoding::RGB24, true), tensor.data(), 0));
+
+            // Half precision keeps 11 significant bits
+            const float tolerance = type == cdi::TensorType::FLOAT32 ? 1e-5f : 4e-3f;
+            bool close = true;
+            for(uint32_t y = 0; y < HEIGHT; y++)
+            {
+                for(uint32_t x = 0; x < WIDTH; x++)
+                {
+                    for(uint32_t c = 0; c < 3; c++)
+                    {
+                        const uint32_t bgr = order == cdi::ChannelOrder::RGB ? 2 - c : c;
+                        const float expected = (channel(x, y, bgr) / 255.0f - mean[c]) / std[c];
+                        const size_t i = index(cdi::TensorLayout::NCHW, WIDTH, HEIGHT, x, y, c);
+                        float value;
+                        if(type == cdi::TensorType::FLOAT32)
+                        {
+                            std::memcpy(&value, tensor.data() + i * 4, sizeof(value));
+                        }
+                        else
+                        {
+                            uint16_t half;
+                            std::memcpy(&half, tensor.data() + i * 2, sizeof(half));
+                            value = half_to_float(half);
+                        }
+                        close = close && std::fabs(value - expected) <= tolerance * std::max(1.0f, std::fabs(expected));
+                    }
+                }
+            }
+            CHECK(close);
+        }
+    }
+
+    // Exact halves at the ends of the range
+    const std::vector<uint8_t> white(3 * 2, 255);
+    const std::vector<uint8_t> black(3 * 2, 0);
+    cdi::TensorWriter writer;
+    REQUIRE(writer.init(desc(2, 1, cdi::TensorLayout::NHWC, cdi::TensorType::FLOAT16, cdi::ChannelOrder::RGB)));
+    std::vector<uint16_t> halves(6);
+    REQUIRE(writer.write(level(white, 2, 1, cdi::Encoding::RGB24, false), halves.data(), 0));
+    CHECK(halves[0] == 0x3C00 && halves[5] == 0x3C00);
+    REQUIRE(writer.write(level(black, 2, 1, cdi::Encoding::RGB24, false), halves.data(), 0));
+    CHECK(halves[0] == 0x0000 && halves[5] == 0x0000);
+}
+
+void test_resize()
+{
+    // Pixel centers are aligned: halving averages pairs, doubling interpolates at quarters
+    std::vector<uint8_t> row(4 * 3);
+    const uint8_t values[4] = {0, 100, 200, 252};
+    for(uint32_t x = 0; x < 4; x++)
+    {
+        row[x * 3] = row[x * 3 + 1] = row[x * 3 + 2] = values[x];
+    }
+
+    cdi::TensorWriter half;
+    REQUIRE(half.init(desc(2, 1, cdi::TensorLayout::NCHW, cdi::TensorType::FLOAT32, cdi::ChannelOrder::RGB)));
+    std::vector<float> halved(6);
+    REQUIRE(half.write(level(row, 4, 1, cdi::Encoding::RGB24, false), halved.data(), 0));
+    CHECK(std::fabs(halved[0] * 255.0f - 50.0f) < 1e-3f);
+    CHECK(std::fabs(halved[1] * 255.0f - 226.0f) < 1e-3f);
+
+    cdi::TensorWriter twice;
+    REQUIRE(twice.init(desc(8, 2, cdi::TensorLayout::NCHW, cdi::TensorType::UINT8, cdi::ChannelOrder::RGB)));
+    std::vector<uint8_t> doubled(twice.size());
+    REQUIRE(twice.write(level(row, 4, 1, cdi::Encoding::RGB24, false), doubled.data(), 0));
+    const uint8_t expected[8] = {0, 25, 75, 125, 175, 213, 239, 252};
+    CHECK(std::memcmp(doubled.data(), expected, 8) == 0);
+    CHECK(std::memcmp(doubled.data() + 8, expected, 8) == 0);
+
+    // The taps follow a change of the source size
+    std::vector<uint8_t> pair(2 * 3, 40);
+    REQUIRE(half.write(level(pair, 2, 1, cdi::Encoding::RGB24, false), halved.data(), 0));
+    CHECK(std::fabs(halved[0] * 255.0f - 40.0f) < 1e-3f && std::fabs(halved[1] * 255.0f - 40.0f) < 1e-3f);
+}
+
+void test_i420()
+{
+    // BT.601 limited range: neutral chroma gives gray, a raised V red
+    const uint32_t width = 4;
+    const uint32_t height = 2;
+    std::vector<uint8_t> frame(width * height + 2 * (width / 2) * (height / 2));
+    std::memset(frame.data(), 126, width * height);
+    uint8_t* u = frame.data() + width * height;
+    uint8_t* v = u + (width / 2) * (height / 2);
+    u[0] = u[1] = 128;
+    v[0] = 128;
+    v[1] = 200;
+
+    for(const cdi::ChannelOrder order : {cdi::ChannelOrder::RGB, cdi::ChannelOrder::BGR})
+    {
+        cdi::TensorWriter writer;
+        REQUIRE(writer.init(desc(width, height, cdi::TensorLayout::NHWC, cdi::TensorType::UINT8, order)));
+        std::vector<uint8_t> tensor(writer.size());
+        REQUIRE(writer.write(level(frame, width, height, cdi::Encoding::I420, false), tensor.data(), 0));
+
+        const uint32_t r = order == cdi::ChannelOrder::RGB ? 0 : 2;
+        const uint32_t b = 2 - r;
+
+        // (126 - 16) * 1.164 = 128.04
+        CHECK(tensor[0] == 128 && tensor[1] == 128 && tensor[2] == 128);
+
+        // The right half, chroma is not interpolated past the last sample
+        const size_t right = index(cdi::TensorLayout::NHWC, width, height, 3, 1, 0);
+        CHECK(tensor[right + r] == 243);
+        CHECK(tensor[right + 1] == 70);
+        CHECK(tensor[right + b] == 128);
+    }
+}
+
+// R, G, B of 8 bit Y, U, V
+void reference_rgb(const double& y, const double& u, const double& v, const cdi::ColorSpace& color, double* rgb)
+{
+    const double kr = color.matrix == cdi::ColorMatrix::BT709 ? 0.2126 : color.matrix == cdi::ColorMatrix::BT2020 ? 0.2627 : 0.299;
+    const double kb = color.matrix == cdi::ColorMatrix::BT709 ? 0.0722 : color.matrix == cdi::ColorMatrix::BT2020 ? 0.0593 : 0.114;
+    const bool full = color.range == cdi::ColorRange::FULL;
+    const double luma = (y - (full ? 0 : 16)) * (full ? 1.0 : 255.0 / 219.0);
+    const double cb = (u - 128) * (full ? 1.0 : 255.0 / 224.0);
+    const double cr = (v - 128) * (full ? 1.0 : 255.0 / 224.0);
+
+    rgb[0] = luma + 2.0 * (1.0 - kr) * cr;
+    rgb[2] = luma + 2.0 * (1.0 - kb) * cb;
+    rgb[1] = (luma - kr * rgb[0] - kb * rgb[2]) / (1.0 - kr - kb);
+    for(uint32_t c = 0; c < 3; c++)
+    {
+        rgb[c] = std::min(255.0, std::max(0.0, rgb[c]));
+    }
+}
+
+void test_i420_odd()
+{
+    // A pyramid level of 1920x1080 halved three times: chroma planes of 120x67 as laid out by
+    // FrameLayout, in a buffer of exactly that size, the last luma row without chroma
+    const uint32_t width = 240;
+    const uint32_t height = 135;
+    cdi::FrameLayout layout;
+    REQUIRE(layout.init(width, height, cdi::Encoding::I420));
+    std::vector<uint8_t> frame(layout.size());
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            frame[y * width + x] = static_cast<uint8_t>(16 + (x + y * 3) % 220);
+        }
+    }
+    std::memset(frame.data() + layout.plane(1).offset, 90, layout.plane(1).stride * layout.plane(1).height);
+    std::memset(frame.data() + layout.plane(2).offset, 170, layout.plane(2).stride * layout.plane(2).height);
+
+    const cdi::ColorSpace colors[] = {
+        cdi::ColorSpace(cdi::ColorMatrix::DEFAULT, cdi::ColorRange::LIMITED),
+        cdi::ColorSpace(cdi::ColorMatrix::BT709, cdi::ColorRange::LIMITED),
+        cdi::ColorSpace(cdi::ColorMatrix::BT709, cdi::ColorRange::FULL),
+        cdi::ColorSpace(cdi::ColorMatrix::BT2020, cdi::ColorRange::FULL),
+    };
+
+    for(const cdi::ColorSpace& color : colors)
+    {
+        // Same size, every element converts one luma sample
+        cdi::TensorWriter writer;
+        REQUIRE(writer.init(desc(width, height, cdi::TensorLayout::NCHW, cdi::TensorType::FLOAT32, cdi::ChannelOrder::RGB)));
+        std::vector<float> tensor(writer.size() / sizeof(float));
+        cdi::FrameLevel level420 = level(frame, width, height, cdi::Encoding::I420, false);
+        level420.color = color;
+        REQUIRE(writer.write(level420, tensor.data(), 0));
+
+        uint32_t errors = 0;
+        for(uint32_t y = 0; y < height; y++)
+        {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                double rgb[3];
+                reference_rgb(frame[y * width + x], 90, 170, color, rgb);
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    errors += std::fabs(tensor[index(cdi::TensorLayout::NCHW, width, height, x, y, c)] * 255.0 - rgb[c]) > 0.05;
+                }
+            }
+        }
+        CHECK(errors == 0);
+    }
+
+    // Resized to the usual network input, up in height and down in width
+    cdi::TensorWriter square;
+    REQUIRE(square.init(desc(224, 224, cdi::TensorLayout::NHWC, cdi::TensorType::UINT8, cdi::ChannelOrder::BGR)));
+    std::vector<uint8_t> tensor(square.size());
+    REQUIRE(square.write(level(frame, width, height, cdi::Encoding::I420, false), tensor.data(), 0));
+
+    // Neither a byte short nor without chroma
+    std::vector<uint8_t> short_frame(layout.size() - 1);
+    CHECK(!square.write(level(short_frame, width, height, cdi::Encoding::I420, false), tensor.data(), 0));
+    std::vector<uint8_t> line(width * 3 / 2);
+    CHECK(!square.write(level(line, width, 1, cdi::Encoding::I420, false), tensor.data(), 0));
+    REQUIRE(square.write(level(frame, width, height, cdi::Encoding::I420, false), tensor.data(), 0));
+}
+
+}
+
+int main()
+{
+    test_init();
+    test_layouts();
+    test_batch();
+    test_normalisation();
+    test_resize();
+    test_i420();
+    test_i420_odd();
+
+    return cdi::test::result("TensorWriterTest");
+}
@@ -0,0 +1,238 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Thread placement on the SDK stand-in, which has four processors in one group on NUMA node 0.
+// Affinities the system refuses leave the thread where it was while the priority still applies
+// and the placement counts the refusal. Memory for a node the system does not have is refused,
+// streams on such a node take their frames and their pre-trigger ring from memory anywhere and
+// deliver the same frames as streams whose policy the system accepts.
+
+#include "Check.h"
+#include "NumaMemory.h"
+#include "ThreadPlacer.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+#include <windows.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+const uint32_t WIDTH = 64;
+const uint32_t HEIGHT = 48;
+const char* RECORDING = "ThreadPlacerTest.cdi";
+const wchar_t* RECORDING_W = L"ThreadPlacerTest.cdi";
+
+cdi::ThreadPolicy policy(const uint64_t& cpu_mask, const uint16_t& cpu_group, const cdi::MemoryPlacement& memory, const uint32_t& numa_node)
+{
+    cdi::ThreadPolicy policy;
+    policy.enabled = true;
+    policy.cpu_mask = cpu_mask;
+    policy.cpu_group = cpu_group;
+    policy.priority = cdi::ThreadPriority::HIGH;
+    policy.memory = memory;
+    policy.numa_node = numa_node;
+    return policy;
+}
+
+// On a thread of its own, the affinity and priority of the stand-in are per thread
+template<typename Test>
+void on_thread(Test test)
+{
+    std::thread thread(test);
+    thread.join();
+}
+
+void test_refused_affinity()
+{
+    on_thread([]()
+    {
+        // Processors beyond the four of the system
+        cdi::ThreadPlacer placer(policy(0x30, 0, cdi::MemoryPlacement::DEFAULT, 0));
+        CHECK(!placer.place());
+
+        cdi::ThreadPlacement placement = placer.placement();
+        CHECK(placement.threads == 1);
+        CHECK(placement.failed == 1);
+        CHECK(placement.cpu_mask == 1);
+        CHECK(placement.cpu_group == 0);
+        CHECK(placement.priority == THREAD_PRIORITY_HIGHEST);
+    });
+
+    on_thread([]()
+    {
+        // A group the system does not have
+        cdi::ThreadPlacer placer(policy(0x1, 1, cdi::MemoryPlacement::DEFAULT, 0));
+        CHECK(!placer.place());
+        CHECK(!cdi::ThreadPlacer::apply(policy(0x1, 1, cdi::MemoryPlacement::DEFAULT, 0)));
+
+        const cdi::ThreadPlacement placement = placer.placement();
+        CHECK(placement.failed == 1);
+        CHECK(placement.cpu_mask == 1);
+        CHECK(placement.cpu_group == 0);
+    });
+
+    on_thread([]()
+    {
+        // Accepted, a thread refused before is placed
+        cdi::ThreadPlacer placer(policy(0x6, 0, cdi::MemoryPlacement::DEFAULT, 0));
+        CHECK(placer.place());
+
+        const cdi::ThreadPlacement placement = placer.placement();
+        CHECK(placement.threads == 1);
+        CHECK(placement.failed == 0);
+        CHECK(placement.cpu_mask == 0x6);
+        CHECK(placement.priority == THREAD_PRIORITY_HIGHEST);
+    });
+
+    on_thread([]()
+    {
+        // Without a policy of its own nor one of the process nothing is applied nor counted
+        cdi::ThreadPlacer placer((cdi::ThreadPolicy()));
+        CHECK(placer.place());
+        CHECK(placer.placement().threads == 0);
+        CHECK(placer.memory_node() == -1);
+    });
+}
+
+void test_memory()
+{
+    CHECK(cdi::ThreadPlacer(policy(0, 0, cdi::MemoryPlacement::NODE, 3)).memory_node() == 3);
+    CHECK(cdi::ThreadPlacer(policy(0, 0, cdi::MemoryPlacement::OPENING_THREAD, 3)).memory_node() == 0);
+    CHECK(cdi::ThreadPlacer(policy(0, 0, cdi::MemoryPlacement::DEFAULT, 3)).memory_node() == -1);
+
+    cdi::NumaMemory memory;
+    CHECK(!memory.allocate(4096, 3));
+    CHECK(memory.data() == nullptr);
+    CHECK(memory.size() == 0);
+    CHECK(!memory.allocate(0, 0));
+
+    REQUIRE(memory.allocate(4096, 0));
+    REQUIRE(memory.data() != nullptr);
+    CHECK(memory.size() == 4096);
+    CHECK(memory.data()[0] == 0 && memory.data()[4095] == 0);
+    CHECK(!memory.allocate(4096, 0));
+    CHECK(cdi::memory_numa_node(memory.data()) == 0);
+
+    memory.free();
+    CHECK(memory.data() == nullptr);
+    CHECK(memory.size() == 0);
+    CHECK(memory.allocate(4096, NUMA_NO_PREFERRED_NODE));
+}
+
+// Luma of the frame is the one of a camera frame
+bool camera_luma(const uint8_t* frame)
+{
+    uint32_t pitch = 0;
+    uint32_t size = 0;
+    sdk::packed_layout(MFVideoFormat_NV12, WIDTH, HEIGHT, pitch, size);
+    std::vector<uint8_t> expected(size);
+    for(uint64_t sequence = 0; sequence < 1000; sequence++)
+    {
+        sdk::fill_frame(MFVideoFormat_NV12, WIDTH, HEIGHT, sequence, expected.data());
+        if(std::memcmp(frame, expected.data(), WIDTH * HEIGHT) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the placement of the stream after a few frames
+cdi::ThreadPlacement stream(const cdi::ThreadPolicy& threads)
+{
+    sdk::CameraDesc desc;
+    desc.formats.push_back({MFVideoFormat_NV12, WIDTH, HEIGHT, 120});
+    sdk::add_camera(desc);
+
+    cdi::StreamOptions options;
+    options.presample = cdi::Presample::DEFERRED;
+    options.pretrigger.seconds = 1;
+    options.threads = threads;
+
+    cdi::ThreadPlacement placement;
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, WIDTH, HEIGHT, cdi::Encoding::I420, options);
+    CHECK(buffer);
+    if(buffer)
+    {
+        for(int i = 0; i < 5; i++)
+        {
+            const uint8_t* frame = static_cast<const uint8_t*>(buffer->lock());
+            CHECK(frame != nullptr && camera_luma(frame));
+            buffer->unlock();
+        }
+
+        // The ring kept them
+        CHECK(buffer->dump(0, RECORDING_W, nullptr));
+        placement = buffer->placement();
+        buffer.reset();
+        std::remove(RECORDING);
+    }
+
+    sdk::remove_cameras();
+    return placement;
+}
+
+void test_stream()
+{
+    // Refused affinity and a node without memory, the stream runs as without them
+    const cdi::ThreadPlacement refused = stream(policy(0x100, 0, cdi::MemoryPlacement::NODE, 3));
+    CHECK(refused.threads > 0);
+    CHECK(refused.failed == refused.threads);
+    CHECK(refused.cpu_mask == 1);
+    CHECK(refused.priority == THREAD_PRIORITY_HIGHEST);
+    CHECK(refused.memory_node == 0);
+
+    const cdi::ThreadPlacement accepted = stream(policy(0x2, 0, cdi::MemoryPlacement::NODE, 0));
+    CHECK(accepted.threads > 0);
+    CHECK(accepted.failed == 0);
+    CHECK(accepted.cpu_mask == 0x2);
+    CHECK(accepted.memory_node == 0);
+}
+
+}
+
+int main()
+{
+    test_refused_affinity();
+    test_memory();
+    test_stream();
+
+    return cdi::test::result("ThreadPlacerTest");
+}
@@ -0,0 +1,390 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Trace rings: each thread keeps its latest events in the order they ended, a ring which wrapped
+// around drops the oldest ones, dumps taken while a thread keeps writing hold whole records of it
+// in order and a restart drops what was recorded before. Scopes of a stream carry the frame and
+// the device and nest as the calls do.
+
+#include "Check.h"
+#include "Trace.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+// Event of the dump, times in the 100ns units of the clock
+struct Event
+{
+    std::string name;
+    bool metadata;
+    unsigned long tid;
+    int64_t start;
+    int64_t duration;
+    unsigned long stream;
+    unsigned long long frame;
+    std::string device;
+};
+
+int64_t parse_time(const char* text)
+{
+    long long whole = 0;
+    long long tenths = 0;
+    return std::sscanf(text, "%lld.%lld", &whole, &tenths) == 2 ? whole * 10 + tenths : -1;
+}
+
+const char* field(const std::string& object, const char* key)
+{
+    const size_t at = object.find(key);
+    return at == std::string::npos ? nullptr : object.c_str() + at + std::strlen(key);
+}
+
+// Only what dump_trace() writes, objects end with their args
+std::vector<Event> parse(const std::string& dump)
+{
+    std::vector<Event> events;
+    const std::string open("{\"name\":\"");
+    size_t at = dump.find(open);
+    while(at != std::string::npos)
+    {
+        const size_t end = dump.find("}}", at);
+        if(end == std::string::npos)
+        {
+            break;
+        }
+        const std::string object = dump.substr(at, end - at);
+        at = dump.find(open, end);
+
+        Event event;
+        event.name = object.substr(open.size(), object.find('"', open.size()) - open.size());
+        event.metadata = object.find("\"ph\":\"M\"") != std::string::npos;
+        event.tid = std::strtoul(field(object, "\"tid\":"), nullptr, 10);
+        event.start = event.metadata ? 0 : parse_time(field(object, "\"ts\":"));
+        event.duration = event.metadata ? 0 : parse_time(field(object, "\"dur\":"));
+        event.stream = event.metadata ? 0 : std::strtoul(field(object, "\"stream\":"), nullptr, 10);
+        event.frame = event.metadata ? 0 : std::strtoull(field(object, "\"frame\":"), nullptr, 10);
+        if(!event.metadata)
+        {
+            const char* device = field(object, "\"device\":\"");
+            event.device.assign(device, object.c_str() + object.size() - 1);
+        }
+        events.push_back(event);
+    }
+    return events;
+}
+
+// Complete events by thread, in the order of the dump
+std::map<unsigned long, std::vector<Event>> by_thread(const std::string& dump)
+{
+    std::map<unsigned long, std::vector<Event>> threads;
+    for(const Event& event : parse(dump))
+    {
+        if(!event.metadata)
+        {
+            threads[event.tid].push_back(event);
+        }
+    }
+    return threads;
+}
+
+// Events whose times follow from the frame, a torn record does not add up
+void record(const uint64_t& frame)
+{
+    const int64_t start = 1000 + static_cast<int64_t>(frame) * 10;
+    cdi::trace::record(cdi::trace::Name::CONVERT, start, start + static_cast<int64_t>(frame % 7), 0, frame);
+}
+
+bool consistent(const Event& event)
+{
+    return event.name == "Convert"
+        && event.start == 1000 + static_cast<int64_t>(event.frame) * 10
+        && event.duration == static_cast<int64_t>(event.frame % 7);
+}
+
+// Frames 'first' to 'last' in order
+bool frames(const std::vector<Event>& events, const uint64_t& first, const uint64_t& last)
+{
+    if(events.size() != last - first + 1)
+    {
+        return false;
+    }
+    for(size_t i = 0; i < events.size(); i++)
+    {
+        if(events[i].frame != first + i || !consistent(events[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_wrap()
+{
+    cdi::start_trace(8);
+
+    std::thread([]()
+    {
+        for(uint64_t frame = 0; frame < 5; frame++)
+        {
+            record(frame);
+        }
+    }).join();
+    std::thread([]()
+    {
+        for(uint64_t frame = 0; frame < 8; frame++)
+        {
+            record(frame);
+        }
+    }).join();
+    std::thread([]()
+    {
+        for(uint64_t frame = 0; frame < 21; frame++)
+        {
+            record(frame);
+        }
+    }).join();
+    // Threads without events have no ring
+    std::thread([]() {}).join();
+
+    const std::string dump = cdi::dump_trace();
+    size_t names = 0;
+    for(const Event& event : parse(dump))
+    {
+        names += event.metadata ? 1 : 0;
+    }
+    CHECK(names == 3);
+
+    CHECK(by_thread(dump).size() == 3);
+
+    // Ended threads keep their rings, in the order the threads started recording
+    std::vector<Event> all;
+    for(const Event& event : parse(dump))
+    {
+        if(!event.metadata)
+        {
+            all.push_back(event);
+        }
+    }
+    REQUIRE(all.size() == 5 + 8 + 8);
+    CHECK(frames(std::vector<Event>(all.begin(), all.begin() + 5), 0, 4));
+    CHECK(frames(std::vector<Event>(all.begin() + 5, all.begin() + 13), 0, 7));
+    CHECK(frames(std::vector<Event>(all.begin() + 13, all.end()), 13, 20));
+    CHECK(all[0].tid != all[5].tid && all[5].tid != all[13].tid);
+
+    // A restart drops them, a ring of one keeps the last event
+    cdi::start_trace(1);
+    CHECK(parse(cdi::dump_trace()).empty());
+    std::thread([]()
+    {
+        for(uint64_t frame = 0; frame < 3; frame++)
+        {
+            record(frame);
+        }
+    }).join();
+    const std::map<unsigned long, std::vector<Event>> last = by_thread(cdi::dump_trace());
+    REQUIRE(last.size() == 1);
+    CHECK(frames(last.begin()->second, 2, 2));
+
+    cdi::stop_trace();
+}
+
+// Dumps while the writer goes around its ring, a large one so that it overwrites records while
+// they are copied
+void test_concurrent()
+{
+    const uint64_t capacity = 16384;
+    const uint32_t DUMPS = 60;
+    cdi::start_trace(static_cast<uint32_t>(capacity));
+
+    std::atomic<uint32_t> dumps(0);
+    std::atomic<uint64_t> written(0);
+    std::thread writer([&dumps, &written]()
+    {
+        uint64_t frame = 0;
+        for(; dumps < DUMPS; frame++)
+        {
+            record(frame);
+        }
+        written = frame;
+    });
+
+    bool ordered = true;
+    uint64_t last_frame = 0;
+    while(dumps < DUMPS)
+    {
+        const std::map<unsigned long, std::vector<Event>> threads = by_thread(cdi::dump_trace());
+        if(threads.empty())
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        dumps++;
+
+        const std::vector<Event>& events = threads.begin()->second;
+        ordered = ordered && threads.size() == 1 && events.size() <= capacity;
+        ordered = ordered && frames(events, events.front().frame, events.back().frame);
+        ordered = ordered && events.back().frame >= last_frame;
+        last_frame = events.back().frame;
+    }
+    writer.join();
+
+    CHECK(ordered);
+
+    // At rest the full ring
+    const std::map<unsigned long, std::vector<Event>> threads = by_thread(cdi::dump_trace());
+    REQUIRE(threads.size() == 1);
+    REQUIRE(written >= capacity);
+    CHECK(frames(threads.begin()->second, written - capacity, written - 1));
+
+    cdi::stop_trace();
+}
+
+void test_scopes()
+{
+    const uint32_t stream = cdi::trace::register_stream(L"Scope \"camera\"");
+
+    cdi::start_trace(16);
+    {
+        cdi::trace::Scope outer(cdi::trace::Name::LOCK, stream, 0);
+        {
+            cdi::trace::set_frame(stream, 41);
+            cdi::trace::Scope inner(cdi::trace::Name::CONVERT);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        outer.set_sequence(41);
+    }
+    {
+        cdi::trace::Scope frame(cdi::trace::Name::UNLOCK, stream, 41);
+        cdi::stop_trace();
+    }
+    {
+        cdi::trace::Scope stopped(cdi::trace::Name::UNLOCK, stream, 42);
+    }
+
+    const std::map<unsigned long, std::vector<Event>> threads = by_thread(cdi::dump_trace());
+    REQUIRE(threads.size() == 1);
+    const std::vector<Event>& events = threads.begin()->second;
+    REQUIRE(events.size() == 2);
+
+    // In the order they ended, the inner scope within the outer one
+    CHECK(events[0].name == "Convert" && events[1].name == "lock");
+    CHECK(events[0].start >= events[1].start);
+    CHECK(events[0].start + events[0].duration <= events[1].start + events[1].duration);
+    CHECK(events[0].duration >= 10000);
+    for(const Event& event : events)
+    {
+        CHECK(event.stream == stream);
+        CHECK(event.frame == 41);
+        CHECK(event.device == "Scope \\\"camera\\\"");
+    }
+
+    cdi::trace::set_frame(0, 0);
+}
+
+// Reads of a synchronous stream happen within the lock of their frame
+void test_stream()
+{
+    sdk::CameraDesc desc;
+    desc.name = L"Trace camera";
+    desc.formats.push_back({MFVideoFormat_NV12, 64, 48, 120});
+    sdk::add_camera(desc);
+
+    std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(0, 64, 48, cdi::Encoding::RGB24);
+    REQUIRE(buffer);
+
+    cdi::start_trace(256);
+    for(int i = 0; i < 6; i++)
+    {
+        CHECK(buffer->lock() != nullptr);
+        buffer->unlock();
+    }
+    cdi::stop_trace();
+    buffer.reset();
+    sdk::remove_cameras();
+
+    const std::map<unsigned long, std::vector<Event>> threads = by_thread(cdi::dump_trace());
+    REQUIRE(threads.size() == 1);
+    const std::vector<Event>& events = threads.begin()->second;
+
+    std::vector<Event> locks;
+    unsigned long long last_frame = 0;
+    for(size_t i = 0; i < events.size(); i++)
+    {
+        const Event& event = events[i];
+        CHECK(event.device == "Trace camera");
+        if(event.name != "lock")
+        {
+            continue;
+        }
+
+        CHECK(event.frame > last_frame);
+        last_frame = event.frame;
+        locks.push_back(event);
+
+        // Its unlock follows, the read of the frame ended before it within the lock
+        CHECK(i + 1 < events.size() && events[i + 1].name == "unlock" && events[i + 1].frame == event.frame);
+        bool read = false;
+        for(size_t j = 0; j < i; j++)
+        {
+            const Event& inner = events[j];
+            read = read || (inner.name == "ReadSample" && inner.frame == event.frame
+                && inner.start >= event.start && inner.start + inner.duration <= event.start + event.duration);
+        }
+        CHECK(read || locks.size() == 1);
+    }
+    CHECK(locks.size() == 6);
+}
+
+}
+
+int main()
+{
+    test_wrap();
+    test_concurrent();
+    test_scopes();
+    test_stream();
+
+    return cdi::test::result("TraceTest");
+}
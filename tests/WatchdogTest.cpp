@@ -0,0 +1,366 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// The watchdog on its own with made up times: when stalls, failed reads and failed conversions
+// are noticed, the retries, giving up and the recovery statistics. Then streams of the SDK
+// stand-in which stall, fail to read and fail to convert are rebuilt while lock() hands out the
+// last good frame marked stale.
+
+#include "Check.h"
+#include "Watchdog.h"
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef cdi::Watchdog::Action Action;
+
+const int64_t MS = 10000; // clock_now() units
+
+cdi::WatchdogOptions options()
+{
+    cdi::WatchdogOptions options;
+    options.enabled = true;
+    options.frame_interval_ms = 10;
+    options.stall_intervals = 5;
+    options.max_errors = 3;
+    options.retry_ms = 100;
+    options.give_up_ms = 1000;
+    return options;
+}
+
+// A stall is noticed after 'stall_intervals' frame intervals, rebuilds repeat every 'retry_ms'
+// until a frame arrives, which ends the recovery
+void check_stall()
+{
+    cdi::Watchdog watchdog;
+    watchdog.init(options(), 0, 0);
+    CHECK(watchdog.enabled());
+    CHECK(watchdog.period() == 10 * MS);
+    CHECK(watchdog.stall_timeout() == 50 * MS);
+
+    watchdog.frame(10 * MS);
+    CHECK(watchdog.check(59 * MS, false) == Action::NONE);
+    CHECK(watchdog.check(60 * MS, false) == Action::RECOVER);
+    CHECK(watchdog.recovering());
+    watchdog.attempted(65 * MS);
+
+    // The first rebuild brought nothing back
+    CHECK(watchdog.check(120 * MS, false) == Action::NONE);
+    CHECK(watchdog.check(164 * MS, false) == Action::NONE);
+    CHECK(watchdog.check(165 * MS, false) == Action::RECOVER);
+    watchdog.attempted(170 * MS);
+
+    watchdog.frame(200 * MS);
+    CHECK(!watchdog.recovering());
+    CHECK(watchdog.check(210 * MS, false) == Action::NONE);
+
+    const cdi::RecoveryStatistics statistics = watchdog.statistics();
+    CHECK(statistics.stalls == 1);
+    CHECK(statistics.failures == 0);
+    CHECK(statistics.recoveries == 1);
+    CHECK(statistics.attempts == 2);
+    CHECK(statistics.last == 140 * MS);
+    CHECK(statistics.longest == 140 * MS);
+    CHECK(statistics.total == 140 * MS);
+
+    // A second, shorter one adds up
+    CHECK(watchdog.check(250 * MS, false) == Action::RECOVER);
+    watchdog.attempted(250 * MS);
+    watchdog.frame(270 * MS);
+    const cdi::RecoveryStatistics second = watchdog.statistics();
+    CHECK(second.stalls == 2);
+    CHECK(second.recoveries == 2);
+    CHECK(second.last == 20 * MS);
+    CHECK(second.longest == 140 * MS);
+    CHECK(second.total == 160 * MS);
+}
+
+// Failed reads count when they come in a row, a frame in between ends the row
+void check_errors()
+{
+    cdi::Watchdog watchdog;
+    watchdog.init(options(), 0, 0);
+
+    CHECK(!watchdog.error());
+    CHECK(!watchdog.error());
+    watchdog.frame(5 * MS);
+    CHECK(!watchdog.error());
+    CHECK(!watchdog.error());
+    CHECK(watchdog.check(10 * MS, false) == Action::NONE);
+    CHECK(watchdog.error());
+    CHECK(watchdog.check(10 * MS, false) == Action::RECOVER);
+    CHECK(watchdog.statistics().failures == 1);
+    CHECK(watchdog.statistics().stalls == 0);
+
+    // The rebuilt reader starts with a clean slate
+    watchdog.attempted(20 * MS);
+    watchdog.rearm(20 * MS);
+    watchdog.frame(30 * MS);
+    CHECK(watchdog.statistics().recoveries == 1);
+    CHECK(watchdog.statistics().last == 20 * MS);
+
+    // A reader which stopped needs no errors to be rebuilt
+    CHECK(watchdog.check(40 * MS, true) == Action::RECOVER);
+    CHECK(watchdog.statistics().failures == 2);
+}
+
+// Frames keep arriving while the conversion fails, only a converted frame ends the row
+void check_conversion_errors()
+{
+    cdi::Watchdog watchdog;
+    watchdog.init(options(), 0, 0);
+
+    CHECK(!watchdog.conversion_error());
+    watchdog.frame(10 * MS);
+    CHECK(!watchdog.conversion_error());
+    watchdog.frame(20 * MS);
+    CHECK(watchdog.check(20 * MS, false) == Action::NONE);
+    CHECK(watchdog.conversion_error());
+    CHECK(watchdog.check(20 * MS, false) == Action::RECOVER);
+    CHECK(watchdog.statistics().failures == 1);
+    watchdog.attempted(20 * MS);
+
+    // Frames of the rebuilt reader end the recovery, the converted ones the row
+    watchdog.rearm(20 * MS);
+    watchdog.frame(30 * MS);
+    CHECK(watchdog.statistics().recoveries == 1);
+    CHECK(!watchdog.conversion_error());
+    CHECK(!watchdog.conversion_error());
+    watchdog.converted();
+    CHECK(!watchdog.conversion_error());
+    CHECK(!watchdog.conversion_error());
+    CHECK(watchdog.check(40 * MS, false) == Action::NONE);
+}
+
+// Recovering for 'give_up_ms' stops the stream for good
+void check_give_up()
+{
+    cdi::Watchdog watchdog;
+    watchdog.init(options(), 0, 0);
+
+    CHECK(watchdog.check(50 * MS, false) == Action::RECOVER);
+    watchdog.attempted(50 * MS);
+    CHECK(watchdog.check(1049 * MS, false) == Action::RECOVER);
+    watchdog.attempted(1049 * MS);
+    CHECK(watchdog.check(1050 * MS, false) == Action::GIVE_UP);
+    CHECK(watchdog.gave_up());
+    CHECK(!watchdog.recovering());
+    CHECK(watchdog.check(2000 * MS, true) == Action::NONE);
+
+    const cdi::RecoveryStatistics statistics = watchdog.statistics();
+    CHECK(statistics.gave_up);
+    CHECK(statistics.recoveries == 0);
+    CHECK(statistics.attempts == 2);
+
+    // The interval of the device unless the options set one, disabled never acts
+    cdi::WatchdogOptions device_interval = options();
+    device_interval.frame_interval_ms = 0;
+    watchdog.init(device_interval, 20 * MS, 0);
+    CHECK(watchdog.period() == 20 * MS);
+    CHECK(!watchdog.gave_up());
+
+    cdi::WatchdogOptions disabled = options();
+    disabled.enabled = false;
+    watchdog.init(disabled, 0, 0);
+    CHECK(watchdog.check(10000 * MS, true) == Action::NONE);
+}
+
+const uint32_t FPS = 30;
+const uint32_t STALL_INTERVALS = 4;
+const double STALL_MS = 1000.0 * STALL_INTERVALS / FPS;
+
+double elapsed_ms(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Locks until 'done' holds, false after 'timeout_ms'
+bool lock_until(cdi::IBuffer& buffer, const std::function<bool()>& done, const double& timeout_ms)
+{
+    const Clock::time_point start = Clock::now();
+    while(elapsed_ms(start) < timeout_ms)
+    {
+        buffer.lock();
+        buffer.unlock();
+        if(done())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// NV12 to I420 goes through the Color Converter DSP
+std::unique_ptr<cdi::IBuffer> open_watched(std::shared_ptr<sdk::Camera>& camera)
+{
+    sdk::remove_cameras();
+
+    sdk::CameraDesc desc;
+    desc.formats.push_back({MFVideoFormat_NV12, 64, 48, FPS});
+    camera = sdk::add_camera(desc);
+
+    cdi::StreamOptions options;
+    options.watchdog.enabled = true;
+    options.watchdog.stall_intervals = STALL_INTERVALS;
+    options.watchdog.max_errors = 3;
+    options.watchdog.retry_ms = 200;
+    options.watchdog.give_up_ms = 5000;
+    return cdi::open_device(0, 64, 48, cdi::Encoding::I420, options);
+}
+
+// A stalled camera: lock() returns the last frame stale once the stall is noticed, the stream is
+// rebuilt and fresh frames follow once the camera is back
+void check_stream_stall()
+{
+    std::shared_ptr<sdk::Camera> camera;
+    std::unique_ptr<cdi::IBuffer> buffer = open_watched(camera);
+    REQUIRE(buffer);
+
+    REQUIRE(buffer->lock() != nullptr);
+    buffer->unlock();
+    CHECK(!buffer->info().stale);
+    const uint64_t sequence = buffer->info().sequence;
+    CHECK(camera->activations() == 1);
+
+    camera->set_stalled(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Waits no longer than a stall takes to notice, the frame is the last good one
+    const Clock::time_point start = Clock::now();
+    CHECK(lock_until(*buffer, [&buffer]() { return buffer->info().stale; }, STALL_MS * 4));
+    CHECK(elapsed_ms(start) < STALL_MS * 3);
+    CHECK(buffer->info().sequence <= sequence + 2);
+
+    CHECK(lock_until(*buffer, [&buffer]() { return buffer->recovery().stalls == 1; }, STALL_MS * 4));
+    CHECK(buffer->recovery().recovering);
+    CHECK(buffer->recovery().failures == 0);
+
+    camera->set_stalled(false);
+    CHECK(lock_until(*buffer, [&buffer]() { return buffer->recovery().recoveries == 1; }, 2000));
+    CHECK(lock_until(*buffer, [&buffer]() { return !buffer->info().stale; }, 1000));
+
+    const cdi::RecoveryStatistics statistics = buffer->recovery();
+    CHECK(!statistics.recovering);
+    CHECK(statistics.attempts >= 1);
+    CHECK(statistics.last > 0 && statistics.last == statistics.longest);
+    CHECK(camera->activations() == 1 + statistics.attempts);
+
+    buffer.reset();
+    CHECK(camera->shutdowns() == camera->activations());
+    sdk::remove_cameras();
+}
+
+// Reads which fail in a row are a failure, the stream comes back when the camera does
+void check_stream_failing()
+{
+    std::shared_ptr<sdk::Camera> camera;
+    std::unique_ptr<cdi::IBuffer> buffer = open_watched(camera);
+    REQUIRE(buffer);
+
+    REQUIRE(buffer->lock() != nullptr);
+    buffer->unlock();
+
+    camera->set_failing(true);
+    CHECK(lock_until(*buffer, [&buffer]() { return buffer->recovery().failures >= 1; }, 2000));
+    CHECK(buffer->recovery().stalls == 0);
+
+    camera->set_failing(false);
+    CHECK(lock_until(*buffer, [&buffer]() { return buffer->recovery().recoveries == 1; }, 2000));
+    CHECK(lock_until(*buffer, [&buffer]() { return !buffer->info().stale; }, 1000));
+    CHECK(camera->activations() >= 2);
+
+    buffer.reset();
+    sdk::remove_cameras();
+}
+
+// The DSP fails while frames keep arriving: the frames are stale, the failures in a row rebuild
+// the reader and the conversion, which converts again once the DSP does
+void check_stream_conversion()
+{
+    std::shared_ptr<sdk::Camera> camera;
+    std::unique_ptr<cdi::IBuffer> buffer = open_watched(camera);
+    REQUIRE(buffer);
+
+    REQUIRE(buffer->lock() != nullptr);
+    buffer->unlock();
+    CHECK(!buffer->info().stale);
+
+    sdk::set_converter_failing(true);
+    CHECK(lock_until(*buffer, [&buffer]() { return buffer->info().stale; }, 1000));
+    CHECK(lock_until(*buffer, [&buffer]() { return buffer->recovery().failures >= 1; }, 2000));
+    CHECK(buffer->recovery().stalls == 0);
+    CHECK(buffer->info().stale);
+
+    sdk::set_converter_failing(false);
+    CHECK(lock_until(*buffer, [&buffer]() { return !buffer->info().stale; }, 2000));
+    CHECK(buffer->recovery().recoveries >= 1);
+    CHECK(camera->activations() >= 2);
+
+    // Converted frames keep the stream going
+    const cdi::RecoveryStatistics statistics = buffer->recovery();
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        buffer->lock();
+        buffer->unlock();
+        CHECK(!buffer->info().stale);
+    }
+    CHECK(buffer->recovery().failures == statistics.failures);
+
+    buffer.reset();
+    sdk::remove_cameras();
+}
+
+}
+
+int main()
+{
+    check_stall();
+    check_errors();
+    check_conversion_errors();
+    check_give_up();
+
+    check_stream_stall();
+    check_stream_failing();
+    check_stream_conversion();
+
+    return cdi::test::result("WatchdogTest");
+}
@@ -0,0 +1,410 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// High bit depth kernels against plain per sample references: conversions between the wide
+// encodings are exact, P010 output keeps ten bits only, and the tone curve maps luma and chroma
+// to I420 and RGB within one code value of a double-precision reference, three for RGB, whose
+// 8 bit intermediates round once more. Odd sizes included.
+
+#include "Check.h"
+#include "FrameLayout.h"
+#include "WideKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+using cdi::Encoding;
+
+struct Size
+{
+    uint32_t width;
+    uint32_t height;
+};
+
+// Y210 pairs its pixels, only even widths
+const Size SIZES[] = {{34, 18}, {36, 19}, {35, 17}};
+
+const Encoding WIDE[] = {Encoding::P010, Encoding::P016, Encoding::Y210, Encoding::GRAY16};
+
+bool fits(const Encoding& encoding, const Size& size)
+{
+    return encoding != Encoding::Y210 || (size.width & 1) == 0;
+}
+
+// Random samples, ten significant bits where the encoding has only those
+std::vector<uint16_t> make_frame(const Encoding& encoding, const Size& size, uint32_t seed)
+{
+    cdi::FrameLayout layout;
+    layout.init(size.width, size.height, encoding);
+    std::vector<uint16_t> frame(layout.size() / 2);
+    const uint16_t mask = encoding == Encoding::P010 || encoding == Encoding::Y210 ? 0xFFC0 : 0xFFFF;
+    for(uint16_t& value : frame)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        value = static_cast<uint16_t>((seed >> 16) & mask);
+    }
+    return frame;
+}
+
+// 16 bit Y, U, V of pixel x, y. 4:2:2 chroma of a 4:2:0 pixel is the average of its two rows.
+void sample(const Encoding& encoding, const Size& size, const std::vector<uint16_t>& frame, const uint32_t& x, const uint32_t& y, uint32_t* yuv)
+{
+    cdi::FrameLayout layout;
+    layout.init(size.width, size.height, encoding);
+    const uint32_t pair = std::min(x >> 1, (size.width >> 1) - 1);
+
+    switch(encoding)
+    {
+    case Encoding::P010:
+    case Encoding::P016:
+        {
+            const cdi::FrameLayout::Plane& uv = layout.plane(1);
+            const size_t row = (uv.offset + std::min(y >> 1, uv.height - 1) * uv.stride) / 2;
+            yuv[0] = frame[y * size.width + x];
+            yuv[1] = frame[row + pair * 2];
+            yuv[2] = frame[row + pair * 2 + 1];
+        }
+        break;
+    case Encoding::Y210:
+        yuv[0] = frame[(y * size.width + x) * 2];
+        yuv[1] = frame[(y * size.width + pair * 2) * 2 + 1];
+        yuv[2] = frame[(y * size.width + pair * 2) * 2 + 3];
+        break;
+    default:
+        yuv[0] = frame[y * size.width + x];
+        yuv[1] = 0x8000;
+        yuv[2] = 0x8000;
+        break;
+    }
+}
+
+// Y210 chroma of the two rows of a 4:2:0 chroma row, rounded up as the kernels average
+void sample_420(const Encoding& encoding, const Size& size, const std::vector<uint16_t>& frame, const uint32_t& x, const uint32_t& y, uint32_t* yuv)
+{
+    sample(encoding, size, frame, x, y, yuv);
+    if(encoding == Encoding::Y210)
+    {
+        uint32_t above[3] = {};
+        uint32_t below[3] = {};
+        sample(encoding, size, frame, x, y & ~1u, above);
+        sample(encoding, size, frame, x, std::min((y & ~1u) + 1, size.height - 1), below);
+        yuv[1] = (above[1] + below[1] + 1) >> 1;
+        yuv[2] = (above[2] + below[2] + 1) >> 1;
+    }
+}
+
+struct Window
+{
+    double black;
+    double range;
+};
+
+double reference_luma(const uint32_t& value, const Window& window)
+{
+    return std::min(255.0, std::max(0.0, (value - window.black) * 255.0 / window.range));
+}
+
+double reference_chroma(const uint32_t& value, const Window& window)
+{
+    return std::min(255.0, std::max(0.0, 128.0 + (static_cast<double>(value) - 32768.0) * 255.0 / window.range));
+}
+
+bool near(const uint8_t& value, const double& reference, const double& tolerance)
+{
+    return std::abs(value - reference) <= tolerance;
+}
+
+cdi::kernels::WideOutput make_output(const bool& enabled)
+{
+    cdi::ToneMapOptions options;
+    options.enabled = enabled;
+    options.black = 4096;
+    options.white = 60000;
+
+    cdi::kernels::WideOutput output;
+    output.curve = cdi::kernels::make_tone_curve(options);
+    return output;
+}
+
+Window window(const bool& enabled)
+{
+    return enabled ? Window{4096, 60000 - 4096} : Window{0, 65535};
+}
+
+int32_t pitch(const Encoding& encoding, const Size& size)
+{
+    cdi::FrameLayout layout;
+    layout.init(size.width, size.height, encoding);
+    return static_cast<int32_t>(layout.plane(0).stride);
+}
+
+void check_wide_to_wide()
+{
+    for(const Size& size : SIZES)
+    {
+        for(const Encoding src : WIDE)
+        {
+            for(const Encoding dst : WIDE)
+            {
+                const cdi::kernels::WideConvert kernel = cdi::kernels::find_wide(src, dst);
+                if(kernel == nullptr || !fits(src, size) || !fits(dst, size))
+                {
+                    continue;
+                }
+
+                const std::vector<uint16_t> in = make_frame(src, size, size.width * 3 + static_cast<uint32_t>(src));
+                std::vector<uint16_t> out = make_frame(dst, size, 99);
+                kernel(reinterpret_cast<const uint8_t*>(in.data()), pitch(src, size),
+                    reinterpret_cast<uint8_t*>(out.data()), pitch(dst, size), size.width, size.height, make_output(false));
+
+                // P010 keeps the ten high bits, everything else every bit
+                const uint32_t mask = dst == Encoding::P010 ? 0xFFC0 : 0xFFFF;
+                const bool chroma = dst != Encoding::GRAY16;
+                uint32_t errors = 0;
+                for(uint32_t y = 0; y < size.height; y++)
+                {
+                    for(uint32_t x = 0; x < size.width; x++)
+                    {
+                        uint32_t expected[3] = {};
+                        uint32_t actual[3] = {};
+                        if(dst == Encoding::Y210)
+                        {
+                            sample(src, size, in, x, y, expected);
+                        }
+                        else
+                        {
+                            sample_420(src, size, in, x, y, expected);
+                        }
+                        sample(dst, size, out, x, y, actual);
+
+                        // Y210 output has chroma of its own in every row, P010 output none in the last of an odd height
+                        const bool has_chroma = chroma && (dst == Encoding::Y210 || (y >> 1) < (size.height >> 1));
+                        errors += actual[0] != (expected[0] & mask);
+                        errors += has_chroma && (actual[1] != (expected[1] & mask) || actual[2] != (expected[2] & mask));
+                    }
+                }
+
+                if(errors != 0)
+                {
+                    std::fprintf(stderr, "%d to %d, %ux%u: %u samples differ\n",
+                        static_cast<int>(src), static_cast<int>(dst), size.width, size.height, errors);
+                    CHECK(!"wide conversion differs");
+                }
+            }
+        }
+    }
+
+    // The ten bits only
+    CHECK(cdi::kernels::find_wide(Encoding::P016, Encoding::P010) != cdi::kernels::find_wide(Encoding::P010, Encoding::P016));
+}
+
+void check_wide_to_i420()
+{
+    for(const bool enabled : {false, true})
+    {
+        for(const Size& size : SIZES)
+        {
+            for(const Encoding src : WIDE)
+            {
+                if(!fits(src, size))
+                {
+                    continue;
+                }
+
+                const cdi::kernels::WideConvert kernel = cdi::kernels::find_wide(src, Encoding::I420);
+                REQUIRE(kernel != nullptr);
+
+                const std::vector<uint16_t> in = make_frame(src, size, size.height * 5 + static_cast<uint32_t>(src));
+                cdi::FrameLayout layout;
+                REQUIRE(layout.init(size.width, size.height, Encoding::I420));
+                std::vector<uint8_t> out(layout.size());
+                kernel(reinterpret_cast<const uint8_t*>(in.data()), pitch(src, size),
+                    out.data(), static_cast<int32_t>(size.width), size.width, size.height, make_output(enabled));
+
+                const Window w = window(enabled);
+                uint32_t errors = 0;
+                for(uint32_t y = 0; y < size.height; y++)
+                {
+                    for(uint32_t x = 0; x < size.width; x++)
+                    {
+                        uint32_t yuv[3] = {};
+                        sample_420(src, size, in, x, y, yuv);
+                        errors += !near(out[y * size.width + x], reference_luma(yuv[0], w), 1.0);
+
+                        // Every chroma sample once
+                        const cdi::FrameLayout::Plane& u = layout.plane(1);
+                        if((x & 1) == 0 && (y & 1) == 0 && (x >> 1) < u.width && (y >> 1) < u.height)
+                        {
+                            const size_t c = (y >> 1) * u.stride + (x >> 1);
+                            errors += !near(out[u.offset + c], reference_chroma(yuv[1], w), 1.0);
+                            errors += !near(out[layout.plane(2).offset + c], reference_chroma(yuv[2], w), 1.0);
+                        }
+                    }
+                }
+
+                if(errors != 0)
+                {
+                    std::fprintf(stderr, "%d to I420, %ux%u, window %d: %u samples off\n",
+                        static_cast<int>(src), size.width, size.height, enabled, errors);
+                    CHECK(!"tone mapped I420 off");
+                }
+            }
+        }
+    }
+}
+
+// B, G, R of 8 bit Y, U, V as in ColorKernelsTest
+void reference_rgb(const double& y, const double& u, const double& v, const cdi::ColorSpace& color, double* bgr)
+{
+    const double kr = color.matrix == cdi::ColorMatrix::BT709 ? 0.2126 : color.matrix == cdi::ColorMatrix::BT2020 ? 0.2627 : 0.299;
+    const double kb = color.matrix == cdi::ColorMatrix::BT709 ? 0.0722 : color.matrix == cdi::ColorMatrix::BT2020 ? 0.0593 : 0.114;
+    const bool full = color.range == cdi::ColorRange::FULL;
+    const double luma = (y - (full ? 0 : 16)) * (full ? 1.0 : 255.0 / 219.0);
+    const double cb = (u - 128) * (full ? 1.0 : 255.0 / 224.0);
+    const double cr = (v - 128) * (full ? 1.0 : 255.0 / 224.0);
+
+    bgr[2] = luma + 2.0 * (1.0 - kr) * cr;
+    bgr[0] = luma + 2.0 * (1.0 - kb) * cb;
+    bgr[1] = (luma - kr * bgr[2] - kb * bgr[0]) / (1.0 - kr - kb);
+}
+
+void check_wide_to_rgb()
+{
+    const cdi::ColorSpace colors[] = {
+        cdi::ColorSpace(cdi::ColorMatrix::DEFAULT, cdi::ColorRange::LIMITED),
+        cdi::ColorSpace(cdi::ColorMatrix::BT709, cdi::ColorRange::LIMITED),
+        cdi::ColorSpace(cdi::ColorMatrix::BT2020, cdi::ColorRange::FULL),
+    };
+
+    for(const cdi::ColorSpace& color : colors)
+    {
+        for(const Encoding dst : {Encoding::RGB24, Encoding::RGBA32})
+        {
+            for(const Size& size : SIZES)
+            {
+                for(const Encoding src : WIDE)
+                {
+                    if(!fits(src, size))
+                    {
+                        continue;
+                    }
+
+                    const cdi::kernels::WideConvert kernel = cdi::kernels::find_wide(src, dst);
+                    REQUIRE(kernel != nullptr);
+
+                    const bool enabled = color.range == cdi::ColorRange::FULL;
+                    cdi::kernels::WideOutput output = make_output(enabled);
+                    output.rgb = cdi::kernels::find_yuv_to_rgb(cdi::kernels::YuvFormat::NV12, dst, color);
+                    REQUIRE(output.rgb != nullptr);
+
+                    // Top-down, as the kernels take any pitch
+                    const uint32_t bpp = dst == Encoding::RGB24 ? 3 : 4;
+                    const std::vector<uint16_t> in = make_frame(src, size, size.width + static_cast<uint32_t>(src) * 7);
+                    std::vector<uint8_t> out(static_cast<size_t>(size.width) * size.height * bpp);
+                    kernel(reinterpret_cast<const uint8_t*>(in.data()), pitch(src, size),
+                        out.data(), static_cast<int32_t>(size.width * bpp), size.width, size.height, output);
+
+                    const Window w = window(enabled);
+                    uint32_t errors = 0;
+                    for(uint32_t y = 0; y < size.height; y++)
+                    {
+                        for(uint32_t x = 0; x < size.width; x++)
+                        {
+                            uint32_t yuv[3] = {};
+                            sample(src, size, in, x, y, yuv);
+                            double bgr[3] = {};
+                            reference_rgb(reference_luma(yuv[0], w), reference_chroma(yuv[1], w), reference_chroma(yuv[2], w), color, bgr);
+
+                            const uint8_t* pixel = out.data() + (static_cast<size_t>(y) * size.width + x) * bpp;
+                            for(uint32_t c = 0; c < 3; c++)
+                            {
+                                errors += !near(pixel[c], std::min(255.0, std::max(0.0, bgr[c])), 3.0);
+                            }
+                            errors += bpp == 4 && pixel[3] != 0xFF;
+                        }
+                    }
+
+                    if(errors != 0)
+                    {
+                        std::fprintf(stderr, "%d to %d, %ux%u, matrix %d, range %d: %u values off\n",
+                            static_cast<int>(src), static_cast<int>(dst), size.width, size.height,
+                            static_cast<int>(color.matrix), static_cast<int>(color.range), errors);
+                        CHECK(!"RGB off");
+                    }
+                }
+            }
+        }
+    }
+}
+
+void check_tone_curve()
+{
+    // Disabled options leave the full range whatever the window says
+    cdi::ToneMapOptions options;
+    options.black = 1000;
+    options.white = 2000;
+    const cdi::kernels::ToneCurve full = cdi::kernels::make_tone_curve(options);
+    CHECK(full.black == 0 && full.range == 0xFFFF);
+
+    // The window ends map onto 0 and 255, neutral chroma stays neutral
+    options.enabled = true;
+    cdi::kernels::WideOutput output;
+    output.curve = cdi::kernels::make_tone_curve(options);
+
+    const Size size = {2, 2};
+    const uint16_t frame[6] = {999, 1000, 2000, 2001, 0x8000, 0x8000};
+    uint8_t out[6] = {};
+    cdi::kernels::find_wide(Encoding::P016, Encoding::I420)(
+        reinterpret_cast<const uint8_t*>(frame), static_cast<int32_t>(size.width * 2), out, 2, size.width, size.height, output);
+    CHECK(out[0] == 0 && out[1] == 0 && out[2] == 255 && out[3] == 255);
+    CHECK(out[4] == 128 && out[5] == 128);
+
+    CHECK(cdi::kernels::find_wide(Encoding::I420, Encoding::P010) == nullptr);
+    CHECK(cdi::kernels::find_wide(Encoding::P010, Encoding::MJPEG) == nullptr);
+}
+
+}
+
+int main()
+{
+    check_wide_to_wide();
+    check_wide_to_i420();
+    check_wide_to_rgb();
+    check_tone_curve();
+
+    return cdi::test::result("WideKernelsTest");
+}
@@ -0,0 +1,104 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Cameras of the Media Foundation stand-in. Tests register them before the library enumerates
+// devices, each one delivers a deterministic frame sequence in its formats at their frame rates
+// and counts what the library does with it. Stalls and failures are switched on at run time.
+// Processes which cannot call in here, such as the Python tests, name their cameras in the
+// environment before the first enumeration:
+//   CDI_SDK_CAMERAS="Front=NV12:640x480@30,YUY2:320x240@15;Back=I420:64x48@30"
+#pragma once
+#include "guiddef.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace sdk {
+
+struct CameraFormat
+{
+    GUID subtype;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps;
+};
+
+struct CameraDesc
+{
+    CameraDesc();
+
+    std::wstring name;
+    std::vector<CameraFormat> formats;
+    // Frames come in 2D buffers with this many bytes after every row, planes of planar formats
+    // follow at the same pitch (I420 chroma at half of it) as drivers lay them out
+    uint32_t row_padding;
+    // Frames come in 2D buffers also without padding, otherwise in plain memory buffers
+    bool buffer_2d;
+    // ActivateObject() takes this long and fails afterwards when 'activate_fails'
+    uint32_t activate_ms;
+    bool activate_fails;
+};
+
+class Camera
+{
+public:
+    virtual ~Camera() {}
+
+    // Reads pend without a frame while stalled
+    virtual void set_stalled(const bool& stalled) = 0;
+    // Reads complete with an error while failing, the synchronous reader returns it
+    virtual void set_failing(const bool& failing) = 0;
+
+    virtual uint32_t activations() const = 0;
+    virtual uint32_t shutdowns() const = 0;
+    virtual uint64_t frames() const = 0;
+};
+
+std::shared_ptr<Camera> add_camera(const CameraDesc& desc);
+void remove_cameras();
+
+// Natural layout of a format as the camera packs it: first plane pitch and total size, false
+// for formats the stand-in cannot produce
+bool packed_layout(const GUID& subtype, const uint32_t& width, const uint32_t& height, uint32_t& pitch, uint32_t& size);
+// Content of frame 'sequence', packed
+void fill_frame(const GUID& subtype, const uint32_t& width, const uint32_t& height, const uint64_t& sequence, uint8_t* dst);
+
+// ProcessInput() of the Color Converter DSP fails while set
+void set_converter_failing(const bool& failing);
+// The DSP writes its output through Lock() only while set, as it does with buffers which are not
+// IMF2DBuffers
+void set_converter_plain_lock(const bool& plain_lock);
+uint32_t converter_instances();
+
+}
@@ -0,0 +1,249 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mfapi.h"
+#include "mfidl.h"
+#include "mfreadwrite.h"
+#include "mftransform.h"
+#include "wmcodecdsp.h"
+
+
+namespace {
+
+constexpr uint32_t fourcc(const char (&code)[5])
+{
+    return static_cast<uint32_t>(static_cast<uint8_t>(code[0]))
+        | static_cast<uint32_t>(static_cast<uint8_t>(code[1])) << 8
+        | static_cast<uint32_t>(static_cast<uint8_t>(code[2])) << 16
+        | static_cast<uint32_t>(static_cast<uint8_t>(code[3])) << 24;
+}
+
+}
+
+// Formats share the tail of MFVideoFormat_Base, the first field is a FOURCC, a D3DFMT or a wave format tag
+#define FORMAT_GUID(name, code) const GUID name = {code, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+
+// Everything else gets an id of the stand-in
+#define STANDIN_GUID(name, number) const GUID name = {0x5D4A0000 + number, 0xC0DE, 0x4F3B, {0x9A, 0x31, 0x6E, 0x2F, 0x4B, 0x18, 0x00, number}};
+#define STANDIN_IID(type, number) \
+    template<> const IID& uuid_of<type>() \
+    { \
+        static const IID id = {0x5D4B0000 + number, 0xC0DE, 0x4F3B, {0x9A, 0x31, 0x6E, 0x2F, 0x4B, 0x18, 0x01, number}}; \
+        return id; \
+    }
+
+const GUID GUID_NULL = {0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0}};
+
+template<> const IID& uuid_of<IUnknown>()
+{
+    static const IID id = {0x00000000, 0x0000, 0x0000, {0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46}};
+    return id;
+}
+
+STANDIN_IID(IMFAttributes, 1)
+STANDIN_IID(IMFMediaType, 2)
+STANDIN_IID(IMFMediaBuffer, 3)
+STANDIN_IID(IMF2DBuffer, 4)
+STANDIN_IID(IMFSample, 5)
+STANDIN_IID(IMFActivate, 6)
+STANDIN_IID(IMFMediaEvent, 7)
+STANDIN_IID(IMFMediaTypeHandler, 8)
+STANDIN_IID(IMFStreamDescriptor, 9)
+STANDIN_IID(IMFPresentationDescriptor, 10)
+STANDIN_IID(IMFMediaSource, 11)
+STANDIN_IID(IMFSourceReader, 12)
+STANDIN_IID(IMFSourceReaderEx, 13)
+STANDIN_IID(IMFSourceReaderCallback, 14)
+STANDIN_IID(IMFTransform, 15)
+
+const IID IID_IMFTransform = uuid_of<IMFTransform>();
+const IID IID_IMFSourceReaderCallback = uuid_of<IMFSourceReaderCallback>();
+
+STANDIN_GUID(CLSID_CColorConvertDMO, 1)
+
+FORMAT_GUID(MFMediaType_Audio, fourcc("auds"))
+FORMAT_GUID(MFMediaType_Video, fourcc("vids"))
+STANDIN_GUID(MFMediaType_Binary, 2)
+STANDIN_GUID(MFMediaType_FileTransfer, 3)
+STANDIN_GUID(MFMediaType_HTML, 4)
+STANDIN_GUID(MFMediaType_Image, 5)
+STANDIN_GUID(MFMediaType_Protected, 6)
+STANDIN_GUID(MFMediaType_SAMI, 7)
+STANDIN_GUID(MFMediaType_Script, 8)
+
+FORMAT_GUID(MFVideoFormat_Base, 0)
+FORMAT_GUID(MFVideoFormat_RGB24, 20)
+FORMAT_GUID(MFVideoFormat_ARGB32, 21)
+FORMAT_GUID(MFVideoFormat_RGB32, 22)
+FORMAT_GUID(MFVideoFormat_RGB565, 23)
+FORMAT_GUID(MFVideoFormat_RGB555, 24)
+FORMAT_GUID(MFVideoFormat_RGB8, 41)
+FORMAT_GUID(MFVideoFormat_L16, 81)
+FORMAT_GUID(MFVideoFormat_AI44, fourcc("AI44"))
+FORMAT_GUID(MFVideoFormat_AYUV, fourcc("AYUV"))
+FORMAT_GUID(MFVideoFormat_DV25, fourcc("dv25"))
+FORMAT_GUID(MFVideoFormat_DV50, fourcc("dv50"))
+FORMAT_GUID(MFVideoFormat_DVH1, fourcc("dvh1"))
+FORMAT_GUID(MFVideoFormat_DVSD, fourcc("dvsd"))
+FORMAT_GUID(MFVideoFormat_DVSL, fourcc("dvsl"))
+FORMAT_GUID(MFVideoFormat_H264, fourcc("H264"))
+FORMAT_GUID(MFVideoFormat_I420, fourcc("I420"))
+FORMAT_GUID(MFVideoFormat_IYUV, fourcc("IYUV"))
+FORMAT_GUID(MFVideoFormat_M4S2, fourcc("M4S2"))
+FORMAT_GUID(MFVideoFormat_MJPG, fourcc("MJPG"))
+FORMAT_GUID(MFVideoFormat_MP43, fourcc("MP43"))
+FORMAT_GUID(MFVideoFormat_MP4S, fourcc("MP4S"))
+FORMAT_GUID(MFVideoFormat_MP4V, fourcc("MP4V"))
+FORMAT_GUID(MFVideoFormat_MSS1, fourcc("MSS1"))
+FORMAT_GUID(MFVideoFormat_MSS2, fourcc("MSS2"))
+FORMAT_GUID(MFVideoFormat_NV11, fourcc("NV11"))
+FORMAT_GUID(MFVideoFormat_NV12, fourcc("NV12"))
+FORMAT_GUID(MFVideoFormat_P010, fourcc("P010"))
+FORMAT_GUID(MFVideoFormat_P016, fourcc("P016"))
+FORMAT_GUID(MFVideoFormat_P210, fourcc("P210"))
+FORMAT_GUID(MFVideoFormat_P216, fourcc("P216"))
+FORMAT_GUID(MFVideoFormat_UYVY, fourcc("UYVY"))
+FORMAT_GUID(MFVideoFormat_WMV1, fourcc("WMV1"))
+FORMAT_GUID(MFVideoFormat_WMV2, fourcc("WMV2"))
+FORMAT_GUID(MFVideoFormat_WMV3, fourcc("WMV3"))
+FORMAT_GUID(MFVideoFormat_WVC1, fourcc("WVC1"))
+FORMAT_GUID(MFVideoFormat_Y210, fourcc("Y210"))
+FORMAT_GUID(MFVideoFormat_Y216, fourcc("Y216"))
+FORMAT_GUID(MFVideoFormat_Y410, fourcc("Y410"))
+FORMAT_GUID(MFVideoFormat_Y416, fourcc("Y416"))
+FORMAT_GUID(MFVideoFormat_Y41P, fourcc("Y41P"))
+FORMAT_GUID(MFVideoFormat_Y41T, fourcc("Y41T"))
+FORMAT_GUID(MFVideoFormat_YUY2, fourcc("YUY2"))
+FORMAT_GUID(MFVideoFormat_YV12, fourcc("YV12"))
+FORMAT_GUID(MFVideoFormat_YVYU, fourcc("YVYU"))
+FORMAT_GUID(MFVideoFormat_v210, fourcc("v210"))
+FORMAT_GUID(MFVideoFormat_v410, fourcc("v410"))
+STANDIN_GUID(MFVideoFormat_MPG1, 9)
+
+FORMAT_GUID(MFAudioFormat_PCM, 0x0001)
+FORMAT_GUID(MFAudioFormat_Float, 0x0003)
+FORMAT_GUID(MFAudioFormat_DTS, 0x0008)
+FORMAT_GUID(MFAudioFormat_DRM, 0x0009)
+FORMAT_GUID(MFAudioFormat_MSP1, 0x000A)
+FORMAT_GUID(MFAudioFormat_MPEG, 0x0050)
+FORMAT_GUID(MFAudioFormat_MP3, 0x0055)
+FORMAT_GUID(MFAudioFormat_Dolby_AC3_SPDIF, 0x0092)
+FORMAT_GUID(MFAudioFormat_WMAudioV8, 0x0161)
+FORMAT_GUID(MFAudioFormat_WMAudioV9, 0x0162)
+FORMAT_GUID(MFAudioFormat_WMAudio_Lossless, 0x0163)
+FORMAT_GUID(MFAudioFormat_WMASPDIF, 0x0164)
+FORMAT_GUID(MFAudioFormat_ADTS, 0x1600)
+FORMAT_GUID(MFAudioFormat_AAC, 0x1610)
+
+STANDIN_GUID(MFSampleExtension_CleanPoint, 10)
+STANDIN_GUID(MFSampleExtension_DeviceTimestamp, 11)
+
+STANDIN_GUID(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME, 12)
+STANDIN_GUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE, 13)
+STANDIN_GUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID, 14)
+STANDIN_GUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK, 15)
+
+STANDIN_GUID(MF_SOURCE_READER_ASYNC_CALLBACK, 16)
+STANDIN_GUID(MF_SOURCE_READER_DISCONNECT_MEDIASOURCE_ON_SHUTDOWN, 17)
+STANDIN_GUID(MF_SOURCE_READER_ENABLE_VIDEO_PROCESSING, 18)
+STANDIN_GUID(MF_READWRITE_DISABLE_CONVERTERS, 19)
+STANDIN_GUID(MF_LOW_LATENCY, 20)
+
+STANDIN_GUID(MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION, 32)
+STANDIN_GUID(MF_MT_AAC_PAYLOAD_TYPE, 33)
+STANDIN_GUID(MF_MT_ALL_SAMPLES_INDEPENDENT, 34)
+STANDIN_GUID(MF_MT_AM_FORMAT_TYPE, 35)
+STANDIN_GUID(MF_MT_ARBITRARY_FORMAT, 36)
+STANDIN_GUID(MF_MT_ARBITRARY_HEADER, 37)
+STANDIN_GUID(MF_MT_AUDIO_AVG_BYTES_PER_SECOND, 38)
+STANDIN_GUID(MF_MT_AUDIO_BITS_PER_SAMPLE, 39)
+STANDIN_GUID(MF_MT_AUDIO_BLOCK_ALIGNMENT, 40)
+STANDIN_GUID(MF_MT_AUDIO_CHANNEL_MASK, 41)
+STANDIN_GUID(MF_MT_AUDIO_FLOAT_SAMPLES_PER_SECOND, 42)
+STANDIN_GUID(MF_MT_AUDIO_FOLDDOWN_MATRIX, 43)
+STANDIN_GUID(MF_MT_AUDIO_NUM_CHANNELS, 44)
+STANDIN_GUID(MF_MT_AUDIO_PREFER_WAVEFORMATEX, 45)
+STANDIN_GUID(MF_MT_AUDIO_SAMPLES_PER_BLOCK, 46)
+STANDIN_GUID(MF_MT_AUDIO_SAMPLES_PER_SECOND, 47)
+STANDIN_GUID(MF_MT_AUDIO_VALID_BITS_PER_SAMPLE, 48)
+STANDIN_GUID(MF_MT_AUDIO_WMADRC_AVGREF, 49)
+STANDIN_GUID(MF_MT_AUDIO_WMADRC_AVGTARGET, 50)
+STANDIN_GUID(MF_MT_AUDIO_WMADRC_PEAKREF, 51)
+STANDIN_GUID(MF_MT_AUDIO_WMADRC_PEAKTARGET, 52)
+STANDIN_GUID(MF_MT_AVG_BITRATE, 53)
+STANDIN_GUID(MF_MT_AVG_BIT_ERROR_RATE, 54)
+STANDIN_GUID(MF_MT_COMPRESSED, 55)
+STANDIN_GUID(MF_MT_CUSTOM_VIDEO_PRIMARIES, 56)
+STANDIN_GUID(MF_MT_DEFAULT_STRIDE, 57)
+STANDIN_GUID(MF_MT_DRM_FLAGS, 58)
+STANDIN_GUID(MF_MT_DV_AAUX_CTRL_PACK_0, 59)
+STANDIN_GUID(MF_MT_DV_AAUX_CTRL_PACK_1, 60)
+STANDIN_GUID(MF_MT_DV_AAUX_SRC_PACK_0, 61)
+STANDIN_GUID(MF_MT_DV_AAUX_SRC_PACK_1, 62)
+STANDIN_GUID(MF_MT_DV_VAUX_CTRL_PACK, 63)
+STANDIN_GUID(MF_MT_DV_VAUX_SRC_PACK, 64)
+STANDIN_GUID(MF_MT_FIXED_SIZE_SAMPLES, 65)
+STANDIN_GUID(MF_MT_FRAME_RATE, 66)
+STANDIN_GUID(MF_MT_FRAME_RATE_RANGE_MAX, 67)
+STANDIN_GUID(MF_MT_FRAME_RATE_RANGE_MIN, 68)
+STANDIN_GUID(MF_MT_FRAME_SIZE, 69)
+STANDIN_GUID(MF_MT_GEOMETRIC_APERTURE, 70)
+STANDIN_GUID(MF_MT_IMAGE_LOSS_TOLERANT, 71)
+STANDIN_GUID(MF_MT_INTERLACE_MODE, 72)
+STANDIN_GUID(MF_MT_MAJOR_TYPE, 73)
+STANDIN_GUID(MF_MT_MAX_KEYFRAME_SPACING, 74)
+STANDIN_GUID(MF_MT_MINIMUM_DISPLAY_APERTURE, 75)
+STANDIN_GUID(MF_MT_MPEG2_FLAGS, 76)
+STANDIN_GUID(MF_MT_MPEG2_LEVEL, 77)
+STANDIN_GUID(MF_MT_MPEG2_PROFILE, 78)
+STANDIN_GUID(MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY, 79)
+STANDIN_GUID(MF_MT_MPEG4_SAMPLE_DESCRIPTION, 80)
+STANDIN_GUID(MF_MT_MPEG_SEQUENCE_HEADER, 81)
+STANDIN_GUID(MF_MT_MPEG_START_TIME_CODE, 82)
+STANDIN_GUID(MF_MT_ORIGINAL_4CC, 83)
+STANDIN_GUID(MF_MT_ORIGINAL_WAVE_FORMAT_TAG, 84)
+STANDIN_GUID(MF_MT_PAD_CONTROL_FLAGS, 85)
+STANDIN_GUID(MF_MT_PALETTE, 86)
+STANDIN_GUID(MF_MT_PAN_SCAN_APERTURE, 87)
+STANDIN_GUID(MF_MT_PAN_SCAN_ENABLED, 88)
+STANDIN_GUID(MF_MT_PIXEL_ASPECT_RATIO, 89)
+STANDIN_GUID(MF_MT_SAMPLE_SIZE, 90)
+STANDIN_GUID(MF_MT_SOURCE_CONTENT_HINT, 91)
+STANDIN_GUID(MF_MT_SUBTYPE, 92)
+STANDIN_GUID(MF_MT_TRANSFER_FUNCTION, 93)
+STANDIN_GUID(MF_MT_USER_DATA, 94)
+STANDIN_GUID(MF_MT_VIDEO_CHROMA_SITING, 95)
+STANDIN_GUID(MF_MT_VIDEO_LIGHTING, 96)
+STANDIN_GUID(MF_MT_VIDEO_NOMINAL_RANGE, 97)
+STANDIN_GUID(MF_MT_VIDEO_PRIMARIES, 98)
+STANDIN_GUID(MF_MT_WRAPPED_TYPE, 99)
+STANDIN_GUID(MF_MT_YUV_MATRIX, 100)
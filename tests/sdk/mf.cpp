@@ -0,0 +1,2340 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "camera.h"
+#include "mfapi.h"
+#include "mfidl.h"
+#include "mfreadwrite.h"
+#include "mftransform.h"
+#include "wmcodecdsp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+// Reference counting and QueryInterface for objects with one interface and the ones it extends
+template<typename Interface>
+class Object : public Interface
+{
+public:
+    STDMETHODIMP QueryInterface(REFIID riid, void** object) override
+    {
+        if(object == nullptr)
+        {
+            return E_POINTER;
+        }
+
+        *object = query(riid);
+        if(*object == nullptr)
+        {
+            return E_NOINTERFACE;
+        }
+
+        AddRef();
+        return S_OK;
+    }
+
+    STDMETHODIMP_(ULONG) AddRef() override
+    {
+        return ++m_references;
+    }
+
+    STDMETHODIMP_(ULONG) Release() override
+    {
+        const ULONG references = --m_references;
+        if(references == 0)
+        {
+            delete this;
+        }
+
+        return references;
+    }
+
+protected:
+    virtual void* query(REFIID riid)
+    {
+        if(riid == __uuidof(IUnknown) || riid == __uuidof(Interface))
+        {
+            return static_cast<Interface*>(this);
+        }
+
+        return nullptr;
+    }
+
+private:
+    std::atomic<ULONG> m_references{1};
+};
+
+template<typename T>
+void release(T*& object)
+{
+    if(object != nullptr)
+    {
+        object->Release();
+        object = nullptr;
+    }
+}
+
+struct GuidLess
+{
+    bool operator()(const GUID& a, const GUID& b) const
+    {
+        return std::memcmp(&a, &b, sizeof(GUID)) < 0;
+    }
+};
+
+LPWSTR allocate_string(const std::wstring& text)
+{
+    LPWSTR result = static_cast<LPWSTR>(CoTaskMemAlloc((text.size() + 1) * sizeof(WCHAR)));
+    if(result != nullptr)
+    {
+        std::wmemcpy(result, text.c_str(), text.size() + 1);
+    }
+    return result;
+}
+
+
+// Attributes
+
+struct Value
+{
+    uint16_t type;
+    UINT64 number;
+    GUID guid;
+    std::wstring text;
+    IUnknown* object;
+};
+
+template<typename Interface>
+class Attributes : public Object<Interface>
+{
+public:
+    STDMETHODIMP GetItem(REFGUID key, PROPVARIANT* value) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Value* item = find(key);
+        if(item == nullptr)
+        {
+            return MF_E_ATTRIBUTENOTFOUND;
+        }
+
+        if(value == nullptr)
+        {
+            return S_OK;
+        }
+
+        value->vt = item->type;
+        switch(item->type)
+        {
+        case VT_UI4:
+            value->ulVal = static_cast<UINT32>(item->number);
+            break;
+        case VT_UI8:
+            value->uhVal.QuadPart = item->number;
+            break;
+        case VT_CLSID:
+            value->puuid = static_cast<GUID*>(CoTaskMemAlloc(sizeof(GUID)));
+            *value->puuid = item->guid;
+            break;
+        case VT_LPWSTR:
+            value->pwszVal = allocate_string(item->text);
+            break;
+        case VT_UNKNOWN:
+            value->punkVal = item->object;
+            value->punkVal->AddRef();
+            break;
+        }
+
+        return S_OK;
+    }
+
+    STDMETHODIMP GetUINT32(REFGUID key, UINT32* value) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Value* item = find(key);
+        if(item == nullptr)
+        {
+            return MF_E_ATTRIBUTENOTFOUND;
+        }
+        if(item->type != VT_UI4)
+        {
+            return MF_E_INVALIDTYPE;
+        }
+
+        *value = static_cast<UINT32>(item->number);
+        return S_OK;
+    }
+
+    STDMETHODIMP GetUINT64(REFGUID key, UINT64* value) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Value* item = find(key);
+        if(item == nullptr)
+        {
+            return MF_E_ATTRIBUTENOTFOUND;
+        }
+        if(item->type != VT_UI8)
+        {
+            return MF_E_INVALIDTYPE;
+        }
+
+        *value = item->number;
+        return S_OK;
+    }
+
+    STDMETHODIMP GetGUID(REFGUID key, GUID* value) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Value* item = find(key);
+        if(item == nullptr)
+        {
+            return MF_E_ATTRIBUTENOTFOUND;
+        }
+        if(item->type != VT_CLSID)
+        {
+            return MF_E_INVALIDTYPE;
+        }
+
+        *value = item->guid;
+        return S_OK;
+    }
+
+    STDMETHODIMP GetStringLength(REFGUID key, UINT32* length) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Value* item = find(key);
+        if(item == nullptr)
+        {
+            return MF_E_ATTRIBUTENOTFOUND;
+        }
+        if(item->type != VT_LPWSTR)
+        {
+            return MF_E_INVALIDTYPE;
+        }
+
+        *length = static_cast<UINT32>(item->text.size());
+        return S_OK;
+    }
+
+    STDMETHODIMP GetString(REFGUID key, LPWSTR value, UINT32 size, UINT32* length) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Value* item = find(key);
+        if(item == nullptr)
+        {
+            return MF_E_ATTRIBUTENOTFOUND;
+        }
+        if(item->type != VT_LPWSTR)
+        {
+            return MF_E_INVALIDTYPE;
+        }
+        if(item->text.size() + 1 > size)
+        {
+            return E_INVALIDARG;
+        }
+
+        std::wmemcpy(value, item->text.c_str(), item->text.size() + 1);
+        if(length != nullptr)
+        {
+            *length = static_cast<UINT32>(item->text.size());
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP GetAllocatedString(REFGUID key, LPWSTR* value, UINT32* length) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Value* item = find(key);
+        if(item == nullptr)
+        {
+            return MF_E_ATTRIBUTENOTFOUND;
+        }
+        if(item->type != VT_LPWSTR)
+        {
+            return MF_E_INVALIDTYPE;
+        }
+
+        *value = allocate_string(item->text);
+        if(length != nullptr)
+        {
+            *length = static_cast<UINT32>(item->text.size());
+        }
+        return *value != nullptr ? S_OK : E_OUTOFMEMORY;
+    }
+
+    STDMETHODIMP GetUnknown(REFGUID key, REFIID riid, void** object) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Value* item = find(key);
+        if(item == nullptr)
+        {
+            return MF_E_ATTRIBUTENOTFOUND;
+        }
+        if(item->type != VT_UNKNOWN)
+        {
+            return MF_E_INVALIDTYPE;
+        }
+
+        return item->object->QueryInterface(riid, object);
+    }
+
+    STDMETHODIMP DeleteItem(REFGUID key) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto item = m_items.find(key);
+        if(item != m_items.end())
+        {
+            release(item->second.object);
+            m_items.erase(item);
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP DeleteAllItems() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        clear();
+        return S_OK;
+    }
+
+    STDMETHODIMP SetUINT32(REFGUID key, UINT32 value) override
+    {
+        Value item = {VT_UI4, value, GUID_NULL, std::wstring(), nullptr};
+        return set(key, item);
+    }
+
+    STDMETHODIMP SetUINT64(REFGUID key, UINT64 value) override
+    {
+        Value item = {VT_UI8, value, GUID_NULL, std::wstring(), nullptr};
+        return set(key, item);
+    }
+
+    STDMETHODIMP SetGUID(REFGUID key, REFGUID value) override
+    {
+        Value item = {VT_CLSID, 0, value, std::wstring(), nullptr};
+        return set(key, item);
+    }
+
+    STDMETHODIMP SetString(REFGUID key, LPCWSTR value) override
+    {
+        Value item = {VT_LPWSTR, 0, GUID_NULL, value, nullptr};
+        return set(key, item);
+    }
+
+    STDMETHODIMP SetUnknown(REFGUID key, IUnknown* object) override
+    {
+        if(object == nullptr)
+        {
+            return E_POINTER;
+        }
+
+        object->AddRef();
+        Value item = {VT_UNKNOWN, 0, GUID_NULL, std::wstring(), object};
+        return set(key, item);
+    }
+
+    STDMETHODIMP GetCount(UINT32* count) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *count = static_cast<UINT32>(m_items.size());
+        return S_OK;
+    }
+
+    STDMETHODIMP CopyAllItems(IMFAttributes* destination) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        destination->DeleteAllItems();
+        for(const auto& item : m_items)
+        {
+            const Value& value = item.second;
+            switch(value.type)
+            {
+            case VT_UI4:
+                destination->SetUINT32(item.first, static_cast<UINT32>(value.number));
+                break;
+            case VT_UI8:
+                destination->SetUINT64(item.first, value.number);
+                break;
+            case VT_CLSID:
+                destination->SetGUID(item.first, value.guid);
+                break;
+            case VT_LPWSTR:
+                destination->SetString(item.first, value.text.c_str());
+                break;
+            case VT_UNKNOWN:
+                destination->SetUnknown(item.first, value.object);
+                break;
+            }
+        }
+        return S_OK;
+    }
+
+protected:
+    ~Attributes() override
+    {
+        clear();
+    }
+
+    void* query(REFIID riid) override
+    {
+        if(riid == __uuidof(IMFAttributes))
+        {
+            return static_cast<IMFAttributes*>(this);
+        }
+
+        return Object<Interface>::query(riid);
+    }
+
+private:
+    const Value* find(REFGUID key) const
+    {
+        auto item = m_items.find(key);
+        return item != m_items.end() ? &item->second : nullptr;
+    }
+
+    HRESULT set(REFGUID key, const Value& value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto item = m_items.find(key);
+        if(item != m_items.end())
+        {
+            release(item->second.object);
+            item->second = value;
+        }
+        else
+        {
+            m_items.insert(std::make_pair(key, value));
+        }
+        return S_OK;
+    }
+
+    void clear()
+    {
+        for(auto& item : m_items)
+        {
+            release(item.second.object);
+        }
+        m_items.clear();
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<GUID, Value, GuidLess> m_items;
+};
+
+class PlainAttributes : public Attributes<IMFAttributes>
+{
+};
+
+class MediaType : public Attributes<IMFMediaType>
+{
+public:
+    STDMETHODIMP GetMajorType(GUID* major_type) override
+    {
+        return GetGUID(MF_MT_MAJOR_TYPE, major_type);
+    }
+};
+
+
+// Frame layouts
+
+struct PlaneShape
+{
+    uint32_t row_bytes;
+    uint32_t rows;
+    uint32_t pitch_divisor; // Of the first plane's pitch
+};
+
+bool is_compressed(const GUID& subtype)
+{
+    return subtype == MFVideoFormat_MJPG || subtype == MFVideoFormat_H264;
+}
+
+bool plane_shapes(const GUID& subtype, const uint32_t& width, const uint32_t& height, std::vector<PlaneShape>& planes)
+{
+    planes.clear();
+    if(subtype == MFVideoFormat_I420 || subtype == MFVideoFormat_IYUV || subtype == MFVideoFormat_YV12)
+    {
+        planes.push_back({width, height, 1});
+        planes.push_back({width / 2, height / 2, 2});
+        planes.push_back({width / 2, height / 2, 2});
+    }
+    else if(subtype == MFVideoFormat_NV12)
+    {
+        planes.push_back({width, height, 1});
+        planes.push_back({width, height / 2, 1});
+    }
+    else if(subtype == MFVideoFormat_P010 || subtype == MFVideoFormat_P016)
+    {
+        planes.push_back({width * 2, height, 1});
+        planes.push_back({width * 2, height / 2, 1});
+    }
+    else if(subtype == MFVideoFormat_YUY2 || subtype == MFVideoFormat_UYVY || subtype == MFVideoFormat_YVYU
+            || subtype == MFVideoFormat_L16)
+    {
+        planes.push_back({width * 2, height, 1});
+    }
+    else if(subtype == MFVideoFormat_RGB24)
+    {
+        planes.push_back({width * 3, height, 1});
+    }
+    else if(subtype == MFVideoFormat_RGB32 || subtype == MFVideoFormat_ARGB32 || subtype == MFVideoFormat_Y210
+            || subtype == MFVideoFormat_Y216)
+    {
+        planes.push_back({width * 4, height, 1});
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// Memory buffers, 2D ones with the rows of every plane padded
+
+class MemoryBuffer : public Object<IMFMediaBuffer>
+{
+public:
+    explicit MemoryBuffer(const DWORD& max_length)
+        : m_memory(max_length)
+        , m_current_length(0)
+    {
+    }
+
+    STDMETHODIMP Lock(BYTE** buffer, DWORD* max_length, DWORD* current_length) override
+    {
+        if(buffer == nullptr)
+        {
+            return E_POINTER;
+        }
+
+        *buffer = m_memory.data();
+        if(max_length != nullptr)
+        {
+            *max_length = static_cast<DWORD>(m_memory.size());
+        }
+        if(current_length != nullptr)
+        {
+            *current_length = m_current_length;
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP Unlock() override
+    {
+        return S_OK;
+    }
+
+    STDMETHODIMP GetCurrentLength(DWORD* current_length) override
+    {
+        *current_length = m_current_length;
+        return S_OK;
+    }
+
+    STDMETHODIMP SetCurrentLength(DWORD current_length) override
+    {
+        if(current_length > m_memory.size())
+        {
+            return E_INVALIDARG;
+        }
+
+        m_current_length = current_length;
+        return S_OK;
+    }
+
+    STDMETHODIMP GetMaxLength(DWORD* max_length) override
+    {
+        *max_length = static_cast<DWORD>(m_memory.size());
+        return S_OK;
+    }
+
+private:
+    std::vector<BYTE> m_memory;
+    DWORD m_current_length;
+};
+
+// Lock() hands out a packed copy which Unlock() writes back, as Media Foundation does
+class Buffer2D : public IMFMediaBuffer, public IMF2DBuffer
+{
+public:
+    Buffer2D(const std::vector<PlaneShape>& planes, const uint32_t& padding)
+        : m_references(1)
+        , m_planes(planes)
+        , m_pitch(planes[0].row_bytes + padding)
+        , m_packed_size(0)
+        , m_locked(false)
+    {
+        size_t size = 0;
+        for(const PlaneShape& plane : m_planes)
+        {
+            size += static_cast<size_t>(m_pitch / plane.pitch_divisor) * plane.rows;
+            m_packed_size += static_cast<DWORD>(plane.row_bytes) * plane.rows;
+        }
+        m_memory.resize(size);
+    }
+
+    STDMETHODIMP QueryInterface(REFIID riid, void** object) override
+    {
+        if(object == nullptr)
+        {
+            return E_POINTER;
+        }
+
+        if(riid == __uuidof(IUnknown) || riid == __uuidof(IMFMediaBuffer))
+        {
+            *object = static_cast<IMFMediaBuffer*>(this);
+        }
+        else if(riid == __uuidof(IMF2DBuffer))
+        {
+            *object = static_cast<IMF2DBuffer*>(this);
+        }
+        else
+        {
+            *object = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        AddRef();
+        return S_OK;
+    }
+
+    STDMETHODIMP_(ULONG) AddRef() override
+    {
+        return ++m_references;
+    }
+
+    STDMETHODIMP_(ULONG) Release() override
+    {
+        const ULONG references = --m_references;
+        if(references == 0)
+        {
+            delete this;
+        }
+        return references;
+    }
+
+    STDMETHODIMP Lock(BYTE** buffer, DWORD* max_length, DWORD* current_length) override
+    {
+        if(buffer == nullptr)
+        {
+            return E_POINTER;
+        }
+
+        m_packed.resize(m_packed_size);
+        copy(m_memory.data(), m_pitch, m_packed.data(), m_planes[0].row_bytes);
+        m_locked = true;
+
+        *buffer = m_packed.data();
+        if(max_length != nullptr)
+        {
+            *max_length = m_packed_size;
+        }
+        if(current_length != nullptr)
+        {
+            *current_length = m_packed_size;
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP Unlock() override
+    {
+        if(m_locked)
+        {
+            copy(m_packed.data(), m_planes[0].row_bytes, m_memory.data(), m_pitch);
+            m_locked = false;
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP GetCurrentLength(DWORD* current_length) override
+    {
+        *current_length = m_packed_size;
+        return S_OK;
+    }
+
+    STDMETHODIMP SetCurrentLength(DWORD current_length) override
+    {
+        return current_length <= m_packed_size ? S_OK : E_INVALIDARG;
+    }
+
+    STDMETHODIMP GetMaxLength(DWORD* max_length) override
+    {
+        *max_length = m_packed_size;
+        return S_OK;
+    }
+
+    STDMETHODIMP Lock2D(BYTE** scanline0, LONG* pitch) override
+    {
+        return GetScanline0AndPitch(scanline0, pitch);
+    }
+
+    STDMETHODIMP Unlock2D() override
+    {
+        return S_OK;
+    }
+
+    STDMETHODIMP GetScanline0AndPitch(BYTE** scanline0, LONG* pitch) override
+    {
+        if(scanline0 == nullptr || pitch == nullptr)
+        {
+            return E_POINTER;
+        }
+
+        *scanline0 = m_memory.data();
+        *pitch = static_cast<LONG>(m_pitch);
+        return S_OK;
+    }
+
+    STDMETHODIMP IsContiguousFormat(BOOL* contiguous) override
+    {
+        *contiguous = m_pitch == m_planes[0].row_bytes ? TRUE : FALSE;
+        return S_OK;
+    }
+
+    STDMETHODIMP GetContiguousLength(DWORD* length) override
+    {
+        *length = m_packed_size;
+        return S_OK;
+    }
+
+    STDMETHODIMP ContiguousCopyTo(BYTE* destination, DWORD destination_length) override
+    {
+        if(destination_length < m_packed_size)
+        {
+            return E_INVALIDARG;
+        }
+
+        copy(m_memory.data(), m_pitch, destination, m_planes[0].row_bytes);
+        return S_OK;
+    }
+
+    STDMETHODIMP ContiguousCopyFrom(const BYTE* source, DWORD source_length) override
+    {
+        if(source_length < m_packed_size)
+        {
+            return E_INVALIDARG;
+        }
+
+        copy(source, m_planes[0].row_bytes, m_memory.data(), m_pitch);
+        return S_OK;
+    }
+
+private:
+    virtual ~Buffer2D() {}
+
+    void copy(const BYTE* src, const uint32_t& src_pitch, BYTE* dst, const uint32_t& dst_pitch) const
+    {
+        for(const PlaneShape& plane : m_planes)
+        {
+            const uint32_t src_plane_pitch = src_pitch / plane.pitch_divisor;
+            const uint32_t dst_plane_pitch = dst_pitch / plane.pitch_divisor;
+            for(uint32_t row = 0; row < plane.rows; row++)
+            {
+                std::memcpy(dst + static_cast<size_t>(dst_plane_pitch) * row, src + static_cast<size_t>(src_plane_pitch) * row, plane.row_bytes);
+            }
+            src += static_cast<size_t>(src_plane_pitch) * plane.rows;
+            dst += static_cast<size_t>(dst_plane_pitch) * plane.rows;
+        }
+    }
+
+private:
+    std::atomic<ULONG> m_references;
+    std::vector<PlaneShape> m_planes;
+    uint32_t m_pitch;
+    DWORD m_packed_size;
+    std::vector<BYTE> m_memory;
+    std::vector<BYTE> m_packed;
+    bool m_locked;
+};
+
+class Sample : public Attributes<IMFSample>
+{
+public:
+    Sample()
+        : m_time(0)
+    {
+    }
+
+    STDMETHODIMP GetSampleTime(LONGLONG* time) override
+    {
+        *time = m_time;
+        return S_OK;
+    }
+
+    STDMETHODIMP SetSampleTime(LONGLONG time) override
+    {
+        m_time = time;
+        return S_OK;
+    }
+
+    STDMETHODIMP GetBufferCount(DWORD* count) override
+    {
+        *count = static_cast<DWORD>(m_buffers.size());
+        return S_OK;
+    }
+
+    STDMETHODIMP GetBufferByIndex(DWORD index, IMFMediaBuffer** buffer) override
+    {
+        if(index >= m_buffers.size())
+        {
+            return E_INVALIDARG;
+        }
+
+        *buffer = m_buffers[index];
+        (*buffer)->AddRef();
+        return S_OK;
+    }
+
+    STDMETHODIMP ConvertToContiguousBuffer(IMFMediaBuffer** buffer) override
+    {
+        if(m_buffers.empty())
+        {
+            return E_UNEXPECTED;
+        }
+
+        if(m_buffers.size() == 1)
+        {
+            return GetBufferByIndex(0, buffer);
+        }
+
+        // Several buffers are joined into a new one, which replaces them
+        DWORD total = 0;
+        GetTotalLength(&total);
+        MemoryBuffer* joined = new MemoryBuffer(total);
+        BYTE* dst = nullptr;
+        joined->Lock(&dst, nullptr, nullptr);
+        for(IMFMediaBuffer* part : m_buffers)
+        {
+            BYTE* src = nullptr;
+            DWORD length = 0;
+            part->Lock(&src, nullptr, &length);
+            std::memcpy(dst, src, length);
+            dst += length;
+            part->Unlock();
+        }
+        joined->Unlock();
+        joined->SetCurrentLength(total);
+
+        RemoveAllBuffers();
+        AddBuffer(joined);
+        *buffer = joined;
+        return S_OK;
+    }
+
+    STDMETHODIMP AddBuffer(IMFMediaBuffer* buffer) override
+    {
+        if(buffer == nullptr)
+        {
+            return E_POINTER;
+        }
+
+        buffer->AddRef();
+        m_buffers.push_back(buffer);
+        return S_OK;
+    }
+
+    STDMETHODIMP RemoveAllBuffers() override
+    {
+        for(IMFMediaBuffer*& buffer : m_buffers)
+        {
+            release(buffer);
+        }
+        m_buffers.clear();
+        return S_OK;
+    }
+
+    STDMETHODIMP GetTotalLength(DWORD* length) override
+    {
+        *length = 0;
+        for(IMFMediaBuffer* buffer : m_buffers)
+        {
+            DWORD current = 0;
+            buffer->GetCurrentLength(&current);
+            *length += current;
+        }
+        return S_OK;
+    }
+
+protected:
+    ~Sample() override
+    {
+        RemoveAllBuffers();
+    }
+
+private:
+    LONGLONG m_time;
+    std::vector<IMFMediaBuffer*> m_buffers;
+};
+
+
+// Cameras, one lock and one condition for all of them and their readers
+
+std::mutex g_mutex;
+std::condition_variable g_changed;
+
+int64_t qpc_now()
+{
+    LARGE_INTEGER counter = {};
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart / 100;
+}
+
+class CameraState : public sdk::Camera
+{
+public:
+    explicit CameraState(const sdk::CameraDesc& desc)
+        : desc(desc)
+        , stalled(false)
+        , failing(false)
+        , activation_count(0)
+        , shutdown_count(0)
+        , frame_count(0)
+    {
+    }
+
+    void set_stalled(const bool& value) override
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        stalled = value;
+        g_changed.notify_all();
+    }
+
+    void set_failing(const bool& value) override
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        failing = value;
+        g_changed.notify_all();
+    }
+
+    uint32_t activations() const override
+    {
+        return activation_count;
+    }
+
+    uint32_t shutdowns() const override
+    {
+        return shutdown_count;
+    }
+
+    uint64_t frames() const override
+    {
+        return frame_count;
+    }
+
+    const sdk::CameraDesc desc;
+    bool stalled;
+    bool failing;
+    std::atomic<uint32_t> activation_count;
+    std::atomic<uint32_t> shutdown_count;
+    std::atomic<uint64_t> frame_count;
+};
+
+std::vector<std::shared_ptr<CameraState>> g_cameras;
+
+IMFMediaType* create_type(const sdk::CameraFormat& format)
+{
+    MediaType* type = new MediaType();
+    type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+    type->SetGUID(MF_MT_SUBTYPE, format.subtype);
+    MFSetAttributeSize(type, MF_MT_FRAME_SIZE, format.width, format.height);
+    MFSetAttributeRatio(type, MF_MT_FRAME_RATE, format.fps, 1);
+
+    uint32_t pitch = 0;
+    uint32_t size = 0;
+    if(sdk::packed_layout(format.subtype, format.width, format.height, pitch, size) && !is_compressed(format.subtype))
+    {
+        type->SetUINT32(MF_MT_SAMPLE_SIZE, size);
+        type->SetUINT32(MF_MT_DEFAULT_STRIDE, pitch);
+    }
+
+    return type;
+}
+
+class TypeHandler : public Object<IMFMediaTypeHandler>
+{
+public:
+    explicit TypeHandler(const std::shared_ptr<CameraState>& camera)
+        : m_camera(camera)
+    {
+    }
+
+    STDMETHODIMP GetMediaTypeCount(DWORD* count) override
+    {
+        *count = static_cast<DWORD>(m_camera->desc.formats.size());
+        return S_OK;
+    }
+
+    STDMETHODIMP GetMediaTypeByIndex(DWORD index, IMFMediaType** type) override
+    {
+        if(index >= m_camera->desc.formats.size())
+        {
+            return MF_E_NO_MORE_TYPES;
+        }
+
+        *type = create_type(m_camera->desc.formats[index]);
+        return S_OK;
+    }
+
+    STDMETHODIMP SetCurrentMediaType(IMFMediaType* /*type*/) override
+    {
+        return E_NOTIMPL;
+    }
+
+    STDMETHODIMP GetCurrentMediaType(IMFMediaType** /*type*/) override
+    {
+        return E_NOTIMPL;
+    }
+
+private:
+    std::shared_ptr<CameraState> m_camera;
+};
+
+class StreamDescriptor : public Attributes<IMFStreamDescriptor>
+{
+public:
+    explicit StreamDescriptor(const std::shared_ptr<CameraState>& camera)
+        : m_camera(camera)
+    {
+    }
+
+    STDMETHODIMP GetStreamIdentifier(DWORD* identifier) override
+    {
+        *identifier = 0;
+        return S_OK;
+    }
+
+    STDMETHODIMP GetMediaTypeHandler(IMFMediaTypeHandler** handler) override
+    {
+        *handler = new TypeHandler(m_camera);
+        return S_OK;
+    }
+
+private:
+    std::shared_ptr<CameraState> m_camera;
+};
+
+class PresentationDescriptor : public Attributes<IMFPresentationDescriptor>
+{
+public:
+    explicit PresentationDescriptor(const std::shared_ptr<CameraState>& camera)
+        : m_camera(camera)
+    {
+    }
+
+    STDMETHODIMP GetStreamDescriptorCount(DWORD* count) override
+    {
+        *count = 1;
+        return S_OK;
+    }
+
+    STDMETHODIMP GetStreamDescriptorByIndex(DWORD index, BOOL* selected, IMFStreamDescriptor** descriptor) override
+    {
+        if(index != 0)
+        {
+            return E_INVALIDARG;
+        }
+
+        *selected = TRUE;
+        *descriptor = new StreamDescriptor(m_camera);
+        return S_OK;
+    }
+
+private:
+    std::shared_ptr<CameraState> m_camera;
+};
+
+class MediaSource : public Object<IMFMediaSource>
+{
+public:
+    explicit MediaSource(const std::shared_ptr<CameraState>& camera)
+        : m_camera(camera)
+        , m_shutdown(false)
+    {
+    }
+
+    STDMETHODIMP CreatePresentationDescriptor(IMFPresentationDescriptor** descriptor) override
+    {
+        if(is_shutdown())
+        {
+            return MF_E_SHUTDOWN;
+        }
+
+        *descriptor = new PresentationDescriptor(m_camera);
+        return S_OK;
+    }
+
+    STDMETHODIMP Stop() override
+    {
+        return is_shutdown() ? MF_E_SHUTDOWN : S_OK;
+    }
+
+    STDMETHODIMP Shutdown() override
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        m_shutdown = true;
+        g_changed.notify_all();
+        return S_OK;
+    }
+
+    // With g_mutex held
+    bool shutdown_locked() const
+    {
+        return m_shutdown;
+    }
+
+    const std::shared_ptr<CameraState>& camera() const
+    {
+        return m_camera;
+    }
+
+private:
+    bool is_shutdown() const
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return m_shutdown;
+    }
+
+private:
+    std::shared_ptr<CameraState> m_camera;
+    bool m_shutdown;
+};
+
+// The source stays with the activation until ShutdownObject()
+class Activate : public Attributes<IMFActivate>
+{
+public:
+    explicit Activate(const std::shared_ptr<CameraState>& camera)
+        : m_camera(camera)
+        , m_source(nullptr)
+    {
+        SetString(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME, camera->desc.name.c_str());
+        SetString(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK, (L"\\\\?\\standin#" + camera->desc.name).c_str());
+        SetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE, MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID);
+    }
+
+    STDMETHODIMP ActivateObject(REFIID riid, void** object) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(m_source == nullptr)
+        {
+            m_camera->activation_count++;
+            if(m_camera->desc.activate_ms > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(m_camera->desc.activate_ms));
+            }
+            if(m_camera->desc.activate_fails)
+            {
+                return E_FAIL;
+            }
+
+            m_source = new MediaSource(m_camera);
+        }
+
+        return m_source->QueryInterface(riid, object);
+    }
+
+    STDMETHODIMP ShutdownObject() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_source != nullptr)
+        {
+            m_camera->shutdown_count++;
+            m_source->Shutdown();
+            release(m_source);
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP DetachObject() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        release(m_source);
+        return S_OK;
+    }
+
+protected:
+    ~Activate() override
+    {
+        release(m_source);
+    }
+
+private:
+    std::shared_ptr<CameraState> m_camera;
+    std::mutex m_mutex;
+    MediaSource* m_source;
+};
+
+IMFSample* create_frame(const sdk::CameraDesc& desc, const sdk::CameraFormat& format, const uint64_t& sequence, const int64_t& timestamp)
+{
+    uint32_t pitch = 0;
+    uint32_t size = 0;
+    sdk::packed_layout(format.subtype, format.width, format.height, pitch, size);
+
+    std::vector<PlaneShape> planes;
+    IMFMediaBuffer* buffer = nullptr;
+    if((desc.buffer_2d || desc.row_padding > 0) && plane_shapes(format.subtype, format.width, format.height, planes))
+    {
+        std::vector<BYTE> packed(size);
+        sdk::fill_frame(format.subtype, format.width, format.height, sequence, packed.data());
+        Buffer2D* buffer_2d = new Buffer2D(planes, desc.row_padding);
+        buffer_2d->ContiguousCopyFrom(packed.data(), size);
+        buffer = buffer_2d;
+    }
+    else
+    {
+        buffer = new MemoryBuffer(size);
+        BYTE* data = nullptr;
+        buffer->Lock(&data, nullptr, nullptr);
+        sdk::fill_frame(format.subtype, format.width, format.height, sequence, data);
+        buffer->Unlock();
+    }
+    buffer->SetCurrentLength(size);
+
+    IMFSample* sample = new Sample();
+    sample->AddBuffer(buffer);
+    buffer->Release();
+
+    sample->SetSampleTime(timestamp);
+    sample->SetUINT64(MFSampleExtension_DeviceTimestamp, static_cast<UINT64>(timestamp));
+    sample->SetUINT32(MFSampleExtension_CleanPoint, !is_compressed(format.subtype) || sequence % 30 == 0);
+
+    return sample;
+}
+
+class SourceReader : public Object<IMFSourceReaderEx>
+{
+public:
+    SourceReader(MediaSource* source, IMFAttributes* attributes)
+        : m_source(source)
+        , m_callback(nullptr)
+        , m_disconnect(false)
+        , m_type(nullptr)
+        , m_next_due(0)
+        , m_sequence(0)
+        , m_flushing(false)
+        , m_exit(false)
+    {
+        m_source->AddRef();
+
+        if(attributes != nullptr)
+        {
+            attributes->GetUnknown(MF_SOURCE_READER_ASYNC_CALLBACK, IID_PPV_ARGS(&m_callback));
+            m_disconnect = MFGetAttributeUINT32(attributes, MF_SOURCE_READER_DISCONNECT_MEDIASOURCE_ON_SHUTDOWN, FALSE) != 0;
+        }
+
+        if(m_callback != nullptr)
+        {
+            m_worker = std::thread([this]() { work(); });
+        }
+    }
+
+    STDMETHODIMP GetStreamSelection(DWORD /*stream_index*/, BOOL* selected) override
+    {
+        *selected = TRUE;
+        return S_OK;
+    }
+
+    STDMETHODIMP SetStreamSelection(DWORD /*stream_index*/, BOOL /*selected*/) override
+    {
+        return S_OK;
+    }
+
+    STDMETHODIMP GetNativeMediaType(DWORD stream_index, DWORD type_index, IMFMediaType** type) override
+    {
+        if(!video_stream(stream_index))
+        {
+            return MF_E_INVALIDSTREAMNUMBER;
+        }
+
+        const std::vector<sdk::CameraFormat>& formats = m_source->camera()->desc.formats;
+        if(type_index >= formats.size())
+        {
+            return MF_E_NO_MORE_TYPES;
+        }
+
+        *type = create_type(formats[type_index]);
+        return S_OK;
+    }
+
+    STDMETHODIMP GetCurrentMediaType(DWORD stream_index, IMFMediaType** type) override
+    {
+        if(!video_stream(stream_index))
+        {
+            return MF_E_INVALIDSTREAMNUMBER;
+        }
+
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if(m_type == nullptr)
+        {
+            return MF_E_TRANSFORM_TYPE_NOT_SET;
+        }
+
+        *type = create_type(m_format);
+        return S_OK;
+    }
+
+    // Native formats only, the stand-in has no decoders to insert
+    STDMETHODIMP SetCurrentMediaType(DWORD stream_index, DWORD* /*reserved*/, IMFMediaType* type) override
+    {
+        if(!video_stream(stream_index))
+        {
+            return MF_E_INVALIDSTREAMNUMBER;
+        }
+
+        GUID subtype = GUID_NULL;
+        UINT32 width = 0;
+        UINT32 height = 0;
+        if(FAILED(type->GetGUID(MF_MT_SUBTYPE, &subtype)) || FAILED(MFGetAttributeSize(type, MF_MT_FRAME_SIZE, &width, &height)))
+        {
+            return MF_E_INVALIDMEDIATYPE;
+        }
+
+        for(const sdk::CameraFormat& format : m_source->camera()->desc.formats)
+        {
+            if(format.subtype == subtype && format.width == width && format.height == height)
+            {
+                std::lock_guard<std::mutex> lock(g_mutex);
+                release(m_type);
+                m_type = create_type(format);
+                m_format = format;
+                m_next_due = 0;
+                return S_OK;
+            }
+        }
+
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    STDMETHODIMP ReadSample(
+        DWORD stream_index,
+        DWORD /*control_flags*/,
+        DWORD* actual_stream_index,
+        DWORD* stream_flags,
+        LONGLONG* timestamp,
+        IMFSample** sample) override
+    {
+        if(!video_stream(stream_index))
+        {
+            return MF_E_INVALIDSTREAMNUMBER;
+        }
+
+        std::unique_lock<std::mutex> lock(g_mutex);
+        if(m_callback != nullptr)
+        {
+            if(m_exit)
+            {
+                return MF_E_SHUTDOWN;
+            }
+
+            m_requests.push_back(false);
+            g_changed.notify_all();
+            return S_OK;
+        }
+
+        if(sample == nullptr || stream_flags == nullptr)
+        {
+            return E_POINTER;
+        }
+
+        *sample = nullptr;
+        int64_t time = 0;
+        const HRESULT result = next_frame(lock, sample, time);
+        *stream_flags = FAILED(result) ? MF_SOURCE_READERF_ERROR : 0;
+        if(actual_stream_index != nullptr)
+        {
+            *actual_stream_index = 0;
+        }
+        if(timestamp != nullptr)
+        {
+            *timestamp = time;
+        }
+
+        return result;
+    }
+
+    // Pending reads are dropped, the callback hears about the flush when it is done
+    STDMETHODIMP Flush(DWORD /*stream_index*/) override
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if(m_callback != nullptr)
+        {
+            m_requests.erase(std::remove(m_requests.begin(), m_requests.end(), false), m_requests.end());
+            m_requests.push_back(true);
+            m_flushing = true;
+            g_changed.notify_all();
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP SetNativeMediaType(DWORD stream_index, IMFMediaType* type, DWORD* stream_flags) override
+    {
+        *stream_flags = 0;
+        return SetCurrentMediaType(stream_index, nullptr, type);
+    }
+
+protected:
+    ~SourceReader() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            m_exit = true;
+            g_changed.notify_all();
+        }
+
+        // The last reference may go with a callback on the worker itself
+        if(m_worker.joinable())
+        {
+            if(m_worker.get_id() == std::this_thread::get_id())
+            {
+                m_worker.detach();
+            }
+            else
+            {
+                m_worker.join();
+            }
+        }
+
+        // Without being told otherwise the reader takes the source down with it
+        if(!m_disconnect)
+        {
+            m_source->Shutdown();
+        }
+
+        release(m_callback);
+        release(m_type);
+        release(m_source);
+    }
+
+    void* query(REFIID riid) override
+    {
+        if(riid == __uuidof(IMFSourceReader))
+        {
+            return static_cast<IMFSourceReader*>(this);
+        }
+
+        return Object<IMFSourceReaderEx>::query(riid);
+    }
+
+private:
+    static bool video_stream(const DWORD& stream_index)
+    {
+        return stream_index == 0 || stream_index == static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM);
+    }
+
+    // Waits for the next frame slot of the current format with g_mutex held. Late reads get the
+    // latest frame, the ones in between are lost as with a real camera.
+    HRESULT next_frame(std::unique_lock<std::mutex>& lock, IMFSample** sample, int64_t& timestamp)
+    {
+        const std::shared_ptr<CameraState>& camera = m_source->camera();
+        using Clock = std::chrono::steady_clock;
+
+        for(;;)
+        {
+            if(m_exit || m_flushing)
+            {
+                return E_ABORT;
+            }
+            if(m_source->shutdown_locked())
+            {
+                return MF_E_SHUTDOWN;
+            }
+            if(m_type == nullptr)
+            {
+                return MF_E_TRANSFORM_TYPE_NOT_SET;
+            }
+            if(camera->stalled)
+            {
+                g_changed.wait(lock);
+                continue;
+            }
+
+            const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+            const int64_t interval = m_format.fps > 0 ? 1000000000 / m_format.fps : 0;
+            if(m_next_due == 0 || now > m_next_due + interval)
+            {
+                m_next_due = now;
+            }
+            if(now < m_next_due)
+            {
+                g_changed.wait_until(lock, Clock::time_point(std::chrono::nanoseconds(m_next_due)));
+                continue;
+            }
+
+            m_next_due += interval;
+            break;
+        }
+
+        // A failing camera fails in its frame slots
+        timestamp = qpc_now();
+        if(camera->failing)
+        {
+            return MF_E_VIDEO_RECORDING_DEVICE_INVALIDATED;
+        }
+
+        const uint64_t sequence = m_sequence++;
+        camera->frame_count++;
+        const sdk::CameraFormat format = m_format;
+
+        lock.unlock();
+        *sample = create_frame(camera->desc, format, sequence, timestamp);
+        lock.lock();
+
+        return S_OK;
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        for(;;)
+        {
+            g_changed.wait(lock, [this]() { return m_exit || !m_requests.empty(); });
+            if(m_exit)
+            {
+                break;
+            }
+
+            const bool flush = m_requests.front();
+            m_requests.pop_front();
+            if(flush)
+            {
+                m_flushing = false;
+                lock.unlock();
+                m_callback->OnFlush(0);
+                lock.lock();
+                continue;
+            }
+
+            IMFSample* sample = nullptr;
+            int64_t timestamp = 0;
+            const HRESULT result = next_frame(lock, &sample, timestamp);
+            if(result == E_ABORT)
+            {
+                continue;
+            }
+
+            lock.unlock();
+            m_callback->OnReadSample(result, 0, FAILED(result) ? MF_SOURCE_READERF_ERROR : 0, timestamp, sample);
+            release(sample);
+            lock.lock();
+        }
+    }
+
+private:
+    MediaSource* m_source;
+    IMFSourceReaderCallback* m_callback;
+    bool m_disconnect;
+
+    // The state below is guarded by g_mutex
+    IMFMediaType* m_type;
+    sdk::CameraFormat m_format;
+    int64_t m_next_due;
+    uint64_t m_sequence;
+    std::deque<bool> m_requests; // True for a flush
+    bool m_flushing;
+    bool m_exit;
+    std::thread m_worker;
+};
+
+
+// The Color Converter DSP
+
+std::atomic<bool> g_converter_failing(false);
+std::atomic<bool> g_converter_plain_lock(false);
+std::atomic<uint32_t> g_converter_instances(0);
+
+struct Yuv
+{
+    int y;
+    int u;
+    int v;
+};
+
+// Sample of pixel x, y of 8 bit YUV, chroma of the pixel's block
+Yuv read_yuv(const GUID& subtype, const BYTE* src, const LONG& pitch, const uint32_t& height, const uint32_t& x, const uint32_t& y)
+{
+    Yuv result = {};
+    if(subtype == MFVideoFormat_YUY2)
+    {
+        const BYTE* pair = src + static_cast<ptrdiff_t>(pitch) * y + (x & ~1u) * 2;
+        result.y = pair[(x & 1) * 2];
+        result.u = pair[1];
+        result.v = pair[3];
+    }
+    else if(subtype == MFVideoFormat_NV12)
+    {
+        const BYTE* chroma = src + static_cast<ptrdiff_t>(pitch) * height + static_cast<ptrdiff_t>(pitch) * (y / 2) + (x & ~1u);
+        result.y = src[static_cast<ptrdiff_t>(pitch) * y + x];
+        result.u = chroma[0];
+        result.v = chroma[1];
+    }
+    else
+    {
+        const LONG chroma_pitch = pitch / 2;
+        const BYTE* u = src + static_cast<ptrdiff_t>(pitch) * height;
+        const BYTE* v = u + static_cast<ptrdiff_t>(chroma_pitch) * (height / 2);
+        result.y = src[static_cast<ptrdiff_t>(pitch) * y + x];
+        result.u = u[static_cast<ptrdiff_t>(chroma_pitch) * (y / 2) + x / 2];
+        result.v = v[static_cast<ptrdiff_t>(chroma_pitch) * (y / 2) + x / 2];
+    }
+    return result;
+}
+
+BYTE clamp_byte(const double& value)
+{
+    return static_cast<BYTE>(std::min(255.0, std::max(0.0, std::floor(value + 0.5))));
+}
+
+class ColorConverter : public Object<IMFTransform>
+{
+public:
+    ColorConverter()
+        : m_width(0)
+        , m_height(0)
+        , m_kr(0.299)
+        , m_kb(0.114)
+        , m_full_range(false)
+        , m_input_set(false)
+        , m_output_set(false)
+        , m_pending(nullptr)
+    {
+        g_converter_instances++;
+    }
+
+    STDMETHODIMP GetInputStatus(DWORD /*stream_id*/, DWORD* flags) override
+    {
+        *flags = m_pending == nullptr ? MFT_INPUT_STATUS_ACCEPT_DATA : 0;
+        return S_OK;
+    }
+
+    STDMETHODIMP GetOutputStreamInfo(DWORD /*stream_id*/, MFT_OUTPUT_STREAM_INFO* info) override
+    {
+        if(!m_output_set)
+        {
+            return MF_E_TRANSFORM_TYPE_NOT_SET;
+        }
+
+        uint32_t pitch = 0;
+        uint32_t size = 0;
+        sdk::packed_layout(m_output, m_width, m_height, pitch, size);
+        info->dwFlags = 0;
+        info->cbSize = size;
+        info->cbAlignment = 0;
+        return S_OK;
+    }
+
+    STDMETHODIMP SetInputType(DWORD /*stream_id*/, IMFMediaType* type, DWORD /*flags*/) override
+    {
+        if(FAILED(type->GetGUID(MF_MT_SUBTYPE, &m_input))
+           || FAILED(MFGetAttributeSize(type, MF_MT_FRAME_SIZE, &m_width, &m_height))
+           || !(m_input == MFVideoFormat_I420 || m_input == MFVideoFormat_IYUV
+                || m_input == MFVideoFormat_NV12 || m_input == MFVideoFormat_YUY2
+                || m_input == MFVideoFormat_RGB24))
+        {
+            return MF_E_INVALIDMEDIATYPE;
+        }
+
+        // BT.601 in the nominal range unless the type says otherwise
+        switch(MFGetAttributeUINT32(type, MF_MT_YUV_MATRIX, MFVideoTransferMatrix_BT601))
+        {
+        case MFVideoTransferMatrix_BT709:
+            m_kr = 0.2126;
+            m_kb = 0.0722;
+            break;
+        case MFVideoTransferMatrix_BT2020_10:
+        case MFVideoTransferMatrix_BT2020_12:
+            m_kr = 0.2627;
+            m_kb = 0.0593;
+            break;
+        default:
+            m_kr = 0.299;
+            m_kb = 0.114;
+            break;
+        }
+        m_full_range = MFGetAttributeUINT32(type, MF_MT_VIDEO_NOMINAL_RANGE, MFNominalRange_16_235) == MFNominalRange_0_255;
+
+        m_input_set = true;
+        return S_OK;
+    }
+
+    STDMETHODIMP SetOutputType(DWORD /*stream_id*/, IMFMediaType* type, DWORD /*flags*/) override
+    {
+        UINT32 width = 0;
+        UINT32 height = 0;
+        if(!m_input_set
+           || FAILED(type->GetGUID(MF_MT_SUBTYPE, &m_output))
+           || FAILED(MFGetAttributeSize(type, MF_MT_FRAME_SIZE, &width, &height))
+           || width != m_width || height != m_height
+           || !(m_output == MFVideoFormat_RGB24 || m_output == MFVideoFormat_RGB32
+                || m_output == MFVideoFormat_I420 || m_output == MFVideoFormat_IYUV)
+           || (m_input == MFVideoFormat_RGB24 && m_output != MFVideoFormat_RGB24))
+        {
+            return MF_E_INVALIDMEDIATYPE;
+        }
+
+        m_output_set = true;
+        return S_OK;
+    }
+
+    STDMETHODIMP ProcessMessage(MFT_MESSAGE_TYPE message, uintptr_t /*param*/) override
+    {
+        if(message == MFT_MESSAGE_COMMAND_FLUSH)
+        {
+            release(m_pending);
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP ProcessInput(DWORD /*stream_id*/, IMFSample* sample, DWORD /*flags*/) override
+    {
+        if(!m_output_set)
+        {
+            return MF_E_TRANSFORM_TYPE_NOT_SET;
+        }
+        if(g_converter_failing)
+        {
+            return E_FAIL;
+        }
+        if(m_pending != nullptr)
+        {
+            return MF_E_NOTACCEPTING;
+        }
+
+        m_pending = sample;
+        m_pending->AddRef();
+        return S_OK;
+    }
+
+    // Writes through IMF2DBuffer when the buffer has one, the input stays pending when the
+    // output buffer cannot be written
+    STDMETHODIMP ProcessOutput(DWORD /*flags*/, DWORD buffer_count, MFT_OUTPUT_DATA_BUFFER* buffers, DWORD* status) override
+    {
+        *status = 0;
+        if(m_pending == nullptr)
+        {
+            return MF_E_TRANSFORM_NEED_MORE_INPUT;
+        }
+        if(buffer_count != 1 || buffers[0].pSample == nullptr)
+        {
+            return E_INVALIDARG;
+        }
+
+        IMFMediaBuffer* target = nullptr;
+        HRESULT result = buffers[0].pSample->GetBufferByIndex(0, &target);
+        if(FAILED(result))
+        {
+            return result;
+        }
+
+        uint32_t natural_pitch = 0;
+        uint32_t size = 0;
+        sdk::packed_layout(m_output, m_width, m_height, natural_pitch, size);
+        const bool rgb = m_output == MFVideoFormat_RGB24 || m_output == MFVideoFormat_RGB32;
+
+        BYTE* dst = nullptr;
+        LONG dst_pitch = 0;
+        IMF2DBuffer* target_2d = nullptr;
+        if(!g_converter_plain_lock && SUCCEEDED(target->QueryInterface(IID_PPV_ARGS(&target_2d))))
+        {
+            result = target_2d->Lock2D(&dst, &dst_pitch);
+            if(SUCCEEDED(result))
+            {
+                convert(dst, dst_pitch);
+                target_2d->Unlock2D();
+            }
+            target_2d->Release();
+        }
+        else
+        {
+            DWORD max_length = 0;
+            result = target->Lock(&dst, &max_length, nullptr);
+            if(SUCCEEDED(result))
+            {
+                // Plain buffers hold RGB bottom-up
+                if(max_length < size)
+                {
+                    result = E_INVALIDARG;
+                }
+                else if(rgb)
+                {
+                    convert(dst + static_cast<size_t>(natural_pitch) * (m_height - 1), -static_cast<LONG>(natural_pitch));
+                }
+                else
+                {
+                    convert(dst, static_cast<LONG>(natural_pitch));
+                }
+                target->Unlock();
+            }
+        }
+
+        if(SUCCEEDED(result))
+        {
+            target->SetCurrentLength(size);
+            release(m_pending);
+        }
+        target->Release();
+
+        return result;
+    }
+
+protected:
+    ~ColorConverter() override
+    {
+        release(m_pending);
+        g_converter_instances--;
+    }
+
+private:
+    void convert(BYTE* dst, const LONG& dst_pitch)
+    {
+        IMFMediaBuffer* input = nullptr;
+        if(FAILED(m_pending->ConvertToContiguousBuffer(&input)))
+        {
+            return;
+        }
+
+        uint32_t natural_pitch = 0;
+        uint32_t size = 0;
+        sdk::packed_layout(m_input, m_width, m_height, natural_pitch, size);
+
+        BYTE* src = nullptr;
+        LONG src_pitch = static_cast<LONG>(natural_pitch);
+        IMF2DBuffer* input_2d = nullptr;
+        if(SUCCEEDED(input->QueryInterface(IID_PPV_ARGS(&input_2d))))
+        {
+            input_2d->Lock2D(&src, &src_pitch);
+        }
+        else
+        {
+            input->Lock(&src, nullptr, nullptr);
+        }
+
+        if(m_input == MFVideoFormat_RGB24)
+        {
+            // RGB24 passes through, plain buffers on both sides hold the rows bottom-up
+            if(input_2d == nullptr)
+            {
+                src += static_cast<ptrdiff_t>(src_pitch) * (m_height - 1);
+                src_pitch = -src_pitch;
+            }
+            for(uint32_t y = 0; y < m_height; y++)
+            {
+                std::memcpy(
+                    dst + static_cast<ptrdiff_t>(dst_pitch) * y,
+                    src + static_cast<ptrdiff_t>(src_pitch) * y,
+                    static_cast<size_t>(m_width) * 3);
+            }
+        }
+        else if(m_output == MFVideoFormat_RGB24 || m_output == MFVideoFormat_RGB32)
+        {
+            to_rgb(src, src_pitch, dst, dst_pitch, m_output == MFVideoFormat_RGB32 ? 4 : 3);
+        }
+        else
+        {
+            to_i420(src, src_pitch, dst, dst_pitch);
+        }
+
+        if(input_2d != nullptr)
+        {
+            input_2d->Unlock2D();
+            input_2d->Release();
+        }
+        else
+        {
+            input->Unlock();
+        }
+        input->Release();
+    }
+
+    void to_rgb(const BYTE* src, const LONG& src_pitch, BYTE* dst, const LONG& dst_pitch, const uint32_t& bpp) const
+    {
+        const double kg = 1.0 - m_kr - m_kb;
+        const double luma_scale = m_full_range ? 1.0 : 255.0 / 219.0;
+        const double chroma_scale = m_full_range ? 1.0 : 255.0 / 224.0;
+        const int luma_offset = m_full_range ? 0 : 16;
+
+        for(uint32_t y = 0; y < m_height; y++)
+        {
+            BYTE* row = dst + static_cast<ptrdiff_t>(dst_pitch) * y;
+            for(uint32_t x = 0; x < m_width; x++)
+            {
+                const Yuv yuv = read_yuv(m_input, src, src_pitch, m_height, x, y);
+                const double luma = (yuv.y - luma_offset) * luma_scale;
+                const double cb = (yuv.u - 128) * chroma_scale;
+                const double cr = (yuv.v - 128) * chroma_scale;
+                const double r = luma + 2.0 * (1.0 - m_kr) * cr;
+                const double b = luma + 2.0 * (1.0 - m_kb) * cb;
+                const double g = (luma - m_kr * r - m_kb * b) / kg;
+
+                BYTE* pixel = row + x * bpp;
+                pixel[0] = clamp_byte(b);
+                pixel[1] = clamp_byte(g);
+                pixel[2] = clamp_byte(r);
+                if(bpp == 4)
+                {
+                    pixel[3] = 0xFF;
+                }
+            }
+        }
+    }
+
+    void to_i420(const BYTE* src, const LONG& src_pitch, BYTE* dst, const LONG& dst_pitch) const
+    {
+        const LONG chroma_pitch = dst_pitch / 2;
+        BYTE* u = dst + static_cast<ptrdiff_t>(dst_pitch) * m_height;
+        BYTE* v = u + static_cast<ptrdiff_t>(chroma_pitch) * (m_height / 2);
+
+        for(uint32_t y = 0; y < m_height; y++)
+        {
+            for(uint32_t x = 0; x < m_width; x++)
+            {
+                dst[static_cast<ptrdiff_t>(dst_pitch) * y + x] = static_cast<BYTE>(read_yuv(m_input, src, src_pitch, m_height, x, y).y);
+            }
+        }
+
+        // 4:2:2 chroma is averaged over the two rows
+        for(uint32_t y = 0; y + 1 < m_height; y += 2)
+        {
+            for(uint32_t x = 0; x + 1 < m_width; x += 2)
+            {
+                const Yuv top = read_yuv(m_input, src, src_pitch, m_height, x, y);
+                const Yuv bottom = read_yuv(m_input, src, src_pitch, m_height, x, y + 1);
+                u[static_cast<ptrdiff_t>(chroma_pitch) * (y / 2) + x / 2] = static_cast<BYTE>((top.u + bottom.u + 1) / 2);
+                v[static_cast<ptrdiff_t>(chroma_pitch) * (y / 2) + x / 2] = static_cast<BYTE>((top.v + bottom.v + 1) / 2);
+            }
+        }
+    }
+
+private:
+    GUID m_input;
+    GUID m_output;
+    UINT32 m_width;
+    UINT32 m_height;
+    double m_kr;
+    double m_kb;
+    bool m_full_range;
+    bool m_input_set;
+    bool m_output_set;
+    IMFSample* m_pending;
+};
+
+
+// Apartments, counted per thread
+
+thread_local uint32_t g_apartment_count = 0;
+thread_local DWORD g_apartment_flags = 0;
+std::atomic<uint32_t> g_startup_count(0);
+
+}
+
+
+// COM
+
+HRESULT CoInitializeEx(void* /*reserved*/, DWORD flags)
+{
+    if(g_apartment_count > 0)
+    {
+        if((flags & COINIT_APARTMENTTHREADED) != (g_apartment_flags & COINIT_APARTMENTTHREADED))
+        {
+            return RPC_E_CHANGED_MODE;
+        }
+
+        g_apartment_count++;
+        return S_FALSE;
+    }
+
+    g_apartment_count = 1;
+    g_apartment_flags = flags;
+    return S_OK;
+}
+
+void CoUninitialize()
+{
+    if(g_apartment_count > 0)
+    {
+        g_apartment_count--;
+    }
+}
+
+HRESULT CoCreateInstance(REFCLSID clsid, IUnknown* outer, DWORD /*context*/, REFIID riid, void** object)
+{
+    if(object == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    *object = nullptr;
+    if(outer != nullptr)
+    {
+        return E_NOTIMPL;
+    }
+    if(clsid != CLSID_CColorConvertDMO)
+    {
+        return REGDB_E_CLASSNOTREG;
+    }
+
+    ColorConverter* converter = new ColorConverter();
+    const HRESULT result = converter->QueryInterface(riid, object);
+    converter->Release();
+    return result;
+}
+
+void* CoTaskMemAlloc(size_t size)
+{
+    return std::malloc(size);
+}
+
+void CoTaskMemFree(void* memory)
+{
+    std::free(memory);
+}
+
+HRESULT PropVariantClear(PROPVARIANT* value)
+{
+    if(value == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    if(value->vt == VT_CLSID)
+    {
+        CoTaskMemFree(value->puuid);
+    }
+    else if(value->vt == VT_LPWSTR)
+    {
+        CoTaskMemFree(value->pwszVal);
+    }
+    else if(value->vt == VT_UNKNOWN && value->punkVal != nullptr)
+    {
+        value->punkVal->Release();
+    }
+
+    value->vt = VT_EMPTY;
+    value->uhVal.QuadPart = 0;
+    return S_OK;
+}
+
+
+// Media Foundation
+
+HRESULT MFStartup(ULONG version, DWORD /*flags*/)
+{
+    if(version != MF_VERSION)
+    {
+        return E_INVALIDARG;
+    }
+
+    g_startup_count++;
+    return S_OK;
+}
+
+HRESULT MFShutdown()
+{
+    if(g_startup_count == 0)
+    {
+        return MF_E_SHUTDOWN;
+    }
+
+    g_startup_count--;
+    return S_OK;
+}
+
+HRESULT MFCreateAttributes(IMFAttributes** attributes, UINT32 /*initial_size*/)
+{
+    *attributes = new PlainAttributes();
+    return S_OK;
+}
+
+HRESULT MFCreateMediaType(IMFMediaType** type)
+{
+    *type = new MediaType();
+    return S_OK;
+}
+
+HRESULT MFCreateSample(IMFSample** sample)
+{
+    *sample = new Sample();
+    return S_OK;
+}
+
+HRESULT MFCreateMemoryBuffer(DWORD max_length, IMFMediaBuffer** buffer)
+{
+    *buffer = new MemoryBuffer(max_length);
+    return S_OK;
+}
+
+HRESULT MFSetAttributeSize(IMFAttributes* attributes, REFGUID key, UINT32 width, UINT32 height)
+{
+    return attributes->SetUINT64(key, static_cast<UINT64>(width) << 32 | height);
+}
+
+HRESULT MFGetAttributeSize(IMFAttributes* attributes, REFGUID key, UINT32* width, UINT32* height)
+{
+    UINT64 value = 0;
+    const HRESULT result = attributes->GetUINT64(key, &value);
+    if(SUCCEEDED(result))
+    {
+        *width = static_cast<UINT32>(value >> 32);
+        *height = static_cast<UINT32>(value);
+    }
+    return result;
+}
+
+HRESULT MFSetAttributeRatio(IMFAttributes* attributes, REFGUID key, UINT32 numerator, UINT32 denominator)
+{
+    return MFSetAttributeSize(attributes, key, numerator, denominator);
+}
+
+HRESULT MFGetAttributeRatio(IMFAttributes* attributes, REFGUID key, UINT32* numerator, UINT32* denominator)
+{
+    return MFGetAttributeSize(attributes, key, numerator, denominator);
+}
+
+UINT32 MFGetAttributeUINT32(IMFAttributes* attributes, REFGUID key, UINT32 fallback)
+{
+    UINT32 value = 0;
+    return SUCCEEDED(attributes->GetUINT32(key, &value)) ? value : fallback;
+}
+
+namespace {
+
+// Cameras of CDI_SDK_CAMERAS, see camera.h
+void add_environment_cameras()
+{
+    const char* variable = std::getenv("CDI_SDK_CAMERAS");
+    if(variable == nullptr)
+    {
+        return;
+    }
+
+    const std::map<std::string, GUID> subtypes =
+    {
+        {"I420", MFVideoFormat_I420},
+        {"NV12", MFVideoFormat_NV12},
+        {"YUY2", MFVideoFormat_YUY2},
+        {"RGB24", MFVideoFormat_RGB24},
+    };
+
+    const std::string cameras(variable);
+    size_t start = 0;
+    while(start < cameras.size())
+    {
+        size_t end = cameras.find(';', start);
+        end = end == std::string::npos ? cameras.size() : end;
+        const std::string camera = cameras.substr(start, end - start);
+        start = end + 1;
+
+        const size_t equals = camera.find('=');
+        if(equals == std::string::npos)
+        {
+            continue;
+        }
+
+        sdk::CameraDesc desc;
+        desc.name.assign(camera.begin(), camera.begin() + equals);
+
+        size_t format_start = equals + 1;
+        while(format_start < camera.size())
+        {
+            size_t format_end = camera.find(',', format_start);
+            format_end = format_end == std::string::npos ? camera.size() : format_end;
+            const std::string format = camera.substr(format_start, format_end - format_start);
+            format_start = format_end + 1;
+
+            char name[16] = {};
+            sdk::CameraFormat parsed = {};
+            const auto subtype = std::sscanf(format.c_str(), "%15[^:]:%ux%u@%u", name, &parsed.width, &parsed.height, &parsed.fps) == 4
+                ? subtypes.find(name)
+                : subtypes.end();
+            if(subtype != subtypes.end())
+            {
+                parsed.subtype = subtype->second;
+                desc.formats.push_back(parsed);
+            }
+        }
+
+        if(!desc.formats.empty())
+        {
+            sdk::add_camera(desc);
+        }
+    }
+}
+
+}
+
+HRESULT MFEnumDeviceSources(IMFAttributes* attributes, IMFActivate*** devices, UINT32* count)
+{
+    GUID source_type = GUID_NULL;
+    if(attributes == nullptr || devices == nullptr || count == nullptr
+       || FAILED(attributes->GetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE, &source_type))
+       || source_type != MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID)
+    {
+        return E_INVALIDARG;
+    }
+
+    static std::once_flag environment;
+    std::call_once(environment, add_environment_cameras);
+
+    std::vector<std::shared_ptr<CameraState>> cameras;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        cameras = g_cameras;
+    }
+
+    *count = static_cast<UINT32>(cameras.size());
+    *devices = static_cast<IMFActivate**>(CoTaskMemAlloc(sizeof(IMFActivate*) * std::max<size_t>(cameras.size(), 1)));
+    for(size_t i = 0; i < cameras.size(); i++)
+    {
+        (*devices)[i] = new Activate(cameras[i]);
+    }
+
+    return S_OK;
+}
+
+HRESULT MFCreateSourceReaderFromMediaSource(IMFMediaSource* source, IMFAttributes* attributes, IMFSourceReader** reader)
+{
+    // Sources of the stand-in's cameras only
+    MediaSource* media_source = dynamic_cast<MediaSource*>(source);
+    if(media_source == nullptr || reader == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    SourceReader* created = new SourceReader(media_source, attributes);
+    *reader = created;
+    return S_OK;
+}
+
+
+// Cameras
+
+namespace sdk {
+
+CameraDesc::CameraDesc()
+    : name(L"Camera")
+    , row_padding(0)
+    , buffer_2d(false)
+    , activate_ms(0)
+    , activate_fails(false)
+{
+}
+
+std::shared_ptr<Camera> add_camera(const CameraDesc& desc)
+{
+    std::shared_ptr<CameraState> camera = std::make_shared<CameraState>(desc);
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_cameras.push_back(camera);
+    return camera;
+}
+
+void remove_cameras()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_cameras.clear();
+}
+
+bool packed_layout(const GUID& subtype, const uint32_t& width, const uint32_t& height, uint32_t& pitch, uint32_t& size)
+{
+    // Compressed frames have a size of their own, a tenth of the 8 bit luma plane
+    if(is_compressed(subtype))
+    {
+        pitch = 0;
+        size = std::max(64u, width * height / 10);
+        return true;
+    }
+
+    std::vector<PlaneShape> planes;
+    if(!plane_shapes(subtype, width, height, planes))
+    {
+        return false;
+    }
+
+    pitch = planes[0].row_bytes;
+    size = 0;
+    for(const PlaneShape& plane : planes)
+    {
+        size += plane.row_bytes * plane.rows;
+    }
+    return true;
+}
+
+void fill_frame(const GUID& subtype, const uint32_t& width, const uint32_t& height, const uint64_t& sequence, uint8_t* dst)
+{
+    uint32_t pitch = 0;
+    uint32_t size = 0;
+    if(!packed_layout(subtype, width, height, pitch, size))
+    {
+        return;
+    }
+
+    // Gradients which move with the frame number and differ from plane to plane, with some
+    // texture so that neighbouring frames and pixels differ
+    const uint32_t row_bytes = pitch != 0 ? pitch : size;
+    const uint32_t shift = static_cast<uint32_t>(sequence * 3);
+    for(uint32_t i = 0; i < size; i++)
+    {
+        const uint32_t x = i % row_bytes;
+        const uint32_t y = i / row_bytes;
+        dst[i] = static_cast<uint8_t>(x * 2 + y * 3 + shift + ((x * y) >> 4 & 0x1F) + (y / height) * 60);
+    }
+}
+
+void set_converter_failing(const bool& failing)
+{
+    g_converter_failing = failing;
+}
+
+void set_converter_plain_lock(const bool& plain_lock)
+{
+    g_converter_plain_lock = plain_lock;
+}
+
+uint32_t converter_instances()
+{
+    return g_converter_instances;
+}
+
+}
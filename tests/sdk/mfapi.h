@@ -0,0 +1,207 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Media Foundation platform functions, attribute helpers and the GUIDs of formats and
+// attributes. FOURCC formats carry their code in the first field as in the SDK, so subtypes
+// built from MFVideoFormat_Base match them, the attribute keys are ids of the stand-in's own.
+#pragma once
+#include "mfobjects.h"
+#include "mferror.h"
+
+
+#define MF_VERSION 0x00020070
+#define MFSTARTUP_FULL 0
+
+HRESULT MFStartup(ULONG version, DWORD flags = MFSTARTUP_FULL);
+HRESULT MFShutdown();
+HRESULT MFCreateAttributes(IMFAttributes** attributes, UINT32 initial_size);
+HRESULT MFCreateMediaType(IMFMediaType** type);
+HRESULT MFCreateSample(IMFSample** sample);
+HRESULT MFCreateMemoryBuffer(DWORD max_length, IMFMediaBuffer** buffer);
+
+// Sizes and ratios are packed into one UINT64, the first value in the upper half
+HRESULT MFSetAttributeSize(IMFAttributes* attributes, REFGUID key, UINT32 width, UINT32 height);
+HRESULT MFGetAttributeSize(IMFAttributes* attributes, REFGUID key, UINT32* width, UINT32* height);
+HRESULT MFSetAttributeRatio(IMFAttributes* attributes, REFGUID key, UINT32 numerator, UINT32 denominator);
+HRESULT MFGetAttributeRatio(IMFAttributes* attributes, REFGUID key, UINT32* numerator, UINT32* denominator);
+UINT32 MFGetAttributeUINT32(IMFAttributes* attributes, REFGUID key, UINT32 fallback);
+
+// Media types
+extern const GUID MFMediaType_Audio;
+extern const GUID MFMediaType_Binary;
+extern const GUID MFMediaType_FileTransfer;
+extern const GUID MFMediaType_HTML;
+extern const GUID MFMediaType_Image;
+extern const GUID MFMediaType_Protected;
+extern const GUID MFMediaType_SAMI;
+extern const GUID MFMediaType_Script;
+extern const GUID MFMediaType_Video;
+
+// Video formats
+extern const GUID MFVideoFormat_Base;
+extern const GUID MFVideoFormat_AI44;
+extern const GUID MFVideoFormat_ARGB32;
+extern const GUID MFVideoFormat_AYUV;
+extern const GUID MFVideoFormat_DV25;
+extern const GUID MFVideoFormat_DV50;
+extern const GUID MFVideoFormat_DVH1;
+extern const GUID MFVideoFormat_DVSD;
+extern const GUID MFVideoFormat_DVSL;
+extern const GUID MFVideoFormat_H264;
+extern const GUID MFVideoFormat_I420;
+extern const GUID MFVideoFormat_IYUV;
+extern const GUID MFVideoFormat_L16;
+extern const GUID MFVideoFormat_M4S2;
+extern const GUID MFVideoFormat_MJPG;
+extern const GUID MFVideoFormat_MP43;
+extern const GUID MFVideoFormat_MP4S;
+extern const GUID MFVideoFormat_MP4V;
+extern const GUID MFVideoFormat_MPG1;
+extern const GUID MFVideoFormat_MSS1;
+extern const GUID MFVideoFormat_MSS2;
+extern const GUID MFVideoFormat_NV11;
+extern const GUID MFVideoFormat_NV12;
+extern const GUID MFVideoFormat_P010;
+extern const GUID MFVideoFormat_P016;
+extern const GUID MFVideoFormat_P210;
+extern const GUID MFVideoFormat_P216;
+extern const GUID MFVideoFormat_RGB24;
+extern const GUID MFVideoFormat_RGB32;
+extern const GUID MFVideoFormat_RGB555;
+extern const GUID MFVideoFormat_RGB565;
+extern const GUID MFVideoFormat_RGB8;
+extern const GUID MFVideoFormat_UYVY;
+extern const GUID MFVideoFormat_WMV1;
+extern const GUID MFVideoFormat_WMV2;
+extern const GUID MFVideoFormat_WMV3;
+extern const GUID MFVideoFormat_WVC1;
+extern const GUID MFVideoFormat_Y210;
+extern const GUID MFVideoFormat_Y216;
+extern const GUID MFVideoFormat_Y410;
+extern const GUID MFVideoFormat_Y416;
+extern const GUID MFVideoFormat_Y41P;
+extern const GUID MFVideoFormat_Y41T;
+extern const GUID MFVideoFormat_YUY2;
+extern const GUID MFVideoFormat_YV12;
+extern const GUID MFVideoFormat_YVYU;
+extern const GUID MFVideoFormat_v210;
+extern const GUID MFVideoFormat_v410;
+
+// Audio formats
+extern const GUID MFAudioFormat_AAC;
+extern const GUID MFAudioFormat_ADTS;
+extern const GUID MFAudioFormat_DRM;
+extern const GUID MFAudioFormat_DTS;
+extern const GUID MFAudioFormat_Dolby_AC3_SPDIF;
+extern const GUID MFAudioFormat_Float;
+extern const GUID MFAudioFormat_MP3;
+extern const GUID MFAudioFormat_MPEG;
+extern const GUID MFAudioFormat_MSP1;
+extern const GUID MFAudioFormat_PCM;
+extern const GUID MFAudioFormat_WMASPDIF;
+extern const GUID MFAudioFormat_WMAudioV8;
+extern const GUID MFAudioFormat_WMAudioV9;
+extern const GUID MFAudioFormat_WMAudio_Lossless;
+
+// Sample attributes
+extern const GUID MFSampleExtension_CleanPoint;
+extern const GUID MFSampleExtension_DeviceTimestamp;
+
+// Media type attributes
+extern const GUID MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION;
+extern const GUID MF_MT_AAC_PAYLOAD_TYPE;
+extern const GUID MF_MT_ALL_SAMPLES_INDEPENDENT;
+extern const GUID MF_MT_AM_FORMAT_TYPE;
+extern const GUID MF_MT_ARBITRARY_FORMAT;
+extern const GUID MF_MT_ARBITRARY_HEADER;
+extern const GUID MF_MT_AUDIO_AVG_BYTES_PER_SECOND;
+extern const GUID MF_MT_AUDIO_BITS_PER_SAMPLE;
+extern const GUID MF_MT_AUDIO_BLOCK_ALIGNMENT;
+extern const GUID MF_MT_AUDIO_CHANNEL_MASK;
+extern const GUID MF_MT_AUDIO_FLOAT_SAMPLES_PER_SECOND;
+extern const GUID MF_MT_AUDIO_FOLDDOWN_MATRIX;
+extern const GUID MF_MT_AUDIO_NUM_CHANNELS;
+extern const GUID MF_MT_AUDIO_PREFER_WAVEFORMATEX;
+extern const GUID MF_MT_AUDIO_SAMPLES_PER_BLOCK;
+extern const GUID MF_MT_AUDIO_SAMPLES_PER_SECOND;
+extern const GUID MF_MT_AUDIO_VALID_BITS_PER_SAMPLE;
+extern const GUID MF_MT_AUDIO_WMADRC_AVGREF;
+extern const GUID MF_MT_AUDIO_WMADRC_AVGTARGET;
+extern const GUID MF_MT_AUDIO_WMADRC_PEAKREF;
+extern const GUID MF_MT_AUDIO_WMADRC_PEAKTARGET;
+extern const GUID MF_MT_AVG_BITRATE;
+extern const GUID MF_MT_AVG_BIT_ERROR_RATE;
+extern const GUID MF_MT_COMPRESSED;
+extern const GUID MF_MT_CUSTOM_VIDEO_PRIMARIES;
+extern const GUID MF_MT_DEFAULT_STRIDE;
+extern const GUID MF_MT_DRM_FLAGS;
+extern const GUID MF_MT_DV_AAUX_CTRL_PACK_0;
+extern const GUID MF_MT_DV_AAUX_CTRL_PACK_1;
+extern const GUID MF_MT_DV_AAUX_SRC_PACK_0;
+extern const GUID MF_MT_DV_AAUX_SRC_PACK_1;
+extern const GUID MF_MT_DV_VAUX_CTRL_PACK;
+extern const GUID MF_MT_DV_VAUX_SRC_PACK;
+extern const GUID MF_MT_FIXED_SIZE_SAMPLES;
+extern const GUID MF_MT_FRAME_RATE;
+extern const GUID MF_MT_FRAME_RATE_RANGE_MAX;
+extern const GUID MF_MT_FRAME_RATE_RANGE_MIN;
+extern const GUID MF_MT_FRAME_SIZE;
+extern const GUID MF_MT_GEOMETRIC_APERTURE;
+extern const GUID MF_MT_IMAGE_LOSS_TOLERANT;
+extern const GUID MF_MT_INTERLACE_MODE;
+extern const GUID MF_MT_MAJOR_TYPE;
+extern const GUID MF_MT_MAX_KEYFRAME_SPACING;
+extern const GUID MF_MT_MINIMUM_DISPLAY_APERTURE;
+extern const GUID MF_MT_MPEG2_FLAGS;
+extern const GUID MF_MT_MPEG2_LEVEL;
+extern const GUID MF_MT_MPEG2_PROFILE;
+extern const GUID MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY;
+extern const GUID MF_MT_MPEG4_SAMPLE_DESCRIPTION;
+extern const GUID MF_MT_MPEG_SEQUENCE_HEADER;
+extern const GUID MF_MT_MPEG_START_TIME_CODE;
+extern const GUID MF_MT_ORIGINAL_4CC;
+extern const GUID MF_MT_ORIGINAL_WAVE_FORMAT_TAG;
+extern const GUID MF_MT_PAD_CONTROL_FLAGS;
+extern const GUID MF_MT_PALETTE;
+extern const GUID MF_MT_PAN_SCAN_APERTURE;
+extern const GUID MF_MT_PAN_SCAN_ENABLED;
+extern const GUID MF_MT_PIXEL_ASPECT_RATIO;
+extern const GUID MF_MT_SAMPLE_SIZE;
+extern const GUID MF_MT_SOURCE_CONTENT_HINT;
+extern const GUID MF_MT_SUBTYPE;
+extern const GUID MF_MT_TRANSFER_FUNCTION;
+extern const GUID MF_MT_USER_DATA;
+extern const GUID MF_MT_VIDEO_CHROMA_SITING;
+extern const GUID MF_MT_VIDEO_LIGHTING;
+extern const GUID MF_MT_VIDEO_NOMINAL_RANGE;
+extern const GUID MF_MT_VIDEO_PRIMARIES;
+extern const GUID MF_MT_WRAPPED_TYPE;
+extern const GUID MF_MT_YUV_MATRIX;
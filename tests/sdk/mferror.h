@@ -0,0 +1,49 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Media Foundation status codes the library and the stand-in return
+#pragma once
+#include "windows.h"
+
+
+#define MF_E_INVALIDMEDIATYPE (static_cast<HRESULT>(0xC00D36B4))
+#define MF_E_INVALIDREQUEST (static_cast<HRESULT>(0xC00D36B2))
+#define MF_E_NOTACCEPTING (static_cast<HRESULT>(0xC00D36B5))
+#define MF_E_NO_MORE_TYPES (static_cast<HRESULT>(0xC00D36B9))
+#define MF_E_ATTRIBUTENOTFOUND (static_cast<HRESULT>(0xC00D36E6))
+#define MF_E_INVALIDTYPE (static_cast<HRESULT>(0xC00D36E7))
+#define MF_E_INVALIDSTREAMNUMBER (static_cast<HRESULT>(0xC00D36B3))
+#define MF_E_TRANSFORM_NEED_MORE_INPUT (static_cast<HRESULT>(0xC00D6D72))
+#define MF_E_TRANSFORM_TYPE_NOT_SET (static_cast<HRESULT>(0xC00D6D60))
+#define MF_E_SHUTDOWN (static_cast<HRESULT>(0xC00D3E85))
+#define MF_E_HW_MFT_FAILED_START_STREAMING (static_cast<HRESULT>(0xC00D3704))
+#define MF_E_VIDEO_RECORDING_DEVICE_INVALIDATED (static_cast<HRESULT>(0xC00D3EA2))
+#define MF_E_VIDEO_RECORDING_DEVICE_PREEMPTED (static_cast<HRESULT>(0xC00D3EA3))
@@ -0,0 +1,76 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Media sources and their descriptors, and the enumeration of capture devices
+#pragma once
+#include "mfobjects.h"
+#include "mferror.h"
+
+
+struct IMFMediaTypeHandler : public IUnknown
+{
+    STDMETHOD(GetMediaTypeCount)(DWORD* count) = 0;
+    STDMETHOD(GetMediaTypeByIndex)(DWORD index, IMFMediaType** type) = 0;
+    STDMETHOD(SetCurrentMediaType)(IMFMediaType* type) = 0;
+    STDMETHOD(GetCurrentMediaType)(IMFMediaType** type) = 0;
+};
+
+struct IMFStreamDescriptor : public IMFAttributes
+{
+    STDMETHOD(GetStreamIdentifier)(DWORD* identifier) = 0;
+    STDMETHOD(GetMediaTypeHandler)(IMFMediaTypeHandler** handler) = 0;
+};
+
+struct IMFPresentationDescriptor : public IMFAttributes
+{
+    STDMETHOD(GetStreamDescriptorCount)(DWORD* count) = 0;
+    STDMETHOD(GetStreamDescriptorByIndex)(DWORD index, BOOL* selected, IMFStreamDescriptor** descriptor) = 0;
+};
+
+struct IMFMediaSource : public IUnknown
+{
+    STDMETHOD(CreatePresentationDescriptor)(IMFPresentationDescriptor** descriptor) = 0;
+    STDMETHOD(Stop)() = 0;
+    STDMETHOD(Shutdown)() = 0;
+};
+
+template<> const IID& uuid_of<IMFMediaTypeHandler>();
+template<> const IID& uuid_of<IMFStreamDescriptor>();
+template<> const IID& uuid_of<IMFPresentationDescriptor>();
+template<> const IID& uuid_of<IMFMediaSource>();
+
+// The cameras registered through camera.h, in the order they were added
+HRESULT MFEnumDeviceSources(IMFAttributes* attributes, IMFActivate*** devices, UINT32* count);
+
+extern const GUID MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME;
+extern const GUID MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE;
+extern const GUID MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID;
+extern const GUID MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK;
@@ -0,0 +1,156 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Media Foundation objects: attribute stores, media types, buffers and samples. Only the
+// methods the library calls, with the SDK's names and argument order.
+#pragma once
+#include "objbase.h"
+
+#include <cstdint>
+
+
+#define VT_EMPTY 0
+#define VT_UNKNOWN 13
+#define VT_UI4 19
+#define VT_UI8 21
+#define VT_LPWSTR 31
+#define VT_CLSID 72
+
+struct PROPVARIANT
+{
+    uint16_t vt;
+    union
+    {
+        UINT32 ulVal;
+        ULARGE_INTEGER uhVal;
+        GUID* puuid;
+        LPWSTR pwszVal;
+        IUnknown* punkVal;
+    };
+};
+
+// Frees what a GetItem() allocated
+HRESULT PropVariantClear(PROPVARIANT* value);
+
+struct IMFAttributes : public IUnknown
+{
+    STDMETHOD(GetItem)(REFGUID key, PROPVARIANT* value) = 0;
+    STDMETHOD(GetUINT32)(REFGUID key, UINT32* value) = 0;
+    STDMETHOD(GetUINT64)(REFGUID key, UINT64* value) = 0;
+    STDMETHOD(GetGUID)(REFGUID key, GUID* value) = 0;
+    STDMETHOD(GetStringLength)(REFGUID key, UINT32* length) = 0;
+    STDMETHOD(GetString)(REFGUID key, LPWSTR value, UINT32 size, UINT32* length) = 0;
+    STDMETHOD(GetAllocatedString)(REFGUID key, LPWSTR* value, UINT32* length) = 0;
+    STDMETHOD(GetUnknown)(REFGUID key, REFIID riid, void** object) = 0;
+    STDMETHOD(DeleteItem)(REFGUID key) = 0;
+    STDMETHOD(DeleteAllItems)() = 0;
+    STDMETHOD(SetUINT32)(REFGUID key, UINT32 value) = 0;
+    STDMETHOD(SetUINT64)(REFGUID key, UINT64 value) = 0;
+    STDMETHOD(SetGUID)(REFGUID key, REFGUID value) = 0;
+    STDMETHOD(SetString)(REFGUID key, LPCWSTR value) = 0;
+    STDMETHOD(SetUnknown)(REFGUID key, IUnknown* object) = 0;
+    STDMETHOD(GetCount)(UINT32* count) = 0;
+    STDMETHOD(CopyAllItems)(IMFAttributes* destination) = 0;
+};
+
+struct IMFMediaType : public IMFAttributes
+{
+    STDMETHOD(GetMajorType)(GUID* major_type) = 0;
+};
+
+struct IMFMediaBuffer : public IUnknown
+{
+    STDMETHOD(Lock)(BYTE** buffer, DWORD* max_length, DWORD* current_length) = 0;
+    STDMETHOD(Unlock)() = 0;
+    STDMETHOD(GetCurrentLength)(DWORD* current_length) = 0;
+    STDMETHOD(SetCurrentLength)(DWORD current_length) = 0;
+    STDMETHOD(GetMaxLength)(DWORD* max_length) = 0;
+};
+
+struct IMF2DBuffer : public IUnknown
+{
+    STDMETHOD(Lock2D)(BYTE** scanline0, LONG* pitch) = 0;
+    STDMETHOD(Unlock2D)() = 0;
+    STDMETHOD(GetScanline0AndPitch)(BYTE** scanline0, LONG* pitch) = 0;
+    STDMETHOD(IsContiguousFormat)(BOOL* contiguous) = 0;
+    STDMETHOD(GetContiguousLength)(DWORD* length) = 0;
+    STDMETHOD(ContiguousCopyTo)(BYTE* destination, DWORD destination_length) = 0;
+    STDMETHOD(ContiguousCopyFrom)(const BYTE* source, DWORD source_length) = 0;
+};
+
+struct IMFSample : public IMFAttributes
+{
+    STDMETHOD(GetSampleTime)(LONGLONG* time) = 0;
+    STDMETHOD(SetSampleTime)(LONGLONG time) = 0;
+    STDMETHOD(GetBufferCount)(DWORD* count) = 0;
+    STDMETHOD(GetBufferByIndex)(DWORD index, IMFMediaBuffer** buffer) = 0;
+    STDMETHOD(ConvertToContiguousBuffer)(IMFMediaBuffer** buffer) = 0;
+    STDMETHOD(AddBuffer)(IMFMediaBuffer* buffer) = 0;
+    STDMETHOD(RemoveAllBuffers)() = 0;
+    STDMETHOD(GetTotalLength)(DWORD* length) = 0;
+};
+
+struct IMFActivate : public IMFAttributes
+{
+    STDMETHOD(ActivateObject)(REFIID riid, void** object) = 0;
+    STDMETHOD(ShutdownObject)() = 0;
+    STDMETHOD(DetachObject)() = 0;
+};
+
+struct IMFMediaEvent : public IMFAttributes
+{
+};
+
+template<> const IID& uuid_of<IUnknown>();
+template<> const IID& uuid_of<IMFAttributes>();
+template<> const IID& uuid_of<IMFMediaType>();
+template<> const IID& uuid_of<IMFMediaBuffer>();
+template<> const IID& uuid_of<IMF2DBuffer>();
+template<> const IID& uuid_of<IMFSample>();
+template<> const IID& uuid_of<IMFActivate>();
+template<> const IID& uuid_of<IMFMediaEvent>();
+
+enum MFVideoTransferMatrix
+{
+    MFVideoTransferMatrix_Unknown = 0,
+    MFVideoTransferMatrix_BT709 = 1,
+    MFVideoTransferMatrix_BT601 = 2,
+    MFVideoTransferMatrix_SMPTE240M = 3,
+    MFVideoTransferMatrix_BT2020_10 = 4,
+    MFVideoTransferMatrix_BT2020_12 = 5,
+};
+
+enum MFNominalRange
+{
+    MFNominalRange_Unknown = 0,
+    MFNominalRange_0_255 = 1,
+    MFNominalRange_16_235 = 2,
+};
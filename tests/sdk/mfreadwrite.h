@@ -0,0 +1,95 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// The source reader, synchronous or completing reads on a thread of its own through the
+// callback set as MF_SOURCE_READER_ASYNC_CALLBACK
+#pragma once
+#include "mfidl.h"
+
+
+#define MF_SOURCE_READER_INVALID_STREAM_INDEX 0xFFFFFFFF
+#define MF_SOURCE_READER_ALL_STREAMS 0xFFFFFFFE
+#define MF_SOURCE_READER_ANY_STREAM 0xFFFFFFFE
+#define MF_SOURCE_READER_FIRST_AUDIO_STREAM 0xFFFFFFFD
+#define MF_SOURCE_READER_FIRST_VIDEO_STREAM 0xFFFFFFFC
+#define MF_SOURCE_READER_MEDIASOURCE 0xFFFFFFFF
+
+#define MF_SOURCE_READERF_ERROR 0x1
+#define MF_SOURCE_READERF_ENDOFSTREAM 0x2
+#define MF_SOURCE_READERF_NEWSTREAM 0x4
+#define MF_SOURCE_READERF_NATIVEMEDIATYPECHANGED 0x10
+#define MF_SOURCE_READERF_CURRENTMEDIATYPECHANGED 0x20
+#define MF_SOURCE_READERF_STREAMTICK 0x100
+
+#define MF_SOURCE_READER_CONTROLF_DRAIN 0x1
+
+struct IMFSourceReader : public IUnknown
+{
+    STDMETHOD(GetStreamSelection)(DWORD stream_index, BOOL* selected) = 0;
+    STDMETHOD(SetStreamSelection)(DWORD stream_index, BOOL selected) = 0;
+    STDMETHOD(GetNativeMediaType)(DWORD stream_index, DWORD type_index, IMFMediaType** type) = 0;
+    STDMETHOD(GetCurrentMediaType)(DWORD stream_index, IMFMediaType** type) = 0;
+    STDMETHOD(SetCurrentMediaType)(DWORD stream_index, DWORD* reserved, IMFMediaType* type) = 0;
+    STDMETHOD(ReadSample)(
+        DWORD stream_index,
+        DWORD control_flags,
+        DWORD* actual_stream_index,
+        DWORD* stream_flags,
+        LONGLONG* timestamp,
+        IMFSample** sample) = 0;
+    STDMETHOD(Flush)(DWORD stream_index) = 0;
+};
+
+struct IMFSourceReaderEx : public IMFSourceReader
+{
+    STDMETHOD(SetNativeMediaType)(DWORD stream_index, IMFMediaType* type, DWORD* stream_flags) = 0;
+};
+
+struct IMFSourceReaderCallback : public IUnknown
+{
+    STDMETHOD(OnReadSample)(HRESULT status, DWORD stream_index, DWORD stream_flags, LONGLONG timestamp, IMFSample* sample) = 0;
+    STDMETHOD(OnFlush)(DWORD stream_index) = 0;
+    STDMETHOD(OnEvent)(DWORD stream_index, IMFMediaEvent* event) = 0;
+};
+
+template<> const IID& uuid_of<IMFSourceReader>();
+template<> const IID& uuid_of<IMFSourceReaderEx>();
+template<> const IID& uuid_of<IMFSourceReaderCallback>();
+
+extern const IID IID_IMFSourceReaderCallback;
+
+HRESULT MFCreateSourceReaderFromMediaSource(IMFMediaSource* source, IMFAttributes* attributes, IMFSourceReader** reader);
+
+extern const GUID MF_SOURCE_READER_ASYNC_CALLBACK;
+extern const GUID MF_SOURCE_READER_DISCONNECT_MEDIASOURCE_ON_SHUTDOWN;
+extern const GUID MF_SOURCE_READER_ENABLE_VIDEO_PROCESSING;
+extern const GUID MF_READWRITE_DISABLE_CONVERTERS;
+extern const GUID MF_LOW_LATENCY;
@@ -0,0 +1,80 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Media Foundation transforms, one input and one output stream with caller allocated samples
+#pragma once
+#include "mfobjects.h"
+#include "mferror.h"
+
+
+#define MFT_INPUT_STATUS_ACCEPT_DATA 0x1
+#define MFT_OUTPUT_STREAM_PROVIDES_SAMPLES 0x100
+
+enum MFT_MESSAGE_TYPE
+{
+    MFT_MESSAGE_COMMAND_FLUSH = 0,
+    MFT_MESSAGE_COMMAND_DRAIN = 0x1,
+    MFT_MESSAGE_NOTIFY_BEGIN_STREAMING = 0x10000000,
+    MFT_MESSAGE_NOTIFY_END_STREAMING = 0x10000001,
+    MFT_MESSAGE_NOTIFY_START_OF_STREAM = 0x10000003,
+};
+
+struct MFT_OUTPUT_STREAM_INFO
+{
+    DWORD dwFlags;
+    DWORD cbSize;
+    DWORD cbAlignment;
+};
+
+struct IMFCollection;
+
+struct MFT_OUTPUT_DATA_BUFFER
+{
+    DWORD dwStreamID;
+    IMFSample* pSample;
+    DWORD dwStatus;
+    IMFCollection* pEvents;
+};
+
+struct IMFTransform : public IUnknown
+{
+    STDMETHOD(GetInputStatus)(DWORD stream_id, DWORD* flags) = 0;
+    STDMETHOD(GetOutputStreamInfo)(DWORD stream_id, MFT_OUTPUT_STREAM_INFO* info) = 0;
+    STDMETHOD(SetInputType)(DWORD stream_id, IMFMediaType* type, DWORD flags) = 0;
+    STDMETHOD(SetOutputType)(DWORD stream_id, IMFMediaType* type, DWORD flags) = 0;
+    STDMETHOD(ProcessMessage)(MFT_MESSAGE_TYPE message, uintptr_t param) = 0;
+    STDMETHOD(ProcessInput)(DWORD stream_id, IMFSample* sample, DWORD flags) = 0;
+    STDMETHOD(ProcessOutput)(DWORD flags, DWORD buffer_count, MFT_OUTPUT_DATA_BUFFER* buffers, DWORD* status) = 0;
+};
+
+template<> const IID& uuid_of<IMFTransform>();
+
+extern const IID IID_IMFTransform;
@@ -0,0 +1,79 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// COM as far as the library uses it: reference counted interfaces with QueryInterface by the
+// interface id, apartments which are only counted per thread, task memory on the C heap and the
+// one class the library creates, the Color Converter DSP of the stand-in.
+#pragma once
+#include "windows.h"
+#include "guiddef.h"
+
+
+#define STDMETHOD(method) virtual HRESULT STDMETHODCALLTYPE method
+#define STDMETHOD_(type, method) virtual type STDMETHODCALLTYPE method
+
+// Interface ids are looked up by type, 'uuid_of<IMFSample>()' for '__uuidof(IMFSample)'
+template<typename T>
+const IID& uuid_of();
+
+template<typename T>
+const IID& uuid_of_pointer(T**)
+{
+    return uuid_of<T>();
+}
+
+#define __uuidof(type) uuid_of<type>()
+#define IID_PPV_ARGS(pointer) uuid_of_pointer(pointer), reinterpret_cast<void**>(pointer)
+
+struct IUnknown
+{
+    STDMETHOD(QueryInterface)(REFIID riid, void** object) = 0;
+    STDMETHOD_(ULONG, AddRef)() = 0;
+    STDMETHOD_(ULONG, Release)() = 0;
+
+protected:
+    // Objects go with their last reference, never through an interface pointer
+    virtual ~IUnknown() {}
+};
+
+#define COINIT_MULTITHREADED 0x0
+#define COINIT_APARTMENTTHREADED 0x2
+#define COINIT_DISABLE_OLE1DDE 0x4
+#define CLSCTX_INPROC_SERVER 0x1
+#define RPC_E_CHANGED_MODE (static_cast<HRESULT>(0x80010106))
+#define REGDB_E_CLASSNOTREG (static_cast<HRESULT>(0x80040154))
+
+// S_FALSE when the thread is initialised already, every success needs a CoUninitialize()
+HRESULT CoInitializeEx(void* reserved, DWORD flags);
+void CoUninitialize();
+HRESULT CoCreateInstance(REFCLSID clsid, IUnknown* outer, DWORD context, REFIID riid, void** object);
+void* CoTaskMemAlloc(size_t size);
+void CoTaskMemFree(void* memory);
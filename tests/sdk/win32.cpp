@@ -0,0 +1,476 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "windows.h"
+#include "psapi.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+
+namespace {
+
+// Files and mappings share one handle type, a mapping refers to the descriptor of its file
+struct Object
+{
+    int fd;
+    bool mapping;
+    bool writable;
+    std::string delete_path;
+};
+
+std::mutex g_views_mutex;
+std::map<const void*, size_t> g_views;
+
+std::string narrow(LPCWSTR path)
+{
+    std::string result;
+    for(; *path != 0; path++)
+    {
+        result.push_back(static_cast<char>(*path));
+    }
+    return result;
+}
+
+Object* object(HANDLE handle)
+{
+    return handle == nullptr || handle == INVALID_HANDLE_VALUE ? nullptr : static_cast<Object*>(handle);
+}
+
+// Arbitrary handle values which never get closed
+HANDLE const CURRENT_PROCESS = reinterpret_cast<HANDLE>(static_cast<intptr_t>(-1));
+HANDLE const CURRENT_THREAD = reinterpret_cast<HANDLE>(static_cast<intptr_t>(-2));
+
+// The system as the stand-in presents it: one group of four processors on NUMA node 0
+const KAFFINITY SYSTEM_PROCESSORS = 0xF;
+const DWORD SYSTEM_NODE = 0;
+
+thread_local int g_thread_priority = THREAD_PRIORITY_NORMAL;
+thread_local GROUP_AFFINITY g_thread_affinity = {1, 0, {0, 0, 0}};
+
+}
+
+HANDLE CreateFileW(
+    LPCWSTR path,
+    DWORD access,
+    DWORD share,
+    void* security,
+    DWORD disposition,
+    DWORD flags,
+    HANDLE template_file)
+{
+    (void)share;
+    (void)security;
+    (void)template_file;
+
+    int mode = 0;
+    if((access & GENERIC_READ) && (access & GENERIC_WRITE))
+    {
+        mode = O_RDWR;
+    }
+    else if(access & GENERIC_WRITE)
+    {
+        mode = O_WRONLY;
+    }
+    else
+    {
+        mode = O_RDONLY;
+    }
+
+    if(disposition == CREATE_ALWAYS)
+    {
+        mode |= O_CREAT | O_TRUNC;
+    }
+
+    const std::string name = narrow(path);
+    const int fd = open(name.c_str(), mode | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    Object* result = new Object();
+    result->fd = fd;
+    result->mapping = false;
+    result->writable = (access & GENERIC_WRITE) != 0;
+    if(flags & FILE_FLAG_DELETE_ON_CLOSE)
+    {
+        result->delete_path = name;
+    }
+
+    return result;
+}
+
+BOOL WriteFile(HANDLE file, const void* data, DWORD size, DWORD* written, void* overlapped)
+{
+    (void)overlapped;
+
+    Object* target = object(file);
+    if(target == nullptr || target->mapping)
+    {
+        return FALSE;
+    }
+
+    const ssize_t result = write(target->fd, data, size);
+    if(result < 0)
+    {
+        return FALSE;
+    }
+
+    if(written != nullptr)
+    {
+        *written = static_cast<DWORD>(result);
+    }
+    return TRUE;
+}
+
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size)
+{
+    Object* target = object(file);
+    struct stat status = {};
+    if(target == nullptr || fstat(target->fd, &status) != 0)
+    {
+        return FALSE;
+    }
+
+    size->QuadPart = static_cast<LONGLONG>(status.st_size);
+    return TRUE;
+}
+
+HANDLE CreateFileMappingW(HANDLE file, void* security, DWORD protect, DWORD size_high, DWORD size_low, LPCWSTR name)
+{
+    (void)security;
+    (void)name;
+
+    Object* source = object(file);
+    if(source == nullptr || source->mapping)
+    {
+        return nullptr;
+    }
+
+    // A mapping larger than the file grows it, as on Windows
+    const off_t size = static_cast<off_t>((static_cast<uint64_t>(size_high) << 32) | size_low);
+    struct stat status = {};
+    if(fstat(source->fd, &status) != 0
+       || (size == 0 && status.st_size == 0)
+       || (size > status.st_size && (protect != PAGE_READWRITE || ftruncate(source->fd, size) != 0)))
+    {
+        return nullptr;
+    }
+
+    Object* result = new Object();
+    result->fd = dup(source->fd);
+    result->mapping = true;
+    result->writable = protect == PAGE_READWRITE;
+
+    return result;
+}
+
+LPVOID MapViewOfFile(HANDLE mapping, DWORD access, DWORD offset_high, DWORD offset_low, size_t size)
+{
+    Object* source = object(mapping);
+    if(source == nullptr || !source->mapping || ((access & FILE_MAP_WRITE) && !source->writable))
+    {
+        return nullptr;
+    }
+
+    const off_t offset = static_cast<off_t>((static_cast<uint64_t>(offset_high) << 32) | offset_low);
+    if(size == 0)
+    {
+        struct stat status = {};
+        if(fstat(source->fd, &status) != 0 || status.st_size <= offset)
+        {
+            return nullptr;
+        }
+        size = static_cast<size_t>(status.st_size - offset);
+    }
+
+    const int protection = (access & FILE_MAP_WRITE) ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* view = mmap(nullptr, size, protection, MAP_SHARED, source->fd, offset);
+    if(view == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_views_mutex);
+    g_views[view] = size;
+
+    return view;
+}
+
+BOOL UnmapViewOfFile(const void* address)
+{
+    size_t size = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_views_mutex);
+        const auto it = g_views.find(address);
+        if(it == g_views.end())
+        {
+            return FALSE;
+        }
+        size = it->second;
+        g_views.erase(it);
+    }
+
+    return munmap(const_cast<void*>(address), size) == 0 ? TRUE : FALSE;
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+    Object* target = object(handle);
+    if(target == nullptr)
+    {
+        return FALSE;
+    }
+
+    close(target->fd);
+    if(!target->delete_path.empty())
+    {
+        unlink(target->delete_path.c_str());
+    }
+    delete target;
+
+    return TRUE;
+}
+
+LPVOID VirtualAllocExNuma(HANDLE process, LPVOID address, size_t size, DWORD type, DWORD protect, DWORD node)
+{
+    (void)process;
+    (void)type;
+    (void)protect;
+
+    // Nodes the system does not have are refused, as Windows does
+    if(address != nullptr || size == 0 || (node != SYSTEM_NODE && node != NUMA_NO_PREFERRED_NODE))
+    {
+        return nullptr;
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_views_mutex);
+    g_views[memory] = size;
+
+    return memory;
+}
+
+BOOL VirtualFree(LPVOID address, size_t size, DWORD type)
+{
+    if(size != 0 || type != MEM_RELEASE)
+    {
+        return FALSE;
+    }
+
+    return UnmapViewOfFile(address);
+}
+
+HANDLE GetCurrentProcess()
+{
+    return CURRENT_PROCESS;
+}
+
+HANDLE GetCurrentThread()
+{
+    return CURRENT_THREAD;
+}
+
+DWORD GetCurrentThreadId()
+{
+    static std::atomic<DWORD> next(1);
+    thread_local DWORD id = next++;
+    return id;
+}
+
+BOOL SetThreadGroupAffinity(HANDLE thread, const GROUP_AFFINITY* affinity, GROUP_AFFINITY* previous)
+{
+    if(thread != CURRENT_THREAD || affinity == nullptr || affinity->Mask == 0)
+    {
+        return FALSE;
+    }
+    // Processors or groups the system does not have, the thread keeps its affinity
+    if(affinity->Group != 0 || (affinity->Mask & ~SYSTEM_PROCESSORS) != 0)
+    {
+        return FALSE;
+    }
+
+    if(previous != nullptr)
+    {
+        *previous = g_thread_affinity;
+    }
+    g_thread_affinity = *affinity;
+
+    return TRUE;
+}
+
+BOOL GetThreadGroupAffinity(HANDLE thread, GROUP_AFFINITY* affinity)
+{
+    if(thread != CURRENT_THREAD || affinity == nullptr)
+    {
+        return FALSE;
+    }
+
+    *affinity = g_thread_affinity;
+    return TRUE;
+}
+
+BOOL SetThreadPriority(HANDLE thread, int priority)
+{
+    if(thread != CURRENT_THREAD)
+    {
+        return FALSE;
+    }
+
+    g_thread_priority = priority;
+    return TRUE;
+}
+
+int GetThreadPriority(HANDLE thread)
+{
+    return thread == CURRENT_THREAD ? g_thread_priority : THREAD_PRIORITY_NORMAL;
+}
+
+void GetCurrentProcessorNumberEx(PROCESSOR_NUMBER* processor)
+{
+    processor->Group = 0;
+    processor->Number = static_cast<BYTE>(sched_getcpu() & 0xFF);
+    processor->Reserved = 0;
+}
+
+BOOL GetNumaProcessorNodeEx(PROCESSOR_NUMBER* processor, USHORT* node)
+{
+    (void)processor;
+    *node = static_cast<USHORT>(SYSTEM_NODE);
+    return TRUE;
+}
+
+void Sleep(DWORD milliseconds)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+LONG InterlockedIncrement(volatile LONG* value)
+{
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+LONG InterlockedDecrement(volatile LONG* value)
+{
+    return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency)
+{
+    frequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* counter)
+{
+    timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    counter->QuadPart = static_cast<LONGLONG>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    return TRUE;
+}
+
+void GetSystemTimeAsFileTime(FILETIME* time)
+{
+    // 100ns units since 1601
+    timespec now = {};
+    clock_gettime(CLOCK_REALTIME, &now);
+    const uint64_t value = (static_cast<uint64_t>(now.tv_sec) + 11644473600ull) * 10000000 + now.tv_nsec / 100;
+    time->dwLowDateTime = static_cast<DWORD>(value);
+    time->dwHighDateTime = static_cast<DWORD>(value >> 32);
+}
+
+BOOL GetSystemTimes(FILETIME* idle, FILETIME* kernel, FILETIME* user)
+{
+    // Clock ticks of all processors: user nice system idle iowait irq softirq
+    FILE* file = fopen("/proc/stat", "r");
+    if(file == nullptr)
+    {
+        return FALSE;
+    }
+
+    unsigned long long ticks[7] = {};
+    const int fields = fscanf(file, "cpu %llu %llu %llu %llu %llu %llu %llu",
+        &ticks[0], &ticks[1], &ticks[2], &ticks[3], &ticks[4], &ticks[5], &ticks[6]);
+    fclose(file);
+    if(fields != 7)
+    {
+        return FALSE;
+    }
+
+    // Kernel time includes the idle time on Windows, both in 100ns units
+    const uint64_t scale = 10000000 / static_cast<uint64_t>(sysconf(_SC_CLK_TCK));
+    const uint64_t idle_time = (ticks[3] + ticks[4]) * scale;
+    const uint64_t kernel_time = (ticks[2] + ticks[5] + ticks[6]) * scale + idle_time;
+    const uint64_t user_time = (ticks[0] + ticks[1]) * scale;
+
+    idle->dwLowDateTime = static_cast<DWORD>(idle_time);
+    idle->dwHighDateTime = static_cast<DWORD>(idle_time >> 32);
+    kernel->dwLowDateTime = static_cast<DWORD>(kernel_time);
+    kernel->dwHighDateTime = static_cast<DWORD>(kernel_time >> 32);
+    user->dwLowDateTime = static_cast<DWORD>(user_time);
+    user->dwHighDateTime = static_cast<DWORD>(user_time >> 32);
+
+    return TRUE;
+}
+
+BOOL QueryWorkingSetEx(HANDLE process, LPVOID info, DWORD size)
+{
+    if(process != CURRENT_PROCESS || size < sizeof(PSAPI_WORKING_SET_EX_INFORMATION))
+    {
+        return FALSE;
+    }
+
+    PSAPI_WORKING_SET_EX_INFORMATION* entry = static_cast<PSAPI_WORKING_SET_EX_INFORMATION*>(info);
+    entry->VirtualAttributes.Flags = 0;
+    entry->VirtualAttributes.Valid = 1;
+
+    return TRUE;
+}
@@ -0,0 +1,247 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Times the lossless codec on synthetic camera frames: encode and decode per frame, the
+// compression ratio and the throughput for each predictor, with one worker and with all of the
+// hardware threads. Every decoded frame is compared against the source.
+
+#include "FrameLayout.h"
+#include "LosslessCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    Options() : width(3840), height(2160), runs(10), threads(0) {}
+    uint32_t width;
+    uint32_t height;
+    uint32_t runs;
+    uint32_t threads; // Zero for one and all hardware threads
+};
+
+// Gradients, edges and sensor noise, roughly the entropy of a camera image, in 0..1
+double sample(const uint32_t& x, const uint32_t& y, const uint32_t& channel, uint32_t& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    const double noise = (static_cast<double>((seed >> 16) % 9) - 4.0) / 255.0;
+    const double edge = ((x / 64 + y / 64) % 2) != 0 ? 0.08 : -0.08;
+    const double value = 0.5 + 0.23 * std::sin(x * 0.03 + channel) + 0.16 * std::cos(y * 0.05 - channel) + edge + noise;
+    return std::min(1.0, std::max(0.0, value));
+}
+
+// Fills every plane, chroma planes at their own resolution
+std::vector<uint8_t> render(const uint32_t& width, const uint32_t& height, const cdi::Encoding& encoding)
+{
+    cdi::FrameLayout layout;
+    layout.init(width, height, encoding);
+    std::vector<uint8_t> frame(layout.size());
+
+    uint32_t seed = 1;
+    for(uint32_t p = 0; p < layout.plane_count(); p++)
+    {
+        const cdi::FrameLayout::Plane& plane = layout.plane(p);
+        const bool wide = cdi::FrameLayout::is_wide(encoding);
+        const uint32_t bytes = wide ? 2 : 1;
+        const uint32_t samples = plane.width / bytes;
+        const uint32_t channels = plane.step / bytes;
+
+        for(uint32_t y = 0; y < plane.height; y++)
+        {
+            uint8_t* row = frame.data() + plane.offset + static_cast<size_t>(y) * plane.stride;
+            for(uint32_t i = 0; i < samples; i++)
+            {
+                const double value = sample(i / channels, y, p * 4 + i % channels, seed);
+                if(wide)
+                {
+                    // 10 significant bits in the high bits as P010 and Y210 carry them
+                    const uint16_t code = static_cast<uint16_t>(std::lround(value * 1023.0) << 6);
+                    row[i * 2] = static_cast<uint8_t>(code);
+                    row[i * 2 + 1] = static_cast<uint8_t>(code >> 8);
+                }
+                else
+                {
+                    row[i] = static_cast<uint8_t>(std::lround(value * 255.0));
+                }
+            }
+        }
+    }
+
+    return frame;
+}
+
+// Fastest of the runs in milliseconds
+template<typename F>
+double best_of(const uint32_t& runs, F run)
+{
+    double best = 1e30;
+    for(uint32_t i = 0; i < runs; i++)
+    {
+        const Clock::time_point start = Clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(i + 1 >= argc)
+        {
+            return false;
+        }
+
+        const uint32_t value = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        if(arg == "--width")
+        {
+            options.width = value;
+        }
+        else if(arg == "--height")
+        {
+            options.height = value;
+        }
+        else if(arg == "--runs")
+        {
+            options.runs = value;
+        }
+        else if(arg == "--threads")
+        {
+            options.threads = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options.width >= 16 && options.height >= 16 && options.runs > 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parse(argc, argv, options))
+    {
+        std::printf("usage: cdi_codec_bench [--width 3840] [--height 2160] [--runs 10] [--threads 0]\n");
+        return 1;
+    }
+
+    std::vector<uint32_t> thread_counts;
+    if(options.threads != 0)
+    {
+        thread_counts.push_back(options.threads);
+    }
+    else
+    {
+        thread_counts.push_back(1);
+        const uint32_t hardware = std::thread::hardware_concurrency();
+        if(hardware > 1)
+        {
+            thread_counts.push_back(hardware);
+        }
+    }
+
+    std::printf("%ux%u, fastest of %u runs, %u hardware threads\n",
+        options.width, options.height, options.runs, std::thread::hardware_concurrency());
+    std::printf("%-22s %8s %10s %10s %8s %10s %10s\n", "", "threads", "encode ms", "decode ms", "ratio", "enc MB/s", "dec MB/s");
+
+    struct Source
+    {
+        const char* name;
+        cdi::Encoding encoding;
+    };
+    const Source sources[] = {
+        {"I420", cdi::Encoding::I420},
+        {"P010", cdi::Encoding::P010},
+        {"RGB24", cdi::Encoding::RGB24},
+    };
+
+    bool failed = false;
+    for(const Source& source : sources)
+    {
+        const std::vector<uint8_t> frame = render(options.width, options.height, source.encoding);
+        std::vector<uint8_t> decoded(frame.size());
+
+        for(const cdi::Predictor predictor : {cdi::Predictor::LEFT, cdi::Predictor::MEDIAN})
+        {
+            for(const uint32_t threads : thread_counts)
+            {
+                cdi::LosslessCodec codec(predictor, threads);
+                std::vector<uint8_t> encoded(codec.bound(options.width, options.height, source.encoding));
+
+                size_t size = 0;
+                const double encode_ms = best_of(options.runs, [&]() {
+                    size = codec.encode(frame.data(), options.width, options.height, source.encoding, encoded.data(), encoded.size());
+                });
+
+                bool decoded_ok = false;
+                const double decode_ms = best_of(options.runs, [&]() {
+                    decoded_ok = codec.decode(encoded.data(), size, decoded.data(), decoded.size());
+                });
+
+                const bool exact = size > 0 && decoded_ok && std::memcmp(decoded.data(), frame.data(), frame.size()) == 0;
+                failed = failed || !exact;
+
+                const double megabytes = static_cast<double>(frame.size()) / 1e6;
+                const std::string name = std::string(source.name)
+                    + (predictor == cdi::Predictor::LEFT ? " left" : " median") + (exact ? "" : " MISMATCH");
+                std::printf("%-22s %8u %10.2f %10.2f %8.2f %10.0f %10.0f\n",
+                    name.c_str(),
+                    threads,
+                    encode_ms,
+                    decode_ms,
+                    size > 0 ? static_cast<double>(frame.size()) / size : 0.0,
+                    megabytes / (encode_ms / 1000.0),
+                    megabytes / (decode_ms / 1000.0));
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}
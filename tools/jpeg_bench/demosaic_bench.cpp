@@ -0,0 +1,268 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Times the demosaic of synthetic Bayer frames, bilinear against edge-aware, on one thread and
+// on all of them, and measures the PSNR of the RGB result against the image the mosaic was
+// sampled from: one scene of smooth gradients and one with hard edges and fine texture.
+
+#include "Demosaic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    Options() : width(1920), height(1080), bits(12), runs(20) {}
+    uint32_t width;
+    uint32_t height;
+    uint32_t bits;
+    uint32_t runs;
+};
+
+// Packed B, G, R, top-down
+std::vector<uint8_t> render(const uint32_t& width, const uint32_t& height, const bool& edges)
+{
+    std::vector<uint8_t> image(static_cast<size_t>(width) * height * 3);
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            double r = 128.0 + 90.0 * std::sin(x * 0.011 + y * 0.004);
+            double g = 128.0 + 90.0 * std::sin(x * 0.007 - y * 0.009 + 1.0);
+            double b = 128.0 + 90.0 * std::cos(x * 0.005 + y * 0.012);
+            if(edges)
+            {
+                // Blocks of differing brightness with hard borders and a fine texture of a
+                // few pixels period, shared by all channels as in natural images
+                const bool block = ((x / 48 + y / 48) % 2) != 0;
+                const double texture = 40.0 * std::sin(x * 0.9) * std::sin(y * 0.7);
+                const double level = (block ? 170.0 : 70.0) + texture;
+                r = level + 0.3 * (r - 128.0);
+                g = level + 0.3 * (g - 128.0);
+                b = level + 0.3 * (b - 128.0);
+            }
+
+            uint8_t* pixel = &image[(static_cast<size_t>(y) * width + x) * 3];
+            pixel[0] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, b)));
+            pixel[1] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, g)));
+            pixel[2] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, r)));
+        }
+    }
+    return image;
+}
+
+// RGGB samples of the image, 8 bit as bytes, wider as 16 bit low aligned
+std::vector<uint8_t> mosaic(const std::vector<uint8_t>& image, const uint32_t& width, const uint32_t& height, const uint32_t& bits)
+{
+    const uint32_t bytes = bits == 8 ? 1 : 2;
+    std::vector<uint8_t> raw(static_cast<size_t>(width) * height * bytes);
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            // Red on even rows and columns, blue on odd ones
+            const uint32_t channel = (y % 2 == 0) ? (x % 2 == 0 ? 2 : 1) : (x % 2 == 0 ? 1 : 0);
+            const uint32_t value = image[(static_cast<size_t>(y) * width + x) * 3 + channel];
+            const size_t i = static_cast<size_t>(y) * width + x;
+            if(bytes == 1)
+            {
+                raw[i] = static_cast<uint8_t>(value);
+            }
+            else
+            {
+                const uint32_t wide = (value * ((1u << bits) - 1) + 127) / 255;
+                raw[i * 2] = static_cast<uint8_t>(wide);
+                raw[i * 2 + 1] = static_cast<uint8_t>(wide >> 8);
+            }
+        }
+    }
+    return raw;
+}
+
+// Over all three channels, without the two pixel border where the kernels mirror the mosaic
+double psnr(const std::vector<uint8_t>& image, const std::vector<uint8_t>& result, const uint32_t& width, const uint32_t& height)
+{
+    double error_sum = 0.0;
+    size_t count = 0;
+    for(uint32_t y = 2; y + 2 < height; y++)
+    {
+        for(uint32_t x = 2; x + 2 < width; x++)
+        {
+            for(uint32_t c = 0; c < 3; c++)
+            {
+                const size_t i = (static_cast<size_t>(y) * width + x) * 3 + c;
+                const double diff = static_cast<double>(image[i]) - result[i];
+                error_sum += diff * diff;
+                count++;
+            }
+        }
+    }
+
+    const double mse = std::max(error_sum / static_cast<double>(count), 1e-6);
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// Fastest of the runs in milliseconds
+template<typename F>
+double best_of(const uint32_t& runs, F run)
+{
+    double best = 1e30;
+    for(uint32_t i = 0; i < runs; i++)
+    {
+        const Clock::time_point start = Clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(i + 1 >= argc)
+        {
+            return false;
+        }
+
+        const uint32_t value = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        if(arg == "--width")
+        {
+            options.width = value;
+        }
+        else if(arg == "--height")
+        {
+            options.height = value;
+        }
+        else if(arg == "--bits")
+        {
+            options.bits = value;
+        }
+        else if(arg == "--runs")
+        {
+            options.runs = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options.width >= 16 && options.height >= 16 && options.width % 2 == 0 && options.height % 2 == 0
+        && (options.bits == 8 || options.bits == 10 || options.bits == 12 || options.bits == 16) && options.runs > 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parse(argc, argv, options))
+    {
+        std::printf("usage: cdi_demosaic_bench [--width 1920] [--height 1080] [--bits 8|10|12|16] [--runs 20]\n");
+        return 1;
+    }
+
+    const uint32_t width = options.width;
+    const uint32_t height = options.height;
+    const std::vector<uint8_t> smooth = render(width, height, false);
+    const std::vector<uint8_t> edges = render(width, height, true);
+    const std::vector<uint8_t> smooth_raw = mosaic(smooth, width, height, options.bits);
+    const std::vector<uint8_t> edges_raw = mosaic(edges, width, height, options.bits);
+    const int32_t src_pitch = static_cast<int32_t>(width * (options.bits == 8 ? 1 : 2));
+    const int32_t dst_pitch = static_cast<int32_t>(width * 3);
+    const double pixels = static_cast<double>(width) * height;
+
+    cdi::BayerFormat format;
+    format.pattern = cdi::BayerPattern::RGGB;
+    format.bits = options.bits;
+
+    std::printf("%ux%u RGGB %u bit to RGB24, fastest of %u runs, %u hardware threads\n",
+        width, height, options.bits, options.runs, std::thread::hardware_concurrency());
+    std::printf("%-24s %10s %10s %12s %12s\n", "", "ms", "Mpix/s", "psnr smooth", "psnr edges");
+
+    struct Method
+    {
+        const char* name;
+        cdi::DemosaicMethod method;
+    };
+    const Method methods[] = {
+        {"bilinear", cdi::DemosaicMethod::BILINEAR},
+        {"edge-aware", cdi::DemosaicMethod::EDGE_AWARE},
+    };
+
+    bool failed = false;
+    for(const Method& method : methods)
+    {
+        for(const uint32_t threads : {1u, 0u})
+        {
+            cdi::DemosaicOptions demosaic_options;
+            demosaic_options.method = method.method;
+            demosaic_options.threads = threads;
+
+            cdi::Demosaic demosaic;
+            if(!demosaic.init(width, height, format, cdi::Encoding::RGB24, cdi::ColorSpace(), demosaic_options, nullptr))
+            {
+                std::printf("%s: init failed\n", method.name);
+                return 1;
+            }
+
+            std::vector<uint8_t> result(static_cast<size_t>(width) * height * 3);
+            const double ms = best_of(options.runs, [&]() {
+                demosaic.run(smooth_raw.data(), src_pitch, result.data(), dst_pitch);
+            });
+            const double smooth_psnr = psnr(smooth, result, width, height);
+
+            demosaic.run(edges_raw.data(), src_pitch, result.data(), dst_pitch);
+            const double edges_psnr = psnr(edges, result, width, height);
+
+            failed = failed || smooth_psnr < 30.0;
+
+            const std::string name = std::string(method.name) + (threads == 1 ? ", 1 thread" : ", all threads");
+            std::printf("%-24s %10.2f %10.1f %12.1f %12.1f\n", name.c_str(), ms, pixels / ms / 1000.0, smooth_psnr, edges_psnr);
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,407 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Times JPEG snapshots of synthetic camera frames: the encoder reading NV12, YUY2 and I420 as
+// the device delivers them, at every scale, against the path it replaces, the RGB24 conversion
+// of lock() handed to libjpeg which converts back to YUV. With libjpeg every snapshot is also
+// decoded again and compared against the source frame.
+
+#include "ColorKernels.h"
+#include "JpegEncoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(CDI_BENCH_LIBJPEG)
+#   include <jpeglib.h>
+#endif
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    Options() : width(1920), height(1080), quality(85), runs(20) {}
+    uint32_t width;
+    uint32_t height;
+    uint32_t quality;
+    uint32_t runs;
+};
+
+// A frame in full range 4:2:0, packed into the device formats on demand
+struct Frame
+{
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> u;
+    std::vector<uint8_t> v;
+};
+
+// Gradients, edges and sensor noise, roughly the entropy of a camera image
+Frame render(const uint32_t& width, const uint32_t& height)
+{
+    Frame frame;
+    frame.width = width;
+    frame.height = height;
+    frame.y.resize(static_cast<size_t>(width) * height);
+    frame.u.resize(static_cast<size_t>(width / 2) * (height / 2));
+    frame.v.resize(frame.u.size());
+
+    uint32_t seed = 1;
+    for(uint32_t row = 0; row < height; row++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            const double noise = static_cast<double>((seed >> 16) % 9) - 4.0;
+            const double edge = ((x / 64 + row / 64) % 2) != 0 ? 20.0 : -20.0;
+            const double value = 128.0 + 60.0 * std::sin(x * 0.03) + 40.0 * std::cos(row * 0.05) + edge + noise;
+            frame.y[static_cast<size_t>(row) * width + x] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, value)));
+        }
+    }
+
+    for(uint32_t row = 0; row < height / 2; row++)
+    {
+        for(uint32_t x = 0; x < width / 2; x++)
+        {
+            const size_t i = static_cast<size_t>(row) * (width / 2) + x;
+            frame.u[i] = static_cast<uint8_t>(128.0 + 50.0 * std::sin(x * 0.05 + row * 0.02));
+            frame.v[i] = static_cast<uint8_t>(128.0 + 50.0 * std::cos(x * 0.03 - row * 0.04));
+        }
+    }
+
+    return frame;
+}
+
+// Limited range as cameras deliver it
+uint8_t limited_luma(const uint8_t& value)
+{
+    return static_cast<uint8_t>(16 + (value * 219 + 127) / 255);
+}
+
+uint8_t limited_chroma(const uint8_t& value)
+{
+    return static_cast<uint8_t>(16 + (value * 224 + 127) / 255);
+}
+
+std::vector<uint8_t> pack(const Frame& frame, const cdi::kernels::YuvFormat& format)
+{
+    const uint32_t width = frame.width;
+    const uint32_t height = frame.height;
+    const uint32_t chroma_width = width / 2;
+    std::vector<uint8_t> packed;
+
+    if(format == cdi::kernels::YuvFormat::YUY2)
+    {
+        packed.resize(static_cast<size_t>(width) * 2 * height);
+        for(uint32_t row = 0; row < height; row++)
+        {
+            uint8_t* dst = packed.data() + static_cast<size_t>(row) * width * 2;
+            for(uint32_t x = 0; x < width; x++)
+            {
+                dst[x * 2] = limited_luma(frame.y[static_cast<size_t>(row) * width + x]);
+            }
+            for(uint32_t x = 0; x < chroma_width; x++)
+            {
+                const size_t i = static_cast<size_t>(row / 2) * chroma_width + x;
+                dst[x * 4 + 1] = limited_chroma(frame.u[i]);
+                dst[x * 4 + 3] = limited_chroma(frame.v[i]);
+            }
+        }
+        return packed;
+    }
+
+    const size_t luma_size = static_cast<size_t>(width) * height;
+    packed.resize(luma_size + luma_size / 2);
+    for(size_t i = 0; i < luma_size; i++)
+    {
+        packed[i] = limited_luma(frame.y[i]);
+    }
+
+    uint8_t* chroma = packed.data() + luma_size;
+    for(size_t i = 0; i < frame.u.size(); i++)
+    {
+        if(format == cdi::kernels::YuvFormat::I420)
+        {
+            chroma[i] = limited_chroma(frame.u[i]);
+            chroma[frame.u.size() + i] = limited_chroma(frame.v[i]);
+        }
+        else
+        {
+            chroma[i * 2] = limited_chroma(frame.u[i]);
+            chroma[i * 2 + 1] = limited_chroma(frame.v[i]);
+        }
+    }
+
+    return packed;
+}
+
+// Fastest of the runs in milliseconds
+template<typename F>
+double best_of(const uint32_t& runs, F run)
+{
+    double best = 1e30;
+    for(uint32_t i = 0; i < runs; i++)
+    {
+        const Clock::time_point start = Clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+#if defined(CDI_BENCH_LIBJPEG)
+
+size_t libjpeg_encode(const uint8_t* bgr, const uint32_t& width, const uint32_t& height, const uint32_t& quality, std::vector<uint8_t>& out)
+{
+    jpeg_compress_struct info;
+    jpeg_error_mgr error;
+    info.err = jpeg_std_error(&error);
+    jpeg_create_compress(&info);
+
+    unsigned char* memory = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&info, &memory, &size);
+
+    info.image_width = width;
+    info.image_height = height;
+    info.input_components = 3;
+    info.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, static_cast<int>(quality), TRUE);
+    jpeg_start_compress(&info, TRUE);
+
+    // Channel order does not matter for the timing
+    while(info.next_scanline < info.image_height)
+    {
+        JSAMPROW row = const_cast<JSAMPROW>(bgr + static_cast<size_t>(info.next_scanline) * width * 3);
+        jpeg_write_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+
+    out.assign(memory, memory + size);
+    free(memory);
+    return size;
+}
+
+// PSNR of the decoded luma against the box filtered source, zero when decoding fails
+double luma_psnr(const Frame& frame, const uint8_t* jpeg, const size_t& size, const uint32_t& scale)
+{
+    jpeg_decompress_struct info;
+    jpeg_error_mgr error;
+    info.err = jpeg_std_error(&error);
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, const_cast<unsigned char*>(jpeg), static_cast<unsigned long>(size));
+    if(jpeg_read_header(&info, TRUE) != JPEG_HEADER_OK)
+    {
+        jpeg_destroy_decompress(&info);
+        return 0.0;
+    }
+
+    info.out_color_space = JCS_YCbCr;
+    jpeg_start_decompress(&info);
+
+    const uint32_t width = info.output_width;
+    const uint32_t height = info.output_height;
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 3);
+    double error_sum = 0.0;
+    while(info.output_scanline < height)
+    {
+        const uint32_t y = info.output_scanline;
+        JSAMPROW rows[1] = {row.data()};
+        jpeg_read_scanlines(&info, rows, 1);
+
+        for(uint32_t x = 0; x < width; x++)
+        {
+            uint32_t sum = 0;
+            for(uint32_t i = 0; i < scale * scale; i++)
+            {
+                sum += frame.y[static_cast<size_t>(y * scale + i / scale) * frame.width + x * scale + i % scale];
+            }
+            const double diff = static_cast<double>(sum) / (scale * scale) - row[x * 3];
+            error_sum += diff * diff;
+        }
+    }
+
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+
+    const bool expected = width == frame.width / scale && height == frame.height / scale;
+    const double mse = std::max(error_sum / (static_cast<double>(width) * height), 1e-6);
+    return expected ? 10.0 * std::log10(255.0 * 255.0 / mse) : 0.0;
+}
+
+#endif
+
+bool parse(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(i + 1 >= argc)
+        {
+            return false;
+        }
+
+        const uint32_t value = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        if(arg == "--width")
+        {
+            options.width = value;
+        }
+        else if(arg == "--height")
+        {
+            options.height = value;
+        }
+        else if(arg == "--quality")
+        {
+            options.quality = value;
+        }
+        else if(arg == "--runs")
+        {
+            options.runs = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options.width >= 16 && options.height >= 16 && options.width % 2 == 0 && options.height % 2 == 0
+        && options.runs > 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parse(argc, argv, options))
+    {
+        std::printf("usage: cdi_jpeg_bench [--width 1920] [--height 1080] [--quality 85] [--runs 20]\n");
+        return 1;
+    }
+
+    cdi::JpegEncoder encoder;
+    if(!encoder.init(options.quality))
+    {
+        std::printf("quality must be 1..100\n");
+        return 1;
+    }
+
+    const Frame frame = render(options.width, options.height);
+    std::vector<uint8_t> out(cdi::JpegEncoder::bound(options.width, options.height));
+
+    std::printf("%ux%u quality %u, fastest of %u runs\n", options.width, options.height, options.quality, options.runs);
+    std::printf("%-28s %10s %10s %10s\n", "", "ms", "bytes", "psnr");
+
+    struct Source
+    {
+        const char* name;
+        cdi::kernels::YuvFormat format;
+        uint32_t bytes_per_pixel;
+    };
+    const Source sources[] = {
+        {"NV12", cdi::kernels::YuvFormat::NV12, 1},
+        {"YUY2", cdi::kernels::YuvFormat::YUY2, 2},
+        {"I420", cdi::kernels::YuvFormat::I420, 1},
+    };
+
+    bool failed = false;
+    for(const Source& source : sources)
+    {
+        const std::vector<uint8_t> packed = pack(frame, source.format);
+        const int32_t pitch = static_cast<int32_t>(options.width * source.bytes_per_pixel);
+
+        for(uint32_t scale = 1; scale <= 8; scale *= 2)
+        {
+            size_t size = 0;
+            const double ms = best_of(options.runs, [&]() {
+                size = encoder.encode(
+                    source.format,
+                    packed.data(),
+                    pitch,
+                    options.width,
+                    options.height,
+                    scale,
+                    cdi::ColorRange::LIMITED,
+                    out.data(),
+                    out.size());
+            });
+
+            double psnr = 0.0;
+#if defined(CDI_BENCH_LIBJPEG)
+            psnr = luma_psnr(frame, out.data(), size, scale);
+            failed = failed || psnr < 30.0;
+#endif
+            failed = failed || size == 0;
+
+            const std::string name = std::string("snapshot ") + source.name + " 1/" + std::to_string(scale);
+            std::printf("%-28s %10.2f %10zu %10.1f\n", name.c_str(), ms, size, psnr);
+        }
+    }
+
+#if defined(CDI_BENCH_LIBJPEG)
+    // The path of a lock() in RGB24 with the image handed to libjpeg
+    const std::vector<uint8_t> nv12 = pack(frame, cdi::kernels::YuvFormat::NV12);
+    std::vector<uint8_t> rgb(static_cast<size_t>(options.width) * options.height * 3);
+    const cdi::kernels::YuvToRgb kernel = cdi::kernels::find_yuv_to_rgb(
+        cdi::kernels::YuvFormat::NV12, cdi::Encoding::RGB24, cdi::ColorSpace());
+    const int32_t rgb_pitch = static_cast<int32_t>(options.width * 3);
+
+    const double convert_ms = best_of(options.runs, [&]() {
+        kernel(nv12.data(), static_cast<int32_t>(options.width), rgb.data(), rgb_pitch, options.width, options.height, nullptr);
+    });
+
+    std::vector<uint8_t> reference;
+    size_t reference_size = 0;
+    const double libjpeg_ms = best_of(options.runs, [&]() {
+        reference_size = libjpeg_encode(rgb.data(), options.width, options.height, options.quality, reference);
+    });
+
+    std::printf("%-28s %10.2f\n", "NV12 to RGB24", convert_ms);
+    std::printf("%-28s %10.2f %10zu\n", "libjpeg from RGB24", libjpeg_ms, reference_size);
+    std::printf("%-28s %10.2f\n", "RGB24 and libjpeg", convert_ms + libjpeg_ms);
+#endif
+
+    return failed ? 1 : 0;
+}
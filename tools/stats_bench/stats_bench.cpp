@@ -0,0 +1,234 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Times the luma statistics: the pass of their own of Device::inspect() alone for the luma
+// layouts of the native formats, which DSP conversions still need, and a YUY2 to RGBA32
+// conversion with the statistics run after the whole frame or inside the kernel's row loop.
+
+#include "ColorKernels.h"
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    Options() : width(0), height(0), runs(20) {}
+    uint32_t width; // Zero for 1080p and 4K
+    uint32_t height;
+    uint32_t runs;
+};
+
+// Smooth content with edges and noise in every byte, luma or not
+std::vector<uint8_t> render(const uint32_t& width, const uint32_t& height, const uint32_t& step)
+{
+    std::vector<uint8_t> frame(static_cast<size_t>(width) * height * step);
+    uint32_t seed = 1;
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width * step; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            const double edge = ((x / step / 64 + y / 64) % 2) != 0 ? 20.0 : -20.0;
+            const double value = 128.0 + 60.0 * std::sin(x * 0.01) * std::cos(y * 0.02) + edge + (seed >> 16) % 9;
+            frame[static_cast<size_t>(y) * width * step + x] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, value)));
+        }
+    }
+    return frame;
+}
+
+void accumulate(
+    cdi::FrameStats& stats,
+    const uint8_t* luma,
+    const size_t& pitch,
+    const uint32_t& width,
+    const uint32_t& first,
+    const uint32_t& rows,
+    const uint32_t& step)
+{
+    const uint8_t* prev = first > 0 ? luma + pitch * (first - 1) : nullptr;
+    for(uint32_t row = first; row < first + rows; row++)
+    {
+        const uint8_t* cur = luma + pitch * row;
+        stats.accumulate_row(cur, prev, width, step);
+        prev = cur;
+    }
+}
+
+// Fastest of the runs in milliseconds
+template<typename F>
+double best_of(const uint32_t& runs, F run)
+{
+    double best = 1e30;
+    for(uint32_t i = 0; i < runs; i++)
+    {
+        const Clock::time_point start = Clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(i + 1 >= argc)
+        {
+            return false;
+        }
+
+        const uint32_t value = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        if(arg == "--width")
+        {
+            options.width = value;
+        }
+        else if(arg == "--height")
+        {
+            options.height = value;
+        }
+        else if(arg == "--runs")
+        {
+            options.runs = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return (options.width == 0) == (options.height == 0) && options.runs > 0;
+}
+
+void report(const char* name, const double& ms)
+{
+    // Share of the frame interval at 30 fps
+    std::printf("%-34s %8.2f %8.1f%%\n", name, ms, ms / (1000.0 / 30.0) * 100.0);
+}
+
+void run(const uint32_t& width, const uint32_t& height, const uint32_t& runs)
+{
+    std::printf("\n%ux%u, fastest of %u runs\n", width, height, runs);
+    std::printf("%-34s %8s %9s\n", "", "ms", "of 30fps");
+
+    cdi::StatisticsOptions options;
+    options.enabled = true;
+    cdi::FrameStats stats;
+
+    struct Layout
+    {
+        const char* name;
+        uint32_t step;
+        uint32_t offset;
+    };
+    const Layout layouts[] = {
+        {"statistics, I420/NV12 luma", 1, 0},
+        {"statistics, YUY2/P010 luma", 2, 0},
+        {"statistics, RGBA32 green", 4, 1},
+    };
+
+    for(const Layout& layout : layouts)
+    {
+        const std::vector<uint8_t> frame = render(width, height, layout.step);
+        const size_t pitch = static_cast<size_t>(width) * layout.step;
+        report(layout.name, best_of(runs, [&]() {
+            stats.begin();
+            accumulate(stats, frame.data() + layout.offset, pitch, width, 0, height, layout.step);
+            stats.finish(options);
+        }));
+    }
+
+    cdi::ColorSpace color;
+    const cdi::kernels::YuvToRgb kernel = cdi::kernels::find_yuv_to_rgb(
+        cdi::kernels::YuvFormat::YUY2, cdi::Encoding::RGBA32, color);
+    if(kernel == nullptr)
+    {
+        return;
+    }
+
+    const std::vector<uint8_t> yuy2 = render(width, height, 2);
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 4);
+    const int32_t src_pitch = static_cast<int32_t>(width * 2);
+    const int32_t dst_pitch = static_cast<int32_t>(width * 4);
+
+    report("YUY2 to RGBA32", best_of(runs, [&]() {
+        kernel(yuy2.data(), src_pitch, rgb.data(), dst_pitch, width, height, nullptr);
+    }));
+
+    report("YUY2 to RGBA32, separate pass", best_of(runs, [&]() {
+        kernel(yuy2.data(), src_pitch, rgb.data(), dst_pitch, width, height, nullptr);
+        stats.begin();
+        accumulate(stats, yuy2.data(), static_cast<size_t>(src_pitch), width, 0, height, 2);
+        stats.finish(options);
+    }));
+
+    report("YUY2 to RGBA32, fused", best_of(runs, [&]() {
+        stats.begin();
+        kernel(yuy2.data(), src_pitch, rgb.data(), dst_pitch, width, height, &stats);
+        stats.finish(options);
+    }));
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parse(argc, argv, options))
+    {
+        std::printf("usage: cdi_stats_bench [--width 0 --height 0] [--runs 20]\n");
+        return 1;
+    }
+
+    if(options.width != 0)
+    {
+        run(options.width, options.height, options.runs);
+    }
+    else
+    {
+        run(1920, 1080, options.runs);
+        run(3840, 2160, options.runs);
+    }
+
+    return 0;
+}
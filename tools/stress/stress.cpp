@@ -0,0 +1,623 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Stress harness for the threading of the capture pipeline. Runs N cameras of the SDK stand-in
+// (tests/sdk) with M consumers each for a fixed time and reports delivered against expected
+// frame rates, CPU time per stream, the 99th percentile of the lock latency and the memory
+// footprint. With --sweep the camera count doubles until the streams saturate.
+//
+// Every camera is opened through the library: a single consumer gets an asynchronous
+// open_device() stream and waits for frames through notify_frame(), several consumers attach to
+// an open_shared() stream and lock in turn, as applications do. The stand-in delivers a frame
+// per interval of the camera's rate to a pending read, late reads lose the frames in between.
+//
+// Lock latency is the time from the frame's capture timestamp to a consumer holding the
+// converted frame, so it covers the read, the waits on every mutex on the way and the
+// conversion. The stand-in stamps a frame before it renders it, its rendering counts as well, as
+// it does in the CPU time, which is that of the whole process.
+
+#include "camera.h"
+
+#include <cdi/cdi.h>
+
+#include <mfapi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    Options()
+        : cameras(8), consumers(1), width(1280), height(720), fps(30)
+        , source(&MFVideoFormat_YUY2), encoding(cdi::Encoding::RGB24)
+        , duration(10.0), warmup(1.0), padding(0), sweep(false), shared(false) {}
+    uint32_t cameras;
+    uint32_t consumers;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps;
+    const GUID* source;
+    cdi::Encoding encoding;
+    double duration;
+    double warmup;
+    uint32_t padding; // Bytes after every row of the camera's 2D buffers, as drivers lay them out
+    bool sweep;
+    bool shared;      // Shared streams also for a single consumer
+};
+
+// Result of one run
+struct Report
+{
+    Report() : cameras(0), expected(0.0), fps_min(0.0), fps_mean(0.0), cpu(0.0), p99(0.0), p50(0.0), rss(0), dropped(0.0) {}
+    uint32_t cameras;
+    double expected;
+    double fps_min;     // Frames per second of the slowest consumer
+    double fps_mean;
+    double cpu;         // Per stream in percent of one core, the whole process
+    double p99;         // Lock latency in microseconds
+    double p50;
+    size_t rss;         // Bytes above the footprint before the run
+    double dropped;     // Percent of the cameras' frame intervals without a frame read
+};
+
+// CPU time of all threads of this process in nanoseconds
+int64_t process_cpu()
+{
+    timespec time;
+    if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+    {
+        return 0;
+    }
+
+    return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+size_t resident_bytes()
+{
+    FILE* file = std::fopen("/proc/self/statm", "r");
+    if(file == nullptr)
+    {
+        return 0;
+    }
+
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    const int read = std::fscanf(file, "%lu %lu", &size, &resident);
+    std::fclose(file);
+    return read == 2 ? static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+// Locks frames of one buffer as fast as they come and reads a few bytes of each
+class Consumer
+{
+    Consumer(const Consumer&);
+    Consumer& operator=(const Consumer&);
+
+public:
+    Consumer(std::unique_ptr<cdi::IBuffer> buffer, const bool& asynchronous, const std::atomic<bool>& measuring, const std::atomic<bool>& exit);
+    ~Consumer();
+
+    void start();
+    // Wakes a consumer waiting for a frame, after 'exit' is set
+    void cancel();
+    void join();
+    uint64_t frames() const;
+    const std::vector<uint32_t>& latencies() const;
+
+private:
+    void run();
+    // Asynchronous streams, false when the wait was cancelled
+    bool wait_frame();
+
+private:
+    std::unique_ptr<cdi::IBuffer> m_buffer;
+    const bool m_asynchronous;
+    const std::atomic<bool>& m_measuring;
+    const std::atomic<bool>& m_exit;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_signalled;
+    bool m_ready;
+
+    uint64_t m_sequence;
+    std::atomic<uint64_t> m_frames;
+    std::vector<uint32_t> m_latencies;
+    uint32_t m_checksum;
+};
+
+Consumer::Consumer(std::unique_ptr<cdi::IBuffer> buffer, const bool& asynchronous, const std::atomic<bool>& measuring, const std::atomic<bool>& exit)
+    : m_buffer(std::move(buffer))
+    , m_asynchronous(asynchronous)
+    , m_measuring(measuring)
+    , m_exit(exit)
+    , m_signalled(false)
+    , m_ready(false)
+    , m_sequence(0)
+    , m_frames(0)
+    , m_checksum(0)
+{
+}
+
+Consumer::~Consumer()
+{
+    join();
+}
+
+void Consumer::start()
+{
+    m_thread = std::thread(&Consumer::run, this);
+}
+
+void Consumer::cancel()
+{
+    if(m_asynchronous)
+    {
+        m_buffer->cancel_notify();
+    }
+}
+
+void Consumer::join()
+{
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+uint64_t Consumer::frames() const
+{
+    return m_frames;
+}
+
+const std::vector<uint32_t>& Consumer::latencies() const
+{
+    return m_latencies;
+}
+
+bool Consumer::wait_frame()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_signalled = false;
+        m_ready = false;
+    }
+
+    // 'ready' may run right away on this thread
+    const bool requested = m_buffer->notify_frame([this](bool ready)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_signalled = true;
+        m_ready = ready;
+        m_condition.notify_one();
+    });
+
+    if(!requested)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]() { return m_signalled; });
+    return m_ready;
+}
+
+void Consumer::run()
+{
+    while(!m_exit)
+    {
+        if(m_asynchronous && !wait_frame())
+        {
+            continue;
+        }
+
+        const uint8_t* data = static_cast<const uint8_t*>(m_buffer->lock());
+        if(data == nullptr)
+        {
+            continue;
+        }
+
+        const int64_t locked = cdi::clock_now();
+        const cdi::FrameInfo info = m_buffer->info();
+        m_checksum += data[0] + data[m_buffer->size() / 2] + data[m_buffer->size() - 1];
+        m_buffer->unlock();
+
+        // A frame locked again is not a delivery
+        if(info.sequence == m_sequence)
+        {
+            continue;
+        }
+
+        m_sequence = info.sequence;
+        if(m_measuring)
+        {
+            m_frames++;
+            m_latencies.push_back(static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(locked - info.timestamp, 0) / 10, UINT32_MAX)));
+        }
+    }
+}
+
+double percentile(std::vector<uint32_t>& values, const double& fraction)
+{
+    if(values.empty())
+    {
+        return 0.0;
+    }
+
+    const size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+bool run(const Options& options, const uint32_t& count, Report& report)
+{
+    const size_t baseline = resident_bytes();
+    std::atomic<bool> measuring(false);
+    std::atomic<bool> exit(false);
+
+    // The cameras of each run are the only devices, in device index order
+    sdk::remove_cameras();
+    std::vector<std::shared_ptr<sdk::Camera>> cameras;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        sdk::CameraDesc desc;
+        desc.name = L"Stress " + std::to_wstring(i);
+        desc.formats.push_back({*options.source, options.width, options.height, options.fps});
+        desc.row_padding = options.padding;
+        desc.buffer_2d = options.padding > 0;
+        cameras.push_back(sdk::add_camera(desc));
+    }
+
+    std::vector<std::unique_ptr<Consumer>> consumers;
+    const bool shared = options.shared || options.consumers > 1;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(shared)
+        {
+            std::unique_ptr<cdi::ISharedStream> stream = cdi::open_shared(i, options.width, options.height, cdi::StreamOptions());
+            if(!stream)
+            {
+                return false;
+            }
+
+            for(uint32_t j = 0; j < options.consumers; j++)
+            {
+                std::unique_ptr<cdi::IBuffer> buffer = stream->attach(options.encoding);
+                if(!buffer || buffer->width() != options.width || buffer->height() != options.height)
+                {
+                    return false;
+                }
+
+                consumers.emplace_back(new Consumer(std::move(buffer), false, measuring, exit));
+            }
+        }
+        else
+        {
+            cdi::StreamOptions stream_options;
+            stream_options.asynchronous = true;
+            std::unique_ptr<cdi::IBuffer> buffer = cdi::open_device(i, options.width, options.height, options.encoding, stream_options);
+            if(!buffer || buffer->width() != options.width || buffer->height() != options.height)
+            {
+                return false;
+            }
+
+            consumers.emplace_back(new Consumer(std::move(buffer), true, measuring, exit));
+        }
+    }
+
+    for(std::unique_ptr<Consumer>& consumer : consumers)
+    {
+        consumer->start();
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.warmup));
+
+    // The process and the cameras are sampled around the same measured window
+    int64_t cpu = -process_cpu();
+    uint64_t read = 0;
+    for(const std::shared_ptr<sdk::Camera>& camera : cameras)
+    {
+        read -= camera->frames();
+    }
+
+    const Clock::time_point start = Clock::now();
+    measuring = true;
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    measuring = false;
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    cpu += process_cpu();
+    for(const std::shared_ptr<sdk::Camera>& camera : cameras)
+    {
+        read += camera->frames();
+    }
+
+    const size_t resident = resident_bytes();
+
+    exit = true;
+    for(std::unique_ptr<Consumer>& consumer : consumers)
+    {
+        consumer->cancel();
+    }
+
+    std::vector<uint32_t> latencies;
+    report = Report();
+    report.cameras = count;
+    report.expected = options.fps;
+    report.fps_min = 1e9;
+    for(std::unique_ptr<Consumer>& consumer : consumers)
+    {
+        consumer->join();
+        const double fps = consumer->frames() / elapsed;
+        report.fps_min = std::min(report.fps_min, fps);
+        report.fps_mean += fps / consumers.size();
+        latencies.insert(latencies.end(), consumer->latencies().begin(), consumer->latencies().end());
+    }
+
+    // Streams close before their cameras go
+    consumers.clear();
+    cameras.clear();
+    sdk::remove_cameras();
+
+    report.cpu = 100.0 * (cpu / 1e9) / elapsed / count;
+    report.p50 = percentile(latencies, 0.50);
+    report.p99 = percentile(latencies, 0.99);
+    report.rss = resident > baseline ? resident - baseline : 0;
+    const double intervals = elapsed * options.fps * count;
+    report.dropped = intervals > read ? 100.0 * (intervals - read) / intervals : 0.0;
+
+    return true;
+}
+
+// Not keeping up: a consumer misses frames or frames wait longer than a frame interval
+bool saturated(const Report& report, std::string& reason)
+{
+    if(report.fps_min < report.expected * 0.95)
+    {
+        reason = "consumers below 95% of the frame rate";
+        return true;
+    }
+
+    if(report.p99 > 1e6 / report.expected)
+    {
+        reason = "p99 lock latency above one frame interval";
+        return true;
+    }
+
+    return false;
+}
+
+void print_header()
+{
+    std::printf("cameras  fps min/mean/expected  cpu/stream  lock p50/p99 us  rss MB (per stream)  dropped\n");
+}
+
+void print(const Report& report)
+{
+    std::printf("%7u  %6.1f %6.1f %6.1f      %8.1f%%  %7.0f %7.0f  %8.1f (%7.2f)  %6.1f%%\n",
+        report.cameras,
+        report.fps_min,
+        report.fps_mean,
+        report.expected,
+        report.cpu,
+        report.p50,
+        report.p99,
+        report.rss / 1048576.0,
+        report.rss / 1048576.0 / report.cameras,
+        report.dropped);
+    std::fflush(stdout);
+}
+
+void usage()
+{
+    std::printf(
+        "cdi_stress [options]\n"
+        "  --cameras N       stand-in cameras, the maximum with --sweep (8)\n"
+        "  --consumers M     consumers per camera, more than one share a stream (1)\n"
+        "  --size WxH        frame size (1280x720)\n"
+        "  --fps F           frame rate of the cameras (30)\n"
+        "  --source S        yuy2, nv12 or i420 (yuy2)\n"
+        "  --encoding E      rgb24, rgba32 or i420 (rgb24)\n"
+        "  --duration S      measured seconds per run (10)\n"
+        "  --padding B       cameras deliver 2D buffers with B bytes after every row (0)\n"
+        "  --sweep           doubles the cameras from one until the streams saturate\n"
+        "  --shared          shared streams also for a single consumer\n");
+}
+
+bool parse(const int& argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if(arg == "--sweep")
+        {
+            options.sweep = true;
+            continue;
+        }
+
+        if(arg == "--shared")
+        {
+            options.shared = true;
+            continue;
+        }
+
+        if(value == nullptr)
+        {
+            return false;
+        }
+
+        i++;
+        const std::string text = value;
+        if(arg == "--cameras")
+        {
+            options.cameras = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if(arg == "--consumers")
+        {
+            options.consumers = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if(arg == "--size")
+        {
+            if(std::sscanf(value, "%ux%u", &options.width, &options.height) != 2)
+            {
+                return false;
+            }
+        }
+        else if(arg == "--fps")
+        {
+            options.fps = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if(arg == "--duration")
+        {
+            options.duration = std::strtod(value, nullptr);
+        }
+        else if(arg == "--padding")
+        {
+            options.padding = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if(arg == "--source")
+        {
+            if(text == "yuy2")
+            {
+                options.source = &MFVideoFormat_YUY2;
+            }
+            else if(text == "nv12")
+            {
+                options.source = &MFVideoFormat_NV12;
+            }
+            else if(text == "i420")
+            {
+                options.source = &MFVideoFormat_I420;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if(arg == "--encoding")
+        {
+            if(text == "rgb24")
+            {
+                options.encoding = cdi::Encoding::RGB24;
+            }
+            else if(text == "rgba32")
+            {
+                options.encoding = cdi::Encoding::RGBA32;
+            }
+            else if(text == "i420")
+            {
+                options.encoding = cdi::Encoding::I420;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // The conversions work on 2x2 blocks
+    return options.cameras > 0 && options.consumers > 0 && options.fps > 0 && options.duration > 0.0
+        && options.width >= 2 && options.height >= 2 && options.width % 2 == 0 && options.height % 2 == 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parse(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+
+    std::printf("%ux%u at %u fps, %u consumers per camera, %u hardware threads\n",
+        options.width, options.height, options.fps, options.consumers, std::thread::hardware_concurrency());
+    print_header();
+
+    uint32_t cameras = options.sweep ? 1 : options.cameras;
+    for(;;)
+    {
+        Report report;
+        if(!run(options, cameras, report))
+        {
+            std::printf("the cameras could not be opened in this size and encoding\n");
+            return 1;
+        }
+
+        print(report);
+
+        std::string reason;
+        if(saturated(report, reason))
+        {
+            std::printf("saturated at %u cameras: %s\n", cameras, reason.c_str());
+            break;
+        }
+
+        if(!options.sweep || cameras >= options.cameras)
+        {
+            if(options.sweep)
+            {
+                std::printf("not saturated up to %u cameras\n", cameras);
+            }
+
+            break;
+        }
+
+        cameras = std::min(cameras * 2, options.cameras);
+    }
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018, Vladimir Bondarev
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+// Times the tensor writer from I420 and RGB24 frames to the usual network inputs, for every
+// element type and layout: milliseconds per frame, frames per second and tensor bytes per second.
+
+#include "FrameLayout.h"
+#include "TensorWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    Options() : width(1920), height(1080), runs(20) {}
+    uint32_t width;
+    uint32_t height;
+    uint32_t runs;
+};
+
+// Gradients, edges and noise in every plane
+std::vector<uint8_t> render(const uint32_t& width, const uint32_t& height, const cdi::Encoding& encoding)
+{
+    cdi::FrameLayout layout;
+    layout.init(width, height, encoding);
+    const size_t size = layout.size();
+    std::vector<uint8_t> frame(size);
+
+    uint32_t seed = 1;
+    for(size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        const uint32_t x = static_cast<uint32_t>(i % width);
+        const uint32_t y = static_cast<uint32_t>(i / width);
+        const double edge = ((x / 64 + y / 64) % 2) != 0 ? 20.0 : -20.0;
+        const double value = 128.0 + 60.0 * std::sin(x * 0.01) * std::cos(y * 0.02) + edge + (seed >> 16) % 9;
+        frame[i] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, value)));
+    }
+    return frame;
+}
+
+// Fastest of the runs in milliseconds
+template<typename F>
+double best_of(const uint32_t& runs, F run)
+{
+    double best = 1e30;
+    for(uint32_t i = 0; i < runs; i++)
+    {
+        const Clock::time_point start = Clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+bool parse(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(i + 1 >= argc)
+        {
+            return false;
+        }
+
+        const uint32_t value = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        if(arg == "--width")
+        {
+            options.width = value;
+        }
+        else if(arg == "--height")
+        {
+            options.height = value;
+        }
+        else if(arg == "--runs")
+        {
+            options.runs = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options.width >= 2 && options.height >= 2 && options.runs > 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parse(argc, argv, options))
+    {
+        std::printf("usage: cdi_tensor_bench [--width 1920] [--height 1080] [--runs 20]\n");
+        return 1;
+    }
+
+    std::printf("%ux%u source, fastest of %u runs\n", options.width, options.height, options.runs);
+    std::printf("%-30s %8s %8s %10s\n", "", "ms", "fps", "MB/s");
+
+    struct Source
+    {
+        const char* name;
+        cdi::Encoding encoding;
+    };
+    const Source sources[] = {
+        {"I420", cdi::Encoding::I420},
+        {"RGB24", cdi::Encoding::RGB24},
+    };
+
+    struct Target
+    {
+        uint32_t width;
+        uint32_t height;
+    };
+    const Target targets[] = {
+        {224, 224},
+        {640, 640},
+        {options.width, options.height},
+    };
+
+    struct Type
+    {
+        const char* name;
+        cdi::TensorType type;
+    };
+    const Type types[] = {
+        {"u8", cdi::TensorType::UINT8},
+        {"f16", cdi::TensorType::FLOAT16},
+        {"f32", cdi::TensorType::FLOAT32},
+    };
+
+    for(const Source& source : sources)
+    {
+        const std::vector<uint8_t> frame = render(options.width, options.height, source.encoding);
+        cdi::FrameLevel level;
+        level.width = options.width;
+        level.height = options.height;
+        level.encoding = source.encoding;
+        level.size = frame.size();
+        level.data = frame.data();
+
+        for(const Target& target : targets)
+        {
+            for(const Type& type : types)
+            {
+                for(const cdi::TensorLayout layout : {cdi::TensorLayout::NCHW, cdi::TensorLayout::NHWC})
+                {
+                    cdi::TensorDesc desc;
+                    desc.width = target.width;
+                    desc.height = target.height;
+                    desc.layout = layout;
+                    desc.type = type.type;
+
+                    cdi::TensorWriter writer;
+                    if(!writer.init(desc))
+                    {
+                        return 1;
+                    }
+                    std::vector<uint8_t> tensor(writer.size());
+
+                    bool written = true;
+                    const double ms = best_of(options.runs, [&]() {
+                        written = writer.write(level, tensor.data(), 0) && written;
+                    });
+                    if(!written)
+                    {
+                        return 1;
+                    }
+
+                    char name[64];
+                    std::snprintf(name, sizeof(name), "%s to %ux%u %s %s",
+                        source.name, target.width, target.height, type.name, layout == cdi::TensorLayout::NCHW ? "NCHW" : "NHWC");
+                    std::printf("%-30s %8.2f %8.0f %10.0f\n",
+                        name, ms, 1000.0 / ms, static_cast<double>(tensor.size()) / 1e6 / (ms / 1000.0));
+                }
+            }
+        }
+    }
+
+    return 0;
+}